@@ -119,6 +119,18 @@ pub trait CreateCertificate {
         properties: &CertificateProperties,
     ) -> Result<Self::Certificate, Error>;
 
+    /// Creates a certificate for each of the properties, in the same order.
+    /// Implementations may issue the batch concurrently.
+    fn create_certificates(
+        &self,
+        properties: &[CertificateProperties],
+    ) -> Result<Vec<Self::Certificate>, Error> {
+        properties
+            .iter()
+            .map(|props| self.create_certificate(props))
+            .collect()
+    }
+
     fn destroy_certificate(&self, alias: String) -> Result<(), Error>;
 }
 
@@ -4,6 +4,7 @@ use std::convert::AsRef;
 use std::ffi::{CStr, CString};
 use std::ops::{Deref, Drop};
 use std::os::raw::{c_uchar, c_void};
+use std::ptr;
 use std::slice;
 use std::str;
 
@@ -36,6 +37,11 @@ pub struct Crypto {
     interface: HSM_CLIENT_CRYPTO_INTERFACE_TAG,
 }
 
+// The HSM library allows all crypto interface functions other than create and
+// destroy to be called concurrently on the same handle.
+unsafe impl Send for Crypto {}
+unsafe impl Sync for Crypto {}
+
 impl Drop for Crypto {
     fn drop(&mut self) {
         if let Some(f) = self.interface.hsm_client_crypto_destroy {
@@ -217,6 +223,49 @@ impl CreateCertificate for Crypto {
         }
     }
 
+    fn create_certificates(
+        &self,
+        properties: &[CertificateProperties],
+    ) -> Result<Vec<HsmCertificate>, Error> {
+        let if_fn = self
+            .interface
+            .hsm_client_create_certificates
+            .ok_or(ErrorKind::NoneFn)?;
+        let mut property_handles = Vec::with_capacity(properties.len());
+        for props in properties {
+            match make_certification_props(props) {
+                Ok(property_handle) => property_handles.push(property_handle),
+                Err(err) => {
+                    for property_handle in property_handles {
+                        unsafe { cert_properties_destroy(property_handle) };
+                    }
+                    return Err(err);
+                }
+            }
+        }
+
+        let mut cert_info_handles = vec![ptr::null_mut(); properties.len()];
+        let result = unsafe {
+            if_fn(
+                self.handle,
+                property_handles.as_mut_ptr(),
+                property_handles.len(),
+                cert_info_handles.as_mut_ptr(),
+            )
+        };
+        for property_handle in property_handles {
+            unsafe { cert_properties_destroy(property_handle) };
+        }
+
+        match result {
+            0 => Ok(cert_info_handles
+                .into_iter()
+                .map(|cert_info_handle| HsmCertificate { cert_info_handle })
+                .collect()),
+            r => Err(ErrorKind::Api(r))?,
+        }
+    }
+
     fn destroy_certificate(&self, alias: String) -> Result<(), Error> {
         let if_fn = self
             .interface
@@ -738,6 +787,24 @@ mod tests {
         }
     }
 
+    unsafe extern "C" fn fake_create_certs(
+        handle: HSM_CLIENT_HANDLE,
+        certificate_props: *mut CERT_PROPS_HANDLE,
+        count: usize,
+        certificates: *mut CERT_INFO_HANDLE,
+    ) -> c_int {
+        let n = handle as isize;
+        if n == 0 {
+            for index in 0..count {
+                *certificates.offset(index as isize) =
+                    fake_create_cert(handle, *certificate_props.offset(index as isize));
+            }
+            0
+        } else {
+            1
+        }
+    }
+
     unsafe extern "C" fn fake_destroy_cert(_handle: HSM_CLIENT_HANDLE, _alias: *const c_char) {}
 
     const DEFAULT_BUF_LEN: usize = 10;
@@ -789,6 +856,15 @@ mod tests {
         println!("You should never see this print {:?}", result);
     }
 
+    #[test]
+    #[should_panic(expected = "HSM API Not Implemented")]
+    fn no_create_certificates_api_fail() {
+        let props = vec![CertificateProperties::default()];
+        let hsm_crypto = fake_no_if_hsm_crypto();
+        let result = hsm_crypto.create_certificates(&props).unwrap();
+        println!("You should never see this print {:?}", result);
+    }
+
     #[test]
     #[should_panic(expected = "HSM API Not Implemented")]
     fn no_trust_bundle_api_fail() {
@@ -837,6 +913,12 @@ mod tests {
                 hsm_client_decrypt_data: Some(fake_decrypt),
                 hsm_client_get_trust_bundle: Some(fake_trust_bundle),
                 hsm_client_free_buffer: Some(real_buffer_destroy),
+                hsm_client_create_certificates: Some(fake_create_certs),
+                hsm_client_encrypt_stream_init: None,
+                hsm_client_decrypt_stream_init: None,
+                hsm_client_stream_update: None,
+                hsm_client_stream_final: None,
+                hsm_client_stream_destroy: None,
             },
         }
     }
@@ -876,6 +958,16 @@ mod tests {
         println!("You should never see this print {:?}", result);
     }
 
+    #[test]
+    #[should_panic(expected = "HSM API failure occurred")]
+    fn hsm_create_certificates_errors() {
+        let hsm_crypto = fake_bad_hsm_crypto();
+        let props = vec![CertificateProperties::default()];
+
+        let result = hsm_crypto.create_certificates(&props).unwrap();
+        println!("You should never see this print {:?}", result);
+    }
+
     #[test]
     #[should_panic(expected = "HSM API returned an invalid null response")]
     fn hsm_get_trust_bundle_errors() {
@@ -918,6 +1010,12 @@ mod tests {
                 hsm_client_decrypt_data: Some(fake_decrypt),
                 hsm_client_get_trust_bundle: Some(fake_trust_bundle),
                 hsm_client_free_buffer: Some(real_buffer_destroy),
+                hsm_client_create_certificates: Some(fake_create_certs),
+                hsm_client_encrypt_stream_init: None,
+                hsm_client_decrypt_stream_init: None,
+                hsm_client_stream_update: None,
+                hsm_client_stream_final: None,
+                hsm_client_stream_destroy: None,
             },
         }
     }
@@ -942,6 +1040,11 @@ mod tests {
         let props = CertificateProperties::default();
         let _new_cert = hsm_crypto.create_certificate(&props).unwrap();
 
+        let batch_props = vec![props.clone(), props.clone()];
+        let new_certs = hsm_crypto.create_certificates(&batch_props).unwrap();
+
+        assert_eq!(new_certs.len(), 2);
+
         let crypt1 = hsm_crypto
             .encrypt(b"client_id", b"plaintext", b"init_vector")
             .unwrap();
@@ -14,7 +14,7 @@ pub use crypto::{
     Buffer, CertificateProperties, CertificateType, Crypto, HsmCertificate, KeyBytes, PrivateKey,
 };
 pub use error::{Error, ErrorKind};
-pub use tpm::{Tpm, TpmDigest, TpmKey};
+pub use tpm::{Tpm, TpmDigest, TpmDigests, TpmKey};
 pub use x509::{X509, X509Data};
 
 // Traits
@@ -32,6 +32,21 @@ pub trait SignWithTpm {
         data: &[u8],
         identity: &[u8],
     ) -> Result<TpmDigest, Error>;
+    /// Signs into `digest` and returns the length of the signature.
+    fn sign_with_identity_into(&self, data: &[u8], digest: &mut [u8]) -> Result<usize, Error>;
+    /// Derives the key for `identity` and signs into `digest`, returning the
+    /// length of the signature.
+    fn derive_and_sign_with_identity_into(
+        &self,
+        data: &[u8],
+        identity: &[u8],
+        digest: &mut [u8],
+    ) -> Result<usize, Error>;
+    /// Signs every payload of `data` with the identity key opened once.
+    fn sign_batch(&self, data: &[&[u8]]) -> Result<TpmDigests, Error>;
+    /// Derives the key for each `(identity, data)` request and signs its
+    /// payload, with the identity key opened once for the whole batch.
+    fn derive_and_sign_batch(&self, requests: &[(&[u8], &[u8])]) -> Result<TpmDigests, Error>;
 }
 
 pub trait GetCerts {
@@ -58,6 +73,11 @@ pub trait CreateCertificate {
         properties: &CertificateProperties,
     ) -> Result<HsmCertificate, Error>;
 
+    fn create_certificates(
+        &self,
+        properties: &[CertificateProperties],
+    ) -> Result<Vec<HsmCertificate>, Error>;
+
     fn destroy_certificate(&self, alias: String) -> Result<(), Error>;
 }
 
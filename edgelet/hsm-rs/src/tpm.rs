@@ -19,6 +19,11 @@ pub struct Tpm {
     interface: HSM_CLIENT_TPM_INTERFACE,
 }
 
+// The HSM library allows all TPM interface functions other than create and
+// destroy to be called concurrently on the same handle.
+unsafe impl Send for Tpm {}
+unsafe impl Sync for Tpm {}
+
 // HSM TPM
 
 impl Drop for Tpm {
@@ -57,6 +62,40 @@ impl Tpm {
             Err(ErrorKind::NullResponse)?
         }
     }
+
+    fn sign_requests(
+        &self,
+        batch_fn: HSM_CLIENT_SIGN_BATCH,
+        requests: &[HSM_SIGN_REQUEST],
+    ) -> Result<TpmDigests, Error> {
+        let mut digest_ln: usize = 0;
+        let mut ptr = ptr::null_mut();
+
+        let key_fn = batch_fn.ok_or(ErrorKind::NoneFn)?;
+        let result = unsafe {
+            key_fn(
+                self.handle,
+                requests.as_ptr(),
+                requests.len(),
+                &mut ptr,
+                &mut digest_ln,
+            )
+        };
+        match result {
+            0 => {
+                let digests =
+                    TpmBuffer::new(self.interface, ptr as *const _, requests.len() * digest_ln);
+                if ptr.is_null() || digest_ln == 0 {
+                    Err(ErrorKind::NullResponse)?
+                }
+                Ok(TpmDigests {
+                    digests,
+                    digest_len: digest_ln,
+                })
+            }
+            r => Err(r)?,
+        }
+    }
 }
 
 impl ManageTpmKeys for Tpm {
@@ -154,6 +193,87 @@ impl SignWithTpm for Tpm {
             Err(result)?
         }
     }
+
+    /// Hashes the parameter data with the key previously stored in the TPM
+    /// into a buffer owned by the caller, nothing is allocated by the HSM.
+    fn sign_with_identity_into(&self, data: &[u8], digest: &mut [u8]) -> Result<usize, Error> {
+        let mut digest_ln: usize = digest.len();
+
+        let key_fn = self
+            .interface
+            .hsm_client_sign_with_identity_into
+            .ok_or(ErrorKind::NoneFn)?;
+        let result = unsafe {
+            key_fn(
+                self.handle,
+                data.as_ptr(),
+                data.len(),
+                digest.as_mut_ptr(),
+                &mut digest_ln,
+            )
+        };
+        match result {
+            0 => Ok(digest_ln),
+            r => Err(r)?,
+        }
+    }
+
+    fn derive_and_sign_with_identity_into(
+        &self,
+        data: &[u8],
+        identity: &[u8],
+        digest: &mut [u8],
+    ) -> Result<usize, Error> {
+        let mut digest_ln: usize = digest.len();
+
+        let key_fn = self
+            .interface
+            .hsm_client_derive_and_sign_with_identity_into
+            .ok_or(ErrorKind::NoneFn)?;
+        let result = unsafe {
+            key_fn(
+                self.handle,
+                data.as_ptr(),
+                data.len(),
+                identity.as_ptr(),
+                identity.len(),
+                digest.as_mut_ptr(),
+                &mut digest_ln,
+            )
+        };
+        match result {
+            0 => Ok(digest_ln),
+            r => Err(r)?,
+        }
+    }
+
+    /// Hashes each payload with the key previously stored in the TPM. The
+    /// digests are returned in request order in a single buffer.
+    fn sign_batch(&self, data: &[&[u8]]) -> Result<TpmDigests, Error> {
+        let requests: Vec<HSM_SIGN_REQUEST> = data
+            .iter()
+            .map(|d| HSM_SIGN_REQUEST {
+                data: d.as_ptr(),
+                data_size: d.len(),
+                identity: ptr::null(),
+                identity_size: 0,
+            })
+            .collect();
+        self.sign_requests(self.interface.hsm_client_sign_batch, &requests)
+    }
+
+    fn derive_and_sign_batch(&self, requests: &[(&[u8], &[u8])]) -> Result<TpmDigests, Error> {
+        let requests: Vec<HSM_SIGN_REQUEST> = requests
+            .iter()
+            .map(|&(identity, data)| HSM_SIGN_REQUEST {
+                data: data.as_ptr(),
+                data_size: data.len(),
+                identity: identity.as_ptr(),
+                identity_size: identity.len(),
+            })
+            .collect();
+        self.sign_requests(self.interface.hsm_client_derive_and_sign_batch, &requests)
+    }
 }
 
 /// When buffer data is returned from TPM interface, it is placed in this struct.
@@ -201,6 +321,38 @@ impl AsRef<[u8]> for TpmBuffer {
     }
 }
 
+/// The digests of a batch sign, all held in the one buffer allocated by the
+/// C library. Digest i is found at offset i * digest_len.
+#[derive(Debug)]
+pub struct TpmDigests {
+    digests: TpmBuffer,
+    digest_len: usize,
+}
+
+impl TpmDigests {
+    /// Number of digests in the batch.
+    pub fn len(&self) -> usize {
+        self.digests.len() / self.digest_len
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+
+    /// Length of each digest.
+    pub fn digest_len(&self) -> usize {
+        self.digest_len
+    }
+
+    pub fn get(&self, index: usize) -> Option<&[u8]> {
+        self.iter().nth(index)
+    }
+
+    pub fn iter(&self) -> slice::Chunks<u8> {
+        self.digests.chunks(self.digest_len)
+    }
+}
+
 #[cfg(test)]
 mod tests {
     use std::os::raw::{c_int, c_uchar, c_void};
@@ -353,6 +505,78 @@ mod tests {
         }
     }
 
+    unsafe extern "C" fn fake_sign_into(
+        handle: HSM_CLIENT_HANDLE,
+        _data: *const c_uchar,
+        _data_len: usize,
+        digest: *mut c_uchar,
+        digest_size: *mut usize,
+    ) -> c_int {
+        let n = handle as isize;
+        if n == 0 && *digest_size >= DEFAULT_KEY_LEN {
+            memset(digest as *mut c_void, 6 as c_int, DEFAULT_KEY_LEN);
+            *digest_size = DEFAULT_KEY_LEN;
+            0
+        } else {
+            1
+        }
+    }
+
+    unsafe extern "C" fn fake_derive_and_sign_into(
+        handle: HSM_CLIENT_HANDLE,
+        _data_to_be_signed: *const c_uchar,
+        _data_to_be_signed_size: usize,
+        _identity: *const c_uchar,
+        _identity_size: usize,
+        digest: *mut c_uchar,
+        digest_size: *mut usize,
+    ) -> c_int {
+        let n = handle as isize;
+        if n == 0 && *digest_size >= DEFAULT_KEY_LEN {
+            memset(digest as *mut c_void, 6 as c_int, DEFAULT_KEY_LEN);
+            *digest_size = DEFAULT_KEY_LEN;
+            0
+        } else {
+            1
+        }
+    }
+
+    unsafe extern "C" fn fake_sign_batch(
+        handle: HSM_CLIENT_HANDLE,
+        _requests: *const HSM_SIGN_REQUEST,
+        count: usize,
+        digests: *mut *mut c_uchar,
+        digest_size: *mut usize,
+    ) -> c_int {
+        let n = handle as isize;
+        if n == 0 && count != 0 {
+            *digests = malloc(count * DEFAULT_KEY_LEN) as *mut c_uchar;
+            memset(*digests as *mut c_void, 6 as c_int, count * DEFAULT_KEY_LEN);
+            *digest_size = DEFAULT_KEY_LEN;
+            0
+        } else {
+            1
+        }
+    }
+
+    unsafe extern "C" fn fake_derive_and_sign_batch(
+        handle: HSM_CLIENT_HANDLE,
+        requests: *const HSM_SIGN_REQUEST,
+        count: usize,
+        digests: *mut *mut c_uchar,
+        digest_size: *mut usize,
+    ) -> c_int {
+        let n = handle as isize;
+        if n == 0 && count != 0 && !(*requests).identity.is_null() {
+            *digests = malloc(count * DEFAULT_KEY_LEN) as *mut c_uchar;
+            memset(*digests as *mut c_void, 7 as c_int, count * DEFAULT_KEY_LEN);
+            *digest_size = DEFAULT_KEY_LEN;
+            0
+        } else {
+            1
+        }
+    }
+
     fn fake_no_if_tpm_hsm() -> Tpm {
         Tpm {
             handle: unsafe { fake_handle_create_good() },
@@ -410,6 +634,47 @@ mod tests {
         println!("You should never see this print {:?}", result);
     }
 
+    #[test]
+    #[should_panic(expected = "HSM API Not Implemented")]
+    fn tpm_no_sign_into_function_fail() {
+        let hsm_tpm = fake_no_if_tpm_hsm();
+        let key = b"key data";
+        let mut digest = [0_u8; DEFAULT_KEY_LEN];
+        let result = hsm_tpm.sign_with_identity_into(key, &mut digest).unwrap();
+        println!("You should never see this print {:?}", result);
+    }
+
+    #[test]
+    #[should_panic(expected = "HSM API Not Implemented")]
+    fn tpm_no_derive_and_sign_into_function_fail() {
+        let hsm_tpm = fake_no_if_tpm_hsm();
+        let key = b"key data";
+        let identity = b"identity";
+        let mut digest = [0_u8; DEFAULT_KEY_LEN];
+        let result = hsm_tpm
+            .derive_and_sign_with_identity_into(key, identity, &mut digest)
+            .unwrap();
+        println!("You should never see this print {:?}", result);
+    }
+
+    #[test]
+    #[should_panic(expected = "HSM API Not Implemented")]
+    fn tpm_no_sign_batch_function_fail() {
+        let hsm_tpm = fake_no_if_tpm_hsm();
+        let data: [&[u8]; 1] = [b"key data"];
+        let result = hsm_tpm.sign_batch(&data).unwrap();
+        println!("You should never see this print {:?}", result);
+    }
+
+    #[test]
+    #[should_panic(expected = "HSM API Not Implemented")]
+    fn tpm_no_derive_and_sign_batch_function_fail() {
+        let hsm_tpm = fake_no_if_tpm_hsm();
+        let requests: [(&[u8], &[u8]); 1] = [(b"identity", b"key data")];
+        let result = hsm_tpm.derive_and_sign_batch(&requests).unwrap();
+        println!("You should never see this print {:?}", result);
+    }
+
     fn fake_good_tpm_hsm() -> Tpm {
         Tpm {
             handle: unsafe { fake_handle_create_good() },
@@ -422,6 +687,10 @@ mod tests {
                 hsm_client_sign_with_identity: Some(fake_sign),
                 hsm_client_derive_and_sign_with_identity: Some(fake_derive_and_sign),
                 hsm_client_free_buffer: Some(fake_buffer_destroy),
+                hsm_client_sign_with_identity_into: Some(fake_sign_into),
+                hsm_client_derive_and_sign_with_identity_into: Some(fake_derive_and_sign_into),
+                hsm_client_sign_batch: Some(fake_sign_batch),
+                hsm_client_derive_and_sign_batch: Some(fake_derive_and_sign_batch),
             },
         }
     }
@@ -451,6 +720,31 @@ mod tests {
         let result5 = hsm_tpm.derive_and_sign_with_identity(k3, identity).unwrap();
         let buf5 = &result5;
         assert_eq!(buf5.len(), DEFAULT_KEY_LEN);
+
+        let mut digest = [0_u8; 2 * DEFAULT_KEY_LEN];
+        let len6 = hsm_tpm.sign_with_identity_into(k2, &mut digest).unwrap();
+        assert_eq!(len6, DEFAULT_KEY_LEN);
+        assert_eq!(digest[0], 6);
+
+        let mut digest = [0_u8; 2 * DEFAULT_KEY_LEN];
+        let len7 = hsm_tpm
+            .derive_and_sign_with_identity_into(k3, identity, &mut digest)
+            .unwrap();
+        assert_eq!(len7, DEFAULT_KEY_LEN);
+        assert_eq!(digest[DEFAULT_KEY_LEN - 1], 6);
+
+        let data: [&[u8]; 3] = [k2, k3, b"a third buffer"];
+        let result8 = hsm_tpm.sign_batch(&data).unwrap();
+        assert_eq!(result8.len(), 3);
+        assert_eq!(result8.digest_len(), DEFAULT_KEY_LEN);
+        assert_eq!(result8.iter().count(), 3);
+        assert_eq!(result8.get(2).unwrap(), &[6_u8; DEFAULT_KEY_LEN][..]);
+        assert!(result8.get(3).is_none());
+
+        let requests: [(&[u8], &[u8]); 2] = [(identity, k2), (b"other identity", k3)];
+        let result9 = hsm_tpm.derive_and_sign_batch(&requests).unwrap();
+        assert_eq!(result9.len(), 2);
+        assert_eq!(result9.get(1).unwrap(), &[7_u8; DEFAULT_KEY_LEN][..]);
     }
 
     fn fake_bad_tpm_hsm() -> Tpm {
@@ -465,6 +759,10 @@ mod tests {
                 hsm_client_sign_with_identity: Some(fake_sign),
                 hsm_client_derive_and_sign_with_identity: Some(fake_derive_and_sign),
                 hsm_client_free_buffer: Some(fake_buffer_destroy),
+                hsm_client_sign_with_identity_into: Some(fake_sign_into),
+                hsm_client_derive_and_sign_with_identity_into: Some(fake_derive_and_sign_into),
+                hsm_client_sign_batch: Some(fake_sign_batch),
+                hsm_client_derive_and_sign_batch: Some(fake_derive_and_sign_batch),
             },
         }
     }
@@ -513,4 +811,45 @@ mod tests {
         println!("You should never see this print {:?}", result);
     }
 
+    #[test]
+    #[should_panic(expected = "HSM API failure occurred")]
+    fn tpm_sign_into_small_buffer_errors() {
+        let hsm_tpm = fake_good_tpm_hsm();
+        let k1 = b"A fake buffer";
+        let mut digest = [0_u8; DEFAULT_KEY_LEN - 1];
+        let result = hsm_tpm.sign_with_identity_into(k1, &mut digest).unwrap();
+        println!("You should never see this print {:?}", result);
+    }
+
+    #[test]
+    #[should_panic(expected = "HSM API failure occurred")]
+    fn tpm_derive_and_sign_into_errors() {
+        let hsm_tpm = fake_bad_tpm_hsm();
+        let k1 = b"A fake buffer";
+        let identity = b"an identity";
+        let mut digest = [0_u8; DEFAULT_KEY_LEN];
+        let result = hsm_tpm
+            .derive_and_sign_with_identity_into(k1, identity, &mut digest)
+            .unwrap();
+        println!("You should never see this print {:?}", result);
+    }
+
+    #[test]
+    #[should_panic(expected = "HSM API failure occurred")]
+    fn tpm_sign_batch_errors() {
+        let hsm_tpm = fake_bad_tpm_hsm();
+        let data: [&[u8]; 2] = [b"A fake buffer", b"Another fake buffer"];
+        let result = hsm_tpm.sign_batch(&data).unwrap();
+        println!("You should never see this print {:?}", result);
+    }
+
+    #[test]
+    #[should_panic(expected = "HSM API failure occurred")]
+    fn tpm_derive_and_sign_batch_errors() {
+        let hsm_tpm = fake_bad_tpm_hsm();
+        let requests: [(&[u8], &[u8]); 1] = [(b"an identity", b"A fake buffer")];
+        let result = hsm_tpm.derive_and_sign_batch(&requests).unwrap();
+        println!("You should never see this print {:?}", result);
+    }
+
 }
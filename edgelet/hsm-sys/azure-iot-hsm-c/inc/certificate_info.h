@@ -37,7 +37,34 @@ typedef enum PRIVATE_KEY_TYPE_TAG
 extern CERT_INFO_HANDLE certificate_info_create(const char* certificate, const void* private_key, size_t priv_key_len, PRIVATE_KEY_TYPE pk_type);
 
 /**
-* @brief            Frees all resources associated with this object
+* @brief            Creates the certificate information object from a buffer that is
+*                   not required to be null terminated, such as a mapped file
+*
+* @param certificate        The certificate in PEM format
+* @param certificate_size   The number of bytes in the certificate buffer
+* @param private_key        A value or reference to the certificate private key
+* @param pk_len             The length of the private key
+* @param pk_type            Indicates the type of the private key either the value or reference
+*
+* @return           On success a valid CERT_INFO_HANDLE or NULL on failure
+*/
+extern CERT_INFO_HANDLE certificate_info_create_from_buffer(const char* certificate, size_t certificate_size, const void* private_key, size_t priv_key_len, PRIVATE_KEY_TYPE pk_type);
+
+/**
+* @brief            Obtains an additional reference to the certificate information
+*                   object. The object is immutable so the returned handle may be
+*                   shared between threads. Each reference must be released with
+*                   certificate_info_destroy.
+*
+* @param handle     The handle created in certificate_info_create
+*
+* @return           The handle on success or NULL on failure
+*/
+extern CERT_INFO_HANDLE certificate_info_clone(CERT_INFO_HANDLE handle);
+
+/**
+* @brief            Releases a reference to this object and frees all resources
+*                   associated with it once the last reference is released
 *
 * @param handle     The handle created in certificate_info_create
 *
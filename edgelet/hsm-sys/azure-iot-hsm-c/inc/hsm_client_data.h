@@ -19,6 +19,7 @@ extern "C" {
 /** @file */
 
 typedef void* HSM_CLIENT_HANDLE;
+typedef void* HSM_CLIENT_STREAM_HANDLE;
 
 /**
  * An allocated buffer and its associated size. If this struct is created by the caller but
@@ -31,6 +32,18 @@ typedef struct SIZED_BUFFER_TAG
     size_t size;
 } SIZED_BUFFER;
 
+/**
+ * A payload to be signed by one of the batch sign functions. The identity is
+ * only used by ::HSM_CLIENT_DERIVE_AND_SIGN_BATCH.
+ */
+typedef struct HSM_SIGN_REQUEST_TAG
+{
+    const unsigned char* data;
+    size_t data_size;
+    const unsigned char* identity;
+    size_t identity_size;
+} HSM_SIGN_REQUEST;
+
 /**
  * @brief   Creates a client for the associated interface
  *
@@ -100,6 +113,9 @@ typedef int (*HSM_CLIENT_GET_STORAGE_ROOT_KEY)(HSM_CLIENT_HANDLE handle, unsigne
 *                           which must be freed by a call to ::HSM_CLIENT_FREE_BUFFER.
 * @param[out] digest_size   The size of the returned digest
 *
+* @note If digest is NULL the API will return the size of the required
+* buffer to hold the digest contents.
+*
 * @return                   On success 0 on. Non-zero on failure
 */
 typedef int (*HSM_CLIENT_SIGN_WITH_IDENTITY)(HSM_CLIENT_HANDLE handle, const unsigned char* data, size_t data_size, unsigned char** digest, size_t* digest_size);
@@ -123,6 +139,81 @@ typedef int (*HSM_CLIENT_SIGN_WITH_IDENTITY)(HSM_CLIENT_HANDLE handle, const uns
 */
 typedef int (*HSM_CLIENT_DERIVE_AND_SIGN_WITH_IDENTITY)(HSM_CLIENT_HANDLE handle, const unsigned char* data, size_t data_size, const unsigned char* identity, size_t identity_size, unsigned char** digest, size_t* digest_size);
 
+/**
+* @brief    Same as ::HSM_CLIENT_SIGN_WITH_IDENTITY but writes the digest into
+*           a buffer supplied by the caller instead of allocating one.
+*
+* @param handle             ::HSM_CLIENT_HANDLE that was created by the ::HSM_CLIENT_CREATE call
+* @param data               Data that will need to be hashed
+* @param data_size          The size of the data parameter
+* @param[out] digest        Buffer that receives the digest
+* @param[in,out] digest_size On input the size of the digest buffer. On output
+*                           the size of the digest, or of the buffer required
+*                           to hold it when the buffer is too small.
+*
+* @note If digest is NULL the API will return the size of the required
+* buffer to hold the digest contents.
+*
+* @return   Zero on success. Non-zero on failure
+*/
+typedef int (*HSM_CLIENT_SIGN_WITH_IDENTITY_INTO)(HSM_CLIENT_HANDLE handle, const unsigned char* data, size_t data_size, unsigned char* digest, size_t* digest_size);
+
+/**
+* @brief    Same as ::HSM_CLIENT_DERIVE_AND_SIGN_WITH_IDENTITY but writes the
+*           digest into a buffer supplied by the caller instead of allocating one.
+*
+* @param handle             A valid HSM client handle
+* @param data               Data to be signed
+* @param data_size          The size of the data to be signed
+* @param identity           Identity to be used to derive the SAS key
+* @param identity_size      The size of the identity
+* @param[out] digest        Buffer that receives the digest
+* @param[in,out] digest_size On input the size of the digest buffer. On output
+*                           the size of the digest, or of the buffer required
+*                           to hold it when the buffer is too small.
+*
+* @note If digest is NULL the API will return the size of the required
+* buffer to hold the digest contents.
+*
+* @return   Zero on success. Non-zero on failure
+*/
+typedef int (*HSM_CLIENT_DERIVE_AND_SIGN_WITH_IDENTITY_INTO)(HSM_CLIENT_HANDLE handle, const unsigned char* data, size_t data_size, const unsigned char* identity, size_t identity_size, unsigned char* digest, size_t* digest_size);
+
+/**
+* @brief    Signs each payload of a batch as if by ::HSM_CLIENT_SIGN_WITH_IDENTITY.
+*           The identity key is opened once for the whole batch.
+*
+* @param handle             A valid HSM client handle
+* @param requests           Array of payloads to be signed
+* @param count              The number of requests
+* @param[out] digests       The returned digests, the digest of request i starts at
+*                           offset i * digest_size. This function allocates memory for
+*                           a single buffer which must be freed by a call to
+*                           ::HSM_CLIENT_FREE_BUFFER.
+* @param[out] digest_size   The size of each digest
+*
+* @return   Zero on success. Non-zero on failure, in which case no digests are returned
+*/
+typedef int (*HSM_CLIENT_SIGN_BATCH)(HSM_CLIENT_HANDLE handle, const HSM_SIGN_REQUEST* requests, size_t count, unsigned char** digests, size_t* digest_size);
+
+/**
+* @brief    Derives the SAS key of each request's identity and uses it to sign the
+*           request's payload as if by ::HSM_CLIENT_DERIVE_AND_SIGN_WITH_IDENTITY.
+*           The identity key is opened once for the whole batch.
+*
+* @param handle             A valid HSM client handle
+* @param requests           Array of identities and payloads to be signed
+* @param count              The number of requests
+* @param[out] digests       The returned digests, the digest of request i starts at
+*                           offset i * digest_size. This function allocates memory for
+*                           a single buffer which must be freed by a call to
+*                           ::HSM_CLIENT_FREE_BUFFER.
+* @param[out] digest_size   The size of each digest
+*
+* @return   Zero on success. Non-zero on failure, in which case no digests are returned
+*/
+typedef int (*HSM_CLIENT_DERIVE_AND_SIGN_BATCH)(HSM_CLIENT_HANDLE handle, const HSM_SIGN_REQUEST* requests, size_t count, unsigned char** digests, size_t* digest_size);
+
 // x509
 /**
 * @brief        Retrieves the certificate to be used for x509 communication. This value is
@@ -202,6 +293,25 @@ typedef int (*HSM_CLIENT_GET_RANDOM_BYTES)(HSM_CLIENT_HANDLE handle, unsigned ch
 */
 typedef CERT_INFO_HANDLE (*HSM_CLIENT_CREATE_CERTIFICATE)(HSM_CLIENT_HANDLE handle, CERT_PROPS_HANDLE certificate_props);
 
+/**
+* @brief    Generates a batch of X.509 certificate and private key pairs, one for each
+*           of the supplied certificate properties, as if by ::HSM_CLIENT_CREATE_CERTIFICATE.
+*           The keys are generated concurrently and the aliases must be distinct.
+*
+* @param handle                 A valid HSM client handle
+* @param certificate_props      Array of handles to certificate properties
+* @param count                  The number of certificate properties
+* @param[out] certificates      Array of count handles which receive the certificate of the
+*                               properties at the same index. Each returned handle must be
+*                               released with certificate_info_destroy.
+*
+* @note On failure no handles are returned and the certificates issued by the call
+* are removed. Existing certificates which were reused are kept.
+*
+* @return   Zero on success, nonzero otherwise
+*/
+typedef int (*HSM_CLIENT_CREATE_CERTIFICATES)(HSM_CLIENT_HANDLE handle, CERT_PROPS_HANDLE* certificate_props, size_t count, CERT_INFO_HANDLE* certificates);
+
 /**
 * @brief    Deletes any crypto assets associated with the handle
 *           returned by ::HSM_CLIENT_CREATE_CERTIFICATE.
@@ -247,6 +357,63 @@ typedef int (*HSM_CLIENT_ENCRYPT_DATA)(HSM_CLIENT_HANDLE handle, const SIZED_BUF
 */
 typedef int (*HSM_CLIENT_DECRYPT_DATA)(HSM_CLIENT_HANDLE handle, const SIZED_BUFFER* identity, const SIZED_BUFFER* ciphertext, const SIZED_BUFFER* init_vector, SIZED_BUFFER* plaintext);
 
+/**
+* @brief    Starts encrypting or decrypting data of any size in pieces, with the key used
+*           by ::HSM_CLIENT_ENCRYPT_DATA, using memory bounded by the chunk size of the
+*           cipher text rather than by the data size. Cipher text of an encrypt stream can
+*           also be decrypted by ::HSM_CLIENT_DECRYPT_DATA.
+*
+* @param handle             A valid HSM client handle
+* @param identity           Module or client identity string used in key generation
+* @param init_vector        Initialization vector used for the cipher
+* @param[out] stream        Receives the stream handle which must be released with a call
+*                           to ::HSM_CLIENT_STREAM_DESTROY.
+*
+* @return   Zero on success, nonzero otherwise
+*/
+typedef int (*HSM_CLIENT_STREAM_INIT)(HSM_CLIENT_HANDLE handle, const SIZED_BUFFER* identity, const SIZED_BUFFER* init_vector, HSM_CLIENT_STREAM_HANDLE* stream);
+
+/**
+* @brief    Feeds the next piece of input to a stream and returns any output it completes.
+*
+* @param handle                 A valid HSM client handle
+* @param stream                 A stream returned by ::HSM_CLIENT_STREAM_INIT
+* @param input                  The next piece of plaintext or cipher text
+* @param input_size             Size of the input in bytes
+* @param[out] output            Caller supplied output buffer, or NULL to query the size needed
+* @param[in,out] output_size    On input the size of output, on return the number of bytes
+*                               written, or which would be written when output is NULL.
+*
+* @note A call whose output buffer is too small fails without consuming any input
+* and sets output_size to the size needed. After any other failure the stream can
+* only be destroyed. Decrypted output is authenticated per chunk, the data as a whole
+* is only authentic once ::HSM_CLIENT_STREAM_FINAL succeeds.
+*
+* @return   Zero on success, nonzero otherwise
+*/
+typedef int (*HSM_CLIENT_STREAM_UPDATE)(HSM_CLIENT_HANDLE handle, HSM_CLIENT_STREAM_HANDLE stream, const unsigned char* input, size_t input_size, unsigned char* output, size_t* output_size);
+
+/**
+* @brief    Completes a stream and returns its remaining output.
+*
+* @param handle                 A valid HSM client handle
+* @param stream                 A stream returned by ::HSM_CLIENT_STREAM_INIT
+* @param[out] output            Caller supplied output buffer, or NULL to query the size needed
+* @param[in,out] output_size    As for ::HSM_CLIENT_STREAM_UPDATE
+*
+* @return   Zero on success, nonzero otherwise
+*/
+typedef int (*HSM_CLIENT_STREAM_FINAL)(HSM_CLIENT_HANDLE handle, HSM_CLIENT_STREAM_HANDLE stream, unsigned char* output, size_t* output_size);
+
+/**
+* @brief    Releases a stream returned by ::HSM_CLIENT_STREAM_INIT whether or not it completed.
+*
+* @param handle     A valid HSM client handle
+* @param stream     The stream to release
+*
+*/
+typedef void (*HSM_CLIENT_STREAM_DESTROY)(HSM_CLIENT_HANDLE handle, HSM_CLIENT_STREAM_HANDLE stream);
+
 /**
 * @brief    Retrieves the trusted certificate bundle used to authenticate the server.
 *
@@ -257,6 +424,25 @@ typedef int (*HSM_CLIENT_DECRYPT_DATA)(HSM_CLIENT_HANDLE handle, const SIZED_BUF
 */
 typedef CERT_INFO_HANDLE (*HSM_CLIENT_GET_TRUST_BUNDLE)(HSM_CLIENT_HANDLE handle);
 
+/**
+* Thread safety
+*
+* Once a handle has been returned by hsm_client_tpm_create or
+* hsm_client_crypto_create, all other functions of the TPM and crypto
+* interfaces may be called concurrently from multiple threads using the
+* same handle. In particular hsm_client_sign_with_identity,
+* hsm_client_derive_and_sign_with_identity, hsm_client_encrypt_data and
+* hsm_client_decrypt_data do not require any external synchronization.
+* A stream returned by hsm_client_encrypt_stream_init or
+* hsm_client_decrypt_stream_init must only be used by one thread at a time.
+*
+* The following must not be called concurrently with any other function
+* using the same handle:
+*   - hsm_client_tpm_destroy / hsm_client_crypto_destroy
+*   - hsm_client_tpm_init / hsm_client_tpm_deinit
+*   - hsm_client_crypto_init / hsm_client_crypto_deinit
+*   - hsm_client_x509_init / hsm_client_x509_deinit
+*/
 typedef struct HSM_CLIENT_TPM_INTERFACE_TAG
 {
     HSM_CLIENT_CREATE hsm_client_tpm_create;
@@ -268,6 +454,10 @@ typedef struct HSM_CLIENT_TPM_INTERFACE_TAG
     HSM_CLIENT_SIGN_WITH_IDENTITY hsm_client_sign_with_identity;
     HSM_CLIENT_DERIVE_AND_SIGN_WITH_IDENTITY hsm_client_derive_and_sign_with_identity;
     HSM_CLIENT_FREE_BUFFER hsm_client_free_buffer;
+    HSM_CLIENT_SIGN_WITH_IDENTITY_INTO hsm_client_sign_with_identity_into;
+    HSM_CLIENT_DERIVE_AND_SIGN_WITH_IDENTITY_INTO hsm_client_derive_and_sign_with_identity_into;
+    HSM_CLIENT_SIGN_BATCH hsm_client_sign_batch;
+    HSM_CLIENT_DERIVE_AND_SIGN_BATCH hsm_client_derive_and_sign_batch;
 } HSM_CLIENT_TPM_INTERFACE;
 
 typedef struct HSM_CLIENT_X509_INTERFACE_TAG
@@ -295,6 +485,12 @@ typedef struct HSM_CLIENT_CRYPTO_INTERFACE_TAG
     HSM_CLIENT_DECRYPT_DATA hsm_client_decrypt_data;
     HSM_CLIENT_GET_TRUST_BUNDLE hsm_client_get_trust_bundle;
     HSM_CLIENT_FREE_BUFFER hsm_client_free_buffer;
+    HSM_CLIENT_CREATE_CERTIFICATES hsm_client_create_certificates;
+    HSM_CLIENT_STREAM_INIT hsm_client_encrypt_stream_init;
+    HSM_CLIENT_STREAM_INIT hsm_client_decrypt_stream_init;
+    HSM_CLIENT_STREAM_UPDATE hsm_client_stream_update;
+    HSM_CLIENT_STREAM_FINAL hsm_client_stream_final;
+    HSM_CLIENT_STREAM_DESTROY hsm_client_stream_destroy;
 } HSM_CLIENT_CRYPTO_INTERFACE;
 
 extern const HSM_CLIENT_TPM_INTERFACE* hsm_client_tpm_interface();
@@ -10,6 +10,7 @@
 #include "azure_c_shared_utility/base64.h"
 #include "azure_c_shared_utility/buffer_.h"
 #include "azure_c_shared_utility/xlogging.h"
+#include "hsm_lock.h"
 
 typedef struct CERT_DATA_INFO_TAG
 {
@@ -26,6 +27,7 @@ typedef struct CERT_DATA_INFO_TAG
     const char* first_cert_start;
     const char* first_cert_end;
     char* first_certificate;
+    volatile long ref_count;
 } CERT_DATA_INFO;
 
 typedef enum X509_ASN1_STATE_TAG
@@ -493,16 +495,32 @@ static int parse_certificate(CERT_DATA_INFO* cert_info)
 }
 
 CERT_INFO_HANDLE certificate_info_create(const char* certificate, const void* private_key, size_t priv_key_len, PRIVATE_KEY_TYPE pk_type)
+{
+    CERT_INFO_HANDLE result;
+
+    if (certificate == NULL)
+    {
+        LogError("Invalid certificate parameter specified");
+        result = NULL;
+    }
+    else
+    {
+        result = certificate_info_create_from_buffer(certificate, strlen(certificate), private_key, priv_key_len, pk_type);
+    }
+    return result;
+}
+
+CERT_INFO_HANDLE certificate_info_create_from_buffer(const char* certificate, size_t certificate_size, const void* private_key, size_t priv_key_len, PRIVATE_KEY_TYPE pk_type)
 {
     CERT_DATA_INFO* result;
-    size_t cert_len;
+    size_t cert_len = certificate_size;
 
     if (certificate == NULL)
     {
         LogError("Invalid certificate parameter specified");
         result = NULL;
     }
-    else if ((cert_len = strlen(certificate)) == 0)
+    else if (cert_len == 0)
     {
         LogError("Empty certificate string provided");
         result = NULL;
@@ -536,6 +554,7 @@ CERT_INFO_HANDLE certificate_info_create(const char* certificate, const void* pr
     else
     {
         memset(result, 0, sizeof(CERT_DATA_INFO));
+        result->ref_count = 1;
 
         if (cert_len == 0 || (result->certificate_pem = malloc(cert_len + 1)) == NULL)
         {
@@ -594,10 +613,24 @@ CERT_INFO_HANDLE certificate_info_create(const char* certificate, const void* pr
     return result;
 }
 
+CERT_INFO_HANDLE certificate_info_clone(CERT_INFO_HANDLE handle)
+{
+    CERT_DATA_INFO* cert_info = (CERT_DATA_INFO*)handle;
+    if (cert_info == NULL)
+    {
+        LogError("Invalid parameter specified");
+    }
+    else
+    {
+        (void)hsm_atomic_increment(&cert_info->ref_count);
+    }
+    return cert_info;
+}
+
 void certificate_info_destroy(CERT_INFO_HANDLE handle)
 {
     CERT_DATA_INFO* cert_info = (CERT_DATA_INFO*)handle;
-    if (cert_info != NULL)
+    if ((cert_info != NULL) && (hsm_atomic_decrement(&cert_info->ref_count) == 0))
     {
         free(cert_info->first_certificate);
         free(cert_info->certificate_pem);
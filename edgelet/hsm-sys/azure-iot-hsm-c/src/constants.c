@@ -7,6 +7,13 @@ const char* const ENV_DEVICE_CA_PATH = "IOTEDGE_DEVICE_CA_CERT";
 const char* const ENV_DEVICE_PK_PATH = "IOTEDGE_DEVICE_CA_PK";
 const char* const ENV_TRUSTED_CA_CERTS_PATH = "IOTEDGE_TRUSTED_CA_CERTS";
 const char* const ENV_TPM_SELECT = "IOTEDGE_USE_TPM_DEVICE";
+const char* const ENV_HSM_PACKED_STORE = "IOTEDGE_HSM_PACKED_STORE";
+const char* const ENV_HSM_KEY_POOL_SIZE = "IOTEDGE_HSM_KEY_POOL_SIZE";
+const char* const ENV_HSM_CERT_RENEWAL_PERCENT = "IOTEDGE_HSM_CERT_RENEWAL_PERCENT";
+const char* const ENV_HSM_CERT_REUSE_PERCENT = "IOTEDGE_HSM_CERT_REUSE_PERCENT";
+const char* const ENV_HSM_HMAC_ENGINE = "IOTEDGE_HSM_HMAC_ENGINE";
+const char* const ENV_HSM_SIGN_CACHE_SIZE = "IOTEDGE_HSM_SIGN_CACHE_SIZE";
+const char* const ENV_HSM_SIGN_CACHE_TTL = "IOTEDGE_HSM_SIGN_CACHE_TTL_SECS";
 
 /* HSM directory name under IOTEDGE_HOMEDIR */
 const char* const DEFAULT_EDGE_HOME_DIR_UNIX = "/var/lib/iotedge"; // note MacOS is included
@@ -1,3 +1,4 @@
+#include <stdint.h>
 #include <stdlib.h>
 
 #include <openssl/evp.h>
@@ -5,7 +6,9 @@
 
 #include "azure_c_shared_utility/gballoc.h"
 #include "hsm_client_store.h"
+#include "hsm_lock.h"
 #include "hsm_log.h"
+#include "hsm_utils.h"
 #include "edge_openssl_common.h"
 
 //#################################################################################################
@@ -28,14 +31,80 @@
 #define CIPHER_VERSION_V1 1
 #define CIPHER_HEADER_SIZE_V1 ((CIPHER_VERSION_SIZE) + (CIPHER_TAG_SIZE_V1))
 
+//   V2 ciphertext layout
+//   0      1           5   OFFSET
+//   +--------------------+
+//   | VER | CHUNK SIZE   |  HEADER, chunk size in network byte order
+//   +--------------------+
+//   |  TAG  |  CHUNK 0   |  RECORD, CHUNK SIZE bytes of ciphertext
+//   +--------------------+
+//   |       ...          |
+//   +--------------------+
+//   |  TAG  |  CHUNK N   |  last RECORD, 0 to CHUNK SIZE bytes
+//   +--------------------+
+//
+//   Every record is sealed on its own, the IV is the one of the caller
+//   followed by the record index as 8 big endian bytes and a byte that is 1
+//   for the last record only, the identity and the header are the AAD.
+//   Records can therefore be neither reordered nor dropped and the
+//   ciphertext can not be cut short at a record boundary.
+
+#define CIPHER_VERSION_V2 2
+#define CIPHER_TAG_SIZE_V2 16
+#define CIPHER_HEADER_SIZE_V2 ((CIPHER_VERSION_SIZE) + 4)
+#define CIPHER_IV_SUFFIX_SIZE_V2 9
+// chunk size of the ciphertext produced by streams
+#define CIPHER_CHUNK_SIZE_V2 (64 * 1024)
+// largest chunk size accepted when decrypting, it bounds the memory of a stream
+#define CIPHER_MAX_CHUNK_SIZE_V2 (1024 * 1024)
+
+// number of keyed cipher contexts kept per key, callers beyond that many at
+// once use a context of their own for the duration of the call
+#define CIPHER_CTX_SLOTS 4
+
+// A context with the AES key schedule of its key already expanded, so that
+// an operation only has to set the IV. The slot belongs to the caller whose
+// increment moved in_use from 0 to 1.
+typedef struct CIPHER_CTX_SLOT_TAG
+{
+    volatile long in_use;
+    EVP_CIPHER_CTX *ctx;
+} CIPHER_CTX_SLOT;
+
 struct ENC_KEY_TAG
 {
     HSM_CLIENT_KEY_INTERFACE intf;
     unsigned char *key;
     size_t key_size;
+    CIPHER_CTX_SLOT ctx_slots[CIPHER_CTX_SLOTS];
 };
 typedef struct ENC_KEY_TAG ENC_KEY;
 
+typedef struct ENC_KEY_STREAM_TAG
+{
+    ENC_KEY *enc_key;
+    bool is_encrypt;
+    bool is_failed;
+    bool is_finished;
+    unsigned char *aad;
+    size_t aad_size;
+    // IV of the caller followed by the suffix of the current record
+    unsigned char *iv;
+    size_t iv_size;
+    uint64_t record_index;
+    // the header is prepared on init when encrypting and read from the
+    // ciphertext when decrypting, header_size is the number of bytes of it
+    // written or read so far
+    unsigned char header[CIPHER_HEADER_SIZE_V2];
+    size_t header_size;
+    size_t chunk_size;
+    // plaintext of the pending chunk when encrypting, the pending record when
+    // decrypting. It is only sealed or opened once more data follows or the
+    // stream is finished, which decides whether it is the last one.
+    unsigned char *buffer;
+    size_t buffer_size;
+} ENC_KEY_STREAM;
+
 //#################################################################################################
 // PKI key operations
 //#################################################################################################
@@ -93,13 +162,202 @@ int enc_key_derive_and_sign
     return __FAILURE__;
 }
 
+static int enc_key_sign_into
+(
+    KEY_HANDLE key_handle,
+    const unsigned char *data_to_be_signed,
+    size_t data_to_be_signed_size,
+    unsigned char *digest,
+    size_t *digest_size
+)
+{
+    (void)key_handle;
+    (void)data_to_be_signed;
+    (void)data_to_be_signed_size;
+    (void)digest;
+
+    LOG_ERROR("Sign for encryption keys is not supported");
+    if (digest_size != NULL)
+    {
+        *digest_size = 0;
+    }
+    return __FAILURE__;
+}
+
+static int enc_key_derive_and_sign_into
+(
+    KEY_HANDLE key_handle,
+    const unsigned char *data_to_be_signed,
+    size_t data_to_be_signed_size,
+    const unsigned char *identity,
+    size_t identity_size,
+    unsigned char *digest,
+    size_t *digest_size
+)
+{
+    (void)key_handle;
+    (void)data_to_be_signed;
+    (void)data_to_be_signed_size;
+    (void)identity;
+    (void)identity_size;
+    (void)digest;
+
+    LOG_ERROR("Derive and sign for encryption keys is not supported");
+    if (digest_size != NULL)
+    {
+        *digest_size = 0;
+    }
+    return __FAILURE__;
+}
+
+static int enc_key_sign_batch
+(
+    KEY_HANDLE key_handle,
+    const HSM_SIGN_REQUEST *requests,
+    size_t count,
+    unsigned char *digests,
+    size_t *digest_size
+)
+{
+    (void)key_handle;
+    (void)requests;
+    (void)count;
+    (void)digests;
+
+    LOG_ERROR("Batch sign for encryption keys is not supported");
+    if (digest_size != NULL)
+    {
+        *digest_size = 0;
+    }
+    return __FAILURE__;
+}
+
+static int enc_key_derive_and_sign_batch
+(
+    KEY_HANDLE key_handle,
+    const HSM_SIGN_REQUEST *requests,
+    size_t count,
+    unsigned char *digests,
+    size_t *digest_size
+)
+{
+    (void)key_handle;
+    (void)requests;
+    (void)count;
+    (void)digests;
+
+    LOG_ERROR("Batch derive and sign for encryption keys is not supported");
+    if (digest_size != NULL)
+    {
+        *digest_size = 0;
+    }
+    return __FAILURE__;
+}
+
+//#################################################################################################
+// Cipher contexts
+//#################################################################################################
+static EVP_CIPHER_CTX* create_cipher_ctx(const unsigned char *key)
+{
+    EVP_CIPHER_CTX *result;
+
+    if ((result = EVP_CIPHER_CTX_new()) == NULL)
+    {
+        LOG_ERROR("Could not create cipher context");
+    }
+    // GCM only runs the block cipher forward so the expanded key serves both
+    // directions, each operation selects its direction when setting the IV
+    else if (EVP_EncryptInit_ex(result, EVP_aes_256_gcm(), NULL, key, NULL) != 1)
+    {
+        LOG_ERROR("Could not initialize cipher context with key");
+        EVP_CIPHER_CTX_free(result);
+        result = NULL;
+    }
+
+    return result;
+}
+
+static EVP_CIPHER_CTX* acquire_cipher_ctx(ENC_KEY *enc_key, CIPHER_CTX_SLOT **slot)
+{
+    EVP_CIPHER_CTX *result;
+    size_t index;
+
+    *slot = NULL;
+    for (index = 0; (index < CIPHER_CTX_SLOTS) && (*slot == NULL); index++)
+    {
+        CIPHER_CTX_SLOT *candidate = &enc_key->ctx_slots[index];
+        if (hsm_atomic_increment(&candidate->in_use) == 1)
+        {
+            *slot = candidate;
+        }
+        else
+        {
+            (void)hsm_atomic_decrement(&candidate->in_use);
+        }
+    }
+
+    if ((*slot != NULL) && ((*slot)->ctx != NULL))
+    {
+        result = (*slot)->ctx;
+    }
+    else if ((result = create_cipher_ctx(enc_key->key)) == NULL)
+    {
+        if (*slot != NULL)
+        {
+            (void)hsm_atomic_decrement(&(*slot)->in_use);
+            *slot = NULL;
+        }
+    }
+    else if (*slot != NULL)
+    {
+        (*slot)->ctx = result;
+    }
+
+    return result;
+}
+
+// A context is only kept after a successful operation, one left in an
+// unknown state by a failure is freed.
+static void release_cipher_ctx(CIPHER_CTX_SLOT *slot, EVP_CIPHER_CTX *ctx, bool keep)
+{
+    if ((slot == NULL) || !keep)
+    {
+        EVP_CIPHER_CTX_free(ctx);
+        if (slot != NULL)
+        {
+            slot->ctx = NULL;
+        }
+    }
+    if (slot != NULL)
+    {
+        (void)hsm_atomic_decrement(&slot->in_use);
+    }
+}
+
+static void destroy_cipher_ctxs(ENC_KEY *enc_key)
+{
+    size_t index;
+
+    for (index = 0; index < CIPHER_CTX_SLOTS; index++)
+    {
+        if (enc_key->ctx_slots[index].ctx != NULL)
+        {
+            EVP_CIPHER_CTX_free(enc_key->ctx_slots[index].ctx);
+            enc_key->ctx_slots[index].ctx = NULL;
+        }
+    }
+}
+
+//#################################################################################################
+// Encrypt and decrypt
+//#################################################################################################
 static int encrypt_v1
 (
     const unsigned char *plaintext,
     int plaintext_len,
     const unsigned char *aad,
 	int aad_len,
-    const unsigned char *key,
+    ENC_KEY *enc_key,
     const unsigned char *iv,
     int iv_len,
     unsigned char **output_buffer,
@@ -108,6 +366,7 @@ static int encrypt_v1
 {
     size_t ciphertext_size = plaintext_len + CIPHER_HEADER_SIZE_V1;
     EVP_CIPHER_CTX *ctx;
+    CIPHER_CTX_SLOT *slot;
 	unsigned char *ciphertext_buffer;
     int result;
 
@@ -118,9 +377,9 @@ static int encrypt_v1
         LOG_ERROR("Could not allocate memory to encrypt data");
         result = __FAILURE__;
     }
-	else if ((ctx = EVP_CIPHER_CTX_new()) == NULL)
+	else if ((ctx = acquire_cipher_ctx(enc_key, &slot)) == NULL)
     {
-        LOG_ERROR("Could not create cipher context");
+        LOG_ERROR("Could not obtain cipher context");
         result = __FAILURE__;
     }
     else
@@ -132,19 +391,14 @@ static int encrypt_v1
 
         memset(ciphertext_buffer, 0, ciphertext_size);
         *version = CIPHER_VERSION_V1;
-        if (EVP_EncryptInit_ex(ctx, EVP_aes_256_gcm(), NULL, NULL, NULL) != 1)
-        {
-            LOG_ERROR("Could not initialize encrypt operation");
-            result = __FAILURE__;
-        }
-        else if(EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, iv_len, NULL) != 1) // set IV length EVP_CTRL_GCM_SET_IVLEN
+        if(EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, iv_len, NULL) != 1) // set IV length EVP_CTRL_GCM_SET_IVLEN
         {
             LOG_ERROR("Could not initialize IV length %d", iv_len);
             result = __FAILURE__;
         }
-        else if(EVP_EncryptInit_ex(ctx, NULL, NULL, key, iv) != 1) // Initialise key and IV
+        else if(EVP_EncryptInit_ex(ctx, NULL, NULL, NULL, iv) != 1) // Initialise IV, the key is already set
         {
-            LOG_ERROR("Could not initialize key and IV");
+            LOG_ERROR("Could not initialize IV");
             result = __FAILURE__;
         }
         else if (EVP_EncryptUpdate(ctx, NULL, &len, aad, aad_len) != 1) //Provide any AAD data.
@@ -183,7 +437,7 @@ static int encrypt_v1
                 }
             }
         }
-    	EVP_CIPHER_CTX_free(ctx);
+        release_cipher_ctx(slot, ctx, (result == 0));
     }
 
     if ((result != 0) && (ciphertext_buffer != NULL))
@@ -214,8 +468,7 @@ static bool validate_key_v1(unsigned char *key, size_t key_size)
 static int encrypt
 (
     unsigned char version,
-    unsigned char *key,
-    size_t key_size,
+    ENC_KEY *enc_key,
     const SIZED_BUFFER *identity,
     const SIZED_BUFFER *plaintext,
     const SIZED_BUFFER *initialization_vector,
@@ -227,7 +480,7 @@ static int encrypt
     initialize_openssl();
     if (version == CIPHER_VERSION_V1)
     {
-        if (!validate_key_v1(key, key_size))
+        if (!validate_key_v1(enc_key->key, enc_key->key_size))
         {
             LOG_ERROR("Encryption key is invalid");
             result = __FAILURE__;
@@ -244,7 +497,7 @@ static int encrypt
                                 (int)plaintext->size,
                                 identity->buffer,
                                 (int)identity->size,
-                                key,
+                                enc_key,
                                 initialization_vector->buffer,
                                 (int)initialization_vector->size,
                                 &ciphertext->buffer,
@@ -266,7 +519,7 @@ static int decrypt_v1
     int ciphertext_buffer_size,
     const unsigned char *aad,
 	int aad_len,
-    const unsigned char *key,
+    ENC_KEY *enc_key,
     const unsigned char *iv,
     int iv_len,
     unsigned char **output_buffer,
@@ -276,6 +529,7 @@ static int decrypt_v1
 	unsigned char *plaintext_buffer;
     int result;
     EVP_CIPHER_CTX *ctx;
+    CIPHER_CTX_SLOT *slot;
     size_t plaintext_buffer_size = ciphertext_buffer_size;
 
     *output_size = 0;
@@ -285,9 +539,9 @@ static int decrypt_v1
         LOG_ERROR("Could not allocate memory to decrypt data");
         result = __FAILURE__;
     }
-	else if ((ctx = EVP_CIPHER_CTX_new()) == NULL)
+	else if ((ctx = acquire_cipher_ctx(enc_key, &slot)) == NULL)
     {
-        LOG_ERROR("Could not create cipher context");
+        LOG_ERROR("Could not obtain cipher context");
         result = __FAILURE__;
     }
     else
@@ -300,19 +554,14 @@ static int decrypt_v1
 
         memset(plaintext_buffer, 0, plaintext_buffer_size);
         memcpy(tag, tag_start, CIPHER_TAG_SIZE_V1);
-        if (EVP_DecryptInit_ex(ctx, EVP_aes_256_gcm(), NULL, NULL, NULL) != 1)
-        {
-            LOG_ERROR("Could not initialize decrypt operation");
-            result = __FAILURE__;
-        }
-        else if(EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, iv_len, NULL) != 1) // set IV length EVP_CTRL_GCM_SET_IVLEN
+        if(EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, iv_len, NULL) != 1) // set IV length EVP_CTRL_GCM_SET_IVLEN
         {
             LOG_ERROR("Could not initialize IV length %d", iv_len);
             result = __FAILURE__;
         }
-        else if(EVP_DecryptInit_ex(ctx, NULL, NULL, key, iv) != 1) // Initialise key and IV
+        else if(EVP_DecryptInit_ex(ctx, NULL, NULL, NULL, iv) != 1) // Initialise IV, the key is already set
         {
-            LOG_ERROR("Could not initialize key and IV");
+            LOG_ERROR("Could not initialize IV");
             result = __FAILURE__;
         }
         else if (EVP_DecryptUpdate(ctx, NULL, &len, aad, aad_len) != 1) //Provide any AAD data.
@@ -349,7 +598,7 @@ static int decrypt_v1
                 }
             }
         }
-    	EVP_CIPHER_CTX_free(ctx);
+        release_cipher_ctx(slot, ctx, (result == 0));
     }
 
     if ((result != 0) && (plaintext_buffer != NULL))
@@ -361,43 +610,859 @@ static int decrypt_v1
 	return result;
 }
 
-static int decrypt
+//#################################################################################################
+// Chunked encrypt and decrypt streams
+//#################################################################################################
+static void write_header_v2(unsigned char *header, size_t chunk_size)
+{
+    header[0] = CIPHER_VERSION_V2;
+    header[1] = (unsigned char)((chunk_size >> 24) & 0xFF);
+    header[2] = (unsigned char)((chunk_size >> 16) & 0xFF);
+    header[3] = (unsigned char)((chunk_size >> 8) & 0xFF);
+    header[4] = (unsigned char)(chunk_size & 0xFF);
+}
+
+static int read_header_v2(const unsigned char *header, size_t *chunk_size)
+{
+    int result;
+    size_t size = ((size_t)header[1] << 24) | ((size_t)header[2] << 16) |
+                  ((size_t)header[3] << 8) | (size_t)header[4];
+
+    if (header[0] != CIPHER_VERSION_V2)
+    {
+        LOG_ERROR("Unsupported encryption version %d", header[0]);
+        result = __FAILURE__;
+    }
+    else if ((size == 0) || (size > CIPHER_MAX_CHUNK_SIZE_V2))
+    {
+        LOG_ERROR("Invalid ciphertext chunk size %zu", size);
+        result = __FAILURE__;
+    }
+    else
+    {
+        *chunk_size = size;
+        result = 0;
+    }
+
+    return result;
+}
+
+static void set_record_iv_v2(ENC_KEY_STREAM *stream, bool is_last)
+{
+    unsigned char *suffix = stream->iv + stream->iv_size - CIPHER_IV_SUFFIX_SIZE_V2;
+    uint64_t index = stream->record_index;
+    int pos;
+
+    for (pos = 7; pos >= 0; pos--)
+    {
+        suffix[pos] = (unsigned char)(index & 0xFF);
+        index >>= 8;
+    }
+    suffix[8] = is_last ? 1 : 0;
+}
+
+static int seal_record_v2
 (
-    unsigned char version,
-    unsigned char *key,
-    size_t key_size,
-    const SIZED_BUFFER *identity,
-    const SIZED_BUFFER *ciphertext,
-    const SIZED_BUFFER *initialization_vector,
-    SIZED_BUFFER *plaintext
+    ENC_KEY_STREAM *stream,
+    const unsigned char *chunk,
+    size_t chunk_size,
+    bool is_last,
+    unsigned char *record
 )
 {
     int result;
-    initialize_openssl();
-    if (version == CIPHER_VERSION_V1)
+    EVP_CIPHER_CTX *ctx;
+    CIPHER_CTX_SLOT *slot;
+
+    set_record_iv_v2(stream, is_last);
+    if ((ctx = acquire_cipher_ctx(stream->enc_key, &slot)) == NULL)
+    {
+        LOG_ERROR("Could not obtain cipher context");
+        result = __FAILURE__;
+    }
+    else
     {
-        if (!validate_key_v1(key, key_size))
+        int len;
+        int ciphertext_len = 0;
+        unsigned char *tag = record;
+        unsigned char *ciphertext = record + CIPHER_TAG_SIZE_V2;
+
+        if (EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, (int)stream->iv_size, NULL) != 1)
         {
-            LOG_ERROR("Encryption key is invalid");
+            LOG_ERROR("Could not initialize IV length %zu", stream->iv_size);
             result = __FAILURE__;
         }
-        else if (ciphertext->size <= CIPHER_HEADER_SIZE_V1)
+        else if (EVP_EncryptInit_ex(ctx, NULL, NULL, NULL, stream->iv) != 1)
         {
-            LOG_ERROR("Ciphertext buffer incorrect size %lu", ciphertext->size);
+            LOG_ERROR("Could not initialize IV");
+            result = __FAILURE__;
+        }
+        else if ((EVP_EncryptUpdate(ctx, NULL, &len, stream->aad, (int)stream->aad_size) != 1) ||
+                 (EVP_EncryptUpdate(ctx, NULL, &len, stream->header, CIPHER_HEADER_SIZE_V2) != 1))
+        {
+            LOG_ERROR("Could not associate AAD information to encrypt operation");
+            result = __FAILURE__;
+        }
+        // an empty last record has no data to process
+        else if ((chunk_size != 0) &&
+                 (EVP_EncryptUpdate(ctx, ciphertext, &ciphertext_len, chunk, (int)chunk_size) != 1))
+        {
+            LOG_ERROR("Could not encrypt plaintext");
+            result = __FAILURE__;
+        }
+        else if (EVP_EncryptFinal_ex(ctx, ciphertext + ciphertext_len, &len) != 1)
+        {
+            LOG_ERROR("Could not encrypt plaintext");
+            result = __FAILURE__;
+        }
+        else if (EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, CIPHER_TAG_SIZE_V2, tag) != 1)
+        {
+            LOG_ERROR("Could not obtain tag");
             result = __FAILURE__;
         }
         else
         {
-            // default decrypt version
-            result = decrypt_v1(ciphertext->buffer,
-                                (int)ciphertext->size,
-                                identity->buffer,
-                                (int)identity->size,
-                                key,
-                                initialization_vector->buffer,
-                                (int)initialization_vector->size,
-                                &plaintext->buffer,
-                                &plaintext->size);
+            stream->record_index++;
+            result = 0;
+        }
+        release_cipher_ctx(slot, ctx, (result == 0));
+    }
+
+    return result;
+}
+
+static int open_record_v2
+(
+    ENC_KEY_STREAM *stream,
+    const unsigned char *record,
+    size_t record_size,
+    bool is_last,
+    unsigned char *chunk
+)
+{
+    int result;
+    EVP_CIPHER_CTX *ctx;
+    CIPHER_CTX_SLOT *slot;
+    size_t chunk_size = record_size - CIPHER_TAG_SIZE_V2;
+
+    set_record_iv_v2(stream, is_last);
+    if ((ctx = acquire_cipher_ctx(stream->enc_key, &slot)) == NULL)
+    {
+        LOG_ERROR("Could not obtain cipher context");
+        result = __FAILURE__;
+    }
+    else
+    {
+        int len;
+        int plaintext_len = 0;
+        unsigned char tag[CIPHER_TAG_SIZE_V2];
+        const unsigned char *ciphertext = record + CIPHER_TAG_SIZE_V2;
+
+        memcpy(tag, record, CIPHER_TAG_SIZE_V2);
+        if (EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, (int)stream->iv_size, NULL) != 1)
+        {
+            LOG_ERROR("Could not initialize IV length %zu", stream->iv_size);
+            result = __FAILURE__;
+        }
+        else if (EVP_DecryptInit_ex(ctx, NULL, NULL, NULL, stream->iv) != 1)
+        {
+            LOG_ERROR("Could not initialize IV");
+            result = __FAILURE__;
+        }
+        else if ((EVP_DecryptUpdate(ctx, NULL, &len, stream->aad, (int)stream->aad_size) != 1) ||
+                 (EVP_DecryptUpdate(ctx, NULL, &len, stream->header, CIPHER_HEADER_SIZE_V2) != 1))
+        {
+            LOG_ERROR("Could not associate AAD information to decrypt operation");
+            result = __FAILURE__;
+        }
+        else if ((chunk_size != 0) &&
+                 (EVP_DecryptUpdate(ctx, chunk, &plaintext_len, ciphertext, (int)chunk_size) != 1))
+        {
+            LOG_ERROR("Could not decrypt ciphertext");
+            result = __FAILURE__;
+        }
+        else if (EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, CIPHER_TAG_SIZE_V2, tag) != 1)
+        {
+            LOG_ERROR("Could not set verification tag");
+            result = __FAILURE__;
+        }
+        else if (EVP_DecryptFinal_ex(ctx, chunk + plaintext_len, &len) <= 0)
+        {
+            LOG_ERROR("Verification of ciphertext record %llu failed", (unsigned long long)stream->record_index);
+            result = __FAILURE__;
+        }
+        else
+        {
+            stream->record_index++;
+            result = 0;
+        }
+        release_cipher_ctx(slot, ctx, (result == 0));
+
+        if ((result != 0) && (chunk_size != 0))
+        {
+            secure_zero(chunk, chunk_size);
+        }
+    }
+
+    return result;
+}
+
+static size_t min_size(size_t a, size_t b)
+{
+    return (a < b) ? a : b;
+}
+
+// Number of whole records the pending data completes, the data of a record is
+// only processed once more data follows it.
+static size_t complete_records(size_t pending_size, size_t record_size)
+{
+    return (pending_size == 0) ? 0 : ((pending_size - 1) / record_size);
+}
+
+static size_t encrypt_update_size_v2(const ENC_KEY_STREAM *stream, size_t input_size)
+{
+    size_t records = complete_records(stream->buffer_size + input_size, stream->chunk_size);
+
+    return (CIPHER_HEADER_SIZE_V2 - stream->header_size) +
+           (records * (CIPHER_TAG_SIZE_V2 + stream->chunk_size));
+}
+
+static int encrypt_update_v2
+(
+    ENC_KEY_STREAM *stream,
+    const unsigned char *input,
+    size_t input_size,
+    unsigned char *output
+)
+{
+    int result = 0;
+    size_t record_size = CIPHER_TAG_SIZE_V2 + stream->chunk_size;
+    size_t header_size = CIPHER_HEADER_SIZE_V2 - stream->header_size;
+
+    memcpy(output, stream->header, header_size);
+    output += header_size;
+    stream->header_size = CIPHER_HEADER_SIZE_V2;
+    while ((result == 0) && (input_size > 0))
+    {
+        if (stream->buffer_size == stream->chunk_size)
+        {
+            // more data follows so the pending chunk is not the last one
+            if ((result = seal_record_v2(stream, stream->buffer, stream->chunk_size, false, output)) == 0)
+            {
+                output += record_size;
+                stream->buffer_size = 0;
+            }
+        }
+        else if ((stream->buffer_size == 0) && (input_size > stream->chunk_size))
+        {
+            if ((result = seal_record_v2(stream, input, stream->chunk_size, false, output)) == 0)
+            {
+                output += record_size;
+                input += stream->chunk_size;
+                input_size -= stream->chunk_size;
+            }
+        }
+        else
+        {
+            size_t count = min_size(stream->chunk_size - stream->buffer_size, input_size);
+            memcpy(stream->buffer + stream->buffer_size, input, count);
+            stream->buffer_size += count;
+            input += count;
+            input_size -= count;
+        }
+    }
+
+    return result;
+}
+
+static size_t encrypt_final_size_v2(const ENC_KEY_STREAM *stream)
+{
+    return (CIPHER_HEADER_SIZE_V2 - stream->header_size) + CIPHER_TAG_SIZE_V2 + stream->buffer_size;
+}
+
+static int encrypt_final_v2(ENC_KEY_STREAM *stream, unsigned char *output)
+{
+    int result;
+    size_t header_size = CIPHER_HEADER_SIZE_V2 - stream->header_size;
+
+    memcpy(output, stream->header, header_size);
+    stream->header_size = CIPHER_HEADER_SIZE_V2;
+    result = seal_record_v2(stream, stream->buffer, stream->buffer_size, true, output + header_size);
+    secure_zero(stream->buffer, stream->buffer_size);
+    stream->buffer_size = 0;
+
+    return result;
+}
+
+// The plaintext decrypting input produces depends on the chunk size, which is
+// read from a header that may only partly be in input.
+static int decrypt_update_size_v2
+(
+    const ENC_KEY_STREAM *stream,
+    const unsigned char *input,
+    size_t input_size,
+    size_t *output_size
+)
+{
+    int result;
+    unsigned char header[CIPHER_HEADER_SIZE_V2];
+    size_t header_size = stream->header_size;
+    size_t count = min_size(CIPHER_HEADER_SIZE_V2 - header_size, input_size);
+    size_t chunk_size;
+
+    memcpy(header, stream->header, header_size);
+    memcpy(header + header_size, input, count);
+    header_size += count;
+    input_size -= count;
+    if (header_size < CIPHER_HEADER_SIZE_V2)
+    {
+        *output_size = 0;
+        result = 0;
+    }
+    else if ((result = read_header_v2(header, &chunk_size)) == 0)
+    {
+        size_t records = complete_records(stream->buffer_size + input_size,
+                                          CIPHER_TAG_SIZE_V2 + chunk_size);
+        *output_size = records * chunk_size;
+    }
+
+    return result;
+}
+
+static int decrypt_update_v2
+(
+    ENC_KEY_STREAM *stream,
+    const unsigned char *input,
+    size_t input_size,
+    unsigned char *output
+)
+{
+    int result = 0;
+    unsigned char *out = output;
+    size_t count = min_size(CIPHER_HEADER_SIZE_V2 - stream->header_size, input_size);
+
+    memcpy(stream->header + stream->header_size, input, count);
+    stream->header_size += count;
+    input += count;
+    input_size -= count;
+    if ((stream->header_size == CIPHER_HEADER_SIZE_V2) && (stream->buffer == NULL))
+    {
+        if (read_header_v2(stream->header, &stream->chunk_size) != 0)
+        {
+            result = __FAILURE__;
+        }
+        else if ((stream->buffer = (unsigned char*)malloc(CIPHER_TAG_SIZE_V2 + stream->chunk_size)) == NULL)
+        {
+            LOG_ERROR("Could not allocate memory for ciphertext record");
+            result = __FAILURE__;
+        }
+    }
+    while ((result == 0) && (input_size > 0))
+    {
+        size_t record_size = CIPHER_TAG_SIZE_V2 + stream->chunk_size;
+        if (stream->buffer_size == record_size)
+        {
+            // more data follows so the pending record is not the last one
+            if ((result = open_record_v2(stream, stream->buffer, record_size, false, out)) == 0)
+            {
+                out += stream->chunk_size;
+                stream->buffer_size = 0;
+            }
+        }
+        else if ((stream->buffer_size == 0) && (input_size > record_size))
+        {
+            if ((result = open_record_v2(stream, input, record_size, false, out)) == 0)
+            {
+                out += stream->chunk_size;
+                input += record_size;
+                input_size -= record_size;
+            }
+        }
+        else
+        {
+            count = min_size(record_size - stream->buffer_size, input_size);
+            memcpy(stream->buffer + stream->buffer_size, input, count);
+            stream->buffer_size += count;
+            input += count;
+            input_size -= count;
+        }
+    }
+
+    if (result != 0)
+    {
+        // the caller is told there is no output, do not leave any plaintext behind
+        secure_zero(output, (size_t)(out - output));
+    }
+
+    return result;
+}
+
+static int decrypt_final_size_v2(const ENC_KEY_STREAM *stream, size_t *output_size)
+{
+    int result;
+
+    if ((stream->header_size < CIPHER_HEADER_SIZE_V2) || (stream->buffer_size < CIPHER_TAG_SIZE_V2))
+    {
+        LOG_ERROR("Ciphertext is truncated");
+        result = __FAILURE__;
+    }
+    else
+    {
+        *output_size = stream->buffer_size - CIPHER_TAG_SIZE_V2;
+        result = 0;
+    }
+
+    return result;
+}
+
+static int decrypt_final_v2(ENC_KEY_STREAM *stream, unsigned char *output)
+{
+    int result = open_record_v2(stream, stream->buffer, stream->buffer_size, true, output);
+
+    stream->buffer_size = 0;
+
+    return result;
+}
+
+static void destroy_stream(ENC_KEY_STREAM *stream)
+{
+    if (stream->buffer != NULL)
+    {
+        secure_zero(stream->buffer, stream->is_encrypt ?
+                    stream->chunk_size : (CIPHER_TAG_SIZE_V2 + stream->chunk_size));
+        free(stream->buffer);
+    }
+    if (stream->aad != NULL)
+    {
+        free(stream->aad);
+    }
+    if (stream->iv != NULL)
+    {
+        free(stream->iv);
+    }
+    free(stream);
+}
+
+static int enc_key_stream_init
+(
+    bool is_encrypt,
+    KEY_HANDLE key_handle,
+    const SIZED_BUFFER *identity,
+    const SIZED_BUFFER *initialization_vector,
+    KEY_STREAM_HANDLE *stream
+)
+{
+    int result;
+    ENC_KEY *enc_key = (ENC_KEY*)key_handle;
+
+    if (stream == NULL)
+    {
+        LOG_ERROR("Invalid stream parameter");
+        result = __FAILURE__;
+    }
+    else
+    {
+        ENC_KEY_STREAM *enc_stream;
+
+        *stream = NULL;
+        if ((enc_key == NULL) || !validate_key_v1(enc_key->key, enc_key->key_size))
+        {
+            LOG_ERROR("Encryption key is invalid");
+            result = __FAILURE__;
+        }
+        else if ((identity == NULL) || (identity->buffer == NULL) ||
+                 (identity->size == 0) || (identity->size > INT_MAX))
+        {
+            LOG_ERROR("Invalid identity parameter");
+            result = __FAILURE__;
+        }
+        else if ((initialization_vector == NULL) || (initialization_vector->buffer == NULL) ||
+                 (initialization_vector->size == 0) ||
+                 (initialization_vector->size > (INT_MAX - CIPHER_IV_SUFFIX_SIZE_V2)))
+        {
+            LOG_ERROR("Invalid initialization vector parameter");
+            result = __FAILURE__;
+        }
+        else if ((enc_stream = (ENC_KEY_STREAM*)malloc(sizeof(ENC_KEY_STREAM))) == NULL)
+        {
+            LOG_ERROR("Could not allocate memory for encryption stream");
+            result = __FAILURE__;
+        }
+        else
+        {
+            memset(enc_stream, 0, sizeof(ENC_KEY_STREAM));
+            enc_stream->enc_key = enc_key;
+            enc_stream->is_encrypt = is_encrypt;
+            enc_stream->aad_size = identity->size;
+            enc_stream->iv_size = initialization_vector->size + CIPHER_IV_SUFFIX_SIZE_V2;
+            if (((enc_stream->aad = (unsigned char*)malloc(enc_stream->aad_size)) == NULL) ||
+                ((enc_stream->iv = (unsigned char*)malloc(enc_stream->iv_size)) == NULL))
+            {
+                LOG_ERROR("Could not allocate memory for encryption stream parameters");
+                result = __FAILURE__;
+            }
+            else if (is_encrypt &&
+                     ((enc_stream->buffer = (unsigned char*)malloc(CIPHER_CHUNK_SIZE_V2)) == NULL))
+            {
+                LOG_ERROR("Could not allocate memory for plaintext chunk");
+                result = __FAILURE__;
+            }
+            else
+            {
+                memcpy(enc_stream->aad, identity->buffer, identity->size);
+                memcpy(enc_stream->iv, initialization_vector->buffer, initialization_vector->size);
+                if (is_encrypt)
+                {
+                    enc_stream->chunk_size = CIPHER_CHUNK_SIZE_V2;
+                    write_header_v2(enc_stream->header, CIPHER_CHUNK_SIZE_V2);
+                }
+                initialize_openssl();
+                *stream = (KEY_STREAM_HANDLE)enc_stream;
+                result = 0;
+            }
+
+            if (result != 0)
+            {
+                destroy_stream(enc_stream);
+            }
+        }
+    }
+
+    return result;
+}
+
+static int enc_key_encrypt_init
+(
+    KEY_HANDLE key_handle,
+    const SIZED_BUFFER *identity,
+    const SIZED_BUFFER *initialization_vector,
+    KEY_STREAM_HANDLE *stream
+)
+{
+    return enc_key_stream_init(true, key_handle, identity, initialization_vector, stream);
+}
+
+static int enc_key_decrypt_init
+(
+    KEY_HANDLE key_handle,
+    const SIZED_BUFFER *identity,
+    const SIZED_BUFFER *initialization_vector,
+    KEY_STREAM_HANDLE *stream
+)
+{
+    return enc_key_stream_init(false, key_handle, identity, initialization_vector, stream);
+}
+
+static bool validate_stream(const ENC_KEY_STREAM *stream, KEY_HANDLE key_handle)
+{
+    bool result;
+
+    if ((stream == NULL) || (stream->enc_key != (ENC_KEY*)key_handle))
+    {
+        LOG_ERROR("Invalid stream for this key");
+        result = false;
+    }
+    else if (stream->is_failed)
+    {
+        LOG_ERROR("Stream failed earlier and can only be destroyed");
+        result = false;
+    }
+    else if (stream->is_finished)
+    {
+        LOG_ERROR("Stream is already finished");
+        result = false;
+    }
+    else
+    {
+        result = true;
+    }
+
+    return result;
+}
+
+static int stream_update_size
+(
+    const ENC_KEY_STREAM *stream,
+    const unsigned char *input,
+    size_t input_size,
+    size_t *output_size
+)
+{
+    int result;
+
+    if (stream->is_encrypt)
+    {
+        *output_size = encrypt_update_size_v2(stream, input_size);
+        result = 0;
+    }
+    else
+    {
+        result = decrypt_update_size_v2(stream, input, input_size, output_size);
+    }
+
+    return result;
+}
+
+static int stream_final_size(const ENC_KEY_STREAM *stream, size_t *output_size)
+{
+    int result;
+
+    if (stream->is_encrypt)
+    {
+        *output_size = encrypt_final_size_v2(stream);
+        result = 0;
+    }
+    else
+    {
+        result = decrypt_final_size_v2(stream, output_size);
+    }
+
+    return result;
+}
+
+static int enc_key_stream_update
+(
+    KEY_HANDLE key_handle,
+    KEY_STREAM_HANDLE stream,
+    const unsigned char *input,
+    size_t input_size,
+    unsigned char *output,
+    size_t *output_size
+)
+{
+    int result;
+    size_t needed = 0;
+    ENC_KEY_STREAM *enc_stream = (ENC_KEY_STREAM*)stream;
+
+    if (output_size == NULL)
+    {
+        LOG_ERROR("Invalid output size parameter");
+        result = __FAILURE__;
+    }
+    else if (!validate_stream(enc_stream, key_handle))
+    {
+        *output_size = 0;
+        result = __FAILURE__;
+    }
+    else if (((input == NULL) && (input_size != 0)) || (input_size > INT_MAX))
+    {
+        LOG_ERROR("Invalid input of size %zu", input_size);
+        *output_size = 0;
+        result = __FAILURE__;
+    }
+    else if (stream_update_size(enc_stream, input, input_size, &needed) != 0)
+    {
+        LOG_ERROR("Invalid ciphertext header");
+        enc_stream->is_failed = true;
+        *output_size = 0;
+        result = __FAILURE__;
+    }
+    else if (output == NULL)
+    {
+        *output_size = needed;
+        result = 0;
+    }
+    else if (*output_size < needed)
+    {
+        LOG_ERROR("Output buffer of size %zu is too small, %zu bytes needed", *output_size, needed);
+        *output_size = needed;
+        result = __FAILURE__;
+    }
+    else if ((enc_stream->is_encrypt ?
+              encrypt_update_v2(enc_stream, input, input_size, output) :
+              decrypt_update_v2(enc_stream, input, input_size, output)) != 0)
+    {
+        LOG_ERROR("Could not process stream input");
+        enc_stream->is_failed = true;
+        *output_size = 0;
+        result = __FAILURE__;
+    }
+    else
+    {
+        *output_size = needed;
+        result = 0;
+    }
+
+    return result;
+}
+
+static int enc_key_stream_final
+(
+    KEY_HANDLE key_handle,
+    KEY_STREAM_HANDLE stream,
+    unsigned char *output,
+    size_t *output_size
+)
+{
+    int result;
+    size_t needed = 0;
+    ENC_KEY_STREAM *enc_stream = (ENC_KEY_STREAM*)stream;
+
+    if (output_size == NULL)
+    {
+        LOG_ERROR("Invalid output size parameter");
+        result = __FAILURE__;
+    }
+    else if (!validate_stream(enc_stream, key_handle))
+    {
+        *output_size = 0;
+        result = __FAILURE__;
+    }
+    else if (stream_final_size(enc_stream, &needed) != 0)
+    {
+        enc_stream->is_failed = true;
+        *output_size = 0;
+        result = __FAILURE__;
+    }
+    else if (output == NULL)
+    {
+        *output_size = needed;
+        result = 0;
+    }
+    else if (*output_size < needed)
+    {
+        LOG_ERROR("Output buffer of size %zu is too small, %zu bytes needed", *output_size, needed);
+        *output_size = needed;
+        result = __FAILURE__;
+    }
+    else if ((enc_stream->is_encrypt ?
+              encrypt_final_v2(enc_stream, output) :
+              decrypt_final_v2(enc_stream, output)) != 0)
+    {
+        LOG_ERROR("Could not process last stream record");
+        enc_stream->is_failed = true;
+        *output_size = 0;
+        result = __FAILURE__;
+    }
+    else
+    {
+        enc_stream->is_finished = true;
+        *output_size = needed;
+        result = 0;
+    }
+
+    return result;
+}
+
+static void enc_key_stream_destroy(KEY_HANDLE key_handle, KEY_STREAM_HANDLE stream)
+{
+    (void)key_handle;
+
+    if (stream != NULL)
+    {
+        destroy_stream((ENC_KEY_STREAM*)stream);
+    }
+}
+
+// One shot decryption of V2 ciphertext, which is always larger than its plaintext
+static int decrypt_v2
+(
+    ENC_KEY *enc_key,
+    const SIZED_BUFFER *identity,
+    const SIZED_BUFFER *ciphertext,
+    const SIZED_BUFFER *initialization_vector,
+    SIZED_BUFFER *plaintext
+)
+{
+    int result;
+    KEY_STREAM_HANDLE stream = NULL;
+    unsigned char *plaintext_buffer;
+    size_t update_size = ciphertext->size;
+    size_t final_size = 0;
+
+    if ((plaintext_buffer = (unsigned char*)malloc(ciphertext->size)) == NULL)
+    {
+        LOG_ERROR("Could not allocate memory to decrypt data");
+        result = __FAILURE__;
+    }
+    else if (enc_key_decrypt_init(enc_key, identity, initialization_vector, &stream) != 0)
+    {
+        LOG_ERROR("Could not initialize decrypt stream");
+        result = __FAILURE__;
+    }
+    else if (enc_key_stream_update(enc_key, stream, ciphertext->buffer, ciphertext->size,
+                                   plaintext_buffer, &update_size) != 0)
+    {
+        LOG_ERROR("Could not decrypt ciphertext");
+        result = __FAILURE__;
+    }
+    else
+    {
+        final_size = ciphertext->size - update_size;
+        if (enc_key_stream_final(enc_key, stream, plaintext_buffer + update_size, &final_size) != 0)
+        {
+            LOG_ERROR("Could not decrypt ciphertext");
+            secure_zero(plaintext_buffer, update_size);
+            result = __FAILURE__;
+        }
+        else
+        {
+            plaintext->buffer = plaintext_buffer;
+            plaintext->size = update_size + final_size;
+            result = 0;
+        }
+    }
+
+    if (stream != NULL)
+    {
+        enc_key_stream_destroy(enc_key, stream);
+    }
+    if ((result != 0) && (plaintext_buffer != NULL))
+    {
+        free(plaintext_buffer);
+    }
+
+    return result;
+}
+
+static int decrypt
+(
+    unsigned char version,
+    ENC_KEY *enc_key,
+    const SIZED_BUFFER *identity,
+    const SIZED_BUFFER *ciphertext,
+    const SIZED_BUFFER *initialization_vector,
+    SIZED_BUFFER *plaintext
+)
+{
+    int result;
+    initialize_openssl();
+    if (version == CIPHER_VERSION_V1)
+    {
+        if (!validate_key_v1(enc_key->key, enc_key->key_size))
+        {
+            LOG_ERROR("Encryption key is invalid");
+            result = __FAILURE__;
+        }
+        else if (ciphertext->size <= CIPHER_HEADER_SIZE_V1)
+        {
+            LOG_ERROR("Ciphertext buffer incorrect size %lu", ciphertext->size);
+            result = __FAILURE__;
+        }
+        else
+        {
+            // default decrypt version
+            result = decrypt_v1(ciphertext->buffer,
+                                (int)ciphertext->size,
+                                identity->buffer,
+                                (int)identity->size,
+                                enc_key,
+                                initialization_vector->buffer,
+                                (int)initialization_vector->size,
+                                &plaintext->buffer,
+                                &plaintext->size);
+        }
+    }
+    else if (version == CIPHER_VERSION_V2)
+    {
+        if (ciphertext->size < (CIPHER_HEADER_SIZE_V2 + CIPHER_TAG_SIZE_V2))
+        {
+            LOG_ERROR("Ciphertext buffer incorrect size %lu", ciphertext->size);
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = decrypt_v2(enc_key, identity, ciphertext, initialization_vector, plaintext);
         }
     }
     else
@@ -459,8 +1524,7 @@ static int enc_key_encrypt
             ENC_KEY *enc_key = (ENC_KEY*)key_handle;
             // default encryption impl version 1
             result = encrypt(CIPHER_VERSION_V1,
-                             enc_key->key,
-                             enc_key->key_size,
+                             enc_key,
                              identity,
                              plaintext,
                              initialization_vector,
@@ -485,7 +1549,7 @@ static bool validate_input_ciphertext_buffer(const SIZED_BUFFER *sb, unsigned ch
         LOG_ERROR("Ciphertext has invalid size %lu", sb->size);
         result = false;
     }
-    else if (sb->buffer[0] != CIPHER_VERSION_V1)
+    else if ((sb->buffer[0] != CIPHER_VERSION_V1) && (sb->buffer[0] != CIPHER_VERSION_V2))
     {
         LOG_ERROR("Unsupported encryption version %c", sb->buffer[0]);
         result = false;
@@ -531,8 +1595,7 @@ static int enc_key_decrypt
         {
             ENC_KEY *enc_key = (ENC_KEY*)key_handle;
             result = decrypt(version,
-                             enc_key->key,
-                             enc_key->key_size,
+                             enc_key,
                              identity,
                              ciphertext,
                              initialization_vector,
@@ -549,6 +1612,7 @@ static void enc_key_destroy(KEY_HANDLE key_handle)
 
     if (enc_key != NULL)
     {
+        destroy_cipher_ctxs(enc_key);
         if (enc_key->key != NULL)
         {
             free(enc_key->key);
@@ -586,8 +1650,18 @@ KEY_HANDLE create_encryption_key(const unsigned char *key, size_t key_size)
             enc_key->intf.hsm_client_key_encrypt = enc_key_encrypt;
             enc_key->intf.hsm_client_key_decrypt = enc_key_decrypt;
             enc_key->intf.hsm_client_key_destroy = enc_key_destroy;
+            enc_key->intf.hsm_client_key_sign_into = enc_key_sign_into;
+            enc_key->intf.hsm_client_key_derive_and_sign_into = enc_key_derive_and_sign_into;
+            enc_key->intf.hsm_client_key_sign_batch = enc_key_sign_batch;
+            enc_key->intf.hsm_client_key_derive_and_sign_batch = enc_key_derive_and_sign_batch;
+            enc_key->intf.hsm_client_key_encrypt_init = enc_key_encrypt_init;
+            enc_key->intf.hsm_client_key_decrypt_init = enc_key_decrypt_init;
+            enc_key->intf.hsm_client_key_stream_update = enc_key_stream_update;
+            enc_key->intf.hsm_client_key_stream_final = enc_key_stream_final;
+            enc_key->intf.hsm_client_key_stream_destroy = enc_key_stream_destroy;
             memcpy(enc_key->key, key, key_size);
             enc_key->key_size = key_size;
+            memset(enc_key->ctx_slots, 0, sizeof(enc_key->ctx_slots));
         }
     }
 
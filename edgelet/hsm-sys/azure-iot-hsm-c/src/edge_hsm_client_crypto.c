@@ -16,6 +16,13 @@ struct EDGE_CRYPTO_TAG
 };
 typedef struct EDGE_CRYPTO_TAG EDGE_CRYPTO;
 
+struct EDGE_CRYPTO_STREAM_TAG
+{
+    KEY_HANDLE key_handle;
+    KEY_STREAM_HANDLE key_stream;
+};
+typedef struct EDGE_CRYPTO_STREAM_TAG EDGE_CRYPTO_STREAM;
+
 static const HSM_CLIENT_STORE_INTERFACE* g_hsm_store_if = NULL;
 static const HSM_CLIENT_KEY_INTERFACE* g_hsm_key_if = NULL;
 static bool g_is_crypto_initialized = false;
@@ -284,6 +291,80 @@ static CERT_INFO_HANDLE edge_hsm_client_create_certificate(HSM_CLIENT_HANDLE han
     return result;
 }
 
+static int edge_hsm_client_create_certificates
+(
+    HSM_CLIENT_HANDLE handle,
+    CERT_PROPS_HANDLE* certificate_props,
+    size_t count,
+    CERT_INFO_HANDLE* certificates
+)
+{
+    int result;
+
+    if (!g_is_crypto_initialized)
+    {
+        LOG_ERROR("hsm_client_crypto_init not called");
+        result = __FAILURE__;
+    }
+    else if (handle == NULL)
+    {
+        LOG_ERROR("Invalid handle value specified");
+        result = __FAILURE__;
+    }
+    else if ((certificate_props == NULL) || (count == 0))
+    {
+        LOG_ERROR("Invalid certificate props values specified");
+        result = __FAILURE__;
+    }
+    else if (certificates == NULL)
+    {
+        LOG_ERROR("Invalid certificates output buffer specified");
+        result = __FAILURE__;
+    }
+    else
+    {
+        // the store validates the properties of every certificate in the batch
+        EDGE_CRYPTO *edge_crypto = (EDGE_CRYPTO*)handle;
+        size_t index;
+
+        memset(certificates, 0, count * sizeof(CERT_INFO_HANDLE));
+        if (g_hsm_store_if->hsm_client_store_create_pki_certs(edge_crypto->hsm_store_handle,
+                                                              certificate_props,
+                                                              count) != 0)
+        {
+            LOG_ERROR("Could not create certificates in the store");
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = 0;
+            for (index = 0; (index < count) && (result == 0); index++)
+            {
+                const char *alias = get_alias(certificate_props[index]);
+                if ((certificates[index] = g_hsm_store_if->hsm_client_store_get_pki_cert(edge_crypto->hsm_store_handle,
+                                                                                         alias)) == NULL)
+                {
+                    LOG_ERROR("Could not get certificate for %s", alias);
+                    result = __FAILURE__;
+                }
+            }
+            if (result != 0)
+            {
+                for (index = 0; index < count; index++)
+                {
+                    if (certificates[index] != NULL)
+                    {
+                        certificate_info_destroy(certificates[index]);
+                        certificates[index] = NULL;
+                    }
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
 static CERT_INFO_HANDLE edge_hsm_client_get_trust_bundle(HSM_CLIENT_HANDLE handle)
 {
     CERT_INFO_HANDLE result;
@@ -522,6 +603,210 @@ static int edge_hsm_client_decrypt_data
     return result;
 }
 
+static int stream_init
+(
+    HSM_CLIENT_HANDLE handle,
+    const SIZED_BUFFER *identity,
+    const SIZED_BUFFER *initialization_vector,
+    HSM_CLIENT_STREAM_HANDLE *stream,
+    bool is_encrypt
+)
+{
+    int result;
+
+    if (!g_is_crypto_initialized)
+    {
+        LOG_ERROR("hsm_client_crypto_init not called");
+        result = __FAILURE__;
+    }
+    else if (stream == NULL)
+    {
+        LOG_ERROR("Invalid output stream parameter");
+        result = __FAILURE__;
+    }
+    else if (!validate_sized_buffer(identity))
+    {
+        LOG_ERROR("Invalid identity buffer provided");
+        result = __FAILURE__;
+    }
+    else if (!validate_sized_buffer(initialization_vector))
+    {
+        LOG_ERROR("Invalid initialization vector buffer provided");
+        result = __FAILURE__;
+    }
+    else
+    {
+        EDGE_CRYPTO *edge_crypto = (EDGE_CRYPTO*)handle;
+        const HSM_CLIENT_STORE_INTERFACE *store_if = g_hsm_store_if;
+        const HSM_CLIENT_KEY_INTERFACE *key_if = g_hsm_key_if;
+        EDGE_CRYPTO_STREAM *crypto_stream;
+
+        *stream = NULL;
+        if ((crypto_stream = (EDGE_CRYPTO_STREAM*)calloc(1, sizeof(EDGE_CRYPTO_STREAM))) == NULL)
+        {
+            LOG_ERROR("Could not allocate memory for stream");
+            result = __FAILURE__;
+        }
+        else if ((crypto_stream->key_handle = store_if->hsm_client_store_open_key(edge_crypto->hsm_store_handle,
+                                                                                  HSM_KEY_ENCRYPTION,
+                                                                                  EDGELET_ENC_KEY_NAME)) == NULL)
+        {
+            LOG_ERROR("Could not get encryption key by name '%s'", EDGELET_ENC_KEY_NAME);
+            free(crypto_stream);
+            result = __FAILURE__;
+        }
+        else
+        {
+            int status;
+            if (is_encrypt)
+            {
+                status = key_if->hsm_client_key_encrypt_init(crypto_stream->key_handle,
+                                                             identity,
+                                                             initialization_vector,
+                                                             &crypto_stream->key_stream);
+            }
+            else
+            {
+                status = key_if->hsm_client_key_decrypt_init(crypto_stream->key_handle,
+                                                             identity,
+                                                             initialization_vector,
+                                                             &crypto_stream->key_stream);
+            }
+
+            if (status != 0)
+            {
+                LOG_ERROR("Error starting stream. Error code %d", status);
+                (void)store_if->hsm_client_store_close_key(edge_crypto->hsm_store_handle,
+                                                           crypto_stream->key_handle);
+                free(crypto_stream);
+                result = __FAILURE__;
+            }
+            else
+            {
+                *stream = crypto_stream;
+                result = 0;
+            }
+        }
+    }
+
+    return result;
+}
+
+static int edge_hsm_client_encrypt_stream_init
+(
+    HSM_CLIENT_HANDLE handle,
+    const SIZED_BUFFER *identity,
+    const SIZED_BUFFER *initialization_vector,
+    HSM_CLIENT_STREAM_HANDLE *stream
+)
+{
+    return stream_init(handle, identity, initialization_vector, stream, true);
+}
+
+static int edge_hsm_client_decrypt_stream_init
+(
+    HSM_CLIENT_HANDLE handle,
+    const SIZED_BUFFER *identity,
+    const SIZED_BUFFER *initialization_vector,
+    HSM_CLIENT_STREAM_HANDLE *stream
+)
+{
+    return stream_init(handle, identity, initialization_vector, stream, false);
+}
+
+static int edge_hsm_client_stream_update
+(
+    HSM_CLIENT_HANDLE handle,
+    HSM_CLIENT_STREAM_HANDLE stream,
+    const unsigned char *input,
+    size_t input_size,
+    unsigned char *output,
+    size_t *output_size
+)
+{
+    int result;
+    (void)handle;
+
+    if (!g_is_crypto_initialized)
+    {
+        LOG_ERROR("hsm_client_crypto_init not called");
+        result = __FAILURE__;
+    }
+    else if (stream == NULL)
+    {
+        LOG_ERROR("Invalid stream parameter");
+        result = __FAILURE__;
+    }
+    else
+    {
+        EDGE_CRYPTO_STREAM *crypto_stream = (EDGE_CRYPTO_STREAM*)stream;
+        result = g_hsm_key_if->hsm_client_key_stream_update(crypto_stream->key_handle,
+                                                            crypto_stream->key_stream,
+                                                            input,
+                                                            input_size,
+                                                            output,
+                                                            output_size);
+    }
+
+    return result;
+}
+
+static int edge_hsm_client_stream_final
+(
+    HSM_CLIENT_HANDLE handle,
+    HSM_CLIENT_STREAM_HANDLE stream,
+    unsigned char *output,
+    size_t *output_size
+)
+{
+    int result;
+    (void)handle;
+
+    if (!g_is_crypto_initialized)
+    {
+        LOG_ERROR("hsm_client_crypto_init not called");
+        result = __FAILURE__;
+    }
+    else if (stream == NULL)
+    {
+        LOG_ERROR("Invalid stream parameter");
+        result = __FAILURE__;
+    }
+    else
+    {
+        EDGE_CRYPTO_STREAM *crypto_stream = (EDGE_CRYPTO_STREAM*)stream;
+        result = g_hsm_key_if->hsm_client_key_stream_final(crypto_stream->key_handle,
+                                                           crypto_stream->key_stream,
+                                                           output,
+                                                           output_size);
+    }
+
+    return result;
+}
+
+static void edge_hsm_client_stream_destroy(HSM_CLIENT_HANDLE handle, HSM_CLIENT_STREAM_HANDLE stream)
+{
+    if (!g_is_crypto_initialized)
+    {
+        LOG_ERROR("hsm_client_crypto_init not called");
+    }
+    else if ((handle != NULL) && (stream != NULL))
+    {
+        int status;
+        EDGE_CRYPTO *edge_crypto = (EDGE_CRYPTO*)handle;
+        EDGE_CRYPTO_STREAM *crypto_stream = (EDGE_CRYPTO_STREAM*)stream;
+        g_hsm_key_if->hsm_client_key_stream_destroy(crypto_stream->key_handle,
+                                                    crypto_stream->key_stream);
+        status = g_hsm_store_if->hsm_client_store_close_key(edge_crypto->hsm_store_handle,
+                                                            crypto_stream->key_handle);
+        if (status != 0)
+        {
+            LOG_ERROR("Error closing key handle. Error code %d", status);
+        }
+        free(crypto_stream);
+    }
+}
+
 static const HSM_CLIENT_CRYPTO_INTERFACE edge_hsm_crypto_interface =
 {
     edge_hsm_client_crypto_create,
@@ -534,7 +819,13 @@ static const HSM_CLIENT_CRYPTO_INTERFACE edge_hsm_crypto_interface =
     edge_hsm_client_encrypt_data,
     edge_hsm_client_decrypt_data,
     edge_hsm_client_get_trust_bundle,
-    edge_hsm_crypto_free_buffer
+    edge_hsm_crypto_free_buffer,
+    edge_hsm_client_create_certificates,
+    edge_hsm_client_encrypt_stream_init,
+    edge_hsm_client_decrypt_stream_init,
+    edge_hsm_client_stream_update,
+    edge_hsm_client_stream_final,
+    edge_hsm_client_stream_destroy
 };
 
 const HSM_CLIENT_CRYPTO_INTERFACE* hsm_client_crypto_interface(void)
@@ -1,19 +1,26 @@
+#include <ctype.h>
 #include <limits.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <time.h>
 
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/base64.h"
 #include "azure_c_shared_utility/buffer_.h"
 #include "azure_c_shared_utility/strings.h"
-#include "azure_c_shared_utility/singlylinkedlist.h"
 #include "azure_c_shared_utility/sha.h"
 
 #include "hsm_client_data.h"
 #include "hsm_client_store.h"
 #include "hsm_constants.h"
 #include "hsm_key.h"
+#include "hsm_key_pool.h"
+#include "hsm_lock.h"
 #include "hsm_log.h"
+#include "hsm_packed_store.h"
+#include "hsm_renewal.h"
 #include "hsm_utils.h"
+#include "hsm_workers.h"
 
 //##############################################################################
 // Data types
@@ -29,42 +36,187 @@
 // local normalized file storage defines
 #define NUM_NORMALIZED_ALIAS_CHARS  32
 
+// alias index defines
+#define STORE_INDEX_MIN_SLOTS     8
+#define STORE_INDEX_SLOT_EMPTY    (-1)
+#define STORE_INDEX_SLOT_DELETED  (-2)
+
+struct STORE_INDEX_ITEM_TAG
+{
+    uint32_t hash;
+    const char *alias;
+    void *value;
+};
+typedef struct STORE_INDEX_ITEM_TAG STORE_INDEX_ITEM;
+
+// Open addressed (linear probing) index of store entries keyed by alias.
+// The slots array holds positions into the items array which preserves
+// insertion order so that iteration, for example when building the trust
+// bundle, is deterministic. Removed items leave a NULL value hole which is
+// reclaimed the next time the index is resized.
+struct STORE_INDEX_TAG
+{
+    int32_t *slots;
+    size_t num_slots;
+    STORE_INDEX_ITEM *items;
+    size_t num_items;
+    size_t count;
+};
+typedef struct STORE_INDEX_TAG STORE_INDEX;
+
+// Key handle returned by open_key. It wraps the constructed SAS or encryption
+// key so that the key can be cached in the store entry and shared across
+// open_key calls. The store entry holds one reference and every open_key
+// holds another; close_key (key_destroy) drops a reference.
+struct STORE_CACHED_KEY_TAG
+{
+    HSM_CLIENT_KEY_INTERFACE intf;
+    KEY_HANDLE key;
+    volatile long ref_count;
+};
+typedef struct STORE_CACHED_KEY_TAG STORE_CACHED_KEY;
+
 struct STORE_ENTRY_KEY_TAG
 {
     STRING_HANDLE id;
     BUFFER_HANDLE key;
+    STORE_CACHED_KEY *cached_key;
 };
 typedef struct STORE_ENTRY_KEY_TAG STORE_ENTRY_KEY;
 
+// The parsed certificate, private key and chain of an entry used to issue
+// certificates. It is shared by the entry and every issuance in progress and
+// destroyed with the last reference. Valid only while the files on disk
+// match cert_stamp and key_stamp.
+struct STORE_ISSUER_TAG
+{
+    PKI_ISSUER_HANDLE pki_issuer;
+    HSM_FILE_STAMP cert_stamp;
+    HSM_FILE_STAMP key_stamp;
+    volatile long ref_count;
+};
+typedef struct STORE_ISSUER_TAG STORE_ISSUER;
+
+// The verifier built from the certificate file of an issuer alias. Shared
+// like STORE_ISSUER and valid only while cert_file on disk matches stamp.
+struct STORE_VERIFIER_TAG
+{
+    STRING_HANDLE alias;
+    STRING_HANDLE cert_file;
+    PKI_VERIFIER_HANDLE pki_verifier;
+    HSM_FILE_STAMP stamp;
+    volatile long ref_count;
+};
+typedef struct STORE_VERIFIER_TAG STORE_VERIFIER;
+
+// Tracks a certificate issued by create_pki_cert so that it is re-issued
+// from props at renew_time, before it expires at valid_to. id identifies the
+// issuance that is being renewed.
+struct STORE_RENEWAL_TAG
+{
+    CERT_PROPS_HANDLE props;
+    int64_t valid_to;
+    int64_t renew_time;
+    uint64_t id;
+};
+typedef struct STORE_RENEWAL_TAG STORE_RENEWAL;
+
+// cert_info caches the parsed certificate and private key. It is valid only
+// while the files on disk match cert_stamp and key_stamp and is dropped with
+// the entry whenever the alias is re-created or removed.
+// issuer is loaded the first time the entry issues a certificate. renewal
+// is set while the certificate is renewed in the background. props_digest
+// identifies the certificate properties the certificate was last issued or
+// reused for, see compute_cert_props_digest. It is also persisted next to
+// the certificate file, see write_cert_props_digest.
 struct STORE_ENTRY_PKI_CERT_TAG
 {
     STRING_HANDLE id;
     STRING_HANDLE issuer_id;
     STRING_HANDLE cert_file;
     STRING_HANDLE private_key_file;
+    CERT_INFO_HANDLE cert_info;
+    STORE_ISSUER *issuer;
+    STORE_RENEWAL *renewal;
+    HSM_FILE_STAMP cert_stamp;
+    HSM_FILE_STAMP key_stamp;
+    unsigned char props_digest[SHA256HashSize];
+    bool has_props_digest;
 };
 typedef struct STORE_ENTRY_PKI_CERT_TAG STORE_ENTRY_PKI_CERT;
 
+// stamp records the state of cert_file when the cached trust bundle was
+// last built
 struct STORE_ENTRY_PKI_TRUSTED_CERT_TAG
 {
     STRING_HANDLE id;
     STRING_HANDLE cert_file;
+    HSM_FILE_STAMP stamp;
 };
 typedef struct STORE_ENTRY_PKI_TRUSTED_CERT_TAG STORE_ENTRY_PKI_TRUSTED_CERT;
 
+// A certificate that passed verify_certificate. id identifies the DER
+// encoded certificate chain and issuer, see get_certificate_verification_id.
+struct VERIFIED_CERT_TAG
+{
+    unsigned char id[CERT_VERIFICATION_ID_SIZE];
+    int64_t not_after;
+};
+typedef struct VERIFIED_CERT_TAG VERIFIED_CERT;
+
+// trust_bundle caches the parsed concatenation of all pki_trusted_certs. It
+// is dropped whenever a trusted certificate is inserted or removed and
+// rebuilt on demand. verifiers holds a STORE_VERIFIER per issuer alias
+// that certificates are verified with. verified_certs is loaded from VERIFY_CACHE_FILE at
+// provisioning and written back whenever a certificate is verified.
+// verified_certs_version counts the changes to verified_certs.
 struct CRYPTO_STORE_ENTRY_TAG
 {
-    SINGLYLINKEDLIST_HANDLE sas_keys;
-    SINGLYLINKEDLIST_HANDLE sym_enc_keys;
-    SINGLYLINKEDLIST_HANDLE pki_certs;
-    SINGLYLINKEDLIST_HANDLE pki_trusted_certs;
+    STORE_INDEX sas_keys;
+    STORE_INDEX sym_enc_keys;
+    STORE_INDEX pki_certs;
+    STORE_INDEX pki_trusted_certs;
+    STORE_INDEX verifiers;
+    CERT_INFO_HANDLE trust_bundle;
+    VERIFIED_CERT *verified_certs;
+    size_t num_verified_certs;
+    uint64_t verified_certs_version;
 };
 typedef struct CRYPTO_STORE_ENTRY_TAG CRYPTO_STORE_ENTRY;
 
+// The store entry indexes are guarded by the store lock. Lookups take it
+// shared, for as long as the returned entry is in use, and any insert or
+// removal takes it exclusively. The lock is not recursive so helpers that
+// mutate the indexes must not be called with the lock held.
+//
+// packed is the optional single file backend for encryption keys, NULL
+// unless enabled with ENV_HSM_PACKED_STORE. Certificates and their keys are
+// only kept in the certs and cert_keys files which OpenSSL issues and
+// verifies from. It has its own lock which may be taken while the store lock
+// is held but never the other way around.
+//
+// renewal is the certificate renewal worker, NULL unless enabled with
+// ENV_HSM_CERT_RENEWAL_PERCENT. renewal_count is guarded by the store lock.
+//
+// reuse_percent is 0 unless certificates are reused across create requests
+// with ENV_HSM_CERT_REUSE_PERCENT.
+//
+// verify_cache_lock serializes writes of VERIFY_CACHE_FILE, which happen
+// after the store lock is released. saved_verify_version is the
+// verified_certs_version last written and is guarded by it. It is never
+// taken while the store lock is held.
 struct CRYPTO_STORE_TAG
 {
     STRING_HANDLE id;
     CRYPTO_STORE_ENTRY* store_entry;
+    HSM_RWLOCK_HANDLE lock;
+    HSM_MUTEX_HANDLE verify_cache_lock;
+    uint64_t saved_verify_version;
+    HSM_PACKED_STORE_HANDLE packed;
+    HSM_RENEWAL_HANDLE renewal;
+    int renewal_percent;
+    uint64_t renewal_count;
+    int reuse_percent;
     int ref_count;
 };
 typedef struct CRYPTO_STORE_TAG CRYPTO_STORE;
@@ -88,11 +240,30 @@ static const char *ENC_KEYS_DIR     = "enc_keys";
 static const char *CERT_FILE_EXT    = ".cert.pem";
 static const char *PK_FILE_EXT      = ".key.pem";
 static const char *ENC_KEY_FILE_EXT = ".enc.key";
+static const char *PACKED_STORE_FILE = "store.pack";
+static const char *VERIFY_CACHE_FILE = "verify.cache";
+static const char *VERIFY_CACHE_TEMP_FILE = "verify.cache.tmp";
+static const char *RENEWAL_FILE_EXT = ".renew";
+static const char *PROPS_FILE_EXT = ".props";
 
-static HSM_STATE_T g_hsm_state = HSM_STATE_UNPROVISIONED;
+static const unsigned char VERIFY_CACHE_MAGIC[8] = { 'I', 'E', 'H', 'S', 'M', 'V', 'C', '1' };
+// bounds the cache file, entries of certificates that are no longer in use
+// are evicted once their certificates expire or when the cache is full
+#define VERIFY_CACHE_MAX_ENTRIES 64
+
+// delay before a certificate that could not be renewed is retried
+#define CERT_RENEWAL_RETRY_SECONDS 300
+
+// certificates of a batch are issued concurrently by up to this many threads
+#define CERT_BATCH_MAX_WORKERS 4
+
+// g_crypto_store and g_store_ref_count are only modified with the
+// HSM_GLOBAL_LOCK_STORE lock held. g_hsm_state is also read without the lock
+// on every store call and is therefore only accessed atomically.
+static volatile long g_hsm_state = HSM_STATE_UNPROVISIONED;
 
 static CRYPTO_STORE* g_crypto_store = NULL;
-static int g_store_ref_count = 0;
+static volatile long g_store_ref_count = 0;
 
 //##############################################################################
 // Forward declarations
@@ -126,259 +297,742 @@ static int verify_certificate_helper
     const char *alias,
     const char *issuer_alias,
     const char *cert_file_path,
-    const char *key_file_path,
     bool *verification_status
 );
 
 static const char* get_base_dir(void);
+
+static void release_store_issuer(STORE_ISSUER *issuer);
+
+static void destroy_store_renewal(STORE_RENEWAL *renewal);
+
+static HSM_STATE_T get_hsm_state(void)
+{
+    return (HSM_STATE_T)hsm_atomic_load(&g_hsm_state);
+}
+
 //##############################################################################
-// STORE_ENTRY_KEY helpers
+// Alias index helpers
 //##############################################################################
-static bool find_key_cb(LIST_ITEM_HANDLE list_item, const void *match_context)
+static uint32_t store_index_hash(const char *alias)
 {
-    bool result;
+    // 32 bit FNV-1a
+    uint32_t result = 2166136261u;
+    const unsigned char *ptr = (const unsigned char*)alias;
 
-    STORE_ENTRY_KEY *key = (STORE_ENTRY_KEY*)singlylinkedlist_item_get_value(list_item);
-    if (strcmp(STRING_c_str(key->id), (const char*)match_context) == 0)
-    {
-        result = true;
-    }
-    else
+    while (*ptr != '\0')
     {
-        result = false;
+        result ^= *ptr;
+        result *= 16777619u;
+        ptr++;
     }
 
     return result;
 }
 
+static size_t store_index_max_items(size_t num_slots)
+{
+    // keep the load factor, tombstones included, at or below 2/3
+    return (num_slots * 2) / 3;
+}
 
-static STORE_ENTRY_KEY* get_key(const CRYPTO_STORE *store, HSM_KEY_T key_type, const char *key_name)
+static bool store_index_find_slot
+(
+    const STORE_INDEX *index,
+    const char *alias,
+    uint32_t hash,
+    size_t *slot
+)
 {
-    STORE_ENTRY_KEY *result = NULL;
-    SINGLYLINKEDLIST_HANDLE key_list = (key_type == HSM_KEY_SAS) ? store->store_entry->sas_keys :
-                                                                   store->store_entry->sym_enc_keys;
-    LIST_ITEM_HANDLE list_item = singlylinkedlist_find(key_list, find_key_cb, key_name);
-    if (list_item != NULL)
+    bool result = false;
+
+    if (index->num_slots != 0)
     {
-        result = (STORE_ENTRY_KEY*)singlylinkedlist_item_get_value(list_item);
+        size_t mask = index->num_slots - 1;
+        size_t pos = hash & mask;
+        int32_t item_pos;
+
+        while ((item_pos = index->slots[pos]) != STORE_INDEX_SLOT_EMPTY)
+        {
+            if (item_pos >= 0)
+            {
+                const STORE_INDEX_ITEM *item = &index->items[item_pos];
+                if ((item->hash == hash) && (strcmp(item->alias, alias) == 0))
+                {
+                    *slot = pos;
+                    result = true;
+                    break;
+                }
+            }
+            pos = (pos + 1) & mask;
+        }
     }
 
     return result;
 }
 
-static bool key_exists(const CRYPTO_STORE *store, HSM_KEY_T key_type, const char *key_name)
+static int store_index_resize(STORE_INDEX *index)
 {
-    STORE_ENTRY_KEY *entry = get_key(store, key_type, key_name);
-    return (entry != NULL) ? true : false;
-}
+    int result;
+    int32_t *slots;
+    STORE_INDEX_ITEM *items;
+    size_t num_slots = STORE_INDEX_MIN_SLOTS;
 
-static STORE_ENTRY_KEY* create_key_entry
-(
-    const char *key_name,
-    const unsigned char* key,
-    size_t key_size
-)
-{
-    STORE_ENTRY_KEY *result;
+    // size the table so that at least as many inserts as live entries
+    // can be made before the next resize
+    while (store_index_max_items(num_slots) < ((index->count + 1) * 2))
+    {
+        num_slots <<= 1;
+    }
 
-    if ((result = malloc(sizeof(STORE_ENTRY_KEY))) == NULL)
+    if ((num_slots > INT32_MAX) ||
+        ((slots = (int32_t*)malloc(num_slots * sizeof(int32_t))) == NULL))
     {
-        LOG_ERROR("Could not allocate memory to store the key %s", key_name);
+        LOG_ERROR("Could not allocate memory for store index slots");
+        result = __FAILURE__;
     }
-    else if ((result->id = STRING_construct(key_name)) == NULL)
+    else if ((items = (STORE_INDEX_ITEM*)malloc(store_index_max_items(num_slots) *
+                                                sizeof(STORE_INDEX_ITEM))) == NULL)
     {
-        LOG_ERROR("Could not allocate string handle for key %s", key_name);
-        free(result);
-        result = NULL;
+        LOG_ERROR("Could not allocate memory for store index items");
+        free(slots);
+        result = __FAILURE__;
     }
-    else if ((result->key = BUFFER_create(key, key_size)) == NULL)
+    else
     {
-        LOG_ERROR("Could not allocate buffer for key %s", key_name);
-        STRING_delete(result->id);
-        free(result);
-        result = NULL;
+        size_t idx, num_items = 0, mask = num_slots - 1;
+
+        for (idx = 0; idx < num_slots; idx++)
+        {
+            slots[idx] = STORE_INDEX_SLOT_EMPTY;
+        }
+        for (idx = 0; idx < index->num_items; idx++)
+        {
+            if (index->items[idx].value != NULL)
+            {
+                size_t pos = index->items[idx].hash & mask;
+                while (slots[pos] != STORE_INDEX_SLOT_EMPTY)
+                {
+                    pos = (pos + 1) & mask;
+                }
+                items[num_items] = index->items[idx];
+                slots[pos] = (int32_t)num_items;
+                num_items++;
+            }
+        }
+        free(index->slots);
+        free(index->items);
+        index->slots = slots;
+        index->num_slots = num_slots;
+        index->items = items;
+        index->num_items = num_items;
+        result = 0;
     }
 
     return result;
 }
 
-static void destroy_key(STORE_ENTRY_KEY *key)
-{
-    STRING_delete(key->id);
-    BUFFER_delete(key->key);
-    free(key);
-}
-
-static void destroy_keys(SINGLYLINKEDLIST_HANDLE keys)
-{
-    LIST_ITEM_HANDLE list_item;
-    while ((list_item = singlylinkedlist_get_head_item(keys)) != NULL)
-    {
-        STORE_ENTRY_KEY *key_entry = (STORE_ENTRY_KEY*)singlylinkedlist_item_get_value(list_item);
-        destroy_key(key_entry);
-        singlylinkedlist_remove(keys, list_item);
-    }
-}
-
-static bool remove_key_entry_cb
-(
-    const void *item,
-    const void *match_context,
-    bool *continue_processing
-)
+static void* store_index_get(const STORE_INDEX *index, const char *alias)
 {
-    bool result;
-    STORE_ENTRY_KEY* key = (STORE_ENTRY_KEY*)item;
+    void *result;
+    size_t slot;
 
-    if (strcmp(STRING_c_str(key->id), (const char*)match_context) == 0)
+    if (store_index_find_slot(index, alias, store_index_hash(alias), &slot))
     {
-        destroy_key(key);
-        *continue_processing = false;
-        result = true;
+        result = index->items[index->slots[slot]].value;
     }
     else
     {
-        *continue_processing = true;
-        result = false;
+        result = NULL;
     }
 
     return result;
 }
 
-static int put_key
-(
-    CRYPTO_STORE *store,
-    HSM_KEY_T key_type,
-    const char *key_name,
-    const unsigned char* key,
-    size_t key_size
-)
+/**
+ * Add a value to the index. The alias string is not copied and must remain
+ * valid for as long as the value is present in the index. Callers are expected
+ * to have removed any existing value for the alias.
+ */
+static int store_index_add(STORE_INDEX *index, const char *alias, void *value)
 {
     int result;
-    STORE_ENTRY_KEY *key_entry;
-    SINGLYLINKEDLIST_HANDLE key_list = (key_type == HSM_KEY_SAS) ? store->store_entry->sas_keys :
-                                                                   store->store_entry->sym_enc_keys;
-    (void)singlylinkedlist_remove_if(key_list, remove_key_entry_cb, key_name);
-    if ((key_entry = create_key_entry(key_name, key, key_size)) == NULL)
-    {
-        LOG_ERROR("Could not allocate memory to store key %s", key_name);
-        result = __FAILURE__;
-    }
-    else if (singlylinkedlist_add(key_list, key_entry) == NULL)
+
+    if ((index->num_items >= store_index_max_items(index->num_slots)) &&
+        (store_index_resize(index) != 0))
     {
-        LOG_ERROR("Could not insert key in the key store");
-        destroy_key(key_entry);
+        LOG_ERROR("Could not grow store index to add %s", alias);
         result = __FAILURE__;
     }
     else
     {
+        uint32_t hash = store_index_hash(alias);
+        size_t mask = index->num_slots - 1;
+        size_t pos = hash & mask;
+        STORE_INDEX_ITEM *item = &index->items[index->num_items];
+
+        while (index->slots[pos] >= 0)
+        {
+            pos = (pos + 1) & mask;
+        }
+        item->hash = hash;
+        item->alias = alias;
+        item->value = value;
+        index->slots[pos] = (int32_t)index->num_items;
+        index->num_items++;
+        index->count++;
         result = 0;
     }
 
     return result;
 }
 
-static int remove_key
-(
-    CRYPTO_STORE *store,
-    HSM_KEY_T key_type,
-    const char *key_name
-)
+static void* store_index_remove(STORE_INDEX *index, const char *alias)
 {
-    int result;
-    SINGLYLINKEDLIST_HANDLE key_list = (key_type == HSM_KEY_SAS) ? store->store_entry->sas_keys :
-                                                                   store->store_entry->sym_enc_keys;
-    LIST_ITEM_HANDLE list_item = singlylinkedlist_find(key_list, find_key_cb, key_name);
-    if (list_item == NULL)
+    void *result;
+    size_t slot;
+
+    if (store_index_find_slot(index, alias, store_index_hash(alias), &slot))
     {
-        LOG_DEBUG("Key not found %s", key_name);
-        result = __FAILURE__;
+        STORE_INDEX_ITEM *item = &index->items[index->slots[slot]];
+        result = item->value;
+        item->value = NULL;
+        item->alias = NULL;
+        index->slots[slot] = STORE_INDEX_SLOT_DELETED;
+        index->count--;
     }
     else
     {
-        STORE_ENTRY_KEY *key_entry = (STORE_ENTRY_KEY*)singlylinkedlist_item_get_value(list_item);
-        destroy_key(key_entry);
-        singlylinkedlist_remove(key_list, list_item);
-        result = 0;
+        result = NULL;
     }
 
     return result;
 }
 
-//##############################################################################
-// STORE_ENTRY_PKI_CERT helpers
-//##############################################################################
-static bool find_pki_cert_cb(LIST_ITEM_HANDLE list_item, const void *match_context)
+/**
+ * Iterate over the values in the index in insertion order. The cursor
+ * should be initialized to 0 and NULL is returned once all values are seen.
+ */
+static void* store_index_next(const STORE_INDEX *index, size_t *cursor)
 {
-    bool result;
-    STORE_ENTRY_PKI_CERT *cert = (STORE_ENTRY_PKI_CERT*)singlylinkedlist_item_get_value(list_item);
-    if (strcmp(STRING_c_str(cert->id), (const char*)match_context) == 0)
-    {
-        result = true;
-    }
-    else
+    void *result = NULL;
+
+    while ((result == NULL) && (*cursor < index->num_items))
     {
-        result = false;
+        result = index->items[*cursor].value;
+        (*cursor)++;
     }
 
     return result;
 }
 
-static STORE_ENTRY_PKI_CERT* get_pki_cert
+static void store_index_deinit(STORE_INDEX *index)
+{
+    free(index->slots);
+    free(index->items);
+    memset(index, 0, sizeof(STORE_INDEX));
+}
+
+//##############################################################################
+// STORE_CACHED_KEY helpers
+//##############################################################################
+static int cached_key_sign
 (
-    const CRYPTO_STORE *store,
-    const char *cert_alias
+    KEY_HANDLE key_handle,
+    const unsigned char* data_to_be_signed,
+    size_t data_to_be_signed_size,
+    unsigned char** digest,
+    size_t* digest_size
+)
+{
+    STORE_CACHED_KEY *cached_key = (STORE_CACHED_KEY*)key_handle;
+    return key_sign(cached_key->key, data_to_be_signed, data_to_be_signed_size,
+                    digest, digest_size);
+}
+
+static int cached_key_derive_and_sign
+(
+    KEY_HANDLE key_handle,
+    const unsigned char* data_to_be_signed,
+    size_t data_to_be_signed_size,
+    const unsigned char* identity,
+    size_t identity_size,
+    unsigned char** digest,
+    size_t* digest_size
+)
+{
+    STORE_CACHED_KEY *cached_key = (STORE_CACHED_KEY*)key_handle;
+    return key_derive_and_sign(cached_key->key, data_to_be_signed, data_to_be_signed_size,
+                               identity, identity_size, digest, digest_size);
+}
+
+static int cached_key_sign_into
+(
+    KEY_HANDLE key_handle,
+    const unsigned char* data_to_be_signed,
+    size_t data_to_be_signed_size,
+    unsigned char* digest,
+    size_t* digest_size
+)
+{
+    STORE_CACHED_KEY *cached_key = (STORE_CACHED_KEY*)key_handle;
+    return key_sign_into(cached_key->key, data_to_be_signed, data_to_be_signed_size,
+                         digest, digest_size);
+}
+
+static int cached_key_derive_and_sign_into
+(
+    KEY_HANDLE key_handle,
+    const unsigned char* data_to_be_signed,
+    size_t data_to_be_signed_size,
+    const unsigned char* identity,
+    size_t identity_size,
+    unsigned char* digest,
+    size_t* digest_size
+)
+{
+    STORE_CACHED_KEY *cached_key = (STORE_CACHED_KEY*)key_handle;
+    return key_derive_and_sign_into(cached_key->key, data_to_be_signed, data_to_be_signed_size,
+                                    identity, identity_size, digest, digest_size);
+}
+
+static int cached_key_sign_batch
+(
+    KEY_HANDLE key_handle,
+    const HSM_SIGN_REQUEST* requests,
+    size_t count,
+    unsigned char* digests,
+    size_t* digest_size
+)
+{
+    STORE_CACHED_KEY *cached_key = (STORE_CACHED_KEY*)key_handle;
+    return key_sign_batch(cached_key->key, requests, count, digests, digest_size);
+}
+
+static int cached_key_derive_and_sign_batch
+(
+    KEY_HANDLE key_handle,
+    const HSM_SIGN_REQUEST* requests,
+    size_t count,
+    unsigned char* digests,
+    size_t* digest_size
+)
+{
+    STORE_CACHED_KEY *cached_key = (STORE_CACHED_KEY*)key_handle;
+    return key_derive_and_sign_batch(cached_key->key, requests, count, digests, digest_size);
+}
+
+static int cached_key_encrypt
+(
+    KEY_HANDLE key_handle,
+    const SIZED_BUFFER *identity,
+    const SIZED_BUFFER *plaintext,
+    const SIZED_BUFFER *initialization_vector,
+    SIZED_BUFFER *ciphertext
+)
+{
+    STORE_CACHED_KEY *cached_key = (STORE_CACHED_KEY*)key_handle;
+    return key_encrypt(cached_key->key, identity, plaintext, initialization_vector, ciphertext);
+}
+
+static int cached_key_decrypt
+(
+    KEY_HANDLE key_handle,
+    const SIZED_BUFFER *identity,
+    const SIZED_BUFFER *ciphertext,
+    const SIZED_BUFFER *initialization_vector,
+    SIZED_BUFFER *plaintext
+)
+{
+    STORE_CACHED_KEY *cached_key = (STORE_CACHED_KEY*)key_handle;
+    return key_decrypt(cached_key->key, identity, ciphertext, initialization_vector, plaintext);
+}
+
+static int cached_key_encrypt_init
+(
+    KEY_HANDLE key_handle,
+    const SIZED_BUFFER *identity,
+    const SIZED_BUFFER *initialization_vector,
+    KEY_STREAM_HANDLE *stream
+)
+{
+    STORE_CACHED_KEY *cached_key = (STORE_CACHED_KEY*)key_handle;
+    return key_encrypt_init(cached_key->key, identity, initialization_vector, stream);
+}
+
+static int cached_key_decrypt_init
+(
+    KEY_HANDLE key_handle,
+    const SIZED_BUFFER *identity,
+    const SIZED_BUFFER *initialization_vector,
+    KEY_STREAM_HANDLE *stream
+)
+{
+    STORE_CACHED_KEY *cached_key = (STORE_CACHED_KEY*)key_handle;
+    return key_decrypt_init(cached_key->key, identity, initialization_vector, stream);
+}
+
+static int cached_key_stream_update
+(
+    KEY_HANDLE key_handle,
+    KEY_STREAM_HANDLE stream,
+    const unsigned char *input,
+    size_t input_size,
+    unsigned char *output,
+    size_t *output_size
+)
+{
+    STORE_CACHED_KEY *cached_key = (STORE_CACHED_KEY*)key_handle;
+    return key_stream_update(cached_key->key, stream, input, input_size, output, output_size);
+}
+
+static int cached_key_stream_final
+(
+    KEY_HANDLE key_handle,
+    KEY_STREAM_HANDLE stream,
+    unsigned char *output,
+    size_t *output_size
 )
 {
-    STORE_ENTRY_PKI_CERT *result = NULL;
-    SINGLYLINKEDLIST_HANDLE certs_list = store->store_entry->pki_certs;
-    LIST_ITEM_HANDLE list_item = singlylinkedlist_find(certs_list,
-                                                       find_pki_cert_cb,
-                                                       cert_alias);
-    if (list_item != NULL)
+    STORE_CACHED_KEY *cached_key = (STORE_CACHED_KEY*)key_handle;
+    return key_stream_final(cached_key->key, stream, output, output_size);
+}
+
+static void cached_key_stream_destroy(KEY_HANDLE key_handle, KEY_STREAM_HANDLE stream)
+{
+    STORE_CACHED_KEY *cached_key = (STORE_CACHED_KEY*)key_handle;
+    key_stream_destroy(cached_key->key, stream);
+}
+
+static void cached_key_release(KEY_HANDLE key_handle)
+{
+    STORE_CACHED_KEY *cached_key = (STORE_CACHED_KEY*)key_handle;
+    if (hsm_atomic_decrement(&cached_key->ref_count) == 0)
     {
-        result = (STORE_ENTRY_PKI_CERT*)singlylinkedlist_item_get_value(list_item);
+        key_destroy(cached_key->key);
+        free(cached_key);
     }
-    return result;
 }
 
-static int make_new_dir_relative_to_dir(const char *relative_dir, const char *new_dir_name)
+static const HSM_CLIENT_KEY_INTERFACE CACHED_KEY_INTERFACE =
 {
-    int result;
+    cached_key_sign,
+    cached_key_derive_and_sign,
+    cached_key_encrypt,
+    cached_key_decrypt,
+    cached_key_release,
+    cached_key_sign_into,
+    cached_key_derive_and_sign_into,
+    cached_key_sign_batch,
+    cached_key_derive_and_sign_batch,
+    cached_key_encrypt_init,
+    cached_key_decrypt_init,
+    cached_key_stream_update,
+    cached_key_stream_final,
+    cached_key_stream_destroy
+};
 
-    STRING_HANDLE dir_path = STRING_construct(relative_dir);
-    if (dir_path == NULL)
+static STORE_CACHED_KEY* create_cached_key(HSM_KEY_T key_type, const STORE_ENTRY_KEY *key_entry)
+{
+    STORE_CACHED_KEY *result;
+    size_t buffer_size = 0;
+    const unsigned char *buffer_ptr = NULL;
+    const char *key_name = STRING_c_str(key_entry->id);
+
+    if (((buffer_ptr = BUFFER_u_char(key_entry->key)) == NULL) ||
+        (BUFFER_size(key_entry->key, &buffer_size) != 0) ||
+        (buffer_size == 0))
     {
-        LOG_ERROR("Could not construct handle to relative dir %s", relative_dir);
-        result = __FAILURE__;
+        LOG_ERROR("Invalid key buffer for %s", key_name);
+        result = NULL;
+    }
+    else if ((result = (STORE_CACHED_KEY*)malloc(sizeof(STORE_CACHED_KEY))) == NULL)
+    {
+        LOG_ERROR("Could not allocate memory for key handle %s", key_name);
     }
     else
     {
-        if ((STRING_concat(dir_path, SLASH) != 0) ||
-            (STRING_concat(dir_path, new_dir_name) != 0))
+        if (key_type == HSM_KEY_ENCRYPTION)
         {
-            LOG_ERROR("Could not construct handle to relative dir %s", relative_dir);
-            result = __FAILURE__;
+            result->key = create_encryption_key(buffer_ptr, buffer_size);
         }
-        else if (make_dir(STRING_c_str(dir_path)) != 0)
+        else
         {
-            LOG_ERROR("Could not create dir %s relative to %s", new_dir_name, relative_dir);
-            result = __FAILURE__;
+            result->key = create_sas_key(buffer_ptr, buffer_size);
+        }
+
+        if (result->key == NULL)
+        {
+            LOG_ERROR("Could not create key handle for %s", key_name);
+            free(result);
+            result = NULL;
         }
         else
         {
-            result = 0;
+            result->intf = CACHED_KEY_INTERFACE;
+            result->ref_count = 1;
         }
-
-        STRING_delete(dir_path);
     }
 
     return result;
 }
 
-static const char* obtain_default_platform_base_dir(void)
+//##############################################################################
+// STORE_ENTRY_KEY helpers
+//##############################################################################
+static STORE_INDEX* get_key_index(const CRYPTO_STORE *store, HSM_KEY_T key_type)
 {
-    const char *result;
+    return (key_type == HSM_KEY_SAS) ? &store->store_entry->sas_keys :
+                                       &store->store_entry->sym_enc_keys;
+}
+
+static STORE_ENTRY_KEY* get_key(const CRYPTO_STORE *store, HSM_KEY_T key_type, const char *key_name)
+{
+    return (STORE_ENTRY_KEY*)store_index_get(get_key_index(store, key_type), key_name);
+}
+
+static bool key_exists(const CRYPTO_STORE *store, HSM_KEY_T key_type, const char *key_name)
+{
+    STORE_ENTRY_KEY *entry;
+
+    hsm_rwlock_read_lock(store->lock);
+    entry = get_key(store, key_type, key_name);
+    hsm_rwlock_read_unlock(store->lock);
+
+    return (entry != NULL) ? true : false;
+}
+
+static STORE_ENTRY_KEY* create_key_entry
+(
+    const char *key_name,
+    const unsigned char* key,
+    size_t key_size
+)
+{
+    STORE_ENTRY_KEY *result;
+
+    if ((result = malloc(sizeof(STORE_ENTRY_KEY))) == NULL)
+    {
+        LOG_ERROR("Could not allocate memory to store the key %s", key_name);
+    }
+    else if ((result->id = STRING_construct(key_name)) == NULL)
+    {
+        LOG_ERROR("Could not allocate string handle for key %s", key_name);
+        free(result);
+        result = NULL;
+    }
+    else if ((result->key = BUFFER_create(key, key_size)) == NULL)
+    {
+        LOG_ERROR("Could not allocate buffer for key %s", key_name);
+        STRING_delete(result->id);
+        free(result);
+        result = NULL;
+    }
+    else
+    {
+        result->cached_key = NULL;
+    }
+
+    return result;
+}
+
+static void destroy_key(STORE_ENTRY_KEY *key)
+{
+    if (key->cached_key != NULL)
+    {
+        // handles still held by callers of open_key remain valid until closed
+        cached_key_release(key->cached_key);
+    }
+    STRING_delete(key->id);
+    BUFFER_delete(key->key);
+    free(key);
+}
+
+static void destroy_keys(STORE_INDEX *keys)
+{
+    STORE_ENTRY_KEY *key_entry;
+    size_t cursor = 0;
+    while ((key_entry = (STORE_ENTRY_KEY*)store_index_next(keys, &cursor)) != NULL)
+    {
+        destroy_key(key_entry);
+    }
+    store_index_deinit(keys);
+}
+
+static int put_key
+(
+    CRYPTO_STORE *store,
+    HSM_KEY_T key_type,
+    const char *key_name,
+    const unsigned char* key,
+    size_t key_size
+)
+{
+    int result;
+    STORE_ENTRY_KEY *key_entry;
+    STORE_INDEX *key_index = get_key_index(store, key_type);
+
+    if ((key_entry = create_key_entry(key_name, key, key_size)) == NULL)
+    {
+        LOG_ERROR("Could not allocate memory to store key %s", key_name);
+        result = __FAILURE__;
+    }
+    else
+    {
+        STORE_ENTRY_KEY *old_entry;
+
+        hsm_rwlock_write_lock(store->lock);
+        if ((old_entry = (STORE_ENTRY_KEY*)store_index_remove(key_index, key_name)) != NULL)
+        {
+            destroy_key(old_entry);
+        }
+        if (store_index_add(key_index, STRING_c_str(key_entry->id), key_entry) != 0)
+        {
+            LOG_ERROR("Could not insert key in the key store");
+            destroy_key(key_entry);
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = 0;
+        }
+        hsm_rwlock_write_unlock(store->lock);
+    }
+
+    return result;
+}
+
+static int remove_key
+(
+    CRYPTO_STORE *store,
+    HSM_KEY_T key_type,
+    const char *key_name
+)
+{
+    int result;
+    STORE_ENTRY_KEY *key_entry;
+
+    hsm_rwlock_write_lock(store->lock);
+    if ((key_entry = (STORE_ENTRY_KEY*)store_index_remove(get_key_index(store, key_type),
+                                                          key_name)) == NULL)
+    {
+        LOG_DEBUG("Key not found %s", key_name);
+        result = __FAILURE__;
+    }
+    else
+    {
+        destroy_key(key_entry);
+        result = 0;
+    }
+    hsm_rwlock_write_unlock(store->lock);
+
+    return result;
+}
+
+static STORE_CACHED_KEY* acquire_cached_key
+(
+    CRYPTO_STORE *store,
+    HSM_KEY_T key_type,
+    const char *key_name
+)
+{
+    STORE_CACHED_KEY *result = NULL;
+    STORE_ENTRY_KEY *key_entry;
+
+    // fast path, the key handle was constructed by an earlier open
+    hsm_rwlock_read_lock(store->lock);
+    if (((key_entry = get_key(store, key_type, key_name)) != NULL) &&
+        ((result = key_entry->cached_key) != NULL))
+    {
+        (void)hsm_atomic_increment(&result->ref_count);
+    }
+    hsm_rwlock_read_unlock(store->lock);
+
+    if (result == NULL)
+    {
+        hsm_rwlock_write_lock(store->lock);
+        if ((key_entry = get_key(store, key_type, key_name)) == NULL)
+        {
+            LOG_ERROR("Could not find key name %s", key_name);
+        }
+        else if ((key_entry->cached_key == NULL) &&
+                 ((key_entry->cached_key = create_cached_key(key_type, key_entry)) == NULL))
+        {
+            LOG_ERROR("Could not create key handle for %s", key_name);
+        }
+        else
+        {
+            result = key_entry->cached_key;
+            (void)hsm_atomic_increment(&result->ref_count);
+        }
+        hsm_rwlock_write_unlock(store->lock);
+    }
+
+    return result;
+}
+
+//##############################################################################
+// STORE_ENTRY_PKI_CERT helpers
+//##############################################################################
+static STORE_ENTRY_PKI_CERT* get_pki_cert
+(
+    const CRYPTO_STORE *store,
+    const char *cert_alias
+)
+{
+    return (STORE_ENTRY_PKI_CERT*)store_index_get(&store->store_entry->pki_certs, cert_alias);
+}
+
+// Certificates in the store had their key checked when they were loaded and
+// renewals swap both files in with the store lock held.
+static bool is_pki_cert_loaded(CRYPTO_STORE *store, const char *cert_alias)
+{
+    bool result;
+
+    hsm_rwlock_read_lock(store->lock);
+    result = (get_pki_cert(store, cert_alias) != NULL);
+    hsm_rwlock_read_unlock(store->lock);
+
+    return result;
+}
+
+static int make_new_dir_relative_to_dir(const char *relative_dir, const char *new_dir_name)
+{
+    int result;
+
+    STRING_HANDLE dir_path = STRING_construct(relative_dir);
+    if (dir_path == NULL)
+    {
+        LOG_ERROR("Could not construct handle to relative dir %s", relative_dir);
+        result = __FAILURE__;
+    }
+    else
+    {
+        if ((STRING_concat(dir_path, SLASH) != 0) ||
+            (STRING_concat(dir_path, new_dir_name) != 0))
+        {
+            LOG_ERROR("Could not construct handle to relative dir %s", relative_dir);
+            result = __FAILURE__;
+        }
+        else if (make_dir(STRING_c_str(dir_path)) != 0)
+        {
+            LOG_ERROR("Could not create dir %s relative to %s", new_dir_name, relative_dir);
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = 0;
+        }
+
+        STRING_delete(dir_path);
+    }
+
+    return result;
+}
+
+static const char* obtain_default_platform_base_dir(void)
+{
+    const char *result;
     static STRING_HANDLE PLATFORM_BASE_PATH = NULL;
 
     if (PLATFORM_BASE_PATH == NULL)
@@ -755,96 +1409,301 @@ static int build_enc_key_file_path(const char *key_name, STRING_HANDLE key_file)
     return result;
 }
 
-static int save_encryption_key_to_file(const char *key_name, unsigned char *key, size_t key_size)
+//##############################################################################
+// Packed store helpers
+//##############################################################################
+static bool is_packed_store_enabled(void)
 {
-    int result;
-    STRING_HANDLE key_file_handle;
+    static const char *ENABLED_VALUES[] = { "1", "on", "yes", "true" };
+    bool result = false;
+    char *env_value = NULL;
 
-    if ((key_file_handle = STRING_new()) == NULL)
+    if (hsm_get_env(ENV_HSM_PACKED_STORE, &env_value) != 0)
     {
-        LOG_ERROR("Could not create string handle");
-        result = __FAILURE__;
+        LOG_ERROR("Could not lookup env variable %s", ENV_HSM_PACKED_STORE);
     }
+    else if (env_value != NULL)
     {
-        const char *key_file;
-        if (build_enc_key_file_path(key_name, key_file_handle) != 0)
-        {
-            LOG_ERROR("Could not construct path to key");
-            result = __FAILURE__;
-        }
-        else if ((key_file = STRING_c_str(key_file_handle)) == NULL)
-        {
-            LOG_ERROR("Key file path NULL");
-            result = __FAILURE__;
-        }
-        else if (write_buffer_to_file(key_file, key, key_size, true) != 0)
-        {
-            LOG_ERROR("Could not write key to file");
-            result = __FAILURE__;
-        }
-        else
+        size_t index, char_index;
+        for (index = 0; (index < sizeof(ENABLED_VALUES) / sizeof(ENABLED_VALUES[0])) && !result; index++)
         {
-            result = 0;
+            const char *expected = ENABLED_VALUES[index];
+            for (char_index = 0; (expected[char_index] != 0) &&
+                                 (tolower((unsigned char)env_value[char_index]) == expected[char_index]); char_index++);
+            result = (expected[char_index] == 0) && (env_value[char_index] == 0);
         }
-        STRING_delete(key_file_handle);
+        free(env_value);
     }
 
     return result;
 }
 
-static int load_encryption_key_from_file(CRYPTO_STORE* store, const char *key_name)
+static int open_packed_store_if_enabled(CRYPTO_STORE *store)
 {
     int result;
-    STRING_HANDLE key_file_handle;
+    STRING_HANDLE packed_file;
 
-    if ((key_file_handle = STRING_new()) == NULL)
+    if (!is_packed_store_enabled())
     {
-        LOG_ERROR("Could not create string handle");
+        result = 0;
+    }
+    else if ((packed_file = STRING_construct(get_base_dir())) == NULL)
+    {
+        LOG_ERROR("Could not allocate string handle for packed store path");
         result = __FAILURE__;
     }
     else
     {
-        const char *key_file;
-        unsigned char *key = NULL;
-        size_t key_size = 0;
-
-        if (build_enc_key_file_path(key_name, key_file_handle) != 0)
-        {
-            LOG_ERROR("Could not construct path to key");
-            result = __FAILURE__;
-        }
-        else if ((key_file = STRING_c_str(key_file_handle)) == NULL)
+        if ((STRING_concat(packed_file, SLASH) != 0) ||
+            (STRING_concat(packed_file, PACKED_STORE_FILE) != 0))
         {
-            LOG_ERROR("Key file path NULL");
+            LOG_ERROR("Could not construct path to packed store");
             result = __FAILURE__;
         }
-        else if (((key = read_file_into_buffer(key_file, &key_size)) == NULL) ||
-                  (key_size == 0))
+        else if ((store->packed = hsm_packed_store_open(STRING_c_str(packed_file))) == NULL)
         {
-            LOG_ERROR("Could not read key from file. Key size %zu", key_size);
+            LOG_ERROR("Could not open packed store %s", STRING_c_str(packed_file));
             result = __FAILURE__;
         }
         else
         {
-            result = put_key(store, HSM_KEY_ENCRYPTION, key_name, key, key_size);
-        }
-
-        if (key != NULL)
-        {
-            free(key);
+            LOG_DEBUG("Using packed store %s", STRING_c_str(packed_file));
+            result = 0;
         }
-        STRING_delete(key_file_handle);
+        STRING_delete(packed_file);
     }
 
     return result;
 }
 
-static int delete_encryption_key_file(const char *key_name)
+static int save_to_packed_store
+(
+    const CRYPTO_STORE *store,
+    HSM_PACKED_RECORD_TYPE type,
+    const char *alias,
+    const unsigned char *data,
+    size_t data_size
+)
 {
     int result;
-    STRING_HANDLE key_file_handle;
+    STRING_HANDLE name;
 
-    if ((key_file_handle = STRING_new()) == NULL)
+    if ((name = normalize_alias_file_path(alias)) == NULL)
+    {
+        LOG_ERROR("Could not normalize packed store record name for %s", alias);
+        result = __FAILURE__;
+    }
+    else
+    {
+        if (hsm_packed_store_put(store->packed, type, STRING_c_str(name), data, data_size) != 0)
+        {
+            LOG_ERROR("Could not write %s to packed store", alias);
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = 0;
+        }
+        STRING_delete(name);
+    }
+
+    return result;
+}
+
+static int remove_from_packed_store
+(
+    const CRYPTO_STORE *store,
+    HSM_PACKED_RECORD_TYPE type,
+    const char *alias
+)
+{
+    int result;
+    STRING_HANDLE name;
+
+    if ((name = normalize_alias_file_path(alias)) == NULL)
+    {
+        LOG_ERROR("Could not normalize packed store record name for %s", alias);
+        result = __FAILURE__;
+    }
+    else
+    {
+        if (hsm_packed_store_remove(store->packed, type, STRING_c_str(name)) != 0)
+        {
+            LOG_ERROR("Could not remove %s from packed store", alias);
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = 0;
+        }
+        STRING_delete(name);
+    }
+
+    return result;
+}
+
+// returns a copy of the record data. the copy allows the packed store to be
+// released before any store lock is taken.
+static unsigned char* copy_from_packed_store
+(
+    const CRYPTO_STORE *store,
+    HSM_PACKED_RECORD_TYPE type,
+    const char *alias,
+    size_t *data_size
+)
+{
+    unsigned char *result;
+    STRING_HANDLE name;
+    HSM_PACKED_RECORD record;
+
+    *data_size = 0;
+    if ((name = normalize_alias_file_path(alias)) == NULL)
+    {
+        LOG_ERROR("Could not normalize packed store record name for %s", alias);
+        result = NULL;
+    }
+    else
+    {
+        if (hsm_packed_store_get(store->packed, type, STRING_c_str(name), &record) != 0)
+        {
+            result = NULL;
+        }
+        else
+        {
+            if ((result = (unsigned char*)malloc(record.data_size)) == NULL)
+            {
+                LOG_ERROR("Could not allocate memory for packed store record %s", alias);
+            }
+            else
+            {
+                memcpy(result, record.data, record.data_size);
+                *data_size = record.data_size;
+            }
+            hsm_packed_store_release(store->packed);
+        }
+        STRING_delete(name);
+    }
+
+    return result;
+}
+
+//##############################################################################
+// Encryption key persistence
+//##############################################################################
+static int save_encryption_key_to_file(CRYPTO_STORE *store, const char *key_name, unsigned char *key, size_t key_size)
+{
+    int result;
+    STRING_HANDLE key_file_handle;
+
+    if (store->packed != NULL)
+    {
+        result = save_to_packed_store(store, HSM_PACKED_RECORD_ENC_KEY, key_name, key, key_size);
+    }
+    else if ((key_file_handle = STRING_new()) == NULL)
+    {
+        LOG_ERROR("Could not create string handle");
+        result = __FAILURE__;
+    }
+    else
+    {
+        const char *key_file;
+        if (build_enc_key_file_path(key_name, key_file_handle) != 0)
+        {
+            LOG_ERROR("Could not construct path to key");
+            result = __FAILURE__;
+        }
+        else if ((key_file = STRING_c_str(key_file_handle)) == NULL)
+        {
+            LOG_ERROR("Key file path NULL");
+            result = __FAILURE__;
+        }
+        else if (write_buffer_to_file(key_file, key, key_size, true) != 0)
+        {
+            LOG_ERROR("Could not write key to file");
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = 0;
+        }
+        STRING_delete(key_file_handle);
+    }
+
+    return result;
+}
+
+static int load_encryption_key_from_file(CRYPTO_STORE* store, const char *key_name)
+{
+    int result;
+    STRING_HANDLE key_file_handle;
+    unsigned char *key = NULL;
+    size_t key_size = 0;
+
+    if ((store->packed != NULL) &&
+        ((key = copy_from_packed_store(store, HSM_PACKED_RECORD_ENC_KEY, key_name, &key_size)) != NULL))
+    {
+        result = put_key(store, HSM_KEY_ENCRYPTION, key_name, key, key_size);
+    }
+    else if ((key_file_handle = STRING_new()) == NULL)
+    {
+        LOG_ERROR("Could not create string handle");
+        result = __FAILURE__;
+    }
+    else
+    {
+        const char *key_file;
+
+        if (build_enc_key_file_path(key_name, key_file_handle) != 0)
+        {
+            LOG_ERROR("Could not construct path to key");
+            result = __FAILURE__;
+        }
+        else if ((key_file = STRING_c_str(key_file_handle)) == NULL)
+        {
+            LOG_ERROR("Key file path NULL");
+            result = __FAILURE__;
+        }
+        else if (((key = read_file_into_buffer(key_file, &key_size)) == NULL) ||
+                  (key_size == 0))
+        {
+            LOG_ERROR("Could not read key from file. Key size %zu", key_size);
+            result = __FAILURE__;
+        }
+        else if ((store->packed != NULL) &&
+                 (save_to_packed_store(store, HSM_PACKED_RECORD_ENC_KEY, key_name, key, key_size) != 0))
+        {
+            // keys created before the packed store was enabled are migrated
+            // on first use, the key file is left in place
+            LOG_ERROR("Could not migrate key %s to the packed store", key_name);
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = put_key(store, HSM_KEY_ENCRYPTION, key_name, key, key_size);
+        }
+
+        STRING_delete(key_file_handle);
+    }
+
+    if (key != NULL)
+    {
+        free(key);
+    }
+
+    return result;
+}
+
+static int delete_encryption_key_file(CRYPTO_STORE *store, const char *key_name)
+{
+    int result;
+    STRING_HANDLE key_file_handle;
+
+    if ((store->packed != NULL) &&
+        (remove_from_packed_store(store, HSM_PACKED_RECORD_ENC_KEY, key_name) != 0))
+    {
+        result = __FAILURE__;
+    }
+    else if ((key_file_handle = STRING_new()) == NULL)
     {
         LOG_ERROR("Could not create string handle");
         result = __FAILURE__;
@@ -877,110 +1736,247 @@ static int delete_encryption_key_file(const char *key_name)
     return result;
 }
 
+//##############################################################################
+// Certificate info helpers
+//##############################################################################
+static CERT_INFO_HANDLE prepare_cert_info_from_files(const char *cert_file, const char *pk_file)
+{
+    CERT_INFO_HANDLE result;
+    char *private_key_contents = NULL;
+    void *cert_contents = NULL;
+    size_t private_key_size = 0, cert_size = 0;
+
+    // certificates such as the device CA are provided by the user and may be
+    // rewritten in place, so they are read into memory rather than mapped
+    if ((private_key_contents = read_file_into_cstring(pk_file, &private_key_size)) == NULL)
+    {
+        LOG_ERROR("Could not load private key into buffer %s", pk_file);
+        result = NULL;
+    }
+    else if ((cert_contents = read_file_into_buffer(cert_file, &cert_size)) == NULL)
+    {
+        LOG_ERROR("Could not read certificate into buffer %s", cert_file);
+        result = NULL;
+    }
+    else
+    {
+        result = certificate_info_create_from_buffer((const char*)cert_contents,
+                                                     cert_size,
+                                                     private_key_contents,
+                                                     private_key_size,
+                                                     (private_key_size != 0) ? PRIVATE_KEY_PAYLOAD :
+                                                                               PRIVATE_KEY_UNKNOWN);
+    }
+
+    if (cert_contents != NULL)
+    {
+        free(cert_contents);
+    }
+    if (private_key_contents != NULL)
+    {
+        free(private_key_contents);
+    }
+
+    return result;
+}
+
 static CERT_INFO_HANDLE prepare_cert_info_handle
 (
     const CRYPTO_STORE *store,
     STORE_ENTRY_PKI_CERT *cert_entry
 )
 {
-    (void)store;
     CERT_INFO_HANDLE result;
-    char *cert_contents = NULL, *private_key_contents = NULL;
-    size_t private_key_size = 0;
     const char *cert_file;
     const char *pk_file;
 
+    (void)store;
     if ((pk_file = STRING_c_str(cert_entry->private_key_file)) == NULL)
     {
         LOG_ERROR("Private key file path is NULL");
         result = NULL;
     }
-    else if ((private_key_contents = read_file_into_cstring(pk_file, &private_key_size)) == NULL)
-    {
-        LOG_ERROR("Could not load private key into buffer %s", pk_file);
-        result = NULL;
-    }
     else if ((cert_file = STRING_c_str(cert_entry->cert_file)) == NULL)
     {
         LOG_ERROR("Certificate file path NULL");
         result = NULL;
     }
-    else if ((cert_contents = read_file_into_cstring(cert_file, NULL)) == NULL)
-    {
-        LOG_ERROR("Could not read certificate into buffer %s", cert_file);
-        result = NULL;
-    }
     else
     {
-        result = certificate_info_create(cert_contents,
-                                         private_key_contents,
-                                         private_key_size,
-                                         (private_key_size != 0) ? PRIVATE_KEY_PAYLOAD :
-                                                                   PRIVATE_KEY_UNKNOWN);
+        result = prepare_cert_info_from_files(cert_file, pk_file);
     }
 
-    if (cert_contents != NULL)
+    return result;
+}
+
+static bool is_file_stamp_equal(const HSM_FILE_STAMP *a, const HSM_FILE_STAMP *b)
+{
+    return (a->device == b->device) &&
+           (a->inode == b->inode) &&
+           (a->size == b->size) &&
+           (a->modified_time == b->modified_time);
+}
+
+static bool is_cached_cert_info_valid(const STORE_ENTRY_PKI_CERT *cert_entry)
+{
+    bool result;
+    HSM_FILE_STAMP cert_stamp, key_stamp;
+
+    if (cert_entry->cert_info == NULL)
     {
-        free(cert_contents);
+        result = false;
     }
-    if (private_key_contents != NULL)
+    else if ((get_file_stamp(STRING_c_str(cert_entry->cert_file), &cert_stamp) != 0) ||
+             (get_file_stamp(STRING_c_str(cert_entry->private_key_file), &key_stamp) != 0))
     {
-        free(private_key_contents);
+        result = false;
+    }
+    else
+    {
+        result = is_file_stamp_equal(&cert_stamp, &cert_entry->cert_stamp) &&
+                 is_file_stamp_equal(&key_stamp, &cert_entry->key_stamp);
     }
 
     return result;
 }
 
-static STORE_ENTRY_PKI_CERT* create_pki_cert_entry
+static CERT_INFO_HANDLE refresh_cached_cert_info
 (
-    const char *alias,
-    const char *issuer_alias,
-    const char *certificate_file,
-    const char *private_key_file
+    const CRYPTO_STORE *store,
+    STORE_ENTRY_PKI_CERT *cert_entry
 )
 {
-    STORE_ENTRY_PKI_CERT *result;
+    CERT_INFO_HANDLE result;
+    HSM_FILE_STAMP cert_stamp, key_stamp;
 
-    if ((result = malloc(sizeof(STORE_ENTRY_PKI_CERT))) == NULL)
-    {
-        LOG_ERROR("Could not allocate memory to store the certificate for alias %s", alias);
-    }
-    else if ((result->id = STRING_construct(alias)) == NULL)
+    // the stamps are taken before the files are read so that a concurrent
+    // rewrite of the files is detected on the next lookup
+    if (get_file_stamp(STRING_c_str(cert_entry->cert_file), &cert_stamp) != 0)
     {
-        LOG_ERROR("Could not allocate string handle for alias %s", alias);
-        free(result);
+        LOG_ERROR("Could not stat certificate file %s", STRING_c_str(cert_entry->cert_file));
         result = NULL;
     }
-    else if ((result->issuer_id = STRING_construct(issuer_alias)) == NULL)
+    else if (get_file_stamp(STRING_c_str(cert_entry->private_key_file), &key_stamp) != 0)
     {
-        LOG_ERROR("Could not allocate string handle for issuer for alias %s", alias);
-        STRING_delete(result->id);
-        free(result);
+        LOG_ERROR("Could not stat private key file %s", STRING_c_str(cert_entry->private_key_file));
         result = NULL;
     }
-    else if ((result->cert_file = STRING_construct(certificate_file)) == NULL)
+    else if ((result = prepare_cert_info_handle(store, cert_entry)) == NULL)
     {
-        LOG_ERROR("Could not allocate string handle for cert file for alias %s", alias);
-        STRING_delete(result->issuer_id);
-        STRING_delete(result->id);
-        free(result);
-        result = NULL;
+        LOG_ERROR("Could not create certificate info for %s", STRING_c_str(cert_entry->id));
     }
-    else if ((result->private_key_file = STRING_construct(private_key_file)) == NULL)
+    else
     {
-        LOG_ERROR("Could not allocate string handle for private key file for alias %s", alias);
-        STRING_delete(result->cert_file);
-        STRING_delete(result->issuer_id);
-        STRING_delete(result->id);
-        free(result);
-        result = NULL;
+        if (cert_entry->cert_info != NULL)
+        {
+            certificate_info_destroy(cert_entry->cert_info);
+        }
+        cert_entry->cert_info = result;
+        cert_entry->cert_stamp = cert_stamp;
+        cert_entry->key_stamp = key_stamp;
+        result = certificate_info_clone(result);
     }
 
     return result;
 }
 
-static void destroy_pki_cert(STORE_ENTRY_PKI_CERT *pki_cert)
+static CERT_INFO_HANDLE get_cached_cert_info(CRYPTO_STORE *store, const char *alias)
 {
+    CERT_INFO_HANDLE result = NULL;
+    STORE_ENTRY_PKI_CERT *cert_entry;
+
+    hsm_rwlock_read_lock(store->lock);
+    if (((cert_entry = get_pki_cert(store, alias)) != NULL) &&
+        is_cached_cert_info_valid(cert_entry))
+    {
+        result = certificate_info_clone(cert_entry->cert_info);
+    }
+    hsm_rwlock_read_unlock(store->lock);
+
+    if (result == NULL)
+    {
+        hsm_rwlock_write_lock(store->lock);
+        if ((cert_entry = get_pki_cert(store, alias)) == NULL)
+        {
+            LOG_ERROR("Could not find certificate for %s", alias);
+        }
+        else if (is_cached_cert_info_valid(cert_entry))
+        {
+            // another thread refreshed the entry while the lock was released
+            result = certificate_info_clone(cert_entry->cert_info);
+        }
+        else
+        {
+            result = refresh_cached_cert_info(store, cert_entry);
+        }
+        hsm_rwlock_write_unlock(store->lock);
+    }
+
+    return result;
+}
+
+static STORE_ENTRY_PKI_CERT* create_pki_cert_entry
+(
+    const char *alias,
+    const char *issuer_alias,
+    const char *certificate_file,
+    const char *private_key_file
+)
+{
+    STORE_ENTRY_PKI_CERT *result;
+
+    if ((result = calloc(1, sizeof(STORE_ENTRY_PKI_CERT))) == NULL)
+    {
+        LOG_ERROR("Could not allocate memory to store the certificate for alias %s", alias);
+    }
+    else if ((result->id = STRING_construct(alias)) == NULL)
+    {
+        LOG_ERROR("Could not allocate string handle for alias %s", alias);
+        free(result);
+        result = NULL;
+    }
+    else if ((result->issuer_id = STRING_construct(issuer_alias)) == NULL)
+    {
+        LOG_ERROR("Could not allocate string handle for issuer for alias %s", alias);
+        STRING_delete(result->id);
+        free(result);
+        result = NULL;
+    }
+    else if ((result->cert_file = STRING_construct(certificate_file)) == NULL)
+    {
+        LOG_ERROR("Could not allocate string handle for cert file for alias %s", alias);
+        STRING_delete(result->issuer_id);
+        STRING_delete(result->id);
+        free(result);
+        result = NULL;
+    }
+    else if ((result->private_key_file = STRING_construct(private_key_file)) == NULL)
+    {
+        LOG_ERROR("Could not allocate string handle for private key file for alias %s", alias);
+        STRING_delete(result->cert_file);
+        STRING_delete(result->issuer_id);
+        STRING_delete(result->id);
+        free(result);
+        result = NULL;
+    }
+
+    return result;
+}
+
+static void destroy_pki_cert(STORE_ENTRY_PKI_CERT *pki_cert)
+{
+    if (pki_cert->cert_info != NULL)
+    {
+        certificate_info_destroy(pki_cert->cert_info);
+    }
+    if (pki_cert->issuer != NULL)
+    {
+        release_store_issuer(pki_cert->issuer);
+    }
+    if (pki_cert->renewal != NULL)
+    {
+        destroy_store_renewal(pki_cert->renewal);
+    }
     STRING_delete(pki_cert->id);
     STRING_delete(pki_cert->issuer_id);
     STRING_delete(pki_cert->cert_file);
@@ -988,299 +1984,1521 @@ static void destroy_pki_cert(STORE_ENTRY_PKI_CERT *pki_cert)
     free(pki_cert);
 }
 
-static bool remove_cert_entry_cb
-(
-    const void *item,
-    const void *match_context,
-    bool *continue_processing
-)
+static int put_pki_cert
+(
+    CRYPTO_STORE *store,
+    const char *alias,
+    const char *issuer_alias,
+    const char *certificate_file,
+    const char *private_key_file
+)
+{
+    int result;
+    STORE_ENTRY_PKI_CERT *cert_entry;
+
+    cert_entry = create_pki_cert_entry(alias, issuer_alias, certificate_file, private_key_file);
+    if (cert_entry == NULL)
+    {
+        LOG_ERROR("Could not allocate memory to store certificate and or key for %s", alias);
+        result = __FAILURE__;
+    }
+    else
+    {
+        STORE_ENTRY_PKI_CERT *old_entry;
+        STORE_INDEX *cert_index = &store->store_entry->pki_certs;
+
+        hsm_rwlock_write_lock(store->lock);
+        if ((old_entry = (STORE_ENTRY_PKI_CERT*)store_index_remove(cert_index, alias)) != NULL)
+        {
+            destroy_pki_cert(old_entry);
+        }
+        if (store_index_add(cert_index, STRING_c_str(cert_entry->id), cert_entry) != 0)
+        {
+            LOG_ERROR("Could not insert cert and key in the store");
+            destroy_pki_cert(cert_entry);
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = 0;
+        }
+        hsm_rwlock_write_unlock(store->lock);
+    }
+    return result;
+}
+
+static int remove_pki_cert(CRYPTO_STORE *store, const char *alias)
+{
+    int result;
+    STORE_ENTRY_PKI_CERT *pki_cert;
+
+    hsm_rwlock_write_lock(store->lock);
+    if ((pki_cert = (STORE_ENTRY_PKI_CERT*)store_index_remove(&store->store_entry->pki_certs,
+                                                              alias)) == NULL)
+    {
+        LOG_ERROR("Certificate not found %s", alias);
+        result = __FAILURE__;
+    }
+    else
+    {
+        destroy_pki_cert(pki_cert);
+        result = 0;
+    }
+    hsm_rwlock_write_unlock(store->lock);
+
+    return result;
+}
+
+static void destroy_pki_certs(STORE_INDEX *certs)
+{
+    STORE_ENTRY_PKI_CERT *pki_cert;
+    size_t cursor = 0;
+    while ((pki_cert = (STORE_ENTRY_PKI_CERT*)store_index_next(certs, &cursor)) != NULL)
+    {
+        destroy_pki_cert(pki_cert);
+    }
+    store_index_deinit(certs);
+}
+
+//##############################################################################
+// Issuer helpers
+//##############################################################################
+static void release_store_issuer(STORE_ISSUER *issuer)
+{
+    if (hsm_atomic_decrement(&issuer->ref_count) == 0)
+    {
+        pki_issuer_destroy(issuer->pki_issuer);
+        free(issuer);
+    }
+}
+
+static bool is_store_issuer_valid(const STORE_ENTRY_PKI_CERT *cert_entry)
+{
+    bool result;
+    HSM_FILE_STAMP cert_stamp, key_stamp;
+
+    if (cert_entry->issuer == NULL)
+    {
+        result = false;
+    }
+    else if ((get_file_stamp(STRING_c_str(cert_entry->cert_file), &cert_stamp) != 0) ||
+             (get_file_stamp(STRING_c_str(cert_entry->private_key_file), &key_stamp) != 0))
+    {
+        result = false;
+    }
+    else
+    {
+        result = is_file_stamp_equal(&cert_stamp, &cert_entry->issuer->cert_stamp) &&
+                 is_file_stamp_equal(&key_stamp, &cert_entry->issuer->key_stamp);
+    }
+
+    return result;
+}
+
+static STORE_ISSUER* load_store_issuer(const char *cert_file, const char *key_file)
+{
+    STORE_ISSUER *result;
+
+    if ((result = (STORE_ISSUER*)calloc(1, sizeof(STORE_ISSUER))) == NULL)
+    {
+        LOG_ERROR("Could not allocate memory for issuer");
+    }
+    // the stamps are taken before the files are read so that a concurrent
+    // rewrite of the files is detected on the next issuance
+    else if ((get_file_stamp(cert_file, &result->cert_stamp) != 0) ||
+             (get_file_stamp(key_file, &result->key_stamp) != 0))
+    {
+        LOG_ERROR("Could not stat issuer files %s and %s", cert_file, key_file);
+        free(result);
+        result = NULL;
+    }
+    else if ((result->pki_issuer = pki_issuer_create(key_file, cert_file)) == NULL)
+    {
+        LOG_ERROR("Could not load issuer from %s", cert_file);
+        free(result);
+        result = NULL;
+    }
+    else
+    {
+        result->ref_count = 1;
+    }
+
+    return result;
+}
+
+/**
+ * Returns a reference to the issuer of the entry for issuer_alias, loading
+ * it from the certificate and key files if it has not been loaded yet or if
+ * the files have changed since. The issuer is loaded without the store lock
+ * held and the reference must be released with release_store_issuer.
+ */
+static STORE_ISSUER* acquire_store_issuer(CRYPTO_STORE *store, const char *issuer_alias)
+{
+    STORE_ISSUER *result = NULL;
+    STRING_HANDLE cert_file = NULL;
+    STRING_HANDLE key_file = NULL;
+    STORE_ENTRY_PKI_CERT *cert_entry;
+
+    hsm_rwlock_read_lock(store->lock);
+    if ((cert_entry = get_pki_cert(store, issuer_alias)) == NULL)
+    {
+        LOG_ERROR("Could not get certificate entry for issuer %s", issuer_alias);
+    }
+    else if (is_store_issuer_valid(cert_entry))
+    {
+        result = cert_entry->issuer;
+        (void)hsm_atomic_increment(&result->ref_count);
+    }
+    else if (((cert_file = STRING_clone(cert_entry->cert_file)) == NULL) ||
+             ((key_file = STRING_clone(cert_entry->private_key_file)) == NULL))
+    {
+        LOG_ERROR("Could not copy file paths for issuer %s", issuer_alias);
+    }
+    hsm_rwlock_read_unlock(store->lock);
+
+    if ((result == NULL) && (cert_file != NULL) && (key_file != NULL))
+    {
+        if ((result = load_store_issuer(STRING_c_str(cert_file), STRING_c_str(key_file))) != NULL)
+        {
+            hsm_rwlock_write_lock(store->lock);
+            // the entry may have been re-created while the lock was released,
+            // the issuer is only cached when it was loaded from its files
+            if (((cert_entry = get_pki_cert(store, issuer_alias)) != NULL) &&
+                (strcmp(STRING_c_str(cert_entry->cert_file), STRING_c_str(cert_file)) == 0) &&
+                (strcmp(STRING_c_str(cert_entry->private_key_file), STRING_c_str(key_file)) == 0))
+            {
+                if (cert_entry->issuer != NULL)
+                {
+                    release_store_issuer(cert_entry->issuer);
+                }
+                (void)hsm_atomic_increment(&result->ref_count);
+                cert_entry->issuer = result;
+            }
+            hsm_rwlock_write_unlock(store->lock);
+        }
+    }
+
+    if (cert_file != NULL)
+    {
+        STRING_delete(cert_file);
+    }
+    if (key_file != NULL)
+    {
+        STRING_delete(key_file);
+    }
+
+    return result;
+}
+
+// Issues the certificate described by cert_props_handle into the given files.
+static int issue_pki_cert
+(
+    CRYPTO_STORE *store,
+    CERT_PROPS_HANDLE cert_props_handle,
+    int ca_path_len,
+    const char *pk_path,
+    const char *cert_path
+)
+{
+    int result;
+    const char *issuer_alias = get_issuer_alias(cert_props_handle);
+
+    if (strcmp(get_alias(cert_props_handle), issuer_alias) == 0)
+    {
+        result = generate_pki_cert_and_key(cert_props_handle,
+                                           rand(), // todo check if rand is okay or if we need something stronger like a SHA1
+                                           ca_path_len,
+                                           pk_path,
+                                           cert_path,
+                                           NULL,
+                                           NULL);
+    }
+    else
+    {
+        // not a self signed certificate request. the issuer is kept
+        // parsed in its store entry and shared by concurrent requests
+        // so that the store lock is not held during generation
+        STORE_ISSUER *issuer;
+        if ((issuer = acquire_store_issuer(store, issuer_alias)) == NULL)
+        {
+            LOG_ERROR("Could not load issuer %s", issuer_alias);
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = generate_pki_cert_and_key_with_issuer(cert_props_handle,
+                                                           rand(),
+                                                           ca_path_len,
+                                                           pk_path,
+                                                           cert_path,
+                                                           issuer->pki_issuer);
+            release_store_issuer(issuer);
+        }
+    }
+
+    return result;
+}
+
+//##############################################################################
+// Verifier helpers
+//##############################################################################
+static void release_store_verifier(STORE_VERIFIER *verifier)
+{
+    if (hsm_atomic_decrement(&verifier->ref_count) == 0)
+    {
+        pki_verifier_destroy(verifier->pki_verifier);
+        STRING_delete(verifier->cert_file);
+        STRING_delete(verifier->alias);
+        free(verifier);
+    }
+}
+
+static STORE_VERIFIER* create_store_verifier
+(
+    const char *issuer_alias,
+    const char *issuer_cert_path,
+    const HSM_FILE_STAMP *stamp
+)
+{
+    STORE_VERIFIER *result;
+
+    if ((result = (STORE_VERIFIER*)calloc(1, sizeof(STORE_VERIFIER))) == NULL)
+    {
+        LOG_ERROR("Could not allocate memory for verifier");
+    }
+    else if ((result->alias = STRING_construct(issuer_alias)) == NULL)
+    {
+        LOG_ERROR("Could not allocate verifier alias %s", issuer_alias);
+        free(result);
+        result = NULL;
+    }
+    else if ((result->cert_file = STRING_construct(issuer_cert_path)) == NULL)
+    {
+        LOG_ERROR("Could not allocate verifier certificate path %s", issuer_cert_path);
+        STRING_delete(result->alias);
+        free(result);
+        result = NULL;
+    }
+    else if ((result->pki_verifier = pki_verifier_create(issuer_cert_path)) == NULL)
+    {
+        LOG_ERROR("Could not load issuer certificate %s", issuer_cert_path);
+        STRING_delete(result->cert_file);
+        STRING_delete(result->alias);
+        free(result);
+        result = NULL;
+    }
+    else
+    {
+        result->stamp = *stamp;
+        result->ref_count = 1;
+    }
+
+    return result;
+}
+
+/**
+ * Returns a reference to the verifier for issuer_alias, building it from
+ * issuer_cert_path if there is none yet or if the file has changed since.
+ * The verifier is built without the store lock held and the reference must
+ * be released with release_store_verifier.
+ */
+static STORE_VERIFIER* acquire_store_verifier
+(
+    CRYPTO_STORE *store,
+    const char *issuer_alias,
+    const char *issuer_cert_path
+)
+{
+    STORE_VERIFIER *result = NULL;
+    STORE_VERIFIER *verifier;
+    HSM_FILE_STAMP stamp;
+
+    // the stamp is taken before the file is read so that a concurrent
+    // rewrite of the file is detected on the next verification
+    if (get_file_stamp(issuer_cert_path, &stamp) != 0)
+    {
+        LOG_ERROR("Could not stat issuer certificate file %s", issuer_cert_path);
+    }
+    else
+    {
+        hsm_rwlock_read_lock(store->lock);
+        if (((verifier = (STORE_VERIFIER*)store_index_get(&store->store_entry->verifiers, issuer_alias)) != NULL) &&
+            (strcmp(STRING_c_str(verifier->cert_file), issuer_cert_path) == 0) &&
+            is_file_stamp_equal(&stamp, &verifier->stamp))
+        {
+            result = verifier;
+            (void)hsm_atomic_increment(&result->ref_count);
+        }
+        hsm_rwlock_read_unlock(store->lock);
+
+        if ((result == NULL) &&
+            ((result = create_store_verifier(issuer_alias, issuer_cert_path, &stamp)) != NULL))
+        {
+            hsm_rwlock_write_lock(store->lock);
+            if ((verifier = (STORE_VERIFIER*)store_index_remove(&store->store_entry->verifiers, issuer_alias)) != NULL)
+            {
+                release_store_verifier(verifier);
+            }
+            if (store_index_add(&store->store_entry->verifiers, STRING_c_str(result->alias), result) != 0)
+            {
+                // the verifier is still used for this verification
+                LOG_ERROR("Could not cache verifier for issuer %s", issuer_alias);
+            }
+            else
+            {
+                (void)hsm_atomic_increment(&result->ref_count);
+            }
+            hsm_rwlock_write_unlock(store->lock);
+        }
+    }
+
+    return result;
+}
+
+static void destroy_verifiers(STORE_INDEX *verifiers)
+{
+    STORE_VERIFIER *verifier;
+    size_t cursor = 0;
+
+    while ((verifier = (STORE_VERIFIER*)store_index_next(verifiers, &cursor)) != NULL)
+    {
+        release_store_verifier(verifier);
+    }
+    store_index_deinit(verifiers);
+}
+
+//##############################################################################
+// Certificate renewal helpers
+//##############################################################################
+static CERT_PROPS_HANDLE copy_cert_props(CERT_PROPS_HANDLE cert_props_handle)
+{
+    CERT_PROPS_HANDLE result;
+    const char *value;
+
+    if ((result = cert_properties_create()) == NULL)
+    {
+        LOG_ERROR("Could not allocate certificate properties");
+    }
+    else if ((set_alias(result, get_alias(cert_props_handle)) != 0) ||
+             (set_issuer_alias(result, get_issuer_alias(cert_props_handle)) != 0) ||
+             ((get_validity_seconds(cert_props_handle) != 0) &&
+              (set_validity_seconds(result, get_validity_seconds(cert_props_handle)) != 0)) ||
+             ((get_certificate_type(cert_props_handle) != CERTIFICATE_TYPE_UNKNOWN) &&
+              (set_certificate_type(result, get_certificate_type(cert_props_handle)) != 0)) ||
+             (((value = get_common_name(cert_props_handle)) != NULL) && (set_common_name(result, value) != 0)) ||
+             (((value = get_country_name(cert_props_handle)) != NULL) && (set_country_name(result, value) != 0)) ||
+             (((value = get_state_name(cert_props_handle)) != NULL) && (set_state_name(result, value) != 0)) ||
+             (((value = get_locality(cert_props_handle)) != NULL) && (set_locality(result, value) != 0)) ||
+             (((value = get_organization_name(cert_props_handle)) != NULL) && (set_organization_name(result, value) != 0)) ||
+             (((value = get_organization_unit(cert_props_handle)) != NULL) && (set_organization_unit(result, value) != 0)))
+    {
+        LOG_ERROR("Could not copy certificate properties");
+        cert_properties_destroy(result);
+        result = NULL;
+    }
+
+    return result;
+}
+
+static void destroy_store_renewal(STORE_RENEWAL *renewal)
+{
+    cert_properties_destroy(renewal->props);
+    free(renewal);
+}
+
+static STORE_RENEWAL* copy_store_renewal(const STORE_RENEWAL *renewal)
+{
+    STORE_RENEWAL *result;
+
+    if ((result = (STORE_RENEWAL*)malloc(sizeof(STORE_RENEWAL))) == NULL)
+    {
+        LOG_ERROR("Could not allocate memory for certificate renewal");
+    }
+    else
+    {
+        *result = *renewal;
+        if ((result->props = copy_cert_props(renewal->props)) == NULL)
+        {
+            free(result);
+            result = NULL;
+        }
+    }
+
+    return result;
+}
+
+// Starts renewing the certificate just issued or loaded for the alias of
+// cert_props_handle, replacing any renewal of a previous issuance.
+static void track_cert_renewal(CRYPTO_STORE *store, CERT_PROPS_HANDLE cert_props_handle)
+{
+    const char *alias = get_alias(cert_props_handle);
+    STORE_RENEWAL *renewal;
+    CERT_INFO_HANDLE cert_info;
+
+    if ((renewal = (STORE_RENEWAL*)calloc(1, sizeof(STORE_RENEWAL))) == NULL)
+    {
+        LOG_ERROR("Could not allocate memory to renew certificate for %s", alias);
+    }
+    else if ((renewal->props = copy_cert_props(cert_props_handle)) == NULL)
+    {
+        LOG_ERROR("Could not copy certificate properties to renew certificate for %s", alias);
+        free(renewal);
+    }
+    else if ((cert_info = get_cached_cert_info(store, alias)) == NULL)
+    {
+        LOG_ERROR("Could not load certificate to renew for %s", alias);
+        destroy_store_renewal(renewal);
+    }
+    else
+    {
+        STORE_ENTRY_PKI_CERT *cert_entry;
+        int64_t valid_from = certificate_info_get_valid_from(cert_info);
+        int64_t renew_time;
+
+        renewal->valid_to = certificate_info_get_valid_to(cert_info);
+        renewal->renew_time = valid_from + ((renewal->valid_to - valid_from) * store->renewal_percent) / 100;
+        renew_time = renewal->renew_time;
+        certificate_info_destroy(cert_info);
+
+        hsm_rwlock_write_lock(store->lock);
+        if ((cert_entry = get_pki_cert(store, alias)) == NULL)
+        {
+            LOG_ERROR("Certificate for %s was removed before its renewal was scheduled", alias);
+            destroy_store_renewal(renewal);
+            renewal = NULL;
+        }
+        else
+        {
+            renewal->id = ++store->renewal_count;
+            if (cert_entry->renewal != NULL)
+            {
+                destroy_store_renewal(cert_entry->renewal);
+            }
+            cert_entry->renewal = renewal;
+        }
+        hsm_rwlock_write_unlock(store->lock);
+
+        if (renewal != NULL)
+        {
+            LOG_DEBUG("Certificate for %s is renewed at %lld", alias, (long long)renew_time);
+            hsm_renewal_schedule(store->renewal, renew_time);
+        }
+    }
+}
+
+// Swaps the renewed certificate and key files in. Called with the store lock
+// held exclusively so that lookups see either the previous or the renewed
+// certificate and key, never a mix of both. A crash between the renames
+// leaves the renewed key with the previous certificate, which
+// load_if_cert_and_key_exist_by_alias detects and issues the alias again.
+static void swap_renewed_cert
+(
+    CRYPTO_STORE *store,
+    STORE_ENTRY_PKI_CERT *cert_entry,
+    CERT_INFO_HANDLE cert_info,
+    const HSM_FILE_STAMP *cert_stamp,
+    const HSM_FILE_STAMP *key_stamp,
+    const char *new_cert_path,
+    const char *new_pk_path,
+    int64_t now
+)
+{
+    const char *alias = STRING_c_str(cert_entry->id);
+    const char *cert_path = STRING_c_str(cert_entry->cert_file);
+    const char *pk_path = STRING_c_str(cert_entry->private_key_file);
+
+    if (replace_file(new_pk_path, pk_path) != 0)
+    {
+        LOG_ERROR("Could not replace private key file for %s", alias);
+        cert_entry->renewal->renew_time = now + CERT_RENEWAL_RETRY_SECONDS;
+        certificate_info_destroy(cert_info);
+    }
+    else if (replace_file(new_cert_path, cert_path) != 0)
+    {
+        // the previous certificate does not match the renewed key, drop
+        // both so that the next request issues a new certificate
+        LOG_ERROR("Could not replace certificate file for %s, removing certificate", alias);
+        (void)store_index_remove(&store->store_entry->pki_certs, alias);
+        (void)delete_file(cert_path);
+        (void)delete_file(pk_path);
+        destroy_pki_cert(cert_entry);
+        certificate_info_destroy(cert_info);
+    }
+    else
+    {
+        // renames keep the file stamps of the renewed files
+        if (cert_entry->cert_info != NULL)
+        {
+            certificate_info_destroy(cert_entry->cert_info);
+        }
+        cert_entry->cert_info = cert_info;
+        cert_entry->cert_stamp = *cert_stamp;
+        cert_entry->key_stamp = *key_stamp;
+        LOG_INFO("Renewed certificate for %s", alias);
+    }
+}
+
+// Issues a new certificate for renewal into files next to the current ones
+// and swaps them in. Returns the time at which the certificate is due next.
+static int64_t renew_pki_cert(CRYPTO_STORE *store, const STORE_RENEWAL *renewal, int64_t now)
+{
+    int64_t result = now + CERT_RENEWAL_RETRY_SECONDS;
+    const char *alias = get_alias(renewal->props);
+    STRING_HANDLE cert_handle = NULL, pk_handle = NULL;
+    CERT_INFO_HANDLE cert_info = NULL;
+    HSM_FILE_STAMP cert_stamp, key_stamp;
+
+    if (((cert_handle = STRING_new()) == NULL) ||
+        ((pk_handle = STRING_new()) == NULL))
+    {
+        LOG_ERROR("Could not allocate string handles for storing certificate and key paths");
+    }
+    else if ((build_cert_file_paths(alias, cert_handle, pk_handle) != 0) ||
+             (STRING_concat(cert_handle, RENEWAL_FILE_EXT) != 0) ||
+             (STRING_concat(pk_handle, RENEWAL_FILE_EXT) != 0))
+    {
+        LOG_ERROR("Could not create file paths to renew certificate for %s", alias);
+    }
+    else if (issue_pki_cert(store, renewal->props, 0, STRING_c_str(pk_handle), STRING_c_str(cert_handle)) != 0)
+    {
+        LOG_ERROR("Could not renew certificate for %s", alias);
+    }
+    else if ((get_file_stamp(STRING_c_str(cert_handle), &cert_stamp) != 0) ||
+             (get_file_stamp(STRING_c_str(pk_handle), &key_stamp) != 0) ||
+             ((cert_info = prepare_cert_info_from_files(STRING_c_str(cert_handle),
+                                                        STRING_c_str(pk_handle))) == NULL))
+    {
+        LOG_ERROR("Could not load renewed certificate for %s", alias);
+    }
+    else
+    {
+        STORE_ENTRY_PKI_CERT *cert_entry;
+        int64_t valid_from = certificate_info_get_valid_from(cert_info);
+        int64_t valid_to = certificate_info_get_valid_to(cert_info);
+
+        if (valid_to <= renewal->valid_to)
+        {
+            // certificates are valid no longer than their issuer
+            LOG_ERROR("Renewing certificate for %s does not extend its validity, renewal stopped", alias);
+            result = HSM_RENEWAL_NEVER;
+        }
+        else
+        {
+            result = valid_from + ((valid_to - valid_from) * store->renewal_percent) / 100;
+        }
+
+        hsm_rwlock_write_lock(store->lock);
+        if (((cert_entry = get_pki_cert(store, alias)) == NULL) ||
+            (cert_entry->renewal == NULL) ||
+            (cert_entry->renewal->id != renewal->id))
+        {
+            // the alias was re-created or removed meanwhile, a new
+            // issuance schedules its own renewal
+            LOG_DEBUG("Certificate for %s changed during renewal", alias);
+            result = HSM_RENEWAL_NEVER;
+        }
+        else if (result == HSM_RENEWAL_NEVER)
+        {
+            cert_entry->renewal->renew_time = HSM_RENEWAL_NEVER;
+        }
+        else
+        {
+            cert_entry->renewal->valid_to = valid_to;
+            cert_entry->renewal->renew_time = result;
+            swap_renewed_cert(store, cert_entry, cert_info, &cert_stamp, &key_stamp,
+                              STRING_c_str(cert_handle), STRING_c_str(pk_handle), now);
+            cert_info = NULL;
+        }
+        hsm_rwlock_write_unlock(store->lock);
+    }
+
+    if (cert_info != NULL)
+    {
+        certificate_info_destroy(cert_info);
+    }
+    if (cert_handle != NULL)
+    {
+        if (is_file_valid(STRING_c_str(cert_handle)))
+        {
+            (void)delete_file(STRING_c_str(cert_handle));
+        }
+        STRING_delete(cert_handle);
+    }
+    if (pk_handle != NULL)
+    {
+        if (is_file_valid(STRING_c_str(pk_handle)))
+        {
+            (void)delete_file(STRING_c_str(pk_handle));
+        }
+        STRING_delete(pk_handle);
+    }
+
+    return result;
+}
+
+// Renewal worker callback, renews every certificate that is due and
+// returns when the next one is.
+static int64_t renew_due_certs(void *context, int64_t now)
+{
+    CRYPTO_STORE *store = (CRYPTO_STORE*)context;
+    int64_t result = HSM_RENEWAL_NEVER;
+    STORE_INDEX *cert_index = &store->store_entry->pki_certs;
+    STORE_RENEWAL **due = NULL;
+    size_t num_due = 0, index;
+
+    // the certificates are renewed with the store lock released
+    hsm_rwlock_read_lock(store->lock);
+    if ((cert_index->count != 0) &&
+        ((due = (STORE_RENEWAL**)calloc(cert_index->count, sizeof(STORE_RENEWAL*))) == NULL))
+    {
+        LOG_ERROR("Could not allocate memory to renew certificates");
+        result = now + CERT_RENEWAL_RETRY_SECONDS;
+    }
+    else
+    {
+        STORE_ENTRY_PKI_CERT *cert_entry;
+        size_t cursor = 0;
+        while ((cert_entry = (STORE_ENTRY_PKI_CERT*)store_index_next(cert_index, &cursor)) != NULL)
+        {
+            int64_t renew_time = (cert_entry->renewal != NULL) ? cert_entry->renewal->renew_time :
+                                                                  HSM_RENEWAL_NEVER;
+            if ((renew_time <= now) &&
+                ((due[num_due] = copy_store_renewal(cert_entry->renewal)) == NULL))
+            {
+                LOG_ERROR("Could not renew certificate for %s", STRING_c_str(cert_entry->id));
+                renew_time = now + CERT_RENEWAL_RETRY_SECONDS;
+            }
+            else if (renew_time <= now)
+            {
+                num_due++;
+            }
+
+            if ((renew_time > now) && (renew_time < result))
+            {
+                result = renew_time;
+            }
+        }
+    }
+    hsm_rwlock_read_unlock(store->lock);
+
+    for (index = 0; index < num_due; index++)
+    {
+        int64_t renew_time = renew_pki_cert(store, due[index], now);
+        if (renew_time < result)
+        {
+            result = renew_time;
+        }
+        destroy_store_renewal(due[index]);
+    }
+    if (due != NULL)
+    {
+        free(due);
+    }
+
+    return result;
+}
+
+//##############################################################################
+// Certificate reuse helpers
+//##############################################################################
+// Each field is preceded by a presence marker and hashed with its terminator
+// so that distinct property sets never hash the same input. The validity is
+// not part of the digest as it is relative to the time of the request, it is
+// checked against the remaining validity of the certificate instead.
+static int compute_cert_props_digest(CERT_PROPS_HANDLE cert_props_handle, unsigned char *digest)
+{
+    int result;
+    const char *fields[8];
+    uint32_t cert_type = (uint32_t)get_certificate_type(cert_props_handle);
+    unsigned char digest_buffer[USHAMaxHashSize];
+    USHAContext ctx;
+    size_t index;
+    int status;
+
+    fields[0] = get_alias(cert_props_handle);
+    fields[1] = get_issuer_alias(cert_props_handle);
+    fields[2] = get_common_name(cert_props_handle);
+    fields[3] = get_country_name(cert_props_handle);
+    fields[4] = get_state_name(cert_props_handle);
+    fields[5] = get_locality(cert_props_handle);
+    fields[6] = get_organization_name(cert_props_handle);
+    fields[7] = get_organization_unit(cert_props_handle);
+
+    status = USHAReset(&ctx, SHA256) ||
+             USHAInput(&ctx, (const uint8_t*)&cert_type, (unsigned int)sizeof(cert_type));
+    for (index = 0; (index < sizeof(fields) / sizeof(fields[0])) && (status == shaSuccess); index++)
+    {
+        uint8_t is_present = (fields[index] != NULL) ? 1 : 0;
+        status = USHAInput(&ctx, &is_present, 1) ||
+                 ((fields[index] != NULL) &&
+                  USHAInput(&ctx, (const uint8_t*)fields[index], (unsigned int)strlen(fields[index]) + 1));
+    }
+    if ((status != shaSuccess) || ((status = USHAResult(&ctx, digest_buffer)) != shaSuccess))
+    {
+        LOG_ERROR("Computing certificate properties digest failed %d", status);
+        result = __FAILURE__;
+    }
+    else
+    {
+        memcpy(digest, digest_buffer, SHA256HashSize);
+        result = 0;
+    }
+
+    return result;
+}
+
+// The digest of the properties a certificate was issued for is kept in a
+// file next to the certificate so that certificates are also reused across
+// restarts. The file is removed before a certificate is issued and written
+// once it is issued for a digest, so it never describes a certificate that
+// was issued for other properties.
+static STRING_HANDLE build_cert_props_file_path(const char *alias)
+{
+    STRING_HANDLE result;
+
+    if ((result = STRING_new()) == NULL)
+    {
+        LOG_ERROR("Could not allocate string handle for certificate properties file");
+    }
+    else if ((build_cert_file_paths(alias, result, NULL) != 0) ||
+             (STRING_concat(result, PROPS_FILE_EXT) != 0))
+    {
+        LOG_ERROR("Could not construct path to certificate properties file for %s", alias);
+        STRING_delete(result);
+        result = NULL;
+    }
+
+    return result;
+}
+
+static bool read_cert_props_digest(const char *alias, unsigned char *digest)
+{
+    bool result = false;
+    STRING_HANDLE props_file;
+
+    if ((props_file = build_cert_props_file_path(alias)) != NULL)
+    {
+        const char *props_path = STRING_c_str(props_file);
+        void *contents;
+        size_t contents_size = 0;
+
+        if (is_file_valid(props_path) &&
+            ((contents = read_file_into_buffer(props_path, &contents_size)) != NULL))
+        {
+            if (contents_size == SHA256HashSize)
+            {
+                memcpy(digest, contents, SHA256HashSize);
+                result = true;
+            }
+            free(contents);
+        }
+        STRING_delete(props_file);
+    }
+
+    return result;
+}
+
+static int write_cert_props_digest(const char *alias, const unsigned char *digest)
+{
+    int result;
+    STRING_HANDLE props_file;
+
+    if ((props_file = build_cert_props_file_path(alias)) == NULL)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        if (write_buffer_to_file(STRING_c_str(props_file), digest, SHA256HashSize, false) != 0)
+        {
+            LOG_ERROR("Could not write certificate properties file for %s", alias);
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = 0;
+        }
+        STRING_delete(props_file);
+    }
+
+    return result;
+}
+
+static void delete_cert_props_digest(const char *alias)
+{
+    STRING_HANDLE props_file;
+
+    if ((props_file = build_cert_props_file_path(alias)) != NULL)
+    {
+        const char *props_path = STRING_c_str(props_file);
+        if (is_file_valid(props_path))
+        {
+            (void)delete_file(props_path);
+        }
+        STRING_delete(props_file);
+    }
+}
+
+// Checks the digest the certificate of alias was last issued or reused for,
+// falling back to the persisted digest for certificates that have not been
+// requested since they were loaded.
+static bool is_cert_props_digest_equal
+(
+    CRYPTO_STORE *store,
+    const char *alias,
+    const unsigned char *digest
+)
+{
+    bool is_known;
+    unsigned char known_digest[SHA256HashSize];
+    STORE_ENTRY_PKI_CERT *cert_entry;
+
+    hsm_rwlock_read_lock(store->lock);
+    if ((is_known = ((cert_entry = get_pki_cert(store, alias)) != NULL) && cert_entry->has_props_digest))
+    {
+        memcpy(known_digest, cert_entry->props_digest, SHA256HashSize);
+    }
+    hsm_rwlock_read_unlock(store->lock);
+
+    if (!is_known)
+    {
+        is_known = read_cert_props_digest(alias, known_digest);
+    }
+
+    return is_known && (memcmp(known_digest, digest, SHA256HashSize) == 0);
+}
+
+// A certificate that matches the requested properties is reused when it
+// remains valid for at least reuse_percent of the requested validity.
+static bool is_cert_validity_reusable(CRYPTO_STORE *store, CERT_PROPS_HANDLE cert_props_handle)
+{
+    bool result;
+    const char *alias = get_alias(cert_props_handle);
+    CERT_INFO_HANDLE cert_info;
+
+    if ((cert_info = get_cached_cert_info(store, alias)) == NULL)
+    {
+        LOG_ERROR("Could not load certificate for %s to check its validity", alias);
+        result = false;
+    }
+    else
+    {
+        int64_t min_validity = (int64_t)((get_validity_seconds(cert_props_handle) * (uint64_t)store->reuse_percent) / 100);
+        int64_t remaining_validity = certificate_info_get_valid_to(cert_info) - (int64_t)time(NULL);
+        result = (remaining_validity >= min_validity);
+        certificate_info_destroy(cert_info);
+    }
+
+    return result;
+}
+
+// is_issued is set when the certificate was just issued for digest, which is
+// then persisted. A reused certificate already has the digest on disk.
+static void set_cert_props_digest
+(
+    CRYPTO_STORE *store,
+    const char *alias,
+    const unsigned char *digest,
+    bool is_issued
+)
+{
+    STORE_ENTRY_PKI_CERT *cert_entry;
+
+    if (is_issued && (write_cert_props_digest(alias, digest) != 0))
+    {
+        LOG_ERROR("Could not persist certificate properties for %s, it is re-issued after a restart", alias);
+    }
+    hsm_rwlock_write_lock(store->lock);
+    if ((cert_entry = get_pki_cert(store, alias)) != NULL)
+    {
+        memcpy(cert_entry->props_digest, digest, SHA256HashSize);
+        cert_entry->has_props_digest = true;
+    }
+    hsm_rwlock_write_unlock(store->lock);
+}
+
+//##############################################################################
+// STORE_ENTRY_PKI_TRUSTED_CERT helpers
+//##############################################################################
+static STORE_ENTRY_PKI_TRUSTED_CERT* create_pki_trusted_cert_entry
+(
+    const char *name,
+    const char *certificate_file
+)
+{
+    STORE_ENTRY_PKI_TRUSTED_CERT *result;
+
+    if ((result = calloc(1, sizeof(STORE_ENTRY_PKI_TRUSTED_CERT))) == NULL)
+    {
+        LOG_ERROR("Could not allocate memory to store the certificate for %s", name);
+    }
+    else if ((result->id = STRING_construct(name)) == NULL)
+    {
+        LOG_ERROR("Could not allocate string handle for %s", name);
+        free(result);
+        result = NULL;
+    }
+    else if ((result->cert_file = STRING_construct(certificate_file)) == NULL)
+    {
+        LOG_ERROR("Could not allocate string handle for the file path for %s", name);
+        STRING_delete(result->id);
+        free(result);
+        result = NULL;
+    }
+
+    return result;
+}
+
+static void destroy_trusted_cert(STORE_ENTRY_PKI_TRUSTED_CERT *trusted_cert)
+{
+    STRING_delete(trusted_cert->id);
+    STRING_delete(trusted_cert->cert_file);
+    free(trusted_cert);
+}
+
+static void invalidate_trust_bundle(CRYPTO_STORE *store)
+{
+    if (store->store_entry->trust_bundle != NULL)
+    {
+        certificate_info_destroy(store->store_entry->trust_bundle);
+        store->store_entry->trust_bundle = NULL;
+    }
+}
+
+static bool is_trust_bundle_valid(const CRYPTO_STORE *store)
+{
+    bool result;
+
+    if (store->store_entry->trust_bundle == NULL)
+    {
+        result = false;
+    }
+    else
+    {
+        STORE_ENTRY_PKI_TRUSTED_CERT *trusted_cert;
+        size_t cursor = 0;
+        result = true;
+        while (result &&
+               ((trusted_cert = (STORE_ENTRY_PKI_TRUSTED_CERT*)store_index_next(&store->store_entry->pki_trusted_certs,
+                                                                                 &cursor)) != NULL))
+        {
+            HSM_FILE_STAMP stamp;
+            if ((get_file_stamp(STRING_c_str(trusted_cert->cert_file), &stamp) != 0) ||
+                !is_file_stamp_equal(&stamp, &trusted_cert->stamp))
+            {
+                result = false;
+            }
+        }
+    }
+
+    return result;
+}
+
+static CERT_INFO_HANDLE build_trust_bundle(CRYPTO_STORE *store)
+{
+    CERT_INFO_HANDLE result;
+    STORE_INDEX *cert_index = &store->store_entry->pki_trusted_certs;
+    int list_count = (int)cert_index->count;
+    char **trusted_files;
+
+    if ((trusted_files = (char **)calloc(list_count, sizeof(const char*))) == NULL)
+    {
+        LOG_ERROR("Could not allocate memory to store list of trusted cert files");
+        result = NULL;
+    }
+    else
+    {
+        char *all_certs = NULL;
+        STORE_ENTRY_PKI_TRUSTED_CERT *trusted_cert;
+        size_t cursor = 0;
+        int index = 0;
+
+        // the stamps are taken before the files are read so that a concurrent
+        // rewrite of any file is detected on the next request
+        while ((trusted_cert = (STORE_ENTRY_PKI_TRUSTED_CERT*)store_index_next(cert_index, &cursor)) != NULL)
+        {
+            trusted_files[index] = (char*)STRING_c_str(trusted_cert->cert_file);
+            if (get_file_stamp(trusted_files[index], &trusted_cert->stamp) != 0)
+            {
+                LOG_ERROR("Could not stat trusted certificate file %s", trusted_files[index]);
+                break;
+            }
+            index++;
+        }
+        if (index != list_count)
+        {
+            result = NULL;
+        }
+        else if (list_count == 1)
+        {
+            // the common case of a single trusted CA file is parsed straight
+            // from the file without building a concatenated copy. The file
+            // is external and may be rewritten in place, so it is read into
+            // memory rather than mapped.
+            size_t cert_size = 0;
+            void *cert_contents;
+            if ((cert_contents = read_file_into_buffer(trusted_files[0], &cert_size)) == NULL)
+            {
+                LOG_ERROR("Could not read trusted cert file %s", trusted_files[0]);
+                result = NULL;
+            }
+            else
+            {
+                if ((result = certificate_info_create_from_buffer((const char*)cert_contents, cert_size, NULL, 0, PRIVATE_KEY_UNKNOWN)) == NULL)
+                {
+                    LOG_ERROR("Could not parse the trusted certificates");
+                }
+                free(cert_contents);
+            }
+        }
+        else if ((all_certs = concat_files_to_cstring((const char**)trusted_files, list_count)) == NULL)
+        {
+            LOG_ERROR("Could not concat all the trusted cert files");
+            result = NULL;
+        }
+        else if ((result = certificate_info_create(all_certs, NULL, 0, PRIVATE_KEY_UNKNOWN)) == NULL)
+        {
+            LOG_ERROR("Could not parse the trusted certificates");
+        }
+
+        if (result != NULL)
+        {
+            invalidate_trust_bundle(store);
+            store->store_entry->trust_bundle = result;
+            result = certificate_info_clone(result);
+        }
+        if (all_certs != NULL)
+        {
+            free(all_certs);
+        }
+        free(trusted_files);
+    }
+
+    return result;
+}
+
+static CERT_INFO_HANDLE prepare_trusted_certs_info(CRYPTO_STORE *store)
+{
+    CERT_INFO_HANDLE result = NULL;
+    bool is_empty;
+
+    hsm_rwlock_read_lock(store->lock);
+    is_empty = (store->store_entry->pki_trusted_certs.count == 0);
+    if (!is_empty && is_trust_bundle_valid(store))
+    {
+        result = certificate_info_clone(store->store_entry->trust_bundle);
+    }
+    hsm_rwlock_read_unlock(store->lock);
+
+    if (!is_empty && (result == NULL))
+    {
+        hsm_rwlock_write_lock(store->lock);
+        if (store->store_entry->pki_trusted_certs.count == 0)
+        {
+            LOG_DEBUG("Trusted certificates were removed while building the trust bundle");
+        }
+        else if (is_trust_bundle_valid(store))
+        {
+            // another thread rebuilt the bundle while the lock was released
+            result = certificate_info_clone(store->store_entry->trust_bundle);
+        }
+        else
+        {
+            result = build_trust_bundle(store);
+        }
+        hsm_rwlock_write_unlock(store->lock);
+    }
+
+    return result;
+}
+
+static void destroy_pki_trusted_certs(STORE_INDEX *trusted_certs)
 {
-    bool result;
-    STORE_ENTRY_PKI_CERT *pki_cert = (STORE_ENTRY_PKI_CERT*)item;
-    if (strcmp(STRING_c_str(pki_cert->id), (const char*)match_context) == 0)
-    {
-        destroy_pki_cert(pki_cert);
-        *continue_processing = false;
-        result = true;
-    }
-    else
+    STORE_ENTRY_PKI_TRUSTED_CERT *trusted_cert;
+    size_t cursor = 0;
+    while ((trusted_cert = (STORE_ENTRY_PKI_TRUSTED_CERT*)store_index_next(trusted_certs, &cursor)) != NULL)
     {
-        *continue_processing = true;
-        result = false;
+        destroy_trusted_cert(trusted_cert);
     }
-
-    return result;
+    store_index_deinit(trusted_certs);
 }
 
-static int put_pki_cert
+static int put_pki_trusted_cert
 (
     CRYPTO_STORE *store,
     const char *alias,
-    const char *issuer_alias,
-    const char *certificate_file,
-    const char *private_key_file
+    const char *certificate_file
 )
 {
     int result;
-    STORE_ENTRY_PKI_CERT *cert_entry;
+    STORE_ENTRY_PKI_TRUSTED_CERT *trusted_cert_entry;
+    STORE_INDEX *cert_index = &store->store_entry->pki_trusted_certs;
 
-    cert_entry = create_pki_cert_entry(alias, issuer_alias, certificate_file, private_key_file);
-    if (cert_entry == NULL)
+    trusted_cert_entry = create_pki_trusted_cert_entry(alias, certificate_file);
+    if (trusted_cert_entry == NULL)
     {
-        LOG_ERROR("Could not allocate memory to store certificate and or key for %s", alias);
+        LOG_ERROR("Could not allocate memory to store trusted certificate for %s", alias);
         result = __FAILURE__;
     }
     else
     {
-        SINGLYLINKEDLIST_HANDLE cert_list = store->store_entry->pki_certs;
-        (void)singlylinkedlist_remove_if(cert_list, remove_cert_entry_cb, alias);
-        if (singlylinkedlist_add(cert_list, cert_entry) == NULL)
+        STORE_ENTRY_PKI_TRUSTED_CERT *old_entry;
+
+        hsm_rwlock_write_lock(store->lock);
+        invalidate_trust_bundle(store);
+        if ((old_entry = (STORE_ENTRY_PKI_TRUSTED_CERT*)store_index_remove(cert_index, alias)) != NULL)
+        {
+            destroy_trusted_cert(old_entry);
+        }
+        if (store_index_add(cert_index, STRING_c_str(trusted_cert_entry->id), trusted_cert_entry) != 0)
         {
             LOG_ERROR("Could not insert cert and key in the store");
-            destroy_pki_cert(cert_entry);
+            destroy_trusted_cert(trusted_cert_entry);
             result = __FAILURE__;
         }
         else
         {
             result = 0;
         }
+        hsm_rwlock_write_unlock(store->lock);
     }
     return result;
 }
 
-static int remove_pki_cert(CRYPTO_STORE *store, const char *alias)
+static int remove_pki_trusted_cert(CRYPTO_STORE *store, const char *alias)
 {
     int result;
-    SINGLYLINKEDLIST_HANDLE certs_list = store->store_entry->pki_certs;
-    LIST_ITEM_HANDLE list_item = singlylinkedlist_find(certs_list, find_pki_cert_cb, alias);
-    if (list_item == NULL)
+    STORE_ENTRY_PKI_TRUSTED_CERT *pki_cert;
+
+    hsm_rwlock_write_lock(store->lock);
+    if ((pki_cert = (STORE_ENTRY_PKI_TRUSTED_CERT*)store_index_remove(&store->store_entry->pki_trusted_certs,
+                                                                      alias)) == NULL)
     {
-        LOG_ERROR("Certificate not found %s", alias);
+        LOG_ERROR("Trusted certificate not found %s", alias);
         result = __FAILURE__;
     }
     else
     {
-        STORE_ENTRY_PKI_CERT *pki_cert;
-        pki_cert = (STORE_ENTRY_PKI_CERT*)singlylinkedlist_item_get_value(list_item);
-        destroy_pki_cert(pki_cert);
-        singlylinkedlist_remove(certs_list, list_item);
+        invalidate_trust_bundle(store);
+        destroy_trusted_cert(pki_cert);
         result = 0;
     }
+    hsm_rwlock_write_unlock(store->lock);
 
     return result;
 }
 
-static void destroy_pki_certs(SINGLYLINKEDLIST_HANDLE certs)
-{
-    LIST_ITEM_HANDLE list_item;
-    while ((list_item = singlylinkedlist_get_head_item(certs)) != NULL)
-    {
-        STORE_ENTRY_PKI_CERT *pki_cert;
-        pki_cert = (STORE_ENTRY_PKI_CERT*)singlylinkedlist_item_get_value(list_item);
-        destroy_pki_cert(pki_cert);
-        singlylinkedlist_remove(certs, list_item);
-    }
-}
-
 //##############################################################################
-// STORE_ENTRY_PKI_TRUSTED_CERT helpers
+// Certificate verification cache helpers
 //##############################################################################
-
-static bool find_pki_trusted_cert_cb(LIST_ITEM_HANDLE list_item, const void *match_context)
+static STRING_HANDLE build_verify_cache_file_path(const char *file_name)
 {
-    bool result;
-    STORE_ENTRY_PKI_CERT *cert = (STORE_ENTRY_PKI_CERT*)singlylinkedlist_item_get_value(list_item);
-    if (strcmp(STRING_c_str(cert->id), (const char*)match_context) == 0)
+    STRING_HANDLE result;
+    const char *base_dir_path = get_base_dir();
+
+    if ((result = STRING_construct(base_dir_path)) == NULL)
     {
-        result = true;
+        LOG_ERROR("Could not allocate string handle for verification cache path");
     }
-    else
+    else if ((STRING_concat(result, SLASH) != 0) ||
+             (STRING_concat(result, file_name) != 0))
     {
-        result = false;
+        LOG_ERROR("Could not construct path to verification cache");
+        STRING_delete(result);
+        result = NULL;
     }
 
     return result;
 }
 
-static STORE_ENTRY_PKI_TRUSTED_CERT* create_pki_trusted_cert_entry
-(
-    const char *name,
-    const char *certificate_file
-)
+// loads the cache file, a missing or malformed file leaves the cache empty
+// which only costs a full verification of every certificate
+static void load_verify_cache(CRYPTO_STORE *store)
 {
-    STORE_ENTRY_PKI_TRUSTED_CERT *result;
+    STRING_HANDLE cache_file;
+    unsigned char *contents = NULL;
+    size_t contents_size = 0;
+    const size_t entry_size = CERT_VERIFICATION_ID_SIZE + sizeof(int64_t);
 
-    if ((result = malloc(sizeof(STORE_ENTRY_PKI_TRUSTED_CERT))) == NULL)
+    if ((cache_file = build_verify_cache_file_path(VERIFY_CACHE_FILE)) != NULL)
     {
-        LOG_ERROR("Could not allocate memory to store the certificate for %s", name);
-    }
-    else if ((result->id = STRING_construct(name)) == NULL)
-    {
-        LOG_ERROR("Could not allocate string handle for %s", name);
-        free(result);
-        result = NULL;
+        const char *cache_path = STRING_c_str(cache_file);
+        if (!is_file_valid(cache_path))
+        {
+            LOG_DEBUG("Verification cache not found %s", cache_path);
+        }
+        else if ((contents = (unsigned char*)read_file_into_buffer(cache_path, &contents_size)) == NULL)
+        {
+            LOG_ERROR("Could not read verification cache %s", cache_path);
+        }
+        else if ((contents_size < sizeof(VERIFY_CACHE_MAGIC)) ||
+                 (memcmp(contents, VERIFY_CACHE_MAGIC, sizeof(VERIFY_CACHE_MAGIC)) != 0) ||
+                 (((contents_size - sizeof(VERIFY_CACHE_MAGIC)) % entry_size) != 0) ||
+                 (((contents_size - sizeof(VERIFY_CACHE_MAGIC)) / entry_size) > VERIFY_CACHE_MAX_ENTRIES))
+        {
+            LOG_ERROR("Ignoring malformed verification cache %s", cache_path);
+        }
+        else
+        {
+            size_t index, num_entries = (contents_size - sizeof(VERIFY_CACHE_MAGIC)) / entry_size;
+            VERIFIED_CERT *verified_certs = NULL;
+            int64_t now = (int64_t)time(NULL);
+
+            if ((num_entries != 0) &&
+                ((verified_certs = (VERIFIED_CERT*)calloc(VERIFY_CACHE_MAX_ENTRIES, sizeof(VERIFIED_CERT))) == NULL))
+            {
+                LOG_ERROR("Could not allocate memory for verification cache");
+            }
+            else
+            {
+                size_t num_verified_certs = 0;
+                const unsigned char *cursor = contents + sizeof(VERIFY_CACHE_MAGIC);
+                for (index = 0; index < num_entries; index++, cursor += entry_size)
+                {
+                    VERIFIED_CERT *entry = &verified_certs[num_verified_certs];
+                    memcpy(entry->id, cursor, CERT_VERIFICATION_ID_SIZE);
+                    memcpy(&entry->not_after, cursor + CERT_VERIFICATION_ID_SIZE, sizeof(int64_t));
+                    if (entry->not_after > now)
+                    {
+                        num_verified_certs++;
+                    }
+                }
+                hsm_rwlock_write_lock(store->lock);
+                store->store_entry->verified_certs = verified_certs;
+                store->store_entry->num_verified_certs = num_verified_certs;
+                hsm_rwlock_write_unlock(store->lock);
+                LOG_DEBUG("Loaded %zu certificate verification results", num_verified_certs);
+            }
+        }
+        STRING_delete(cache_file);
     }
-    else if ((result->cert_file = STRING_construct(certificate_file)) == NULL)
+
+    if (contents != NULL)
     {
-        LOG_ERROR("Could not allocate string handle for the file path for %s", name);
-        STRING_delete(result->id);
-        free(result);
-        result = NULL;
+        free(contents);
     }
-
-    return result;
 }
 
-static void destroy_trusted_cert(STORE_ENTRY_PKI_TRUSTED_CERT *trusted_cert)
+// the verify cache lock must be held. the file is replaced atomically so
+// that a crash never leaves a partially written cache behind.
+static int save_verify_cache(const VERIFIED_CERT *verified_certs, size_t num_verified_certs)
 {
-    STRING_delete(trusted_cert->id);
-    STRING_delete(trusted_cert->cert_file);
-    free(trusted_cert);
-}
+    int result;
+    STRING_HANDLE cache_file = NULL, temp_file = NULL;
+    unsigned char *contents = NULL;
+    const size_t entry_size = CERT_VERIFICATION_ID_SIZE + sizeof(int64_t);
+    size_t contents_size = sizeof(VERIFY_CACHE_MAGIC) + (num_verified_certs * entry_size);
 
-static bool remove_trusted_cert_entry_cb
-(
-    const void* item,
-    const void* match_context,
-    bool* continue_processing
-)
-{
-    bool result;
-    STORE_ENTRY_PKI_TRUSTED_CERT* trusted_cert = (STORE_ENTRY_PKI_TRUSTED_CERT*)item;
-    if (strcmp(STRING_c_str(trusted_cert->id), (const char*)match_context) == 0)
+    if (((cache_file = build_verify_cache_file_path(VERIFY_CACHE_FILE)) == NULL) ||
+        ((temp_file = build_verify_cache_file_path(VERIFY_CACHE_TEMP_FILE)) == NULL))
     {
-        destroy_trusted_cert(trusted_cert);
-        *continue_processing = false;
-        result = true;
+        result = __FAILURE__;
     }
-    else
+    else if ((contents = (unsigned char*)malloc(contents_size)) == NULL)
     {
-        *continue_processing = true;
-        result = false;
+        LOG_ERROR("Could not allocate memory for verification cache");
+        result = __FAILURE__;
     }
-
-    return result;
-}
-
-static CERT_INFO_HANDLE prepare_trusted_certs_info(CRYPTO_STORE *store)
-{
-    CERT_INFO_HANDLE result;
-    LIST_ITEM_HANDLE list_item;
-    SINGLYLINKEDLIST_HANDLE cert_list = store->store_entry->pki_trusted_certs;
-    int list_count = 0;
-
-    list_item = singlylinkedlist_get_head_item(cert_list);
-    while (list_item != NULL)
+    else
     {
-        list_count++;
-        list_item = singlylinkedlist_get_next_item(list_item);
-    }
+        size_t index;
+        unsigned char *cursor = contents + sizeof(VERIFY_CACHE_MAGIC);
 
-    if (list_count > 0)
-    {
-        char **trusted_files;
-        int index = 0;
-        if ((trusted_files = (char **)calloc(list_count, sizeof(const char*))) == NULL)
+        memcpy(contents, VERIFY_CACHE_MAGIC, sizeof(VERIFY_CACHE_MAGIC));
+        for (index = 0; index < num_verified_certs; index++, cursor += entry_size)
         {
-            LOG_ERROR("Could not allocate memory to store list of trusted cert files");
-            result = NULL;
+            const VERIFIED_CERT *entry = &verified_certs[index];
+            memcpy(cursor, entry->id, CERT_VERIFICATION_ID_SIZE);
+            memcpy(cursor + CERT_VERIFICATION_ID_SIZE, &entry->not_after, sizeof(int64_t));
+        }
+
+        if (write_buffer_to_file(STRING_c_str(temp_file), contents, contents_size, true) != 0)
+        {
+            LOG_ERROR("Could not write verification cache %s", STRING_c_str(temp_file));
+            result = __FAILURE__;
+        }
+        else if (replace_file(STRING_c_str(temp_file), STRING_c_str(cache_file)) != 0)
+        {
+            LOG_ERROR("Could not replace verification cache %s", STRING_c_str(cache_file));
+            result = __FAILURE__;
         }
         else
         {
-            char *all_certs;
-            list_item = singlylinkedlist_get_head_item(cert_list);
-            while (list_item != NULL)
-            {
-                STORE_ENTRY_PKI_TRUSTED_CERT *trusted_cert;
-                trusted_cert = (STORE_ENTRY_PKI_TRUSTED_CERT*)singlylinkedlist_item_get_value(list_item);
-                trusted_files[index] = (char*)STRING_c_str(trusted_cert->cert_file);
-                index++;
-                list_item = singlylinkedlist_get_next_item(list_item);
-            }
-            if ((all_certs = concat_files_to_cstring((const char**)trusted_files, list_count)) == NULL)
-            {
-                LOG_ERROR("Could not concat all the trusted cert files");
-                result = NULL;
-            }
-            else
-            {
-                result = certificate_info_create(all_certs, NULL, 0, PRIVATE_KEY_UNKNOWN);
-                free(all_certs);
-            }
-            free(trusted_files);
+            result = 0;
         }
     }
-    else
+
+    if (contents != NULL)
     {
-        result = NULL;
+        free(contents);
+    }
+    if (temp_file != NULL)
+    {
+        STRING_delete(temp_file);
+    }
+    if (cache_file != NULL)
+    {
+        STRING_delete(cache_file);
     }
 
     return result;
 }
 
-static void destroy_pki_trusted_certs(SINGLYLINKEDLIST_HANDLE trusted_certs)
+static bool is_cert_verification_cached
+(
+    CRYPTO_STORE *store,
+    const unsigned char *id,
+    int64_t not_after
+)
 {
-    LIST_ITEM_HANDLE list_item;
-    while ((list_item = singlylinkedlist_get_head_item(trusted_certs)) != NULL)
+    bool result = false;
+    size_t index;
+
+    hsm_rwlock_read_lock(store->lock);
+    for (index = 0; (index < store->store_entry->num_verified_certs) && !result; index++)
     {
-        STORE_ENTRY_PKI_TRUSTED_CERT *trusted_cert;
-        trusted_cert = (STORE_ENTRY_PKI_TRUSTED_CERT*)singlylinkedlist_item_get_value(list_item);
-        destroy_trusted_cert(trusted_cert);
-        singlylinkedlist_remove(trusted_certs, list_item);
+        const VERIFIED_CERT *entry = &store->store_entry->verified_certs[index];
+        result = (memcmp(entry->id, id, CERT_VERIFICATION_ID_SIZE) == 0) &&
+                 (entry->not_after == not_after);
     }
+    hsm_rwlock_read_unlock(store->lock);
+
+    return result && (not_after > (int64_t)time(NULL));
 }
 
-static int put_pki_trusted_cert
+static int add_cert_verification
 (
     CRYPTO_STORE *store,
-    const char *alias,
-    const char *certificate_file
+    const unsigned char *id,
+    int64_t not_after
 )
 {
     int result;
-    STORE_ENTRY_PKI_TRUSTED_CERT *trusted_cert_entry;
-    SINGLYLINKEDLIST_HANDLE cert_list = store->store_entry->pki_trusted_certs;
-    (void)singlylinkedlist_remove_if(cert_list, remove_trusted_cert_entry_cb, alias);
-    trusted_cert_entry = create_pki_trusted_cert_entry(alias, certificate_file);
-    if (trusted_cert_entry == NULL)
+    CRYPTO_STORE_ENTRY *store_entry = store->store_entry;
+    VERIFIED_CERT verified_certs[VERIFY_CACHE_MAX_ENTRIES];
+    size_t num_verified_certs = 0;
+    uint64_t version = 0;
+
+    hsm_rwlock_write_lock(store->lock);
+    if ((store_entry->verified_certs == NULL) &&
+        ((store_entry->verified_certs = (VERIFIED_CERT*)calloc(VERIFY_CACHE_MAX_ENTRIES, sizeof(VERIFIED_CERT))) == NULL))
     {
-        LOG_ERROR("Could not allocate memory to store trusted certificate for %s", alias);
+        LOG_ERROR("Could not allocate memory for verification cache");
         result = __FAILURE__;
     }
     else
     {
-        if (singlylinkedlist_add(cert_list, trusted_cert_entry) == NULL)
+        size_t index = 0, slot = 0, num_live = 0;
+        int64_t now = (int64_t)time(NULL);
+
+        // drop expired results and any earlier result for the same id
+        for (index = 0; index < store_entry->num_verified_certs; index++)
         {
-            LOG_ERROR("Could not insert cert and key in the store");
-            destroy_trusted_cert(trusted_cert_entry);
-            result = __FAILURE__;
+            VERIFIED_CERT *entry = &store_entry->verified_certs[index];
+            if ((entry->not_after > now) &&
+                (memcmp(entry->id, id, CERT_VERIFICATION_ID_SIZE) != 0))
+            {
+                store_entry->verified_certs[num_live++] = *entry;
+            }
+        }
+
+        if (num_live == VERIFY_CACHE_MAX_ENTRIES)
+        {
+            // evict the result that expires first
+            for (index = 1; index < num_live; index++)
+            {
+                if (store_entry->verified_certs[index].not_after < store_entry->verified_certs[slot].not_after)
+                {
+                    slot = index;
+                }
+            }
         }
         else
         {
-            result = 0;
+            slot = num_live++;
+        }
+        memcpy(store_entry->verified_certs[slot].id, id, CERT_VERIFICATION_ID_SIZE);
+        store_entry->verified_certs[slot].not_after = not_after;
+        store_entry->num_verified_certs = num_live;
+
+        // the file is written from a copy so that lookups do not wait for it
+        num_verified_certs = num_live;
+        memcpy(verified_certs, store_entry->verified_certs, num_live * sizeof(VERIFIED_CERT));
+        version = ++store_entry->verified_certs_version;
+        result = 0;
+    }
+    hsm_rwlock_write_unlock(store->lock);
+
+    if (result == 0)
+    {
+        hsm_mutex_lock(store->verify_cache_lock);
+        // a newer copy may already have been written by another thread
+        if (version > store->saved_verify_version)
+        {
+            if ((result = save_verify_cache(verified_certs, num_verified_certs)) == 0)
+            {
+                store->saved_verify_version = version;
+            }
         }
+        hsm_mutex_unlock(store->verify_cache_lock);
     }
+
     return result;
 }
 
-static int remove_pki_trusted_cert(CRYPTO_STORE *store, const char *alias)
+// verify_certificate with the result of a successful verification remembered
+// across restarts. the id covers every certificate in both files so any
+// change to the certificate, its chain or its issuer is verified again.
+// Certificates are verified with the verifier of issuer_alias.
+static int verify_certificate_with_cache
+(
+    CRYPTO_STORE *store,
+    const char *cert_file_path,
+    const char *issuer_alias,
+    const char *issuer_cert_path,
+    bool *cert_verified
+)
 {
     int result;
-    SINGLYLINKEDLIST_HANDLE certs_list = store->store_entry->pki_trusted_certs;
-    LIST_ITEM_HANDLE list_item = singlylinkedlist_find(certs_list, find_pki_trusted_cert_cb, alias);
-    if (list_item == NULL)
+    unsigned char id[CERT_VERIFICATION_ID_SIZE];
+    int64_t not_after = 0;
+    bool has_id;
+    STORE_VERIFIER *verifier;
+
+    if (get_certificate_verification_id(cert_file_path, issuer_cert_path, id, sizeof(id), &not_after) != 0)
     {
-        LOG_ERROR("Trusted certificate not found %s", alias);
-        result = __FAILURE__;
+        LOG_DEBUG("Could not compute verification id for %s", cert_file_path);
+        has_id = false;
     }
     else
     {
-        STORE_ENTRY_PKI_TRUSTED_CERT *pki_cert;
-        pki_cert = (STORE_ENTRY_PKI_TRUSTED_CERT*)singlylinkedlist_item_get_value(list_item);
-        destroy_trusted_cert(pki_cert);
-        singlylinkedlist_remove(certs_list, list_item);
+        has_id = true;
+    }
+
+    if (has_id && is_cert_verification_cached(store, id, not_after))
+    {
+        LOG_DEBUG("Certificate %s verified previously using %s", cert_file_path, issuer_cert_path);
+        *cert_verified = true;
         result = 0;
     }
+    else if ((verifier = acquire_store_verifier(store, issuer_alias, issuer_cert_path)) == NULL)
+    {
+        LOG_ERROR("Could not get verifier for issuer %s", issuer_alias);
+        result = __FAILURE__;
+    }
+    else
+    {
+        if ((result = verify_certificate_with_verifier(cert_file_path, verifier->pki_verifier, cert_verified)) != 0)
+        {
+            LOG_ERROR("Error trying to verify certificate %s", cert_file_path);
+        }
+        else if (has_id && *cert_verified && (add_cert_verification(store, id, not_after) != 0))
+        {
+            // the result is still valid, it is only not remembered
+            LOG_ERROR("Could not cache verification result for %s", cert_file_path);
+        }
+        release_store_verifier(verifier);
+    }
 
     return result;
 }
@@ -1292,59 +3510,40 @@ static CRYPTO_STORE* create_store(const char *store_name)
 {
     CRYPTO_STORE_ENTRY *store_entry;
     STRING_HANDLE store_id;
+    HSM_RWLOCK_HANDLE lock;
+    HSM_MUTEX_HANDLE verify_cache_lock;
     CRYPTO_STORE *result;
 
     if ((result = (CRYPTO_STORE*)malloc(sizeof(CRYPTO_STORE))) == NULL)
     {
         LOG_ERROR("Could not allocate memory to create the store");
     }
-    else if ((store_entry = (CRYPTO_STORE_ENTRY*)malloc(sizeof(CRYPTO_STORE_ENTRY))) == NULL)
+    else if ((store_entry = (CRYPTO_STORE_ENTRY*)calloc(1, sizeof(CRYPTO_STORE_ENTRY))) == NULL)
     {
         LOG_ERROR("Could not allocate memory for store entry");
         free(result);
         result = NULL;
     }
-    else if ((store_entry->sas_keys = singlylinkedlist_create()) == NULL)
-    {
-        LOG_ERROR("Could not allocate SAS keys list");
-        free(store_entry);
-        free(result);
-        result = NULL;
-    }
-    else if ((store_entry->sym_enc_keys = singlylinkedlist_create()) == NULL)
-    {
-        LOG_ERROR("Could not allocate encryption keys list");
-        singlylinkedlist_destroy(store_entry->sas_keys);
-        free(store_entry);
-        free(result);
-        result = NULL;
-    }
-    else if ((store_entry->pki_certs = singlylinkedlist_create()) == NULL)
+    else if ((store_id = STRING_construct(store_name)) == NULL)
     {
-        LOG_ERROR("Could not allocate certs list");
-        singlylinkedlist_destroy(store_entry->sym_enc_keys);
-        singlylinkedlist_destroy(store_entry->sas_keys);
+        LOG_ERROR("Could not allocate store id");
         free(store_entry);
         free(result);
         result = NULL;
     }
-    else if ((store_entry->pki_trusted_certs = singlylinkedlist_create()) == NULL)
+    else if ((lock = hsm_rwlock_create()) == NULL)
     {
-        LOG_ERROR("Could not allocate trusted certs list");
-        singlylinkedlist_destroy(store_entry->pki_certs);
-        singlylinkedlist_destroy(store_entry->sym_enc_keys);
-        singlylinkedlist_destroy(store_entry->sas_keys);
+        LOG_ERROR("Could not create store lock");
+        STRING_delete(store_id);
         free(store_entry);
         free(result);
         result = NULL;
     }
-    else if ((store_id = STRING_construct(store_name)) == NULL)
+    else if ((verify_cache_lock = hsm_mutex_create()) == NULL)
     {
-        LOG_ERROR("Could not allocate store id");
-        singlylinkedlist_destroy(store_entry->pki_trusted_certs);
-        singlylinkedlist_destroy(store_entry->pki_certs);
-        singlylinkedlist_destroy(store_entry->sym_enc_keys);
-        singlylinkedlist_destroy(store_entry->sas_keys);
+        LOG_ERROR("Could not create verification cache lock");
+        hsm_rwlock_destroy(lock);
+        STRING_delete(store_id);
         free(store_entry);
         free(result);
         result = NULL;
@@ -1354,6 +3553,14 @@ static CRYPTO_STORE* create_store(const char *store_name)
         result->ref_count = 1;
         result->store_entry = store_entry;
         result->id = store_id;
+        result->lock = lock;
+        result->verify_cache_lock = verify_cache_lock;
+        result->saved_verify_version = 0;
+        result->packed = NULL;
+        result->renewal = NULL;
+        result->renewal_percent = 0;
+        result->renewal_count = 0;
+        result->reuse_percent = 0;
     }
 
     return result;
@@ -1361,16 +3568,29 @@ static CRYPTO_STORE* create_store(const char *store_name)
 
 static void destroy_store(CRYPTO_STORE *store)
 {
+    // waits for a renewal in progress, which uses the store
+    if (store->renewal != NULL)
+    {
+        hsm_renewal_destroy(store->renewal);
+    }
     STRING_delete(store->id);
-    destroy_pki_trusted_certs(store->store_entry->pki_trusted_certs);
-    singlylinkedlist_destroy(store->store_entry->pki_trusted_certs);
-    destroy_pki_certs(store->store_entry->pki_certs);
-    singlylinkedlist_destroy(store->store_entry->pki_certs);
-    destroy_keys(store->store_entry->sym_enc_keys);
-    singlylinkedlist_destroy(store->store_entry->sym_enc_keys);
-    destroy_keys(store->store_entry->sas_keys);
-    singlylinkedlist_destroy(store->store_entry->sas_keys);
+    invalidate_trust_bundle(store);
+    if (store->store_entry->verified_certs != NULL)
+    {
+        free(store->store_entry->verified_certs);
+    }
+    destroy_verifiers(&store->store_entry->verifiers);
+    destroy_pki_trusted_certs(&store->store_entry->pki_trusted_certs);
+    destroy_pki_certs(&store->store_entry->pki_certs);
+    destroy_keys(&store->store_entry->sym_enc_keys);
+    destroy_keys(&store->store_entry->sas_keys);
     free(store->store_entry);
+    hsm_rwlock_destroy(store->lock);
+    hsm_mutex_destroy(store->verify_cache_lock);
+    if (store->packed != NULL)
+    {
+        hsm_packed_store_close(store->packed);
+    }
     free(store);
 }
 
@@ -1477,6 +3697,7 @@ static int remove_if_cert_and_key_exist_by_alias
             }
             else
             {
+                delete_cert_props_digest(alias);
                 result = 0;
             }
         }
@@ -1524,9 +3745,22 @@ static int load_if_cert_and_key_exist_by_alias
         bool verify_status = false;
         if (is_file_valid(cert_file_path) && is_file_valid(key_file_path))
         {
-            if (verify_certificate_helper(handle, alias, issuer_alias,
-                                          cert_file_path, key_file_path,
-                                          &verify_status) != 0)
+            bool key_matches = true;
+            if (!is_pki_cert_loaded((CRYPTO_STORE*)handle, alias) &&
+                (check_certificate_key(cert_file_path, key_file_path, &key_matches) != 0))
+            {
+                LOG_ERROR("Failure when checking the private key for alias %s", alias);
+                result = LOAD_ERR_FAILED;
+            }
+            else if (!key_matches)
+            {
+                // a renewal was interrupted between replacing the key and
+                // the certificate, the alias is issued again
+                LOG_ERROR("Private key does not match the certificate for alias %s", alias);
+                result = LOAD_ERR_NOT_FOUND;
+            }
+            else if (verify_certificate_helper(handle, alias, issuer_alias,
+                                               cert_file_path, &verify_status) != 0)
             {
                 LOG_ERROR("Failure when verifying certificate for alias %s", alias);
                 result = LOAD_ERR_FAILED;
@@ -1819,7 +4053,9 @@ static int hsm_provision_edge_certificates(void)
             // all required certificate files are available/generated now setup the trust bundle
             if (trusted_certs_path == NULL)
             {
-                // certificates were generated so set the Owner CA as the trusted CA cert
+                // certificates were generated so set the Owner CA as the trusted CA cert.
+                // the store is not published until provisioning completes so the
+                // entry cannot be removed concurrently and no lock is required here
                 STORE_ENTRY_PKI_CERT *store_entry;
                 trusted_ca = NULL;
                 if ((store_entry = get_pki_cert(g_crypto_store, OWNER_CA_ALIAS)) == NULL)
@@ -1845,21 +4081,107 @@ static int hsm_provision_edge_certificates(void)
                 result = put_pki_trusted_cert(g_crypto_store, DEFAULT_TRUSTED_CA_ALIAS, trusted_ca);
             }
         }
-        if (trusted_certs_path != NULL)
+        if (trusted_certs_path != NULL)
+        {
+            free(trusted_certs_path);
+        }
+        if (device_ca_path != NULL)
+        {
+            free(device_ca_path);
+        }
+        if (device_pk_path != NULL)
+        {
+            free(device_pk_path);
+        }
+    }
+
+    return result;
+}
+
+// The key pool is an optimization, issuance falls back to generating keys
+// on demand so a pool that cannot be started is not a provisioning error.
+static void start_key_pool_if_enabled(void)
+{
+    char *env_value = NULL;
+
+    if (hsm_get_env(ENV_HSM_KEY_POOL_SIZE, &env_value) != 0)
+    {
+        LOG_ERROR("Could not lookup env variable %s", ENV_HSM_KEY_POOL_SIZE);
+    }
+    else if (env_value != NULL)
+    {
+        char *end = NULL;
+        unsigned long pool_size = strtoul(env_value, &end, 10);
+        if ((end == env_value) || (*end != 0) || (pool_size > HSM_KEY_POOL_MAX_SIZE))
+        {
+            LOG_ERROR("Invalid value %s for env variable %s, expected 0 to %d",
+                      env_value, ENV_HSM_KEY_POOL_SIZE, HSM_KEY_POOL_MAX_SIZE);
+        }
+        else if ((pool_size != 0) && (pki_key_pool_init((size_t)pool_size) != 0))
         {
-            free(trusted_certs_path);
+            LOG_ERROR("Could not start key pool, keys will be generated on demand");
         }
-        if (device_ca_path != NULL)
+        free(env_value);
+    }
+}
+
+// Without the worker certificates are only re-issued once they are found
+// to have expired, in which case the request pays for the new key inline.
+static void start_cert_renewal_if_enabled(CRYPTO_STORE *store)
+{
+    char *env_value = NULL;
+
+    if (hsm_get_env(ENV_HSM_CERT_RENEWAL_PERCENT, &env_value) != 0)
+    {
+        LOG_ERROR("Could not lookup env variable %s", ENV_HSM_CERT_RENEWAL_PERCENT);
+    }
+    else if (env_value != NULL)
+    {
+        char *end = NULL;
+        unsigned long renewal_percent = strtoul(env_value, &end, 10);
+        if ((end == env_value) || (*end != 0) || (renewal_percent > 99))
         {
-            free(device_ca_path);
+            LOG_ERROR("Invalid value %s for env variable %s, expected 0 to 99",
+                      env_value, ENV_HSM_CERT_RENEWAL_PERCENT);
         }
-        if (device_pk_path != NULL)
+        else if ((renewal_percent != 0) &&
+                 ((store->renewal = hsm_renewal_create(renew_due_certs, store)) == NULL))
         {
-            free(device_pk_path);
+            LOG_ERROR("Could not start certificate renewal, certificates are renewed once expired");
+        }
+        else
+        {
+            store->renewal_percent = (int)renewal_percent;
         }
+        free(env_value);
     }
+}
 
-    return result;
+// Without reuse every request for an alias that exists returns the existing
+// certificate, callers that need fresh properties destroy the alias first.
+static void start_cert_reuse_if_enabled(CRYPTO_STORE *store)
+{
+    char *env_value = NULL;
+
+    if (hsm_get_env(ENV_HSM_CERT_REUSE_PERCENT, &env_value) != 0)
+    {
+        LOG_ERROR("Could not lookup env variable %s", ENV_HSM_CERT_REUSE_PERCENT);
+    }
+    else if (env_value != NULL)
+    {
+        char *end = NULL;
+        unsigned long reuse_percent = strtoul(env_value, &end, 10);
+        if ((end == env_value) || (*end != 0) || (reuse_percent > 100))
+        {
+            LOG_ERROR("Invalid value %s for env variable %s, expected 0 to 100",
+                      env_value, ENV_HSM_CERT_REUSE_PERCENT);
+        }
+        else
+        {
+            store->reuse_percent = (int)reuse_percent;
+        }
+        free(env_value);
+    }
 }
 
 static int hsm_provision(void)
@@ -1872,9 +4194,21 @@ static int hsm_provision(void)
                   "Set environment variable IOTEDGE_HOMEDIR to a valid path.");
         result = __FAILURE__;
     }
+    else if (open_packed_store_if_enabled(g_crypto_store) != 0)
+    {
+        LOG_ERROR("Could not open the packed HSM store");
+        result = __FAILURE__;
+    }
     else
     {
-        result = hsm_provision_edge_certificates();
+        load_verify_cache(g_crypto_store);
+        start_key_pool_if_enabled();
+        start_cert_renewal_if_enabled(g_crypto_store);
+        start_cert_reuse_if_enabled(g_crypto_store);
+        if ((result = hsm_provision_edge_certificates()) != 0)
+        {
+            pki_key_pool_deinit();
+        }
     }
 
     return result;
@@ -1882,6 +4216,7 @@ static int hsm_provision(void)
 
 static int hsm_deprovision(void)
 {
+    pki_key_pool_deinit();
     return 0;
 }
 
@@ -1896,36 +4231,41 @@ static int edge_hsm_client_store_create(const char* store_name)
     {
         result = __FAILURE__;
     }
-    else if ((g_hsm_state == HSM_STATE_UNPROVISIONED) ||
-             (g_hsm_state == HSM_STATE_PROVISIONING_ERROR))
+    else
     {
-        g_crypto_store = create_store(store_name);
-        if (g_crypto_store == NULL)
-        {
-            LOG_ERROR("Could not create HSM store");
-            result = __FAILURE__;
-        }
-        else
+        hsm_global_lock(HSM_GLOBAL_LOCK_STORE);
+        if ((get_hsm_state() == HSM_STATE_UNPROVISIONED) ||
+            (get_hsm_state() == HSM_STATE_PROVISIONING_ERROR))
         {
-            if (hsm_provision() != 0)
+            g_crypto_store = create_store(store_name);
+            if (g_crypto_store == NULL)
             {
-                destroy_store(g_crypto_store);
-                g_crypto_store = NULL;
-                g_hsm_state = HSM_STATE_PROVISIONING_ERROR;
+                LOG_ERROR("Could not create HSM store");
                 result = __FAILURE__;
             }
             else
             {
-                g_store_ref_count = 1;
-                g_hsm_state = HSM_STATE_PROVISIONED;
-                result = 0;
+                if (hsm_provision() != 0)
+                {
+                    destroy_store(g_crypto_store);
+                    g_crypto_store = NULL;
+                    hsm_atomic_store(&g_hsm_state, HSM_STATE_PROVISIONING_ERROR);
+                    result = __FAILURE__;
+                }
+                else
+                {
+                    hsm_atomic_store(&g_store_ref_count, 1);
+                    hsm_atomic_store(&g_hsm_state, HSM_STATE_PROVISIONED);
+                    result = 0;
+                }
             }
         }
-    }
-    else
-    {
-        g_store_ref_count++;
-        result = 0;
+        else
+        {
+            (void)hsm_atomic_increment(&g_store_ref_count);
+            result = 0;
+        }
+        hsm_global_unlock(HSM_GLOBAL_LOCK_STORE);
     }
 
     return result;
@@ -1940,25 +4280,31 @@ static int edge_hsm_client_store_destroy(const char* store_name)
         LOG_ERROR("Invald store name parameter");
         result = __FAILURE__;
     }
-    else if (g_hsm_state != HSM_STATE_PROVISIONED)
+    else if (get_hsm_state() != HSM_STATE_PROVISIONED)
     {
         LOG_ERROR("HSM store has not been provisioned");
         result = __FAILURE__;
     }
     else
     {
-        g_store_ref_count--;
-        if (g_store_ref_count == 0)
+        hsm_global_lock(HSM_GLOBAL_LOCK_STORE);
+        if (get_hsm_state() != HSM_STATE_PROVISIONED)
         {
+            LOG_ERROR("HSM store has not been provisioned");
+            result = __FAILURE__;
+        }
+        else if (hsm_atomic_decrement(&g_store_ref_count) == 0)
+        {
+            hsm_atomic_store(&g_hsm_state, HSM_STATE_UNPROVISIONED);
             result = hsm_deprovision();
             destroy_store(g_crypto_store);
-            g_hsm_state = HSM_STATE_UNPROVISIONED;
             g_crypto_store = NULL;
         }
         else
         {
             result = 0;
         }
+        hsm_global_unlock(HSM_GLOBAL_LOCK_STORE);
     }
 
     return result;
@@ -1973,14 +4319,16 @@ static HSM_CLIENT_STORE_HANDLE edge_hsm_client_store_open(const char* store_name
         LOG_ERROR("Invald store name parameter");
         result = NULL;
     }
-    else if (g_hsm_state != HSM_STATE_PROVISIONED)
+    else if (get_hsm_state() != HSM_STATE_PROVISIONED)
     {
         LOG_ERROR("HSM store has not been provisioned");
         result = NULL;
     }
     else
     {
+        hsm_global_lock(HSM_GLOBAL_LOCK_STORE);
         result = (HSM_CLIENT_STORE_HANDLE)g_crypto_store;
+        hsm_global_unlock(HSM_GLOBAL_LOCK_STORE);
     }
 
     return result;
@@ -1995,7 +4343,7 @@ static int edge_hsm_client_store_close(HSM_CLIENT_STORE_HANDLE handle)
         LOG_ERROR("Invald store name parameter");
         result = __FAILURE__;
     }
-    else if (g_hsm_state != HSM_STATE_PROVISIONED)
+    else if (get_hsm_state() != HSM_STATE_PROVISIONED)
     {
         LOG_ERROR("HSM store has not been provisioned");
         result = __FAILURE__;
@@ -2033,7 +4381,7 @@ static int edge_hsm_client_store_insert_sas_key
         LOG_ERROR("Invalid key parameters");
         result = __FAILURE__;
     }
-    else if (g_hsm_state != HSM_STATE_PROVISIONED)
+    else if (get_hsm_state() != HSM_STATE_PROVISIONED)
     {
         LOG_ERROR("HSM store has not been provisioned");
         result = __FAILURE__;
@@ -2070,7 +4418,7 @@ static int edge_hsm_client_store_remove_key
         LOG_ERROR("Invalid key name parameter");
         result = __FAILURE__;
     }
-    else if (g_hsm_state != HSM_STATE_PROVISIONED)
+    else if (get_hsm_state() != HSM_STATE_PROVISIONED)
     {
         LOG_ERROR("HSM store has not been provisioned");
         result = __FAILURE__;
@@ -2084,7 +4432,7 @@ static int edge_hsm_client_store_remove_key
             {
                 LOG_DEBUG("Encryption key not loaded in HSM store %s", key_name);
             }
-            result = delete_encryption_key_file(key_name);
+            result = delete_encryption_key_file((CRYPTO_STORE*)handle, key_name);
         }
         else
         {
@@ -2127,7 +4475,7 @@ static KEY_HANDLE edge_hsm_client_open_key
         LOG_ERROR("Invalid key name parameter");
         result = NULL;
     }
-    else if (g_hsm_state != HSM_STATE_PROVISIONED)
+    else if (get_hsm_state() != HSM_STATE_PROVISIONED)
     {
         LOG_ERROR("HSM store has not been provisioned");
         result = NULL;
@@ -2153,32 +4501,7 @@ static KEY_HANDLE edge_hsm_client_open_key
         }
         else
         {
-            STORE_ENTRY_KEY* key_entry;
-            size_t buffer_size = 0;
-            const unsigned char *buffer_ptr = NULL;
-            if ((key_entry = get_key(store, key_type, key_name)) == NULL)
-            {
-                LOG_ERROR("Could not find key name %s", key_name);
-                result = NULL;
-            }
-            else if (((buffer_ptr = BUFFER_u_char(key_entry->key)) == NULL) ||
-                     (BUFFER_size(key_entry->key, &buffer_size) != 0) ||
-                     (buffer_size == 0))
-            {
-                LOG_ERROR("Invalid key buffer for %s", key_name);
-                result = NULL;
-            }
-            else
-            {
-                if (key_type == HSM_KEY_ENCRYPTION)
-                {
-                    result = create_encryption_key(buffer_ptr, buffer_size);
-                }
-                else
-                {
-                    result = create_sas_key(buffer_ptr, buffer_size);
-                }
-            }
+            result = (KEY_HANDLE)acquire_cached_key(store, key_type, key_name);
         }
     }
 
@@ -2199,7 +4522,7 @@ static int edge_hsm_client_close_key(HSM_CLIENT_STORE_HANDLE handle, KEY_HANDLE
         LOG_ERROR("Invalid key handle parameter");
         result = __FAILURE__;
     }
-    else if (g_hsm_state != HSM_STATE_PROVISIONED)
+    else if (get_hsm_state() != HSM_STATE_PROVISIONED)
     {
         LOG_ERROR("HSM store has not been provisioned");
         result = __FAILURE__;
@@ -2227,24 +4550,14 @@ static CERT_INFO_HANDLE get_cert_info_by_alias(HSM_CLIENT_STORE_HANDLE handle, c
         LOG_ERROR("Invalid alias value");
         result = NULL;
     }
-    else if (g_hsm_state != HSM_STATE_PROVISIONED)
+    else if (get_hsm_state() != HSM_STATE_PROVISIONED)
     {
         LOG_ERROR("HSM store has not been provisioned");
         result = NULL;
     }
     else
     {
-        STORE_ENTRY_PKI_CERT *cert_entry;
-        CRYPTO_STORE *store = (CRYPTO_STORE*)handle;
-        if ((cert_entry = get_pki_cert(store, alias)) == NULL)
-        {
-            LOG_ERROR("Could not find certificate for %s", alias);
-            result = NULL;
-        }
-        else
-        {
-            result = prepare_cert_info_handle(store, cert_entry);
-        }
+        result = get_cached_cert_info((CRYPTO_STORE*)handle, alias);
     }
 
     return result;
@@ -2263,7 +4576,7 @@ static int remove_cert_by_alias(HSM_CLIENT_STORE_HANDLE handle, const char* alia
         LOG_ERROR("Invalid alias value");
         result = __FAILURE__;
     }
-    else if (g_hsm_state != HSM_STATE_PROVISIONED)
+    else if (get_hsm_state() != HSM_STATE_PROVISIONED)
     {
         LOG_ERROR("HSM store has not been provisioned");
         result = __FAILURE__;
@@ -2303,7 +4616,6 @@ static int verify_certificate_helper
     const char *alias,
     const char *issuer_alias,
     const char *cert_file_path,
-    const char *key_file_path,
     bool *cert_verified
 )
 {
@@ -2312,7 +4624,8 @@ static int verify_certificate_helper
 
     if (cmp == 0)
     {
-        result = verify_certificate(cert_file_path, key_file_path, cert_file_path, cert_verified);
+        result = verify_certificate_with_cache((CRYPTO_STORE*)handle, cert_file_path, issuer_alias,
+                                               cert_file_path, cert_verified);
     }
     else
     {
@@ -2321,12 +4634,23 @@ static int verify_certificate_helper
         STORE_ENTRY_PKI_CERT *cert_entry;
 
         const char *issuer_cert_path = NULL;
+        hsm_rwlock_read_lock(store->lock);
         if ((cert_entry = get_pki_cert(store, issuer_alias)) != NULL)
         {
             LOG_DEBUG("Certificate already loaded in store for alias %s", issuer_alias);
-            issuer_cert_path = STRING_c_str(cert_entry->cert_file);
+            // copy the path so that the entry is not referenced after the lock is released
+            if ((issuer_cert_path_handle = STRING_clone(cert_entry->cert_file)) == NULL)
+            {
+                LOG_ERROR("Could not copy certificate path for alias %s", issuer_alias);
+            }
+            else
+            {
+                issuer_cert_path = STRING_c_str(issuer_cert_path_handle);
+            }
         }
-        else
+        hsm_rwlock_read_unlock(store->lock);
+
+        if ((cert_entry == NULL) && (issuer_cert_path == NULL))
         {
             if ((issuer_cert_path_handle = STRING_new()) == NULL)
             {
@@ -2347,7 +4671,8 @@ static int verify_certificate_helper
             LOG_ERROR("Could not find issuer certificate file %s", issuer_cert_path);
             result = __FAILURE__;
         }
-        else if (verify_certificate(cert_file_path, key_file_path, issuer_cert_path, cert_verified) != 0)
+        else if (verify_certificate_with_cache(store, cert_file_path, issuer_alias,
+                                               issuer_cert_path, cert_verified) != 0)
         {
             LOG_ERROR("Error trying to verify certificate %s for alias %s", cert_file_path, alias);
             result = __FAILURE__;
@@ -2425,44 +4750,12 @@ static int edge_hsm_client_store_create_pki_cert_internal
         else
         {
             CRYPTO_STORE *store = (CRYPTO_STORE*)handle;
-            const char *issuer_pk_path = NULL;
-            const char *issuer_cert_path = NULL;
             const char *alias_pk_path = STRING_c_str(alias_pk_handle);
             const char *alias_cert_path = STRING_c_str(alias_cert_handle);
-            result = 0;
-            if (strcmp(alias, issuer_alias) != 0)
-            {
-                // not a self signed certificate request
-                STORE_ENTRY_PKI_CERT *issuer_cert_entry;
-                if ((issuer_cert_entry = get_pki_cert(store, issuer_alias)) == NULL)
-                {
-                    LOG_ERROR("Could not get certificate entry for issuer %s", issuer_alias);
-                    result = __FAILURE__;
-                }
-                else
-                {
-                    issuer_cert_path = STRING_c_str(issuer_cert_entry->cert_file);
-                    issuer_pk_path = STRING_c_str(issuer_cert_entry->private_key_file);
-                    if ((issuer_pk_path == NULL) || (issuer_cert_path == NULL))
-                    {
-                        LOG_ERROR("Unexpected NULL file paths found for issuer %s", issuer_alias);
-                        result = __FAILURE__;
-                    }
-                }
-            }
-            if (result == 0)
-            {
-                // @note this will overwrite the older the certificate and private key
-                // files for the requested alias
-                result = generate_pki_cert_and_key(cert_props_handle,
-                                                   rand(), // todo check if rand is okay or if we need something stronger like a SHA1
-                                                   ca_path_len,
-                                                   alias_pk_path,
-                                                   alias_cert_path,
-                                                   issuer_pk_path,
-                                                   issuer_cert_path);
-            }
-
+            // @note this will overwrite the older the certificate and private key
+            // files for the requested alias
+            delete_cert_props_digest(alias);
+            result = issue_pki_cert(store, cert_props_handle, ca_path_len, alias_pk_path, alias_cert_path);
             if (result != 0)
             {
                 LOG_ERROR("Could not create PKI certificate and key for %s", alias);
@@ -2488,16 +4781,25 @@ static int edge_hsm_client_store_create_pki_cert_internal
     return result;
 }
 
-static int edge_hsm_client_store_create_pki_cert
+// Loads the certificate of the alias of cert_props_handle if it can be
+// reused, otherwise issues it. issued, if not NULL, is set when the
+// certificate and key files were written by this call.
+static int get_or_create_pki_cert
 (
     HSM_CLIENT_STORE_HANDLE handle,
-    CERT_PROPS_HANDLE cert_props_handle
+    CERT_PROPS_HANDLE cert_props_handle,
+    bool *issued
 )
 {
     int result;
     const char* alias;
     const char* issuer_alias;
 
+    if (issued != NULL)
+    {
+        *issued = false;
+    }
+
     if (handle == NULL)
     {
         LOG_ERROR("Invalid handle value");
@@ -2518,14 +4820,36 @@ static int edge_hsm_client_store_create_pki_cert
         LOG_ERROR("Invalid certificate alias value");
         result = __FAILURE__;
     }
-    else if (g_hsm_state != HSM_STATE_PROVISIONED)
+    else if (get_hsm_state() != HSM_STATE_PROVISIONED)
     {
         LOG_ERROR("HSM store has not been provisioned");
         result = __FAILURE__;
     }
     else
     {
-        int load_status = load_if_cert_and_key_exist_by_alias(handle, alias, issuer_alias);
+        CRYPTO_STORE *store = (CRYPTO_STORE*)handle;
+        unsigned char props_digest[SHA256HashSize];
+        bool is_reuse_checked = (store->reuse_percent != 0) &&
+                                (get_certificate_type(cert_props_handle) != CERTIFICATE_TYPE_CA) &&
+                                (compute_cert_props_digest(cert_props_handle, props_digest) == 0);
+        int load_status;
+
+        if (is_reuse_checked && !is_cert_props_digest_equal(store, alias, props_digest))
+        {
+            // re-issue, overwriting the certificate and key of the alias
+            load_status = LOAD_ERR_NOT_FOUND;
+        }
+        else
+        {
+            load_status = load_if_cert_and_key_exist_by_alias(handle, alias, issuer_alias);
+            if (is_reuse_checked &&
+                (load_status == LOAD_SUCCESS) &&
+                !is_cert_validity_reusable(store, cert_props_handle))
+            {
+                load_status = LOAD_ERR_NOT_FOUND;
+            }
+        }
+
         if (load_status == LOAD_ERR_FAILED)
         {
             LOG_ERROR("Could not check and load certificate and key for alias %s", alias);
@@ -2546,6 +4870,10 @@ static int edge_hsm_client_store_create_pki_cert
             }
             else
             {
+                if (issued != NULL)
+                {
+                    *issued = true;
+                }
                 result = 0;
             }
         }
@@ -2553,6 +4881,246 @@ static int edge_hsm_client_store_create_pki_cert
         {
             result = 0;
         }
+
+        if ((result == 0) && is_reuse_checked)
+        {
+            set_cert_props_digest(store, alias, props_digest, (load_status == LOAD_ERR_NOT_FOUND));
+        }
+
+        // CA certificates are not renewed as that would invalidate the
+        // chains of the certificates they issued
+        if ((result == 0) &&
+            (store->renewal != NULL) &&
+            (get_certificate_type(cert_props_handle) != CERTIFICATE_TYPE_CA))
+        {
+            track_cert_renewal(store, cert_props_handle);
+        }
+    }
+
+    return result;
+}
+
+static int edge_hsm_client_store_create_pki_cert
+(
+    HSM_CLIENT_STORE_HANDLE handle,
+    CERT_PROPS_HANDLE cert_props_handle
+)
+{
+    return get_or_create_pki_cert(handle, cert_props_handle, NULL);
+}
+
+// Items are claimed from next by the batch workers, see create_batch_certs.
+// issued[index] is only written by the worker which claimed the item.
+typedef struct STORE_CERT_BATCH_TAG
+{
+    HSM_CLIENT_STORE_HANDLE handle;
+    CERT_PROPS_HANDLE *cert_props_handles;
+    bool *issued;
+    size_t count;
+    volatile long next;
+    volatile long num_failed;
+} STORE_CERT_BATCH;
+
+static void create_batch_certs(void *context)
+{
+    STORE_CERT_BATCH *batch = (STORE_CERT_BATCH*)context;
+    size_t index;
+
+    while ((index = (size_t)(hsm_atomic_increment(&batch->next) - 1)) < batch->count)
+    {
+        if (get_or_create_pki_cert(batch->handle,
+                                   batch->cert_props_handles[index],
+                                   &batch->issued[index]) != 0)
+        {
+            LOG_ERROR("Could not create certificate %zu of the batch", index);
+            (void)hsm_atomic_increment(&batch->num_failed);
+        }
+    }
+}
+
+// every properties handle must have an alias and issuer and the aliases are
+// distinct so that no two workers create the same certificate
+static bool is_cert_batch_valid(CERT_PROPS_HANDLE *cert_props_handles, size_t count)
+{
+    bool result = true;
+    size_t index, other;
+
+    for (index = 0; (index < count) && result; index++)
+    {
+        if ((cert_props_handles[index] == NULL) ||
+            (get_alias(cert_props_handles[index]) == NULL) ||
+            (get_issuer_alias(cert_props_handles[index]) == NULL))
+        {
+            LOG_ERROR("Invalid certificate properties value at %zu", index);
+            result = false;
+        }
+        for (other = 0; (other < index) && result; other++)
+        {
+            if (strcmp(get_alias(cert_props_handles[index]), get_alias(cert_props_handles[other])) == 0)
+            {
+                LOG_ERROR("Alias %s is requested more than once", get_alias(cert_props_handles[index]));
+                result = false;
+            }
+        }
+    }
+
+    return result;
+}
+
+// Issuers are cached in their store entry the first time they are acquired.
+// Loading them before the workers start keeps concurrent requests from each
+// loading the same issuer.
+static void preload_batch_issuers(CRYPTO_STORE *store, CERT_PROPS_HANDLE *cert_props_handles, size_t count)
+{
+    size_t index;
+
+    for (index = 0; index < count; index++)
+    {
+        const char *issuer_alias = get_issuer_alias(cert_props_handles[index]);
+        if (strcmp(get_alias(cert_props_handles[index]), issuer_alias) != 0)
+        {
+            STORE_ISSUER *issuer;
+            if ((issuer = acquire_store_issuer(store, issuer_alias)) != NULL)
+            {
+                release_store_issuer(issuer);
+            }
+        }
+    }
+}
+
+// Removes the certificates issued by a batch which failed so that the
+// batch is not left half applied. Certificates which already existed and
+// were reused by the batch are kept.
+static void remove_batch_issued_certs(const STORE_CERT_BATCH *batch)
+{
+    size_t index;
+
+    for (index = 0; index < batch->count; index++)
+    {
+        if (batch->issued[index])
+        {
+            const char *alias = get_alias(batch->cert_props_handles[index]);
+            if (remove_if_cert_and_key_exist_by_alias(batch->handle, alias) != 0)
+            {
+                LOG_ERROR("Could not remove certificate %s issued by the failed batch", alias);
+            }
+        }
+    }
+}
+
+static int sync_cert_dirs(void)
+{
+    int result;
+    const char *base_dir_path = get_base_dir();
+    STRING_HANDLE certs_dir = NULL;
+    STRING_HANDLE cert_keys_dir = NULL;
+
+    if (((certs_dir = STRING_construct(base_dir_path)) == NULL) ||
+        ((cert_keys_dir = STRING_construct(base_dir_path)) == NULL) ||
+        (STRING_concat(certs_dir, SLASH) != 0) ||
+        (STRING_concat(certs_dir, CERTS_DIR) != 0) ||
+        (STRING_concat(cert_keys_dir, SLASH) != 0) ||
+        (STRING_concat(cert_keys_dir, CERT_KEYS_DIR) != 0))
+    {
+        LOG_ERROR("Could not construct paths to the certificate directories");
+        result = __FAILURE__;
+    }
+    else if ((sync_directory(STRING_c_str(certs_dir)) != 0) ||
+             (sync_directory(STRING_c_str(cert_keys_dir)) != 0))
+    {
+        LOG_ERROR("Could not sync the certificate directories");
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = 0;
+    }
+    if (certs_dir != NULL)
+    {
+        STRING_delete(certs_dir);
+    }
+    if (cert_keys_dir != NULL)
+    {
+        STRING_delete(cert_keys_dir);
+    }
+
+    return result;
+}
+
+static int edge_hsm_client_store_create_pki_certs
+(
+    HSM_CLIENT_STORE_HANDLE handle,
+    CERT_PROPS_HANDLE* cert_props_handles,
+    size_t count
+)
+{
+    int result;
+
+    if (handle == NULL)
+    {
+        LOG_ERROR("Invalid handle value");
+        result = __FAILURE__;
+    }
+    else if ((cert_props_handles == NULL) || (count == 0) || (count > LONG_MAX))
+    {
+        LOG_ERROR("Invalid certificate properties values");
+        result = __FAILURE__;
+    }
+    else if (!is_cert_batch_valid(cert_props_handles, count))
+    {
+        LOG_ERROR("Invalid certificate properties in batch");
+        result = __FAILURE__;
+    }
+    else if (get_hsm_state() != HSM_STATE_PROVISIONED)
+    {
+        LOG_ERROR("HSM store has not been provisioned");
+        result = __FAILURE__;
+    }
+    else
+    {
+        STORE_CERT_BATCH batch;
+
+        batch.handle = handle;
+        batch.cert_props_handles = cert_props_handles;
+        batch.count = count;
+        batch.next = 0;
+        batch.num_failed = 0;
+        if ((batch.issued = (bool*)calloc(count, sizeof(bool))) == NULL)
+        {
+            LOG_ERROR("Could not allocate memory to track the certificates of the batch");
+            result = __FAILURE__;
+        }
+        else
+        {
+            long num_failed;
+
+            preload_batch_issuers((CRYPTO_STORE*)handle, cert_props_handles, count);
+            hsm_workers_run((count < CERT_BATCH_MAX_WORKERS) ? count : CERT_BATCH_MAX_WORKERS,
+                            create_batch_certs,
+                            &batch);
+
+            if ((num_failed = hsm_atomic_load(&batch.num_failed)) != 0)
+            {
+                remove_batch_issued_certs(&batch);
+            }
+
+            // the certificate and key files are not synced as they are
+            // written, the new directory entries are synced once per batch
+            if (sync_cert_dirs() != 0)
+            {
+                result = __FAILURE__;
+            }
+            else if (num_failed != 0)
+            {
+                LOG_ERROR("Could not create %ld of %zu certificates", num_failed, count);
+                result = __FAILURE__;
+            }
+            else
+            {
+                result = 0;
+            }
+            free(batch.issued);
+        }
     }
 
     return result;
@@ -2581,7 +5149,7 @@ static int edge_hsm_client_store_insert_pki_trusted_cert
         LOG_ERROR("Invalid certificate file name %s", cert_file_name);
         result = __FAILURE__;
     }
-    else if (g_hsm_state != HSM_STATE_PROVISIONED)
+    else if (get_hsm_state() != HSM_STATE_PROVISIONED)
     {
         LOG_ERROR("HSM store has not been provisioned");
         result = __FAILURE__;
@@ -2605,7 +5173,7 @@ static CERT_INFO_HANDLE edge_hsm_client_store_get_pki_trusted_certs
         LOG_ERROR("Invalid handle value");
         result = NULL;
     }
-    else if (g_hsm_state != HSM_STATE_PROVISIONED)
+    else if (get_hsm_state() != HSM_STATE_PROVISIONED)
     {
         LOG_ERROR("HSM store has not been provisioned");
         result = NULL;
@@ -2635,7 +5203,7 @@ static int edge_hsm_client_store_remove_pki_trusted_cert
         LOG_ERROR("Invalid handle alias value");
         result = __FAILURE__;
     }
-    else if (g_hsm_state != HSM_STATE_PROVISIONED)
+    else if (get_hsm_state() != HSM_STATE_PROVISIONED)
     {
         LOG_ERROR("HSM store has not been provisioned");
         result = __FAILURE__;
@@ -2666,7 +5234,7 @@ static int edge_hsm_client_store_insert_encryption_key
         LOG_ERROR("Invalid handle alias value");
         result = __FAILURE__;
     }
-    else if (g_hsm_state != HSM_STATE_PROVISIONED)
+    else if (get_hsm_state() != HSM_STATE_PROVISIONED)
     {
         LOG_ERROR("HSM store has not been provisioned");
         result = __FAILURE__;
@@ -2687,7 +5255,7 @@ static int edge_hsm_client_store_insert_encryption_key
         }
         else
         {
-            if (save_encryption_key_to_file(key_name, key, key_size) != 0)
+            if (save_encryption_key_to_file((CRYPTO_STORE*)handle, key_name, key, key_size) != 0)
             {
                 LOG_ERROR("Could not persist encryption key %s to file", key_name);
                 result = __FAILURE__;
@@ -2715,6 +5283,7 @@ static const HSM_CLIENT_STORE_INTERFACE edge_hsm_client_store_interface =
     edge_hsm_client_store_insert_sas_key,
     edge_hsm_client_store_insert_encryption_key,
     edge_hsm_client_store_create_pki_cert,
+    edge_hsm_client_store_create_pki_certs,
     edge_hsm_client_store_get_pki_cert,
     edge_hsm_client_store_remove_pki_cert,
     edge_hsm_client_store_insert_pki_trusted_cert,
@@ -108,6 +108,176 @@ static int edge_hsm_client_key_derive_and_sign
                         identity, identity_size, digest, digest_size);
 }
 
+static int perform_sign_into
+(
+    bool do_derive_and_sign,
+    KEY_HANDLE key_handle,
+    const unsigned char* data_to_be_signed,
+    size_t data_to_be_signed_size,
+    const unsigned char* identity,
+    size_t identity_size,
+    unsigned char* digest,
+    size_t* digest_size
+)
+{
+    int result;
+
+    // digest may be NULL in which case only the digest size is returned
+    if (digest_size == NULL)
+    {
+        LOG_ERROR("Invalid digest size parameter");
+        result = __FAILURE__;
+    }
+    else if (key_handle == NULL)
+    {
+        LOG_ERROR("Invalid key handle parameter");
+        result = __FAILURE__;
+    }
+    else if (data_to_be_signed == NULL)
+    {
+        LOG_ERROR("Invalid data to be signed parameter");
+        result = __FAILURE__;
+    }
+    else if (data_to_be_signed_size == 0)
+    {
+        LOG_ERROR("Data to be signed size is 0");
+        result = __FAILURE__;
+    }
+    else if (do_derive_and_sign)
+    {
+        if (identity == NULL)
+        {
+            LOG_ERROR("Invalid identity parameter");
+            result = __FAILURE__;
+        }
+        else if (identity_size == 0)
+        {
+            LOG_ERROR("Invalid identity size parameter");
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = key_derive_and_sign_into(key_handle, data_to_be_signed, data_to_be_signed_size,
+                                              identity, identity_size, digest, digest_size);
+        }
+    }
+    else
+    {
+        result = key_sign_into(key_handle, data_to_be_signed, data_to_be_signed_size, digest, digest_size);
+    }
+
+    return result;
+}
+
+static int edge_hsm_client_key_sign_into
+(
+    KEY_HANDLE key_handle,
+    const unsigned char* data_to_be_signed,
+    size_t data_to_be_signed_size,
+    unsigned char* digest,
+    size_t* digest_size
+)
+{
+    return perform_sign_into(false, key_handle, data_to_be_signed, data_to_be_signed_size,
+                             NULL, 0, digest, digest_size);
+}
+
+static int edge_hsm_client_key_derive_and_sign_into
+(
+    KEY_HANDLE key_handle,
+    const unsigned char* data_to_be_signed,
+    size_t data_to_be_signed_size,
+    const unsigned char* identity,
+    size_t identity_size,
+    unsigned char* digest,
+    size_t* digest_size
+)
+{
+    return perform_sign_into(true, key_handle, data_to_be_signed, data_to_be_signed_size,
+                             identity, identity_size, digest, digest_size);
+}
+
+static int perform_sign_batch
+(
+    bool do_derive_and_sign,
+    KEY_HANDLE key_handle,
+    const HSM_SIGN_REQUEST* requests,
+    size_t count,
+    unsigned char* digests,
+    size_t* digest_size
+)
+{
+    int result = 0;
+    size_t index;
+
+    // digests may be NULL in which case only the digest size is returned
+    if (digest_size == NULL)
+    {
+        LOG_ERROR("Invalid digest size parameter");
+        result = __FAILURE__;
+    }
+    else if (key_handle == NULL)
+    {
+        LOG_ERROR("Invalid key handle parameter");
+        result = __FAILURE__;
+    }
+    else if ((requests == NULL) || (count == 0))
+    {
+        LOG_ERROR("Invalid sign requests parameter");
+        result = __FAILURE__;
+    }
+    else
+    {
+        for (index = 0; (result == 0) && (index < count); index++)
+        {
+            if ((requests[index].data == NULL) || (requests[index].data_size == 0))
+            {
+                LOG_ERROR("Invalid data to be signed in request %zu", index);
+                result = __FAILURE__;
+            }
+            else if (do_derive_and_sign &&
+                     ((requests[index].identity == NULL) || (requests[index].identity_size == 0)))
+            {
+                LOG_ERROR("Invalid identity in request %zu", index);
+                result = __FAILURE__;
+            }
+        }
+
+        if (result == 0)
+        {
+            result = do_derive_and_sign ?
+                key_derive_and_sign_batch(key_handle, requests, count, digests, digest_size) :
+                key_sign_batch(key_handle, requests, count, digests, digest_size);
+        }
+    }
+
+    return result;
+}
+
+static int edge_hsm_client_key_sign_batch
+(
+    KEY_HANDLE key_handle,
+    const HSM_SIGN_REQUEST* requests,
+    size_t count,
+    unsigned char* digests,
+    size_t* digest_size
+)
+{
+    return perform_sign_batch(false, key_handle, requests, count, digests, digest_size);
+}
+
+static int edge_hsm_client_key_derive_and_sign_batch
+(
+    KEY_HANDLE key_handle,
+    const HSM_SIGN_REQUEST* requests,
+    size_t count,
+    unsigned char* digests,
+    size_t* digest_size
+)
+{
+    return perform_sign_batch(true, key_handle, requests, count, digests, digest_size);
+}
+
 static int enc_dec_validation
 (
     const SIZED_BUFFER *identity,
@@ -190,6 +360,149 @@ static int edge_hsm_client_key_decrypt(KEY_HANDLE key_handle,
     return result;
 }
 
+static int perform_stream_init
+(
+    bool do_encrypt,
+    KEY_HANDLE key_handle,
+    const SIZED_BUFFER *identity,
+    const SIZED_BUFFER *iv,
+    KEY_STREAM_HANDLE *stream
+)
+{
+    int result;
+
+    if (stream == NULL)
+    {
+        LOG_ERROR("Invalid stream parameter");
+        result = __FAILURE__;
+    }
+    else
+    {
+        *stream = NULL;
+        if (key_handle == NULL)
+        {
+            LOG_ERROR("Invalid key handle parameter");
+            result = __FAILURE__;
+        }
+        else if ((identity == NULL) || (identity->buffer == NULL) || (identity->size == 0))
+        {
+            LOG_ERROR("Invalid identity parameter");
+            result = __FAILURE__;
+        }
+        else if ((iv == NULL) || (iv->buffer == NULL) || (iv->size == 0))
+        {
+            LOG_ERROR("Invalid initialization vector parameter");
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = do_encrypt ?
+                key_encrypt_init(key_handle, identity, iv, stream) :
+                key_decrypt_init(key_handle, identity, iv, stream);
+        }
+    }
+
+    return result;
+}
+
+static int edge_hsm_client_key_encrypt_init
+(
+    KEY_HANDLE key_handle,
+    const SIZED_BUFFER *identity,
+    const SIZED_BUFFER *iv,
+    KEY_STREAM_HANDLE *stream
+)
+{
+    return perform_stream_init(true, key_handle, identity, iv, stream);
+}
+
+static int edge_hsm_client_key_decrypt_init
+(
+    KEY_HANDLE key_handle,
+    const SIZED_BUFFER *identity,
+    const SIZED_BUFFER *iv,
+    KEY_STREAM_HANDLE *stream
+)
+{
+    return perform_stream_init(false, key_handle, identity, iv, stream);
+}
+
+static int edge_hsm_client_key_stream_update
+(
+    KEY_HANDLE key_handle,
+    KEY_STREAM_HANDLE stream,
+    const unsigned char *input,
+    size_t input_size,
+    unsigned char *output,
+    size_t *output_size
+)
+{
+    int result;
+
+    // output may be NULL in which case only the output size is returned
+    if (output_size == NULL)
+    {
+        LOG_ERROR("Invalid output size parameter");
+        result = __FAILURE__;
+    }
+    else if ((key_handle == NULL) || (stream == NULL))
+    {
+        LOG_ERROR("Invalid key or stream handle parameter");
+        *output_size = 0;
+        result = __FAILURE__;
+    }
+    else if ((input == NULL) && (input_size != 0))
+    {
+        LOG_ERROR("Invalid input parameter");
+        *output_size = 0;
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = key_stream_update(key_handle, stream, input, input_size, output, output_size);
+    }
+
+    return result;
+}
+
+static int edge_hsm_client_key_stream_final
+(
+    KEY_HANDLE key_handle,
+    KEY_STREAM_HANDLE stream,
+    unsigned char *output,
+    size_t *output_size
+)
+{
+    int result;
+
+    // output may be NULL in which case only the output size is returned
+    if (output_size == NULL)
+    {
+        LOG_ERROR("Invalid output size parameter");
+        result = __FAILURE__;
+    }
+    else if ((key_handle == NULL) || (stream == NULL))
+    {
+        LOG_ERROR("Invalid key or stream handle parameter");
+        *output_size = 0;
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = key_stream_final(key_handle, stream, output, output_size);
+    }
+
+    return result;
+}
+
+static void edge_hsm_client_key_stream_destroy(KEY_HANDLE key_handle, KEY_STREAM_HANDLE stream)
+{
+    if ((key_handle != NULL) && (stream != NULL))
+    {
+        key_stream_destroy(key_handle, stream);
+    }
+}
+
 static void edge_hsm_client_key_destroy(KEY_HANDLE key_handle)
 {
     if (key_handle != NULL)
@@ -204,7 +517,16 @@ static const HSM_CLIENT_KEY_INTERFACE edge_hsm_key_interface =
     edge_hsm_client_key_derive_and_sign,
     edge_hsm_client_key_encrypt,
     edge_hsm_client_key_decrypt,
-    edge_hsm_client_key_destroy
+    edge_hsm_client_key_destroy,
+    edge_hsm_client_key_sign_into,
+    edge_hsm_client_key_derive_and_sign_into,
+    edge_hsm_client_key_sign_batch,
+    edge_hsm_client_key_derive_and_sign_batch,
+    edge_hsm_client_key_encrypt_init,
+    edge_hsm_client_key_decrypt_init,
+    edge_hsm_client_key_stream_update,
+    edge_hsm_client_key_stream_final,
+    edge_hsm_client_key_stream_destroy
 };
 
 const HSM_CLIENT_KEY_INTERFACE* hsm_client_key_interface(void)
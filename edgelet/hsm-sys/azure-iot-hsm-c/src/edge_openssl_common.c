@@ -1,17 +1,76 @@
+#include <openssl/crypto.h>
 #include <openssl/err.h>
 #include <openssl/x509.h>
 #include "azure_c_shared_utility/gballoc.h"
 #include "edge_openssl_common.h"
+#include "hsm_lock.h"
+#include "hsm_log.h"
 
-void initialize_openssl(void)
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+// OpenSSL before 1.1 is only safe to use from several threads once the
+// application supplies the locks it asks for
+static HSM_MUTEX_HANDLE g_openssl_locks[CRYPTO_NUM_LOCKS];
+
+static void openssl_locking_callback(int mode, int type, const char *file, int line)
 {
-    static bool is_openssl_initialized = false;
+    (void)file;
+    (void)line;
+    if (mode & CRYPTO_LOCK)
+    {
+        hsm_mutex_lock(g_openssl_locks[type]);
+    }
+    else
+    {
+        hsm_mutex_unlock(g_openssl_locks[type]);
+    }
+}
 
-    if (!is_openssl_initialized)
+static void install_openssl_locks(void)
+{
+    // another library in the process may already have installed its locks
+    if (CRYPTO_get_locking_callback() == NULL)
     {
-        OpenSSL_add_all_algorithms();
-        ERR_load_BIO_strings();
-        ERR_load_crypto_strings();
-        is_openssl_initialized = true;
+        int index;
+        int num_locks = 0;
+
+        while ((num_locks < CRYPTO_NUM_LOCKS) &&
+               ((g_openssl_locks[num_locks] = hsm_mutex_create()) != NULL))
+        {
+            num_locks++;
+        }
+
+        if (num_locks < CRYPTO_NUM_LOCKS)
+        {
+            LOG_ERROR("Could not create OpenSSL locks, OpenSSL is not safe for concurrent use");
+            for (index = 0; index < num_locks; index++)
+            {
+                hsm_mutex_destroy(g_openssl_locks[index]);
+                g_openssl_locks[index] = NULL;
+            }
+        }
+        else
+        {
+            // OpenSSL's default thread id callback already tells threads
+            // apart on every supported platform
+            CRYPTO_set_locking_callback(openssl_locking_callback);
+        }
     }
 }
+#endif
+
+static void initialize_openssl_once(void)
+{
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+    install_openssl_locks();
+#endif
+    OpenSSL_add_all_algorithms();
+    ERR_load_BIO_strings();
+    ERR_load_crypto_strings();
+}
+
+void initialize_openssl(void)
+{
+    static HSM_ONCE openssl_once = HSM_ONCE_INIT;
+
+    hsm_run_once(&openssl_once, initialize_openssl_once);
+}
@@ -17,6 +17,7 @@
 #include <openssl/bio.h>
 #include <openssl/err.h>
 #include <openssl/ec.h>
+#include <openssl/evp.h>
 #include <openssl/pem.h>
 #include <openssl/x509.h>
 #include <openssl/x509v3.h>
@@ -27,6 +28,7 @@
 #include "edge_openssl_common.h"
 
 #include "hsm_key.h"
+#include "hsm_key_pool.h"
 #include "hsm_log.h"
 #include "hsm_utils.h"
 
@@ -75,6 +77,59 @@ struct CERT_KEY_TAG
 };
 typedef struct CERT_KEY_TAG CERT_KEY;
 
+// An issuer is read only once loaded so it may be used to issue
+// certificates on several threads concurrently. chain holds the contents of
+// the issuer certificate file which are appended to issued certificates.
+struct PKI_ISSUER_TAG
+{
+    X509 *x509_cert;
+    EVP_PKEY *evp_key;
+    void *chain;
+    size_t chain_size;
+};
+typedef struct PKI_ISSUER_TAG PKI_ISSUER;
+
+// size of the SHA-256 digest identifying a certificate in a chain
+#define CERT_DIGEST_SIZE 32
+
+// digest is the SHA-256 of the DER encoding of the certificate
+struct PKI_CHAIN_CERT_TAG
+{
+    X509 *x509_cert;
+    unsigned char digest[CERT_DIGEST_SIZE];
+};
+typedef struct PKI_CHAIN_CERT_TAG PKI_CHAIN_CERT;
+
+// The certificates of a PEM certificate file in the order of the file
+struct PKI_CERT_CHAIN_TAG
+{
+    PKI_CHAIN_CERT *certs;
+    size_t num_certs;
+};
+typedef struct PKI_CERT_CHAIN_TAG PKI_CERT_CHAIN;
+
+// ski is NULL for certificates without a subject key identifier
+struct PKI_TRUST_ANCHOR_TAG
+{
+    X509 *x509_cert;
+    unsigned long subject_hash;
+    ASN1_OCTET_STRING *ski;
+};
+typedef struct PKI_TRUST_ANCHOR_TAG PKI_TRUST_ANCHOR;
+
+// A verifier is read only once loaded. store holds every certificate of the
+// issuer certificate file and no other lookup so verifying against it does
+// not touch the file system. anchors indexes the certificates of
+// issuer_chain sorted by subject name hash.
+struct PKI_VERIFIER_TAG
+{
+    X509_STORE *store;
+    PKI_TRUST_ANCHOR *anchors;
+    size_t num_anchors;
+    PKI_CERT_CHAIN issuer_chain;
+};
+typedef struct PKI_VERIFIER_TAG PKI_VERIFIER;
+
 //#################################################################################################
 // Forward Declarations
 //#################################################################################################
@@ -153,6 +208,98 @@ int cert_key_derive_and_sign
     return __FAILURE__;
 }
 
+static int cert_key_sign_into
+(
+    KEY_HANDLE key_handle,
+    const unsigned char* data_to_be_signed,
+    size_t data_to_be_signed_size,
+    unsigned char* digest,
+    size_t* digest_size
+)
+{
+    (void)key_handle;
+    (void)data_to_be_signed;
+    (void)data_to_be_signed_size;
+    (void)digest;
+
+    LOG_ERROR("Sign for cert keys is not supported");
+    if (digest_size != NULL)
+    {
+        *digest_size = 0;
+    }
+    return __FAILURE__;
+}
+
+static int cert_key_derive_and_sign_into
+(
+    KEY_HANDLE key_handle,
+    const unsigned char* data_to_be_signed,
+    size_t data_to_be_signed_size,
+    const unsigned char* identity,
+    size_t identity_size,
+    unsigned char* digest,
+    size_t* digest_size
+)
+{
+    (void)key_handle;
+    (void)data_to_be_signed;
+    (void)data_to_be_signed_size;
+    (void)identity;
+    (void)identity_size;
+    (void)digest;
+
+    LOG_ERROR("Derive and sign for cert keys is not supported");
+    if (digest_size != NULL)
+    {
+        *digest_size = 0;
+    }
+    return __FAILURE__;
+}
+
+static int cert_key_sign_batch
+(
+    KEY_HANDLE key_handle,
+    const HSM_SIGN_REQUEST* requests,
+    size_t count,
+    unsigned char* digests,
+    size_t* digest_size
+)
+{
+    (void)key_handle;
+    (void)requests;
+    (void)count;
+    (void)digests;
+
+    LOG_ERROR("Batch sign for cert keys is not supported");
+    if (digest_size != NULL)
+    {
+        *digest_size = 0;
+    }
+    return __FAILURE__;
+}
+
+static int cert_key_derive_and_sign_batch
+(
+    KEY_HANDLE key_handle,
+    const HSM_SIGN_REQUEST* requests,
+    size_t count,
+    unsigned char* digests,
+    size_t* digest_size
+)
+{
+    (void)key_handle;
+    (void)requests;
+    (void)count;
+    (void)digests;
+
+    LOG_ERROR("Batch derive and sign for cert keys is not supported");
+    if (digest_size != NULL)
+    {
+        *digest_size = 0;
+    }
+    return __FAILURE__;
+}
+
 static int cert_key_encrypt
 (
     KEY_HANDLE key_handle,
@@ -193,6 +340,76 @@ static int cert_key_decrypt
     return __FAILURE__;
 }
 
+static int cert_key_stream_init
+(
+    KEY_HANDLE key_handle,
+    const SIZED_BUFFER *identity,
+    const SIZED_BUFFER *initialization_vector,
+    KEY_STREAM_HANDLE *stream
+)
+{
+    (void)key_handle;
+    (void)identity;
+    (void)initialization_vector;
+
+    LOG_ERROR("Cert key stream encrypt and decrypt operations not supported");
+    if (stream != NULL)
+    {
+        *stream = NULL;
+    }
+    return __FAILURE__;
+}
+
+static int cert_key_stream_update
+(
+    KEY_HANDLE key_handle,
+    KEY_STREAM_HANDLE stream,
+    const unsigned char *input,
+    size_t input_size,
+    unsigned char *output,
+    size_t *output_size
+)
+{
+    (void)key_handle;
+    (void)stream;
+    (void)input;
+    (void)input_size;
+    (void)output;
+
+    LOG_ERROR("Cert key stream update operation not supported");
+    if (output_size != NULL)
+    {
+        *output_size = 0;
+    }
+    return __FAILURE__;
+}
+
+static int cert_key_stream_final
+(
+    KEY_HANDLE key_handle,
+    KEY_STREAM_HANDLE stream,
+    unsigned char *output,
+    size_t *output_size
+)
+{
+    (void)key_handle;
+    (void)stream;
+    (void)output;
+
+    LOG_ERROR("Cert key stream final operation not supported");
+    if (output_size != NULL)
+    {
+        *output_size = 0;
+    }
+    return __FAILURE__;
+}
+
+static void cert_key_stream_destroy(KEY_HANDLE key_handle, KEY_STREAM_HANDLE stream)
+{
+    (void)key_handle;
+    (void)stream;
+}
+
 static void cert_key_destroy(KEY_HANDLE key_handle)
 {
     CERT_KEY *cert_key = (CERT_KEY*)key_handle;
@@ -206,15 +423,18 @@ static void cert_key_destroy(KEY_HANDLE key_handle)
 //#################################################################################################
 // PKI key generation
 //#################################################################################################
-static EVP_PKEY* generate_rsa_key(CERTIFICATE_TYPE cert_type)
+// Pool of pre-generated keys, NULL unless enabled with pki_key_pool_init.
+// Only modified while the store is being created or destroyed.
+static HSM_KEY_POOL_HANDLE g_pki_key_pool = NULL;
+
+static EVP_PKEY* generate_rsa_key(int key_len)
 {
     int status;
     BIGNUM *bne;
     EVP_PKEY *pkey;
     RSA *rsa;
 
-    size_t key_len = (cert_type == CERTIFICATE_TYPE_CA) ? RSA_KEY_LEN_CA : RSA_KEY_LEN_NON_CA;
-    LOG_INFO("Generating RSA key of length %lu", key_len);
+    LOG_INFO("Generating RSA key of length %d", key_len);
     if ((pkey = EVP_PKEY_new()) == NULL)
     {
         LOG_ERROR("Unable to create EVP_PKEY structure");
@@ -239,7 +459,7 @@ static EVP_PKEY* generate_rsa_key(CERTIFICATE_TYPE cert_type)
         EVP_PKEY_free(pkey);
         pkey = NULL;
     }
-    else if ((status = RSA_generate_key_ex(rsa, (int)key_len, bne, NULL)) != 1)
+    else if ((status = RSA_generate_key_ex(rsa, key_len, bne, NULL)) != 1)
     {
         LOG_ERROR("Unable to generate RSA key");
         RSA_free(rsa);
@@ -264,13 +484,11 @@ static EVP_PKEY* generate_rsa_key(CERTIFICATE_TYPE cert_type)
     return pkey;
 }
 
-static EVP_PKEY* generate_ecc_key(const char *ecc_type)
+static EVP_PKEY* generate_ecc_key(int ecc_group)
 {
     EC_KEY* ecc_key;
     EVP_PKEY *evp_key;
 
-    int ecc_group = OBJ_txt2nid(ecc_type);
-
     if ((ecc_key = EC_KEY_new_by_curve_name(ecc_group)) == NULL)
     {
         LOG_ERROR("Failure getting curve name");
@@ -300,6 +518,49 @@ static EVP_PKEY* generate_ecc_key(const char *ecc_type)
     return evp_key;
 }
 
+// the key param is the key length for RSA keys and the curve NID for EC keys
+static void* generate_key_by_type(int key_type, int key_param)
+{
+    EVP_PKEY *evp_key;
+
+    if (key_type == HSM_PKI_KEY_EC)
+    {
+        evp_key = generate_ecc_key(key_param);
+    }
+    else
+    {
+        evp_key = generate_rsa_key(key_param);
+    }
+
+    return evp_key;
+}
+
+static void destroy_pooled_key(void *key)
+{
+    destroy_evp_key((EVP_PKEY*)key);
+}
+
+static EVP_PKEY* take_or_generate_key(HSM_PKI_KEY_T key_type, int key_param)
+{
+    EVP_PKEY *evp_key = NULL;
+
+    if (g_pki_key_pool != NULL)
+    {
+        evp_key = (EVP_PKEY*)hsm_key_pool_take(g_pki_key_pool, key_type, key_param);
+    }
+    if (evp_key == NULL)
+    {
+        evp_key = (EVP_PKEY*)generate_key_by_type(key_type, key_param);
+    }
+
+    return evp_key;
+}
+
+static int get_rsa_key_len(CERTIFICATE_TYPE cert_type)
+{
+    return (cert_type == CERTIFICATE_TYPE_CA) ? RSA_KEY_LEN_CA : RSA_KEY_LEN_NON_CA;
+}
+
 static EVP_PKEY* generate_evp_key
 (
     CERTIFICATE_TYPE cert_type,
@@ -315,12 +576,12 @@ static EVP_PKEY* generate_evp_key
         {
             const char *curve = (key_props->ec_curve_name != NULL) ? key_props->ec_curve_name :
                                                                      DEFAULT_EC_CURVE_NAME;
-            evp_key = generate_ecc_key(curve);
+            evp_key = take_or_generate_key(HSM_PKI_KEY_EC, OBJ_txt2nid(curve));
         }
         else
         {
             // by default use RSA keys if no issuer cert or key properties was provided
-            evp_key = generate_rsa_key(cert_type);
+            evp_key = take_or_generate_key(HSM_PKI_KEY_RSA, get_rsa_key_len(cert_type));
         }
     }
     else
@@ -340,7 +601,7 @@ static EVP_PKEY* generate_evp_key
             {
                 case EVP_PKEY_RSA:
                 {
-                    evp_key = generate_rsa_key(cert_type);
+                    evp_key = take_or_generate_key(HSM_PKI_KEY_RSA, get_rsa_key_len(cert_type));
                 }
                 break;
 
@@ -351,7 +612,7 @@ static EVP_PKEY* generate_evp_key
                     const char *curve_name = OBJ_nid2sn(EC_GROUP_get_curve_name(ecgrp));
                     LOG_INFO("Generating ECC Key size: %d bits. ECC Key type: %s",
                              EVP_PKEY_bits(evp_pub_key), curve_name);
-                    evp_key = generate_ecc_key(curve_name);
+                    evp_key = take_or_generate_key(HSM_PKI_KEY_EC, OBJ_txt2nid(curve_name));
                     EC_KEY_free(ecc_key);
                 }
                 break;
@@ -400,43 +661,19 @@ static X509* load_certificate_file(const char* cert_file_name)
     return x509_cert;
 }
 
-static int bio_chain_cert_helper(BIO *cert_file, const char *issuer_cert_file_name)
+static int bio_chain_cert_helper(BIO *cert_file, const PKI_ISSUER *issuer)
 {
     int result;
-    size_t issuer_buf_size = 0;
 
-    void *issuer_cert = read_file_into_buffer(issuer_cert_file_name, &issuer_buf_size);
-    if (issuer_cert == NULL)
+    int len = BIO_write(cert_file, issuer->chain, (int)issuer->chain_size);
+    if (len != (int)issuer->chain_size)
     {
-        LOG_ERROR("Could not read issuer certificate file %s", issuer_cert_file_name);
+        LOG_ERROR("BIO_write returned %d expected %zu", len, issuer->chain_size);
         result = __FAILURE__;
     }
     else
     {
-        if (issuer_buf_size == 0)
-        {
-            LOG_ERROR("Read zero bytes from issuer certificate file %s", issuer_cert_file_name);
-            result = __FAILURE__;
-        }
-        else if (issuer_buf_size > INT_MAX)
-        {
-            LOG_ERROR("Issuer certificate file too large %s", issuer_cert_file_name);
-            result = __FAILURE__;
-        }
-        else
-        {
-            int len = BIO_write(cert_file, issuer_cert, (int)issuer_buf_size);
-            if (len != (int)issuer_buf_size)
-            {
-                LOG_ERROR("BIO_write returned %d expected %zu", len, issuer_buf_size);
-                result = __FAILURE__;
-            }
-            else
-            {
-                result = 0;
-            }
-        }
-        free(issuer_cert);
+        result = 0;
     }
 
     return result;
@@ -446,7 +683,7 @@ static int write_certificate_file
 (
     X509 *x509_cert,
     const char *cert_file_name,
-    const char *issuer_certificate_file
+    const PKI_ISSUER *issuer
 )
 {
     int result;
@@ -465,8 +702,7 @@ static int write_certificate_file
             LOG_ERROR("Unable to write certificate to file %s", cert_file_name);
             result = __FAILURE__;
         }
-        else if ((issuer_certificate_file != NULL) &&
-                 (bio_chain_cert_helper(cert_file, issuer_certificate_file) != 0))
+        else if ((issuer != NULL) && (bio_chain_cert_helper(cert_file, issuer) != 0))
         {
             result = __FAILURE__;
         }
@@ -498,8 +734,7 @@ static int write_certificate_file
                 LOG_ERROR("Unable to write certificate to file %s", cert_file_name);
                 result = __FAILURE__;
             }
-            else if ((issuer_certificate_file != NULL) &&
-                     (bio_chain_cert_helper(cert_file, issuer_certificate_file) != 0))
+            else if ((issuer != NULL) && (bio_chain_cert_helper(cert_file, issuer) != 0))
             {
                 result = __FAILURE__;
             }
@@ -594,6 +829,68 @@ static int write_private_key_file(EVP_PKEY* evp_key, const char* key_file_name)
     return result;
 }
 
+//#################################################################################################
+// PKI issuer
+//#################################################################################################
+static void destroy_issuer(PKI_ISSUER *issuer)
+{
+    if (issuer->x509_cert != NULL)
+    {
+        X509_free(issuer->x509_cert);
+    }
+    if (issuer->evp_key != NULL)
+    {
+        destroy_evp_key(issuer->evp_key);
+    }
+    if (issuer->chain != NULL)
+    {
+        free(issuer->chain);
+    }
+    free(issuer);
+}
+
+static PKI_ISSUER* load_issuer(const char *issuer_key_file, const char *issuer_certificate_file)
+{
+    PKI_ISSUER *result;
+
+    if ((result = (PKI_ISSUER*)calloc(1, sizeof(PKI_ISSUER))) == NULL)
+    {
+        LOG_ERROR("Could not allocate memory for issuer");
+    }
+    else if ((result->x509_cert = load_certificate_file(issuer_certificate_file)) == NULL)
+    {
+        LOG_ERROR("Could not load issuer certificate file");
+        destroy_issuer(result);
+        result = NULL;
+    }
+    else if ((result->evp_key = load_private_key_file(issuer_key_file)) == NULL)
+    {
+        LOG_ERROR("Could not load issuer private key file");
+        destroy_issuer(result);
+        result = NULL;
+    }
+    else if ((result->chain = read_file_into_buffer(issuer_certificate_file, &result->chain_size)) == NULL)
+    {
+        LOG_ERROR("Could not read issuer certificate file %s", issuer_certificate_file);
+        destroy_issuer(result);
+        result = NULL;
+    }
+    else if (result->chain_size == 0)
+    {
+        LOG_ERROR("Read zero bytes from issuer certificate file %s", issuer_certificate_file);
+        destroy_issuer(result);
+        result = NULL;
+    }
+    else if (result->chain_size > INT_MAX)
+    {
+        LOG_ERROR("Issuer certificate file too large %s", issuer_certificate_file);
+        destroy_issuer(result);
+        result = NULL;
+    }
+
+    return result;
+}
+
 //#################################################################################################
 // PKI certificate generation
 //#################################################################################################
@@ -976,9 +1273,7 @@ static int generate_evp_certificate
     CERTIFICATE_TYPE cert_type,
     const char *common_name,
     uint64_t requested_validity,
-    EVP_PKEY* issuer_evp_key,
-    X509* issuer_certificate,
-    const char *issuer_certificate_file,
+    const PKI_ISSUER *issuer,
     CERT_PROPS_HANDLE cert_props_handle,
     int serial_num,
     int ca_path_len,
@@ -988,6 +1283,7 @@ static int generate_evp_certificate
 {
     int result;
     X509* x509_cert;
+    X509* issuer_certificate = (issuer != NULL) ? issuer->x509_cert : NULL;
     *result_cert = NULL;
     if ((x509_cert = X509_new()) == NULL)
     {
@@ -1025,13 +1321,13 @@ static int generate_evp_certificate
         }
         else
         {
-            issuer_evp_key = (issuer_evp_key == NULL) ? evp_key : issuer_evp_key;
+            EVP_PKEY *issuer_evp_key = (issuer != NULL) ? issuer->evp_key : evp_key;
             if (!X509_sign(x509_cert, issuer_evp_key, EVP_sha256()))
             {
                 LOG_ERROR("Failure signing x509");
                 result = __FAILURE__;
             }
-            else if (write_certificate_file(x509_cert, cert_file_name, issuer_certificate_file) != 0)
+            else if (write_certificate_file(x509_cert, cert_file_name, issuer) != 0)
             {
                 LOG_ERROR("Failure saving x509 certificate");
                 result = __FAILURE__;
@@ -1059,14 +1355,14 @@ static int generate_pki_cert_and_key_helper
     const char* cert_file_name,
     const char* issuer_key_file,
     const char* issuer_certificate_file,
+    const PKI_ISSUER *issuer,
     const PKI_KEY_PROPS *key_props
 )
 {
     int result;
     uint64_t requested_validity;
     const char* common_name_prop_value;
-    X509* issuer_certificate = NULL;
-    EVP_PKEY* issuer_evp_key = NULL;
+    PKI_ISSUER* loaded_issuer = NULL;
 
     initialize_openssl();
     if (cert_props_handle == NULL)
@@ -1135,18 +1431,13 @@ static int generate_pki_cert_and_key_helper
             bool perform_cert_gen;
             if (issuer_certificate_file)
             {
-                if ((issuer_certificate = load_certificate_file(issuer_certificate_file)) == NULL)
-                {
-                    LOG_ERROR("Could not load issuer certificate file");
-                    perform_cert_gen = false;
-                }
-                else if ((issuer_evp_key = load_private_key_file(issuer_key_file)) == NULL)
+                if ((loaded_issuer = load_issuer(issuer_key_file, issuer_certificate_file)) == NULL)
                 {
-                    LOG_ERROR("Could not load issuer private key file");
                     perform_cert_gen = false;
                 }
                 else
                 {
+                    issuer = loaded_issuer;
                     perform_cert_gen = true;
                 }
             }
@@ -1163,14 +1454,14 @@ static int generate_pki_cert_and_key_helper
             {
                 X509* x509_cert = NULL;
                 EVP_PKEY* evp_key = NULL;
-                if (generate_cert_key(cert_type, issuer_certificate, key_file_name, &evp_key, key_props) != 0)
+                if (generate_cert_key(cert_type, (issuer != NULL) ? issuer->x509_cert : NULL,
+                                      key_file_name, &evp_key, key_props) != 0)
                 {
                     LOG_ERROR("Could not generate private key for certificate create request");
                     result = __FAILURE__;
                 }
                 else if (generate_evp_certificate(evp_key, cert_type, common_name_prop_value, requested_validity,
-                                                  issuer_evp_key, issuer_certificate, issuer_certificate_file,
-                                                  cert_props_handle, serial_number, ca_path_len,
+                                                  issuer, cert_props_handle, serial_number, ca_path_len,
                                                   cert_file_name, &x509_cert) != 0)
                 {
                     LOG_ERROR("Could not generate certificate create request");
@@ -1193,13 +1484,9 @@ static int generate_pki_cert_and_key_helper
         }
     }
 
-    if (issuer_certificate != NULL)
-    {
-        X509_free(issuer_certificate);
-    }
-    if (issuer_evp_key != NULL)
+    if (loaded_issuer != NULL)
     {
-        destroy_evp_key(issuer_evp_key);
+        destroy_issuer(loaded_issuer);
     }
 
     return result;
@@ -1233,6 +1520,7 @@ int generate_pki_cert_and_key_with_props
                                                   cert_file_name,
                                                   NULL,
                                                   NULL,
+                                                  NULL,
                                                   key_props);
     }
 
@@ -1257,87 +1545,380 @@ int generate_pki_cert_and_key
                                             cert_file_name,
                                             issuer_key_file,
                                             issuer_certificate_file,
+                                            NULL,
                                             NULL);
 }
 
-KEY_HANDLE create_cert_key(const char* key_file_name)
+int generate_pki_cert_and_key_with_issuer
+(
+    CERT_PROPS_HANDLE cert_props_handle,
+    int serial_number,
+    int ca_path_len,
+    const char* key_file_name,
+    const char* cert_file_name,
+    PKI_ISSUER_HANDLE issuer
+)
 {
-    KEY_HANDLE result;
-    EVP_PKEY* evp_key;
-    CERT_KEY *cert_key;
+    int result;
 
-    if (key_file_name == NULL)
+    if (issuer == NULL)
     {
-        LOG_ERROR("Key file name cannot be NULL");
-        result = NULL;
+        LOG_ERROR("Invalid issuer");
+        result = __FAILURE__;
     }
-    else if ((evp_key = load_private_key_file(key_file_name)) == NULL)
+    else
     {
-        LOG_ERROR("Could not load private key file %s", key_file_name);
-        result = NULL;
+        result = generate_pki_cert_and_key_helper(cert_props_handle,
+                                                  serial_number,
+                                                  ca_path_len,
+                                                  key_file_name,
+                                                  cert_file_name,
+                                                  NULL,
+                                                  NULL,
+                                                  issuer,
+                                                  NULL);
     }
-    else if ((cert_key = (CERT_KEY*)malloc(sizeof(CERT_KEY))) == NULL)
+
+    return result;
+}
+
+PKI_ISSUER_HANDLE pki_issuer_create(const char* issuer_key_file, const char* issuer_certificate_file)
+{
+    PKI_ISSUER_HANDLE result;
+
+    initialize_openssl();
+    if ((issuer_key_file == NULL) || (issuer_certificate_file == NULL))
     {
-        LOG_ERROR("Could not allocate memory for SAS_KEY");
-        destroy_evp_key(evp_key);
+        LOG_ERROR("Invalid issuer certificate and key file provided");
         result = NULL;
     }
     else
     {
-        cert_key->interface.hsm_client_key_sign = cert_key_sign;
+        result = load_issuer(issuer_key_file, issuer_certificate_file);
+    }
+
+    return result;
+}
+
+void pki_issuer_destroy(PKI_ISSUER_HANDLE issuer)
+{
+    if (issuer != NULL)
+    {
+        destroy_issuer(issuer);
+    }
+}
+
+KEY_HANDLE create_cert_key(const char* key_file_name)
+{
+    KEY_HANDLE result;
+    EVP_PKEY* evp_key;
+    CERT_KEY *cert_key;
+
+    if (key_file_name == NULL)
+    {
+        LOG_ERROR("Key file name cannot be NULL");
+        result = NULL;
+    }
+    else if ((evp_key = load_private_key_file(key_file_name)) == NULL)
+    {
+        LOG_ERROR("Could not load private key file %s", key_file_name);
+        result = NULL;
+    }
+    else if ((cert_key = (CERT_KEY*)malloc(sizeof(CERT_KEY))) == NULL)
+    {
+        LOG_ERROR("Could not allocate memory for SAS_KEY");
+        destroy_evp_key(evp_key);
+        result = NULL;
+    }
+    else
+    {
+        cert_key->interface.hsm_client_key_sign = cert_key_sign;
         cert_key->interface.hsm_client_key_derive_and_sign = cert_key_derive_and_sign;
         cert_key->interface.hsm_client_key_encrypt = cert_key_encrypt;
         cert_key->interface.hsm_client_key_decrypt = cert_key_decrypt;
         cert_key->interface.hsm_client_key_destroy = cert_key_destroy;
+        cert_key->interface.hsm_client_key_sign_into = cert_key_sign_into;
+        cert_key->interface.hsm_client_key_derive_and_sign_into = cert_key_derive_and_sign_into;
+        cert_key->interface.hsm_client_key_sign_batch = cert_key_sign_batch;
+        cert_key->interface.hsm_client_key_derive_and_sign_batch = cert_key_derive_and_sign_batch;
+        cert_key->interface.hsm_client_key_encrypt_init = cert_key_stream_init;
+        cert_key->interface.hsm_client_key_decrypt_init = cert_key_stream_init;
+        cert_key->interface.hsm_client_key_stream_update = cert_key_stream_update;
+        cert_key->interface.hsm_client_key_stream_final = cert_key_stream_final;
+        cert_key->interface.hsm_client_key_stream_destroy = cert_key_stream_destroy;
         cert_key->evp_key = evp_key;
         result = (KEY_HANDLE)cert_key;
     }
     return result;
 }
 
-static int validate_cert_chain
-(
-    const char *cert_file,
-    const char *issuer_cert_file,
-    bool *verify_status
-)
+static void destroy_cert_chain(PKI_CERT_CHAIN *chain)
+{
+    size_t index;
+
+    for (index = 0; index < chain->num_certs; index++)
+    {
+        X509_free(chain->certs[index].x509_cert);
+    }
+    if (chain->certs != NULL)
+    {
+        free(chain->certs);
+    }
+    chain->certs = NULL;
+    chain->num_certs = 0;
+}
+
+// takes ownership of x509_cert
+static int add_chain_cert(PKI_CERT_CHAIN *chain, X509 *x509_cert)
 {
     int result;
-    char *cert_data = NULL;
-    char *issuer_data = NULL;
+    PKI_CHAIN_CERT *certs;
+    unsigned int digest_size = 0;
 
-    *verify_status = false;
-    if ((cert_data = read_file_into_cstring(cert_file, NULL)) == NULL)
+    if ((certs = (PKI_CHAIN_CERT*)realloc(chain->certs, (chain->num_certs + 1) * sizeof(PKI_CHAIN_CERT))) == NULL)
     {
-        LOG_ERROR("Could not read certificate %s", cert_file);
+        LOG_ERROR("Could not allocate memory for certificate chain");
+        X509_free(x509_cert);
         result = __FAILURE__;
     }
-    else if ((issuer_data = read_file_into_cstring(issuer_cert_file, NULL)) == NULL)
+    else
     {
-        LOG_ERROR("Could not read issuer certificate %s", issuer_cert_file);
+        PKI_CHAIN_CERT *cert = &certs[chain->num_certs];
+        chain->certs = certs;
+        cert->x509_cert = x509_cert;
+        chain->num_certs++;
+        // X509_digest hashes the DER encoding of the certificate
+        if (!X509_digest(x509_cert, EVP_sha256(), cert->digest, &digest_size) ||
+            (digest_size != CERT_DIGEST_SIZE))
+        {
+            LOG_ERROR("Could not compute digest of certificate %zu", chain->num_certs - 1);
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+/**
+ * Parses every certificate of a PEM certificate file in the order of the
+ * file. The file is read once and each certificate is hashed once. The file
+ * may be provided by the user and rewritten in place so it is copied into
+ * memory rather than mapped.
+ */
+static int load_cert_chain(const char *cert_file_name, PKI_CERT_CHAIN *chain)
+{
+    int result;
+    void *cert_data;
+    size_t cert_size = 0;
+    BIO *cert_bio;
+
+    chain->certs = NULL;
+    chain->num_certs = 0;
+    if ((cert_data = read_file_into_buffer(cert_file_name, &cert_size)) == NULL)
+    {
+        LOG_ERROR("Could not read certificate %s", cert_file_name);
         result = __FAILURE__;
     }
     else
     {
-        if (strstr(cert_data, issuer_data) == NULL)
+        if (cert_size > INT_MAX)
+        {
+            LOG_ERROR("Certificate file too large %s", cert_file_name);
+            result = __FAILURE__;
+        }
+        else if ((cert_bio = BIO_new_mem_buf(cert_data, (int)cert_size)) == NULL)
         {
-            LOG_ERROR("Did not find issuer certificate in certificate %s", cert_file);
+            LOG_ERROR("Could not create BIO for certificate %s", cert_file_name);
+            result = __FAILURE__;
         }
         else
         {
-            *verify_status = true;
+            X509 *x509_cert;
+
+            result = 0;
+            while ((result == 0) && ((x509_cert = PEM_read_bio_X509(cert_bio, NULL, NULL, NULL)) != NULL))
+            {
+                result = add_chain_cert(chain, x509_cert);
+            }
+            if ((result == 0) && (chain->num_certs == 0))
+            {
+                LOG_ERROR("No certificates found in %s", cert_file_name);
+                result = __FAILURE__;
+            }
+            BIO_free_all(cert_bio);
+        }
+        free(cert_data);
+
+        if (result != 0)
+        {
+            destroy_cert_chain(chain);
         }
-        result = 0;
     }
 
-    if (cert_data != NULL)
+    return result;
+}
+
+/**
+ * The issuer is part of a chain when every issuer certificate is found in
+ * the chain in the order of the issuer certificate file.
+ */
+static bool is_issuer_in_chain(const PKI_CERT_CHAIN *chain, const PKI_CERT_CHAIN *issuer_chain)
+{
+    bool result = false;
+    size_t start, index;
+
+    for (start = 0; !result && ((start + issuer_chain->num_certs) <= chain->num_certs); start++)
     {
-        free(cert_data);
+        result = true;
+        for (index = 0; result && (index < issuer_chain->num_certs); index++)
+        {
+            result = (memcmp(chain->certs[start + index].digest,
+                             issuer_chain->certs[index].digest,
+                             CERT_DIGEST_SIZE) == 0);
+        }
+    }
+
+    return result;
+}
+
+static int compare_trust_anchors(const void *lhs, const void *rhs)
+{
+    unsigned long lhs_hash = ((const PKI_TRUST_ANCHOR*)lhs)->subject_hash;
+    unsigned long rhs_hash = ((const PKI_TRUST_ANCHOR*)rhs)->subject_hash;
+
+    return (lhs_hash < rhs_hash) ? -1 : ((lhs_hash > rhs_hash) ? 1 : 0);
+}
+
+static void destroy_verifier(PKI_VERIFIER *verifier)
+{
+    size_t index;
+
+    for (index = 0; index < verifier->num_anchors; index++)
+    {
+        if (verifier->anchors[index].ski != NULL)
+        {
+            ASN1_OCTET_STRING_free(verifier->anchors[index].ski);
+        }
+    }
+    if (verifier->anchors != NULL)
+    {
+        free(verifier->anchors);
     }
+    destroy_cert_chain(&verifier->issuer_chain);
+    if (verifier->store != NULL)
+    {
+        X509_STORE_free(verifier->store);
+    }
+    free(verifier);
+}
 
-    if (issuer_data != NULL)
+static PKI_VERIFIER* load_verifier(const char *issuer_certificate_file)
+{
+    PKI_VERIFIER *result;
+
+    if ((result = (PKI_VERIFIER*)calloc(1, sizeof(PKI_VERIFIER))) == NULL)
     {
-        free(issuer_data);
+        LOG_ERROR("Could not allocate memory for verifier");
+    }
+    else if (load_cert_chain(issuer_certificate_file, &result->issuer_chain) != 0)
+    {
+        LOG_ERROR("Could not load issuer certificates %s", issuer_certificate_file);
+        destroy_verifier(result);
+        result = NULL;
+    }
+    else if ((result->store = X509_STORE_new()) == NULL)
+    {
+        LOG_ERROR("API X509_STORE_new failed");
+        destroy_verifier(result);
+        result = NULL;
+    }
+    else
+    {
+        size_t index;
+        int status = 0;
+
+        X509_STORE_set_flags(result->store, X509_V_FLAG_X509_STRICT |
+                                            X509_V_FLAG_CHECK_SS_SIGNATURE |
+                                            X509_V_FLAG_POLICY_CHECK);
+        for (index = 0; (status == 0) && (index < result->issuer_chain.num_certs); index++)
+        {
+            if (!X509_STORE_add_cert(result->store, result->issuer_chain.certs[index].x509_cert))
+            {
+                LOG_ERROR("Could not add issuer certificate %zu to the store", index);
+                status = __FAILURE__;
+            }
+        }
+
+        if ((status == 0) &&
+            ((result->anchors = (PKI_TRUST_ANCHOR*)malloc(result->issuer_chain.num_certs * sizeof(PKI_TRUST_ANCHOR))) == NULL))
+        {
+            LOG_ERROR("Could not allocate memory for trust anchors");
+            status = __FAILURE__;
+        }
+
+        if (status != 0)
+        {
+            destroy_verifier(result);
+            result = NULL;
+        }
+        else
+        {
+            for (index = 0; index < result->issuer_chain.num_certs; index++)
+            {
+                X509 *x509_cert = result->issuer_chain.certs[index].x509_cert;
+                PKI_TRUST_ANCHOR *anchor = &result->anchors[index];
+                anchor->x509_cert = x509_cert;
+                anchor->subject_hash = X509_subject_name_hash(x509_cert);
+                anchor->ski = (ASN1_OCTET_STRING*)X509_get_ext_d2i(x509_cert, NID_subject_key_identifier, NULL, NULL);
+                result->num_anchors++;
+            }
+            qsort(result->anchors, result->num_anchors, sizeof(PKI_TRUST_ANCHOR), compare_trust_anchors);
+        }
+    }
+
+    return result;
+}
+
+static const PKI_TRUST_ANCHOR* find_trust_anchor(const PKI_VERIFIER *verifier, X509 *x509_cert)
+{
+    const PKI_TRUST_ANCHOR *result = NULL;
+    unsigned long issuer_hash = X509_issuer_name_hash(x509_cert);
+    AUTHORITY_KEYID *akid = (AUTHORITY_KEYID*)X509_get_ext_d2i(x509_cert, NID_authority_key_identifier, NULL, NULL);
+    size_t low = 0, high = verifier->num_anchors;
+
+    while (low < high)
+    {
+        size_t mid = low + ((high - low) / 2);
+        if (verifier->anchors[mid].subject_hash < issuer_hash)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    // several anchors may share a subject, as a renewed CA does, in which
+    // case the key identifier picks the one that signed the certificate
+    for (; (result == NULL) && (low < verifier->num_anchors) &&
+           (verifier->anchors[low].subject_hash == issuer_hash); low++)
+    {
+        const PKI_TRUST_ANCHOR *anchor = &verifier->anchors[low];
+        if ((akid == NULL) || (akid->keyid == NULL) || (anchor->ski == NULL) ||
+            (ASN1_OCTET_STRING_cmp(akid->keyid, anchor->ski) == 0))
+        {
+            result = anchor;
+        }
+    }
+
+    if (akid != NULL)
+    {
+        AUTHORITY_KEYID_free(akid);
     }
 
     return result;
@@ -1345,40 +1926,34 @@ static int validate_cert_chain
 
 static int check_certificates
 (
-    X509_STORE *store,
+    const PKI_VERIFIER *verifier,
+    X509 *x509_cert,
     const char *cert_file,
-    const char *issuer_cert_file,
     bool *verify_status
 )
 {
     int result;
     X509_STORE_CTX *store_ctxt = NULL;
-    X509* x509_cert = NULL;
     double exp_seconds = 0;
 
-    if ((x509_cert = load_certificate_file(cert_file)) == NULL)
+    if (validate_certificate_expiration(x509_cert, &exp_seconds) != 0)
     {
-        LOG_ERROR("Could not create X509 to verify certificate %s", cert_file);
+        LOG_ERROR("Certificate file has expired %s", cert_file);
         result = __FAILURE__;
     }
-    else if (validate_certificate_expiration(x509_cert, &exp_seconds) != 0)
+    else if (find_trust_anchor(verifier, x509_cert) == NULL)
     {
-        LOG_ERROR("Certificate file has expired %s", cert_file);
-        X509_free(x509_cert);
-        result = __FAILURE__;
+        LOG_ERROR("Could not find the issuer of certificate %s in the issuer certificates", cert_file);
+        result = 0;
     }
     else if ((store_ctxt = X509_STORE_CTX_new()) == NULL)
     {
         LOG_ERROR("Could not create X509 store context");
-        X509_free(x509_cert);
         result = __FAILURE__;
     }
     else
     {
-        X509_STORE_set_flags(store, X509_V_FLAG_X509_STRICT |
-                                    X509_V_FLAG_CHECK_SS_SIGNATURE |
-                                    X509_V_FLAG_POLICY_CHECK);
-        if(!X509_STORE_CTX_init(store_ctxt, store, x509_cert, 0))
+        if(!X509_STORE_CTX_init(store_ctxt, verifier->store, x509_cert, 0))
         {
             LOG_ERROR("Could not initialize X509 store context");
             result = __FAILURE__;
@@ -1395,8 +1970,7 @@ static int check_certificates
                 {
                     msg = "";
                 }
-                LOG_ERROR("Could not verify certificate %s using issuer certificate %s.",
-                        cert_file, issuer_cert_file);
+                LOG_ERROR("Could not verify certificate %s using its issuer certificates.", cert_file);
                 LOG_ERROR("Verification status: %d, Error: %d, Msg: '%s'", status, err_code, msg);
             }
             else
@@ -1407,7 +1981,39 @@ static int check_certificates
             result = 0;
         }
         X509_STORE_CTX_free(store_ctxt);
-        X509_free(x509_cert);
+    }
+
+    return result;
+}
+
+static int verify_certificate_with_verifier_internal
+(
+    const char *certificate,
+    const PKI_VERIFIER *verifier,
+    bool *verify_status
+)
+{
+    int result;
+    PKI_CERT_CHAIN chain;
+
+    if (load_cert_chain(certificate, &chain) != 0)
+    {
+        LOG_ERROR("Could not load certificate file %s", certificate);
+        result = __FAILURE__;
+    }
+    else
+    {
+        if (!is_issuer_in_chain(&chain, &verifier->issuer_chain))
+        {
+            LOG_ERROR("Certificate file does not contain issuer certificate %s", certificate);
+            result = 0;
+        }
+        else
+        {
+            LOG_DEBUG("Verifying %s", certificate);
+            result = check_certificates(verifier, chain.certs[0].x509_cert, certificate, verify_status);
+        }
+        destroy_cert_chain(&chain);
     }
 
     return result;
@@ -1421,93 +2027,369 @@ static int verify_certificate_internal
 )
 {
     int result;
-    X509_LOOKUP *lookup = NULL;
-    X509_STORE *store = NULL;
-    bool check_chain = false;
+    PKI_VERIFIER *verifier;
 
     initialize_openssl();
 
-    if (validate_cert_chain(certificate, issuer_certificate, &check_chain) != 0)
+    if ((verifier = load_verifier(issuer_certificate)) == NULL)
     {
-        LOG_ERROR("Failed verifying if issuer is contained in certificate file %s", certificate);
+        LOG_ERROR("Could not load issuer certificate %s", issuer_certificate);
         result = __FAILURE__;
     }
-    else if (!check_chain)
+    else
     {
-        LOG_ERROR("Certificate file does not contain issuer certificate %s", certificate);
-        result = 0;
+        result = verify_certificate_with_verifier_internal(certificate, verifier, verify_status);
+        destroy_verifier(verifier);
+    }
+
+    return result;
+}
+
+int verify_certificate
+(
+    const char *certificate_file_path,
+    const char *key_file_path,
+    const char *issuer_certificate_file_path,
+    bool *verify_status
+)
+{
+    int result;
+
+    if (verify_status == NULL)
+    {
+        LOG_ERROR("Invalid verify_status parameter");
+        result = __FAILURE__;
     }
-    else if ((store = X509_STORE_new()) == NULL)
+    else
     {
-        LOG_ERROR("API X509_STORE_new failed");
+        *verify_status = false;
+        if ((certificate_file_path == NULL) ||
+            (key_file_path == NULL) ||
+            (issuer_certificate_file_path == NULL))
+        {
+            LOG_ERROR("Invalid parameters");
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = verify_certificate_internal(certificate_file_path,
+                                                 issuer_certificate_file_path,
+                                                 verify_status);
+        }
+    }
+
+    return result;
+}
+
+PKI_VERIFIER_HANDLE pki_verifier_create(const char *issuer_certificate_file_path)
+{
+    PKI_VERIFIER *result;
+
+    if (issuer_certificate_file_path == NULL)
+    {
+        LOG_ERROR("Invalid issuer certificate file parameter");
+        result = NULL;
+    }
+    else
+    {
+        initialize_openssl();
+        if ((result = load_verifier(issuer_certificate_file_path)) == NULL)
+        {
+            LOG_ERROR("Could not load issuer certificate %s", issuer_certificate_file_path);
+        }
+    }
+
+    return (PKI_VERIFIER_HANDLE)result;
+}
+
+void pki_verifier_destroy(PKI_VERIFIER_HANDLE verifier)
+{
+    if (verifier != NULL)
+    {
+        destroy_verifier((PKI_VERIFIER*)verifier);
+    }
+}
+
+int verify_certificate_with_verifier
+(
+    const char *certificate_file_path,
+    PKI_VERIFIER_HANDLE verifier,
+    bool *verify_status
+)
+{
+    int result;
+
+    if (verify_status == NULL)
+    {
+        LOG_ERROR("Invalid verify_status parameter");
         result = __FAILURE__;
     }
-    else if ((lookup = X509_STORE_add_lookup(store, X509_LOOKUP_file())) == NULL)
+    else
     {
-        LOG_ERROR("X509 add lookup failed");
+        *verify_status = false;
+        if ((certificate_file_path == NULL) || (verifier == NULL))
+        {
+            LOG_ERROR("Invalid parameters");
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = verify_certificate_with_verifier_internal(certificate_file_path,
+                                                               (const PKI_VERIFIER*)verifier,
+                                                               verify_status);
+        }
+    }
+
+    return result;
+}
+
+static int digest_certificate_file
+(
+    EVP_MD_CTX *ctx,
+    const char *cert_file_name,
+    int64_t *not_after
+)
+{
+    int result;
+    BIO *cert_file;
+
+    if ((cert_file = BIO_new_file(cert_file_name, "r")) == NULL)
+    {
+        LOG_ERROR("Failure to open certificate file %s", cert_file_name);
         result = __FAILURE__;
     }
-    else if (!X509_LOOKUP_load_file(lookup, issuer_certificate, X509_FILETYPE_PEM))
+    else
+    {
+        X509 *x509_cert;
+        int num_certs = 0;
+
+        result = 0;
+        while ((result == 0) && ((x509_cert = PEM_read_bio_X509(cert_file, NULL, NULL, NULL)) != NULL))
+        {
+            unsigned char *der = NULL;
+            int der_len;
+
+            if ((der_len = i2d_X509(x509_cert, NULL)) <= 0)
+            {
+                LOG_ERROR("Could not DER encode certificate %d in %s", num_certs, cert_file_name);
+                result = __FAILURE__;
+            }
+            else if ((der = (unsigned char*)malloc((size_t)der_len)) == NULL)
+            {
+                LOG_ERROR("Could not allocate memory to DER encode certificate %s", cert_file_name);
+                result = __FAILURE__;
+            }
+            else
+            {
+                // i2d_X509 advances the output pointer so a copy is passed in.
+                // each certificate is prefixed with its length so that the
+                // boundaries between certificates contribute to the digest
+                unsigned char *der_cursor = der;
+                unsigned char len_prefix[4];
+                len_prefix[0] = (unsigned char)((der_len >> 24) & 0xFF);
+                len_prefix[1] = (unsigned char)((der_len >> 16) & 0xFF);
+                len_prefix[2] = (unsigned char)((der_len >> 8) & 0xFF);
+                len_prefix[3] = (unsigned char)(der_len & 0xFF);
+                if (i2d_X509(x509_cert, &der_cursor) != der_len)
+                {
+                    LOG_ERROR("Could not DER encode certificate %d in %s", num_certs, cert_file_name);
+                    result = __FAILURE__;
+                }
+                else if (!EVP_DigestUpdate(ctx, len_prefix, sizeof(len_prefix)) ||
+                         !EVP_DigestUpdate(ctx, der, (size_t)der_len))
+                {
+                    LOG_ERROR("Computing SHA-256 digest failed for %s", cert_file_name);
+                    result = __FAILURE__;
+                }
+                else if ((num_certs == 0) && (not_after != NULL))
+                {
+                    ASN1_TIME *exp_asn1 = X509_get_notAfter(x509_cert);
+                    time_t exp_time = get_utc_time_from_asn_string(exp_asn1->data, exp_asn1->length);
+                    if (exp_time == 0)
+                    {
+                        LOG_ERROR("Could not parse expiration date from certificate %s", cert_file_name);
+                        result = __FAILURE__;
+                    }
+                    else
+                    {
+                        *not_after = (int64_t)exp_time;
+                    }
+                }
+            }
+            if (der != NULL)
+            {
+                free(der);
+            }
+            X509_free(x509_cert);
+            num_certs++;
+        }
+        if ((result == 0) && (num_certs == 0))
+        {
+            LOG_ERROR("No certificates found in %s", cert_file_name);
+            result = __FAILURE__;
+        }
+        BIO_free_all(cert_file);
+    }
+
+    return result;
+}
+
+int get_certificate_verification_id
+(
+    const char *certificate_file_path,
+    const char *issuer_certificate_file_path,
+    unsigned char *id,
+    size_t id_size,
+    int64_t *not_after
+)
+{
+    int result;
+    EVP_MD_CTX *ctx;
+    static const unsigned char FILE_SEPARATOR[4] = { 0, 0, 0, 0 };
+
+    if ((certificate_file_path == NULL) || (issuer_certificate_file_path == NULL))
     {
-        LOG_ERROR("Loading issuer certificate failed");
+        LOG_ERROR("Invalid certificate file parameters");
         result = __FAILURE__;
     }
-    else if ((lookup = X509_STORE_add_lookup(store, X509_LOOKUP_hash_dir())) == NULL)
+    else if ((id == NULL) || (id_size < CERT_VERIFICATION_ID_SIZE))
     {
-        LOG_ERROR("Setting up store lookup failed");
+        LOG_ERROR("Invalid verification id buffer");
         result = __FAILURE__;
     }
-    else if (!X509_LOOKUP_add_dir(lookup, NULL, X509_FILETYPE_DEFAULT))
+    else if (not_after == NULL)
     {
-        LOG_ERROR("Setting up store lookup failed");
+        LOG_ERROR("Invalid not_after parameter");
         result = __FAILURE__;
     }
     else
     {
-        LOG_DEBUG("Verifying %s using %s", certificate, issuer_certificate);
-        result = check_certificates(store, certificate, issuer_certificate, verify_status);
-    }
+        initialize_openssl();
 
-    if (store != NULL)
-    {
-        X509_STORE_free(store);
+        if ((ctx = EVP_MD_CTX_create()) == NULL)
+        {
+            LOG_ERROR("Could not create digest context");
+            result = __FAILURE__;
+        }
+        else
+        {
+            unsigned int digest_size = 0;
+            if (!EVP_DigestInit_ex(ctx, EVP_sha256(), NULL))
+            {
+                LOG_ERROR("Could not initialize SHA-256 digest");
+                result = __FAILURE__;
+            }
+            else if (digest_certificate_file(ctx, certificate_file_path, not_after) != 0)
+            {
+                LOG_ERROR("Could not digest certificate file %s", certificate_file_path);
+                result = __FAILURE__;
+            }
+            else if (!EVP_DigestUpdate(ctx, FILE_SEPARATOR, sizeof(FILE_SEPARATOR)))
+            {
+                LOG_ERROR("Computing SHA-256 digest failed");
+                result = __FAILURE__;
+            }
+            else if (digest_certificate_file(ctx, issuer_certificate_file_path, NULL) != 0)
+            {
+                LOG_ERROR("Could not digest issuer certificate file %s", issuer_certificate_file_path);
+                result = __FAILURE__;
+            }
+            else if (!EVP_DigestFinal_ex(ctx, id, &digest_size) ||
+                     (digest_size != CERT_VERIFICATION_ID_SIZE))
+            {
+                LOG_ERROR("Computing SHA-256 digest failed");
+                result = __FAILURE__;
+            }
+            else
+            {
+                result = 0;
+            }
+            EVP_MD_CTX_destroy(ctx);
+        }
     }
 
     return result;
 }
 
-int verify_certificate
+int check_certificate_key
 (
     const char *certificate_file_path,
     const char *key_file_path,
-    const char *issuer_certificate_file_path,
-    bool *verify_status
+    bool *key_matches
 )
 {
     int result;
 
-    if (verify_status == NULL)
+    if ((certificate_file_path == NULL) || (key_file_path == NULL) || (key_matches == NULL))
     {
-        LOG_ERROR("Invalid verify_status parameter");
+        LOG_ERROR("Invalid parameters");
         result = __FAILURE__;
     }
     else
     {
-        *verify_status = false;
-        if ((certificate_file_path == NULL) ||
-            (key_file_path == NULL) ||
-            (issuer_certificate_file_path == NULL))
+        X509 *x509_cert;
+        EVP_PKEY *evp_key;
+
+        initialize_openssl();
+        *key_matches = false;
+        if ((x509_cert = load_certificate_file(certificate_file_path)) == NULL)
         {
-            LOG_ERROR("Invalid parameters");
+            LOG_ERROR("Could not load certificate file %s", certificate_file_path);
             result = __FAILURE__;
         }
         else
         {
-            result = verify_certificate_internal(certificate_file_path,
-                                                 issuer_certificate_file_path,
-                                                 verify_status);
+            if ((evp_key = load_private_key_file(key_file_path)) == NULL)
+            {
+                LOG_ERROR("Could not load private key file %s", key_file_path);
+                result = __FAILURE__;
+            }
+            else
+            {
+                *key_matches = (X509_check_private_key(x509_cert, evp_key) == 1);
+                EVP_PKEY_free(evp_key);
+                result = 0;
+            }
+            X509_free(x509_cert);
         }
     }
 
     return result;
 }
+
+int pki_key_pool_init(size_t pool_size)
+{
+    int result;
+
+    initialize_openssl();
+    if (g_pki_key_pool != NULL)
+    {
+        LOG_ERROR("Key pool already initialized");
+        result = __FAILURE__;
+    }
+    else if ((g_pki_key_pool = hsm_key_pool_create(pool_size, generate_key_by_type, destroy_pooled_key)) == NULL)
+    {
+        LOG_ERROR("Could not create key pool of size %zu", pool_size);
+        result = __FAILURE__;
+    }
+    else
+    {
+        LOG_INFO("Pre-generating up to %zu keys per key type", pool_size);
+        result = 0;
+    }
+
+    return result;
+}
+
+void pki_key_pool_deinit(void)
+{
+    if (g_pki_key_pool != NULL)
+    {
+        HSM_KEY_POOL_METRICS metrics;
+        hsm_key_pool_get_metrics(g_pki_key_pool, &metrics);
+        LOG_INFO("Key pool hits %llu misses %llu",
+                 (unsigned long long)metrics.hits, (unsigned long long)metrics.misses);
+        hsm_key_pool_destroy(g_pki_key_pool);
+        g_pki_key_pool = NULL;
+    }
+}
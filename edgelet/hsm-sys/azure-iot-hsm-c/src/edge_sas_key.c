@@ -1,18 +1,304 @@
 // Copyright (c) Microsoft. All rights reserved.
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
+#if !(defined __WINDOWS__ || defined _WIN32 || defined _WIN64 || defined _Windows)
+    // MAP_ANONYMOUS is not visible in strict C99 builds
+    #if !defined _DEFAULT_SOURCE
+        #define _DEFAULT_SOURCE
+    #endif
+#endif
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include "azure_c_shared_utility/gballoc.h"
-#include "edge_sas_perform_sign_with_key.h"
+#include "hsm_hmac.h"
 #include "hsm_key.h"
+#include "hsm_lock.h"
 #include "hsm_log.h"
+#include "hsm_utils.h"
+
+#if defined __WINDOWS__ || defined _WIN32 || defined _WIN64 || defined _Windows
+    #include <windows.h>
+#else
+    #include <sys/mman.h>
+
+    #if !defined MAP_ANONYMOUS && defined MAP_ANON
+        #define MAP_ANONYMOUS MAP_ANON
+    #endif
+#endif
+
+//##############################################################################
+// Data types
+//##############################################################################
+// Keys derived by sas_key_derive_and_sign are cached per identity, module
+// identities are short so longer identities are derived on every call.
+#define SAS_KEY_CACHE_SIZE 16
+#define SAS_KEY_CACHE_MAX_IDENTITY_SIZE 256
+
+typedef struct SAS_KEY_CACHE_ENTRY_TAG
+{
+    // zero when the entry is unused, otherwise the cache clock at last use
+    uint64_t last_used;
+    size_t identity_size;
+    HSM_HMAC_KEY derived_key;
+    unsigned char identity[SAS_KEY_CACHE_MAX_IDENTITY_SIZE];
+} SAS_KEY_CACHE_ENTRY;
+
+// Mapped on the first derive and locked in memory so that derived keys are
+// never paged out. Every entry is zeroized before the cache is unmapped.
+typedef struct SAS_KEY_CACHE_TAG
+{
+    uint64_t clock;
+    SAS_KEY_CACHE_ENTRY entries[SAS_KEY_CACHE_SIZE];
+} SAS_KEY_CACHE;
 
+// A SAS key is shared by every handle the store hands out for it and is
+// replaced when the identity key is activated again, which drops its cache.
+// Only the precomputed HMAC state of the key is kept, cache and
+// is_cache_disabled are guarded by the mutex.
 struct SAS_KEY_TAG
 {
     HSM_CLIENT_KEY_INTERFACE intf;
-    unsigned char *key;
-    size_t key_len;
+    HSM_HMAC_KEY hmac_key;
+    SAS_KEY_CACHE *cache;
+    bool is_cache_disabled;
+    HSM_MUTEX_HANDLE mutex;
 };
 typedef struct SAS_KEY_TAG SAS_KEY;
 
+//##############################################################################
+// Locked memory helpers
+//##############################################################################
+static void* alloc_locked_buffer(size_t size)
+{
+    void *result;
+
+#if defined __WINDOWS__ || defined _WIN32 || defined _WIN64 || defined _Windows
+    if ((result = VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE)) == NULL)
+    {
+        LOG_ERROR("Could not allocate derived key cache. GetLastError=%08x", GetLastError());
+    }
+    else if (!VirtualLock(result, size))
+    {
+        LOG_INFO("Could not lock derived key cache in memory, keys will not be cached. GetLastError=%08x",
+                 GetLastError());
+        (void)VirtualFree(result, 0, MEM_RELEASE);
+        result = NULL;
+    }
+#else
+    if ((result = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED)
+    {
+        LOG_ERROR("Could not allocate derived key cache. Errno %d", errno);
+        result = NULL;
+    }
+    else if (mlock(result, size) != 0)
+    {
+        LOG_INFO("Could not lock derived key cache in memory, keys will not be cached. Errno %d", errno);
+        (void)munmap(result, size);
+        result = NULL;
+    }
+    else
+    {
+    #if defined MADV_DONTDUMP
+        (void)madvise(result, size, MADV_DONTDUMP);
+    #endif
+    }
+#endif
+
+    return result;
+}
+
+static void free_locked_buffer(void *buffer, size_t size)
+{
+    secure_zero(buffer, size);
+#if defined __WINDOWS__ || defined _WIN32 || defined _WIN64 || defined _Windows
+    (void)VirtualUnlock(buffer, size);
+    (void)VirtualFree(buffer, 0, MEM_RELEASE);
+#else
+    (void)munlock(buffer, size);
+    (void)munmap(buffer, size);
+#endif
+}
+
+//##############################################################################
+// Derived key cache
+//##############################################################################
+static SAS_KEY_CACHE_ENTRY* find_cache_entry
+(
+    SAS_KEY_CACHE *cache,
+    const unsigned char *identity,
+    size_t identity_size
+)
+{
+    SAS_KEY_CACHE_ENTRY *result = NULL;
+    size_t index;
+
+    for (index = 0; (index < SAS_KEY_CACHE_SIZE) && (result == NULL); index++)
+    {
+        SAS_KEY_CACHE_ENTRY *entry = &cache->entries[index];
+        if ((entry->last_used != 0) &&
+            (entry->identity_size == identity_size) &&
+            (memcmp(entry->identity, identity, identity_size) == 0))
+        {
+            result = entry;
+        }
+    }
+
+    return result;
+}
+
+// Copies the cached key derived for identity into derived_key, returns
+// false when the identity is not cached.
+static bool get_cached_derived_key
+(
+    SAS_KEY *sas_key,
+    const unsigned char *identity,
+    size_t identity_size,
+    HSM_HMAC_KEY *derived_key
+)
+{
+    bool result = false;
+
+    if (identity_size <= SAS_KEY_CACHE_MAX_IDENTITY_SIZE)
+    {
+        SAS_KEY_CACHE_ENTRY *entry;
+
+        hsm_mutex_lock(sas_key->mutex);
+        if ((sas_key->cache != NULL) &&
+            ((entry = find_cache_entry(sas_key->cache, identity, identity_size)) != NULL))
+        {
+            entry->last_used = ++sas_key->cache->clock;
+            *derived_key = entry->derived_key;
+            result = true;
+        }
+        hsm_mutex_unlock(sas_key->mutex);
+    }
+
+    return result;
+}
+
+static void cache_derived_key
+(
+    SAS_KEY *sas_key,
+    const unsigned char *identity,
+    size_t identity_size,
+    const HSM_HMAC_KEY *derived_key
+)
+{
+    if (identity_size <= SAS_KEY_CACHE_MAX_IDENTITY_SIZE)
+    {
+        hsm_mutex_lock(sas_key->mutex);
+        if ((sas_key->cache == NULL) && !sas_key->is_cache_disabled)
+        {
+            if ((sas_key->cache = (SAS_KEY_CACHE*)alloc_locked_buffer(sizeof(SAS_KEY_CACHE))) == NULL)
+            {
+                sas_key->is_cache_disabled = true;
+            }
+        }
+        // another caller may have derived the same key concurrently
+        if ((sas_key->cache != NULL) &&
+            (find_cache_entry(sas_key->cache, identity, identity_size) == NULL))
+        {
+            SAS_KEY_CACHE_ENTRY *entry = &sas_key->cache->entries[0];
+            size_t index;
+
+            for (index = 1; index < SAS_KEY_CACHE_SIZE; index++)
+            {
+                if (sas_key->cache->entries[index].last_used < entry->last_used)
+                {
+                    entry = &sas_key->cache->entries[index];
+                }
+            }
+            secure_zero(entry, sizeof(SAS_KEY_CACHE_ENTRY));
+            memcpy(entry->identity, identity, identity_size);
+            entry->identity_size = identity_size;
+            entry->derived_key = *derived_key;
+            entry->last_used = ++sas_key->cache->clock;
+        }
+        hsm_mutex_unlock(sas_key->mutex);
+    }
+}
+
+//##############################################################################
+// SAS key interface
+//##############################################################################
+
+// Signs into a newly allocated digest
+static int sign_with_hmac_key
+(
+    const HSM_HMAC_KEY *hmac_key,
+    const unsigned char* data_to_be_signed,
+    size_t data_to_be_signed_size,
+    unsigned char** digest,
+    size_t* digest_size
+)
+{
+    int result;
+    unsigned char *result_digest;
+
+    if ((result_digest = (unsigned char*)malloc(HSM_HMAC_DIGEST_SIZE)) == NULL)
+    {
+        LOG_ERROR("Error allocating memory for digest");
+        result = __FAILURE__;
+    }
+    else if (hsm_hmac_sign(hmac_key, data_to_be_signed, data_to_be_signed_size, result_digest) != 0)
+    {
+        LOG_ERROR("Error computing HMAC256SHA signature");
+        free(result_digest);
+        result = __FAILURE__;
+    }
+    else
+    {
+        *digest = result_digest;
+        *digest_size = HSM_HMAC_DIGEST_SIZE;
+        result = 0;
+    }
+
+    return result;
+}
+
+// Signs into a digest buffer supplied by the caller, only the required size
+// is returned when digest is NULL
+static int sign_into_with_hmac_key
+(
+    const HSM_HMAC_KEY *hmac_key,
+    const unsigned char* data_to_be_signed,
+    size_t data_to_be_signed_size,
+    unsigned char* digest,
+    size_t* digest_size
+)
+{
+    int result;
+
+    if (digest == NULL)
+    {
+        *digest_size = HSM_HMAC_DIGEST_SIZE;
+        result = 0;
+    }
+    else if (*digest_size < HSM_HMAC_DIGEST_SIZE)
+    {
+        LOG_ERROR("Digest buffer of size %zu is too small", *digest_size);
+        *digest_size = HSM_HMAC_DIGEST_SIZE;
+        result = __FAILURE__;
+    }
+    else if (hsm_hmac_sign(hmac_key, data_to_be_signed, data_to_be_signed_size, digest) != 0)
+    {
+        LOG_ERROR("Error computing HMAC256SHA signature");
+        *digest_size = 0;
+        result = __FAILURE__;
+    }
+    else
+    {
+        *digest_size = HSM_HMAC_DIGEST_SIZE;
+        result = 0;
+    }
+
+    return result;
+}
+
 static int sas_key_sign
 (
     KEY_HANDLE key_handle,
@@ -31,13 +317,48 @@ static int sas_key_sign
     }
     else
     {
-        result = perform_sign_with_key(sas_key->key,
-                                       sas_key->key_len,
-                                       data_to_be_signed,
-                                       data_to_be_signed_size,
-                                       digest,
-                                       digest_size);
+        result = sign_with_hmac_key(&sas_key->hmac_key,
+                                    data_to_be_signed,
+                                    data_to_be_signed_size,
+                                    digest,
+                                    digest_size);
+    }
+    return result;
+}
+
+// Looks up the key derived for identity, deriving and caching it on a miss
+static int get_derived_key
+(
+    SAS_KEY *sas_key,
+    const unsigned char* identity,
+    size_t identity_size,
+    HSM_HMAC_KEY *derived_key
+)
+{
+    int result;
+
+    if (get_cached_derived_key(sas_key, identity, identity_size, derived_key))
+    {
+        result = 0;
+    }
+    else
+    {
+        unsigned char derived_key_bytes[HSM_HMAC_DIGEST_SIZE];
+
+        if ((hsm_hmac_sign(&sas_key->hmac_key, identity, identity_size, derived_key_bytes) != 0) ||
+            (hsm_hmac_key_init(derived_key, derived_key_bytes, sizeof(derived_key_bytes)) != 0))
+        {
+            LOG_ERROR("Error deriving key for identity %s", identity);
+            result = __FAILURE__;
+        }
+        else
+        {
+            cache_derived_key(sas_key, identity, identity_size, derived_key);
+            result = 0;
+        }
+        secure_zero(derived_key_bytes, sizeof(derived_key_bytes));
     }
+
     return result;
 }
 
@@ -53,29 +374,198 @@ int sas_key_derive_and_sign
 )
 {
     int result;
-    unsigned char* derived_key = NULL;
-    size_t derived_key_size = 0;
+    HSM_HMAC_KEY derived_key;
     SAS_KEY* sas_key = (SAS_KEY*)key_handle;
 
-    if ((result = perform_sign_with_key(sas_key->key, sas_key->key_len,
-                                        identity, identity_size,
-                                        &derived_key, &derived_key_size)) != 0)
+    if ((result = get_derived_key(sas_key, identity, identity_size, &derived_key)) == 0)
     {
-        LOG_ERROR("Error deriving key for identity %s", identity);
+        if ((result = sign_with_hmac_key(&derived_key,
+                                         data_to_be_signed, data_to_be_signed_size,
+                                         digest, digest_size)) != 0)
+        {
+            LOG_ERROR("Error signing payload for identity %s", identity);
+        }
+    }
+    hsm_hmac_key_clear(&derived_key);
+    return result;
+}
+
+static int sas_key_sign_into
+(
+    KEY_HANDLE key_handle,
+    const unsigned char* data_to_be_signed,
+    size_t data_to_be_signed_size,
+    unsigned char* digest,
+    size_t* digest_size
+)
+{
+    int result;
+    SAS_KEY *sas_key = (SAS_KEY*)key_handle;
+    if (sas_key == NULL)
+    {
+        LOG_ERROR("Invalid key handle");
+        result = 1;
     }
     else
     {
-        if ((result = perform_sign_with_key(derived_key, derived_key_size,
-                                            data_to_be_signed, data_to_be_signed_size,
-                                            digest, digest_size)) != 0)
+        result = sign_into_with_hmac_key(&sas_key->hmac_key,
+                                         data_to_be_signed,
+                                         data_to_be_signed_size,
+                                         digest,
+                                         digest_size);
+    }
+    return result;
+}
+
+static int sas_key_derive_and_sign_into
+(
+    KEY_HANDLE key_handle,
+    const unsigned char* data_to_be_signed,
+    size_t data_to_be_signed_size,
+    const unsigned char* identity,
+    size_t identity_size,
+    unsigned char* digest,
+    size_t* digest_size
+)
+{
+    int result;
+    SAS_KEY* sas_key = (SAS_KEY*)key_handle;
+
+    if ((digest == NULL) || (*digest_size < HSM_HMAC_DIGEST_SIZE))
+    {
+        // size query or short buffer, the key is not used so nothing is derived
+        result = sign_into_with_hmac_key(NULL, data_to_be_signed, data_to_be_signed_size,
+                                         digest, digest_size);
+    }
+    else
+    {
+        HSM_HMAC_KEY derived_key;
+
+        if ((result = get_derived_key(sas_key, identity, identity_size, &derived_key)) == 0)
         {
-            LOG_ERROR("Error signing payload for identity %s", identity);
+            if ((result = sign_into_with_hmac_key(&derived_key,
+                                                  data_to_be_signed, data_to_be_signed_size,
+                                                  digest, digest_size)) != 0)
+            {
+                LOG_ERROR("Error signing payload for identity %s", identity);
+            }
+        }
+        hsm_hmac_key_clear(&derived_key);
+    }
+    return result;
+}
+
+// Signs the requests in groups of HSM_SHA256_LANES so the multi-buffer
+// SHA-256 kernel hashes as many strings to sign at once as it can. When
+// derive is set each request is signed with the key derived for its identity.
+static int sign_batch_with_sas_key
+(
+    SAS_KEY* sas_key,
+    bool derive,
+    const HSM_SIGN_REQUEST* requests,
+    size_t count,
+    unsigned char* digests,
+    size_t* digest_size
+)
+{
+    int result;
+
+    if (sas_key == NULL)
+    {
+        LOG_ERROR("Invalid key handle");
+        result = __FAILURE__;
+    }
+    else if (digests == NULL)
+    {
+        *digest_size = HSM_HMAC_DIGEST_SIZE;
+        result = 0;
+    }
+    else if ((count > (SIZE_MAX / HSM_HMAC_DIGEST_SIZE)) ||
+             (*digest_size < (count * HSM_HMAC_DIGEST_SIZE)))
+    {
+        LOG_ERROR("Digest buffer of size %zu is too small for %zu digests", *digest_size, count);
+        *digest_size = HSM_HMAC_DIGEST_SIZE;
+        result = __FAILURE__;
+    }
+    else
+    {
+        HSM_HMAC_KEY derived_keys[HSM_SHA256_LANES];
+        HSM_HMAC_REQUEST hmac_requests[HSM_SHA256_LANES];
+        size_t group, index;
+
+        result = 0;
+        for (group = 0; (result == 0) && (group < count); group += HSM_SHA256_LANES)
+        {
+            size_t group_size = ((count - group) > HSM_SHA256_LANES) ? HSM_SHA256_LANES : (count - group);
+
+            for (index = 0; (result == 0) && (index < group_size); index++)
+            {
+                const HSM_SIGN_REQUEST *request = &requests[group + index];
+                if (!derive)
+                {
+                    hmac_requests[index].key = &sas_key->hmac_key;
+                }
+                else if (get_derived_key(sas_key, request->identity, request->identity_size,
+                                         &derived_keys[index]) == 0)
+                {
+                    hmac_requests[index].key = &derived_keys[index];
+                }
+                else
+                {
+                    LOG_ERROR("Error deriving key for batch request %zu", group + index);
+                    result = __FAILURE__;
+                }
+                hmac_requests[index].data = request->data;
+                hmac_requests[index].data_size = request->data_size;
+                hmac_requests[index].digest = digests + ((group + index) * HSM_HMAC_DIGEST_SIZE);
+            }
+
+            if ((result == 0) && (hsm_hmac_sign_batch(hmac_requests, group_size) != 0))
+            {
+                LOG_ERROR("Error computing HMAC256SHA signatures");
+                result = __FAILURE__;
+            }
+        }
+        secure_zero(derived_keys, sizeof(derived_keys));
+
+        if (result == 0)
+        {
+            *digest_size = HSM_HMAC_DIGEST_SIZE;
+        }
+        else
+        {
+            secure_zero(digests, count * HSM_HMAC_DIGEST_SIZE);
+            *digest_size = 0;
         }
-        free(derived_key);
     }
+
     return result;
 }
 
+static int sas_key_sign_batch
+(
+    KEY_HANDLE key_handle,
+    const HSM_SIGN_REQUEST* requests,
+    size_t count,
+    unsigned char* digests,
+    size_t* digest_size
+)
+{
+    return sign_batch_with_sas_key((SAS_KEY*)key_handle, false, requests, count, digests, digest_size);
+}
+
+static int sas_key_derive_and_sign_batch
+(
+    KEY_HANDLE key_handle,
+    const HSM_SIGN_REQUEST* requests,
+    size_t count,
+    unsigned char* digests,
+    size_t* digest_size
+)
+{
+    return sign_batch_with_sas_key((SAS_KEY*)key_handle, true, requests, count, digests, digest_size);
+}
+
 static int sas_key_encrypt(KEY_HANDLE key_handle,
                             const SIZED_BUFFER *identity,
                             const SIZED_BUFFER *plaintext,
@@ -110,15 +600,87 @@ static int sas_key_decrypt(KEY_HANDLE key_handle,
     return 1;
 }
 
+static int sas_key_stream_init
+(
+    KEY_HANDLE key_handle,
+    const SIZED_BUFFER *identity,
+    const SIZED_BUFFER *initialization_vector,
+    KEY_STREAM_HANDLE *stream
+)
+{
+    (void)key_handle;
+    (void)identity;
+    (void)initialization_vector;
+
+    LOG_ERROR("Shared access key stream encrypt and decrypt operations not supported");
+    if (stream != NULL)
+    {
+        *stream = NULL;
+    }
+    return __FAILURE__;
+}
+
+static int sas_key_stream_update
+(
+    KEY_HANDLE key_handle,
+    KEY_STREAM_HANDLE stream,
+    const unsigned char *input,
+    size_t input_size,
+    unsigned char *output,
+    size_t *output_size
+)
+{
+    (void)key_handle;
+    (void)stream;
+    (void)input;
+    (void)input_size;
+    (void)output;
+
+    LOG_ERROR("Shared access key stream update operation not supported");
+    if (output_size != NULL)
+    {
+        *output_size = 0;
+    }
+    return __FAILURE__;
+}
+
+static int sas_key_stream_final
+(
+    KEY_HANDLE key_handle,
+    KEY_STREAM_HANDLE stream,
+    unsigned char *output,
+    size_t *output_size
+)
+{
+    (void)key_handle;
+    (void)stream;
+    (void)output;
+
+    LOG_ERROR("Shared access key stream final operation not supported");
+    if (output_size != NULL)
+    {
+        *output_size = 0;
+    }
+    return __FAILURE__;
+}
+
+static void sas_key_stream_destroy(KEY_HANDLE key_handle, KEY_STREAM_HANDLE stream)
+{
+    (void)key_handle;
+    (void)stream;
+}
+
 void sas_key_destroy(KEY_HANDLE key_handle)
 {
     SAS_KEY *sas_key = (SAS_KEY*)key_handle;
     if (sas_key != NULL)
     {
-        if (sas_key->key != NULL)
+        if (sas_key->cache != NULL)
         {
-            free(sas_key->key);
+            free_locked_buffer(sas_key->cache, sizeof(SAS_KEY_CACHE));
         }
+        hsm_mutex_destroy(sas_key->mutex);
+        hsm_hmac_key_clear(&sas_key->hmac_key);
         free(sas_key);
     }
 }
@@ -138,21 +700,37 @@ KEY_HANDLE create_sas_key(const unsigned char* key, size_t key_len)
         {
             LOG_ERROR("Could not allocate memory for SAS_KEY");
         }
-        else if ((sas_key->key = (unsigned char*)malloc(key_len)) == NULL)
+        else if (hsm_hmac_key_init(&sas_key->hmac_key, key, key_len) != 0)
+        {
+            LOG_ERROR("Could not compute HMAC state for sas key creation");
+            free(sas_key);
+            sas_key = NULL;
+        }
+        else if ((sas_key->mutex = hsm_mutex_create()) == NULL)
         {
-            LOG_ERROR("Could not allocate memory for sas key creation");
+            LOG_ERROR("Could not create sas key mutex");
+            hsm_hmac_key_clear(&sas_key->hmac_key);
             free(sas_key);
             sas_key = NULL;
         }
         else
         {
+            sas_key->cache = NULL;
+            sas_key->is_cache_disabled = false;
             sas_key->intf.hsm_client_key_sign = sas_key_sign;
             sas_key->intf.hsm_client_key_derive_and_sign = sas_key_derive_and_sign;
             sas_key->intf.hsm_client_key_encrypt = sas_key_encrypt;
             sas_key->intf.hsm_client_key_decrypt = sas_key_decrypt;
             sas_key->intf.hsm_client_key_destroy = sas_key_destroy;
-            memcpy(sas_key->key, key, key_len);
-            sas_key->key_len = key_len;
+            sas_key->intf.hsm_client_key_sign_into = sas_key_sign_into;
+            sas_key->intf.hsm_client_key_derive_and_sign_into = sas_key_derive_and_sign_into;
+            sas_key->intf.hsm_client_key_sign_batch = sas_key_sign_batch;
+            sas_key->intf.hsm_client_key_derive_and_sign_batch = sas_key_derive_and_sign_batch;
+            sas_key->intf.hsm_client_key_encrypt_init = sas_key_stream_init;
+            sas_key->intf.hsm_client_key_decrypt_init = sas_key_stream_init;
+            sas_key->intf.hsm_client_key_stream_update = sas_key_stream_update;
+            sas_key->intf.hsm_client_key_stream_final = sas_key_stream_final;
+            sas_key->intf.hsm_client_key_stream_destroy = sas_key_stream_destroy;
         }
     }
     return (KEY_HANDLE)sas_key;
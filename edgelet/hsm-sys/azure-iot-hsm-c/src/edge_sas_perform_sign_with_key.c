@@ -1,65 +1,220 @@
 // Copyright (c) Microsoft. All rights reserved.
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
-#include "azure_c_shared_utility/buffer_.h"
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
 #include "azure_c_shared_utility/gballoc.h"
-#include "azure_c_shared_utility/hmacsha256.h"
 #include "azure_c_shared_utility/macro_utils.h"
 
+#include "hsm_constants.h"
+#include "hsm_hmac.h"
+#include "hsm_lock.h"
 #include "hsm_log.h"
+#include "hsm_utils.h"
 
-int perform_sign_with_key
+// perform_sign_with_key is only called by the TPM device, with the key it
+// derives per identity, so the engine only applies to that path. In memory
+// SAS keys sign from their own precomputed pad states in edge_sas_key.c.
+// The engine is resolved once, 0 until resolved
+#define HMAC_ENGINE_UNKNOWN 0
+#define HMAC_ENGINE_BUILTIN 1
+#define HMAC_ENGINE_OPENSSL 2
+
+#if defined USE_OPENSSL_HMAC
+    #define DEFAULT_HMAC_ENGINE HMAC_ENGINE_OPENSSL
+#else
+    #define DEFAULT_HMAC_ENGINE HMAC_ENGINE_BUILTIN
+#endif
+
+static const char* const HMAC_ENGINE_NAME_BUILTIN = "builtin";
+static const char* const HMAC_ENGINE_NAME_OPENSSL = "openssl";
+
+//##############################################################################
+// HMAC engine selection
+//##############################################################################
+static bool engine_name_matches(const char *value, const char *expected)
+{
+    size_t index;
+    for (index = 0; (expected[index] != 0) &&
+                    (tolower((unsigned char)value[index]) == expected[index]); index++);
+    return (expected[index] == 0) && (value[index] == 0);
+}
+
+static long read_hmac_engine(void)
+{
+    long result = DEFAULT_HMAC_ENGINE;
+    char *env_value = NULL;
+
+    if (hsm_get_env(ENV_HSM_HMAC_ENGINE, &env_value) != 0)
+    {
+        LOG_ERROR("Could not lookup env variable %s", ENV_HSM_HMAC_ENGINE);
+    }
+    else if (env_value != NULL)
+    {
+        if (engine_name_matches(env_value, HMAC_ENGINE_NAME_OPENSSL))
+        {
+            result = HMAC_ENGINE_OPENSSL;
+        }
+        else if (engine_name_matches(env_value, HMAC_ENGINE_NAME_BUILTIN))
+        {
+            result = HMAC_ENGINE_BUILTIN;
+        }
+        else
+        {
+            LOG_ERROR("Unknown HMAC engine '%s' in %s, using the default", env_value, ENV_HSM_HMAC_ENGINE);
+        }
+        free(env_value);
+    }
+
+    return result;
+}
+
+static long get_hmac_engine(void)
+{
+    static volatile long hmac_engine = HMAC_ENGINE_UNKNOWN;
+    long result = hsm_atomic_load(&hmac_engine);
+
+    if (result == HMAC_ENGINE_UNKNOWN)
+    {
+        // racing threads read the same environment and store the same value
+        result = read_hmac_engine();
+        hsm_atomic_store(&hmac_engine, result);
+    }
+
+    return result;
+}
+
+static int compute_hmac
 (
     const unsigned char* key,
     size_t key_len,
     const unsigned char* data_to_be_signed,
     size_t data_to_be_signed_size,
-    unsigned char** digest,
-    size_t* digest_size
+    unsigned char* digest
 )
 {
     int result;
-    BUFFER_HANDLE signed_payload_handle;
 
-    if ((signed_payload_handle = BUFFER_new()) == NULL)
-    {
-        LOG_ERROR("Error allocating new buffer handle");
-        result = __FAILURE__;
-    }
-    else
+    if (get_hmac_engine() == HMAC_ENGINE_OPENSSL)
     {
-        size_t signed_payload_size;
-        unsigned char *result_digest, *src_digest;
-        int status = HMACSHA256_ComputeHash(key, key_len, data_to_be_signed,
-                                            data_to_be_signed_size, signed_payload_handle);
-        if (status != HMACSHA256_OK)
+        if (hsm_hmac_openssl_sign(key, key_len, data_to_be_signed, data_to_be_signed_size, digest) != 0)
         {
-            LOG_ERROR("Error computing HMAC256SHA signature");
-            result =  __FAILURE__;
+            LOG_ERROR("Error computing HMAC256SHA signature with OpenSSL");
+            result = __FAILURE__;
         }
-        else if ((signed_payload_size = BUFFER_length(signed_payload_handle)) == 0)
-        {
-            LOG_ERROR("Error computing HMAC256SHA. Signature size is 0");
-            result =  __FAILURE__;
-        }
-        else if ((src_digest = BUFFER_u_char(signed_payload_handle)) == NULL)
+        else
         {
-            LOG_ERROR("Error obtaining underlying uchar buffer");
-            result =  __FAILURE__;
+            result = 0;
         }
-        else if ((result_digest = (unsigned char*)malloc(signed_payload_size)) == NULL)
+    }
+    else
+    {
+        HSM_HMAC_KEY hmac_key;
+
+        if (hsm_hmac_key_init(&hmac_key, key, key_len) != 0)
         {
-            LOG_ERROR("Error allocating memory for digest");
-            result =  __FAILURE__;
+            LOG_ERROR("Error computing HMAC256SHA key state");
+            result = __FAILURE__;
         }
         else
         {
-            memcpy(result_digest, src_digest, signed_payload_size);
-            *digest = result_digest;
-            *digest_size = signed_payload_size;
-            result = 0;
+            if (hsm_hmac_sign(&hmac_key, data_to_be_signed, data_to_be_signed_size, digest) != 0)
+            {
+                LOG_ERROR("Error computing HMAC256SHA signature");
+                result = __FAILURE__;
+            }
+            else
+            {
+                result = 0;
+            }
+            hsm_hmac_key_clear(&hmac_key);
         }
-        BUFFER_delete(signed_payload_handle);
     }
+
     return result;
 }
 
+//##############################################################################
+// Sign API
+//##############################################################################
+
+int perform_sign_with_key
+(
+    const unsigned char* key,
+    size_t key_len,
+    const unsigned char* data_to_be_signed,
+    size_t data_to_be_signed_size,
+    unsigned char** digest,
+    size_t* digest_size
+)
+{
+    int result;
+    unsigned char *result_digest;
+
+    if ((result_digest = (unsigned char*)malloc(HSM_HMAC_DIGEST_SIZE)) == NULL)
+    {
+        LOG_ERROR("Error allocating memory for digest");
+        result =  __FAILURE__;
+    }
+    else if (compute_hmac(key, key_len, data_to_be_signed, data_to_be_signed_size, result_digest) != 0)
+    {
+        LOG_ERROR("Error computing HMAC256SHA digest");
+        free(result_digest);
+        result =  __FAILURE__;
+    }
+    else
+    {
+        *digest = result_digest;
+        *digest_size = HSM_HMAC_DIGEST_SIZE;
+        result = 0;
+    }
+    return result;
+}
+
+int perform_sign_with_key_into
+(
+    const unsigned char* key,
+    size_t key_len,
+    const unsigned char* data_to_be_signed,
+    size_t data_to_be_signed_size,
+    unsigned char* digest,
+    size_t* digest_size
+)
+{
+    int result;
+
+    if (digest_size == NULL)
+    {
+        LOG_ERROR("Invalid digest size");
+        result = __FAILURE__;
+    }
+    else if (digest == NULL)
+    {
+        *digest_size = HSM_HMAC_DIGEST_SIZE;
+        result = 0;
+    }
+    else if (*digest_size < HSM_HMAC_DIGEST_SIZE)
+    {
+        LOG_ERROR("Digest buffer of size %zu is too small", *digest_size);
+        *digest_size = HSM_HMAC_DIGEST_SIZE;
+        result = __FAILURE__;
+    }
+    else if (compute_hmac(key, key_len, data_to_be_signed, data_to_be_signed_size, digest) != 0)
+    {
+        LOG_ERROR("Error computing HMAC256SHA digest");
+        *digest_size = 0;
+        result = __FAILURE__;
+    }
+    else
+    {
+        *digest_size = HSM_HMAC_DIGEST_SIZE;
+        result = 0;
+    }
+    return result;
+}
+
+void perform_sign_with_key_deinit(void)
+{
+    hsm_hmac_openssl_deinit();
+}
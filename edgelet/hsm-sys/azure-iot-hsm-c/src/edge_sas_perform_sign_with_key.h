@@ -7,3 +7,13 @@ MOCKABLE_FUNCTION(,int, perform_sign_with_key, const unsigned char *, key, size_
                                   const unsigned char *, data_to_be_signed, size_t, data_to_be_signed_size, 
                                   unsigned char **, digest, size_t *, digest_size);
 
+
+// Signs into a caller supplied digest of *digest_size bytes. On return
+// *digest_size holds the digest size, which is all that is returned when
+// digest is NULL.
+MOCKABLE_FUNCTION(,int, perform_sign_with_key_into, const unsigned char *, key, size_t,  key_len,
+                                  const unsigned char *, data_to_be_signed, size_t, data_to_be_signed_size,
+                                  unsigned char *, digest, size_t *, digest_size);
+
+// Releases what the HMAC engine keeps across calls, see IOTEDGE_HSM_HMAC_ENGINE.
+MOCKABLE_FUNCTION(, void, perform_sign_with_key_deinit);
@@ -35,6 +35,13 @@ typedef int (*HSM_CLIENT_STORE_CREATE_PKI_CERT)
     CERT_PROPS_HANDLE cert_props_handle
 );
 
+typedef int (*HSM_CLIENT_STORE_CREATE_PKI_CERTS)
+(
+    HSM_CLIENT_STORE_HANDLE handle,
+    CERT_PROPS_HANDLE* cert_props_handles,
+    size_t count
+);
+
 typedef CERT_INFO_HANDLE (*HSM_CLIENT_STORE_GET_PKI_CERT)
 (
 	HSM_CLIENT_STORE_HANDLE handle,
@@ -76,6 +83,7 @@ struct HSM_CLIENT_STORE_INTERFACE_TAG {
     HSM_CLIENT_STORE_INSERT_SAS_KEY hsm_client_store_insert_sas_key;
     HSM_CLIENT_STORE_INSERT_ENCRYPTION_KEY hsm_client_store_insert_encryption_key;
     HSM_CLIENT_STORE_CREATE_PKI_CERT hsm_client_store_create_pki_cert;
+    HSM_CLIENT_STORE_CREATE_PKI_CERTS hsm_client_store_create_pki_certs;
     HSM_CLIENT_STORE_GET_PKI_CERT hsm_client_store_get_pki_cert;
     HSM_CLIENT_STORE_REMOVE_PKI_CERT hsm_client_store_remove_pki_cert;
     HSM_CLIENT_STORE_INSERT_PKI_TRUSTED_CERT hsm_client_store_insert_pki_trusted_cert;
@@ -6,10 +6,13 @@
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/sastoken.h"
 #include "azure_c_shared_utility/sha.h"
 #include "hsm_log.h"
+#include "hsm_lock.h"
+#include "hsm_sign_cache.h"
 #include "azure_c_shared_utility/crt_abstractions.h"
 
 #include "hsm_client_data.h"
@@ -23,8 +26,13 @@
 #define HMAC_LENGTH                 32
 #define TPM_DATA_LENGTH             1024
 
+// The password session is shared by every handle and the TPM command channel
+// does not support interleaved commands, so every TPM command is issued with
+// the HSM_GLOBAL_LOCK_TPM_DEVICE lock held. Data that is only read after
+// create (e.g. the EK and SRK public parts) may be accessed without the lock.
 static TPM2B_AUTH      NullAuth = { .t = {0,  {0}} };
 static TSS_SESSION     NullPwSession;
+static HSM_SIGN_CACHE_HANDLE g_sign_cache = NULL;
 static const UINT32 TPM_20_SRK_HANDLE = HR_PERSISTENT | 0x00000001;
 static const UINT32 TPM_20_EK_HANDLE = HR_PERSISTENT | 0x00010001;
 static const UINT32 DPS_ID_KEY_HANDLE = HR_PERSISTENT | 0x00000100;
@@ -299,8 +307,12 @@ static HSM_CLIENT_HANDLE hsm_client_tpm_create()
     }
     else
     {
+        int status;
         memset(result, 0, sizeof(HSM_CLIENT_INFO));
-        if (initialize_tpm_device(result) != 0)
+        hsm_global_lock(HSM_GLOBAL_LOCK_TPM_DEVICE);
+        status = initialize_tpm_device(result);
+        hsm_global_unlock(HSM_GLOBAL_LOCK_TPM_DEVICE);
+        if (status != 0)
         {
             LOG_ERROR("Failure initializing tpm device.");
             free(result);
@@ -316,7 +328,9 @@ static void hsm_client_tpm_destroy(HSM_CLIENT_HANDLE handle)
     {
         HSM_CLIENT_INFO* hsm_client_info = (HSM_CLIENT_INFO*)handle;
 
+        hsm_global_lock(HSM_GLOBAL_LOCK_TPM_DEVICE);
         Deinit_TPM_Codec(&hsm_client_info->tpm_device);
+        hsm_global_unlock(HSM_GLOBAL_LOCK_TPM_DEVICE);
         free(hsm_client_info);
     }
 }
@@ -336,7 +350,20 @@ static int hsm_client_tpm_activate_identity_key
     }
     else
     {
-        if (insert_key_in_tpm((HSM_CLIENT_INFO*)handle, key, key_len))
+        int status;
+        // signatures cached before or while the key is replaced are dropped
+        if (g_sign_cache != NULL)
+        {
+            hsm_sign_cache_clear(g_sign_cache);
+        }
+        hsm_global_lock(HSM_GLOBAL_LOCK_TPM_DEVICE);
+        status = insert_key_in_tpm((HSM_CLIENT_INFO*)handle, key, key_len);
+        hsm_global_unlock(HSM_GLOBAL_LOCK_TPM_DEVICE);
+        if (g_sign_cache != NULL)
+        {
+            hsm_sign_cache_clear(g_sign_cache);
+        }
+        if (status != 0)
         {
             LOG_ERROR("Failure inserting key into tpm");
             result = __FAILURE__;
@@ -444,68 +471,92 @@ static int hsm_client_tpm_get_storage_key
     return result;
 }
 
-static int hsm_client_tpm_sign_data
+static int hsm_client_tpm_sign_data_into
 (
     HSM_CLIENT_HANDLE handle,
     const unsigned char* data_to_be_signed,
     size_t data_to_be_signed_size,
-    unsigned char** digest,
+    unsigned char* digest,
     size_t* digest_size
 )
 {
     int result;
 
     if (handle == NULL || data_to_be_signed == NULL || data_to_be_signed_size == 0 ||
-                    digest == NULL || digest_size == NULL)
+                    digest_size == NULL)
     {
         LOG_ERROR("Invalid handle value specified handle: %p, data: %p, data_size: %zu, digest: %p, digest_size: %p",
             handle, data_to_be_signed, data_to_be_signed_size, digest, digest_size);
         result = __FAILURE__;
     }
+    else if ((digest == NULL) || (*digest_size < HMAC_LENGTH))
+    {
+        if (digest != NULL)
+        {
+            LOG_ERROR("Digest buffer of size %zu is too small", *digest_size);
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = 0;
+        }
+        *digest_size = HMAC_LENGTH;
+    }
+    else if ((g_sign_cache != NULL) &&
+             hsm_sign_cache_lookup(g_sign_cache, NULL, 0,
+                                   data_to_be_signed, data_to_be_signed_size,
+                                   digest, digest_size))
+    {
+        result = 0;
+    }
     else
     {
         BYTE data_signature[TPM_DATA_LENGTH];
         BYTE* data_copy = (unsigned char*)data_to_be_signed;
         HSM_CLIENT_INFO* hsm_client_info = (HSM_CLIENT_INFO*)handle;
+        uint64_t generation = (g_sign_cache != NULL) ? hsm_sign_cache_get_generation(g_sign_cache) : 0;
 
-        uint32_t sign_len = SignData(&hsm_client_info->tpm_device,
+        uint32_t sign_len;
+
+        hsm_global_lock(HSM_GLOBAL_LOCK_TPM_DEVICE);
+        sign_len = SignData(&hsm_client_info->tpm_device,
                         &NullPwSession, data_copy, (UINT32)data_to_be_signed_size,
                         data_signature, sizeof(data_signature) );
-        if (sign_len == 0)
+        hsm_global_unlock(HSM_GLOBAL_LOCK_TPM_DEVICE);
+        if ((sign_len == 0) || (sign_len > *digest_size))
         {
             LOG_ERROR("Failure signing data from hash");
+            *digest_size = 0;
             result = __FAILURE__;
         }
         else
         {
-            if ((*digest = (unsigned char*)malloc(sign_len)) == NULL)
+            memcpy(digest, data_signature, sign_len);
+            *digest_size = (size_t)sign_len;
+            if (g_sign_cache != NULL)
             {
-                LOG_ERROR("Failure creating buffer handle");
-                result = __FAILURE__;
-            }
-            else
-            {
-                memcpy(*digest, data_signature, sign_len);
-                *digest_size = (size_t)sign_len;
-                result = 0;
+                hsm_sign_cache_insert(g_sign_cache, generation, NULL, 0,
+                                      data_to_be_signed, data_to_be_signed_size,
+                                      digest, *digest_size);
             }
+            result = 0;
         }
     }
     return result;
 }
 
-static int hsm_client_tpm_derive_and_sign_with_identity
+static int hsm_client_tpm_derive_and_sign_with_identity_into
 (
    HSM_CLIENT_HANDLE handle,
    const unsigned char* data_to_be_signed,
    size_t data_to_be_signed_size,
    const unsigned char* identity,
    size_t identity_size,
-   unsigned char** digest,
+   unsigned char* digest,
    size_t* digest_size
 )
 {
-    int result =0;
+    int result;
     if (handle == NULL)
     {
         LOG_ERROR("Invalid NULL Handle");
@@ -531,47 +582,71 @@ static int hsm_client_tpm_derive_and_sign_with_identity
         LOG_ERROR("identity is empty");
         result = __FAILURE__;
     }
-    else if (digest==NULL)
-    {
-        LOG_ERROR("digest is NULL");
-        result = __FAILURE__;
-    }
     else if (digest_size == NULL)
     {
         LOG_ERROR("digest_size is NULL");
         result = __FAILURE__;
     }
+    else if ((digest == NULL) || (*digest_size < HMAC_LENGTH))
+    {
+        if (digest != NULL)
+        {
+            LOG_ERROR("Digest buffer of size %zu is too small", *digest_size);
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = 0;
+        }
+        *digest_size = HMAC_LENGTH;
+    }
+    else if ((g_sign_cache != NULL) &&
+             hsm_sign_cache_lookup(g_sign_cache, identity, identity_size,
+                                   data_to_be_signed, data_to_be_signed_size,
+                                   digest, digest_size))
+    {
+        result = 0;
+    }
     else
     {
-        *digest = NULL;
-        *digest_size = 0;
-
         BYTE data_signature[TPM_DATA_LENGTH];
         BYTE* data_copy = (unsigned char*)identity;
         HSM_CLIENT_INFO* hsm_client_info = (HSM_CLIENT_INFO*)handle;
+        uint64_t generation = (g_sign_cache != NULL) ? hsm_sign_cache_get_generation(g_sign_cache) : 0;
+
+        uint32_t sign_len;
 
-        uint32_t sign_len = SignData(&hsm_client_info->tpm_device,
+        hsm_global_lock(HSM_GLOBAL_LOCK_TPM_DEVICE);
+        sign_len = SignData(&hsm_client_info->tpm_device,
                         &NullPwSession, data_copy, (UINT32)identity_size,
                         data_signature, sizeof(data_signature) );
+        hsm_global_unlock(HSM_GLOBAL_LOCK_TPM_DEVICE);
         if (sign_len == 0)
         {
             LOG_ERROR("Failure signing derived key from hash");
+            *digest_size = 0;
             result = __FAILURE__;
         }
         else
         {
             // data_signature has the module key
             // - use software signing so we don't displace the key in TPM0
-            if( perform_sign_with_key(data_signature, sign_len,
-                                    data_to_be_signed, data_to_be_signed_size,
-                                    digest, digest_size) != 0)
+            if (perform_sign_with_key_into(data_signature, sign_len,
+                                           data_to_be_signed, data_to_be_signed_size,
+                                           digest, digest_size) != 0)
             {
                 LOG_ERROR("Failure signing data from derived key hash");
                 result = __FAILURE__;
             }
             else
             {
-                result =0;
+                if (g_sign_cache != NULL)
+                {
+                    hsm_sign_cache_insert(g_sign_cache, generation, identity, identity_size,
+                                          data_to_be_signed, data_to_be_signed_size,
+                                          digest, *digest_size);
+                }
+                result = 0;
             }
 
             memset(data_signature, 0, TPM_DATA_LENGTH);
@@ -580,6 +655,304 @@ static int hsm_client_tpm_derive_and_sign_with_identity
     return result;
 }
 
+// Copies a signature computed by one of the _into variants into a buffer
+// owned by the caller
+static int copy_signature
+(
+    const unsigned char* signature,
+    size_t signature_size,
+    unsigned char** digest,
+    size_t* digest_size
+)
+{
+    int result;
+
+    if ((*digest = (unsigned char*)malloc(signature_size)) == NULL)
+    {
+        LOG_ERROR("Failure creating buffer handle");
+        result = __FAILURE__;
+    }
+    else
+    {
+        memcpy(*digest, signature, signature_size);
+        *digest_size = signature_size;
+        result = 0;
+    }
+
+    return result;
+}
+
+static int hsm_client_tpm_sign_data
+(
+    HSM_CLIENT_HANDLE handle,
+    const unsigned char* data_to_be_signed,
+    size_t data_to_be_signed_size,
+    unsigned char** digest,
+    size_t* digest_size
+)
+{
+    int result;
+
+    if (digest_size == NULL)
+    {
+        LOG_ERROR("digest_size is NULL");
+        result = __FAILURE__;
+    }
+    else if (digest == NULL)
+    {
+        // size query
+        result = hsm_client_tpm_sign_data_into(handle, data_to_be_signed, data_to_be_signed_size,
+                                               NULL, digest_size);
+    }
+    else
+    {
+        BYTE signature[TPM_DATA_LENGTH];
+        size_t signature_size = sizeof(signature);
+
+        *digest = NULL;
+        if ((hsm_client_tpm_sign_data_into(handle, data_to_be_signed, data_to_be_signed_size,
+                                           signature, &signature_size) != 0) ||
+            (copy_signature(signature, signature_size, digest, digest_size) != 0))
+        {
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = 0;
+        }
+    }
+    return result;
+}
+
+static int hsm_client_tpm_derive_and_sign_with_identity
+(
+   HSM_CLIENT_HANDLE handle,
+   const unsigned char* data_to_be_signed,
+   size_t data_to_be_signed_size,
+   const unsigned char* identity,
+   size_t identity_size,
+   unsigned char** digest,
+   size_t* digest_size
+)
+{
+    int result;
+
+    if (digest_size == NULL)
+    {
+        LOG_ERROR("digest_size is NULL");
+        result = __FAILURE__;
+    }
+    else if (digest == NULL)
+    {
+        // size query
+        result = hsm_client_tpm_derive_and_sign_with_identity_into(handle, data_to_be_signed,
+                                                                   data_to_be_signed_size,
+                                                                   identity, identity_size,
+                                                                   NULL, digest_size);
+    }
+    else
+    {
+        BYTE signature[TPM_DATA_LENGTH];
+        size_t signature_size = sizeof(signature);
+
+        *digest = NULL;
+        if ((hsm_client_tpm_derive_and_sign_with_identity_into(handle, data_to_be_signed,
+                                                               data_to_be_signed_size,
+                                                               identity, identity_size,
+                                                               signature, &signature_size) != 0) ||
+            (copy_signature(signature, signature_size, digest, digest_size) != 0))
+        {
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = 0;
+        }
+    }
+    return result;
+}
+
+static int validate_sign_batch
+(
+    HSM_CLIENT_HANDLE handle,
+    const HSM_SIGN_REQUEST* requests,
+    size_t count,
+    bool do_derive
+)
+{
+    int result;
+
+    if (handle == NULL)
+    {
+        LOG_ERROR("Invalid NULL Handle");
+        result = __FAILURE__;
+    }
+    else if ((requests == NULL) || (count == 0) || (count > (SIZE_MAX / HMAC_LENGTH)))
+    {
+        LOG_ERROR("Invalid sign requests");
+        result = __FAILURE__;
+    }
+    else
+    {
+        size_t index;
+
+        result = 0;
+        for (index = 0; (index < count) && (result == 0); index++)
+        {
+            if ((requests[index].data == NULL) || (requests[index].data_size == 0))
+            {
+                LOG_ERROR("no data to be signed in request %zu", index);
+                result = __FAILURE__;
+            }
+            else if (do_derive &&
+                     ((requests[index].identity == NULL) || (requests[index].identity_size == 0)))
+            {
+                LOG_ERROR("identity is empty in request %zu", index);
+                result = __FAILURE__;
+            }
+        }
+    }
+
+    return result;
+}
+
+// Every command of the batch is issued back to back with the device lock
+// held once, so the batch runs in the shared password session without
+// interleaving with other callers.
+static int sign_batch_locked
+(
+    HSM_CLIENT_INFO* hsm_client_info,
+    const HSM_SIGN_REQUEST* requests,
+    size_t count,
+    bool do_derive,
+    unsigned char* batch
+)
+{
+    int result = 0;
+    size_t index;
+    BYTE data_signature[TPM_DATA_LENGTH];
+
+    for (index = 0; (index < count) && (result == 0); index++)
+    {
+        const HSM_SIGN_REQUEST *request = &requests[index];
+        unsigned char *digest = batch + (index * HMAC_LENGTH);
+        BYTE* data_copy = (unsigned char*)(do_derive ? request->identity : request->data);
+        size_t data_copy_size = do_derive ? request->identity_size : request->data_size;
+        uint32_t sign_len;
+
+        sign_len = SignData(&hsm_client_info->tpm_device,
+                        &NullPwSession, data_copy, (UINT32)data_copy_size,
+                        data_signature, sizeof(data_signature) );
+        if (sign_len == 0)
+        {
+            LOG_ERROR("Failure signing batch request %zu", index);
+            result = __FAILURE__;
+        }
+        else if (do_derive)
+        {
+            // data_signature has the module key
+            // - use software signing so we don't displace the key in TPM0
+            size_t digest_size = HMAC_LENGTH;
+            if ((perform_sign_with_key_into(data_signature, sign_len,
+                                            request->data, request->data_size,
+                                            digest, &digest_size) != 0) ||
+                (digest_size != HMAC_LENGTH))
+            {
+                LOG_ERROR("Failure signing data from derived key hash in batch request %zu", index);
+                result = __FAILURE__;
+            }
+        }
+        else if (sign_len != HMAC_LENGTH)
+        {
+            LOG_ERROR("Unexpected signature length %u in batch request %zu", (unsigned int)sign_len, index);
+            result = __FAILURE__;
+        }
+        else
+        {
+            memcpy(digest, data_signature, HMAC_LENGTH);
+        }
+    }
+    memset(data_signature, 0, TPM_DATA_LENGTH);
+
+    return result;
+}
+
+static int perform_sign_batch
+(
+    HSM_CLIENT_HANDLE handle,
+    const HSM_SIGN_REQUEST* requests,
+    size_t count,
+    unsigned char** digests,
+    size_t* digest_size,
+    bool do_derive
+)
+{
+    int result;
+
+    if ((digests == NULL) || (digest_size == NULL))
+    {
+        LOG_ERROR("Invalid digests specified digests: %p, digest_size: %p", digests, digest_size);
+        result = __FAILURE__;
+    }
+    else
+    {
+        unsigned char *batch;
+
+        *digests = NULL;
+        *digest_size = 0;
+        if (validate_sign_batch(handle, requests, count, do_derive) != 0)
+        {
+            result = __FAILURE__;
+        }
+        else if ((batch = (unsigned char*)malloc(count * HMAC_LENGTH)) == NULL)
+        {
+            LOG_ERROR("Failure creating buffer handle");
+            result = __FAILURE__;
+        }
+        else
+        {
+            hsm_global_lock(HSM_GLOBAL_LOCK_TPM_DEVICE);
+            result = sign_batch_locked((HSM_CLIENT_INFO*)handle, requests, count, do_derive, batch);
+            hsm_global_unlock(HSM_GLOBAL_LOCK_TPM_DEVICE);
+            if (result != 0)
+            {
+                free(batch);
+            }
+            else
+            {
+                *digests = batch;
+                *digest_size = HMAC_LENGTH;
+            }
+        }
+    }
+
+    return result;
+}
+
+static int hsm_client_tpm_sign_batch
+(
+    HSM_CLIENT_HANDLE handle,
+    const HSM_SIGN_REQUEST* requests,
+    size_t count,
+    unsigned char** digests,
+    size_t* digest_size
+)
+{
+    return perform_sign_batch(handle, requests, count, digests, digest_size, false);
+}
+
+static int hsm_client_tpm_derive_and_sign_batch
+(
+    HSM_CLIENT_HANDLE handle,
+    const HSM_SIGN_REQUEST* requests,
+    size_t count,
+    unsigned char** digests,
+    size_t* digest_size
+)
+{
+    return perform_sign_batch(handle, requests, count, digests, digest_size, true);
+}
+
 static void hsm_client_tpm_free_buffer(void* buffer)
 {
     if (buffer != NULL)
@@ -590,11 +963,22 @@ static void hsm_client_tpm_free_buffer(void* buffer)
 
 int hsm_client_tpm_device_init(void)
 {
+    // the cache is optional, signing works the same without it
+    if (g_sign_cache == NULL)
+    {
+        g_sign_cache = hsm_sign_cache_create_from_env();
+    }
     return 0;
 }
 
 void hsm_client_tpm_device_deinit(void)
 {
+    if (g_sign_cache != NULL)
+    {
+        hsm_sign_cache_destroy(g_sign_cache);
+    }
+    g_sign_cache = NULL;
+    perform_sign_with_key_deinit();
 }
 
 static const HSM_CLIENT_TPM_INTERFACE tpm_interface =
@@ -606,7 +990,11 @@ static const HSM_CLIENT_TPM_INTERFACE tpm_interface =
     hsm_client_tpm_get_storage_key,
     hsm_client_tpm_sign_data,
     hsm_client_tpm_derive_and_sign_with_identity,
-    hsm_client_tpm_free_buffer
+    hsm_client_tpm_free_buffer,
+    hsm_client_tpm_sign_data_into,
+    hsm_client_tpm_derive_and_sign_with_identity_into,
+    hsm_client_tpm_sign_batch,
+    hsm_client_tpm_derive_and_sign_batch
 };
 
 const HSM_CLIENT_TPM_INTERFACE* hsm_client_tpm_device_interface(void)
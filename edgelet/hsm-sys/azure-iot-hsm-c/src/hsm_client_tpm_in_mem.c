@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "azure_c_shared_utility/gballoc.h"
 #include "hsm_client_data.h"
@@ -10,6 +11,9 @@
 #include "hsm_log.h"
 #include "hsm_constants.h"
 
+// identity signatures are HMAC-SHA256 digests, larger ones still fit
+#define MAX_IDENTITY_SIGNATURE_SIZE 64
+
 struct EDGE_TPM_TAG
 {
     HSM_CLIENT_STORE_HANDLE hsm_store_handle;
@@ -239,74 +243,395 @@ static int edge_hsm_client_get_srk
     return ek_srk_unsupported(handle, key, key_len);
 }
 
-static int perform_sign
+static int validate_sign_parameters
 (
     HSM_CLIENT_HANDLE handle,
     const unsigned char* data_to_be_signed,
     size_t data_to_be_signed_size,
     const unsigned char* identity,
     size_t identity_size,
-    unsigned char** digest,
-    size_t* digest_size,
     int do_derive
 )
 {
-    int result = 0;
-    if (digest == NULL)
+    int result;
+
+    if (!g_is_tpm_initialized)
+    {
+        LOG_ERROR("hsm_client_tpm_init not called");
+        result = __FAILURE__;
+    }
+    else if (handle == NULL)
+    {
+        LOG_ERROR("Invalid handle value specified");
+        result = __FAILURE__;
+    }
+    else if (data_to_be_signed == NULL)
     {
-        LOG_ERROR("Invalid digest specified");
+        LOG_ERROR("Invalid data to be signed specified");
+        result = __FAILURE__;
+    }
+    else if (data_to_be_signed_size == 0)
+    {
+        LOG_ERROR("Invalid data to be signed length specified");
+        result = __FAILURE__;
+    }
+    else if ((identity == NULL) && do_derive)
+    {
+        LOG_ERROR("Invalid identity specified");
+        result = __FAILURE__;
+    }
+    else if ((identity_size == 0) && do_derive)
+    {
+        LOG_ERROR("Invalid identity length specified");
         result = __FAILURE__;
     }
     else
     {
-        *digest = NULL;
+        result = 0;
     }
+
+    return result;
+}
+
+static int perform_sign_into
+(
+    HSM_CLIENT_HANDLE handle,
+    const unsigned char* data_to_be_signed,
+    size_t data_to_be_signed_size,
+    const unsigned char* identity,
+    size_t identity_size,
+    unsigned char* digest,
+    size_t* digest_size,
+    int do_derive
+)
+{
+    int result;
+
+    // digest may be NULL in which case only the digest size is returned
     if (digest_size == NULL)
     {
         LOG_ERROR("Invalid digest size specified");
         result = __FAILURE__;
     }
-    else
+    else if (validate_sign_parameters(handle, data_to_be_signed, data_to_be_signed_size,
+                                      identity, identity_size, do_derive) != 0)
     {
         *digest_size = 0;
+        result = __FAILURE__;
     }
-    if (result == 0)
+    else
     {
-        if (!g_is_tpm_initialized)
+        KEY_HANDLE key_handle;
+        const HSM_CLIENT_STORE_INTERFACE *store_if = g_hsm_store_if;
+        const HSM_CLIENT_KEY_INTERFACE *key_if = g_hsm_key_if;
+        EDGE_TPM* edge_tpm = (EDGE_TPM*)handle;
+        key_handle = store_if->hsm_client_store_open_key(edge_tpm->hsm_store_handle,
+                                                         HSM_KEY_SAS,
+                                                         EDGELET_IDENTITY_SAS_KEY_NAME);
+        if (key_handle == NULL)
         {
-            LOG_ERROR("hsm_client_tpm_init not called");
+            LOG_ERROR("Could not get SAS key by name '%s'", EDGELET_IDENTITY_SAS_KEY_NAME);
+            *digest_size = 0;
             result = __FAILURE__;
         }
-        else if (handle == NULL)
+        else
         {
-            LOG_ERROR("Invalid handle value specified");
-            result = __FAILURE__;
+            int status;
+            if (identity != NULL)
+            {
+                status = key_if->hsm_client_key_derive_and_sign_into(key_handle,
+                                                                     data_to_be_signed,
+                                                                     data_to_be_signed_size,
+                                                                     identity,
+                                                                     identity_size,
+                                                                     digest,
+                                                                     digest_size);
+            }
+            else
+            {
+                status = key_if->hsm_client_key_sign_into(key_handle,
+                                                          data_to_be_signed,
+                                                          data_to_be_signed_size,
+                                                          digest,
+                                                          digest_size);
+            }
+
+            if (status != 0)
+            {
+                LOG_ERROR("Error computing signature using identity key. Error code %d", status);
+                result = __FAILURE__;
+            }
+            else
+            {
+                result = 0;
+            }
+            // always close the key handle
+            status = store_if->hsm_client_store_close_key(edge_tpm->hsm_store_handle, key_handle);
+            if (status != 0)
+            {
+                LOG_ERROR("Error closing key handle. Error code %d", status);
+                result = __FAILURE__;
+            }
         }
-        else if (data_to_be_signed == NULL)
+    }
+
+    return result;
+}
+
+static int perform_sign
+(
+    HSM_CLIENT_HANDLE handle,
+    const unsigned char* data_to_be_signed,
+    size_t data_to_be_signed_size,
+    const unsigned char* identity,
+    size_t identity_size,
+    unsigned char** digest,
+    size_t* digest_size,
+    int do_derive
+)
+{
+    int result;
+
+    if (digest_size == NULL)
+    {
+        LOG_ERROR("Invalid digest size specified");
+        if (digest != NULL)
+        {
+            *digest = NULL;
+        }
+        result = __FAILURE__;
+    }
+    else if (digest == NULL)
+    {
+        // size query
+        result = perform_sign_into(handle, data_to_be_signed, data_to_be_signed_size,
+                                   identity, identity_size, NULL, digest_size, do_derive);
+    }
+    else
+    {
+        unsigned char signature[MAX_IDENTITY_SIGNATURE_SIZE];
+        size_t signature_size = sizeof(signature);
+
+        *digest = NULL;
+        *digest_size = 0;
+        if (perform_sign_into(handle, data_to_be_signed, data_to_be_signed_size,
+                              identity, identity_size, signature, &signature_size, do_derive) != 0)
         {
-            LOG_ERROR("Invalid data to be signed specified");
             result = __FAILURE__;
         }
-        else if (data_to_be_signed_size == 0)
+        else if ((*digest = (unsigned char*)malloc(signature_size)) == NULL)
         {
-            LOG_ERROR("Invalid data to be signed length specified");
+            LOG_ERROR("Could not allocate memory for digest");
             result = __FAILURE__;
         }
-        else if ((identity == NULL) && do_derive)
+        else
+        {
+            memcpy(*digest, signature, signature_size);
+            *digest_size = signature_size;
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+static int edge_hsm_client_sign_with_identity
+(
+    HSM_CLIENT_HANDLE handle,
+    const unsigned char* data_to_be_signed,
+    size_t data_to_be_signed_size,
+    unsigned char** digest,
+    size_t* digest_size
+)
+{
+    return perform_sign(handle, data_to_be_signed, data_to_be_signed_size,
+                        NULL, 0, digest, digest_size, 0);
+}
+
+static int edge_hsm_client_derive_and_sign_with_identity
+(
+    HSM_CLIENT_HANDLE handle,
+    const unsigned char* data_to_be_signed,
+    size_t data_to_be_signed_size,
+    const unsigned char* identity,
+    size_t identity_size,
+    unsigned char** digest,
+    size_t* digest_size
+)
+{
+    return perform_sign(handle, data_to_be_signed, data_to_be_signed_size,
+                        identity, identity_size, digest, digest_size, 1);
+}
+
+static int edge_hsm_client_sign_with_identity_into
+(
+    HSM_CLIENT_HANDLE handle,
+    const unsigned char* data_to_be_signed,
+    size_t data_to_be_signed_size,
+    unsigned char* digest,
+    size_t* digest_size
+)
+{
+    return perform_sign_into(handle, data_to_be_signed, data_to_be_signed_size,
+                             NULL, 0, digest, digest_size, 0);
+}
+
+static int edge_hsm_client_derive_and_sign_with_identity_into
+(
+    HSM_CLIENT_HANDLE handle,
+    const unsigned char* data_to_be_signed,
+    size_t data_to_be_signed_size,
+    const unsigned char* identity,
+    size_t identity_size,
+    unsigned char* digest,
+    size_t* digest_size
+)
+{
+    return perform_sign_into(handle, data_to_be_signed, data_to_be_signed_size,
+                             identity, identity_size, digest, digest_size, 1);
+}
+
+static int sign_requests_into
+(
+    KEY_HANDLE key_handle,
+    const HSM_SIGN_REQUEST *requests,
+    size_t count,
+    unsigned char* digests,
+    size_t* digest_size,
+    int do_derive
+)
+{
+    const HSM_CLIENT_KEY_INTERFACE *key_if = g_hsm_key_if;
+    int result;
+
+    if (do_derive)
+    {
+        result = key_if->hsm_client_key_derive_and_sign_batch(key_handle,
+                                                              requests,
+                                                              count,
+                                                              digests,
+                                                              digest_size);
+    }
+    else
+    {
+        result = key_if->hsm_client_key_sign_batch(key_handle,
+                                                   requests,
+                                                   count,
+                                                   digests,
+                                                   digest_size);
+    }
+
+    return result;
+}
+
+// Signs every request into one buffer with the key opened once, the key signs
+// the whole batch so it can hash the requests side by side
+static int sign_batch_with_key
+(
+    KEY_HANDLE key_handle,
+    const HSM_SIGN_REQUEST* requests,
+    size_t count,
+    unsigned char** digests,
+    size_t* digest_size,
+    int do_derive
+)
+{
+    int result;
+    size_t size = 0;
+    unsigned char *batch;
+
+    if (sign_requests_into(key_handle, requests, count, NULL, &size, do_derive) != 0)
+    {
+        LOG_ERROR("Could not determine the digest size");
+        result = __FAILURE__;
+    }
+    else if ((size == 0) || (count > (SIZE_MAX / size)))
+    {
+        LOG_ERROR("Invalid digest size %zu for a batch of %zu", size, count);
+        result = __FAILURE__;
+    }
+    else if ((batch = (unsigned char*)malloc(count * size)) == NULL)
+    {
+        LOG_ERROR("Could not allocate memory for %zu digests", count);
+        result = __FAILURE__;
+    }
+    else
+    {
+        size_t written = count * size;
+        int status = sign_requests_into(key_handle, requests, count, batch, &written, do_derive);
+
+        if ((status != 0) || (written != size))
         {
-            LOG_ERROR("Invalid identity specified");
+            LOG_ERROR("Error computing signatures of batch. Error code %d", status);
+            free(batch);
             result = __FAILURE__;
         }
-        else if ((identity_size == 0) && do_derive)
+        else
+        {
+            *digests = batch;
+            *digest_size = size;
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+static int perform_sign_batch
+(
+    HSM_CLIENT_HANDLE handle,
+    const HSM_SIGN_REQUEST* requests,
+    size_t count,
+    unsigned char** digests,
+    size_t* digest_size,
+    int do_derive
+)
+{
+    int result = 0;
+    if (digests == NULL)
+    {
+        LOG_ERROR("Invalid digests specified");
+        result = __FAILURE__;
+    }
+    else
+    {
+        *digests = NULL;
+    }
+    if (digest_size == NULL)
+    {
+        LOG_ERROR("Invalid digest size specified");
+        result = __FAILURE__;
+    }
+    else
+    {
+        *digest_size = 0;
+    }
+    if (result == 0)
+    {
+        if ((requests == NULL) || (count == 0))
         {
-            LOG_ERROR("Invalid identity length specified");
+            LOG_ERROR("Invalid sign requests specified");
             result = __FAILURE__;
         }
         else
+        {
+            size_t index;
+            for (index = 0; (index < count) && (result == 0); index++)
+            {
+                if (validate_sign_parameters(handle, requests[index].data, requests[index].data_size,
+                                             requests[index].identity, requests[index].identity_size,
+                                             do_derive) != 0)
+                {
+                    LOG_ERROR("Invalid sign request at %zu", index);
+                    result = __FAILURE__;
+                }
+            }
+        }
+
+        if (result == 0)
         {
             KEY_HANDLE key_handle;
             const HSM_CLIENT_STORE_INTERFACE *store_if = g_hsm_store_if;
-            const HSM_CLIENT_KEY_INTERFACE *key_if = g_hsm_key_if;
             EDGE_TPM* edge_tpm = (EDGE_TPM*)handle;
             key_handle = store_if->hsm_client_store_open_key(edge_tpm->hsm_store_handle,
                                                              HSM_KEY_SAS,
@@ -319,39 +644,18 @@ static int perform_sign
             else
             {
                 int status;
-                if (identity != NULL)
-                {
-                    status = key_if->hsm_client_key_derive_and_sign(key_handle,
-                                                                    data_to_be_signed,
-                                                                    data_to_be_signed_size,
-                                                                    identity,
-                                                                    identity_size,
-                                                                    digest,
-                                                                    digest_size);
-                }
-                else
-                {
-                    status = key_if->hsm_client_key_sign(key_handle,
-                                                        data_to_be_signed,
-                                                        data_to_be_signed_size,
-                                                        digest,
-                                                        digest_size);
-                }
-
-                if (status != 0)
-                {
-                    LOG_ERROR("Error computing signature using identity key. Error code %d", status);
-                    result = __FAILURE__;
-                }
-                else
-                {
-                    result = 0;
-                }
+                result = sign_batch_with_key(key_handle, requests, count, digests, digest_size, do_derive);
                 // always close the key handle
                 status = store_if->hsm_client_store_close_key(edge_tpm->hsm_store_handle, key_handle);
                 if (status != 0)
                 {
                     LOG_ERROR("Error closing key handle. Error code %d", status);
+                    if (result == 0)
+                    {
+                        free(*digests);
+                        *digests = NULL;
+                        *digest_size = 0;
+                    }
                     result = __FAILURE__;
                 }
             }
@@ -360,32 +664,28 @@ static int perform_sign
     return result;
 }
 
-static int edge_hsm_client_sign_with_identity
+static int edge_hsm_client_sign_batch
 (
     HSM_CLIENT_HANDLE handle,
-    const unsigned char* data_to_be_signed,
-    size_t data_to_be_signed_size,
-    unsigned char** digest,
+    const HSM_SIGN_REQUEST* requests,
+    size_t count,
+    unsigned char** digests,
     size_t* digest_size
 )
 {
-    return perform_sign(handle, data_to_be_signed, data_to_be_signed_size,
-                        NULL, 0, digest, digest_size, 0);
+    return perform_sign_batch(handle, requests, count, digests, digest_size, 0);
 }
 
-static int edge_hsm_client_derive_and_sign_with_identity
+static int edge_hsm_client_derive_and_sign_batch
 (
     HSM_CLIENT_HANDLE handle,
-    const unsigned char* data_to_be_signed,
-    size_t data_to_be_signed_size,
-    const unsigned char* identity,
-    size_t identity_size,
-    unsigned char** digest,
+    const HSM_SIGN_REQUEST* requests,
+    size_t count,
+    unsigned char** digests,
     size_t* digest_size
 )
 {
-    return perform_sign(handle, data_to_be_signed, data_to_be_signed_size,
-                        identity, identity_size, digest, digest_size, 1);
+    return perform_sign_batch(handle, requests, count, digests, digest_size, 1);
 }
 
 static void edge_hsm_free_buffer(void *buffer)
@@ -405,7 +705,11 @@ static const HSM_CLIENT_TPM_INTERFACE edge_tpm_interface =
     edge_hsm_client_get_srk,
     edge_hsm_client_sign_with_identity,
     edge_hsm_client_derive_and_sign_with_identity,
-    edge_hsm_free_buffer
+    edge_hsm_free_buffer,
+    edge_hsm_client_sign_with_identity_into,
+    edge_hsm_client_derive_and_sign_with_identity_into,
+    edge_hsm_client_sign_batch,
+    edge_hsm_client_derive_and_sign_batch
 };
 
 const HSM_CLIENT_TPM_INTERFACE* hsm_client_tpm_store_interface()
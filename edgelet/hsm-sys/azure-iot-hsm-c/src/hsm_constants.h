@@ -8,6 +8,13 @@ extern const char* const ENV_EDGE_HOME_DIR;
 extern const char* const ENV_DEVICE_CA_PATH;
 extern const char* const ENV_DEVICE_PK_PATH;
 extern const char* const ENV_TRUSTED_CA_CERTS_PATH;
+extern const char* const ENV_HSM_PACKED_STORE;
+extern const char* const ENV_HSM_KEY_POOL_SIZE;
+extern const char* const ENV_HSM_CERT_RENEWAL_PERCENT;
+extern const char* const ENV_HSM_CERT_REUSE_PERCENT;
+extern const char* const ENV_HSM_HMAC_ENGINE;
+extern const char* const ENV_HSM_SIGN_CACHE_SIZE;
+extern const char* const ENV_HSM_SIGN_CACHE_TTL;
 
 /* HSM directory name under IOTEDGE_HOMEDIR */
 extern const char* const DEFAULT_EDGE_HOME_DIR_UNIX;
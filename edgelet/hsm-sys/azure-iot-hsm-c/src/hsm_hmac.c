@@ -0,0 +1,171 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "azure_c_shared_utility/gballoc.h"
+#include "hsm_hmac.h"
+#include "hsm_log.h"
+#include "hsm_utils.h"
+
+#define HMAC_IPAD 0x36
+#define HMAC_OPAD 0x5c
+
+//##############################################################################
+// Helpers
+//##############################################################################
+static void hash_pad
+(
+    HSM_SHA256_STATE *state,
+    const unsigned char *key_block,
+    unsigned char pad_byte
+)
+{
+    unsigned char pad[HSM_SHA256_BLOCK_SIZE];
+    size_t index;
+
+    for (index = 0; index < HSM_SHA256_BLOCK_SIZE; index++)
+    {
+        pad[index] = key_block[index] ^ pad_byte;
+    }
+
+    hsm_sha256_init_state(state);
+    hsm_sha256_compress(state, pad, 1);
+    secure_zero(pad, sizeof(pad));
+}
+
+// Both halves of an HMAC continue from a state that has absorbed one pad
+// block. The inner hashes of a batch are finished together, then the outer
+// hashes over the inner digests.
+static void sign_requests(const HSM_HMAC_REQUEST *requests, size_t count)
+{
+    HSM_SHA256_MESSAGE messages[HSM_SHA256_LANES];
+    unsigned char inner_digests[HSM_SHA256_LANES][HSM_HMAC_DIGEST_SIZE];
+    size_t index;
+
+    for (index = 0; index < count; index++)
+    {
+        messages[index].state = &requests[index].key->inner;
+        messages[index].prefix_size = HSM_SHA256_BLOCK_SIZE;
+        messages[index].data = requests[index].data;
+        messages[index].data_size = requests[index].data_size;
+        messages[index].digest = inner_digests[index];
+    }
+    hsm_sha256_finish(messages, count);
+
+    for (index = 0; index < count; index++)
+    {
+        messages[index].state = &requests[index].key->outer;
+        messages[index].data = inner_digests[index];
+        messages[index].data_size = HSM_HMAC_DIGEST_SIZE;
+        messages[index].digest = requests[index].digest;
+    }
+    hsm_sha256_finish(messages, count);
+    secure_zero(inner_digests, sizeof(inner_digests));
+}
+
+//##############################################################################
+// HMAC API
+//##############################################################################
+int hsm_hmac_key_init(HSM_HMAC_KEY *hmac_key, const unsigned char *key, size_t key_size)
+{
+    int result;
+    unsigned char key_block[HSM_SHA256_BLOCK_SIZE];
+
+    memset(key_block, 0, sizeof(key_block));
+    if ((hmac_key == NULL) || (key == NULL) || (key_size == 0))
+    {
+        LOG_ERROR("Invalid HMAC key parameters");
+        result = __FAILURE__;
+    }
+    else
+    {
+        if (key_size > HSM_SHA256_BLOCK_SIZE)
+        {
+            // keys longer than the block size are replaced by their digest
+            hsm_sha256_digest(key, key_size, key_block);
+        }
+        else
+        {
+            memcpy(key_block, key, key_size);
+        }
+        hash_pad(&hmac_key->inner, key_block, HMAC_IPAD);
+        hash_pad(&hmac_key->outer, key_block, HMAC_OPAD);
+        result = 0;
+    }
+    secure_zero(key_block, sizeof(key_block));
+
+    return result;
+}
+
+void hsm_hmac_key_clear(HSM_HMAC_KEY *hmac_key)
+{
+    if (hmac_key != NULL)
+    {
+        secure_zero(hmac_key, sizeof(HSM_HMAC_KEY));
+    }
+}
+
+int hsm_hmac_sign
+(
+    const HSM_HMAC_KEY *hmac_key,
+    const unsigned char *data,
+    size_t data_size,
+    unsigned char digest[HSM_HMAC_DIGEST_SIZE]
+)
+{
+    int result;
+
+    if ((hmac_key == NULL) || (data == NULL) || (digest == NULL))
+    {
+        LOG_ERROR("Invalid HMAC sign parameters");
+        result = __FAILURE__;
+    }
+    else
+    {
+        HSM_HMAC_REQUEST request;
+
+        // continue from the precomputed pad states rather than rehashing the key
+        request.key = hmac_key;
+        request.data = data;
+        request.data_size = data_size;
+        request.digest = digest;
+        sign_requests(&request, 1);
+        result = 0;
+    }
+
+    return result;
+}
+
+int hsm_hmac_sign_batch(const HSM_HMAC_REQUEST *requests, size_t count)
+{
+    int result;
+    size_t index;
+
+    if ((requests == NULL) || (count == 0))
+    {
+        LOG_ERROR("Invalid HMAC batch parameters");
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = 0;
+        for (index = 0; index < count; index++)
+        {
+            if ((requests[index].key == NULL) ||
+                (requests[index].data == NULL) ||
+                (requests[index].digest == NULL))
+            {
+                LOG_ERROR("Invalid HMAC batch request %zu", index);
+                result = __FAILURE__;
+                break;
+            }
+        }
+
+        for (index = 0; (result == 0) && (index < count); index += HSM_SHA256_LANES)
+        {
+            size_t remaining = count - index;
+            sign_requests(&requests[index], (remaining > HSM_SHA256_LANES) ? HSM_SHA256_LANES : remaining);
+        }
+    }
+
+    return result;
+}
@@ -0,0 +1,85 @@
+#ifndef HSM_HMAC_H
+#define HSM_HMAC_H
+
+#ifdef __cplusplus
+#include <cstddef>
+extern "C" {
+#else
+#include <stddef.h>
+#endif
+
+#include "hsm_sha256.h"
+
+#define HSM_HMAC_DIGEST_SIZE HSM_SHA256_DIGEST_SIZE
+
+/**
+ * HMAC-SHA256 key with the inner and outer hash states precomputed.
+ *
+ * Both key pads are hashed once by hsm_hmac_key_init, after which each
+ * signature only hashes the message and the inner digest. A key is not
+ * modified by hsm_hmac_sign and may be shared by concurrent calls.
+ */
+typedef struct HSM_HMAC_KEY_TAG
+{
+    HSM_SHA256_STATE inner;
+    HSM_SHA256_STATE outer;
+} HSM_HMAC_KEY;
+
+/**
+ * One signature of a batch. digest must hold HSM_HMAC_DIGEST_SIZE bytes.
+ */
+typedef struct HSM_HMAC_REQUEST_TAG
+{
+    const HSM_HMAC_KEY *key;
+    const unsigned char *data;
+    size_t data_size;
+    unsigned char *digest;
+} HSM_HMAC_REQUEST;
+
+extern int hsm_hmac_key_init(HSM_HMAC_KEY *hmac_key, const unsigned char *key, size_t key_size);
+
+/**
+ * Zeroizes the precomputed states, which are equivalent to the key.
+ */
+extern void hsm_hmac_key_clear(HSM_HMAC_KEY *hmac_key);
+
+extern int hsm_hmac_sign
+(
+    const HSM_HMAC_KEY *hmac_key,
+    const unsigned char *data,
+    size_t data_size,
+    unsigned char digest[HSM_HMAC_DIGEST_SIZE]
+);
+
+/**
+ * Signs every request, hashing the messages side by side when the CPU has a
+ * multi-buffer SHA-256 kernel. The requests may use different keys.
+ */
+extern int hsm_hmac_sign_batch(const HSM_HMAC_REQUEST *requests, size_t count);
+
+/**
+ * Computes HMAC-SHA256 with OpenSSL. Each calling thread keeps one OpenSSL
+ * context, released when the thread exits, that is rekeyed on every call, so
+ * unlike hsm_hmac_sign the pad blocks are hashed again for each signature.
+ */
+extern int hsm_hmac_openssl_sign
+(
+    const unsigned char *key,
+    size_t key_size,
+    const unsigned char *data,
+    size_t data_size,
+    unsigned char digest[HSM_HMAC_DIGEST_SIZE]
+);
+
+/**
+ * Releases the per thread context slot of hsm_hmac_openssl_sign along with
+ * the context of the calling thread. Called when no other thread signs, a
+ * later call to hsm_hmac_openssl_sign allocates the slot again.
+ */
+extern void hsm_hmac_openssl_deinit(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  //HSM_HMAC_H
@@ -0,0 +1,366 @@
+#include <limits.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include <openssl/opensslv.h>
+
+#include "azure_c_shared_utility/gballoc.h"
+#include "hsm_hmac.h"
+#include "hsm_lock.h"
+#include "hsm_log.h"
+
+// OpenSSL 3.0 deprecates the HMAC_CTX API in favour of the EVP_MAC one,
+// 1.0.x has no allocator for HMAC_CTX so the context is embedded in our own
+// allocation
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    #include <openssl/core_names.h>
+    #include <openssl/evp.h>
+    #include <openssl/params.h>
+
+    typedef EVP_MAC_CTX THREAD_HMAC_CTX;
+#else
+    #include <openssl/evp.h>
+    #include <openssl/hmac.h>
+
+    typedef HMAC_CTX THREAD_HMAC_CTX;
+#endif
+
+#if defined __WINDOWS__ || defined _WIN32 || defined _WIN64 || defined _Windows
+    #include <windows.h>
+
+    static DWORD g_ctx_slot = FLS_OUT_OF_INDEXES;
+#else
+    #include <pthread.h>
+
+    static pthread_key_t g_ctx_slot;
+#endif
+// set while g_ctx_slot is allocated, changes with HSM_GLOBAL_LOCK_HMAC held
+static volatile long g_ctx_slot_created = 0;
+
+//##############################################################################
+// OpenSSL HMAC context
+//##############################################################################
+static THREAD_HMAC_CTX* create_hmac_ctx(void)
+{
+    THREAD_HMAC_CTX *result;
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    EVP_MAC *mac;
+
+    if ((mac = EVP_MAC_fetch(NULL, OSSL_MAC_NAME_HMAC, NULL)) == NULL)
+    {
+        LOG_ERROR("Could not fetch the OpenSSL HMAC implementation");
+        result = NULL;
+    }
+    else
+    {
+        // the context holds its own reference to the implementation
+        if ((result = EVP_MAC_CTX_new(mac)) == NULL)
+        {
+            LOG_ERROR("Could not allocate OpenSSL HMAC context");
+        }
+        else
+        {
+            OSSL_PARAM params[2];
+            params[0] = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, (char*)"SHA256", 0);
+            params[1] = OSSL_PARAM_construct_end();
+            if (EVP_MAC_CTX_set_params(result, params) != 1)
+            {
+                LOG_ERROR("Could not select SHA256 for the OpenSSL HMAC context");
+                EVP_MAC_CTX_free(result);
+                result = NULL;
+            }
+        }
+        EVP_MAC_free(mac);
+    }
+#elif OPENSSL_VERSION_NUMBER >= 0x10100000L
+    if ((result = HMAC_CTX_new()) == NULL)
+    {
+        LOG_ERROR("Could not allocate OpenSSL HMAC context");
+    }
+#else
+    if ((result = (THREAD_HMAC_CTX*)malloc(sizeof(THREAD_HMAC_CTX))) == NULL)
+    {
+        LOG_ERROR("Could not allocate OpenSSL HMAC context");
+    }
+    else
+    {
+        HMAC_CTX_init(result);
+    }
+#endif
+
+    return result;
+}
+
+static void destroy_hmac_ctx(THREAD_HMAC_CTX *ctx)
+{
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    EVP_MAC_CTX_free(ctx);
+#elif OPENSSL_VERSION_NUMBER >= 0x10100000L
+    HMAC_CTX_free(ctx);
+#else
+    HMAC_CTX_cleanup(ctx);
+    free(ctx);
+#endif
+}
+
+static int compute_hmac
+(
+    THREAD_HMAC_CTX *ctx,
+    const unsigned char *key,
+    size_t key_size,
+    const unsigned char *data,
+    size_t data_size,
+    unsigned char digest[HSM_HMAC_DIGEST_SIZE]
+)
+{
+    int result;
+
+    // passing a key always rekeys the context, a NULL key would continue with
+    // the key of the previous signature on this thread
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    size_t digest_len = 0;
+
+    if ((EVP_MAC_init(ctx, key, key_size, NULL) != 1) ||
+        (EVP_MAC_update(ctx, data, data_size) != 1) ||
+        (EVP_MAC_final(ctx, digest, &digest_len, HSM_HMAC_DIGEST_SIZE) != 1) ||
+        (digest_len != HSM_HMAC_DIGEST_SIZE))
+    {
+        LOG_ERROR("OpenSSL HMAC computation failed");
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = 0;
+    }
+#else
+    unsigned int digest_len = 0;
+
+    if (key_size > INT_MAX)
+    {
+        LOG_ERROR("HMAC key of size %zu is too large", key_size);
+        result = __FAILURE__;
+    }
+    else if ((HMAC_Init_ex(ctx, key, (int)key_size, EVP_sha256(), NULL) != 1) ||
+             (HMAC_Update(ctx, data, data_size) != 1) ||
+             (HMAC_Final(ctx, digest, &digest_len) != 1) ||
+             (digest_len != HSM_HMAC_DIGEST_SIZE))
+    {
+        LOG_ERROR("OpenSSL HMAC computation failed");
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = 0;
+    }
+#endif
+
+    return result;
+}
+
+//##############################################################################
+// Per thread context
+//##############################################################################
+// Every signing thread keeps one context for its lifetime so the digest
+// method and its buffers are set up once rather than on every signature.
+#if defined __WINDOWS__ || defined _WIN32 || defined _WIN64 || defined _Windows
+static VOID WINAPI release_thread_ctx(PVOID ctx)
+{
+    if (ctx != NULL)
+    {
+        destroy_hmac_ctx((THREAD_HMAC_CTX*)ctx);
+    }
+}
+
+static int create_ctx_slot(void)
+{
+    int result;
+
+    // fiber local storage runs the callback on thread exit, plain TLS does not
+    if ((g_ctx_slot = FlsAlloc(release_thread_ctx)) == FLS_OUT_OF_INDEXES)
+    {
+        LOG_ERROR("Could not allocate HMAC context slot. Error code %lu", GetLastError());
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = 0;
+    }
+
+    return result;
+}
+
+static void delete_ctx_slot(void)
+{
+    // runs the callback for the contexts still in the slot
+    (void)FlsFree(g_ctx_slot);
+    g_ctx_slot = FLS_OUT_OF_INDEXES;
+}
+
+static THREAD_HMAC_CTX* get_ctx_slot_value(void)
+{
+    return (THREAD_HMAC_CTX*)FlsGetValue(g_ctx_slot);
+}
+
+static int set_ctx_slot_value(THREAD_HMAC_CTX *ctx)
+{
+    int result;
+
+    if (!FlsSetValue(g_ctx_slot, ctx))
+    {
+        LOG_ERROR("Could not store HMAC context for thread. Error code %lu", GetLastError());
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = 0;
+    }
+
+    return result;
+}
+#else
+static void release_thread_ctx(void *ctx)
+{
+    destroy_hmac_ctx((THREAD_HMAC_CTX*)ctx);
+}
+
+static int create_ctx_slot(void)
+{
+    int result, status;
+
+    if ((status = pthread_key_create(&g_ctx_slot, release_thread_ctx)) != 0)
+    {
+        LOG_ERROR("Could not allocate HMAC context slot. Error code %d", status);
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = 0;
+    }
+
+    return result;
+}
+
+static void delete_ctx_slot(void)
+{
+    // pthread_key_delete does not run the destructor, the context of the
+    // calling thread is released here and those of threads that exited were
+    // released when they did
+    THREAD_HMAC_CTX *ctx = (THREAD_HMAC_CTX*)pthread_getspecific(g_ctx_slot);
+    if (ctx != NULL)
+    {
+        (void)pthread_setspecific(g_ctx_slot, NULL);
+        destroy_hmac_ctx(ctx);
+    }
+    (void)pthread_key_delete(g_ctx_slot);
+}
+
+static THREAD_HMAC_CTX* get_ctx_slot_value(void)
+{
+    return (THREAD_HMAC_CTX*)pthread_getspecific(g_ctx_slot);
+}
+
+static int set_ctx_slot_value(THREAD_HMAC_CTX *ctx)
+{
+    int result, status;
+
+    if ((status = pthread_setspecific(g_ctx_slot, ctx)) != 0)
+    {
+        LOG_ERROR("Could not store HMAC context for thread. Error code %d", status);
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = 0;
+    }
+
+    return result;
+}
+#endif
+
+static bool is_ctx_slot_ready(void)
+{
+    bool result = (hsm_atomic_load(&g_ctx_slot_created) != 0);
+
+    if (!result)
+    {
+        hsm_global_lock(HSM_GLOBAL_LOCK_HMAC);
+        if ((hsm_atomic_load(&g_ctx_slot_created) == 0) && (create_ctx_slot() == 0))
+        {
+            hsm_atomic_store(&g_ctx_slot_created, 1);
+        }
+        result = (hsm_atomic_load(&g_ctx_slot_created) != 0);
+        hsm_global_unlock(HSM_GLOBAL_LOCK_HMAC);
+    }
+
+    return result;
+}
+
+static THREAD_HMAC_CTX* get_thread_ctx(void)
+{
+    THREAD_HMAC_CTX *result;
+
+    if (!is_ctx_slot_ready())
+    {
+        LOG_ERROR("HMAC context slot is unavailable");
+        result = NULL;
+    }
+    else if ((result = get_ctx_slot_value()) == NULL)
+    {
+        if ((result = create_hmac_ctx()) == NULL)
+        {
+            LOG_ERROR("Could not create HMAC context for thread");
+        }
+        else if (set_ctx_slot_value(result) != 0)
+        {
+            destroy_hmac_ctx(result);
+            result = NULL;
+        }
+    }
+
+    return result;
+}
+
+//##############################################################################
+// OpenSSL HMAC API
+//##############################################################################
+int hsm_hmac_openssl_sign
+(
+    const unsigned char *key,
+    size_t key_size,
+    const unsigned char *data,
+    size_t data_size,
+    unsigned char digest[HSM_HMAC_DIGEST_SIZE]
+)
+{
+    int result;
+    THREAD_HMAC_CTX *ctx;
+
+    if ((key == NULL) || (key_size == 0) || (data == NULL) || (digest == NULL))
+    {
+        LOG_ERROR("Invalid HMAC sign parameters");
+        result = __FAILURE__;
+    }
+    else if ((ctx = get_thread_ctx()) == NULL)
+    {
+        LOG_ERROR("Could not obtain HMAC context");
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = compute_hmac(ctx, key, key_size, data, data_size, digest);
+    }
+
+    return result;
+}
+
+void hsm_hmac_openssl_deinit(void)
+{
+    hsm_global_lock(HSM_GLOBAL_LOCK_HMAC);
+    if (hsm_atomic_load(&g_ctx_slot_created) != 0)
+    {
+        delete_ctx_slot();
+        hsm_atomic_store(&g_ctx_slot_created, 0);
+    }
+    hsm_global_unlock(HSM_GLOBAL_LOCK_HMAC);
+}
@@ -4,10 +4,12 @@
 #ifdef __cplusplus
 #include <cstdbool>
 #include <cstddef>
+#include <cstdint>
 extern "C" {
 #else
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #endif
 
 #include "azure_c_shared_utility/umock_c_prod.h"
@@ -27,6 +29,10 @@ struct PKI_KEY_PROPS_TAG
 };
 typedef struct PKI_KEY_PROPS_TAG PKI_KEY_PROPS;
 
+// Parsed issuer certificate, private key and certificate chain
+typedef struct PKI_ISSUER_TAG* PKI_ISSUER_HANDLE;
+typedef struct PKI_VERIFIER_TAG* PKI_VERIFIER_HANDLE;
+
 MOCKABLE_FUNCTION(, KEY_HANDLE, create_sas_key, const unsigned char*, key, size_t, key_len);
 MOCKABLE_FUNCTION(, KEY_HANDLE, create_encryption_key, const unsigned char*, key, size_t, key_len);
 MOCKABLE_FUNCTION(, KEY_HANDLE, create_cert_key, const char*, key_file_name);
@@ -39,8 +45,40 @@ MOCKABLE_FUNCTION(, int, generate_pki_cert_and_key_with_props, CERT_PROPS_HANDLE
                     int, serial_number, int, ca_path_len,
                     const char*, key_file_name, const char*, cert_file_name,
                     const PKI_KEY_PROPS*, key_props);
+// Same as generate_pki_cert_and_key using an issuer loaded once with
+// pki_issuer_create. An issuer may be shared by concurrent calls.
+MOCKABLE_FUNCTION(, int, generate_pki_cert_and_key_with_issuer, CERT_PROPS_HANDLE, cert_props_handle,
+                    int, serial_number, int, ca_path_len,
+                    const char*, key_file_name, const char*, cert_file_name,
+                    PKI_ISSUER_HANDLE, issuer);
+MOCKABLE_FUNCTION(, PKI_ISSUER_HANDLE, pki_issuer_create, const char*, issuer_key_file, const char*, issuer_certificate_file);
+MOCKABLE_FUNCTION(, void, pki_issuer_destroy, PKI_ISSUER_HANDLE, issuer);
 MOCKABLE_FUNCTION(, int, generate_encryption_key, unsigned char**, key, size_t*, key_size);
 MOCKABLE_FUNCTION(, int, verify_certificate, const char*, certificate, const char*, certificate_key, const char*, issuer_certificate, bool*, verify_status);
+// Same as verify_certificate using every certificate of an issuer certificate
+// file loaded once with pki_verifier_create. A verifier may be shared by
+// concurrent calls.
+MOCKABLE_FUNCTION(, int, verify_certificate_with_verifier, const char*, certificate, PKI_VERIFIER_HANDLE, verifier, bool*, verify_status);
+MOCKABLE_FUNCTION(, PKI_VERIFIER_HANDLE, pki_verifier_create, const char*, issuer_certificate);
+MOCKABLE_FUNCTION(, void, pki_verifier_destroy, PKI_VERIFIER_HANDLE, verifier);
+
+// Size of the identifier returned by get_certificate_verification_id
+#define CERT_VERIFICATION_ID_SIZE 32
+
+// Computes a SHA-256 over the DER encoding of every certificate in the
+// certificate and issuer certificate files, which identifies the inputs to
+// verify_certificate, and returns the expiration time of the certificate.
+MOCKABLE_FUNCTION(, int, get_certificate_verification_id, const char*, certificate, const char*, issuer_certificate, unsigned char*, id, size_t, id_size, int64_t*, not_after);
+
+// Checks that the private key in certificate_key belongs to the first
+// certificate in certificate.
+MOCKABLE_FUNCTION(, int, check_certificate_key, const char*, certificate, const char*, certificate_key, bool*, key_matches);
+
+// Starts pre-generating up to pool_size keys of each key type and size used
+// by generate_pki_cert_and_key, which then take their keys from the pool.
+// The pool hits and misses are logged when the pool is deinitialized.
+MOCKABLE_FUNCTION(, int, pki_key_pool_init, size_t, pool_size);
+MOCKABLE_FUNCTION(, void, pki_key_pool_deinit);
 
 #ifdef __cplusplus
 }
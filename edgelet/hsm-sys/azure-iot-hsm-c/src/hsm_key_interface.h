@@ -4,6 +4,7 @@
 #include "hsm_client_data.h"
 
 typedef void* KEY_HANDLE;
+typedef void* KEY_STREAM_HANDLE;
 
 enum HSM_KEY_TAG_T
 {
@@ -27,6 +28,40 @@ typedef int (*HSM_KEY_DERIVE_AND_SIGN)(KEY_HANDLE key_handle,
                                        unsigned char** digest,
                                        size_t* digest_size);
 
+// The *_INTO variants write into a caller supplied digest buffer whose size is
+// passed in digest_size. On return digest_size holds the size of the digest,
+// which is all that is computed when digest is NULL.
+typedef int (*HSM_KEY_SIGN_INTO)(KEY_HANDLE key_handle,
+                                 const unsigned char* data_to_be_signed,
+                                 size_t data_to_be_signed_size,
+                                 unsigned char* digest,
+                                 size_t* digest_size);
+
+typedef int (*HSM_KEY_DERIVE_AND_SIGN_INTO)(KEY_HANDLE key_handle,
+                                            const unsigned char* data_to_be_signed,
+                                            size_t data_to_be_signed_size,
+                                            const unsigned char* identity,
+                                            size_t identity_size,
+                                            unsigned char* digest,
+                                            size_t* digest_size);
+
+// The *_BATCH variants sign every request into digests, a caller supplied
+// buffer of count consecutive digests whose total size is passed in
+// digest_size. On return digest_size holds the size of one digest, which is
+// all that is computed when digests is NULL. Plain signing ignores the
+// identity of the requests.
+typedef int (*HSM_KEY_SIGN_BATCH)(KEY_HANDLE key_handle,
+                                  const HSM_SIGN_REQUEST* requests,
+                                  size_t count,
+                                  unsigned char* digests,
+                                  size_t* digest_size);
+
+typedef int (*HSM_KEY_DERIVE_AND_SIGN_BATCH)(KEY_HANDLE key_handle,
+                                             const HSM_SIGN_REQUEST* requests,
+                                             size_t count,
+                                             unsigned char* digests,
+                                             size_t* digest_size);
+
 typedef int (*HSM_KEY_ENCRYPT)(KEY_HANDLE key_handle,
                                const SIZED_BUFFER *identity,
                                const SIZED_BUFFER *plaintext,
@@ -41,6 +76,37 @@ typedef int (*HSM_KEY_DECRYPT)(KEY_HANDLE key_handle,
 
 typedef void (*HSM_KEY_DESTROY)(KEY_HANDLE key_handle);
 
+// Streams encrypt or decrypt data of any size in pieces, using memory bounded
+// by the chunk size of the ciphertext format rather than by the data size.
+// A stream is started with *_INIT, fed with any number of updates and
+// completed by final. Output goes to a caller supplied buffer whose size is
+// passed in output_size. On return output_size holds the number of bytes
+// written, or when output is NULL the number of bytes the call would write,
+// which is all that is computed. A call whose output buffer is too small
+// fails without consuming any input and sets output_size to the size needed,
+// after any other failure the stream can only be destroyed. Decrypted data
+// is only returned once the chunk it belongs to is authenticated, the data as
+// a whole is only authentic once final succeeds. Every stream is released
+// with HSM_KEY_STREAM_DESTROY and must not outlive its key.
+typedef int (*HSM_KEY_STREAM_INIT)(KEY_HANDLE key_handle,
+                                   const SIZED_BUFFER *identity,
+                                   const SIZED_BUFFER *initialization_vector,
+                                   KEY_STREAM_HANDLE *stream);
+
+typedef int (*HSM_KEY_STREAM_UPDATE)(KEY_HANDLE key_handle,
+                                     KEY_STREAM_HANDLE stream,
+                                     const unsigned char *input,
+                                     size_t input_size,
+                                     unsigned char *output,
+                                     size_t *output_size);
+
+typedef int (*HSM_KEY_STREAM_FINAL)(KEY_HANDLE key_handle,
+                                    KEY_STREAM_HANDLE stream,
+                                    unsigned char *output,
+                                    size_t *output_size);
+
+typedef void (*HSM_KEY_STREAM_DESTROY)(KEY_HANDLE key_handle, KEY_STREAM_HANDLE stream);
+
 struct HSM_CLIENT_KEY_INTERFACE_TAG
 {
     HSM_KEY_SIGN hsm_client_key_sign;
@@ -48,6 +114,15 @@ struct HSM_CLIENT_KEY_INTERFACE_TAG
     HSM_KEY_ENCRYPT hsm_client_key_encrypt;
     HSM_KEY_DECRYPT hsm_client_key_decrypt;
     HSM_KEY_DESTROY hsm_client_key_destroy;
+    HSM_KEY_SIGN_INTO hsm_client_key_sign_into;
+    HSM_KEY_DERIVE_AND_SIGN_INTO hsm_client_key_derive_and_sign_into;
+    HSM_KEY_SIGN_BATCH hsm_client_key_sign_batch;
+    HSM_KEY_DERIVE_AND_SIGN_BATCH hsm_client_key_derive_and_sign_batch;
+    HSM_KEY_STREAM_INIT hsm_client_key_encrypt_init;
+    HSM_KEY_STREAM_INIT hsm_client_key_decrypt_init;
+    HSM_KEY_STREAM_UPDATE hsm_client_key_stream_update;
+    HSM_KEY_STREAM_FINAL hsm_client_key_stream_final;
+    HSM_KEY_STREAM_DESTROY hsm_client_key_stream_destroy;
 };
 typedef struct HSM_CLIENT_KEY_INTERFACE_TAG HSM_CLIENT_KEY_INTERFACE;
 extern const HSM_CLIENT_KEY_INTERFACE* hsm_client_key_interface(void);
@@ -90,6 +165,78 @@ static inline int key_derive_and_sign
                                                          digest_size);
 }
 
+static inline int key_sign_into
+(
+    KEY_HANDLE key_handle,
+    const unsigned char* data_to_be_signed,
+    size_t data_to_be_signed_size,
+    unsigned char* digest,
+    size_t* digest_size
+)
+{
+    HSM_CLIENT_KEY_INTERFACE* key_interface = (HSM_CLIENT_KEY_INTERFACE*)key_handle;
+    return key_interface->hsm_client_key_sign_into(key_handle,
+                                                   data_to_be_signed,
+                                                   data_to_be_signed_size,
+                                                   digest,
+                                                   digest_size);
+}
+
+static inline int key_derive_and_sign_into
+(
+    KEY_HANDLE key_handle,
+    const unsigned char* data_to_be_signed,
+    size_t data_to_be_signed_size,
+    const unsigned char* identity,
+    size_t identity_size,
+    unsigned char* digest,
+    size_t* digest_size
+)
+{
+    HSM_CLIENT_KEY_INTERFACE* key_interface = (HSM_CLIENT_KEY_INTERFACE*)key_handle;
+    return key_interface->hsm_client_key_derive_and_sign_into(key_handle,
+                                                              data_to_be_signed,
+                                                              data_to_be_signed_size,
+                                                              identity,
+                                                              identity_size,
+                                                              digest,
+                                                              digest_size);
+}
+
+static inline int key_sign_batch
+(
+    KEY_HANDLE key_handle,
+    const HSM_SIGN_REQUEST* requests,
+    size_t count,
+    unsigned char* digests,
+    size_t* digest_size
+)
+{
+    HSM_CLIENT_KEY_INTERFACE* key_interface = (HSM_CLIENT_KEY_INTERFACE*)key_handle;
+    return key_interface->hsm_client_key_sign_batch(key_handle,
+                                                    requests,
+                                                    count,
+                                                    digests,
+                                                    digest_size);
+}
+
+static inline int key_derive_and_sign_batch
+(
+    KEY_HANDLE key_handle,
+    const HSM_SIGN_REQUEST* requests,
+    size_t count,
+    unsigned char* digests,
+    size_t* digest_size
+)
+{
+    HSM_CLIENT_KEY_INTERFACE* key_interface = (HSM_CLIENT_KEY_INTERFACE*)key_handle;
+    return key_interface->hsm_client_key_derive_and_sign_batch(key_handle,
+                                                               requests,
+                                                               count,
+                                                               digests,
+                                                               digest_size);
+}
+
 static inline int key_encrypt(KEY_HANDLE key_handle,
                               const SIZED_BUFFER *identity,
                               const SIZED_BUFFER *plaintext,
@@ -118,6 +265,64 @@ static inline int key_decrypt(KEY_HANDLE key_handle,
                                                  plaintext);
 }
 
+static inline int key_encrypt_init(KEY_HANDLE key_handle,
+                                   const SIZED_BUFFER *identity,
+                                   const SIZED_BUFFER *initialization_vector,
+                                   KEY_STREAM_HANDLE *stream)
+{
+    HSM_CLIENT_KEY_INTERFACE* key_interface = (HSM_CLIENT_KEY_INTERFACE*)key_handle;
+    return key_interface->hsm_client_key_encrypt_init(key_handle,
+                                                      identity,
+                                                      initialization_vector,
+                                                      stream);
+}
+
+static inline int key_decrypt_init(KEY_HANDLE key_handle,
+                                   const SIZED_BUFFER *identity,
+                                   const SIZED_BUFFER *initialization_vector,
+                                   KEY_STREAM_HANDLE *stream)
+{
+    HSM_CLIENT_KEY_INTERFACE* key_interface = (HSM_CLIENT_KEY_INTERFACE*)key_handle;
+    return key_interface->hsm_client_key_decrypt_init(key_handle,
+                                                      identity,
+                                                      initialization_vector,
+                                                      stream);
+}
+
+static inline int key_stream_update(KEY_HANDLE key_handle,
+                                    KEY_STREAM_HANDLE stream,
+                                    const unsigned char *input,
+                                    size_t input_size,
+                                    unsigned char *output,
+                                    size_t *output_size)
+{
+    HSM_CLIENT_KEY_INTERFACE* key_interface = (HSM_CLIENT_KEY_INTERFACE*)key_handle;
+    return key_interface->hsm_client_key_stream_update(key_handle,
+                                                       stream,
+                                                       input,
+                                                       input_size,
+                                                       output,
+                                                       output_size);
+}
+
+static inline int key_stream_final(KEY_HANDLE key_handle,
+                                   KEY_STREAM_HANDLE stream,
+                                   unsigned char *output,
+                                   size_t *output_size)
+{
+    HSM_CLIENT_KEY_INTERFACE* key_interface = (HSM_CLIENT_KEY_INTERFACE*)key_handle;
+    return key_interface->hsm_client_key_stream_final(key_handle,
+                                                      stream,
+                                                      output,
+                                                      output_size);
+}
+
+static inline void key_stream_destroy(KEY_HANDLE key_handle, KEY_STREAM_HANDLE stream)
+{
+    HSM_CLIENT_KEY_INTERFACE* key_interface = (HSM_CLIENT_KEY_INTERFACE*)key_handle;
+    key_interface->hsm_client_key_stream_destroy(key_handle, stream);
+}
+
 static inline void key_destroy(KEY_HANDLE key_handle)
 {
     HSM_CLIENT_KEY_INTERFACE* key_interface = (HSM_CLIENT_KEY_INTERFACE*)key_handle;
@@ -0,0 +1,283 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "azure_c_shared_utility/gballoc.h"
+#include "hsm_key_pool.h"
+#include "hsm_lock.h"
+#include "hsm_log.h"
+
+//##############################################################################
+// Data types
+//##############################################################################
+// bounds the number of distinct key types and sizes that are pre-generated
+#define KEY_POOL_MAX_CLASSES 8
+
+typedef struct KEY_POOL_CLASS_TAG
+{
+    int key_type;
+    int key_param;
+    void *keys[HSM_KEY_POOL_MAX_SIZE];
+    size_t num_keys;
+    bool is_disabled;
+} KEY_POOL_CLASS;
+
+// Everything below the callbacks is guarded by the pool mutex. Keys are
+// generated by the worker with the mutex released so that takes are never
+// blocked on a key generation.
+struct HSM_KEY_POOL_TAG
+{
+    size_t pool_size;
+    HSM_KEY_POOL_GENERATE_KEY generate_key;
+    HSM_KEY_POOL_DESTROY_KEY destroy_key;
+    KEY_POOL_CLASS classes[KEY_POOL_MAX_CLASSES];
+    size_t num_classes;
+    bool is_stopping;
+    uint64_t hits;
+    uint64_t misses;
+    HSM_MUTEX_HANDLE mutex;
+    HSM_COND_HANDLE cond;
+    HSM_THREAD_HANDLE worker;
+};
+typedef struct HSM_KEY_POOL_TAG HSM_KEY_POOL;
+
+//##############################################################################
+// Worker
+//##############################################################################
+static KEY_POOL_CLASS* find_class(HSM_KEY_POOL *pool, int key_type, int key_param)
+{
+    KEY_POOL_CLASS *result = NULL;
+    size_t index;
+
+    for (index = 0; (index < pool->num_classes) && (result == NULL); index++)
+    {
+        if ((pool->classes[index].key_type == key_type) &&
+            (pool->classes[index].key_param == key_param))
+        {
+            result = &pool->classes[index];
+        }
+    }
+
+    return result;
+}
+
+static KEY_POOL_CLASS* find_class_to_refill(HSM_KEY_POOL *pool)
+{
+    KEY_POOL_CLASS *result = NULL;
+    size_t index;
+
+    for (index = 0; (index < pool->num_classes) && (result == NULL); index++)
+    {
+        if (!pool->classes[index].is_disabled &&
+            (pool->classes[index].num_keys < pool->pool_size))
+        {
+            result = &pool->classes[index];
+        }
+    }
+
+    return result;
+}
+
+static void refill_pool(void *context)
+{
+    HSM_KEY_POOL *pool = (HSM_KEY_POOL*)context;
+    KEY_POOL_CLASS *key_class;
+
+    hsm_mutex_lock(pool->mutex);
+    while (!pool->is_stopping)
+    {
+        if ((key_class = find_class_to_refill(pool)) == NULL)
+        {
+            hsm_cond_wait(pool->cond, pool->mutex);
+        }
+        else
+        {
+            // classes are never removed so key_class remains valid while unlocked
+            void *key;
+            int key_type = key_class->key_type;
+            int key_param = key_class->key_param;
+
+            hsm_mutex_unlock(pool->mutex);
+            key = pool->generate_key(key_type, key_param);
+            hsm_mutex_lock(pool->mutex);
+
+            if (key == NULL)
+            {
+                LOG_ERROR("Could not pre-generate key of type %d param %d, refill disabled",
+                          key_type, key_param);
+                key_class->is_disabled = true;
+            }
+            else if (pool->is_stopping || (key_class->num_keys >= pool->pool_size))
+            {
+                pool->destroy_key(key);
+            }
+            else
+            {
+                key_class->keys[key_class->num_keys++] = key;
+            }
+        }
+    }
+    hsm_mutex_unlock(pool->mutex);
+}
+
+static int start_worker(HSM_KEY_POOL *pool)
+{
+    int result;
+
+    if ((pool->mutex = hsm_mutex_create()) == NULL)
+    {
+        LOG_ERROR("Could not create key pool mutex");
+        result = __FAILURE__;
+    }
+    else if ((pool->cond = hsm_cond_create()) == NULL)
+    {
+        LOG_ERROR("Could not create key pool condition");
+        hsm_mutex_destroy(pool->mutex);
+        result = __FAILURE__;
+    }
+    else if ((pool->worker = hsm_thread_create(refill_pool, pool)) == NULL)
+    {
+        LOG_ERROR("Could not create key pool thread");
+        hsm_cond_destroy(pool->cond);
+        hsm_mutex_destroy(pool->mutex);
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = 0;
+    }
+
+    return result;
+}
+
+static void stop_worker(HSM_KEY_POOL *pool)
+{
+    hsm_mutex_lock(pool->mutex);
+    pool->is_stopping = true;
+    hsm_cond_signal(pool->cond);
+    hsm_mutex_unlock(pool->mutex);
+
+    hsm_thread_join(pool->worker);
+    hsm_cond_destroy(pool->cond);
+    hsm_mutex_destroy(pool->mutex);
+}
+
+//##############################################################################
+// Key pool API
+//##############################################################################
+HSM_KEY_POOL_HANDLE hsm_key_pool_create
+(
+    size_t pool_size,
+    HSM_KEY_POOL_GENERATE_KEY generate_key,
+    HSM_KEY_POOL_DESTROY_KEY destroy_key
+)
+{
+    HSM_KEY_POOL *result;
+
+    if ((pool_size == 0) || (pool_size > HSM_KEY_POOL_MAX_SIZE))
+    {
+        LOG_ERROR("Invalid key pool size %zu", pool_size);
+        result = NULL;
+    }
+    else if ((generate_key == NULL) || (destroy_key == NULL))
+    {
+        LOG_ERROR("Invalid key pool callbacks");
+        result = NULL;
+    }
+    else if ((result = (HSM_KEY_POOL*)calloc(1, sizeof(HSM_KEY_POOL))) == NULL)
+    {
+        LOG_ERROR("Could not allocate memory for key pool");
+    }
+    else
+    {
+        result->pool_size = pool_size;
+        result->generate_key = generate_key;
+        result->destroy_key = destroy_key;
+        if (start_worker(result) != 0)
+        {
+            free(result);
+            result = NULL;
+        }
+    }
+
+    return (HSM_KEY_POOL_HANDLE)result;
+}
+
+void hsm_key_pool_destroy(HSM_KEY_POOL_HANDLE handle)
+{
+    if (handle != NULL)
+    {
+        size_t index, key_index;
+
+        stop_worker(handle);
+        for (index = 0; index < handle->num_classes; index++)
+        {
+            for (key_index = 0; key_index < handle->classes[index].num_keys; key_index++)
+            {
+                handle->destroy_key(handle->classes[index].keys[key_index]);
+            }
+        }
+        free(handle);
+    }
+}
+
+void* hsm_key_pool_take(HSM_KEY_POOL_HANDLE handle, int key_type, int key_param)
+{
+    void *result = NULL;
+
+    if (handle == NULL)
+    {
+        LOG_ERROR("Invalid key pool handle");
+    }
+    else
+    {
+        KEY_POOL_CLASS *key_class;
+
+        hsm_mutex_lock(handle->mutex);
+        if ((key_class = find_class(handle, key_type, key_param)) == NULL)
+        {
+            if (handle->num_classes < KEY_POOL_MAX_CLASSES)
+            {
+                key_class = &handle->classes[handle->num_classes++];
+                key_class->key_type = key_type;
+                key_class->key_param = key_param;
+                LOG_DEBUG("Pre-generating keys of type %d param %d", key_type, key_param);
+            }
+        }
+        else if (key_class->num_keys > 0)
+        {
+            result = key_class->keys[--key_class->num_keys];
+        }
+
+        if (result != NULL)
+        {
+            handle->hits++;
+        }
+        else
+        {
+            handle->misses++;
+        }
+        if (key_class != NULL)
+        {
+            hsm_cond_signal(handle->cond);
+        }
+        hsm_mutex_unlock(handle->mutex);
+    }
+
+    return result;
+}
+
+void hsm_key_pool_get_metrics(HSM_KEY_POOL_HANDLE handle, HSM_KEY_POOL_METRICS *metrics)
+{
+    if ((handle == NULL) || (metrics == NULL))
+    {
+        LOG_ERROR("Invalid key pool metrics parameters");
+    }
+    else
+    {
+        hsm_mutex_lock(handle->mutex);
+        metrics->hits = handle->hits;
+        metrics->misses = handle->misses;
+        hsm_mutex_unlock(handle->mutex);
+    }
+}
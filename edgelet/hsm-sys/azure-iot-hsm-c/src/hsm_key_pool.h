@@ -0,0 +1,59 @@
+#ifndef HSM_KEY_POOL_H
+#define HSM_KEY_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Pool of pre-generated keys which are refilled by a background thread.
+ *
+ * Keys are grouped in classes identified by a key type and a type specific
+ * parameter such as the key length or curve. A class is added the first time
+ * a key of that class is requested, which is counted as a miss, after which
+ * the worker thread keeps up to pool_size keys of the class generated. The
+ * number of classes is bounded and a class is no longer refilled once the
+ * generation of one of its keys fails.
+ *
+ * Keys are opaque to the pool and are created and destroyed with the
+ * callbacks provided when the pool is created.
+ */
+typedef struct HSM_KEY_POOL_TAG* HSM_KEY_POOL_HANDLE;
+
+typedef void* (*HSM_KEY_POOL_GENERATE_KEY)(int key_type, int key_param);
+typedef void (*HSM_KEY_POOL_DESTROY_KEY)(void *key);
+
+typedef struct HSM_KEY_POOL_METRICS_TAG
+{
+    uint64_t hits;
+    uint64_t misses;
+} HSM_KEY_POOL_METRICS;
+
+// Upper bound for the number of keys kept per class
+#define HSM_KEY_POOL_MAX_SIZE 64
+
+extern HSM_KEY_POOL_HANDLE hsm_key_pool_create(size_t pool_size, HSM_KEY_POOL_GENERATE_KEY generate_key, HSM_KEY_POOL_DESTROY_KEY destroy_key);
+
+/**
+ * Stops the worker thread, waiting for any key being generated, and destroys
+ * all pooled keys.
+ */
+extern void hsm_key_pool_destroy(HSM_KEY_POOL_HANDLE handle);
+
+/**
+ * Takes a key of the class from the pool and wakes the worker to replace it.
+ * Returns NULL when no key is available in which case the caller generates
+ * the key itself. The caller owns the returned key.
+ */
+extern void* hsm_key_pool_take(HSM_KEY_POOL_HANDLE handle, int key_type, int key_param);
+
+extern void hsm_key_pool_get_metrics(HSM_KEY_POOL_HANDLE handle, HSM_KEY_POOL_METRICS *metrics);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  //HSM_KEY_POOL_H
@@ -0,0 +1,417 @@
+#if !(defined __WINDOWS__ || defined _WIN32 || defined _WIN64 || defined _Windows)
+    // pthread_rwlock_t and pthread condition variables are only visible in
+    // strict C99 builds with XSI extensions enabled
+    #if !defined _XOPEN_SOURCE
+        #define _XOPEN_SOURCE 700
+    #endif
+#endif
+
+#include <stdlib.h>
+#include <time.h>
+
+#include "azure_c_shared_utility/gballoc.h"
+#include "hsm_lock.h"
+#include "hsm_log.h"
+
+#if defined __WINDOWS__ || defined _WIN32 || defined _WIN64 || defined _Windows
+    #include <windows.h>
+
+    struct HSM_RWLOCK_TAG
+    {
+        SRWLOCK lock;
+    };
+
+    struct HSM_MUTEX_TAG
+    {
+        SRWLOCK lock;
+    };
+
+    struct HSM_COND_TAG
+    {
+        CONDITION_VARIABLE cond;
+    };
+
+    struct HSM_THREAD_TAG
+    {
+        HSM_THREAD_RUN run;
+        void *context;
+        HANDLE thread;
+    };
+
+    static SRWLOCK g_global_locks[HSM_GLOBAL_LOCK_COUNT] = { SRWLOCK_INIT, SRWLOCK_INIT, SRWLOCK_INIT, SRWLOCK_INIT };
+#else
+    #include <pthread.h>
+
+    struct HSM_RWLOCK_TAG
+    {
+        pthread_rwlock_t lock;
+    };
+
+    struct HSM_MUTEX_TAG
+    {
+        pthread_mutex_t lock;
+    };
+
+    struct HSM_COND_TAG
+    {
+        pthread_cond_t cond;
+    };
+
+    struct HSM_THREAD_TAG
+    {
+        HSM_THREAD_RUN run;
+        void *context;
+        pthread_t thread;
+    };
+
+    static pthread_mutex_t g_global_locks[HSM_GLOBAL_LOCK_COUNT] =
+    {
+        PTHREAD_MUTEX_INITIALIZER,
+        PTHREAD_MUTEX_INITIALIZER,
+        PTHREAD_MUTEX_INITIALIZER,
+        PTHREAD_MUTEX_INITIALIZER
+    };
+#endif
+
+HSM_RWLOCK_HANDLE hsm_rwlock_create(void)
+{
+    HSM_RWLOCK_HANDLE result;
+
+    if ((result = (HSM_RWLOCK_HANDLE)malloc(sizeof(struct HSM_RWLOCK_TAG))) == NULL)
+    {
+        LOG_ERROR("Could not allocate memory for lock");
+    }
+    else
+    {
+#if defined __WINDOWS__ || defined _WIN32 || defined _WIN64 || defined _Windows
+        InitializeSRWLock(&result->lock);
+#else
+        int status;
+        if ((status = pthread_rwlock_init(&result->lock, NULL)) != 0)
+        {
+            LOG_ERROR("Could not initialize lock. Error code %d", status);
+            free(result);
+            result = NULL;
+        }
+#endif
+    }
+
+    return result;
+}
+
+void hsm_rwlock_destroy(HSM_RWLOCK_HANDLE lock)
+{
+    if (lock != NULL)
+    {
+#if !(defined __WINDOWS__ || defined _WIN32 || defined _WIN64 || defined _Windows)
+        (void)pthread_rwlock_destroy(&lock->lock);
+#endif
+        free(lock);
+    }
+}
+
+void hsm_rwlock_read_lock(HSM_RWLOCK_HANDLE lock)
+{
+#if defined __WINDOWS__ || defined _WIN32 || defined _WIN64 || defined _Windows
+    AcquireSRWLockShared(&lock->lock);
+#else
+    (void)pthread_rwlock_rdlock(&lock->lock);
+#endif
+}
+
+void hsm_rwlock_read_unlock(HSM_RWLOCK_HANDLE lock)
+{
+#if defined __WINDOWS__ || defined _WIN32 || defined _WIN64 || defined _Windows
+    ReleaseSRWLockShared(&lock->lock);
+#else
+    (void)pthread_rwlock_unlock(&lock->lock);
+#endif
+}
+
+void hsm_rwlock_write_lock(HSM_RWLOCK_HANDLE lock)
+{
+#if defined __WINDOWS__ || defined _WIN32 || defined _WIN64 || defined _Windows
+    AcquireSRWLockExclusive(&lock->lock);
+#else
+    (void)pthread_rwlock_wrlock(&lock->lock);
+#endif
+}
+
+void hsm_rwlock_write_unlock(HSM_RWLOCK_HANDLE lock)
+{
+#if defined __WINDOWS__ || defined _WIN32 || defined _WIN64 || defined _Windows
+    ReleaseSRWLockExclusive(&lock->lock);
+#else
+    (void)pthread_rwlock_unlock(&lock->lock);
+#endif
+}
+
+HSM_MUTEX_HANDLE hsm_mutex_create(void)
+{
+    HSM_MUTEX_HANDLE result;
+
+    if ((result = (HSM_MUTEX_HANDLE)malloc(sizeof(struct HSM_MUTEX_TAG))) == NULL)
+    {
+        LOG_ERROR("Could not allocate memory for mutex");
+    }
+    else
+    {
+#if defined __WINDOWS__ || defined _WIN32 || defined _WIN64 || defined _Windows
+        InitializeSRWLock(&result->lock);
+#else
+        int status;
+        if ((status = pthread_mutex_init(&result->lock, NULL)) != 0)
+        {
+            LOG_ERROR("Could not initialize mutex. Error code %d", status);
+            free(result);
+            result = NULL;
+        }
+#endif
+    }
+
+    return result;
+}
+
+void hsm_mutex_destroy(HSM_MUTEX_HANDLE mutex)
+{
+    if (mutex != NULL)
+    {
+#if !(defined __WINDOWS__ || defined _WIN32 || defined _WIN64 || defined _Windows)
+        (void)pthread_mutex_destroy(&mutex->lock);
+#endif
+        free(mutex);
+    }
+}
+
+void hsm_mutex_lock(HSM_MUTEX_HANDLE mutex)
+{
+#if defined __WINDOWS__ || defined _WIN32 || defined _WIN64 || defined _Windows
+    AcquireSRWLockExclusive(&mutex->lock);
+#else
+    (void)pthread_mutex_lock(&mutex->lock);
+#endif
+}
+
+void hsm_mutex_unlock(HSM_MUTEX_HANDLE mutex)
+{
+#if defined __WINDOWS__ || defined _WIN32 || defined _WIN64 || defined _Windows
+    ReleaseSRWLockExclusive(&mutex->lock);
+#else
+    (void)pthread_mutex_unlock(&mutex->lock);
+#endif
+}
+
+HSM_COND_HANDLE hsm_cond_create(void)
+{
+    HSM_COND_HANDLE result;
+
+    if ((result = (HSM_COND_HANDLE)malloc(sizeof(struct HSM_COND_TAG))) == NULL)
+    {
+        LOG_ERROR("Could not allocate memory for condition");
+    }
+    else
+    {
+#if defined __WINDOWS__ || defined _WIN32 || defined _WIN64 || defined _Windows
+        InitializeConditionVariable(&result->cond);
+#else
+        int status;
+        if ((status = pthread_cond_init(&result->cond, NULL)) != 0)
+        {
+            LOG_ERROR("Could not initialize condition. Error code %d", status);
+            free(result);
+            result = NULL;
+        }
+#endif
+    }
+
+    return result;
+}
+
+void hsm_cond_destroy(HSM_COND_HANDLE cond)
+{
+    if (cond != NULL)
+    {
+#if !(defined __WINDOWS__ || defined _WIN32 || defined _WIN64 || defined _Windows)
+        (void)pthread_cond_destroy(&cond->cond);
+#endif
+        free(cond);
+    }
+}
+
+void hsm_cond_wait(HSM_COND_HANDLE cond, HSM_MUTEX_HANDLE mutex)
+{
+#if defined __WINDOWS__ || defined _WIN32 || defined _WIN64 || defined _Windows
+    (void)SleepConditionVariableSRW(&cond->cond, &mutex->lock, INFINITE, 0);
+#else
+    (void)pthread_cond_wait(&cond->cond, &mutex->lock);
+#endif
+}
+
+void hsm_cond_wait_until(HSM_COND_HANDLE cond, HSM_MUTEX_HANDLE mutex, int64_t due_time)
+{
+#if defined __WINDOWS__ || defined _WIN32 || defined _WIN64 || defined _Windows
+    // the wait is relative, so wait in bounded steps and let the caller
+    // re-check the wall clock on every wake up
+    int64_t wait_seconds = due_time - (int64_t)time(NULL);
+    DWORD timeout_ms;
+    if (wait_seconds <= 0)
+    {
+        timeout_ms = 0;
+    }
+    else
+    {
+        timeout_ms = (wait_seconds > 3600) ? (3600 * 1000) : (DWORD)(wait_seconds * 1000);
+    }
+    (void)SleepConditionVariableSRW(&cond->cond, &mutex->lock, timeout_ms, 0);
+#else
+    struct timespec due;
+    due.tv_sec = (time_t)due_time;
+    due.tv_nsec = 0;
+    (void)pthread_cond_timedwait(&cond->cond, &mutex->lock, &due);
+#endif
+}
+
+void hsm_cond_signal(HSM_COND_HANDLE cond)
+{
+#if defined __WINDOWS__ || defined _WIN32 || defined _WIN64 || defined _Windows
+    WakeConditionVariable(&cond->cond);
+#else
+    (void)pthread_cond_signal(&cond->cond);
+#endif
+}
+
+#if defined __WINDOWS__ || defined _WIN32 || defined _WIN64 || defined _Windows
+static DWORD WINAPI thread_start(LPVOID context)
+{
+    HSM_THREAD_HANDLE thread = (HSM_THREAD_HANDLE)context;
+    thread->run(thread->context);
+    return 0;
+}
+#else
+static void* thread_start(void *context)
+{
+    HSM_THREAD_HANDLE thread = (HSM_THREAD_HANDLE)context;
+    thread->run(thread->context);
+    return NULL;
+}
+#endif
+
+HSM_THREAD_HANDLE hsm_thread_create(HSM_THREAD_RUN run, void *context)
+{
+    HSM_THREAD_HANDLE result;
+
+    if (run == NULL)
+    {
+        LOG_ERROR("Invalid thread function");
+        result = NULL;
+    }
+    else if ((result = (HSM_THREAD_HANDLE)malloc(sizeof(struct HSM_THREAD_TAG))) == NULL)
+    {
+        LOG_ERROR("Could not allocate memory for thread");
+    }
+    else
+    {
+        result->run = run;
+        result->context = context;
+#if defined __WINDOWS__ || defined _WIN32 || defined _WIN64 || defined _Windows
+        if ((result->thread = CreateThread(NULL, 0, thread_start, result, 0, NULL)) == NULL)
+        {
+            LOG_ERROR("Could not create thread. Error code %lu", GetLastError());
+            free(result);
+            result = NULL;
+        }
+#else
+        int status;
+        if ((status = pthread_create(&result->thread, NULL, thread_start, result)) != 0)
+        {
+            LOG_ERROR("Could not create thread. Error code %d", status);
+            free(result);
+            result = NULL;
+        }
+#endif
+    }
+
+    return result;
+}
+
+void hsm_thread_join(HSM_THREAD_HANDLE thread)
+{
+    if (thread != NULL)
+    {
+#if defined __WINDOWS__ || defined _WIN32 || defined _WIN64 || defined _Windows
+        (void)WaitForSingleObject(thread->thread, INFINITE);
+        (void)CloseHandle(thread->thread);
+#else
+        (void)pthread_join(thread->thread, NULL);
+#endif
+        free(thread);
+    }
+}
+
+void hsm_global_lock(HSM_GLOBAL_LOCK lock)
+{
+#if defined __WINDOWS__ || defined _WIN32 || defined _WIN64 || defined _Windows
+    AcquireSRWLockExclusive(&g_global_locks[lock]);
+#else
+    (void)pthread_mutex_lock(&g_global_locks[lock]);
+#endif
+}
+
+void hsm_global_unlock(HSM_GLOBAL_LOCK lock)
+{
+#if defined __WINDOWS__ || defined _WIN32 || defined _WIN64 || defined _Windows
+    ReleaseSRWLockExclusive(&g_global_locks[lock]);
+#else
+    (void)pthread_mutex_unlock(&g_global_locks[lock]);
+#endif
+}
+
+void hsm_run_once(HSM_ONCE *once, HSM_ONCE_RUN init)
+{
+    if (hsm_atomic_load(once) == 0)
+    {
+        hsm_global_lock(HSM_GLOBAL_LOCK_ONCE);
+        if (hsm_atomic_load(once) == 0)
+        {
+            init();
+            hsm_atomic_store(once, 1);
+        }
+        hsm_global_unlock(HSM_GLOBAL_LOCK_ONCE);
+    }
+}
+
+long hsm_atomic_increment(volatile long *value)
+{
+#if defined __WINDOWS__ || defined _WIN32 || defined _WIN64 || defined _Windows
+    return InterlockedIncrement(value);
+#else
+    return __atomic_add_fetch(value, 1, __ATOMIC_SEQ_CST);
+#endif
+}
+
+long hsm_atomic_decrement(volatile long *value)
+{
+#if defined __WINDOWS__ || defined _WIN32 || defined _WIN64 || defined _Windows
+    return InterlockedDecrement(value);
+#else
+    return __atomic_sub_fetch(value, 1, __ATOMIC_SEQ_CST);
+#endif
+}
+
+long hsm_atomic_load(volatile long *value)
+{
+#if defined __WINDOWS__ || defined _WIN32 || defined _WIN64 || defined _Windows
+    return InterlockedCompareExchange(value, 0, 0);
+#else
+    return __atomic_load_n(value, __ATOMIC_SEQ_CST);
+#endif
+}
+
+void hsm_atomic_store(volatile long *value, long new_value)
+{
+#if defined __WINDOWS__ || defined _WIN32 || defined _WIN64 || defined _Windows
+    (void)InterlockedExchange(value, new_value);
+#else
+    __atomic_store_n(value, new_value, __ATOMIC_SEQ_CST);
+#endif
+}
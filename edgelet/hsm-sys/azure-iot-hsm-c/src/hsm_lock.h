@@ -0,0 +1,103 @@
+#ifndef HSM_LOCK_H
+#define HSM_LOCK_H
+
+#ifdef __cplusplus
+#include <cstdint>
+extern "C" {
+#else
+#include <stdint.h>
+#endif
+
+/**
+ * Reader/writer lock. Any number of readers may hold the lock concurrently,
+ * writers are exclusive. Locks are not recursive.
+ */
+typedef struct HSM_RWLOCK_TAG* HSM_RWLOCK_HANDLE;
+
+/**
+ * Exclusive lock that can be waited on through a condition. Not recursive.
+ */
+typedef struct HSM_MUTEX_TAG* HSM_MUTEX_HANDLE;
+
+/**
+ * Condition variable used together with an HSM_MUTEX_HANDLE. Waits may wake
+ * up spuriously so callers re-check their predicate in a loop.
+ */
+typedef struct HSM_COND_TAG* HSM_COND_HANDLE;
+
+/**
+ * Thread started by hsm_thread_create. Every thread must be joined exactly
+ * once with hsm_thread_join, which also releases the handle.
+ */
+typedef struct HSM_THREAD_TAG* HSM_THREAD_HANDLE;
+typedef void (*HSM_THREAD_RUN)(void *context);
+
+/**
+ * Statically allocated process wide locks. These are usable without any
+ * initialization and are intended to guard library singletons.
+ */
+typedef enum HSM_GLOBAL_LOCK_TAG
+{
+    HSM_GLOBAL_LOCK_STORE = 0,
+    HSM_GLOBAL_LOCK_TPM_DEVICE,
+    HSM_GLOBAL_LOCK_ONCE,
+    HSM_GLOBAL_LOCK_HMAC,
+    HSM_GLOBAL_LOCK_COUNT
+} HSM_GLOBAL_LOCK;
+
+/**
+ * Flag for hsm_run_once. Must have static storage duration and be
+ * initialized to HSM_ONCE_INIT.
+ */
+typedef volatile long HSM_ONCE;
+#define HSM_ONCE_INIT 0
+typedef void (*HSM_ONCE_RUN)(void);
+
+extern HSM_RWLOCK_HANDLE hsm_rwlock_create(void);
+extern void hsm_rwlock_destroy(HSM_RWLOCK_HANDLE lock);
+extern void hsm_rwlock_read_lock(HSM_RWLOCK_HANDLE lock);
+extern void hsm_rwlock_read_unlock(HSM_RWLOCK_HANDLE lock);
+extern void hsm_rwlock_write_lock(HSM_RWLOCK_HANDLE lock);
+extern void hsm_rwlock_write_unlock(HSM_RWLOCK_HANDLE lock);
+
+extern HSM_MUTEX_HANDLE hsm_mutex_create(void);
+extern void hsm_mutex_destroy(HSM_MUTEX_HANDLE mutex);
+extern void hsm_mutex_lock(HSM_MUTEX_HANDLE mutex);
+extern void hsm_mutex_unlock(HSM_MUTEX_HANDLE mutex);
+
+extern HSM_COND_HANDLE hsm_cond_create(void);
+extern void hsm_cond_destroy(HSM_COND_HANDLE cond);
+extern void hsm_cond_wait(HSM_COND_HANDLE cond, HSM_MUTEX_HANDLE mutex);
+/**
+ * Waits like hsm_cond_wait but returns no later than when the wall clock
+ * reaches due_time, in seconds since the epoch as returned by time().
+ */
+extern void hsm_cond_wait_until(HSM_COND_HANDLE cond, HSM_MUTEX_HANDLE mutex, int64_t due_time);
+extern void hsm_cond_signal(HSM_COND_HANDLE cond);
+
+extern HSM_THREAD_HANDLE hsm_thread_create(HSM_THREAD_RUN run, void *context);
+extern void hsm_thread_join(HSM_THREAD_HANDLE thread);
+
+extern void hsm_global_lock(HSM_GLOBAL_LOCK lock);
+extern void hsm_global_unlock(HSM_GLOBAL_LOCK lock);
+
+/**
+ * Runs init exactly once for a flag. Callers that race with the first call
+ * wait until init has returned. init must not call hsm_run_once itself.
+ */
+extern void hsm_run_once(HSM_ONCE *once, HSM_ONCE_RUN init);
+
+/**
+ * Sequentially consistent atomic operations. Increment and decrement return
+ * the updated value.
+ */
+extern long hsm_atomic_increment(volatile long *value);
+extern long hsm_atomic_decrement(volatile long *value);
+extern long hsm_atomic_load(volatile long *value);
+extern void hsm_atomic_store(volatile long *value, long new_value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  //HSM_LOCK_H
@@ -1,3 +1,10 @@
+#if !(defined __WINDOWS__ || defined _WIN32 || defined _WIN64 || defined _Windows)
+    // gmtime_r is only visible in strict C99 builds with XSI extensions enabled
+    #if !defined _XOPEN_SOURCE
+        #define _XOPEN_SOURCE 700
+    #endif
+#endif
+
 #include <stdarg.h>
 #include <stdio.h>
 #include <time.h>
@@ -21,10 +28,17 @@ void log_msg(int level, const char* file, const char* function, int line, const
 
     if (level >= log_level) {
         time_t now;
+        struct tm now_tm;
         char buffer[MAX_LOG_SIZE];
         char time_buf[sizeof("2018-05-24T00:00:00Z")];
         time(&now);
-        strftime(time_buf, sizeof(time_buf), "%FT%TZ", gmtime(&now));
+        // messages are logged concurrently, gmtime shares its result buffer
+#if defined __WINDOWS__ || defined _WIN32 || defined _WIN64 || defined _Windows
+        (void)gmtime_s(&now_tm, &now);
+#else
+        (void)gmtime_r(&now, &now_tm);
+#endif
+        strftime(time_buf, sizeof(time_buf), "%FT%TZ", &now_tm);
         va_list args;
         va_start (args, fmt_str);
         vsnprintf(buffer, MAX_LOG_SIZE, fmt_str, args);
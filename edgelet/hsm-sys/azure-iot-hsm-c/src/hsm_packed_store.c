@@ -0,0 +1,821 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "azure_c_shared_utility/gballoc.h"
+#include "hsm_lock.h"
+#include "hsm_log.h"
+#include "hsm_packed_store.h"
+#include "hsm_utils.h"
+
+//##############################################################################
+// Data types
+//##############################################################################
+#define PACKED_STORE_VERSION        1
+#define PACKED_RECORD_MAGIC         0x524d5348  // "HSMR"
+#define PACKED_RECORD_TOMBSTONE     0x0001
+#define PACKED_RECORD_ALIGNMENT     8
+#define PACKED_RECORD_MAX_FIELD     (16 * 1024 * 1024)
+#define PACKED_MIN_ENTRIES          8
+// the file is compacted after a write once it is at least this large and
+// more than half of it is superseded or removed records
+#define PACKED_COMPACT_MIN_SIZE     (64 * 1024)
+
+static const unsigned char PACKED_STORE_MAGIC[8] = { 'I', 'E', 'H', 'S', 'M', 'P', 'K', '1' };
+static const char *PACKED_TEMP_FILE_EXT = ".tmp";
+
+// The index_count entries immediately follow the header and reference the
+// records written by the last compaction, which end at log_offset. Records
+// appended since start at log_offset. header_crc covers all preceding
+// header fields and index_crc covers the index entries.
+typedef struct PACKED_HEADER_TAG
+{
+    unsigned char magic[8];
+    uint32_t version;
+    uint32_t index_count;
+    uint64_t log_offset;
+    uint32_t index_crc;
+    uint32_t header_crc;
+} PACKED_HEADER;
+
+typedef struct PACKED_INDEX_ENTRY_TAG
+{
+    uint64_t offset;
+    uint32_t size;
+    uint32_t hash;
+} PACKED_INDEX_ENTRY;
+
+// the record is followed by the name and data and is padded to
+// PACKED_RECORD_ALIGNMENT. crc covers every byte after the crc field up to
+// the end of the data.
+typedef struct PACKED_RECORD_HEADER_TAG
+{
+    uint32_t magic;
+    uint32_t crc;
+    uint16_t type;
+    uint16_t flags;
+    uint32_t name_len;
+    uint32_t data_len;
+} PACKED_RECORD_HEADER;
+
+#define PACKED_RECORD_CRC_OFFSET (2 * sizeof(uint32_t))
+
+typedef struct PACKED_ENTRY_TAG
+{
+    uint32_t hash;
+    uint16_t type;
+    size_t offset;
+    size_t size;
+} PACKED_ENTRY;
+
+// view holds the contents of the file as of the last load. Readers hold the
+// lock shared for as long as they reference the view, writers exclusively
+// since every write replaces the view.
+struct HSM_PACKED_STORE_TAG
+{
+    char *file_path;
+    char *temp_file_path;
+    HSM_RWLOCK_HANDLE lock;
+    const unsigned char *view;
+    size_t view_size;
+    PACKED_ENTRY *entries;
+    size_t num_entries;
+    size_t max_entries;
+    size_t live_size;
+    size_t valid_size;
+    bool needs_compaction;
+};
+typedef struct HSM_PACKED_STORE_TAG HSM_PACKED_STORE;
+
+//##############################################################################
+// Checksum and hashing helpers
+//##############################################################################
+static uint32_t packed_crc32(uint32_t crc, const unsigned char *data, size_t size)
+{
+    // CRC-32 (IEEE 802.3), nibble table driven
+    static const uint32_t CRC_TABLE[16] =
+    {
+        0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac,
+        0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+        0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c,
+        0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c
+    };
+    size_t index;
+
+    crc = ~crc;
+    for (index = 0; index < size; index++)
+    {
+        crc = CRC_TABLE[(crc ^ data[index]) & 0x0f] ^ (crc >> 4);
+        crc = CRC_TABLE[(crc ^ (data[index] >> 4)) & 0x0f] ^ (crc >> 4);
+    }
+
+    return ~crc;
+}
+
+static uint32_t packed_name_hash(const char *name, size_t name_len)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    size_t index;
+
+    for (index = 0; index < name_len; index++)
+    {
+        hash ^= (unsigned char)name[index];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+static size_t packed_record_size(size_t name_len, size_t data_len)
+{
+    size_t size = sizeof(PACKED_RECORD_HEADER) + name_len + data_len;
+    return (size + PACKED_RECORD_ALIGNMENT - 1) & ~((size_t)PACKED_RECORD_ALIGNMENT - 1);
+}
+
+//##############################################################################
+// File view helpers
+//##############################################################################
+static bool parse_record
+(
+    const HSM_PACKED_STORE *store,
+    size_t offset,
+    PACKED_RECORD_HEADER *header,
+    size_t *record_size
+)
+{
+    bool result;
+    size_t remaining;
+
+    if ((offset > store->view_size) ||
+        ((remaining = store->view_size - offset) < sizeof(PACKED_RECORD_HEADER)))
+    {
+        result = false;
+    }
+    else
+    {
+        memcpy(header, store->view + offset, sizeof(PACKED_RECORD_HEADER));
+        if ((header->magic != PACKED_RECORD_MAGIC) ||
+            (header->name_len == 0) ||
+            (header->name_len > PACKED_RECORD_MAX_FIELD) ||
+            (header->data_len > PACKED_RECORD_MAX_FIELD))
+        {
+            result = false;
+        }
+        else
+        {
+            size_t payload_end = sizeof(PACKED_RECORD_HEADER) + header->name_len + header->data_len;
+            *record_size = packed_record_size(header->name_len, header->data_len);
+            if (*record_size > remaining)
+            {
+                result = false;
+            }
+            else
+            {
+                const unsigned char *crc_start = store->view + offset + PACKED_RECORD_CRC_OFFSET;
+                result = (packed_crc32(0, crc_start, payload_end - PACKED_RECORD_CRC_OFFSET) == header->crc);
+            }
+        }
+    }
+
+    return result;
+}
+
+static const char* get_entry_name(const HSM_PACKED_STORE *store, const PACKED_ENTRY *entry, size_t *name_len)
+{
+    PACKED_RECORD_HEADER header;
+    memcpy(&header, store->view + entry->offset, sizeof(header));
+    *name_len = header.name_len;
+    return (const char*)(store->view + entry->offset + sizeof(header));
+}
+
+static PACKED_ENTRY* find_entry
+(
+    const HSM_PACKED_STORE *store,
+    uint16_t type,
+    const char *name,
+    size_t name_len,
+    uint32_t hash
+)
+{
+    PACKED_ENTRY *result = NULL;
+    size_t index;
+
+    // stores hold a handful of aliases so a scan of the hashes is sufficient
+    for (index = 0; index < store->num_entries; index++)
+    {
+        PACKED_ENTRY *entry = &store->entries[index];
+        if ((entry->hash == hash) && (entry->type == type))
+        {
+            size_t entry_name_len;
+            const char *entry_name = get_entry_name(store, entry, &entry_name_len);
+            if ((entry_name_len == name_len) && (memcmp(entry_name, name, name_len) == 0))
+            {
+                result = entry;
+                break;
+            }
+        }
+    }
+
+    return result;
+}
+
+static int apply_record(HSM_PACKED_STORE *store, size_t offset, const PACKED_RECORD_HEADER *header, size_t record_size)
+{
+    int result;
+    const char *name = (const char*)(store->view + offset + sizeof(PACKED_RECORD_HEADER));
+    uint32_t hash = packed_name_hash(name, header->name_len);
+    PACKED_ENTRY *entry = find_entry(store, header->type, name, header->name_len, hash);
+
+    if (header->flags & PACKED_RECORD_TOMBSTONE)
+    {
+        if (entry != NULL)
+        {
+            store->live_size -= entry->size;
+            *entry = store->entries[store->num_entries - 1];
+            store->num_entries--;
+        }
+        result = 0;
+    }
+    else if (entry != NULL)
+    {
+        store->live_size = store->live_size - entry->size + record_size;
+        entry->offset = offset;
+        entry->size = record_size;
+        result = 0;
+    }
+    else
+    {
+        if (store->num_entries == store->max_entries)
+        {
+            size_t new_max = (store->max_entries == 0) ? PACKED_MIN_ENTRIES : (2 * store->max_entries);
+            PACKED_ENTRY *new_entries = (PACKED_ENTRY*)realloc(store->entries, new_max * sizeof(PACKED_ENTRY));
+            if (new_entries == NULL)
+            {
+                LOG_ERROR("Could not allocate memory for packed store index");
+            }
+            else
+            {
+                store->entries = new_entries;
+                store->max_entries = new_max;
+            }
+        }
+
+        if (store->num_entries == store->max_entries)
+        {
+            result = __FAILURE__;
+        }
+        else
+        {
+            entry = &store->entries[store->num_entries++];
+            entry->hash = hash;
+            entry->type = header->type;
+            entry->offset = offset;
+            entry->size = record_size;
+            store->live_size += record_size;
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+static void unload_view(HSM_PACKED_STORE *store)
+{
+    if (store->view != NULL)
+    {
+        unmap_file(store->view, store->view_size);
+        store->view = NULL;
+    }
+    store->view_size = 0;
+    store->num_entries = 0;
+    store->live_size = 0;
+    store->valid_size = 0;
+    store->needs_compaction = false;
+}
+
+static int load_index(HSM_PACKED_STORE *store, const PACKED_HEADER *header)
+{
+    int result = 0;
+    size_t index_size = (size_t)header->index_count * sizeof(PACKED_INDEX_ENTRY);
+    uint32_t index;
+
+    if ((header->log_offset > store->view_size) ||
+        (index_size > header->log_offset - sizeof(PACKED_HEADER)) ||
+        (packed_crc32(0, store->view + sizeof(PACKED_HEADER), index_size) != header->index_crc))
+    {
+        LOG_ERROR("Packed store index is corrupt in %s", store->file_path);
+        result = __FAILURE__;
+    }
+
+    for (index = 0; (result == 0) && (index < header->index_count); index++)
+    {
+        PACKED_INDEX_ENTRY index_entry;
+        PACKED_RECORD_HEADER record;
+        size_t record_size;
+
+        memcpy(&index_entry, store->view + sizeof(PACKED_HEADER) + (index * sizeof(index_entry)), sizeof(index_entry));
+        if ((index_entry.offset < sizeof(PACKED_HEADER) + index_size) ||
+            (index_entry.offset >= header->log_offset) ||
+            !parse_record(store, (size_t)index_entry.offset, &record, &record_size) ||
+            (record_size != index_entry.size) ||
+            (record.flags & PACKED_RECORD_TOMBSTONE))
+        {
+            LOG_ERROR("Packed store record %u is corrupt in %s", index, store->file_path);
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = apply_record(store, (size_t)index_entry.offset, &record, record_size);
+        }
+    }
+
+    return result;
+}
+
+static int load_log(HSM_PACKED_STORE *store, size_t log_offset)
+{
+    int result = 0;
+    size_t offset = log_offset;
+    PACKED_RECORD_HEADER record;
+    size_t record_size;
+
+    while ((result == 0) && (offset < store->view_size))
+    {
+        if (!parse_record(store, offset, &record, &record_size))
+        {
+            // a write was interrupted, everything from here on is discarded
+            // and the file is rewritten before the next append
+            LOG_ERROR("Discarding %zu bytes of incomplete records in %s",
+                      store->view_size - offset, store->file_path);
+            store->needs_compaction = true;
+            break;
+        }
+        else if ((result = apply_record(store, offset, &record, record_size)) == 0)
+        {
+            offset += record_size;
+        }
+    }
+    store->valid_size = offset;
+
+    return result;
+}
+
+static int load_view(HSM_PACKED_STORE *store)
+{
+    int result;
+
+    HSM_FILE_STAMP stamp;
+
+    unload_view(store);
+    if (!is_file_valid(store->file_path) ||
+        ((get_file_stamp(store->file_path, &stamp) == 0) && (stamp.size == 0)))
+    {
+        // the file is created on the first write
+        result = 0;
+    }
+    // the store file is only replaced atomically or appended to after the
+    // view is unloaded, it is never truncated under a live mapping
+    else if ((store->view = (const unsigned char*)read_file_mapped(store->file_path, &store->view_size)) == NULL)
+    {
+        LOG_ERROR("Could not read packed store %s", store->file_path);
+        result = __FAILURE__;
+    }
+    else
+    {
+        PACKED_HEADER header;
+
+        if (store->view_size < sizeof(PACKED_HEADER))
+        {
+            LOG_ERROR("Packed store file is truncated %s", store->file_path);
+            result = __FAILURE__;
+        }
+        else
+        {
+            memcpy(&header, store->view, sizeof(header));
+            if ((memcmp(header.magic, PACKED_STORE_MAGIC, sizeof(PACKED_STORE_MAGIC)) != 0) ||
+                (packed_crc32(0, store->view, offsetof(PACKED_HEADER, header_crc)) != header.header_crc))
+            {
+                LOG_ERROR("Packed store header is corrupt in %s", store->file_path);
+                result = __FAILURE__;
+            }
+            else if (header.version != PACKED_STORE_VERSION)
+            {
+                LOG_ERROR("Unsupported packed store version %u in %s", header.version, store->file_path);
+                result = __FAILURE__;
+            }
+            else if (load_index(store, &header) != 0)
+            {
+                result = __FAILURE__;
+            }
+            else
+            {
+                result = load_log(store, (size_t)header.log_offset);
+            }
+        }
+
+        if (result != 0)
+        {
+            unload_view(store);
+        }
+    }
+
+    return result;
+}
+
+static void init_header(PACKED_HEADER *header, uint32_t index_count, size_t log_offset, uint32_t index_crc)
+{
+    memset(header, 0, sizeof(PACKED_HEADER));
+    memcpy(header->magic, PACKED_STORE_MAGIC, sizeof(PACKED_STORE_MAGIC));
+    header->version = PACKED_STORE_VERSION;
+    header->index_count = index_count;
+    header->log_offset = log_offset;
+    header->index_crc = index_crc;
+    header->header_crc = packed_crc32(0, (const unsigned char*)header, offsetof(PACKED_HEADER, header_crc));
+}
+
+//##############################################################################
+// Write helpers, all called with the store lock held exclusively
+//##############################################################################
+static int compact_locked(HSM_PACKED_STORE *store)
+{
+    int result;
+    size_t index_size = store->num_entries * sizeof(PACKED_INDEX_ENTRY);
+    size_t records_offset = sizeof(PACKED_HEADER) + index_size;
+    size_t file_size = records_offset + store->live_size;
+    unsigned char *buffer;
+
+    if ((buffer = (unsigned char*)calloc(1, file_size)) == NULL)
+    {
+        LOG_ERROR("Could not allocate memory to compact packed store");
+        result = __FAILURE__;
+    }
+    else
+    {
+        PACKED_HEADER header;
+        size_t offset = records_offset;
+        size_t index;
+
+        for (index = 0; index < store->num_entries; index++)
+        {
+            const PACKED_ENTRY *entry = &store->entries[index];
+            PACKED_INDEX_ENTRY index_entry;
+            index_entry.offset = offset;
+            index_entry.size = (uint32_t)entry->size;
+            index_entry.hash = entry->hash;
+            memcpy(buffer + sizeof(PACKED_HEADER) + (index * sizeof(index_entry)), &index_entry, sizeof(index_entry));
+            memcpy(buffer + offset, store->view + entry->offset, entry->size);
+            offset += entry->size;
+        }
+        init_header(&header, (uint32_t)store->num_entries, file_size,
+                    packed_crc32(0, buffer + sizeof(PACKED_HEADER), index_size));
+        memcpy(buffer, &header, sizeof(header));
+
+        // the view must be released before the file is replaced
+        unload_view(store);
+        if (write_buffer_to_file(store->temp_file_path, buffer, file_size, true) != 0)
+        {
+            LOG_ERROR("Could not write compacted packed store %s", store->temp_file_path);
+            result = __FAILURE__;
+        }
+        else if (replace_file(store->temp_file_path, store->file_path) != 0)
+        {
+            LOG_ERROR("Could not replace packed store %s", store->file_path);
+            (void)delete_file(store->temp_file_path);
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = 0;
+        }
+        free(buffer);
+
+        if (load_view(store) != 0)
+        {
+            result = __FAILURE__;
+        }
+    }
+
+    return result;
+}
+
+static int append_record_locked
+(
+    HSM_PACKED_STORE *store,
+    uint16_t type,
+    uint16_t flags,
+    const char *name,
+    const unsigned char *data,
+    size_t data_size
+)
+{
+    int result;
+    size_t name_len = strlen(name);
+    size_t record_size;
+    unsigned char *buffer;
+
+    if ((name_len > PACKED_RECORD_MAX_FIELD) ||
+        (data_size > PACKED_RECORD_MAX_FIELD))
+    {
+        LOG_ERROR("Packed store record too large for %s", name);
+        result = __FAILURE__;
+    }
+    else if (store->needs_compaction && (compact_locked(store) != 0))
+    {
+        LOG_ERROR("Could not recover packed store %s", store->file_path);
+        result = __FAILURE__;
+    }
+    else if ((buffer = (unsigned char*)calloc(1, (record_size = packed_record_size(name_len, data_size)))) == NULL)
+    {
+        LOG_ERROR("Could not allocate memory for packed store record");
+        result = __FAILURE__;
+    }
+    else
+    {
+        PACKED_RECORD_HEADER header;
+        unsigned char *payload = buffer + sizeof(header);
+
+        memcpy(payload, name, name_len);
+        if (data_size != 0)
+        {
+            memcpy(payload + name_len, data, data_size);
+        }
+        header.magic = PACKED_RECORD_MAGIC;
+        header.crc = 0;
+        header.type = type;
+        header.flags = flags;
+        header.name_len = (uint32_t)name_len;
+        header.data_len = (uint32_t)data_size;
+        memcpy(buffer, &header, sizeof(header));
+        header.crc = packed_crc32(0, buffer + PACKED_RECORD_CRC_OFFSET,
+                                  sizeof(header) + name_len + data_size - PACKED_RECORD_CRC_OFFSET);
+        memcpy(buffer, &header, sizeof(header));
+
+        if (store->view == NULL)
+        {
+            PACKED_HEADER file_header;
+            init_header(&file_header, 0, sizeof(PACKED_HEADER), packed_crc32(0, NULL, 0));
+            result = write_buffer_to_file(store->file_path, (const unsigned char*)&file_header, sizeof(file_header), true);
+        }
+        else
+        {
+            unload_view(store);
+            result = 0;
+        }
+
+        if ((result != 0) || (append_buffer_to_file(store->file_path, buffer, record_size, true) != 0))
+        {
+            LOG_ERROR("Could not append record to packed store %s", store->file_path);
+            result = __FAILURE__;
+        }
+        free(buffer);
+
+        if (load_view(store) != 0)
+        {
+            result = __FAILURE__;
+        }
+        else if ((result == 0) &&
+                 (store->valid_size >= PACKED_COMPACT_MIN_SIZE) &&
+                 (store->live_size < (store->valid_size / 2)) &&
+                 (compact_locked(store) != 0))
+        {
+            // the record was written, a failed compaction is retried on the next write
+            LOG_ERROR("Could not compact packed store %s", store->file_path);
+        }
+    }
+
+    return result;
+}
+
+static char* concat_path(const char *path, const char *ext)
+{
+    size_t path_len = strlen(path), ext_len = strlen(ext);
+    char *result;
+
+    if ((result = (char*)malloc(path_len + ext_len + 1)) != NULL)
+    {
+        memcpy(result, path, path_len);
+        memcpy(result + path_len, ext, ext_len + 1);
+    }
+
+    return result;
+}
+
+//##############################################################################
+// Packed store API
+//##############################################################################
+HSM_PACKED_STORE_HANDLE hsm_packed_store_open(const char *file_path)
+{
+    HSM_PACKED_STORE *result;
+
+    if ((file_path == NULL) || (strlen(file_path) == 0))
+    {
+        LOG_ERROR("Invalid file path parameter");
+        result = NULL;
+    }
+    else if ((result = (HSM_PACKED_STORE*)calloc(1, sizeof(HSM_PACKED_STORE))) == NULL)
+    {
+        LOG_ERROR("Could not allocate memory for packed store");
+    }
+    else if (((result->file_path = concat_path(file_path, "")) == NULL) ||
+             ((result->temp_file_path = concat_path(file_path, PACKED_TEMP_FILE_EXT)) == NULL))
+    {
+        LOG_ERROR("Could not allocate memory for packed store path");
+        free(result->file_path);
+        free(result);
+        result = NULL;
+    }
+    else if ((result->lock = hsm_rwlock_create()) == NULL)
+    {
+        LOG_ERROR("Could not create packed store lock");
+        free(result->temp_file_path);
+        free(result->file_path);
+        free(result);
+        result = NULL;
+    }
+    else if ((load_view(result) != 0) ||
+             (result->needs_compaction && (compact_locked(result) != 0)))
+    {
+        LOG_ERROR("Could not load packed store %s", file_path);
+        hsm_packed_store_close(result);
+        result = NULL;
+    }
+
+    return result;
+}
+
+void hsm_packed_store_close(HSM_PACKED_STORE_HANDLE handle)
+{
+    if (handle != NULL)
+    {
+        unload_view(handle);
+        free(handle->entries);
+        hsm_rwlock_destroy(handle->lock);
+        free(handle->temp_file_path);
+        free(handle->file_path);
+        free(handle);
+    }
+}
+
+int hsm_packed_store_get
+(
+    HSM_PACKED_STORE_HANDLE handle,
+    HSM_PACKED_RECORD_TYPE type,
+    const char *name,
+    HSM_PACKED_RECORD *record
+)
+{
+    int result;
+
+    if ((handle == NULL) || (name == NULL) || (strlen(name) == 0) || (record == NULL))
+    {
+        LOG_ERROR("Invalid parameters");
+        result = __FAILURE__;
+    }
+    else
+    {
+        size_t name_len = strlen(name);
+        const PACKED_ENTRY *entry;
+
+        hsm_rwlock_read_lock(handle->lock);
+        if ((entry = find_entry(handle, (uint16_t)type, name, name_len, packed_name_hash(name, name_len))) == NULL)
+        {
+            LOG_DEBUG("Record %s of type %d not found in packed store", name, (int)type);
+            hsm_rwlock_read_unlock(handle->lock);
+            result = __FAILURE__;
+        }
+        else
+        {
+            PACKED_RECORD_HEADER header;
+            const unsigned char *payload = handle->view + entry->offset + sizeof(header);
+
+            memcpy(&header, handle->view + entry->offset, sizeof(header));
+            record->data = payload + header.name_len;
+            record->data_size = header.data_len;
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+void hsm_packed_store_release(HSM_PACKED_STORE_HANDLE handle)
+{
+    if (handle != NULL)
+    {
+        hsm_rwlock_read_unlock(handle->lock);
+    }
+}
+
+int hsm_packed_store_put
+(
+    HSM_PACKED_STORE_HANDLE handle,
+    HSM_PACKED_RECORD_TYPE type,
+    const char *name,
+    const unsigned char *data,
+    size_t data_size
+)
+{
+    int result;
+
+    if ((handle == NULL) || (name == NULL) || (strlen(name) == 0) ||
+        (data == NULL) || (data_size == 0))
+    {
+        LOG_ERROR("Invalid parameters");
+        result = __FAILURE__;
+    }
+    else
+    {
+        hsm_rwlock_write_lock(handle->lock);
+        result = append_record_locked(handle, (uint16_t)type, 0, name, data, data_size);
+        hsm_rwlock_write_unlock(handle->lock);
+    }
+
+    return result;
+}
+
+int hsm_packed_store_import_file
+(
+    HSM_PACKED_STORE_HANDLE handle,
+    HSM_PACKED_RECORD_TYPE type,
+    const char *name,
+    const char *file_path
+)
+{
+    int result;
+    void *data;
+    size_t data_size = 0;
+
+    if ((handle == NULL) || (file_path == NULL))
+    {
+        LOG_ERROR("Invalid parameters");
+        result = __FAILURE__;
+    }
+    else if ((data = read_file_into_buffer(file_path, &data_size)) == NULL)
+    {
+        LOG_ERROR("Could not read file %s", file_path);
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = hsm_packed_store_put(handle, type, name, (const unsigned char*)data, data_size);
+        free(data);
+    }
+
+    return result;
+}
+
+int hsm_packed_store_remove
+(
+    HSM_PACKED_STORE_HANDLE handle,
+    HSM_PACKED_RECORD_TYPE type,
+    const char *name
+)
+{
+    int result;
+
+    if ((handle == NULL) || (name == NULL) || (strlen(name) == 0))
+    {
+        LOG_ERROR("Invalid parameters");
+        result = __FAILURE__;
+    }
+    else
+    {
+        size_t name_len = strlen(name);
+
+        hsm_rwlock_write_lock(handle->lock);
+        if (find_entry(handle, (uint16_t)type, name, name_len, packed_name_hash(name, name_len)) == NULL)
+        {
+            // nothing to remove
+            result = 0;
+        }
+        else
+        {
+            result = append_record_locked(handle, (uint16_t)type, PACKED_RECORD_TOMBSTONE, name, NULL, 0);
+        }
+        hsm_rwlock_write_unlock(handle->lock);
+    }
+
+    return result;
+}
+
+int hsm_packed_store_compact(HSM_PACKED_STORE_HANDLE handle)
+{
+    int result;
+
+    if (handle == NULL)
+    {
+        LOG_ERROR("Invalid handle parameter");
+        result = __FAILURE__;
+    }
+    else
+    {
+        hsm_rwlock_write_lock(handle->lock);
+        result = compact_locked(handle);
+        hsm_rwlock_write_unlock(handle->lock);
+    }
+
+    return result;
+}
@@ -0,0 +1,70 @@
+#ifndef HSM_PACKED_STORE_H
+#define HSM_PACKED_STORE_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Single file alternative to the enc_keys directory. Certificates and their
+ * keys are issued and verified from files by OpenSSL and stay in the certs
+ * and cert_keys directories.
+ *
+ * The file starts with a header and an index of the records written at the
+ * last compaction, followed by those records. Records written since are
+ * appended to the end of the file and supersede any earlier record of the
+ * same type and name; removals are appended as tombstones. Every record is
+ * checksummed, a torn record at the end of the file is discarded and the
+ * file is rewritten on open.
+ *
+ * Compaction writes the live records to a temporary file which atomically
+ * replaces the store file, so a crash leaves either the old or the new file.
+ *
+ * Record names are the normalized alias file names used by the directory
+ * layout which allows records to be migrated from existing files as is.
+ * The file uses the byte order of the host.
+ */
+typedef struct HSM_PACKED_STORE_TAG* HSM_PACKED_STORE_HANDLE;
+
+typedef enum HSM_PACKED_RECORD_TYPE_TAG
+{
+    HSM_PACKED_RECORD_ENC_KEY = 1
+} HSM_PACKED_RECORD_TYPE;
+
+/**
+ * A record as stored in the file, the data is not null terminated.
+ */
+typedef struct HSM_PACKED_RECORD_TAG
+{
+    const unsigned char *data;
+    size_t data_size;
+} HSM_PACKED_RECORD;
+
+/**
+ * Opens the store file, creating it on the first write if it does not exist.
+ * The file is read with a single open and mapped when large enough.
+ */
+extern HSM_PACKED_STORE_HANDLE hsm_packed_store_open(const char *file_path);
+extern void hsm_packed_store_close(HSM_PACKED_STORE_HANDLE handle);
+
+/**
+ * Looks up a record. On success the record points into the store mapping
+ * which is kept alive, with the store locked for reading, until
+ * hsm_packed_store_release is called. Nothing needs to be released when a
+ * lookup fails. Must not be called by a thread that is holding a record.
+ */
+extern int hsm_packed_store_get(HSM_PACKED_STORE_HANDLE handle, HSM_PACKED_RECORD_TYPE type, const char *name, HSM_PACKED_RECORD *record);
+extern void hsm_packed_store_release(HSM_PACKED_STORE_HANDLE handle);
+
+extern int hsm_packed_store_put(HSM_PACKED_STORE_HANDLE handle, HSM_PACKED_RECORD_TYPE type, const char *name, const unsigned char *data, size_t data_size);
+extern int hsm_packed_store_import_file(HSM_PACKED_STORE_HANDLE handle, HSM_PACKED_RECORD_TYPE type, const char *name, const char *file_path);
+extern int hsm_packed_store_remove(HSM_PACKED_STORE_HANDLE handle, HSM_PACKED_RECORD_TYPE type, const char *name);
+extern int hsm_packed_store_compact(HSM_PACKED_STORE_HANDLE handle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  //HSM_PACKED_STORE_H
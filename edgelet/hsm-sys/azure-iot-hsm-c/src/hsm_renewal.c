@@ -0,0 +1,163 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "azure_c_shared_utility/gballoc.h"
+#include "hsm_renewal.h"
+#include "hsm_lock.h"
+#include "hsm_log.h"
+
+//##############################################################################
+// Data types
+//##############################################################################
+// due_time and is_stopping are guarded by the mutex. The callback is run
+// with the mutex released so that scheduling never waits for a renewal.
+struct HSM_RENEWAL_TAG
+{
+    HSM_RENEWAL_RUN run;
+    void *context;
+    int64_t due_time;
+    bool is_stopping;
+    HSM_MUTEX_HANDLE mutex;
+    HSM_COND_HANDLE cond;
+    HSM_THREAD_HANDLE worker;
+};
+typedef struct HSM_RENEWAL_TAG HSM_RENEWAL;
+
+//##############################################################################
+// Worker
+//##############################################################################
+static void run_renewals(void *context)
+{
+    HSM_RENEWAL *renewal = (HSM_RENEWAL*)context;
+
+    hsm_mutex_lock(renewal->mutex);
+    while (!renewal->is_stopping)
+    {
+        int64_t now = (int64_t)time(NULL);
+        if (renewal->due_time == HSM_RENEWAL_NEVER)
+        {
+            hsm_cond_wait(renewal->cond, renewal->mutex);
+        }
+        else if (renewal->due_time > now)
+        {
+            hsm_cond_wait_until(renewal->cond, renewal->mutex, renewal->due_time);
+        }
+        else
+        {
+            int64_t next_due_time;
+
+            // anything scheduled while the callback runs is kept in due_time
+            renewal->due_time = HSM_RENEWAL_NEVER;
+            hsm_mutex_unlock(renewal->mutex);
+            next_due_time = renewal->run(renewal->context, now);
+            hsm_mutex_lock(renewal->mutex);
+
+            if (next_due_time < renewal->due_time)
+            {
+                renewal->due_time = next_due_time;
+            }
+        }
+    }
+    hsm_mutex_unlock(renewal->mutex);
+}
+
+static int start_worker(HSM_RENEWAL *renewal)
+{
+    int result;
+
+    if ((renewal->mutex = hsm_mutex_create()) == NULL)
+    {
+        LOG_ERROR("Could not create renewal mutex");
+        result = __FAILURE__;
+    }
+    else if ((renewal->cond = hsm_cond_create()) == NULL)
+    {
+        LOG_ERROR("Could not create renewal condition");
+        hsm_mutex_destroy(renewal->mutex);
+        result = __FAILURE__;
+    }
+    else if ((renewal->worker = hsm_thread_create(run_renewals, renewal)) == NULL)
+    {
+        LOG_ERROR("Could not create renewal thread");
+        hsm_cond_destroy(renewal->cond);
+        hsm_mutex_destroy(renewal->mutex);
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = 0;
+    }
+
+    return result;
+}
+
+static void stop_worker(HSM_RENEWAL *renewal)
+{
+    hsm_mutex_lock(renewal->mutex);
+    renewal->is_stopping = true;
+    hsm_cond_signal(renewal->cond);
+    hsm_mutex_unlock(renewal->mutex);
+
+    hsm_thread_join(renewal->worker);
+    hsm_cond_destroy(renewal->cond);
+    hsm_mutex_destroy(renewal->mutex);
+}
+
+//##############################################################################
+// Renewal API
+//##############################################################################
+HSM_RENEWAL_HANDLE hsm_renewal_create(HSM_RENEWAL_RUN run, void *context)
+{
+    HSM_RENEWAL *result;
+
+    if (run == NULL)
+    {
+        LOG_ERROR("Invalid renewal callback");
+        result = NULL;
+    }
+    else if ((result = (HSM_RENEWAL*)calloc(1, sizeof(HSM_RENEWAL))) == NULL)
+    {
+        LOG_ERROR("Could not allocate memory for renewal");
+    }
+    else
+    {
+        result->run = run;
+        result->context = context;
+        result->due_time = HSM_RENEWAL_NEVER;
+        if (start_worker(result) != 0)
+        {
+            free(result);
+            result = NULL;
+        }
+    }
+
+    return (HSM_RENEWAL_HANDLE)result;
+}
+
+void hsm_renewal_destroy(HSM_RENEWAL_HANDLE handle)
+{
+    if (handle != NULL)
+    {
+        stop_worker(handle);
+        free(handle);
+    }
+}
+
+void hsm_renewal_schedule(HSM_RENEWAL_HANDLE handle, int64_t due_time)
+{
+    if (handle == NULL)
+    {
+        LOG_ERROR("Invalid renewal handle");
+    }
+    else
+    {
+        hsm_mutex_lock(handle->mutex);
+        if (due_time < handle->due_time)
+        {
+            handle->due_time = due_time;
+            hsm_cond_signal(handle->cond);
+        }
+        hsm_mutex_unlock(handle->mutex);
+    }
+}
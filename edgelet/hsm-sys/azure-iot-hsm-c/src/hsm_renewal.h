@@ -0,0 +1,41 @@
+#ifndef HSM_RENEWAL_H
+#define HSM_RENEWAL_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Background thread that runs a renewal callback whenever it is due.
+ *
+ * The callback renews everything that is due at the time it is called and
+ * returns the time at which it is next due, or HSM_RENEWAL_NEVER when nothing
+ * is scheduled. hsm_renewal_schedule brings the next run forward, for example
+ * when a new item is tracked. Times are UTC seconds since the epoch.
+ */
+typedef struct HSM_RENEWAL_TAG* HSM_RENEWAL_HANDLE;
+
+typedef int64_t (*HSM_RENEWAL_RUN)(void *context, int64_t now);
+
+#define HSM_RENEWAL_NEVER INT64_MAX
+
+extern HSM_RENEWAL_HANDLE hsm_renewal_create(HSM_RENEWAL_RUN run, void *context);
+
+/**
+ * Stops the worker thread, waiting for a run in progress to complete.
+ */
+extern void hsm_renewal_destroy(HSM_RENEWAL_HANDLE handle);
+
+/**
+ * Schedules a run at due_time unless one is already scheduled earlier.
+ * Never blocks on a run in progress.
+ */
+extern void hsm_renewal_schedule(HSM_RENEWAL_HANDLE handle, int64_t due_time);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  //HSM_RENEWAL_H
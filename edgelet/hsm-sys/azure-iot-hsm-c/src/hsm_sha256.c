@@ -0,0 +1,334 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "azure_c_shared_utility/gballoc.h"
+#include "hsm_sha256.h"
+#include "hsm_utils.h"
+
+//##############################################################################
+// Helpers
+//##############################################################################
+static const uint32_t SHA256_INITIAL_STATE[8] =
+{
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+const uint32_t HSM_SHA256_K[64] =
+{
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static uint32_t load_be32(const unsigned char *bytes)
+{
+    return ((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16) |
+           ((uint32_t)bytes[2] << 8) | (uint32_t)bytes[3];
+}
+
+static void store_be32(unsigned char *bytes, uint32_t value)
+{
+    bytes[0] = (unsigned char)(value >> 24);
+    bytes[1] = (unsigned char)(value >> 16);
+    bytes[2] = (unsigned char)(value >> 8);
+    bytes[3] = (unsigned char)value;
+}
+
+static uint32_t rotate_right(uint32_t value, unsigned int count)
+{
+    return (value >> count) | (value << (32 - count));
+}
+
+//##############################################################################
+// Scalar kernel
+//##############################################################################
+static void compress_scalar(uint32_t state[8], const unsigned char *blocks, size_t block_count)
+{
+    uint32_t w[64];
+
+    while (block_count-- > 0)
+    {
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+        int t;
+
+        for (t = 0; t < 16; t++)
+        {
+            w[t] = load_be32(blocks + (4 * t));
+        }
+        for (t = 16; t < 64; t++)
+        {
+            uint32_t s0 = rotate_right(w[t - 15], 7) ^ rotate_right(w[t - 15], 18) ^ (w[t - 15] >> 3);
+            uint32_t s1 = rotate_right(w[t - 2], 17) ^ rotate_right(w[t - 2], 19) ^ (w[t - 2] >> 10);
+            w[t] = w[t - 16] + s0 + w[t - 7] + s1;
+        }
+        for (t = 0; t < 64; t++)
+        {
+            uint32_t s1 = rotate_right(e, 6) ^ rotate_right(e, 11) ^ rotate_right(e, 25);
+            uint32_t ch = (e & f) ^ (~e & g);
+            uint32_t temp1 = h + s1 + ch + HSM_SHA256_K[t] + w[t];
+            uint32_t s0 = rotate_right(a, 2) ^ rotate_right(a, 13) ^ rotate_right(a, 22);
+            uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+            uint32_t temp2 = s0 + maj;
+            h = g;
+            g = f;
+            f = e;
+            e = d + temp1;
+            d = c;
+            c = b;
+            b = a;
+            a = temp1 + temp2;
+        }
+
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+        state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+        blocks += HSM_SHA256_BLOCK_SIZE;
+    }
+    secure_zero(w, sizeof(w));
+}
+
+static const HSM_SHA256_BACKEND scalar_backend =
+{
+    "scalar",
+    compress_scalar,
+    NULL
+};
+
+const HSM_SHA256_BACKEND* hsm_sha256_scalar_backend(void)
+{
+    return &scalar_backend;
+}
+
+//##############################################################################
+// Kernel selection
+//##############################################################################
+static const HSM_SHA256_BACKEND *g_backend_override = NULL;
+
+// SHA extensions outrun the multi-buffer kernel, which is only used on CPUs
+// that cannot accelerate single messages.
+static void get_kernels(HSM_SHA256_COMPRESS *compress, HSM_SHA256_COMPRESS_LANES *compress_lanes)
+{
+    const HSM_SHA256_BACKEND *backend;
+
+    if ((backend = g_backend_override) != NULL)
+    {
+        *compress = (backend->compress != NULL) ? backend->compress : compress_scalar;
+        *compress_lanes = backend->compress_lanes;
+    }
+    else if (((backend = hsm_sha256_shani_backend()) != NULL) ||
+             ((backend = hsm_sha256_armv8_backend()) != NULL))
+    {
+        *compress = backend->compress;
+        *compress_lanes = NULL;
+    }
+    else
+    {
+        *compress = compress_scalar;
+        *compress_lanes = ((backend = hsm_sha256_avx2_backend()) != NULL) ? backend->compress_lanes : NULL;
+    }
+}
+
+void hsm_sha256_use_backend(const HSM_SHA256_BACKEND *backend)
+{
+    g_backend_override = backend;
+}
+
+//##############################################################################
+// Message padding
+//##############################################################################
+// A message is hashed as its full data blocks followed by one or two tail
+// blocks holding the remaining data, the padding and the bit length.
+typedef struct SHA256_LANE_TAG
+{
+    HSM_SHA256_STATE state;
+    const unsigned char *data;
+    size_t full_blocks;
+    size_t block_count;
+    unsigned char tail[2 * HSM_SHA256_BLOCK_SIZE];
+} SHA256_LANE;
+
+static void lane_init(SHA256_LANE *lane, const HSM_SHA256_MESSAGE *message)
+{
+    size_t tail_size = message->data_size % HSM_SHA256_BLOCK_SIZE;
+    size_t tail_blocks = ((tail_size + 9) > HSM_SHA256_BLOCK_SIZE) ? 2 : 1;
+    uint64_t bit_length = (message->prefix_size + message->data_size) * 8;
+    unsigned char *length = lane->tail + (tail_blocks * HSM_SHA256_BLOCK_SIZE) - 8;
+
+    if (message->state == NULL)
+    {
+        hsm_sha256_init_state(&lane->state);
+    }
+    else
+    {
+        lane->state = *message->state;
+    }
+    lane->data = message->data;
+    lane->full_blocks = message->data_size / HSM_SHA256_BLOCK_SIZE;
+    lane->block_count = lane->full_blocks + tail_blocks;
+
+    memset(lane->tail, 0, sizeof(lane->tail));
+    if (tail_size > 0)
+    {
+        memcpy(lane->tail, message->data + (lane->full_blocks * HSM_SHA256_BLOCK_SIZE), tail_size);
+    }
+    lane->tail[tail_size] = 0x80;
+    store_be32(length, (uint32_t)(bit_length >> 32));
+    store_be32(length + 4, (uint32_t)bit_length);
+}
+
+static const unsigned char* lane_block(const SHA256_LANE *lane, size_t index)
+{
+    return (index < lane->full_blocks) ?
+        lane->data + (index * HSM_SHA256_BLOCK_SIZE) :
+        lane->tail + ((index - lane->full_blocks) * HSM_SHA256_BLOCK_SIZE);
+}
+
+static void lane_digest(const SHA256_LANE *lane, unsigned char *digest)
+{
+    int index;
+
+    for (index = 0; index < 8; index++)
+    {
+        store_be32(digest + (4 * index), lane->state.h[index]);
+    }
+}
+
+static void finish_one(HSM_SHA256_COMPRESS compress, const HSM_SHA256_MESSAGE *message)
+{
+    SHA256_LANE lane;
+
+    lane_init(&lane, message);
+    if (lane.full_blocks > 0)
+    {
+        compress(lane.state.h, lane.data, lane.full_blocks);
+    }
+    compress(lane.state.h, lane.tail, lane.block_count - lane.full_blocks);
+    lane_digest(&lane, message->digest);
+    secure_zero(&lane, sizeof(lane));
+}
+
+// Hashes up to HSM_SHA256_LANES messages side by side. Lanes whose message
+// is done, or that have no message, compress a dummy block into a scratch
+// state until the longest message is done.
+static void finish_lanes
+(
+    HSM_SHA256_COMPRESS_LANES compress_lanes,
+    const HSM_SHA256_MESSAGE *messages,
+    size_t count
+)
+{
+    static const unsigned char dummy_block[HSM_SHA256_BLOCK_SIZE] = { 0 };
+    SHA256_LANE lanes[HSM_SHA256_LANES];
+    HSM_SHA256_STATE scratch[HSM_SHA256_LANES];
+    size_t max_blocks = 0;
+    size_t block;
+    size_t index;
+
+    // idle lanes chain through scratch, so it must hold defined words
+    // before the first compression reads it
+    memset(scratch, 0, sizeof(scratch));
+    for (index = 0; index < count; index++)
+    {
+        lane_init(&lanes[index], &messages[index]);
+        if (lanes[index].block_count > max_blocks)
+        {
+            max_blocks = lanes[index].block_count;
+        }
+    }
+
+    for (block = 0; block < max_blocks; block++)
+    {
+        uint32_t *states[HSM_SHA256_LANES];
+        const unsigned char *blocks[HSM_SHA256_LANES];
+
+        for (index = 0; index < HSM_SHA256_LANES; index++)
+        {
+            if ((index < count) && (block < lanes[index].block_count))
+            {
+                states[index] = lanes[index].state.h;
+                blocks[index] = lane_block(&lanes[index], block);
+            }
+            else
+            {
+                states[index] = scratch[index].h;
+                blocks[index] = dummy_block;
+            }
+        }
+        compress_lanes(states, blocks);
+    }
+
+    for (index = 0; index < count; index++)
+    {
+        lane_digest(&lanes[index], messages[index].digest);
+    }
+    secure_zero(lanes, sizeof(lanes));
+    secure_zero(scratch, sizeof(scratch));
+}
+
+//##############################################################################
+// SHA-256 API
+//##############################################################################
+void hsm_sha256_init_state(HSM_SHA256_STATE *state)
+{
+    memcpy(state->h, SHA256_INITIAL_STATE, sizeof(state->h));
+}
+
+void hsm_sha256_compress(HSM_SHA256_STATE *state, const unsigned char *blocks, size_t block_count)
+{
+    HSM_SHA256_COMPRESS compress;
+    HSM_SHA256_COMPRESS_LANES compress_lanes;
+
+    get_kernels(&compress, &compress_lanes);
+    if (block_count > 0)
+    {
+        compress(state->h, blocks, block_count);
+    }
+}
+
+void hsm_sha256_finish(const HSM_SHA256_MESSAGE *messages, size_t count)
+{
+    HSM_SHA256_COMPRESS compress;
+    HSM_SHA256_COMPRESS_LANES compress_lanes;
+    size_t index = 0;
+
+    get_kernels(&compress, &compress_lanes);
+    while (index < count)
+    {
+        size_t remaining = count - index;
+        if ((compress_lanes != NULL) && (remaining > 1))
+        {
+            size_t lane_count = (remaining > HSM_SHA256_LANES) ? HSM_SHA256_LANES : remaining;
+            finish_lanes(compress_lanes, &messages[index], lane_count);
+            index += lane_count;
+        }
+        else
+        {
+            finish_one(compress, &messages[index]);
+            index++;
+        }
+    }
+}
+
+void hsm_sha256_digest
+(
+    const unsigned char *data,
+    size_t data_size,
+    unsigned char digest[HSM_SHA256_DIGEST_SIZE]
+)
+{
+    HSM_SHA256_MESSAGE message;
+
+    message.state = NULL;
+    message.prefix_size = 0;
+    message.data = data;
+    message.data_size = data_size;
+    message.digest = digest;
+    hsm_sha256_finish(&message, 1);
+}
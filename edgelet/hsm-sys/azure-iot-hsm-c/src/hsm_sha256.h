@@ -0,0 +1,112 @@
+#ifndef HSM_SHA256_H
+#define HSM_SHA256_H
+
+#ifdef __cplusplus
+#include <cstddef>
+#include <cstdint>
+extern "C" {
+#else
+#include <stddef.h>
+#include <stdint.h>
+#endif
+
+#define HSM_SHA256_DIGEST_SIZE 32
+#define HSM_SHA256_BLOCK_SIZE 64
+// number of independent messages hashed by one multi-buffer kernel call
+#define HSM_SHA256_LANES 8
+
+typedef struct HSM_SHA256_STATE_TAG
+{
+    uint32_t h[8];
+} HSM_SHA256_STATE;
+
+/**
+ * Compresses block_count consecutive 64 byte blocks into state.
+ */
+typedef void (*HSM_SHA256_COMPRESS)(uint32_t state[8],
+                                    const unsigned char *blocks,
+                                    size_t block_count);
+
+/**
+ * Compresses blocks[i] into states[i] for each of the HSM_SHA256_LANES lanes.
+ * The lanes are independent, a state may not be passed in two lanes.
+ */
+typedef void (*HSM_SHA256_COMPRESS_LANES)(uint32_t *states[HSM_SHA256_LANES],
+                                          const unsigned char *blocks[HSM_SHA256_LANES]);
+
+/**
+ * A set of SHA-256 compression kernels. A backend has a single message
+ * kernel, a multi-buffer kernel or both, the missing ones are NULL.
+ */
+typedef struct HSM_SHA256_BACKEND_TAG
+{
+    const char *name;
+    HSM_SHA256_COMPRESS compress;
+    HSM_SHA256_COMPRESS_LANES compress_lanes;
+} HSM_SHA256_BACKEND;
+
+/**
+ * A message whose hash is finished by hsm_sha256_finish.
+ *
+ * The hash continues from state, after prefix_size bytes that have already
+ * been compressed into it, or starts from the SHA-256 initial state when
+ * state is NULL. digest must hold HSM_SHA256_DIGEST_SIZE bytes.
+ */
+typedef struct HSM_SHA256_MESSAGE_TAG
+{
+    const HSM_SHA256_STATE *state;
+    uint64_t prefix_size;
+    const unsigned char *data;
+    size_t data_size;
+    unsigned char *digest;
+} HSM_SHA256_MESSAGE;
+
+extern void hsm_sha256_init_state(HSM_SHA256_STATE *state);
+
+extern void hsm_sha256_compress(HSM_SHA256_STATE *state,
+                                const unsigned char *blocks,
+                                size_t block_count);
+
+/**
+ * Pads and hashes the remaining data of every message. Independent messages
+ * are hashed side by side when the CPU has a multi-buffer kernel.
+ */
+extern void hsm_sha256_finish(const HSM_SHA256_MESSAGE *messages, size_t count);
+
+extern void hsm_sha256_digest(const unsigned char *data,
+                              size_t data_size,
+                              unsigned char digest[HSM_SHA256_DIGEST_SIZE]);
+
+//##############################################################################
+// Backends
+//##############################################################################
+// round constants, shared by the kernels
+extern const uint32_t HSM_SHA256_K[64];
+
+/**
+ * Portable C kernel, this is the reference the other kernels are tested
+ * against and is used when the CPU has no SHA-256 acceleration.
+ */
+extern const HSM_SHA256_BACKEND* hsm_sha256_scalar_backend(void);
+
+/**
+ * The accelerated backends return NULL when the library was built without
+ * them or when the CPU does not support them.
+ */
+extern const HSM_SHA256_BACKEND* hsm_sha256_shani_backend(void);
+extern const HSM_SHA256_BACKEND* hsm_sha256_avx2_backend(void);
+extern const HSM_SHA256_BACKEND* hsm_sha256_armv8_backend(void);
+
+/**
+ * Replaces the kernels picked for the CPU on first use by the kernels of
+ * backend, the scalar kernel stands in for a missing single message kernel.
+ * Passing NULL restores the kernels picked for the CPU. This is meant for
+ * tests and must not be called while other threads are hashing.
+ */
+extern void hsm_sha256_use_backend(const HSM_SHA256_BACKEND *backend);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  //HSM_SHA256_H
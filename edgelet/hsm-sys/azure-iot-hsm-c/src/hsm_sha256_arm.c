@@ -0,0 +1,117 @@
+#include <stdlib.h>
+
+#include "azure_c_shared_utility/gballoc.h"
+#include "hsm_lock.h"
+#include "hsm_sha256.h"
+
+// The SHA-2 instructions are optional in ARMv8-A. Builds that already target
+// them use the kernel directly, GCC builds for the baseline compile the
+// kernel with a target attribute and check the CPU at run time.
+#if defined __aarch64__ && defined __linux__ && (defined __ARM_FEATURE_SHA2 || defined __ARM_FEATURE_CRYPTO)
+#define HSM_SHA256_ARMV8
+#define TARGET_ARMV8
+#elif defined __aarch64__ && defined __linux__ && defined __GNUC__ && !defined __clang__ && (__GNUC__ >= 6)
+#define HSM_SHA256_ARMV8
+#define TARGET_ARMV8 __attribute__((target("+crypto")))
+#endif
+
+#if defined HSM_SHA256_ARMV8
+
+#include <arm_neon.h>
+#include <sys/auxv.h>
+
+#ifndef HWCAP_SHA2
+#define HWCAP_SHA2 (1 << 6)
+#endif
+
+// support is probed once, 0 until probed, 1 if supported and -1 if not
+#define CPU_FEATURE_UNKNOWN 0
+#define CPU_FEATURE_PRESENT 1
+#define CPU_FEATURE_ABSENT -1
+
+//##############################################################################
+// CPU detection
+//##############################################################################
+static int cpu_supports_sha2(void)
+{
+    return ((getauxval(AT_HWCAP) & HWCAP_SHA2) != 0);
+}
+
+//##############################################################################
+// ARMv8 SHA-2 kernel
+//##############################################################################
+// Each vector carries four message words, sha256h and sha256h2 run four
+// rounds on the state split as ABCD and EFGH.
+TARGET_ARMV8
+static void compress_armv8(uint32_t state[8], const unsigned char *blocks, size_t block_count)
+{
+    uint32x4_t state0 = vld1q_u32(&state[0]);
+    uint32x4_t state1 = vld1q_u32(&state[4]);
+
+    while (block_count-- > 0)
+    {
+        const uint32x4_t abcd_save = state0;
+        const uint32x4_t efgh_save = state1;
+        uint32x4_t msg[4];
+        int group;
+
+        // group i holds message words 4i to 4i + 3, only the last four
+        // groups are kept for the schedule
+        for (group = 0; group < 16; group++)
+        {
+            uint32x4_t words, tmp, abcd;
+            if (group < 4)
+            {
+                words = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(blocks + (16 * group))));
+            }
+            else
+            {
+                words = vsha256su0q_u32(msg[group & 3], msg[(group + 1) & 3]);
+                words = vsha256su1q_u32(words, msg[(group + 2) & 3], msg[(group + 3) & 3]);
+            }
+            msg[group & 3] = words;
+
+            tmp = vaddq_u32(words, vld1q_u32(&HSM_SHA256_K[4 * group]));
+            abcd = state0;
+            state0 = vsha256hq_u32(state0, state1, tmp);
+            state1 = vsha256h2q_u32(state1, abcd, tmp);
+        }
+
+        state0 = vaddq_u32(state0, abcd_save);
+        state1 = vaddq_u32(state1, efgh_save);
+        blocks += HSM_SHA256_BLOCK_SIZE;
+    }
+
+    vst1q_u32(&state[0], state0);
+    vst1q_u32(&state[4], state1);
+}
+
+static const HSM_SHA256_BACKEND armv8_backend =
+{
+    "armv8",
+    compress_armv8,
+    NULL
+};
+
+#endif //HSM_SHA256_ARMV8
+
+//##############################################################################
+// Backend API
+//##############################################################################
+const HSM_SHA256_BACKEND* hsm_sha256_armv8_backend(void)
+{
+#if defined HSM_SHA256_ARMV8
+    static volatile long sha2_supported = CPU_FEATURE_UNKNOWN;
+    long value = hsm_atomic_load(&sha2_supported);
+
+    if (value == CPU_FEATURE_UNKNOWN)
+    {
+        value = cpu_supports_sha2() ? CPU_FEATURE_PRESENT : CPU_FEATURE_ABSENT;
+        hsm_atomic_store(&sha2_supported, value);
+    }
+
+    return (value == CPU_FEATURE_PRESENT) ? &armv8_backend : NULL;
+#else
+    return NULL;
+#endif
+}
@@ -0,0 +1,302 @@
+#include <stdlib.h>
+
+#include "azure_c_shared_utility/gballoc.h"
+#include "hsm_lock.h"
+#include "hsm_sha256.h"
+
+// The kernels are compiled with per function target attributes so the rest
+// of the library keeps the baseline instruction set, they only run after the
+// CPU has been checked for the extensions they use.
+#if defined __GNUC__ && (defined __x86_64__ || defined __i386__)
+#define HSM_SHA256_X86
+
+#include <cpuid.h>
+#include <immintrin.h>
+
+#define TARGET_SHANI __attribute__((target("sha,sse4.1")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+
+#define CPUID1_ECX_SSSE3 (1u << 9)
+#define CPUID1_ECX_SSE41 (1u << 19)
+#define CPUID1_ECX_OSXSAVE (1u << 27)
+#define CPUID1_ECX_AVX (1u << 28)
+#define CPUID7_EBX_AVX2 (1u << 5)
+#define CPUID7_EBX_SHA (1u << 29)
+#define XCR0_SSE_AVX 0x6
+
+// support is probed once, 0 until probed, 1 if supported and -1 if not
+#define CPU_FEATURE_UNKNOWN 0
+#define CPU_FEATURE_PRESENT 1
+#define CPU_FEATURE_ABSENT -1
+
+//##############################################################################
+// CPU detection
+//##############################################################################
+static void read_cpuid(unsigned int leaf, unsigned int regs[4])
+{
+    regs[0] = regs[1] = regs[2] = regs[3] = 0;
+    if (__get_cpuid_max(0, NULL) >= leaf)
+    {
+        __cpuid_count(leaf, 0, regs[0], regs[1], regs[2], regs[3]);
+    }
+}
+
+// the OS must save the YMM registers on context switch for AVX2 to be usable
+static int os_saves_avx_state(void)
+{
+    unsigned int eax, edx;
+    __asm__ volatile ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    (void)edx;
+    return ((eax & XCR0_SSE_AVX) == XCR0_SSE_AVX);
+}
+
+static int cpu_supports_shani(void)
+{
+    unsigned int leaf1[4], leaf7[4];
+
+    read_cpuid(1, leaf1);
+    read_cpuid(7, leaf7);
+    return ((leaf1[2] & CPUID1_ECX_SSSE3) != 0) &&
+           ((leaf1[2] & CPUID1_ECX_SSE41) != 0) &&
+           ((leaf7[1] & CPUID7_EBX_SHA) != 0);
+}
+
+static int cpu_supports_avx2(void)
+{
+    unsigned int leaf1[4], leaf7[4];
+
+    read_cpuid(1, leaf1);
+    read_cpuid(7, leaf7);
+    return ((leaf1[2] & CPUID1_ECX_OSXSAVE) != 0) &&
+           ((leaf1[2] & CPUID1_ECX_AVX) != 0) &&
+           ((leaf7[1] & CPUID7_EBX_AVX2) != 0) &&
+           os_saves_avx_state();
+}
+
+static int probe_feature(volatile long *feature, int (*detect)(void))
+{
+    long value = hsm_atomic_load(feature);
+
+    if (value == CPU_FEATURE_UNKNOWN)
+    {
+        value = detect() ? CPU_FEATURE_PRESENT : CPU_FEATURE_ABSENT;
+        hsm_atomic_store(feature, value);
+    }
+
+    return (value == CPU_FEATURE_PRESENT);
+}
+
+//##############################################################################
+// SHA extensions kernel
+//##############################################################################
+// Each 128 bit vector carries four message words, sha256rnds2 runs two
+// rounds on the state split as ABEF and CDGH.
+TARGET_SHANI
+static void compress_shani(uint32_t state[8], const unsigned char *blocks, size_t block_count)
+{
+    const __m128i byte_swap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    __m128i state0, state1, tmp;
+
+    tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[0]), 0xB1);
+    state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[4]), 0x1B);
+    state0 = _mm_alignr_epi8(tmp, state1, 8);
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+    while (block_count-- > 0)
+    {
+        const __m128i abef_save = state0;
+        const __m128i cdgh_save = state1;
+        __m128i msg[4];
+        int group;
+
+        // group i holds message words 4i to 4i + 3, only the last four
+        // groups are kept for the schedule
+        for (group = 0; group < 16; group++)
+        {
+            __m128i words;
+            if (group < 4)
+            {
+                words = _mm_loadu_si128((const __m128i*)(blocks + (16 * group)));
+                words = _mm_shuffle_epi8(words, byte_swap);
+            }
+            else
+            {
+                words = _mm_sha256msg1_epu32(msg[group & 3], msg[(group + 1) & 3]);
+                words = _mm_add_epi32(words, _mm_alignr_epi8(msg[(group + 3) & 3], msg[(group + 2) & 3], 4));
+                words = _mm_sha256msg2_epu32(words, msg[(group + 3) & 3]);
+            }
+            msg[group & 3] = words;
+
+            tmp = _mm_add_epi32(words, _mm_loadu_si128((const __m128i*)&HSM_SHA256_K[4 * group]));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, tmp);
+            tmp = _mm_shuffle_epi32(tmp, 0x0E);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, tmp);
+        }
+
+        state0 = _mm_add_epi32(state0, abef_save);
+        state1 = _mm_add_epi32(state1, cdgh_save);
+        blocks += HSM_SHA256_BLOCK_SIZE;
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1B);
+    state1 = _mm_shuffle_epi32(state1, 0xB1);
+    state0 = _mm_blend_epi16(tmp, state1, 0xF0);
+    state1 = _mm_alignr_epi8(state1, tmp, 8);
+    _mm_storeu_si128((__m128i*)&state[0], state0);
+    _mm_storeu_si128((__m128i*)&state[4], state1);
+}
+
+static const HSM_SHA256_BACKEND shani_backend =
+{
+    "shani",
+    compress_shani,
+    NULL
+};
+
+//##############################################################################
+// AVX2 multi-buffer kernel
+//##############################################################################
+// Element i of every vector belongs to lane i, so the eight lanes run the
+// scalar rounds in lockstep.
+TARGET_AVX2
+static inline __m256i rotr_lanes(__m256i value, int count)
+{
+    return _mm256_or_si256(_mm256_srli_epi32(value, count), _mm256_slli_epi32(value, 32 - count));
+}
+
+// turns eight rows of eight words into eight columns
+TARGET_AVX2
+static inline void transpose_lanes(__m256i rows[8])
+{
+    __m256i t0 = _mm256_unpacklo_epi32(rows[0], rows[1]);
+    __m256i t1 = _mm256_unpackhi_epi32(rows[0], rows[1]);
+    __m256i t2 = _mm256_unpacklo_epi32(rows[2], rows[3]);
+    __m256i t3 = _mm256_unpackhi_epi32(rows[2], rows[3]);
+    __m256i t4 = _mm256_unpacklo_epi32(rows[4], rows[5]);
+    __m256i t5 = _mm256_unpackhi_epi32(rows[4], rows[5]);
+    __m256i t6 = _mm256_unpacklo_epi32(rows[6], rows[7]);
+    __m256i t7 = _mm256_unpackhi_epi32(rows[6], rows[7]);
+    __m256i u0 = _mm256_unpacklo_epi64(t0, t2);
+    __m256i u1 = _mm256_unpackhi_epi64(t0, t2);
+    __m256i u2 = _mm256_unpacklo_epi64(t1, t3);
+    __m256i u3 = _mm256_unpackhi_epi64(t1, t3);
+    __m256i u4 = _mm256_unpacklo_epi64(t4, t6);
+    __m256i u5 = _mm256_unpackhi_epi64(t4, t6);
+    __m256i u6 = _mm256_unpacklo_epi64(t5, t7);
+    __m256i u7 = _mm256_unpackhi_epi64(t5, t7);
+
+    rows[0] = _mm256_permute2x128_si256(u0, u4, 0x20);
+    rows[1] = _mm256_permute2x128_si256(u1, u5, 0x20);
+    rows[2] = _mm256_permute2x128_si256(u2, u6, 0x20);
+    rows[3] = _mm256_permute2x128_si256(u3, u7, 0x20);
+    rows[4] = _mm256_permute2x128_si256(u0, u4, 0x31);
+    rows[5] = _mm256_permute2x128_si256(u1, u5, 0x31);
+    rows[6] = _mm256_permute2x128_si256(u2, u6, 0x31);
+    rows[7] = _mm256_permute2x128_si256(u3, u7, 0x31);
+}
+
+TARGET_AVX2
+static void compress_lanes_avx2
+(
+    uint32_t *states[HSM_SHA256_LANES],
+    const unsigned char *blocks[HSM_SHA256_LANES]
+)
+{
+    const __m256i byte_swap = _mm256_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3,
+                                              12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+    __m256i s[8], w[16];
+    __m256i a, b, c, d, e, f, g, h;
+    int lane, half, t;
+
+    for (lane = 0; lane < HSM_SHA256_LANES; lane++)
+    {
+        s[lane] = _mm256_loadu_si256((const __m256i*)states[lane]);
+    }
+    transpose_lanes(s);
+
+    for (half = 0; half < 2; half++)
+    {
+        __m256i *words = &w[8 * half];
+        for (lane = 0; lane < HSM_SHA256_LANES; lane++)
+        {
+            words[lane] = _mm256_loadu_si256((const __m256i*)(blocks[lane] + (32 * half)));
+            words[lane] = _mm256_shuffle_epi8(words[lane], byte_swap);
+        }
+        transpose_lanes(words);
+    }
+
+    a = s[0]; b = s[1]; c = s[2]; d = s[3];
+    e = s[4]; f = s[5]; g = s[6]; h = s[7];
+    for (t = 0; t < 64; t++)
+    {
+        __m256i s0, s1, ch, maj, temp1, temp2;
+
+        // the schedule is kept as a rolling window of sixteen words
+        if (t >= 16)
+        {
+            __m256i w15 = w[(t - 15) & 15];
+            __m256i w2 = w[(t - 2) & 15];
+            s0 = _mm256_xor_si256(_mm256_xor_si256(rotr_lanes(w15, 7), rotr_lanes(w15, 18)), _mm256_srli_epi32(w15, 3));
+            s1 = _mm256_xor_si256(_mm256_xor_si256(rotr_lanes(w2, 17), rotr_lanes(w2, 19)), _mm256_srli_epi32(w2, 10));
+            w[t & 15] = _mm256_add_epi32(_mm256_add_epi32(w[t & 15], s0), _mm256_add_epi32(w[(t - 7) & 15], s1));
+        }
+
+        s1 = _mm256_xor_si256(_mm256_xor_si256(rotr_lanes(e, 6), rotr_lanes(e, 11)), rotr_lanes(e, 25));
+        ch = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+        temp1 = _mm256_add_epi32(_mm256_add_epi32(h, s1), ch);
+        temp1 = _mm256_add_epi32(temp1, _mm256_add_epi32(_mm256_set1_epi32((int)HSM_SHA256_K[t]), w[t & 15]));
+        s0 = _mm256_xor_si256(_mm256_xor_si256(rotr_lanes(a, 2), rotr_lanes(a, 13)), rotr_lanes(a, 22));
+        maj = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_or_si256(a, b)));
+        temp2 = _mm256_add_epi32(s0, maj);
+        h = g;
+        g = f;
+        f = e;
+        e = _mm256_add_epi32(d, temp1);
+        d = c;
+        c = b;
+        b = a;
+        a = _mm256_add_epi32(temp1, temp2);
+    }
+
+    s[0] = _mm256_add_epi32(s[0], a); s[1] = _mm256_add_epi32(s[1], b);
+    s[2] = _mm256_add_epi32(s[2], c); s[3] = _mm256_add_epi32(s[3], d);
+    s[4] = _mm256_add_epi32(s[4], e); s[5] = _mm256_add_epi32(s[5], f);
+    s[6] = _mm256_add_epi32(s[6], g); s[7] = _mm256_add_epi32(s[7], h);
+    transpose_lanes(s);
+    for (lane = 0; lane < HSM_SHA256_LANES; lane++)
+    {
+        _mm256_storeu_si256((__m256i*)states[lane], s[lane]);
+    }
+}
+
+static const HSM_SHA256_BACKEND avx2_backend =
+{
+    "avx2",
+    NULL,
+    compress_lanes_avx2
+};
+
+#endif //HSM_SHA256_X86
+
+//##############################################################################
+// Backend API
+//##############################################################################
+const HSM_SHA256_BACKEND* hsm_sha256_shani_backend(void)
+{
+#if defined HSM_SHA256_X86
+    static volatile long shani_supported = CPU_FEATURE_UNKNOWN;
+    return probe_feature(&shani_supported, cpu_supports_shani) ? &shani_backend : NULL;
+#else
+    return NULL;
+#endif
+}
+
+const HSM_SHA256_BACKEND* hsm_sha256_avx2_backend(void)
+{
+#if defined HSM_SHA256_X86
+    static volatile long avx2_supported = CPU_FEATURE_UNKNOWN;
+    return probe_feature(&avx2_supported, cpu_supports_avx2) ? &avx2_backend : NULL;
+#else
+    return NULL;
+#endif
+}
@@ -0,0 +1,383 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "azure_c_shared_utility/gballoc.h"
+#include "hsm_constants.h"
+#include "hsm_lock.h"
+#include "hsm_log.h"
+#include "hsm_sha256.h"
+#include "hsm_sign_cache.h"
+#include "hsm_utils.h"
+
+//##############################################################################
+// Data types
+//##############################################################################
+// number of entries a payload may be cached in
+#define SIGN_CACHE_WAYS 4
+// an epoch time in seconds fits in 18 digits for the foreseeable future and
+// the value cannot overflow
+#define SIGN_CACHE_MAX_EXPIRY_DIGITS 18
+
+typedef struct SIGN_CACHE_KEY_TAG
+{
+    unsigned char identity_hash[HSM_SHA256_DIGEST_SIZE];
+    unsigned char data_hash[HSM_SHA256_DIGEST_SIZE];
+    bool is_derived;
+} SIGN_CACHE_KEY;
+
+// an entry is free when digest_size is 0
+typedef struct SIGN_CACHE_ENTRY_TAG
+{
+    SIGN_CACHE_KEY key;
+    unsigned char digest[HSM_SIGN_CACHE_MAX_DIGEST_SIZE];
+    size_t digest_size;
+    time_t expiry;
+    volatile long last_used;
+} SIGN_CACHE_ENTRY;
+
+// The entries are guarded by the lock. Lookups only take it shared, the
+// recency of entries and the counters are updated atomically instead. The
+// counters may wrap, for use_count that only changes which entry is evicted.
+struct HSM_SIGN_CACHE_TAG
+{
+    uint32_t ttl_seconds;
+    HSM_SIGN_CACHE_CLOCK clock;
+    HSM_RWLOCK_HANDLE lock;
+    SIGN_CACHE_ENTRY *entries;
+    size_t num_sets;
+    volatile long generation;
+    volatile long use_count;
+    volatile long hits;
+    volatile long misses;
+};
+typedef struct HSM_SIGN_CACHE_TAG HSM_SIGN_CACHE;
+
+//##############################################################################
+// Helpers
+//##############################################################################
+static time_t get_time(const HSM_SIGN_CACHE *cache)
+{
+    return (cache->clock != NULL) ? cache->clock() : time(NULL);
+}
+
+static void compute_key
+(
+    const unsigned char *identity,
+    size_t identity_size,
+    const unsigned char *data,
+    size_t data_size,
+    SIGN_CACHE_KEY *key
+)
+{
+    memset(key, 0, sizeof(*key));
+    if (identity != NULL)
+    {
+        hsm_sha256_digest(identity, identity_size, key->identity_hash);
+        key->is_derived = true;
+    }
+    hsm_sha256_digest(data, data_size, key->data_hash);
+}
+
+static bool key_matches(const SIGN_CACHE_KEY *lhs, const SIGN_CACHE_KEY *rhs)
+{
+    return (lhs->is_derived == rhs->is_derived) &&
+           (memcmp(lhs->identity_hash, rhs->identity_hash, sizeof(lhs->identity_hash)) == 0) &&
+           (memcmp(lhs->data_hash, rhs->data_hash, sizeof(lhs->data_hash)) == 0);
+}
+
+static SIGN_CACHE_ENTRY* get_set(HSM_SIGN_CACHE *cache, const SIGN_CACHE_KEY *key)
+{
+    size_t index, value = 0;
+
+    // the digests are uniformly distributed, any of their bytes will do
+    for (index = 0; index < sizeof(size_t); index++)
+    {
+        value = (value << 8) | (size_t)(key->data_hash[index] ^ key->identity_hash[index]);
+    }
+    return &cache->entries[(value % cache->num_sets) * SIGN_CACHE_WAYS];
+}
+
+// free and expired entries are replaced before the least recently used one
+static unsigned long get_eviction_rank(SIGN_CACHE_ENTRY *entry, time_t now)
+{
+    return ((entry->digest_size == 0) || (now >= entry->expiry)) ?
+           0 : (unsigned long)hsm_atomic_load(&entry->last_used);
+}
+
+// SAS strings to sign end with a newline followed by the token expiry
+static bool get_payload_expiry(const unsigned char *data, size_t data_size, uint64_t *expiry)
+{
+    bool result = false;
+    size_t num_digits = 0;
+
+    while ((num_digits < data_size) && (num_digits <= SIGN_CACHE_MAX_EXPIRY_DIGITS) &&
+           (data[data_size - num_digits - 1] >= '0') && (data[data_size - num_digits - 1] <= '9'))
+    {
+        num_digits++;
+    }
+
+    if ((num_digits != 0) && (num_digits <= SIGN_CACHE_MAX_EXPIRY_DIGITS) &&
+        (num_digits < data_size) && (data[data_size - num_digits - 1] == '\n'))
+    {
+        size_t index;
+        *expiry = 0;
+        for (index = data_size - num_digits; index < data_size; index++)
+        {
+            *expiry = (*expiry * 10) + (uint64_t)(data[index] - '0');
+        }
+        result = true;
+    }
+
+    return result;
+}
+
+static bool parse_env_value(const char *env_name, unsigned long max_value, unsigned long *value)
+{
+    bool result = false;
+    char *env_value = NULL;
+
+    if (hsm_get_env(env_name, &env_value) != 0)
+    {
+        LOG_ERROR("Could not lookup env variable %s", env_name);
+    }
+    else if (env_value != NULL)
+    {
+        char *end = NULL;
+        unsigned long parsed = strtoul(env_value, &end, 10);
+        if ((end == env_value) || (*end != 0) || (parsed > max_value))
+        {
+            LOG_ERROR("Invalid value %s for env variable %s, expected 0 to %lu",
+                      env_value, env_name, max_value);
+        }
+        else
+        {
+            *value = parsed;
+            result = true;
+        }
+        free(env_value);
+    }
+
+    return result;
+}
+
+//##############################################################################
+// Sign cache API
+//##############################################################################
+HSM_SIGN_CACHE_HANDLE hsm_sign_cache_create(size_t cache_size, uint32_t ttl_seconds, HSM_SIGN_CACHE_CLOCK clock)
+{
+    HSM_SIGN_CACHE *result;
+
+    if ((cache_size == 0) || (cache_size > HSM_SIGN_CACHE_MAX_SIZE))
+    {
+        LOG_ERROR("Invalid sign cache size %zu, expected 1 to %d", cache_size, HSM_SIGN_CACHE_MAX_SIZE);
+        result = NULL;
+    }
+    else if ((ttl_seconds == 0) || (ttl_seconds > HSM_SIGN_CACHE_MAX_TTL))
+    {
+        LOG_ERROR("Invalid sign cache TTL %u, expected 1 to %d", (unsigned int)ttl_seconds, HSM_SIGN_CACHE_MAX_TTL);
+        result = NULL;
+    }
+    else if ((result = (HSM_SIGN_CACHE*)calloc(1, sizeof(HSM_SIGN_CACHE))) == NULL)
+    {
+        LOG_ERROR("Could not allocate memory for sign cache");
+    }
+    else
+    {
+        result->ttl_seconds = ttl_seconds;
+        result->clock = clock;
+        result->num_sets = (cache_size + SIGN_CACHE_WAYS - 1) / SIGN_CACHE_WAYS;
+        if ((result->entries = (SIGN_CACHE_ENTRY*)calloc(result->num_sets * SIGN_CACHE_WAYS, sizeof(SIGN_CACHE_ENTRY))) == NULL)
+        {
+            LOG_ERROR("Could not allocate memory for sign cache entries");
+            free(result);
+            result = NULL;
+        }
+        else if ((result->lock = hsm_rwlock_create()) == NULL)
+        {
+            LOG_ERROR("Could not create sign cache lock");
+            free(result->entries);
+            free(result);
+            result = NULL;
+        }
+    }
+
+    return result;
+}
+
+HSM_SIGN_CACHE_HANDLE hsm_sign_cache_create_from_env(void)
+{
+    HSM_SIGN_CACHE_HANDLE result = NULL;
+    unsigned long cache_size = 0;
+
+    if (parse_env_value(ENV_HSM_SIGN_CACHE_SIZE, HSM_SIGN_CACHE_MAX_SIZE, &cache_size) && (cache_size != 0))
+    {
+        unsigned long ttl_seconds = HSM_SIGN_CACHE_DEFAULT_TTL;
+        if (parse_env_value(ENV_HSM_SIGN_CACHE_TTL, HSM_SIGN_CACHE_MAX_TTL, &ttl_seconds) && (ttl_seconds == 0))
+        {
+            LOG_ERROR("Sign cache TTL of 0 is invalid, using %d seconds", HSM_SIGN_CACHE_DEFAULT_TTL);
+            ttl_seconds = HSM_SIGN_CACHE_DEFAULT_TTL;
+        }
+        if ((result = hsm_sign_cache_create((size_t)cache_size, (uint32_t)ttl_seconds, NULL)) == NULL)
+        {
+            LOG_ERROR("Could not create sign cache, signatures will not be cached");
+        }
+    }
+
+    return result;
+}
+
+void hsm_sign_cache_destroy(HSM_SIGN_CACHE_HANDLE handle)
+{
+    if (handle != NULL)
+    {
+        secure_zero(handle->entries, handle->num_sets * SIGN_CACHE_WAYS * sizeof(SIGN_CACHE_ENTRY));
+        free(handle->entries);
+        hsm_rwlock_destroy(handle->lock);
+        free(handle);
+    }
+}
+
+bool hsm_sign_cache_lookup
+(
+    HSM_SIGN_CACHE_HANDLE handle,
+    const unsigned char *identity,
+    size_t identity_size,
+    const unsigned char *data,
+    size_t data_size,
+    unsigned char *digest,
+    size_t *digest_size
+)
+{
+    bool result = false;
+
+    if ((handle == NULL) || (data == NULL) || (digest == NULL) || (digest_size == NULL))
+    {
+        LOG_ERROR("Invalid sign cache lookup parameters");
+    }
+    else
+    {
+        SIGN_CACHE_KEY key;
+        SIGN_CACHE_ENTRY *set;
+        time_t now = get_time(handle);
+        size_t way;
+
+        // hash before taking the lock so that it is only held for the copy
+        compute_key(identity, identity_size, data, data_size, &key);
+        hsm_rwlock_read_lock(handle->lock);
+        set = get_set(handle, &key);
+        for (way = 0; way < SIGN_CACHE_WAYS; way++)
+        {
+            SIGN_CACHE_ENTRY *entry = &set[way];
+            if ((entry->digest_size != 0) && (now < entry->expiry) &&
+                (entry->digest_size <= *digest_size) && key_matches(&entry->key, &key))
+            {
+                memcpy(digest, entry->digest, entry->digest_size);
+                *digest_size = entry->digest_size;
+                hsm_atomic_store(&entry->last_used, hsm_atomic_increment(&handle->use_count));
+                result = true;
+                break;
+            }
+        }
+        hsm_rwlock_read_unlock(handle->lock);
+        (void)hsm_atomic_increment(result ? &handle->hits : &handle->misses);
+    }
+
+    return result;
+}
+
+uint64_t hsm_sign_cache_get_generation(HSM_SIGN_CACHE_HANDLE handle)
+{
+    uint64_t result = 0;
+
+    if (handle != NULL)
+    {
+        result = (uint64_t)(unsigned long)hsm_atomic_load(&handle->generation);
+    }
+
+    return result;
+}
+
+void hsm_sign_cache_insert
+(
+    HSM_SIGN_CACHE_HANDLE handle,
+    uint64_t generation,
+    const unsigned char *identity,
+    size_t identity_size,
+    const unsigned char *data,
+    size_t data_size,
+    const unsigned char *digest,
+    size_t digest_size
+)
+{
+    if ((handle == NULL) || (data == NULL) || (digest == NULL) ||
+        (digest_size == 0) || (digest_size > HSM_SIGN_CACHE_MAX_DIGEST_SIZE))
+    {
+        LOG_ERROR("Invalid sign cache insert parameters");
+    }
+    else
+    {
+        time_t now = get_time(handle);
+        uint64_t expiry = (uint64_t)now + handle->ttl_seconds;
+        uint64_t payload_expiry;
+
+        if (get_payload_expiry(data, data_size, &payload_expiry) && (payload_expiry < expiry))
+        {
+            expiry = payload_expiry;
+        }
+
+        // signatures of tokens that have already expired are not worth keeping
+        if ((now >= 0) && (expiry > (uint64_t)now))
+        {
+            SIGN_CACHE_KEY key;
+            SIGN_CACHE_ENTRY *set, *victim;
+            size_t way;
+
+            compute_key(identity, identity_size, data, data_size, &key);
+            hsm_rwlock_write_lock(handle->lock);
+            if (generation == (uint64_t)(unsigned long)hsm_atomic_load(&handle->generation))
+            {
+                set = get_set(handle, &key);
+                victim = &set[0];
+                for (way = 0; way < SIGN_CACHE_WAYS; way++)
+                {
+                    SIGN_CACHE_ENTRY *entry = &set[way];
+                    if ((entry->digest_size != 0) && key_matches(&entry->key, &key))
+                    {
+                        victim = entry;
+                        break;
+                    }
+                    else if (get_eviction_rank(entry, now) < get_eviction_rank(victim, now))
+                    {
+                        victim = entry;
+                    }
+                }
+                victim->key = key;
+                memcpy(victim->digest, digest, digest_size);
+                victim->digest_size = digest_size;
+                victim->expiry = (time_t)expiry;
+                hsm_atomic_store(&victim->last_used, hsm_atomic_increment(&handle->use_count));
+            }
+            hsm_rwlock_write_unlock(handle->lock);
+        }
+    }
+}
+
+void hsm_sign_cache_clear(HSM_SIGN_CACHE_HANDLE handle)
+{
+    if (handle != NULL)
+    {
+        hsm_rwlock_write_lock(handle->lock);
+        secure_zero(handle->entries, handle->num_sets * SIGN_CACHE_WAYS * sizeof(SIGN_CACHE_ENTRY));
+        (void)hsm_atomic_increment(&handle->generation);
+        hsm_rwlock_write_unlock(handle->lock);
+    }
+}
+
+void hsm_sign_cache_get_metrics(HSM_SIGN_CACHE_HANDLE handle, HSM_SIGN_CACHE_METRICS *metrics)
+{
+    if ((handle != NULL) && (metrics != NULL))
+    {
+        metrics->hits = (uint64_t)(unsigned long)hsm_atomic_load(&handle->hits);
+        metrics->misses = (uint64_t)(unsigned long)hsm_atomic_load(&handle->misses);
+    }
+}
@@ -0,0 +1,103 @@
+#ifndef HSM_SIGN_CACHE_H
+#define HSM_SIGN_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Bounded cache of identity key signatures.
+ *
+ * Entries are keyed by the SHA-256 digests of the derivation identity, if
+ * any, and of the signed payload, so neither is kept in memory. A payload
+ * ending in a newline followed by a decimal epoch time, as SAS strings to
+ * sign do, is only cached until that time and never past the cache TTL.
+ * Payloads that have already expired are not cached.
+ *
+ * The cache is set associative, inserting into a full set replaces its least
+ * recently used entry. Cached signatures are only valid for the identity key
+ * they were computed with, owners clear the cache whenever that key changes.
+ *
+ * Only the TPM device backend uses the cache, signing there is a round trip
+ * to the TPM while the in memory backend signs faster than it could hash the
+ * payload for a lookup.
+ */
+typedef struct HSM_SIGN_CACHE_TAG* HSM_SIGN_CACHE_HANDLE;
+
+/**
+ * Returns the current time in seconds since the epoch, time() is used when
+ * the cache is created without a clock.
+ */
+typedef time_t (*HSM_SIGN_CACHE_CLOCK)(void);
+
+typedef struct HSM_SIGN_CACHE_METRICS_TAG
+{
+    uint64_t hits;
+    uint64_t misses;
+} HSM_SIGN_CACHE_METRICS;
+
+// Upper bound for the number of cached signatures
+#define HSM_SIGN_CACHE_MAX_SIZE 4096
+// Largest signature that is cached
+#define HSM_SIGN_CACHE_MAX_DIGEST_SIZE 64
+// TTL used when none is configured, in seconds
+#define HSM_SIGN_CACHE_DEFAULT_TTL 300
+#define HSM_SIGN_CACHE_MAX_TTL 86400
+
+MOCKABLE_FUNCTION(, HSM_SIGN_CACHE_HANDLE, hsm_sign_cache_create, size_t, cache_size, uint32_t, ttl_seconds, HSM_SIGN_CACHE_CLOCK, clock);
+
+/**
+ * Creates a cache configured by IOTEDGE_HSM_SIGN_CACHE_SIZE and
+ * IOTEDGE_HSM_SIGN_CACHE_TTL_SECS. Returns NULL when the cache is disabled,
+ * which is the default, or could not be created.
+ */
+MOCKABLE_FUNCTION(, HSM_SIGN_CACHE_HANDLE, hsm_sign_cache_create_from_env);
+
+/**
+ * Zeroizes and frees all entries.
+ */
+MOCKABLE_FUNCTION(, void, hsm_sign_cache_destroy, HSM_SIGN_CACHE_HANDLE, handle);
+
+/**
+ * Copies the cached signature into digest when there is one that has not
+ * expired. On input digest_size holds the size of digest, a signature that
+ * does not fit is treated as a miss. identity is NULL for signatures made
+ * with the identity key itself.
+ */
+MOCKABLE_FUNCTION(, bool, hsm_sign_cache_lookup, HSM_SIGN_CACHE_HANDLE, handle,
+                  const unsigned char*, identity, size_t, identity_size,
+                  const unsigned char*, data, size_t, data_size,
+                  unsigned char*, digest, size_t*, digest_size);
+
+/**
+ * Returns the number of times the cache has been cleared. Owners read it
+ * before computing a signature and pass it to hsm_sign_cache_insert, which
+ * drops the signature if the cache was cleared in between so that one
+ * computed with a replaced key is never cached.
+ */
+MOCKABLE_FUNCTION(, uint64_t, hsm_sign_cache_get_generation, HSM_SIGN_CACHE_HANDLE, handle);
+
+MOCKABLE_FUNCTION(, void, hsm_sign_cache_insert, HSM_SIGN_CACHE_HANDLE, handle, uint64_t, generation,
+                  const unsigned char*, identity, size_t, identity_size,
+                  const unsigned char*, data, size_t, data_size,
+                  const unsigned char*, digest, size_t, digest_size);
+
+/**
+ * Drops every entry, used when the identity key is replaced.
+ */
+MOCKABLE_FUNCTION(, void, hsm_sign_cache_clear, HSM_SIGN_CACHE_HANDLE, handle);
+
+MOCKABLE_FUNCTION(, void, hsm_sign_cache_get_metrics, HSM_SIGN_CACHE_HANDLE, handle, HSM_SIGN_CACHE_METRICS*, metrics);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  //HSM_SIGN_CACHE_H
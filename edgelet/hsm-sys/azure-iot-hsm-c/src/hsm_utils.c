@@ -1,3 +1,10 @@
+#if !(defined __WINDOWS__ || defined _WIN32 || defined _WIN64 || defined _Windows)
+    // MAP_ANONYMOUS is not visible in strict C99 builds
+    #if !defined _DEFAULT_SOURCE
+        #define _DEFAULT_SOURCE
+    #endif
+#endif
+
 #include <fcntl.h>
 #include <limits.h>
 #include <stddef.h>
@@ -15,8 +22,13 @@
 #define HSM_UTIL_EMPTY 2
 #define HSM_UTIL_UNSUPPORTED 3
 
+// files smaller than this are read rather than mapped by read_file_mapped,
+// for small files a read is cheaper than setting up and faulting in a mapping
+#define HSM_UTIL_MAP_MIN_SIZE (64 * 1024)
+
 #if defined __WINDOWS__ || defined _WIN32 || defined _WIN64 || defined _Windows
     #include <direct.h>
+    #include <io.h>
     #include <intsafe.h>
     #include <windows.h>
     #if !defined S_ISDIR
@@ -25,8 +37,13 @@
     #define HSM_MKDIR(dir_path) _mkdir(dir_path)
 #else
     #include <unistd.h>
+    #include <sys/mman.h>
     #include <sys/types.h>
 
+    #if !defined MAP_ANONYMOUS && defined MAP_ANON
+        #define MAP_ANONYMOUS MAP_ANON
+    #endif
+
     #ifndef SSIZE_MAX
         #define SSIZE_MAX INT_MAX
     #endif
@@ -68,169 +85,204 @@ static int create_file_handle_for_reading(const char *file_name, HANDLE *handle)
 }
 #endif
 
-static int read_file_into_buffer_impl
+#if defined __WINDOWS__ || defined _WIN32 || defined _WIN64 || defined _Windows
+typedef HANDLE HSM_FILE_HANDLE;
+#else
+typedef int HSM_FILE_HANDLE;
+#endif
+
+static int open_file_for_reading
 (
     const char *file_name,
-    void  *output_buffer,
-    size_t output_buffer_size,
-    size_t *file_size_in_bytes
+    HSM_FILE_HANDLE *handle,
+    size_t *file_size
 )
 {
-
     int result;
 
 #if defined __WINDOWS__ || defined _WIN32 || defined _WIN64 || defined _Windows
+    LARGE_INTEGER size;
 
-    HANDLE file_handle;
-    LARGE_INTEGER file_size;
-
-    if (file_size_in_bytes != NULL)
+    if (create_file_handle_for_reading(file_name, handle) != 0)
     {
-        *file_size_in_bytes = 0;
+        result = HSM_UTIL_ERROR;
+    }
+    else if (!GetFileSizeEx(*handle, &size))
+    {
+        LOG_ERROR("Could not get file size for %s. GetLastError=%08x", file_name, GetLastError());
+        CloseHandle(*handle);
+        result = HSM_UTIL_ERROR;
     }
+    else if ((size.QuadPart < 0) || ((unsigned long long)size.QuadPart > (unsigned long long)SIZE_MAX))
+    {
+        LOG_ERROR("File size invalid for %s", file_name);
+        CloseHandle(*handle);
+        result = HSM_UTIL_ERROR;
+    }
+    else
+    {
+        *file_size = (size_t)size.QuadPart;
+        result = HSM_UTIL_SUCCESS;
+    }
+#else
+    struct stat stbuf;
 
-    if (create_file_handle_for_reading(file_name, &file_handle) != 0)
+    if ((*handle = open(file_name, O_RDONLY)) == -1)
+    {
+        LOG_ERROR("Could not open file for reading %s. Errno %d '%s'", file_name, errno, err_to_str());
+        result = HSM_UTIL_ERROR;
+    }
+    else if (fstat(*handle, &stbuf) != 0)
     {
+        LOG_ERROR("fstat returned error for file %s. Errno %d '%s'", file_name, errno, err_to_str());
+        close(*handle);
+        result = HSM_UTIL_ERROR;
+    }
+    else if (!S_ISREG(stbuf.st_mode))
+    {
+        LOG_ERROR("File %s is not a regular file.", file_name);
+        close(*handle);
+        result = HSM_UTIL_ERROR;
+    }
+    else if (stbuf.st_size < 0)
+    {
+        LOG_ERROR("File size invalid for %s", file_name);
+        close(*handle);
         result = HSM_UTIL_ERROR;
     }
     else
     {
-        if (!GetFileSizeEx(file_handle, &file_size))
+        *file_size = (size_t)stbuf.st_size;
+        result = HSM_UTIL_SUCCESS;
+    }
+#endif
+
+    return result;
+}
+
+/**
+ * Reads at most num_bytes from the file into buffer, retrying short reads.
+ * On success num_bytes_read holds the number of bytes read which is smaller
+ * than num_bytes only when the end of file was reached.
+ */
+static int read_file_handle
+(
+    const char *file_name,
+    HSM_FILE_HANDLE handle,
+    char *buffer,
+    size_t num_bytes,
+    size_t *num_bytes_read
+)
+{
+    int result = HSM_UTIL_SUCCESS;
+    size_t offset = 0;
+
+    while ((result == HSM_UTIL_SUCCESS) && (offset < num_bytes))
+    {
+        size_t remaining = num_bytes - offset;
+#if defined __WINDOWS__ || defined _WIN32 || defined _WIN64 || defined _Windows
+        DWORD chunk_read = 0;
+        DWORD chunk = (remaining > MAXDWORD) ? MAXDWORD : (DWORD)remaining;
+        if (!ReadFile(handle, buffer + offset, chunk, &chunk_read, NULL))
         {
-            LOG_ERROR("Could not get file size for %s. GetLastError=%08x", file_name, GetLastError());
+            LOG_ERROR("File read failed for file %s. GetLastError=%08x", file_name, GetLastError());
             result = HSM_UTIL_ERROR;
         }
-        else if (file_size.QuadPart == 0)
-        {
-            LOG_ERROR("File size found to be zero for %s", file_name);
-            result = HSM_UTIL_EMPTY;
-        }
-        else
+#else
+        ssize_t chunk_read;
+        size_t chunk = (remaining > SSIZE_MAX) ? SSIZE_MAX : remaining;
+        if ((chunk_read = read(handle, buffer + offset, chunk)) < 0)
         {
-            DWORD file_size_converted = 0;
-
-            if (ULongLongToDWord(file_size.QuadPart, &file_size_converted) != S_OK)
+            if (errno != EINTR)
             {
-                LOG_ERROR("File size too large, overflow detected for %s", file_name);
+                LOG_ERROR("File read failed for file %s. Errno %d '%s'", file_name, errno, err_to_str());
                 result = HSM_UTIL_ERROR;
             }
-            else
-            {
-                if (file_size_in_bytes != NULL)
-                {
-                    *file_size_in_bytes = file_size_converted;
-                }
-                if (output_buffer != NULL)
-                {
-                    DWORD num_bytes_read = 0;
-                    DWORD num_bytes_to_read = (output_buffer_size < (size_t)file_size_converted) ?
-                                               (DWORD)output_buffer_size :
-                                               file_size_converted;
-                    BOOL read_res = ReadFile(file_handle,
-                                             output_buffer,
-                                             num_bytes_to_read,
-                                             &num_bytes_read,
-                                             NULL);
-                    if (!read_res)
-                    {
-                        LOG_ERROR("File read failed for file %s. GetLastError=%08x", file_name, GetLastError());
-                        result = HSM_UTIL_ERROR;
-                    }
-                    else
-                    {
-                        result = HSM_UTIL_SUCCESS;
-                    }
-                }
-                else
-                {
-                    result = HSM_UTIL_SUCCESS;
-                }
-            }
+            chunk_read = 0;
         }
-        CloseHandle(file_handle);
+#endif
+        else if (chunk_read == 0)
+        {
+            // end of file, the file was truncated after its size was obtained
+            break;
+        }
+        offset += (size_t)chunk_read;
     }
+    *num_bytes_read = offset;
 
+    return result;
+}
+
+static void close_file_handle(HSM_FILE_HANDLE handle)
+{
+#if defined __WINDOWS__ || defined _WIN32 || defined _WIN64 || defined _Windows
+    CloseHandle(handle);
 #else
+    close(handle);
+#endif
+}
 
-    int fd;
-    off_t file_size;
-    struct stat stbuf;
+static int read_file_into_buffer_impl
+(
+    const char *file_name,
+    void  *output_buffer,
+    size_t output_buffer_size,
+    size_t *file_size_in_bytes
+)
+{
+    int result;
+    HSM_FILE_HANDLE handle;
+    size_t file_size = 0;
 
     if (file_size_in_bytes != NULL)
     {
         *file_size_in_bytes = 0;
     }
 
-    if ((fd = open(file_name, O_RDONLY)) == -1)
+    if (open_file_for_reading(file_name, &handle, &file_size) != HSM_UTIL_SUCCESS)
     {
-        LOG_ERROR("Could not open file for reading %s. Errno %d '%s'", file_name, errno, err_to_str());
         result = HSM_UTIL_ERROR;
     }
     else
     {
-        if (fstat(fd, &stbuf) != 0)
+        if (file_size == 0)
         {
-            LOG_ERROR("fstat returned error for file %s. Errno %d '%s'", file_name, errno, err_to_str());
-            result = HSM_UTIL_ERROR;
-        }
-        else if (!S_ISREG(stbuf.st_mode))
-        {
-            LOG_ERROR("File %s is not a regular file.", file_name);
-            result = HSM_UTIL_ERROR;
+            LOG_ERROR("File size found to be zero for %s", file_name);
+            result = HSM_UTIL_EMPTY;
         }
         else
         {
-            file_size = stbuf.st_size;
-            if (file_size < 0)
+            if (file_size_in_bytes != NULL)
             {
-                LOG_ERROR("File size invalid for %s", file_name);
-                result = HSM_UTIL_ERROR;
+                *file_size_in_bytes = file_size;
             }
-            else if (file_size == 0)
+            if (output_buffer != NULL)
             {
-                LOG_ERROR("File size found to be zero for %s", file_name);
-                result = HSM_UTIL_EMPTY;
-            }
-            else
-            {
-                if (file_size_in_bytes != NULL)
+                size_t num_bytes_read = 0;
+                size_t num_bytes_to_read = (output_buffer_size < file_size) ?
+                                            output_buffer_size :
+                                            file_size;
+                if (read_file_handle(file_name, handle, output_buffer, num_bytes_to_read, &num_bytes_read) != HSM_UTIL_SUCCESS)
                 {
-                    *file_size_in_bytes = file_size;
+                    result = HSM_UTIL_ERROR;
                 }
-                if (output_buffer != NULL)
+                else if (num_bytes_read != num_bytes_to_read)
                 {
-                    ssize_t num_bytes_read;
-                    size_t num_bytes_to_read = (output_buffer_size < (size_t)file_size) ?
-                                                output_buffer_size :
-                                                (size_t)file_size;
-                    if (num_bytes_to_read > SSIZE_MAX)
-                    {
-                        LOG_ERROR("Unsupported file read operation. File too large %s.", file_name);
-                        result = HSM_UTIL_ERROR;
-                    }
-                    else
-                    {
-                        num_bytes_read = read(fd, output_buffer, num_bytes_to_read);
-                        if (num_bytes_read < 0)
-                        {
-                            LOG_ERROR("File read failed for file %s. Errno %d '%s'", file_name, errno, err_to_str());
-                            result = HSM_UTIL_ERROR;
-                        }
-                        else
-                        {
-                            result = HSM_UTIL_SUCCESS;
-                        }
-                    }
+                    LOG_ERROR("File %s was truncated while being read", file_name);
+                    result = HSM_UTIL_ERROR;
                 }
                 else
                 {
                     result = HSM_UTIL_SUCCESS;
                 }
             }
+            else
+            {
+                result = HSM_UTIL_SUCCESS;
+            }
         }
-        close(fd);
+        close_file_handle(handle);
     }
-#endif
 
     return result;
 }
@@ -320,6 +372,157 @@ static int write_buffer_into_file
     return result;
 }
 
+//##############################################################################
+// Memory mapped file reads
+//##############################################################################
+static void* map_file_handle(const char *file_name, HSM_FILE_HANDLE handle, size_t file_size)
+{
+    void *result;
+
+#if defined __WINDOWS__ || defined _WIN32 || defined _WIN64 || defined _Windows
+    HANDLE mapping = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping == NULL)
+    {
+        LOG_DEBUG("Could not create file mapping for %s. GetLastError=%08x", file_name, GetLastError());
+        result = NULL;
+    }
+    else
+    {
+        // the view holds a reference to the mapping object
+        if ((result = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, file_size)) == NULL)
+        {
+            LOG_DEBUG("Could not map view of file %s. GetLastError=%08x", file_name, GetLastError());
+        }
+        CloseHandle(mapping);
+    }
+#else
+    if ((result = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, handle, 0)) == MAP_FAILED)
+    {
+        LOG_DEBUG("Could not map file %s. Errno %d '%s'", file_name, errno, err_to_str());
+        result = NULL;
+    }
+#endif
+
+    return result;
+}
+
+static void* alloc_mapped_buffer(size_t size)
+{
+    void *result;
+
+#if defined __WINDOWS__ || defined _WIN32 || defined _WIN64 || defined _Windows
+    result = VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#else
+    if ((result = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED)
+    {
+        result = NULL;
+    }
+#endif
+
+    return result;
+}
+
+static void free_mapped_buffer(void *buffer, size_t size)
+{
+#if defined __WINDOWS__ || defined _WIN32 || defined _WIN64 || defined _Windows
+    MEMORY_BASIC_INFORMATION info;
+    (void)size;
+    if ((VirtualQuery(buffer, &info, sizeof(info)) != 0) && (info.Type == MEM_MAPPED))
+    {
+        (void)UnmapViewOfFile(buffer);
+    }
+    else
+    {
+        (void)VirtualFree(buffer, 0, MEM_RELEASE);
+    }
+#else
+    (void)munmap(buffer, size);
+#endif
+}
+
+const void* read_file_mapped(const char* file_name, size_t *mapped_size)
+{
+    void *result;
+    HSM_FILE_HANDLE handle;
+    size_t file_size = 0;
+
+    if (mapped_size != NULL)
+    {
+        *mapped_size = 0;
+    }
+
+    if ((file_name == NULL) || (strlen(file_name) == 0) || (mapped_size == NULL))
+    {
+        LOG_ERROR("Invalid parameters");
+        result = NULL;
+    }
+    else if (open_file_for_reading(file_name, &handle, &file_size) != HSM_UTIL_SUCCESS)
+    {
+        result = NULL;
+    }
+    else
+    {
+        if (file_size == 0)
+        {
+            LOG_ERROR("File size found to be zero for %s", file_name);
+            result = NULL;
+        }
+        else if ((file_size >= HSM_UTIL_MAP_MIN_SIZE) &&
+                 ((result = map_file_handle(file_name, handle, file_size)) != NULL))
+        {
+            *mapped_size = file_size;
+        }
+        else
+        {
+            size_t num_bytes_read = 0;
+            bool use_heap = (file_size < HSM_UTIL_MAP_MIN_SIZE);
+
+            // the buffer kind is implied by the size which lets unmap_file
+            // release it without any additional bookkeeping
+            if ((result = (use_heap ? malloc(file_size) : alloc_mapped_buffer(file_size))) == NULL)
+            {
+                LOG_ERROR("Could not allocate memory to store the contents of the file %s", file_name);
+            }
+            else if ((read_file_handle(file_name, handle, result, file_size, &num_bytes_read) != HSM_UTIL_SUCCESS) ||
+                     (num_bytes_read != file_size))
+            {
+                LOG_ERROR("Could not read file into buffer: %s", file_name);
+                if (use_heap)
+                {
+                    free(result);
+                }
+                else
+                {
+                    free_mapped_buffer(result, file_size);
+                }
+                result = NULL;
+            }
+            else
+            {
+                *mapped_size = file_size;
+            }
+        }
+        close_file_handle(handle);
+    }
+
+    return result;
+}
+
+void unmap_file(const void* mapped_data, size_t mapped_size)
+{
+    if (mapped_data != NULL)
+    {
+        if (mapped_size < HSM_UTIL_MAP_MIN_SIZE)
+        {
+            free((void*)mapped_data);
+        }
+        else
+        {
+            free_mapped_buffer((void*)mapped_data, mapped_size);
+        }
+    }
+}
+
 void* read_file_into_buffer(const char* file_name, size_t *output_buffer_size)
 {
     void* result;
@@ -409,89 +612,107 @@ char* read_file_into_cstring(const char* file_name, size_t *output_buffer_size)
     return result;
 }
 
-char* concat_files_to_cstring(const char **file_names, int num_files)
+//##############################################################################
+// Single pass file concatenation
+//##############################################################################
+/**
+ * Appends the contents of file_name at offset *length of *buffer, growing
+ * the buffer geometrically as needed so that the total cost of appending N
+ * files is linear in the combined size. One byte is always kept available
+ * past the data for a null terminator.
+ */
+static int append_file_to_buffer
+(
+    const char *file_name,
+    char **buffer,
+    size_t *capacity,
+    size_t *length
+)
 {
-    char *result;
+    int result;
+    HSM_FILE_HANDLE handle;
+    size_t file_size = 0;
 
-    if ((file_names == NULL) || (num_files <= 0))
+    if ((result = open_file_for_reading(file_name, &handle, &file_size)) == HSM_UTIL_SUCCESS)
     {
-        LOG_ERROR("Invalid parameters");
-        result = NULL;
-    }
-    else
-    {
-        int index;
-        bool errors_found = false;
-        size_t accumulated_size = 0;
-        size_t accumulated_size_check;
+        size_t num_bytes_read;
 
-        for (index = 0; index < num_files; index++)
+        if (file_size > (SIZE_MAX - 1 - *length))
         {
-            size_t buffer_size;
-            int status = read_file_into_buffer_impl(file_names[index], NULL, 0, &buffer_size);
-            if (status == HSM_UTIL_ERROR)
+            LOG_ERROR("Concatenated file sizes too large");
+            result = HSM_UTIL_ERROR;
+        }
+        else if ((*length + file_size + 1) > *capacity)
+        {
+            size_t new_capacity = (*capacity > (SIZE_MAX / 2)) ? SIZE_MAX : (*capacity * 2);
+            char *new_buffer;
+            if (new_capacity < (*length + file_size + 1))
             {
-                errors_found = true;
-                break;
+                new_capacity = *length + file_size + 1;
             }
-            else if ((accumulated_size_check = accumulated_size + buffer_size) < accumulated_size)
+            if ((new_buffer = (char*)realloc(*buffer, new_capacity)) == NULL)
             {
-                LOG_ERROR("Concatenated file sizes too large");
-                errors_found = true;
-                break;
+                LOG_ERROR("Could not allocate memory to store the concatenated files");
+                result = HSM_UTIL_ERROR;
             }
             else
             {
-                accumulated_size = accumulated_size_check;
+                *buffer = new_buffer;
+                *capacity = new_capacity;
             }
         }
 
-        if (errors_found)
+        if (result != HSM_UTIL_SUCCESS)
         {
-            result = NULL;
+            // error already logged
+        }
+        else if (read_file_handle(file_name, handle, *buffer + *length, file_size, &num_bytes_read) != HSM_UTIL_SUCCESS)
+        {
+            result = HSM_UTIL_ERROR;
         }
         else
         {
-            // add one more for null term
-            accumulated_size_check = accumulated_size + 1;
-            if (accumulated_size_check < accumulated_size)
+            *length += num_bytes_read;
+        }
+        close_file_handle(handle);
+    }
+
+    return result;
+}
+
+char* concat_files_to_cstring(const char **file_names, int num_files)
+{
+    char *result;
+
+    if ((file_names == NULL) || (num_files <= 0))
+    {
+        LOG_ERROR("Invalid parameters");
+        result = NULL;
+    }
+    else
+    {
+        int index;
+        size_t capacity = 0;
+        size_t length = 0;
+
+        result = NULL;
+        for (index = 0; index < num_files; index++)
+        {
+            if (append_file_to_buffer(file_names[index], &result, &capacity, &length) != HSM_UTIL_SUCCESS)
             {
-                LOG_ERROR("Concatenated file sizes too large");
+                LOG_ERROR("Could not concatenate file %s", file_names[index]);
+                free(result);
                 result = NULL;
+                break;
             }
-            else
-            {
-                accumulated_size = accumulated_size_check;
-                if ((result = (char*)malloc(accumulated_size)) == NULL)
-                {
-                    LOG_ERROR("Could not allocate memory to store the concatenated files");
-                }
-                else
-                {
-                    bool concat_error = false;
-                    result[0] = 0;
-                    index = 0;
-                    while ((index < num_files) && (!concat_error))
-                    {
-                        char *temp_result = read_file_into_cstring(file_names[index], NULL);
-                        if (temp_result != NULL)
-                        {
-                            // todo optimize for inplace concat
-                            if (strcat_s(result, accumulated_size, temp_result) != 0)
-                            {
-                                LOG_ERROR("Error observed during concatenation");
-                                free(result);
-                                result = NULL;
-                                concat_error = true;
-                            }
-                            free(temp_result);
-                        }
-                        index++;
-                    }
-                }
-            }
+        }
+
+        if (result != NULL)
+        {
+            result[length] = 0;
         }
     }
+
     return result;
 }
 
@@ -527,6 +748,34 @@ bool is_directory_valid(const char* dir_path)
     return result;
 }
 
+int get_file_stamp(const char* file_name, HSM_FILE_STAMP* stamp)
+{
+    int result;
+    struct stat info;
+
+    if ((file_name == NULL) || (stamp == NULL))
+    {
+        LOG_ERROR("Invalid parameters");
+        result = __FAILURE__;
+    }
+    else if (stat(file_name, &info) != 0)
+    {
+        LOG_DEBUG("Could not stat file %s. Errno %d '%s'", file_name, errno, err_to_str());
+        result = __FAILURE__;
+    }
+    else
+    {
+        memset(stamp, 0, sizeof(HSM_FILE_STAMP));
+        stamp->device = (uint64_t)info.st_dev;
+        stamp->inode = (uint64_t)info.st_ino;
+        stamp->size = (uint64_t)info.st_size;
+        stamp->modified_time = (int64_t)info.st_mtime;
+        result = 0;
+    }
+
+    return result;
+}
+
 int write_cstring_to_file(const char* file_name, const char* data)
 {
     int result;
@@ -582,6 +831,201 @@ int write_buffer_to_file
     return result;
 }
 
+int append_buffer_to_file
+(
+    const char *file_name,
+    const unsigned char *data,
+    size_t data_size,
+    bool make_private
+)
+{
+    int result;
+
+    if ((file_name == NULL) || (strlen(file_name) == 0))
+    {
+        LOG_ERROR("Invalid file name parameter");
+        result = __FAILURE__;
+    }
+    else if ((data == NULL) || (data_size == 0))
+    {
+        LOG_ERROR("Invalid data parameter");
+        result = __FAILURE__;
+    }
+    else
+    {
+#if defined __WINDOWS__ || defined _WIN32 || defined _WIN64 || defined _Windows
+        FILE *file_handle;
+        (void)make_private;
+        if ((file_handle = fopen(file_name, "ab")) == NULL)
+        {
+            LOG_ERROR("Could not open file for appending %s", file_name);
+            result = __FAILURE__;
+        }
+        else
+        {
+            size_t num_bytes_written = fwrite(data, 1, data_size, file_handle);
+            if ((num_bytes_written != data_size) || (ferror(file_handle) != 0))
+            {
+                LOG_ERROR("File append failed for file %s", file_name);
+                result = __FAILURE__;
+            }
+            else if ((fflush(file_handle) != 0) || (_commit(_fileno(file_handle)) != 0))
+            {
+                LOG_ERROR("File sync failed for file %s", file_name);
+                result = __FAILURE__;
+            }
+            else
+            {
+                result = 0;
+            }
+            (void)fclose(file_handle);
+        }
+#else
+        mode_t mode = make_private ? (S_IRUSR | S_IWUSR) : (S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+        int fd = open(file_name, O_CREAT | O_WRONLY | O_APPEND, mode);
+        if (fd == -1)
+        {
+            LOG_ERROR("Could not open file for appending %s. Errno %d '%s'", file_name, errno, err_to_str());
+            result = __FAILURE__;
+        }
+        else
+        {
+            size_t total_written = 0;
+            result = 0;
+            while ((result == 0) && (total_written < data_size))
+            {
+                ssize_t write_status = write(fd, data + total_written, data_size - total_written);
+                if (write_status < 0)
+                {
+                    if (errno != EINTR)
+                    {
+                        LOG_ERROR("File append failed for file %s. Errno %d '%s'", file_name, errno, err_to_str());
+                        result = __FAILURE__;
+                    }
+                }
+                else
+                {
+                    total_written += (size_t)write_status;
+                }
+            }
+            if ((result == 0) && (fsync(fd) != 0))
+            {
+                LOG_ERROR("File sync failed for file %s", file_name);
+                result = __FAILURE__;
+            }
+            (void)close(fd);
+        }
+#endif
+    }
+
+    return result;
+}
+
+int replace_file(const char* source_file_name, const char* target_file_name)
+{
+    int result;
+
+    if ((source_file_name == NULL) || (strlen(source_file_name) == 0) ||
+        (target_file_name == NULL) || (strlen(target_file_name) == 0))
+    {
+        LOG_ERROR("Invalid file name parameters");
+        result = __FAILURE__;
+    }
+    else
+    {
+#if defined __WINDOWS__ || defined _WIN32 || defined _WIN64 || defined _Windows
+        if (MoveFileExA(source_file_name, target_file_name,
+                        MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) == 0)
+        {
+            LOG_ERROR("Could not replace file %s with %s. GetLastError=%08x",
+                      target_file_name, source_file_name, GetLastError());
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = 0;
+        }
+#else
+        if (rename(source_file_name, target_file_name) != 0)
+        {
+            LOG_ERROR("Could not replace file %s with %s. Errno %d '%s'",
+                      target_file_name, source_file_name, errno, err_to_str());
+            result = __FAILURE__;
+        }
+        else
+        {
+            // the rename is only durable once the directory entry is synced
+            char *dir_name;
+            const char *slash = strrchr(target_file_name, '/');
+            size_t dir_len = (slash == NULL) ? 0 : (size_t)(slash - target_file_name);
+            if ((dir_name = (char*)malloc(dir_len + 2)) == NULL)
+            {
+                LOG_ERROR("Could not allocate memory for directory name");
+                result = __FAILURE__;
+            }
+            else
+            {
+                if (dir_len == 0)
+                {
+                    dir_name[0] = (slash == NULL) ? '.' : '/';
+                    dir_name[1] = 0;
+                }
+                else
+                {
+                    memcpy(dir_name, target_file_name, dir_len);
+                    dir_name[dir_len] = 0;
+                }
+                result = sync_directory(dir_name);
+                free(dir_name);
+            }
+        }
+#endif
+    }
+
+    return result;
+}
+
+int sync_directory(const char* dir_path)
+{
+    int result;
+
+    if ((dir_path == NULL) || (strlen(dir_path) == 0))
+    {
+        LOG_ERROR("Invalid directory name parameter");
+        result = __FAILURE__;
+    }
+    else
+    {
+#if defined __WINDOWS__ || defined _WIN32 || defined _WIN64 || defined _Windows
+        // directory entries cannot be flushed on Windows, renames are made
+        // durable with MOVEFILE_WRITE_THROUGH instead
+        result = 0;
+#else
+        int fd;
+        if ((fd = open(dir_path, O_RDONLY)) == -1)
+        {
+            LOG_ERROR("Could not open directory %s. Errno %d '%s'", dir_path, errno, err_to_str());
+            result = __FAILURE__;
+        }
+        else
+        {
+            if (fsync(fd) != 0)
+            {
+                LOG_ERROR("Directory sync failed for %s", dir_path);
+                result = __FAILURE__;
+            }
+            else
+            {
+                result = 0;
+            }
+            (void)close(fd);
+        }
+#endif
+    }
+
+    return result;
+}
+
 int delete_file(const char* file_name)
 {
     int result;
@@ -734,3 +1178,18 @@ int hsm_get_env(const char *key, char **buffer)
 
     return result;
 }
+
+void secure_zero(void *buffer, size_t size)
+{
+#if defined __WINDOWS__ || defined _WIN32 || defined _WIN64 || defined _Windows
+    (void)SecureZeroMemory(buffer, size);
+#else
+    // the volatile access keeps the compiler from eliding stores to memory
+    // that is about to be released or go out of scope
+    volatile unsigned char *ptr = (volatile unsigned char*)buffer;
+    while (size-- > 0)
+    {
+        *ptr++ = 0;
+    }
+#endif
+}
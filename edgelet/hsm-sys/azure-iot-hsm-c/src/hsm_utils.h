@@ -2,17 +2,72 @@
 #define HSM_UTILS_H
 
 #include <stddef.h>
+#include <stdint.h>
 #include "azure_c_shared_utility/umock_c_prod.h"
 
+/**
+ * Identifies a version of a file on disk. Two stamps that compare equal
+ * refer to the same unmodified file, modulo the resolution of the file
+ * system modification time.
+ */
+typedef struct HSM_FILE_STAMP_TAG
+{
+    uint64_t device;
+    uint64_t inode;
+    uint64_t size;
+    int64_t modified_time;
+} HSM_FILE_STAMP;
+
 MOCKABLE_FUNCTION(, char*, concat_files_to_cstring, const char **, file_names, int, num_files);
 MOCKABLE_FUNCTION(, char*, read_file_into_cstring, const char*, file_name, size_t*, output_buffer_size);
 MOCKABLE_FUNCTION(, void*, read_file_into_buffer, const char*, file_name, size_t*, output_buffer_size);
+
+/**
+ * Provides read only access to the contents of a file. Large files are
+ * memory mapped, small files and files that cannot be mapped are read into
+ * memory. The data is not null terminated and must be released with
+ * unmap_file using the size returned in mapped_size. Empty files are
+ * reported as an error.
+ *
+ * @note Only use this for files owned by the HSM which are replaced
+ *       atomically. A file truncated or rewritten in place while it is
+ *       mapped raises SIGBUS, files provided by the user must be read with
+ *       read_file_into_buffer.
+ */
+MOCKABLE_FUNCTION(, const void*, read_file_mapped, const char*, file_name, size_t*, mapped_size);
+MOCKABLE_FUNCTION(, void, unmap_file, const void*, mapped_data, size_t, mapped_size);
+
 MOCKABLE_FUNCTION(, bool, is_file_valid, const char*, file_name);
 MOCKABLE_FUNCTION(, bool, is_directory_valid, const char*, dir_path);
+MOCKABLE_FUNCTION(, int, get_file_stamp, const char*, file_name, HSM_FILE_STAMP*, stamp);
 MOCKABLE_FUNCTION(, int, write_cstring_to_file, const char*, file_name, const char*, data);
 MOCKABLE_FUNCTION(, int, write_buffer_to_file, const char*, file_name, const unsigned char*, data, size_t, data_size, bool, make_private);
+
+/**
+ * Appends data to a file, creating it if required, and flushes the file to
+ * stable storage before returning.
+ */
+MOCKABLE_FUNCTION(, int, append_buffer_to_file, const char*, file_name, const unsigned char*, data, size_t, data_size, bool, make_private);
+
+/**
+ * Atomically replaces target_file_name with source_file_name. Once this
+ * returns successfully the rename is durable.
+ */
+MOCKABLE_FUNCTION(, int, replace_file, const char*, source_file_name, const char*, target_file_name);
+
+/**
+ * Flushes the entries of a directory to stable storage so that files that
+ * were created, renamed or removed in it are durable.
+ */
+MOCKABLE_FUNCTION(, int, sync_directory, const char*, dir_path);
 MOCKABLE_FUNCTION(, int, delete_file, const char*, file_name);
 MOCKABLE_FUNCTION(, int, make_dir, const char*, dir_path);
 MOCKABLE_FUNCTION(, int, hsm_get_env, const char*, key, char**, output);
 
+/**
+ * Overwrites a buffer with zeros in a way the compiler cannot elide. Used to
+ * clear key material and plaintext before the memory is released or reused.
+ */
+MOCKABLE_FUNCTION(, void, secure_zero, void*, buffer, size_t, size);
+
 #endif  //HSM_UTILS_H
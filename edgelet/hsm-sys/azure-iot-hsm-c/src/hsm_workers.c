@@ -0,0 +1,40 @@
+#include <stdlib.h>
+
+#include "azure_c_shared_utility/gballoc.h"
+#include "hsm_workers.h"
+#include "hsm_lock.h"
+#include "hsm_log.h"
+
+//##############################################################################
+// Workers API
+//##############################################################################
+void hsm_workers_run(size_t num_workers, HSM_WORKERS_RUN run, void *context)
+{
+    if (run == NULL)
+    {
+        LOG_ERROR("Invalid worker callback");
+    }
+    else
+    {
+        HSM_THREAD_HANDLE threads[HSM_WORKERS_MAX - 1];
+        size_t num_threads = 0;
+        size_t index;
+
+        if (num_workers > HSM_WORKERS_MAX)
+        {
+            num_workers = HSM_WORKERS_MAX;
+        }
+        // the calling thread is the last worker, a thread that cannot be
+        // created leaves its share of the work to the others
+        while (((num_threads + 1) < num_workers) &&
+               ((threads[num_threads] = hsm_thread_create(run, context)) != NULL))
+        {
+            num_threads++;
+        }
+        run(context);
+        for (index = 0; index < num_threads; index++)
+        {
+            hsm_thread_join(threads[index]);
+        }
+    }
+}
@@ -0,0 +1,31 @@
+#ifndef HSM_WORKERS_H
+#define HSM_WORKERS_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Runs a callback concurrently on a number of threads and waits for all of
+ * them to return.
+ *
+ * The calling thread is one of the workers, so the callback always runs at
+ * least once even when no additional thread can be created. Callers are
+ * expected to claim work items from a shared counter in the context until
+ * none are left so that the outcome does not depend on the number of
+ * workers that actually ran.
+ */
+typedef void (*HSM_WORKERS_RUN)(void *context);
+
+// Upper bound for the number of workers of a single run
+#define HSM_WORKERS_MAX 16
+
+extern void hsm_workers_run(size_t num_workers, HSM_WORKERS_RUN run, void *context);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  //HSM_WORKERS_H
@@ -402,6 +402,42 @@ BEGIN_TEST_SUITE(certificate_info_ut)
         certificate_info_destroy(cert_handle);
     }
 
+    TEST_FUNCTION(certificate_info_create_from_buffer_not_null_terminated_succeed)
+    {
+        //arrange
+        size_t cert_len = strlen(TEST_RSA_CERT);
+        char* cert_buffer = (char*)my_gballoc_malloc(cert_len + 1);
+        ASSERT_IS_NOT_NULL(cert_buffer);
+        memcpy(cert_buffer, TEST_RSA_CERT, cert_len);
+        cert_buffer[cert_len] = 'X';
+        umock_c_reset_all_calls();
+
+        //act
+        CERT_INFO_HANDLE cert_handle = certificate_info_create_from_buffer(cert_buffer, cert_len, NULL, 0, PRIVATE_KEY_UNKNOWN);
+        const char* certificate = certificate_info_get_certificate(cert_handle);
+
+        //assert
+        ASSERT_IS_NOT_NULL(cert_handle);
+        ASSERT_ARE_EQUAL(char_ptr, TEST_RSA_CERT, certificate);
+
+        //cleanup
+        certificate_info_destroy(cert_handle);
+        my_gballoc_free(cert_buffer);
+    }
+
+    TEST_FUNCTION(certificate_info_create_from_buffer_zero_size_fail)
+    {
+        //arrange
+
+        //act
+        CERT_INFO_HANDLE cert_handle = certificate_info_create_from_buffer(TEST_RSA_CERT, 0, NULL, 0, PRIVATE_KEY_UNKNOWN);
+
+        //assert
+        ASSERT_IS_NULL(cert_handle);
+
+        //cleanup
+    }
+
     TEST_FUNCTION(certificate_info_create_ecc_succeed)
     {
         //arrange
@@ -534,6 +570,43 @@ BEGIN_TEST_SUITE(certificate_info_ut)
         //cleanup
     }
 
+    TEST_FUNCTION(certificate_info_clone_handle_NULL_fail)
+    {
+        //arrange
+
+        //act
+        CERT_INFO_HANDLE cert_handle = certificate_info_clone(NULL);
+
+        //assert
+        ASSERT_IS_NULL(cert_handle);
+
+        //cleanup
+    }
+
+    TEST_FUNCTION(certificate_info_clone_destroy_releases_on_last_reference_succeed)
+    {
+        //arrange
+        CERT_INFO_HANDLE cert_handle = certificate_info_create(TEST_RSA_CERT, NULL, 0, PRIVATE_KEY_UNKNOWN);
+        umock_c_reset_all_calls();
+
+        //act
+        CERT_INFO_HANDLE clone_handle = certificate_info_clone(cert_handle);
+        certificate_info_destroy(cert_handle);
+
+        //assert
+        ASSERT_ARE_EQUAL(void_ptr, cert_handle, clone_handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_IS_NOT_NULL(certificate_info_get_certificate(clone_handle));
+
+        //cleanup
+        umock_c_reset_all_calls();
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+        certificate_info_destroy(clone_handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
     TEST_FUNCTION(certificate_info_get_certificate_succeed)
     {
         //arrange
@@ -814,6 +814,83 @@ BEGIN_TEST_SUITE(edge_hsm_crypto_int_tests)
         test_helper_crypto_deinit(hsm_handle);
     }
 
+    TEST_FUNCTION(hsm_client_encrypt_decrypt_stream_smoke)
+    {
+        // arrange
+        int status;
+        HSM_CLIENT_HANDLE hsm_handle = test_helper_crypto_init();
+        const HSM_CLIENT_CRYPTO_INTERFACE* interface = hsm_client_crypto_interface();
+        SIZED_BUFFER id = {TEST_ID, TEST_ID_SIZE};
+        SIZED_BUFFER iv = {TEST_IV, TEST_IV_SIZE};
+        SIZED_BUFFER ciphertext = { NULL, 0 };
+        SIZED_BUFFER plaintext_result = { NULL, 0 };
+        HSM_CLIENT_STREAM_HANDLE stream = NULL;
+        unsigned char *decrypted;
+        size_t decrypted_size = 0;
+        size_t output_size;
+
+        status = interface->hsm_client_create_master_encryption_key(hsm_handle);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+
+        // act, assert
+        status = interface->hsm_client_encrypt_stream_init(hsm_handle, &id, &iv, &stream);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        output_size = 0;
+        status = interface->hsm_client_stream_update(hsm_handle, stream, TEST_PLAINTEXT, TEST_PLAINTEXT_SIZE,
+                                                     NULL, &output_size);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        ciphertext.buffer = (unsigned char*)malloc(output_size);
+        ASSERT_IS_NOT_NULL_WITH_MSG(ciphertext.buffer, "Line:" TOSTRING(__LINE__));
+        status = interface->hsm_client_stream_update(hsm_handle, stream, TEST_PLAINTEXT, TEST_PLAINTEXT_SIZE,
+                                                     ciphertext.buffer, &output_size);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        ciphertext.size = output_size;
+        output_size = 0;
+        status = interface->hsm_client_stream_final(hsm_handle, stream, NULL, &output_size);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        ciphertext.buffer = (unsigned char*)realloc(ciphertext.buffer, ciphertext.size + output_size);
+        ASSERT_IS_NOT_NULL_WITH_MSG(ciphertext.buffer, "Line:" TOSTRING(__LINE__));
+        status = interface->hsm_client_stream_final(hsm_handle, stream, ciphertext.buffer + ciphertext.size, &output_size);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        ciphertext.size += output_size;
+        interface->hsm_client_stream_destroy(hsm_handle, stream);
+
+        // the cipher text of a stream is understood by the one shot API
+        status = interface->hsm_client_decrypt_data(hsm_handle, &id, &ciphertext, &iv, &plaintext_result);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        ASSERT_ARE_EQUAL_WITH_MSG(size_t, TEST_PLAINTEXT_SIZE, plaintext_result.size, "Line:" TOSTRING(__LINE__));
+        status = memcmp(TEST_PLAINTEXT, plaintext_result.buffer, TEST_PLAINTEXT_SIZE);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+
+        stream = NULL;
+        status = interface->hsm_client_decrypt_stream_init(hsm_handle, &id, &iv, &stream);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        decrypted = (unsigned char*)malloc(ciphertext.size);
+        ASSERT_IS_NOT_NULL_WITH_MSG(decrypted, "Line:" TOSTRING(__LINE__));
+        output_size = ciphertext.size;
+        status = interface->hsm_client_stream_update(hsm_handle, stream, ciphertext.buffer, ciphertext.size,
+                                                     decrypted, &output_size);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        decrypted_size = output_size;
+        output_size = ciphertext.size - decrypted_size;
+        status = interface->hsm_client_stream_final(hsm_handle, stream, decrypted + decrypted_size, &output_size);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        decrypted_size += output_size;
+        interface->hsm_client_stream_destroy(hsm_handle, stream);
+        ASSERT_ARE_EQUAL_WITH_MSG(size_t, TEST_PLAINTEXT_SIZE, decrypted_size, "Line:" TOSTRING(__LINE__));
+        status = memcmp(TEST_PLAINTEXT, decrypted, TEST_PLAINTEXT_SIZE);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+
+        status = interface->hsm_client_destroy_master_encryption_key(hsm_handle);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+
+        // cleanup
+        free(decrypted);
+        free(plaintext_result.buffer);
+        free(ciphertext.buffer);
+        test_helper_crypto_deinit(hsm_handle);
+    }
+
     TEST_FUNCTION(hsm_client_multiple_masterkey_create_idempotent_success)
     {
         // arrange
@@ -57,6 +57,7 @@ MOCKABLE_FUNCTION(, int, mocked_hsm_client_store_insert_encryption_key, HSM_CLIE
 
 // store pki mocks
 MOCKABLE_FUNCTION(, int, mocked_hsm_client_store_create_pki_cert, HSM_CLIENT_STORE_HANDLE, handle, CERT_PROPS_HANDLE, cert_props_handle);
+MOCKABLE_FUNCTION(, int, mocked_hsm_client_store_create_pki_certs, HSM_CLIENT_STORE_HANDLE, handle, CERT_PROPS_HANDLE*, cert_props_handles, size_t, count);
 MOCKABLE_FUNCTION(, CERT_INFO_HANDLE, mocked_hsm_client_store_get_pki_cert, HSM_CLIENT_STORE_HANDLE, handle, const char*, alias);
 MOCKABLE_FUNCTION(, int, mocked_hsm_client_store_remove_pki_cert, HSM_CLIENT_STORE_HANDLE, handle, const char*, alias);
 
@@ -77,6 +78,7 @@ MOCKABLE_FUNCTION(, const HSM_CLIENT_STORE_INTERFACE*, hsm_client_store_interfac
 MOCKABLE_FUNCTION(, const HSM_CLIENT_KEY_INTERFACE*, hsm_client_key_interface);
 
 MOCKABLE_FUNCTION(, CERT_INFO_HANDLE, certificate_info_create, const char*, certificate, const void*, private_key, size_t, priv_key_len, PRIVATE_KEY_TYPE, pk_type);
+MOCKABLE_FUNCTION(, void, certificate_info_destroy, CERT_INFO_HANDLE, handle);
 MOCKABLE_FUNCTION(, const char*, get_alias, CERT_PROPS_HANDLE, handle);
 MOCKABLE_FUNCTION(, const char*, get_issuer_alias, CERT_PROPS_HANDLE, handle);
 
@@ -120,6 +122,7 @@ static const HSM_CLIENT_STORE_INTERFACE mocked_hsm_client_store_interface =
     mocked_hsm_client_store_insert_sas_key,
     mocked_hsm_client_store_insert_encryption_key,
     mocked_hsm_client_store_create_pki_cert,
+    mocked_hsm_client_store_create_pki_certs,
     mocked_hsm_client_store_get_pki_cert,
     mocked_hsm_client_store_remove_pki_cert,
     mocked_hsm_client_store_insert_pki_trusted_cert,
@@ -221,6 +224,13 @@ static int test_hook_hsm_client_store_create_pki_cert(HSM_CLIENT_STORE_HANDLE ha
     return 0;
 }
 
+static int test_hook_hsm_client_store_create_pki_certs(HSM_CLIENT_STORE_HANDLE handle,
+                                                       CERT_PROPS_HANDLE* cert_props_handles,
+                                                       size_t count)
+{
+    return 0;
+}
+
 static CERT_INFO_HANDLE test_hook_hsm_client_store_get_pki_cert(HSM_CLIENT_STORE_HANDLE handle,
                                                                 const char* alias)
 {
@@ -400,6 +410,9 @@ BEGIN_TEST_SUITE(edge_hsm_crypto_unittests)
             REGISTER_GLOBAL_MOCK_HOOK(mocked_hsm_client_store_create_pki_cert, test_hook_hsm_client_store_create_pki_cert);
             REGISTER_GLOBAL_MOCK_FAIL_RETURN(mocked_hsm_client_store_create_pki_cert, 1);
 
+            REGISTER_GLOBAL_MOCK_HOOK(mocked_hsm_client_store_create_pki_certs, test_hook_hsm_client_store_create_pki_certs);
+            REGISTER_GLOBAL_MOCK_FAIL_RETURN(mocked_hsm_client_store_create_pki_certs, 1);
+
             REGISTER_GLOBAL_MOCK_HOOK(mocked_hsm_client_store_get_pki_cert, test_hook_hsm_client_store_get_pki_cert);
             REGISTER_GLOBAL_MOCK_FAIL_RETURN(mocked_hsm_client_store_get_pki_cert, NULL);
 
@@ -1128,6 +1141,81 @@ BEGIN_TEST_SUITE(edge_hsm_crypto_unittests)
             umock_c_negative_tests_deinit();
         }
 
+        /**
+         * Test function for API
+         *   hsm_client_create_certificates
+        */
+        TEST_FUNCTION(edge_hsm_client_create_certificates_invalid_param_validation)
+        {
+            //arrange
+            int status = hsm_client_crypto_init();
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+            const HSM_CLIENT_CRYPTO_INTERFACE* interface = hsm_client_crypto_interface();
+            HSM_CLIENT_CREATE_CERTIFICATES hsm_client_create_certificates = interface->hsm_client_create_certificates;
+            CERT_PROPS_HANDLE cert_props_handles[1] = { TEST_CERT_PROPS_HANDLE };
+            CERT_INFO_HANDLE cert_info_handles[1];
+            umock_c_reset_all_calls();
+
+            // act, assert
+            status = hsm_client_create_certificates(NULL, cert_props_handles, 1, cert_info_handles);
+            ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+
+            // act, assert
+            status = hsm_client_create_certificates(TEST_HSM_CLIENT_HANDLE, NULL, 1, cert_info_handles);
+            ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+
+            // act, assert
+            status = hsm_client_create_certificates(TEST_HSM_CLIENT_HANDLE, cert_props_handles, 0, cert_info_handles);
+            ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+
+            // act, assert
+            status = hsm_client_create_certificates(TEST_HSM_CLIENT_HANDLE, cert_props_handles, 1, NULL);
+            ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+            ASSERT_ARE_EQUAL_WITH_MSG(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls(), "Line:" TOSTRING(__LINE__));
+
+            //cleanup
+            hsm_client_crypto_deinit();
+        }
+
+        /**
+         * Test function for API
+         *   hsm_client_create_certificates
+        */
+        TEST_FUNCTION(edge_hsm_client_create_certificates_success)
+        {
+            //arrange
+            int status;
+            status = hsm_client_crypto_init();
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+            const HSM_CLIENT_CRYPTO_INTERFACE* interface = hsm_client_crypto_interface();
+            HSM_CLIENT_CREATE hsm_client_crypto_create = interface->hsm_client_crypto_create;
+            HSM_CLIENT_DESTROY hsm_client_crypto_destroy = interface->hsm_client_crypto_destroy;
+            HSM_CLIENT_CREATE_CERTIFICATES hsm_client_create_certificates = interface->hsm_client_create_certificates;
+            HSM_CLIENT_HANDLE hsm_handle = hsm_client_crypto_create();
+            CERT_PROPS_HANDLE cert_props_handles[2] = { TEST_CERT_PROPS_HANDLE, TEST_CERT_PROPS_HANDLE };
+            CERT_INFO_HANDLE cert_info_handles[2] = { NULL, NULL };
+            umock_c_reset_all_calls();
+
+            STRICT_EXPECTED_CALL(mocked_hsm_client_store_create_pki_certs(IGNORED_PTR_ARG, cert_props_handles, 2));
+            STRICT_EXPECTED_CALL(get_alias(TEST_CERT_PROPS_HANDLE));
+            STRICT_EXPECTED_CALL(mocked_hsm_client_store_get_pki_cert(IGNORED_PTR_ARG, TEST_ALIAS_STRING));
+            STRICT_EXPECTED_CALL(get_alias(TEST_CERT_PROPS_HANDLE));
+            STRICT_EXPECTED_CALL(mocked_hsm_client_store_get_pki_cert(IGNORED_PTR_ARG, TEST_ALIAS_STRING));
+
+            // act
+            status = hsm_client_create_certificates(hsm_handle, cert_props_handles, 2, cert_info_handles);
+
+            // assert
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+            ASSERT_ARE_EQUAL_WITH_MSG(void_ptr, TEST_CERT_INFO_HANDLE, cert_info_handles[0], "Line:" TOSTRING(__LINE__));
+            ASSERT_ARE_EQUAL_WITH_MSG(void_ptr, TEST_CERT_INFO_HANDLE, cert_info_handles[1], "Line:" TOSTRING(__LINE__));
+            ASSERT_ARE_EQUAL_WITH_MSG(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls(), "Line:" TOSTRING(__LINE__));
+
+            //cleanup
+            hsm_client_crypto_destroy(hsm_handle);
+            hsm_client_crypto_deinit();
+        }
+
         /**
          * Test function for API
          *   hsm_client_get_trust_bundle
@@ -41,8 +41,6 @@ static void test_hook_gballoc_free(void* ptr)
 #define ENABLE_MOCKS
 
 #include "azure_c_shared_utility/gballoc.h"
-#include "azure_c_shared_utility/buffer_.h"
-#include "azure_c_shared_utility/hmacsha256.h"
 
 #undef ENABLE_MOCKS
 
@@ -52,7 +50,7 @@ static void test_hook_gballoc_free(void* ptr)
 
 #include "hsm_client_data.h"
 #include "hsm_key.h"
-#include "edge_sas_perform_sign_with_key.h"
+#include "hsm_hmac.h"
 
 //#############################################################################
 // Test defines and data
@@ -60,16 +58,25 @@ static void test_hook_gballoc_free(void* ptr)
 
 DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
 
-#define TEST_BUFFER_HANDLE (BUFFER_HANDLE)0x1000
-#define TEST_DERIVED_BUFFER_HANDLE (BUFFER_HANDLE)0x1001
 #define TEST_DIGEST_PTR (unsigned char*)0x5000
+// more requests than the multi-buffer SHA-256 kernel hashes at once
+#define TEST_BATCH_SIZE (HSM_SHA256_LANES + 1)
 
 static TEST_MUTEX_HANDLE g_testByTest;
 static TEST_MUTEX_HANDLE g_dllByDll;
-static unsigned char TEST_KEY_DATA[] = {'A', 'B', 'C', 'D'};
-static unsigned char TEST_DIGEST_DATA[] = {'D', 'I', 'G', 'E', 'S', 'T'};
-static unsigned char TEST_DERIVED_DIGEST_DATA[] = {'D', 'I', 'G', 'E', 'S', 'T',
-                                                   'D', 'E', 'R', 'I', 'V', 'E', 'D'};
+// RFC 4231 HMAC-SHA256 test case 2
+static unsigned char TEST_KEY_DATA[] = {'J', 'e', 'f', 'e'};
+static unsigned char TEST_DATA_TO_BE_SIGNED[] = "what do ya want for nothing?";
+#define TEST_DATA_TO_BE_SIGNED_SIZE (sizeof(TEST_DATA_TO_BE_SIGNED) - 1)
+static unsigned char TEST_DIGEST_DATA[] = {
+    0x5b, 0xdc, 0xc1, 0x46, 0xbf, 0x60, 0x75, 0x4e, 0x6a, 0x04, 0x24, 0x26, 0x08, 0x95, 0x75, 0xc7,
+    0x5a, 0x00, 0x3f, 0x08, 0x9d, 0x27, 0x39, 0x83, 0x9d, 0xec, 0x58, 0xb9, 0x64, 0xec, 0x38, 0x43
+};
+// HMAC(HMAC(TEST_KEY_DATA, "identity" including the terminator), TEST_DATA_TO_BE_SIGNED)
+static unsigned char TEST_DERIVED_DIGEST_DATA[] = {
+    0xe6, 0x0a, 0xb6, 0x30, 0x91, 0xea, 0xa0, 0x83, 0xff, 0x35, 0x65, 0xbd, 0x02, 0x5e, 0x91, 0xa2,
+    0x3d, 0x6b, 0xdd, 0x87, 0xc9, 0x39, 0x4d, 0x67, 0xdc, 0x87, 0x07, 0xcf, 0x7a, 0x26, 0x82, 0xe5
+};
 
 //#############################################################################
 // Mocked functions test hooks
@@ -83,48 +90,6 @@ static void test_hook_on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
     ASSERT_FAIL(temp_str);
 }
 
-static unsigned char* test_hook_BUFFER_u_char(BUFFER_HANDLE handle)
-{
-    unsigned char* result = NULL;
-    if (handle == TEST_BUFFER_HANDLE)
-    {
-        result = TEST_DIGEST_DATA;
-    }
-    else if (handle == TEST_DERIVED_BUFFER_HANDLE)
-    {
-        result = TEST_DERIVED_DIGEST_DATA;
-    }
-    ASSERT_IS_NOT_NULL_WITH_MSG(result, "Line:" TOSTRING(__LINE__));
-    return result;
-}
-
-static size_t test_hook_BUFFER_length(BUFFER_HANDLE handle)
-{
-    size_t result = 0;
-    if (handle == TEST_BUFFER_HANDLE)
-    {
-        result = sizeof(TEST_DIGEST_DATA);
-    }
-    else if (handle == TEST_DERIVED_BUFFER_HANDLE)
-    {
-        result = sizeof(TEST_DERIVED_DIGEST_DATA);
-    }
-    ASSERT_ARE_NOT_EQUAL_WITH_MSG(size_t, 0, result, "Line:" TOSTRING(__LINE__));
-    return result;
-}
-
-static HMACSHA256_RESULT test_hook_HMACSHA256_ComputeHash
-(
-    const unsigned char* key,
-    size_t keyLen,
-    const unsigned char* payload,
-    size_t payloadLen,
-    BUFFER_HANDLE hash
-)
-{
-    return HMACSHA256_OK;
-}
-
 //#############################################################################
 // Test helpers
 //#############################################################################
@@ -157,9 +122,7 @@ BEGIN_TEST_SUITE(edge_hsm_key_interface_sas_key_unittests)
 
             umock_c_init(test_hook_on_umock_c_error);
 
-            REGISTER_UMOCK_ALIAS_TYPE(BUFFER_HANDLE, void*);
             REGISTER_UMOCK_ALIAS_TYPE(KEY_HANDLE, void*);
-            REGISTER_UMOCK_ALIAS_TYPE(HMACSHA256_RESULT, int);
 
             ASSERT_ARE_EQUAL(int, 0, umocktypes_charptr_register_types() );
 
@@ -173,15 +136,6 @@ BEGIN_TEST_SUITE(edge_hsm_key_interface_sas_key_unittests)
             REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_realloc, NULL);
 
             REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, test_hook_gballoc_free);
-
-            REGISTER_GLOBAL_MOCK_HOOK(BUFFER_length, test_hook_BUFFER_length);
-            REGISTER_GLOBAL_MOCK_FAIL_RETURN(BUFFER_length, 0);
-
-            REGISTER_GLOBAL_MOCK_HOOK(BUFFER_u_char, test_hook_BUFFER_u_char);
-            REGISTER_GLOBAL_MOCK_FAIL_RETURN(BUFFER_u_char, NULL);
-
-            REGISTER_GLOBAL_MOCK_HOOK(HMACSHA256_ComputeHash, test_hook_HMACSHA256_ComputeHash);
-            REGISTER_GLOBAL_MOCK_FAIL_RETURN(HMACSHA256_ComputeHash, HMACSHA256_ERROR);
         }
 
         TEST_SUITE_CLEANUP(TestClassCleanup)
@@ -221,6 +175,15 @@ BEGIN_TEST_SUITE(edge_hsm_key_interface_sas_key_unittests)
             ASSERT_IS_NOT_NULL_WITH_MSG(key_if->hsm_client_key_encrypt, "Line:" TOSTRING(__LINE__));
             ASSERT_IS_NOT_NULL_WITH_MSG(key_if->hsm_client_key_decrypt, "Line:" TOSTRING(__LINE__));
             ASSERT_IS_NOT_NULL_WITH_MSG(key_if->hsm_client_key_destroy, "Line:" TOSTRING(__LINE__));
+            ASSERT_IS_NOT_NULL_WITH_MSG(key_if->hsm_client_key_sign_into, "Line:" TOSTRING(__LINE__));
+            ASSERT_IS_NOT_NULL_WITH_MSG(key_if->hsm_client_key_derive_and_sign_into, "Line:" TOSTRING(__LINE__));
+            ASSERT_IS_NOT_NULL_WITH_MSG(key_if->hsm_client_key_sign_batch, "Line:" TOSTRING(__LINE__));
+            ASSERT_IS_NOT_NULL_WITH_MSG(key_if->hsm_client_key_derive_and_sign_batch, "Line:" TOSTRING(__LINE__));
+            ASSERT_IS_NOT_NULL_WITH_MSG(key_if->hsm_client_key_encrypt_init, "Line:" TOSTRING(__LINE__));
+            ASSERT_IS_NOT_NULL_WITH_MSG(key_if->hsm_client_key_decrypt_init, "Line:" TOSTRING(__LINE__));
+            ASSERT_IS_NOT_NULL_WITH_MSG(key_if->hsm_client_key_stream_update, "Line:" TOSTRING(__LINE__));
+            ASSERT_IS_NOT_NULL_WITH_MSG(key_if->hsm_client_key_stream_final, "Line:" TOSTRING(__LINE__));
+            ASSERT_IS_NOT_NULL_WITH_MSG(key_if->hsm_client_key_stream_destroy, "Line:" TOSTRING(__LINE__));
 
             // cleanup
         }
@@ -229,7 +192,7 @@ BEGIN_TEST_SUITE(edge_hsm_key_interface_sas_key_unittests)
         {
             // arrange
             EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-            STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(TEST_KEY_DATA)));
+            EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
 
             // act
             KEY_HANDLE key_handle = create_sas_key(TEST_KEY_DATA, sizeof(TEST_KEY_DATA));
@@ -249,7 +212,7 @@ BEGIN_TEST_SUITE(edge_hsm_key_interface_sas_key_unittests)
             ASSERT_ARE_EQUAL(int, 0, test_result);
 
             EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-            STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(TEST_KEY_DATA)));
+            EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
             umock_c_negative_tests_snapshot();
 
             for (size_t i = 0; i < umock_c_negative_tests_call_count(); i++)
@@ -367,24 +330,16 @@ BEGIN_TEST_SUITE(edge_hsm_key_interface_sas_key_unittests)
         {
             // arrange
             int status;
-            unsigned char data_to_be_signed[] = "data";
-            size_t data_len = sizeof(data_to_be_signed);
             unsigned char* digest = NULL;
             size_t digest_size = 0;
             const HSM_CLIENT_KEY_INTERFACE* key_if = hsm_client_key_interface();
             KEY_HANDLE key_handle = test_helper_create_key(TEST_KEY_DATA, sizeof(TEST_KEY_DATA));
             umock_c_reset_all_calls();
 
-            EXPECTED_CALL(BUFFER_new())
-                .SetReturn(TEST_BUFFER_HANDLE);
-            STRICT_EXPECTED_CALL(HMACSHA256_ComputeHash(IGNORED_PTR_ARG, sizeof(TEST_KEY_DATA), data_to_be_signed, data_len, TEST_BUFFER_HANDLE));
-            STRICT_EXPECTED_CALL(BUFFER_length(TEST_BUFFER_HANDLE));
-            STRICT_EXPECTED_CALL(BUFFER_u_char(TEST_BUFFER_HANDLE));
-            STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(TEST_DIGEST_DATA)));
-            STRICT_EXPECTED_CALL(BUFFER_delete(TEST_BUFFER_HANDLE));
+            STRICT_EXPECTED_CALL(gballoc_malloc(HSM_HMAC_DIGEST_SIZE));
 
             // act
-            status = key_if->hsm_client_key_sign(key_handle, data_to_be_signed, data_len, &digest, &digest_size);
+            status = key_if->hsm_client_key_sign(key_handle, TEST_DATA_TO_BE_SIGNED, TEST_DATA_TO_BE_SIGNED_SIZE, &digest, &digest_size);
 
             // assert
             ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
@@ -404,22 +359,13 @@ BEGIN_TEST_SUITE(edge_hsm_key_interface_sas_key_unittests)
             int test_result = umock_c_negative_tests_init();
             ASSERT_ARE_EQUAL(int, 0, test_result);
             int status;
-            unsigned char data_to_be_signed[] = "data";
-            size_t data_len = sizeof(data_to_be_signed);
             unsigned char* digest = NULL;
             size_t digest_size = 0;
             const HSM_CLIENT_KEY_INTERFACE* key_if = hsm_client_key_interface();
             KEY_HANDLE key_handle = test_helper_create_key(TEST_KEY_DATA, sizeof(TEST_KEY_DATA));
             umock_c_reset_all_calls();
 
-            EXPECTED_CALL(BUFFER_new())
-                .SetReturn(TEST_BUFFER_HANDLE);
-            STRICT_EXPECTED_CALL(HMACSHA256_ComputeHash(IGNORED_PTR_ARG, sizeof(TEST_KEY_DATA), data_to_be_signed, data_len, TEST_BUFFER_HANDLE));
-            STRICT_EXPECTED_CALL(BUFFER_length(TEST_BUFFER_HANDLE));
-            STRICT_EXPECTED_CALL(BUFFER_u_char(TEST_BUFFER_HANDLE));
-            STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(TEST_DIGEST_DATA)));
-            // note BUFFER_delete does not fail
-            //STRICT_EXPECTED_CALL(BUFFER_delete(TEST_BUFFER_HANDLE));
+            STRICT_EXPECTED_CALL(gballoc_malloc(HSM_HMAC_DIGEST_SIZE));
 
             umock_c_negative_tests_snapshot();
 
@@ -429,7 +375,7 @@ BEGIN_TEST_SUITE(edge_hsm_key_interface_sas_key_unittests)
                 umock_c_negative_tests_fail_call(i);
 
                 // act
-                status = key_if->hsm_client_key_sign(key_handle, data_to_be_signed, data_len, &digest, &digest_size);
+                status = key_if->hsm_client_key_sign(key_handle, TEST_DATA_TO_BE_SIGNED, TEST_DATA_TO_BE_SIGNED_SIZE, &digest, &digest_size);
 
                 // assert
                 ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
@@ -507,8 +453,6 @@ BEGIN_TEST_SUITE(edge_hsm_key_interface_sas_key_unittests)
         {
             // arrange
             int status;
-            unsigned char data_to_be_signed[] = "data";
-            size_t data_len = sizeof(data_to_be_signed);
             unsigned char* digest = NULL;
             size_t digest_size = 0;
             unsigned char identity[] = "identity";
@@ -517,24 +461,10 @@ BEGIN_TEST_SUITE(edge_hsm_key_interface_sas_key_unittests)
             KEY_HANDLE key_handle = test_helper_create_key(TEST_KEY_DATA, sizeof(TEST_KEY_DATA));
             umock_c_reset_all_calls();
 
-            EXPECTED_CALL(BUFFER_new())
-                .SetReturn(TEST_BUFFER_HANDLE);
-            STRICT_EXPECTED_CALL(HMACSHA256_ComputeHash(IGNORED_PTR_ARG, sizeof(TEST_KEY_DATA), identity, identity_size, TEST_BUFFER_HANDLE));
-            STRICT_EXPECTED_CALL(BUFFER_length(TEST_BUFFER_HANDLE));
-            STRICT_EXPECTED_CALL(BUFFER_u_char(TEST_BUFFER_HANDLE));
-            STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(TEST_DIGEST_DATA)));
-            STRICT_EXPECTED_CALL(BUFFER_delete(TEST_BUFFER_HANDLE));
-            EXPECTED_CALL(BUFFER_new())
-                .SetReturn(TEST_DERIVED_BUFFER_HANDLE);
-            STRICT_EXPECTED_CALL(HMACSHA256_ComputeHash(IGNORED_PTR_ARG, sizeof(TEST_DIGEST_DATA), data_to_be_signed, data_len, TEST_DERIVED_BUFFER_HANDLE));
-            STRICT_EXPECTED_CALL(BUFFER_length(TEST_DERIVED_BUFFER_HANDLE));
-            STRICT_EXPECTED_CALL(BUFFER_u_char(TEST_DERIVED_BUFFER_HANDLE));
-            STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(TEST_DERIVED_DIGEST_DATA)));
-            STRICT_EXPECTED_CALL(BUFFER_delete(TEST_DERIVED_BUFFER_HANDLE));
-            EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+            STRICT_EXPECTED_CALL(gballoc_malloc(HSM_HMAC_DIGEST_SIZE));
 
             // act
-            status = key_if->hsm_client_key_derive_and_sign(key_handle, data_to_be_signed, data_len, identity, identity_size, &digest, &digest_size);
+            status = key_if->hsm_client_key_derive_and_sign(key_handle, TEST_DATA_TO_BE_SIGNED, TEST_DATA_TO_BE_SIGNED_SIZE, identity, identity_size, &digest, &digest_size);
 
             // assert
             ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
@@ -548,66 +478,64 @@ BEGIN_TEST_SUITE(edge_hsm_key_interface_sas_key_unittests)
             test_helper_destroy_key(key_handle);
         }
 
+        TEST_FUNCTION(hsm_client_key_derive_and_sign_interface_repeat_success)
+        {
+            // arrange
+            int status;
+            unsigned char* digest = NULL;
+            size_t digest_size = 0;
+            unsigned char identity[] = "identity";
+            size_t identity_size = sizeof(identity);
+            const HSM_CLIENT_KEY_INTERFACE* key_if = hsm_client_key_interface();
+            KEY_HANDLE key_handle = test_helper_create_key(TEST_KEY_DATA, sizeof(TEST_KEY_DATA));
+            status = key_if->hsm_client_key_derive_and_sign(key_handle, TEST_DATA_TO_BE_SIGNED, TEST_DATA_TO_BE_SIGNED_SIZE, identity, identity_size, &digest, &digest_size);
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+            test_hook_gballoc_free(digest);
+            umock_c_reset_all_calls();
+
+            STRICT_EXPECTED_CALL(gballoc_malloc(HSM_HMAC_DIGEST_SIZE));
+
+            // act
+            status = key_if->hsm_client_key_derive_and_sign(key_handle, TEST_DATA_TO_BE_SIGNED, TEST_DATA_TO_BE_SIGNED_SIZE, identity, identity_size, &digest, &digest_size);
+
+            // assert
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+            status = memcmp(TEST_DERIVED_DIGEST_DATA, digest, sizeof(TEST_DERIVED_DIGEST_DATA));
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+            ASSERT_ARE_EQUAL_WITH_MSG(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls(), "Line:" TOSTRING(__LINE__));
+
+            // cleanup
+            test_hook_gballoc_free(digest);
+            test_helper_destroy_key(key_handle);
+        }
+
         TEST_FUNCTION(hsm_client_key_derive_and_sign_interface_negative)
         {
             //arrange
             int test_result = umock_c_negative_tests_init();
             ASSERT_ARE_EQUAL(int, 0, test_result);
             int status;
-            unsigned char data_to_be_signed[] = "data";
-            size_t data_len = sizeof(data_to_be_signed);
             unsigned char* digest = NULL;
             size_t digest_size = 0;
             unsigned char identity[] = "identity";
             size_t identity_size = sizeof(identity);
             const HSM_CLIENT_KEY_INTERFACE* key_if = hsm_client_key_interface();
             KEY_HANDLE key_handle = test_helper_create_key(TEST_KEY_DATA, sizeof(TEST_KEY_DATA));
-            uint64_t failedFunctionBitmask = 0;
-            size_t i = 0;
             umock_c_reset_all_calls();
 
-            EXPECTED_CALL(BUFFER_new())
-                .SetReturn(TEST_BUFFER_HANDLE);
-            failedFunctionBitmask |= ((uint64_t)1 << i++);
-            STRICT_EXPECTED_CALL(HMACSHA256_ComputeHash(IGNORED_PTR_ARG, sizeof(TEST_KEY_DATA), identity, identity_size, TEST_BUFFER_HANDLE));
-            failedFunctionBitmask |= ((uint64_t)1 << i++);
-            STRICT_EXPECTED_CALL(BUFFER_length(TEST_BUFFER_HANDLE));
-            failedFunctionBitmask |= ((uint64_t)1 << i++);
-            STRICT_EXPECTED_CALL(BUFFER_u_char(TEST_BUFFER_HANDLE));
-            failedFunctionBitmask |= ((uint64_t)1 << i++);
-            STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(TEST_DIGEST_DATA)));
-            failedFunctionBitmask |= ((uint64_t)1 << i++);
-            STRICT_EXPECTED_CALL(BUFFER_delete(TEST_BUFFER_HANDLE));
-            i++;
-            EXPECTED_CALL(BUFFER_new())
-                .SetReturn(TEST_DERIVED_BUFFER_HANDLE);
-            failedFunctionBitmask |= ((uint64_t)1 << i++);
-            STRICT_EXPECTED_CALL(HMACSHA256_ComputeHash(IGNORED_PTR_ARG, sizeof(TEST_DIGEST_DATA), data_to_be_signed, data_len, TEST_DERIVED_BUFFER_HANDLE));
-            failedFunctionBitmask |= ((uint64_t)1 << i++);
-            STRICT_EXPECTED_CALL(BUFFER_length(TEST_DERIVED_BUFFER_HANDLE));
-            failedFunctionBitmask |= ((uint64_t)1 << i++);
-            STRICT_EXPECTED_CALL(BUFFER_u_char(TEST_DERIVED_BUFFER_HANDLE));
-            failedFunctionBitmask |= ((uint64_t)1 << i++);
-            STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(TEST_DERIVED_DIGEST_DATA)));
-            failedFunctionBitmask |= ((uint64_t)1 << i++);
-            STRICT_EXPECTED_CALL(BUFFER_delete(TEST_DERIVED_BUFFER_HANDLE));
-            i++;
-            EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
-            i++;
+            STRICT_EXPECTED_CALL(gballoc_malloc(HSM_HMAC_DIGEST_SIZE));
             umock_c_negative_tests_snapshot();
 
-            for (i = 0; i < umock_c_negative_tests_call_count(); i++)
+            for (size_t i = 0; i < umock_c_negative_tests_call_count(); i++)
             {
                 umock_c_negative_tests_reset();
                 umock_c_negative_tests_fail_call(i);
-                if (failedFunctionBitmask & ((uint64_t)1 << i))
-                {
-                    // act
-                    status = key_if->hsm_client_key_derive_and_sign(key_handle, data_to_be_signed, data_len, identity, identity_size, &digest, &digest_size);
-
-                    // assert
-                    ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
-                }
+
+                // act
+                status = key_if->hsm_client_key_derive_and_sign(key_handle, TEST_DATA_TO_BE_SIGNED, TEST_DATA_TO_BE_SIGNED_SIZE, identity, identity_size, &digest, &digest_size);
+
+                // assert
+                ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
             }
 
             //cleanup
@@ -615,4 +543,265 @@ BEGIN_TEST_SUITE(edge_hsm_key_interface_sas_key_unittests)
             umock_c_negative_tests_deinit();
         }
 
+        TEST_FUNCTION(hsm_client_key_sign_into_interface_success)
+        {
+            // arrange
+            int status;
+            unsigned char digest[HSM_HMAC_DIGEST_SIZE + 1];
+            size_t digest_size = sizeof(digest);
+            const HSM_CLIENT_KEY_INTERFACE* key_if = hsm_client_key_interface();
+            KEY_HANDLE key_handle = test_helper_create_key(TEST_KEY_DATA, sizeof(TEST_KEY_DATA));
+            umock_c_reset_all_calls();
+
+            // act
+            status = key_if->hsm_client_key_sign_into(key_handle, TEST_DATA_TO_BE_SIGNED, TEST_DATA_TO_BE_SIGNED_SIZE, digest, &digest_size);
+
+            // assert
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+            ASSERT_ARE_EQUAL_WITH_MSG(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls(), "Line:" TOSTRING(__LINE__));
+            ASSERT_ARE_EQUAL_WITH_MSG(size_t, sizeof(TEST_DIGEST_DATA), digest_size, "Line:" TOSTRING(__LINE__));
+            status = memcmp(TEST_DIGEST_DATA, digest, sizeof(TEST_DIGEST_DATA));
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+
+            // cleanup
+            test_helper_destroy_key(key_handle);
+        }
+
+        TEST_FUNCTION(hsm_client_key_sign_into_interface_returns_size)
+        {
+            // arrange
+            int status;
+            unsigned char digest[HSM_HMAC_DIGEST_SIZE - 1];
+            size_t digest_size = 0;
+            const HSM_CLIENT_KEY_INTERFACE* key_if = hsm_client_key_interface();
+            KEY_HANDLE key_handle = test_helper_create_key(TEST_KEY_DATA, sizeof(TEST_KEY_DATA));
+            umock_c_reset_all_calls();
+
+            // act, assert
+            status = key_if->hsm_client_key_sign_into(key_handle, TEST_DATA_TO_BE_SIGNED, TEST_DATA_TO_BE_SIGNED_SIZE, NULL, &digest_size);
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+            ASSERT_ARE_EQUAL_WITH_MSG(size_t, HSM_HMAC_DIGEST_SIZE, digest_size, "Line:" TOSTRING(__LINE__));
+
+            digest_size = sizeof(digest);
+            status = key_if->hsm_client_key_sign_into(key_handle, TEST_DATA_TO_BE_SIGNED, TEST_DATA_TO_BE_SIGNED_SIZE, digest, &digest_size);
+            ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+            ASSERT_ARE_EQUAL_WITH_MSG(size_t, HSM_HMAC_DIGEST_SIZE, digest_size, "Line:" TOSTRING(__LINE__));
+
+            status = key_if->hsm_client_key_sign_into(key_handle, TEST_DATA_TO_BE_SIGNED, TEST_DATA_TO_BE_SIGNED_SIZE, digest, NULL);
+            ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+
+            // cleanup
+            test_helper_destroy_key(key_handle);
+        }
+
+        TEST_FUNCTION(hsm_client_key_derive_and_sign_into_interface_success)
+        {
+            // arrange
+            int status;
+            unsigned char digest[HSM_HMAC_DIGEST_SIZE];
+            size_t digest_size = sizeof(digest);
+            unsigned char identity[] = "identity";
+            size_t identity_size = sizeof(identity);
+            const HSM_CLIENT_KEY_INTERFACE* key_if = hsm_client_key_interface();
+            KEY_HANDLE key_handle = test_helper_create_key(TEST_KEY_DATA, sizeof(TEST_KEY_DATA));
+            umock_c_reset_all_calls();
+
+            // act
+            status = key_if->hsm_client_key_derive_and_sign_into(key_handle, TEST_DATA_TO_BE_SIGNED, TEST_DATA_TO_BE_SIGNED_SIZE, identity, identity_size, digest, &digest_size);
+
+            // assert
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+            ASSERT_ARE_EQUAL_WITH_MSG(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls(), "Line:" TOSTRING(__LINE__));
+            ASSERT_ARE_EQUAL_WITH_MSG(size_t, sizeof(TEST_DERIVED_DIGEST_DATA), digest_size, "Line:" TOSTRING(__LINE__));
+            status = memcmp(TEST_DERIVED_DIGEST_DATA, digest, sizeof(TEST_DERIVED_DIGEST_DATA));
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+
+            // cleanup
+            test_helper_destroy_key(key_handle);
+        }
+
+        TEST_FUNCTION(hsm_client_key_sign_batch_interface_success)
+        {
+            // arrange
+            int status;
+            size_t index;
+            HSM_SIGN_REQUEST requests[TEST_BATCH_SIZE];
+            unsigned char digests[TEST_BATCH_SIZE * HSM_HMAC_DIGEST_SIZE];
+            size_t digest_size = sizeof(digests);
+            const HSM_CLIENT_KEY_INTERFACE* key_if = hsm_client_key_interface();
+            KEY_HANDLE key_handle = test_helper_create_key(TEST_KEY_DATA, sizeof(TEST_KEY_DATA));
+            for (index = 0; index < TEST_BATCH_SIZE; index++)
+            {
+                requests[index].data = TEST_DATA_TO_BE_SIGNED;
+                requests[index].data_size = TEST_DATA_TO_BE_SIGNED_SIZE;
+                requests[index].identity = NULL;
+                requests[index].identity_size = 0;
+            }
+            umock_c_reset_all_calls();
+
+            // act
+            status = key_if->hsm_client_key_sign_batch(key_handle, requests, TEST_BATCH_SIZE, digests, &digest_size);
+
+            // assert
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+            ASSERT_ARE_EQUAL_WITH_MSG(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls(), "Line:" TOSTRING(__LINE__));
+            ASSERT_ARE_EQUAL_WITH_MSG(size_t, sizeof(TEST_DIGEST_DATA), digest_size, "Line:" TOSTRING(__LINE__));
+            for (index = 0; index < TEST_BATCH_SIZE; index++)
+            {
+                status = memcmp(TEST_DIGEST_DATA, digests + (index * HSM_HMAC_DIGEST_SIZE), sizeof(TEST_DIGEST_DATA));
+                ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+            }
+
+            // cleanup
+            test_helper_destroy_key(key_handle);
+        }
+
+        TEST_FUNCTION(hsm_client_key_sign_batch_interface_returns_size)
+        {
+            // arrange
+            int status;
+            unsigned char test_input[] = {'t', 'e', 's', 't'};
+            HSM_SIGN_REQUEST requests[2] = {
+                { test_input, sizeof(test_input), NULL, 0 },
+                { test_input, sizeof(test_input), NULL, 0 }
+            };
+            unsigned char digests[(2 * HSM_HMAC_DIGEST_SIZE) - 1];
+            size_t digest_size = 0;
+            const HSM_CLIENT_KEY_INTERFACE* key_if = hsm_client_key_interface();
+            KEY_HANDLE key_handle = test_helper_create_key(TEST_KEY_DATA, sizeof(TEST_KEY_DATA));
+            umock_c_reset_all_calls();
+
+            // act, assert
+            status = key_if->hsm_client_key_sign_batch(key_handle, requests, 2, NULL, &digest_size);
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+            ASSERT_ARE_EQUAL_WITH_MSG(size_t, HSM_HMAC_DIGEST_SIZE, digest_size, "Line:" TOSTRING(__LINE__));
+
+            digest_size = sizeof(digests);
+            status = key_if->hsm_client_key_sign_batch(key_handle, requests, 2, digests, &digest_size);
+            ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+            ASSERT_ARE_EQUAL_WITH_MSG(size_t, HSM_HMAC_DIGEST_SIZE, digest_size, "Line:" TOSTRING(__LINE__));
+
+            status = key_if->hsm_client_key_sign_batch(key_handle, requests, 0, digests, &digest_size);
+            ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+
+            status = key_if->hsm_client_key_sign_batch(key_handle, requests, 2, digests, NULL);
+            ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+
+            // cleanup
+            test_helper_destroy_key(key_handle);
+        }
+
+        TEST_FUNCTION(hsm_client_key_derive_and_sign_batch_interface_success)
+        {
+            // arrange
+            int status;
+            size_t index;
+            unsigned char identity[] = "identity";
+            HSM_SIGN_REQUEST requests[TEST_BATCH_SIZE];
+            unsigned char digests[TEST_BATCH_SIZE * HSM_HMAC_DIGEST_SIZE];
+            size_t digest_size = sizeof(digests);
+            const HSM_CLIENT_KEY_INTERFACE* key_if = hsm_client_key_interface();
+            KEY_HANDLE key_handle = test_helper_create_key(TEST_KEY_DATA, sizeof(TEST_KEY_DATA));
+            for (index = 0; index < TEST_BATCH_SIZE; index++)
+            {
+                requests[index].data = TEST_DATA_TO_BE_SIGNED;
+                requests[index].data_size = TEST_DATA_TO_BE_SIGNED_SIZE;
+                requests[index].identity = identity;
+                requests[index].identity_size = sizeof(identity);
+            }
+            umock_c_reset_all_calls();
+
+            // act
+            status = key_if->hsm_client_key_derive_and_sign_batch(key_handle, requests, TEST_BATCH_SIZE, digests, &digest_size);
+
+            // assert
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+            ASSERT_ARE_EQUAL_WITH_MSG(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls(), "Line:" TOSTRING(__LINE__));
+            ASSERT_ARE_EQUAL_WITH_MSG(size_t, sizeof(TEST_DERIVED_DIGEST_DATA), digest_size, "Line:" TOSTRING(__LINE__));
+            for (index = 0; index < TEST_BATCH_SIZE; index++)
+            {
+                status = memcmp(TEST_DERIVED_DIGEST_DATA, digests + (index * HSM_HMAC_DIGEST_SIZE), sizeof(TEST_DERIVED_DIGEST_DATA));
+                ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+            }
+
+            // cleanup
+            test_helper_destroy_key(key_handle);
+        }
+
+        TEST_FUNCTION(hsm_client_key_stream_interface_unsupported)
+        {
+            // arrange
+            int status;
+            unsigned char identity[] = "identity";
+            unsigned char iv[] = "iv";
+            SIZED_BUFFER id_buffer = {identity, sizeof(identity)};
+            SIZED_BUFFER iv_buffer = {iv, sizeof(iv)};
+            KEY_STREAM_HANDLE stream = (KEY_STREAM_HANDLE)0x1000;
+            size_t output_size = 10;
+            const HSM_CLIENT_KEY_INTERFACE* key_if = hsm_client_key_interface();
+            KEY_HANDLE key_handle = test_helper_create_key(TEST_KEY_DATA, sizeof(TEST_KEY_DATA));
+            umock_c_reset_all_calls();
+
+            // act, assert
+            status = key_if->hsm_client_key_encrypt_init(key_handle, &id_buffer, &iv_buffer, &stream);
+            ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+            ASSERT_IS_NULL_WITH_MSG(stream, "Line:" TOSTRING(__LINE__));
+
+            stream = (KEY_STREAM_HANDLE)0x1000;
+            status = key_if->hsm_client_key_decrypt_init(key_handle, &id_buffer, &iv_buffer, &stream);
+            ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+            ASSERT_IS_NULL_WITH_MSG(stream, "Line:" TOSTRING(__LINE__));
+
+            status = key_if->hsm_client_key_stream_update(key_handle, NULL, iv, sizeof(iv), NULL, &output_size);
+            ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+            ASSERT_ARE_EQUAL_WITH_MSG(size_t, 0, output_size, "Line:" TOSTRING(__LINE__));
+
+            output_size = 10;
+            status = key_if->hsm_client_key_stream_final(key_handle, NULL, NULL, &output_size);
+            ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+            ASSERT_ARE_EQUAL_WITH_MSG(size_t, 0, output_size, "Line:" TOSTRING(__LINE__));
+            ASSERT_ARE_EQUAL_WITH_MSG(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls(), "Line:" TOSTRING(__LINE__));
+
+            // cleanup
+            test_helper_destroy_key(key_handle);
+        }
+
+        TEST_FUNCTION(hsm_client_key_stream_interface_invalid_params)
+        {
+            // arrange
+            int status;
+            unsigned char identity[] = "identity";
+            unsigned char iv[] = "iv";
+            SIZED_BUFFER id_buffer = {identity, sizeof(identity)};
+            SIZED_BUFFER iv_buffer = {iv, sizeof(iv)};
+            SIZED_BUFFER empty_buffer = {NULL, 0};
+            KEY_STREAM_HANDLE stream = NULL;
+            const HSM_CLIENT_KEY_INTERFACE* key_if = hsm_client_key_interface();
+            KEY_HANDLE key_handle = test_helper_create_key(TEST_KEY_DATA, sizeof(TEST_KEY_DATA));
+            umock_c_reset_all_calls();
+
+            // act, assert
+            status = key_if->hsm_client_key_encrypt_init(NULL, &id_buffer, &iv_buffer, &stream);
+            ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+
+            status = key_if->hsm_client_key_encrypt_init(key_handle, &empty_buffer, &iv_buffer, &stream);
+            ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+
+            status = key_if->hsm_client_key_decrypt_init(key_handle, &id_buffer, &empty_buffer, &stream);
+            ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+
+            status = key_if->hsm_client_key_decrypt_init(key_handle, &id_buffer, &iv_buffer, NULL);
+            ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+
+            status = key_if->hsm_client_key_stream_update(key_handle, (KEY_STREAM_HANDLE)0x1000, NULL, 1, NULL, NULL);
+            ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+
+            status = key_if->hsm_client_key_stream_final(key_handle, (KEY_STREAM_HANDLE)0x1000, NULL, NULL);
+            ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+            ASSERT_ARE_EQUAL_WITH_MSG(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls(), "Line:" TOSTRING(__LINE__));
+
+            // cleanup
+            test_helper_destroy_key(key_handle);
+        }
+
 END_TEST_SUITE(edge_hsm_key_interface_sas_key_unittests)
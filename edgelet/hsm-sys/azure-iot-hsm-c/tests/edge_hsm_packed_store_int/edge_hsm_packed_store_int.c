@@ -0,0 +1,277 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "testrunnerswitcher.h"
+#include "azure_c_shared_utility/gballoc.h"
+#include "hsm_utils.h"
+
+//#############################################################################
+// Interface(s) under test
+//#############################################################################
+
+#include "hsm_packed_store.h"
+
+//#############################################################################
+// Test defines and data
+//#############################################################################
+
+#define TEST_PACKED_FILE "test_store.pack"
+#define TEST_CHURN_RECORD_SIZE 4096
+#define TEST_CHURN_COUNT 100
+
+static const unsigned char TEST_KEY_A[] = { 'k', 'e', 'y', 'A' };
+static const unsigned char TEST_KEY_A2[] = { 'k', 'e', 'y', 'A', '2' };
+static const unsigned char TEST_KEY_B[] = { 'k', 'e', 'y', 'B' };
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+//#############################################################################
+// Test helpers
+//#############################################################################
+
+static HSM_PACKED_STORE_HANDLE test_helper_reopen(HSM_PACKED_STORE_HANDLE handle)
+{
+    HSM_PACKED_STORE_HANDLE result;
+
+    hsm_packed_store_close(handle);
+    result = hsm_packed_store_open(TEST_PACKED_FILE);
+    ASSERT_IS_NOT_NULL_WITH_MSG(result, "Line:" TOSTRING(__LINE__));
+
+    return result;
+}
+
+static void test_helper_assert_record
+(
+    HSM_PACKED_STORE_HANDLE handle,
+    HSM_PACKED_RECORD_TYPE type,
+    const char *name,
+    const unsigned char *expected_data,
+    size_t expected_data_size
+)
+{
+    HSM_PACKED_RECORD record;
+    int status = hsm_packed_store_get(handle, type, name, &record);
+    ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+    ASSERT_ARE_EQUAL_WITH_MSG(size_t, expected_data_size, record.data_size, "Line:" TOSTRING(__LINE__));
+    ASSERT_ARE_EQUAL_WITH_MSG(int, 0, memcmp(expected_data, record.data, record.data_size), "Line:" TOSTRING(__LINE__));
+    hsm_packed_store_release(handle);
+}
+
+static void test_helper_assert_no_record
+(
+    HSM_PACKED_STORE_HANDLE handle,
+    HSM_PACKED_RECORD_TYPE type,
+    const char *name
+)
+{
+    HSM_PACKED_RECORD record;
+    int status = hsm_packed_store_get(handle, type, name, &record);
+    ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+}
+
+static void test_helper_append_raw(const char *data, size_t data_size)
+{
+    FILE *file_handle = fopen(TEST_PACKED_FILE, "ab");
+    ASSERT_IS_NOT_NULL_WITH_MSG(file_handle, "Line:" TOSTRING(__LINE__));
+    ASSERT_ARE_EQUAL_WITH_MSG(size_t, data_size, fwrite(data, 1, data_size, file_handle), "Line:" TOSTRING(__LINE__));
+    fclose(file_handle);
+}
+
+static HSM_PACKED_STORE_HANDLE test_helper_create_store(void)
+{
+    HSM_PACKED_STORE_HANDLE result;
+
+    (void)remove(TEST_PACKED_FILE);
+    result = hsm_packed_store_open(TEST_PACKED_FILE);
+    ASSERT_IS_NOT_NULL_WITH_MSG(result, "Line:" TOSTRING(__LINE__));
+    ASSERT_ARE_EQUAL(int, 0, hsm_packed_store_put(result, HSM_PACKED_RECORD_ENC_KEY, "a", TEST_KEY_A, sizeof(TEST_KEY_A)));
+    ASSERT_ARE_EQUAL(int, 0, hsm_packed_store_put(result, HSM_PACKED_RECORD_ENC_KEY, "b", TEST_KEY_B, sizeof(TEST_KEY_B)));
+
+    return result;
+}
+
+//#############################################################################
+// Test cases
+//#############################################################################
+
+BEGIN_TEST_SUITE(edge_hsm_packed_store_int_tests)
+
+        TEST_SUITE_INITIALIZE(TestClassInitialize)
+        {
+            TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+            g_testByTest = TEST_MUTEX_CREATE();
+            ASSERT_IS_NOT_NULL(g_testByTest);
+        }
+
+        TEST_SUITE_CLEANUP(TestClassCleanup)
+        {
+            (void)remove(TEST_PACKED_FILE);
+            TEST_MUTEX_DESTROY(g_testByTest);
+            TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+        }
+
+        TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+        {
+            if (TEST_MUTEX_ACQUIRE(g_testByTest))
+            {
+                ASSERT_FAIL("Mutex is ABANDONED. Failure in test framework.");
+            }
+        }
+
+        TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+        {
+            TEST_MUTEX_RELEASE(g_testByTest);
+        }
+
+        TEST_FUNCTION(hsm_packed_store_open_invalid_params)
+        {
+            // act, assert
+            ASSERT_IS_NULL(hsm_packed_store_open(NULL));
+            ASSERT_IS_NULL(hsm_packed_store_open(""));
+        }
+
+        TEST_FUNCTION(hsm_packed_store_put_get_smoke)
+        {
+            // arrange
+            HSM_PACKED_STORE_HANDLE handle = test_helper_create_store();
+
+            // act, assert
+            test_helper_assert_record(handle, HSM_PACKED_RECORD_ENC_KEY, "a", TEST_KEY_A, sizeof(TEST_KEY_A));
+            test_helper_assert_record(handle, HSM_PACKED_RECORD_ENC_KEY, "b", TEST_KEY_B, sizeof(TEST_KEY_B));
+            test_helper_assert_no_record(handle, HSM_PACKED_RECORD_ENC_KEY, "c");
+
+            // cleanup
+            hsm_packed_store_close(handle);
+        }
+
+        TEST_FUNCTION(hsm_packed_store_records_persist_across_open)
+        {
+            // arrange
+            HSM_PACKED_STORE_HANDLE handle = test_helper_create_store();
+            ASSERT_ARE_EQUAL(int, 0, hsm_packed_store_put(handle, HSM_PACKED_RECORD_ENC_KEY, "a", TEST_KEY_A2, sizeof(TEST_KEY_A2)));
+            ASSERT_ARE_EQUAL(int, 0, hsm_packed_store_remove(handle, HSM_PACKED_RECORD_ENC_KEY, "b"));
+
+            // act
+            handle = test_helper_reopen(handle);
+
+            // assert
+            test_helper_assert_record(handle, HSM_PACKED_RECORD_ENC_KEY, "a", TEST_KEY_A2, sizeof(TEST_KEY_A2));
+            test_helper_assert_no_record(handle, HSM_PACKED_RECORD_ENC_KEY, "b");
+
+            // cleanup
+            hsm_packed_store_close(handle);
+        }
+
+        TEST_FUNCTION(hsm_packed_store_compact_keeps_live_records)
+        {
+            // arrange
+            HSM_PACKED_STORE_HANDLE handle = test_helper_create_store();
+            ASSERT_ARE_EQUAL(int, 0, hsm_packed_store_remove(handle, HSM_PACKED_RECORD_ENC_KEY, "b"));
+
+            // act
+            int status = hsm_packed_store_compact(handle);
+            handle = test_helper_reopen(handle);
+
+            // assert
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+            test_helper_assert_record(handle, HSM_PACKED_RECORD_ENC_KEY, "a", TEST_KEY_A, sizeof(TEST_KEY_A));
+            test_helper_assert_no_record(handle, HSM_PACKED_RECORD_ENC_KEY, "b");
+
+            // cleanup
+            hsm_packed_store_close(handle);
+        }
+
+        TEST_FUNCTION(hsm_packed_store_torn_tail_is_discarded)
+        {
+            // arrange
+            static const char garbage[] = "garbagegarbagegarbagegarbage";
+            HSM_PACKED_STORE_HANDLE handle = test_helper_create_store();
+            hsm_packed_store_close(handle);
+            test_helper_append_raw(garbage, sizeof(garbage) - 1);
+
+            // act
+            handle = hsm_packed_store_open(TEST_PACKED_FILE);
+            ASSERT_IS_NOT_NULL_WITH_MSG(handle, "Line:" TOSTRING(__LINE__));
+            int status = hsm_packed_store_put(handle, HSM_PACKED_RECORD_ENC_KEY, "c", TEST_KEY_B, sizeof(TEST_KEY_B));
+            handle = test_helper_reopen(handle);
+
+            // assert
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+            test_helper_assert_record(handle, HSM_PACKED_RECORD_ENC_KEY, "a", TEST_KEY_A, sizeof(TEST_KEY_A));
+            test_helper_assert_record(handle, HSM_PACKED_RECORD_ENC_KEY, "c", TEST_KEY_B, sizeof(TEST_KEY_B));
+
+            // cleanup
+            hsm_packed_store_close(handle);
+        }
+
+        TEST_FUNCTION(hsm_packed_store_overwrites_are_compacted)
+        {
+            // arrange
+            static unsigned char data[TEST_CHURN_RECORD_SIZE];
+            HSM_FILE_STAMP stamp;
+            int index, status = 0;
+            HSM_PACKED_STORE_HANDLE handle = test_helper_create_store();
+            memset(data, 'x', sizeof(data));
+
+            // act
+            for (index = 0; (index < TEST_CHURN_COUNT) && (status == 0); index++)
+            {
+                status = hsm_packed_store_put(handle, HSM_PACKED_RECORD_ENC_KEY, "churn", data, sizeof(data));
+            }
+
+            // assert
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, get_file_stamp(TEST_PACKED_FILE, &stamp), "Line:" TOSTRING(__LINE__));
+            ASSERT_IS_TRUE_WITH_MSG(stamp.size < (TEST_CHURN_COUNT * TEST_CHURN_RECORD_SIZE) / 2, "Line:" TOSTRING(__LINE__));
+            test_helper_assert_record(handle, HSM_PACKED_RECORD_ENC_KEY, "churn", data, sizeof(data));
+
+            // cleanup
+            hsm_packed_store_close(handle);
+        }
+
+        TEST_FUNCTION(hsm_packed_store_corrupt_header_fails_open)
+        {
+            // arrange
+            FILE *file_handle;
+            HSM_PACKED_STORE_HANDLE handle = test_helper_create_store();
+            ASSERT_ARE_EQUAL(int, 0, hsm_packed_store_compact(handle));
+            hsm_packed_store_close(handle);
+            file_handle = fopen(TEST_PACKED_FILE, "r+b");
+            ASSERT_IS_NOT_NULL_WITH_MSG(file_handle, "Line:" TOSTRING(__LINE__));
+            (void)fputc('X', file_handle);
+            fclose(file_handle);
+
+            // act
+            handle = hsm_packed_store_open(TEST_PACKED_FILE);
+
+            // assert
+            ASSERT_IS_NULL_WITH_MSG(handle, "Line:" TOSTRING(__LINE__));
+        }
+
+        TEST_FUNCTION(hsm_packed_store_import_file_smoke)
+        {
+            // arrange
+            static const char *import_file = "test_store_import.enc.key";
+            HSM_PACKED_STORE_HANDLE handle = test_helper_create_store();
+            ASSERT_ARE_EQUAL(int, 0, write_buffer_to_file(import_file, TEST_KEY_A2, sizeof(TEST_KEY_A2), false));
+
+            // act
+            int status = hsm_packed_store_import_file(handle, HSM_PACKED_RECORD_ENC_KEY, "a", import_file);
+
+            // assert
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+            test_helper_assert_record(handle, HSM_PACKED_RECORD_ENC_KEY, "a", TEST_KEY_A2, sizeof(TEST_KEY_A2));
+
+            // cleanup
+            hsm_packed_store_close(handle);
+            (void)delete_file(import_file);
+        }
+
+END_TEST_SUITE(edge_hsm_packed_store_int_tests)
@@ -430,4 +430,60 @@ BEGIN_TEST_SUITE(edge_hsm_sas_auth_int_tests)
         tpm_deprovision(hsm_handle);
     }
 
+    // This tests the following:
+    //  1) A well known identity key K can be installed in the TPM
+    //  2) A batch derive and sign request for the primary and secondary
+    //     module identities returns, in order and in one buffer, the same
+    //     digests as would be obtained by signing each request individually
+    TEST_FUNCTION(hsm_client_key_interface_derive_and_sign_batch_matches_individual_signs)
+    {
+        // arrange
+        unsigned char test_data_to_be_signed[] = TEST_DATA_TO_BE_SIGNED;
+        size_t test_data_to_be_signed_size = sizeof(test_data_to_be_signed);
+        char primary_fqmid[] = TEST_HOSTNAME "/devices/" TEST_DEVICE_ID "/modules/" \
+                               TEST_MODULE_ID "/" PRIMARY_URI "/" TEST_GEN_ID;
+        char secondary_fqmid[] = TEST_HOSTNAME "/devices/" TEST_DEVICE_ID "/modules/" \
+                                 TEST_MODULE_ID "/" SECONDARY_URI "/" TEST_GEN_ID;
+        char test_key[] = TEST_KEY_BASE64;
+        BUFFER_HANDLE decoded_key = test_helper_base64_converter(test_key);
+        HSM_SIGN_REQUEST requests[2] = {
+            { test_data_to_be_signed, test_data_to_be_signed_size,
+              (unsigned char*)primary_fqmid, strlen(primary_fqmid) },
+            { test_data_to_be_signed, test_data_to_be_signed_size,
+              (unsigned char*)secondary_fqmid, strlen(secondary_fqmid) }
+        };
+        const HSM_CLIENT_TPM_INTERFACE* interface = hsm_client_tpm_interface();
+        unsigned char *digests = NULL;
+        size_t digest_size = 0;
+        BUFFER_HANDLE test_expected_primary_digest = BUFFER_new();
+        ASSERT_IS_NOT_NULL_WITH_MSG(test_expected_primary_digest, "Line:" TOSTRING(__LINE__));
+        BUFFER_HANDLE test_expected_secondary_digest = BUFFER_new();
+        ASSERT_IS_NOT_NULL_WITH_MSG(test_expected_secondary_digest, "Line:" TOSTRING(__LINE__));
+        HSM_CLIENT_HANDLE hsm_handle = test_helper_init_tpm_and_activate_key(decoded_key);
+
+        // compute expected result
+        tpm_sign(hsm_handle, (unsigned char*)primary_fqmid, strlen(primary_fqmid),
+                 test_data_to_be_signed, test_data_to_be_signed_size, test_expected_primary_digest);
+        tpm_sign(hsm_handle, (unsigned char*)secondary_fqmid, strlen(secondary_fqmid),
+                 test_data_to_be_signed, test_data_to_be_signed_size, test_expected_secondary_digest);
+
+        // act
+        int status = interface->hsm_client_derive_and_sign_batch(hsm_handle, requests, 2,
+                                                                 &digests, &digest_size);
+
+        // assert
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        ASSERT_IS_NOT_NULL_WITH_MSG(digests, "Line:" TOSTRING(__LINE__));
+        ASSERT_ARE_EQUAL_WITH_MSG(size_t, BUFFER_length(test_expected_primary_digest), digest_size, "Line:" TOSTRING(__LINE__));
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, memcmp(BUFFER_u_char(test_expected_primary_digest), digests, digest_size), "Line:" TOSTRING(__LINE__));
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, memcmp(BUFFER_u_char(test_expected_secondary_digest), digests + digest_size, digest_size), "Line:" TOSTRING(__LINE__));
+
+        // cleanup
+        interface->hsm_client_free_buffer(digests);
+        BUFFER_delete(test_expected_primary_digest);
+        BUFFER_delete(test_expected_secondary_digest);
+        BUFFER_delete(decoded_key);
+        tpm_deprovision(hsm_handle);
+    }
+
 END_TEST_SUITE(edge_hsm_sas_auth_int_tests)
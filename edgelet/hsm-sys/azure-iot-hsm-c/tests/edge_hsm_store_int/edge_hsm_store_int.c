@@ -16,6 +16,7 @@
 #include "azure_c_shared_utility/buffer_.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/crt_abstractions.h"
+#include "azure_c_shared_utility/threadapi.h"
 #include "hsm_log.h"
 #include "hsm_utils.h"
 
@@ -31,6 +32,8 @@
 #define EDGE_STORE_NAME "blah"
 #define TEST_DATA_TO_BE_SIGNED "The quick brown fox jumped over the lazy dog"
 #define TEST_KEY_BASE64 "D7PuplFy7vIr0349blOugqCxyfMscyVZDoV9Ii0EFnA="
+#define TEST_NUM_THREADS 4
+#define TEST_NUM_ITERATIONS 100
 
 static TEST_MUTEX_HANDLE g_testByTest;
 static TEST_MUTEX_HANDLE g_dllByDll;
@@ -54,6 +57,16 @@ static void test_helper_setup_homedir(void)
 #endif
 }
 
+static void test_helper_set_env(const char *name, const char *value)
+{
+#if defined __WINDOWS__ || defined _WIN32 || defined _WIN64 || defined _Windows
+    errno_t status = _putenv_s(name, (value != NULL) ? value : "");
+#else
+    int status = (value != NULL) ? setenv(name, value, 1) : unsetenv(name);
+#endif
+    ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+}
+
 static CERT_PROPS_HANDLE test_helper_create_certificate_props
 (
     const char *common_name,
@@ -151,6 +164,162 @@ static void test_helper_sas_key_sign
     ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
 }
 
+static void test_helper_assert_derive_and_sign
+(
+    HSM_CLIENT_STORE_HANDLE store_handle,
+    BUFFER_HANDLE key,
+    const char *identity
+)
+{
+    unsigned char test_data_to_be_signed[] = TEST_DATA_TO_BE_SIGNED;
+    size_t test_data_to_be_signed_size = sizeof(test_data_to_be_signed);
+    BUFFER_HANDLE derived_key = test_helper_compute_hmac(key,
+                                                         (const unsigned char*)identity,
+                                                         strlen(identity));
+    BUFFER_HANDLE expected_digest = test_helper_compute_hmac(derived_key,
+                                                             test_data_to_be_signed,
+                                                             test_data_to_be_signed_size);
+    BUFFER_HANDLE output_digest = BUFFER_new();
+    ASSERT_IS_NOT_NULL_WITH_MSG(output_digest, "Line:" TOSTRING(__LINE__));
+
+    test_helper_sas_key_sign(store_handle,
+                             "my_sas_key",
+                             (const unsigned char*)identity, strlen(identity),
+                             test_data_to_be_signed, test_data_to_be_signed_size,
+                             output_digest);
+
+    ASSERT_ARE_EQUAL_WITH_MSG(size_t, BUFFER_length(expected_digest), BUFFER_length(output_digest), "Line:" TOSTRING(__LINE__));
+    ASSERT_ARE_EQUAL_WITH_MSG(int, 0, memcmp(BUFFER_u_char(expected_digest), BUFFER_u_char(output_digest), BUFFER_length(output_digest)), "Line:" TOSTRING(__LINE__));
+    BUFFER_delete(output_digest);
+    BUFFER_delete(expected_digest);
+    BUFFER_delete(derived_key);
+}
+
+// matches the 32 bit FNV-1a hash the store indexes aliases with
+static uint32_t test_helper_alias_hash(const char *alias)
+{
+    uint32_t result = 2166136261u;
+    const unsigned char *ptr = (const unsigned char*)alias;
+
+    while (*ptr != '\0')
+    {
+        result ^= *ptr;
+        result *= 16777619u;
+        ptr++;
+    }
+
+    return result;
+}
+
+// fills aliases with distinct aliases whose hashes share the low 6 bits so
+// that they probe the same slots in every index of up to 64 slots
+static void test_helper_find_colliding_aliases(char aliases[][32], size_t count)
+{
+    uint32_t candidate = 0;
+    uint32_t mask = 63;
+    uint32_t target = test_helper_alias_hash("collide_0") & mask;
+    size_t found = 0;
+
+    while (found < count)
+    {
+        char alias[32];
+        (void)snprintf(alias, sizeof(alias), "collide_%u", (unsigned)candidate++);
+        if ((test_helper_alias_hash(alias) & mask) == target)
+        {
+            (void)strcpy(aliases[found++], alias);
+        }
+    }
+}
+
+static void test_helper_insert_alias_sas_key(HSM_CLIENT_STORE_HANDLE store_handle, const char *alias)
+{
+    const HSM_CLIENT_STORE_INTERFACE *store_if = hsm_client_store_interface();
+    // each key is its own alias so a key found under the wrong alias is detected
+    int result = store_if->hsm_client_store_insert_sas_key(store_handle, alias,
+                                                           (const unsigned char*)alias, strlen(alias));
+    ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+}
+
+static void test_helper_assert_alias_sas_key(HSM_CLIENT_STORE_HANDLE store_handle, const char *alias)
+{
+    unsigned char test_data_to_be_signed[] = TEST_DATA_TO_BE_SIGNED;
+    size_t test_data_to_be_signed_size = sizeof(test_data_to_be_signed);
+    BUFFER_HANDLE key = BUFFER_create((const unsigned char*)alias, strlen(alias));
+    ASSERT_IS_NOT_NULL_WITH_MSG(key, "Line:" TOSTRING(__LINE__));
+    BUFFER_HANDLE expected_digest = test_helper_compute_hmac(key,
+                                                             test_data_to_be_signed,
+                                                             test_data_to_be_signed_size);
+    BUFFER_HANDLE output_digest = BUFFER_new();
+    ASSERT_IS_NOT_NULL_WITH_MSG(output_digest, "Line:" TOSTRING(__LINE__));
+
+    test_helper_sas_key_sign(store_handle, alias, NULL, 0,
+                             test_data_to_be_signed, test_data_to_be_signed_size,
+                             output_digest);
+
+    ASSERT_ARE_EQUAL_WITH_MSG(size_t, BUFFER_length(expected_digest), BUFFER_length(output_digest), "Line:" TOSTRING(__LINE__));
+    ASSERT_ARE_EQUAL_WITH_MSG(int, 0, memcmp(BUFFER_u_char(expected_digest), BUFFER_u_char(output_digest), BUFFER_length(output_digest)), "Line:" TOSTRING(__LINE__));
+    BUFFER_delete(output_digest);
+    BUFFER_delete(expected_digest);
+    BUFFER_delete(key);
+}
+
+static void test_helper_assert_no_sas_key(HSM_CLIENT_STORE_HANDLE store_handle, const char *alias)
+{
+    const HSM_CLIENT_STORE_INTERFACE *store_if = hsm_client_store_interface();
+    KEY_HANDLE key_handle = store_if->hsm_client_store_open_key(store_handle, HSM_KEY_SAS, alias);
+    ASSERT_IS_NULL_WITH_MSG(key_handle, "Line:" TOSTRING(__LINE__));
+}
+
+typedef struct TEST_SIGN_THREAD_ARGS_TAG
+{
+    HSM_CLIENT_STORE_HANDLE store_handle;
+    BUFFER_HANDLE expected_digest;
+} TEST_SIGN_THREAD_ARGS;
+
+// test assertions are not usable outside the main thread so this
+// returns the number of failed sign attempts instead
+static int test_helper_sign_thread(void *context)
+{
+    int failures = 0;
+    int iter;
+    TEST_SIGN_THREAD_ARGS *args = (TEST_SIGN_THREAD_ARGS*)context;
+    unsigned char test_data_to_be_signed[] = TEST_DATA_TO_BE_SIGNED;
+    const HSM_CLIENT_STORE_INTERFACE *store_if = hsm_client_store_interface();
+    const HSM_CLIENT_KEY_INTERFACE *key_if = hsm_client_key_interface();
+
+    for (iter = 0; iter < TEST_NUM_ITERATIONS; iter++)
+    {
+        unsigned char *digest = NULL;
+        size_t digest_size = 0;
+        KEY_HANDLE key_handle = store_if->hsm_client_store_open_key(args->store_handle,
+                                                                    HSM_KEY_SAS,
+                                                                    "my_sas_key");
+        if (key_handle == NULL)
+        {
+            failures++;
+        }
+        else
+        {
+            if ((key_if->hsm_client_key_sign(key_handle,
+                                             test_data_to_be_signed,
+                                             sizeof(test_data_to_be_signed),
+                                             &digest,
+                                             &digest_size) != 0) ||
+                (digest_size != BUFFER_length(args->expected_digest)) ||
+                (memcmp(BUFFER_u_char(args->expected_digest), digest, digest_size) != 0))
+            {
+                failures++;
+            }
+            free(digest);
+            if (store_if->hsm_client_store_close_key(args->store_handle, key_handle) != 0)
+            {
+                failures++;
+            }
+        }
+    }
+
+    return failures;
+}
 
 //#############################################################################
 // Test cases
@@ -312,6 +481,261 @@ BEGIN_TEST_SUITE(edge_hsm_store_int_tests)
         ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
     }
 
+    TEST_FUNCTION(open_key_handle_survives_key_overwrite_smoke)
+    {
+        // arrange
+        int result;
+        unsigned char *digest = NULL;
+        size_t digest_size = 0;
+        unsigned char test_data_to_be_signed[] = TEST_DATA_TO_BE_SIGNED;
+        size_t test_data_to_be_signed_size = sizeof(test_data_to_be_signed);
+        char test_key[] = TEST_KEY_BASE64;
+        BUFFER_HANDLE decoded_key = test_helper_base64_converter(test_key);
+        BUFFER_HANDLE test_expected_digest = test_helper_compute_hmac(decoded_key,
+                                                                      test_data_to_be_signed,
+                                                                      test_data_to_be_signed_size);
+        const HSM_CLIENT_STORE_INTERFACE *store_if = hsm_client_store_interface();
+        const HSM_CLIENT_KEY_INTERFACE *key_if = hsm_client_key_interface();
+        result = store_if->hsm_client_store_create(EDGE_STORE_NAME);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        HSM_CLIENT_STORE_HANDLE store_handle = store_if->hsm_client_store_open(EDGE_STORE_NAME);
+        ASSERT_IS_NOT_NULL_WITH_MSG(store_handle, "Line:" TOSTRING(__LINE__));
+        result = store_if->hsm_client_store_insert_sas_key(store_handle, "my_sas_key",
+                                                           BUFFER_u_char(decoded_key),
+                                                           BUFFER_length(decoded_key));
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+
+        // act
+        KEY_HANDLE key_handle_1 = store_if->hsm_client_store_open_key(store_handle, HSM_KEY_SAS, "my_sas_key");
+        KEY_HANDLE key_handle_2 = store_if->hsm_client_store_open_key(store_handle, HSM_KEY_SAS, "my_sas_key");
+        result = store_if->hsm_client_store_insert_sas_key(store_handle, "my_sas_key", "ABCD", 5);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        KEY_HANDLE key_handle_3 = store_if->hsm_client_store_open_key(store_handle, HSM_KEY_SAS, "my_sas_key");
+
+        // assert
+        ASSERT_IS_NOT_NULL_WITH_MSG(key_handle_1, "Line:" TOSTRING(__LINE__));
+        ASSERT_IS_NOT_NULL_WITH_MSG(key_handle_3, "Line:" TOSTRING(__LINE__));
+        ASSERT_ARE_EQUAL_WITH_MSG(void_ptr, key_handle_1, key_handle_2, "Line:" TOSTRING(__LINE__));
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(void_ptr, key_handle_1, key_handle_3, "Line:" TOSTRING(__LINE__));
+        result = store_if->hsm_client_store_close_key(store_handle, key_handle_2);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        // the handle opened before the overwrite still signs with the old key
+        result = key_if->hsm_client_key_sign(key_handle_1,
+                                             test_data_to_be_signed,
+                                             test_data_to_be_signed_size,
+                                             &digest,
+                                             &digest_size);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        ASSERT_ARE_EQUAL_WITH_MSG(size_t, BUFFER_length(test_expected_digest), digest_size, "Line:" TOSTRING(__LINE__));
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, memcmp(BUFFER_u_char(test_expected_digest), digest, digest_size), "Line:" TOSTRING(__LINE__));
+
+        // cleanup
+        free(digest);
+        result = store_if->hsm_client_store_close_key(store_handle, key_handle_1);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        result = store_if->hsm_client_store_close_key(store_handle, key_handle_3);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        result = store_if->hsm_client_store_remove_key(store_handle, HSM_KEY_SAS, "my_sas_key");
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        BUFFER_delete(test_expected_digest);
+        BUFFER_delete(decoded_key);
+        result = store_if->hsm_client_store_close(store_handle);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        result = store_if->hsm_client_store_destroy(EDGE_STORE_NAME);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+    }
+
+    TEST_FUNCTION(encrypt_decrypt_stream_with_store_key_smoke)
+    {
+        // arrange
+        int result;
+        KEY_STREAM_HANDLE stream = NULL;
+        unsigned char plaintext[] = TEST_DATA_TO_BE_SIGNED;
+        unsigned char *ciphertext;
+        unsigned char *decrypted;
+        size_t ciphertext_size = 0;
+        size_t decrypted_size = 0;
+        size_t split = sizeof(plaintext) / 2;
+        size_t output_size;
+        unsigned char identity_data[] = "my_module";
+        unsigned char iv_data[] = "ABCDEFGHIJKLMNOP";
+        SIZED_BUFFER identity = { identity_data, sizeof(identity_data) };
+        SIZED_BUFFER iv = { iv_data, sizeof(iv_data) };
+        const HSM_CLIENT_STORE_INTERFACE *store_if = hsm_client_store_interface();
+        const HSM_CLIENT_KEY_INTERFACE *key_if = hsm_client_key_interface();
+        result = store_if->hsm_client_store_create(EDGE_STORE_NAME);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        HSM_CLIENT_STORE_HANDLE store_handle = store_if->hsm_client_store_open(EDGE_STORE_NAME);
+        ASSERT_IS_NOT_NULL_WITH_MSG(store_handle, "Line:" TOSTRING(__LINE__));
+        result = store_if->hsm_client_store_insert_encryption_key(store_handle, "my_enc_key");
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        KEY_HANDLE key_handle = store_if->hsm_client_store_open_key(store_handle, HSM_KEY_ENCRYPTION, "my_enc_key");
+        ASSERT_IS_NOT_NULL_WITH_MSG(key_handle, "Line:" TOSTRING(__LINE__));
+
+        // act
+        // the store key forwards every stream call to the key it caches
+        result = key_if->hsm_client_key_encrypt_init(key_handle, &identity, &iv, &stream);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        ciphertext = (unsigned char*)malloc(sizeof(plaintext) + 1024);
+        ASSERT_IS_NOT_NULL_WITH_MSG(ciphertext, "Line:" TOSTRING(__LINE__));
+        output_size = 1024;
+        result = key_if->hsm_client_key_stream_update(key_handle, stream, plaintext, split,
+                                                      ciphertext, &output_size);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        ciphertext_size += output_size;
+        output_size = 1024;
+        result = key_if->hsm_client_key_stream_update(key_handle, stream, plaintext + split,
+                                                      sizeof(plaintext) - split,
+                                                      ciphertext + ciphertext_size, &output_size);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        ciphertext_size += output_size;
+        output_size = 1024;
+        result = key_if->hsm_client_key_stream_final(key_handle, stream,
+                                                     ciphertext + ciphertext_size, &output_size);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        ciphertext_size += output_size;
+        key_if->hsm_client_key_stream_destroy(key_handle, stream);
+
+        stream = NULL;
+        result = key_if->hsm_client_key_decrypt_init(key_handle, &identity, &iv, &stream);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        decrypted = (unsigned char*)malloc(ciphertext_size + 1024);
+        ASSERT_IS_NOT_NULL_WITH_MSG(decrypted, "Line:" TOSTRING(__LINE__));
+        output_size = ciphertext_size + 1024;
+        result = key_if->hsm_client_key_stream_update(key_handle, stream, ciphertext, ciphertext_size,
+                                                      decrypted, &output_size);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        decrypted_size += output_size;
+        output_size = 1024;
+        result = key_if->hsm_client_key_stream_final(key_handle, stream,
+                                                     decrypted + decrypted_size, &output_size);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        decrypted_size += output_size;
+        key_if->hsm_client_key_stream_destroy(key_handle, stream);
+
+        // assert
+        ASSERT_ARE_EQUAL_WITH_MSG(size_t, sizeof(plaintext), decrypted_size, "Line:" TOSTRING(__LINE__));
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, memcmp(plaintext, decrypted, decrypted_size), "Line:" TOSTRING(__LINE__));
+
+        // cleanup
+        free(decrypted);
+        free(ciphertext);
+        result = store_if->hsm_client_store_close_key(store_handle, key_handle);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        result = store_if->hsm_client_store_remove_key(store_handle, HSM_KEY_ENCRYPTION, "my_enc_key");
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        result = store_if->hsm_client_store_close(store_handle);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        result = store_if->hsm_client_store_destroy(EDGE_STORE_NAME);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+    }
+
+    TEST_FUNCTION(concurrent_open_key_sign_smoke)
+    {
+        // arrange
+        int result, i;
+        THREAD_HANDLE threads[TEST_NUM_THREADS];
+        TEST_SIGN_THREAD_ARGS args;
+        unsigned char test_data_to_be_signed[] = TEST_DATA_TO_BE_SIGNED;
+        char test_key[] = TEST_KEY_BASE64;
+        BUFFER_HANDLE decoded_key = test_helper_base64_converter(test_key);
+        const HSM_CLIENT_STORE_INTERFACE *store_if = hsm_client_store_interface();
+        result = store_if->hsm_client_store_create(EDGE_STORE_NAME);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        HSM_CLIENT_STORE_HANDLE store_handle = store_if->hsm_client_store_open(EDGE_STORE_NAME);
+        ASSERT_IS_NOT_NULL_WITH_MSG(store_handle, "Line:" TOSTRING(__LINE__));
+        result = store_if->hsm_client_store_insert_sas_key(store_handle, "my_sas_key",
+                                                           BUFFER_u_char(decoded_key),
+                                                           BUFFER_length(decoded_key));
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        args.store_handle = store_handle;
+        args.expected_digest = test_helper_compute_hmac(decoded_key,
+                                                        test_data_to_be_signed,
+                                                        sizeof(test_data_to_be_signed));
+
+        // act
+        for (i = 0; i < TEST_NUM_THREADS; i++)
+        {
+            THREADAPI_RESULT status = ThreadAPI_Create(&threads[i], test_helper_sign_thread, &args);
+            ASSERT_ARE_EQUAL_WITH_MSG(int, (int)THREADAPI_OK, (int)status, "Line:" TOSTRING(__LINE__));
+        }
+        // mutate an unrelated key while the signing threads are running
+        for (i = 0; i < TEST_NUM_ITERATIONS; i++)
+        {
+            result = store_if->hsm_client_store_insert_sas_key(store_handle, "my_other_key", "ABCD", 5);
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+            result = store_if->hsm_client_store_remove_key(store_handle, HSM_KEY_SAS, "my_other_key");
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        }
+
+        // assert
+        for (i = 0; i < TEST_NUM_THREADS; i++)
+        {
+            int failures = -1;
+            THREADAPI_RESULT status = ThreadAPI_Join(threads[i], &failures);
+            ASSERT_ARE_EQUAL_WITH_MSG(int, (int)THREADAPI_OK, (int)status, "Line:" TOSTRING(__LINE__));
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, failures, "Line:" TOSTRING(__LINE__));
+        }
+
+        // cleanup
+        result = store_if->hsm_client_store_remove_key(store_handle, HSM_KEY_SAS, "my_sas_key");
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        BUFFER_delete(args.expected_digest);
+        BUFFER_delete(decoded_key);
+        result = store_if->hsm_client_store_close(store_handle);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        result = store_if->hsm_client_store_destroy(EDGE_STORE_NAME);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+    }
+
+    TEST_FUNCTION(derive_and_sign_cached_until_key_reinserted_smoke)
+    {
+        // arrange
+        int result, i, pass;
+        char identity[32];
+        char test_key[] = TEST_KEY_BASE64;
+        BUFFER_HANDLE decoded_key = test_helper_base64_converter(test_key);
+        BUFFER_HANDLE other_key = BUFFER_create((const unsigned char*)"ABCD", 5);
+        ASSERT_IS_NOT_NULL_WITH_MSG(other_key, "Line:" TOSTRING(__LINE__));
+        const HSM_CLIENT_STORE_INTERFACE *store_if = hsm_client_store_interface();
+        result = store_if->hsm_client_store_create(EDGE_STORE_NAME);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        HSM_CLIENT_STORE_HANDLE store_handle = store_if->hsm_client_store_open(EDGE_STORE_NAME);
+        ASSERT_IS_NOT_NULL_WITH_MSG(store_handle, "Line:" TOSTRING(__LINE__));
+        result = store_if->hsm_client_store_insert_sas_key(store_handle, "my_sas_key",
+                                                           BUFFER_u_char(decoded_key),
+                                                           BUFFER_length(decoded_key));
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+
+        // act, assert
+        // more identities than are cached so that entries are evicted and re-derived
+        for (pass = 0; pass < 2; pass++)
+        {
+            for (i = 0; i < 20; i++)
+            {
+                (void)snprintf(identity, sizeof(identity), "edge_device/module_%02d", i);
+                test_helper_assert_derive_and_sign(store_handle, decoded_key, identity);
+                test_helper_assert_derive_and_sign(store_handle, decoded_key, "edge_device/module_00");
+            }
+        }
+        // activating the key again drops the keys derived from the previous key
+        result = store_if->hsm_client_store_insert_sas_key(store_handle, "my_sas_key",
+                                                           BUFFER_u_char(other_key),
+                                                           BUFFER_length(other_key));
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        test_helper_assert_derive_and_sign(store_handle, other_key, "edge_device/module_00");
+
+        // cleanup
+        result = store_if->hsm_client_store_remove_key(store_handle, HSM_KEY_SAS, "my_sas_key");
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        BUFFER_delete(other_key);
+        BUFFER_delete(decoded_key);
+        result = store_if->hsm_client_store_close(store_handle);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        result = store_if->hsm_client_store_destroy(EDGE_STORE_NAME);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+    }
+
     TEST_FUNCTION(insert_default_trusted_ca_cert_smoke)
     {
         // arrange
@@ -340,6 +764,56 @@ BEGIN_TEST_SUITE(edge_hsm_store_int_tests)
         ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
     }
 
+    TEST_FUNCTION(trusted_certs_cached_until_changed_smoke)
+    {
+        // arrange
+        int result;
+        const char *test_trusted_file = TESTONLY_IOTEDGE_HOMEDIR "/my_trusted_cert.pem";
+        const HSM_CLIENT_STORE_INTERFACE *store_if = hsm_client_store_interface();
+        result = store_if->hsm_client_store_create(EDGE_STORE_NAME);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        HSM_CLIENT_STORE_HANDLE store_handle = store_if->hsm_client_store_open(EDGE_STORE_NAME);
+        ASSERT_IS_NOT_NULL_WITH_MSG(store_handle, "Line:" TOSTRING(__LINE__));
+        CERT_INFO_HANDLE default_bundle = store_if->hsm_client_store_get_pki_trusted_certs(store_handle);
+        ASSERT_IS_NOT_NULL_WITH_MSG(default_bundle, "Line:" TOSTRING(__LINE__));
+        const char *default_pem = certificate_info_get_certificate(default_bundle);
+        result = write_cstring_to_file(test_trusted_file, default_pem);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+
+        // act
+        CERT_INFO_HANDLE cached_bundle = store_if->hsm_client_store_get_pki_trusted_certs(store_handle);
+        result = store_if->hsm_client_store_insert_pki_trusted_cert(store_handle, "my_trusted_alias", test_trusted_file);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        CERT_INFO_HANDLE extended_bundle = store_if->hsm_client_store_get_pki_trusted_certs(store_handle);
+        result = store_if->hsm_client_store_remove_pki_trusted_cert(store_handle, "my_trusted_alias");
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        CERT_INFO_HANDLE restored_bundle = store_if->hsm_client_store_get_pki_trusted_certs(store_handle);
+
+        // assert
+        ASSERT_ARE_EQUAL_WITH_MSG(void_ptr, default_bundle, cached_bundle, "Line:" TOSTRING(__LINE__));
+        ASSERT_IS_NOT_NULL_WITH_MSG(extended_bundle, "Line:" TOSTRING(__LINE__));
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(void_ptr, default_bundle, extended_bundle, "Line:" TOSTRING(__LINE__));
+        ASSERT_ARE_EQUAL_WITH_MSG(size_t, 2 * strlen(default_pem),
+                                  strlen(certificate_info_get_certificate(extended_bundle)),
+                                  "Line:" TOSTRING(__LINE__));
+        ASSERT_IS_NOT_NULL_WITH_MSG(restored_bundle, "Line:" TOSTRING(__LINE__));
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(void_ptr, extended_bundle, restored_bundle, "Line:" TOSTRING(__LINE__));
+        ASSERT_ARE_EQUAL_WITH_MSG(char_ptr, default_pem,
+                                  certificate_info_get_certificate(restored_bundle),
+                                  "Line:" TOSTRING(__LINE__));
+
+        // cleanup
+        certificate_info_destroy(restored_bundle);
+        certificate_info_destroy(extended_bundle);
+        certificate_info_destroy(cached_bundle);
+        certificate_info_destroy(default_bundle);
+        (void)delete_file(test_trusted_file);
+        result = store_if->hsm_client_store_close(store_handle);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        result = store_if->hsm_client_store_destroy(EDGE_STORE_NAME);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+    }
+
     TEST_FUNCTION(insert_generated_cert_smoke)
     {
         // arrange
@@ -384,4 +858,570 @@ BEGIN_TEST_SUITE(edge_hsm_store_int_tests)
         ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
     }
 
+    TEST_FUNCTION(get_pki_cert_cached_until_recreated_smoke)
+    {
+        // arrange
+        int result;
+        const HSM_CLIENT_STORE_INTERFACE *store_if = hsm_client_store_interface();
+        result = store_if->hsm_client_store_create(EDGE_STORE_NAME);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        HSM_CLIENT_STORE_HANDLE store_handle = store_if->hsm_client_store_open(EDGE_STORE_NAME);
+        ASSERT_IS_NOT_NULL_WITH_MSG(store_handle, "Line:" TOSTRING(__LINE__));
+        CERT_PROPS_HANDLE cert_props = test_helper_create_certificate_props("test_cn",
+                                                                            "my_test_alias",
+                                                                            hsm_get_device_ca_alias(),
+                                                                            CERTIFICATE_TYPE_CLIENT,
+                                                                            3600);
+        result = store_if->hsm_client_store_create_pki_cert(store_handle, cert_props);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+
+        // act
+        CERT_INFO_HANDLE cert_info_1 = store_if->hsm_client_store_get_pki_cert(store_handle, "my_test_alias");
+        CERT_INFO_HANDLE cert_info_2 = store_if->hsm_client_store_get_pki_cert(store_handle, "my_test_alias");
+        result = store_if->hsm_client_store_create_pki_cert(store_handle, cert_props);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        CERT_INFO_HANDLE cert_info_3 = store_if->hsm_client_store_get_pki_cert(store_handle, "my_test_alias");
+        result = store_if->hsm_client_store_remove_pki_cert(store_handle, "my_test_alias");
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        CERT_INFO_HANDLE cert_info_4 = store_if->hsm_client_store_get_pki_cert(store_handle, "my_test_alias");
+
+        // assert
+        ASSERT_IS_NOT_NULL_WITH_MSG(cert_info_1, "Line:" TOSTRING(__LINE__));
+        ASSERT_IS_NOT_NULL_WITH_MSG(cert_info_3, "Line:" TOSTRING(__LINE__));
+        ASSERT_IS_NULL_WITH_MSG(cert_info_4, "Line:" TOSTRING(__LINE__));
+        ASSERT_ARE_EQUAL_WITH_MSG(void_ptr, cert_info_1, cert_info_2, "Line:" TOSTRING(__LINE__));
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(void_ptr, cert_info_1, cert_info_3, "Line:" TOSTRING(__LINE__));
+        // handles returned before the alias was re-created or removed remain usable
+        ASSERT_IS_NOT_NULL_WITH_MSG(certificate_info_get_certificate(cert_info_1), "Line:" TOSTRING(__LINE__));
+        ASSERT_IS_NOT_NULL_WITH_MSG(certificate_info_get_certificate(cert_info_3), "Line:" TOSTRING(__LINE__));
+
+        // cleanup
+        certificate_info_destroy(cert_info_1);
+        certificate_info_destroy(cert_info_2);
+        certificate_info_destroy(cert_info_3);
+        cert_properties_destroy(cert_props);
+        result = store_if->hsm_client_store_close(store_handle);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        result = store_if->hsm_client_store_destroy(EDGE_STORE_NAME);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+    }
+
+    TEST_FUNCTION(verification_results_persist_across_create_smoke)
+    {
+        // arrange
+        int result;
+        const char *cache_file = TESTONLY_IOTEDGE_HOMEDIR "/hsm/verify.cache";
+        const HSM_CLIENT_STORE_INTERFACE *store_if = hsm_client_store_interface();
+        result = store_if->hsm_client_store_create(EDGE_STORE_NAME);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        result = store_if->hsm_client_store_destroy(EDGE_STORE_NAME);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+
+        // act, assert
+        // loading the existing CA certificates verifies and caches them
+        result = store_if->hsm_client_store_create(EDGE_STORE_NAME);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        result = store_if->hsm_client_store_destroy(EDGE_STORE_NAME);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        ASSERT_IS_TRUE_WITH_MSG(is_file_valid(cache_file), "Line:" TOSTRING(__LINE__));
+
+        // the cached results are used on the next create
+        result = store_if->hsm_client_store_create(EDGE_STORE_NAME);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        result = store_if->hsm_client_store_destroy(EDGE_STORE_NAME);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+    }
+
+    TEST_FUNCTION(cert_renewed_in_background_smoke)
+    {
+        // arrange
+        int result, attempt;
+        test_helper_set_env("IOTEDGE_HSM_CERT_RENEWAL_PERCENT", "50");
+        const HSM_CLIENT_STORE_INTERFACE *store_if = hsm_client_store_interface();
+        result = store_if->hsm_client_store_create(EDGE_STORE_NAME);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        HSM_CLIENT_STORE_HANDLE store_handle = store_if->hsm_client_store_open(EDGE_STORE_NAME);
+        ASSERT_IS_NOT_NULL_WITH_MSG(store_handle, "Line:" TOSTRING(__LINE__));
+        CERT_PROPS_HANDLE cert_props = test_helper_create_certificate_props("test_cn",
+                                                                            "my_test_alias",
+                                                                            hsm_get_device_ca_alias(),
+                                                                            CERTIFICATE_TYPE_CLIENT,
+                                                                            6);
+        result = store_if->hsm_client_store_create_pki_cert(store_handle, cert_props);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        CERT_INFO_HANDLE cert_info_1 = store_if->hsm_client_store_get_pki_cert(store_handle, "my_test_alias");
+        ASSERT_IS_NOT_NULL_WITH_MSG(cert_info_1, "Line:" TOSTRING(__LINE__));
+
+        // act
+        // the certificate is due for renewal 3 seconds after it was issued
+        CERT_INFO_HANDLE cert_info_2 = NULL;
+        for (attempt = 0; (attempt < 20) && (cert_info_2 == NULL); attempt++)
+        {
+            ThreadAPI_Sleep(500);
+            cert_info_2 = store_if->hsm_client_store_get_pki_cert(store_handle, "my_test_alias");
+            ASSERT_IS_NOT_NULL_WITH_MSG(cert_info_2, "Line:" TOSTRING(__LINE__));
+            if (certificate_info_get_valid_to(cert_info_2) == certificate_info_get_valid_to(cert_info_1))
+            {
+                certificate_info_destroy(cert_info_2);
+                cert_info_2 = NULL;
+            }
+        }
+
+        // assert
+        ASSERT_IS_NOT_NULL_WITH_MSG(cert_info_2, "Line:" TOSTRING(__LINE__));
+        ASSERT_IS_TRUE_WITH_MSG((certificate_info_get_valid_to(cert_info_2) > certificate_info_get_valid_to(cert_info_1)),
+                                "Line:" TOSTRING(__LINE__));
+        ASSERT_IS_TRUE_WITH_MSG((strcmp(certificate_info_get_certificate(cert_info_1),
+                                        certificate_info_get_certificate(cert_info_2)) != 0),
+                                "Line:" TOSTRING(__LINE__));
+        // handles returned before the renewal remain usable
+        ASSERT_IS_NOT_NULL_WITH_MSG(certificate_info_get_certificate(cert_info_1), "Line:" TOSTRING(__LINE__));
+
+        // cleanup
+        certificate_info_destroy(cert_info_1);
+        certificate_info_destroy(cert_info_2);
+        result = store_if->hsm_client_store_remove_pki_cert(store_handle, "my_test_alias");
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        cert_properties_destroy(cert_props);
+        result = store_if->hsm_client_store_close(store_handle);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        result = store_if->hsm_client_store_destroy(EDGE_STORE_NAME);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        test_helper_set_env("IOTEDGE_HSM_CERT_RENEWAL_PERCENT", NULL);
+    }
+
+    TEST_FUNCTION(cert_reused_for_same_props_smoke)
+    {
+        // arrange
+        int result;
+        test_helper_set_env("IOTEDGE_HSM_CERT_REUSE_PERCENT", "50");
+        const HSM_CLIENT_STORE_INTERFACE *store_if = hsm_client_store_interface();
+        result = store_if->hsm_client_store_create(EDGE_STORE_NAME);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        HSM_CLIENT_STORE_HANDLE store_handle = store_if->hsm_client_store_open(EDGE_STORE_NAME);
+        ASSERT_IS_NOT_NULL_WITH_MSG(store_handle, "Line:" TOSTRING(__LINE__));
+        CERT_PROPS_HANDLE cert_props = test_helper_create_certificate_props("test_cn",
+                                                                            "my_test_alias",
+                                                                            hsm_get_device_ca_alias(),
+                                                                            CERTIFICATE_TYPE_SERVER,
+                                                                            3600);
+
+        // act
+        result = store_if->hsm_client_store_create_pki_cert(store_handle, cert_props);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        CERT_INFO_HANDLE cert_info_1 = store_if->hsm_client_store_get_pki_cert(store_handle, "my_test_alias");
+        result = store_if->hsm_client_store_create_pki_cert(store_handle, cert_props);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        CERT_INFO_HANDLE cert_info_2 = store_if->hsm_client_store_get_pki_cert(store_handle, "my_test_alias");
+        set_common_name(cert_props, "other_test_cn");
+        result = store_if->hsm_client_store_create_pki_cert(store_handle, cert_props);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        CERT_INFO_HANDLE cert_info_3 = store_if->hsm_client_store_get_pki_cert(store_handle, "my_test_alias");
+        // less than half of the requested validity remains
+        set_validity_seconds(cert_props, 3 * 3600);
+        result = store_if->hsm_client_store_create_pki_cert(store_handle, cert_props);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        CERT_INFO_HANDLE cert_info_4 = store_if->hsm_client_store_get_pki_cert(store_handle, "my_test_alias");
+
+        // assert
+        ASSERT_IS_NOT_NULL_WITH_MSG(cert_info_1, "Line:" TOSTRING(__LINE__));
+        ASSERT_IS_NOT_NULL_WITH_MSG(cert_info_2, "Line:" TOSTRING(__LINE__));
+        ASSERT_IS_NOT_NULL_WITH_MSG(cert_info_3, "Line:" TOSTRING(__LINE__));
+        ASSERT_IS_NOT_NULL_WITH_MSG(cert_info_4, "Line:" TOSTRING(__LINE__));
+        ASSERT_ARE_EQUAL_WITH_MSG(char_ptr, certificate_info_get_certificate(cert_info_1),
+                                  certificate_info_get_certificate(cert_info_2), "Line:" TOSTRING(__LINE__));
+        ASSERT_IS_TRUE_WITH_MSG((strcmp(certificate_info_get_certificate(cert_info_2),
+                                        certificate_info_get_certificate(cert_info_3)) != 0),
+                                "Line:" TOSTRING(__LINE__));
+        ASSERT_IS_TRUE_WITH_MSG((strcmp(certificate_info_get_certificate(cert_info_3),
+                                        certificate_info_get_certificate(cert_info_4)) != 0),
+                                "Line:" TOSTRING(__LINE__));
+        ASSERT_IS_TRUE_WITH_MSG((certificate_info_get_valid_to(cert_info_4) > certificate_info_get_valid_to(cert_info_3)),
+                                "Line:" TOSTRING(__LINE__));
+
+        // cleanup
+        certificate_info_destroy(cert_info_1);
+        certificate_info_destroy(cert_info_2);
+        certificate_info_destroy(cert_info_3);
+        certificate_info_destroy(cert_info_4);
+        result = store_if->hsm_client_store_remove_pki_cert(store_handle, "my_test_alias");
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        cert_properties_destroy(cert_props);
+        result = store_if->hsm_client_store_close(store_handle);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        result = store_if->hsm_client_store_destroy(EDGE_STORE_NAME);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        test_helper_set_env("IOTEDGE_HSM_CERT_REUSE_PERCENT", NULL);
+    }
+
+    TEST_FUNCTION(cert_reused_across_store_restart_smoke)
+    {
+        // arrange
+        int result;
+        test_helper_set_env("IOTEDGE_HSM_CERT_REUSE_PERCENT", "50");
+        const HSM_CLIENT_STORE_INTERFACE *store_if = hsm_client_store_interface();
+        result = store_if->hsm_client_store_create(EDGE_STORE_NAME);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        HSM_CLIENT_STORE_HANDLE store_handle = store_if->hsm_client_store_open(EDGE_STORE_NAME);
+        ASSERT_IS_NOT_NULL_WITH_MSG(store_handle, "Line:" TOSTRING(__LINE__));
+        CERT_PROPS_HANDLE cert_props = test_helper_create_certificate_props("test_cn",
+                                                                            "my_test_alias",
+                                                                            hsm_get_device_ca_alias(),
+                                                                            CERTIFICATE_TYPE_SERVER,
+                                                                            3600);
+        result = store_if->hsm_client_store_create_pki_cert(store_handle, cert_props);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        CERT_INFO_HANDLE cert_info_1 = store_if->hsm_client_store_get_pki_cert(store_handle, "my_test_alias");
+        ASSERT_IS_NOT_NULL_WITH_MSG(cert_info_1, "Line:" TOSTRING(__LINE__));
+        result = store_if->hsm_client_store_close(store_handle);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        result = store_if->hsm_client_store_destroy(EDGE_STORE_NAME);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+
+        // act
+        result = store_if->hsm_client_store_create(EDGE_STORE_NAME);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        store_handle = store_if->hsm_client_store_open(EDGE_STORE_NAME);
+        ASSERT_IS_NOT_NULL_WITH_MSG(store_handle, "Line:" TOSTRING(__LINE__));
+        result = store_if->hsm_client_store_create_pki_cert(store_handle, cert_props);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        CERT_INFO_HANDLE cert_info_2 = store_if->hsm_client_store_get_pki_cert(store_handle, "my_test_alias");
+        set_common_name(cert_props, "other_test_cn");
+        result = store_if->hsm_client_store_create_pki_cert(store_handle, cert_props);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        CERT_INFO_HANDLE cert_info_3 = store_if->hsm_client_store_get_pki_cert(store_handle, "my_test_alias");
+
+        // assert
+        // the certificate issued before the restart is reused for the same
+        // properties and re-issued once they change
+        ASSERT_IS_NOT_NULL_WITH_MSG(cert_info_2, "Line:" TOSTRING(__LINE__));
+        ASSERT_IS_NOT_NULL_WITH_MSG(cert_info_3, "Line:" TOSTRING(__LINE__));
+        ASSERT_ARE_EQUAL_WITH_MSG(char_ptr, certificate_info_get_certificate(cert_info_1),
+                                  certificate_info_get_certificate(cert_info_2), "Line:" TOSTRING(__LINE__));
+        ASSERT_IS_TRUE_WITH_MSG((strcmp(certificate_info_get_certificate(cert_info_2),
+                                        certificate_info_get_certificate(cert_info_3)) != 0),
+                                "Line:" TOSTRING(__LINE__));
+
+        // cleanup
+        certificate_info_destroy(cert_info_1);
+        certificate_info_destroy(cert_info_2);
+        certificate_info_destroy(cert_info_3);
+        result = store_if->hsm_client_store_remove_pki_cert(store_handle, "my_test_alias");
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        cert_properties_destroy(cert_props);
+        result = store_if->hsm_client_store_close(store_handle);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        result = store_if->hsm_client_store_destroy(EDGE_STORE_NAME);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        test_helper_set_env("IOTEDGE_HSM_CERT_REUSE_PERCENT", NULL);
+    }
+
+    TEST_FUNCTION(create_pki_certs_batch_smoke)
+    {
+        // arrange
+        int result;
+        size_t index;
+        const char *aliases[3] = { "my_test_alias_1", "my_test_alias_2", "my_test_alias_3" };
+        CERT_PROPS_HANDLE cert_props[3];
+        CERT_INFO_HANDLE cert_infos[3];
+        const HSM_CLIENT_STORE_INTERFACE *store_if = hsm_client_store_interface();
+        result = store_if->hsm_client_store_create(EDGE_STORE_NAME);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        HSM_CLIENT_STORE_HANDLE store_handle = store_if->hsm_client_store_open(EDGE_STORE_NAME);
+        ASSERT_IS_NOT_NULL_WITH_MSG(store_handle, "Line:" TOSTRING(__LINE__));
+        for (index = 0; index < 3; index++)
+        {
+            cert_props[index] = test_helper_create_certificate_props("test_cn",
+                                                                     aliases[index],
+                                                                     hsm_get_device_ca_alias(),
+                                                                     CERTIFICATE_TYPE_CLIENT,
+                                                                     3600);
+        }
+
+        // act
+        result = store_if->hsm_client_store_create_pki_certs(store_handle, cert_props, 3);
+
+        // assert
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        for (index = 0; index < 3; index++)
+        {
+            cert_infos[index] = store_if->hsm_client_store_get_pki_cert(store_handle, aliases[index]);
+            ASSERT_IS_NOT_NULL_WITH_MSG(cert_infos[index], "Line:" TOSTRING(__LINE__));
+        }
+        ASSERT_IS_TRUE_WITH_MSG((strcmp(certificate_info_get_certificate(cert_infos[0]),
+                                        certificate_info_get_certificate(cert_infos[1])) != 0),
+                                "Line:" TOSTRING(__LINE__));
+        ASSERT_IS_TRUE_WITH_MSG((strcmp(certificate_info_get_certificate(cert_infos[1]),
+                                        certificate_info_get_certificate(cert_infos[2])) != 0),
+                                "Line:" TOSTRING(__LINE__));
+        // the same alias cannot be requested twice in a batch
+        CERT_PROPS_HANDLE duplicate_cert_props[2] = { cert_props[0], cert_props[0] };
+        result = store_if->hsm_client_store_create_pki_certs(store_handle, duplicate_cert_props, 2);
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+
+        // cleanup
+        for (index = 0; index < 3; index++)
+        {
+            certificate_info_destroy(cert_infos[index]);
+            cert_properties_destroy(cert_props[index]);
+            result = store_if->hsm_client_store_remove_pki_cert(store_handle, aliases[index]);
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        }
+        result = store_if->hsm_client_store_close(store_handle);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        result = store_if->hsm_client_store_destroy(EDGE_STORE_NAME);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+    }
+
+    TEST_FUNCTION(create_pki_certs_batch_failure_removes_issued_certs)
+    {
+        // arrange
+        int result;
+        size_t index;
+        const char *aliases[3] = { "my_test_alias_1", "my_test_alias_2", "my_test_alias_3" };
+        const char *issuer_aliases[3] = { hsm_get_device_ca_alias(), hsm_get_device_ca_alias(), "unknown_issuer_alias" };
+        CERT_PROPS_HANDLE cert_props[3];
+        CERT_INFO_HANDLE existing_cert_info, cert_info;
+        const HSM_CLIENT_STORE_INTERFACE *store_if = hsm_client_store_interface();
+        result = store_if->hsm_client_store_create(EDGE_STORE_NAME);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        HSM_CLIENT_STORE_HANDLE store_handle = store_if->hsm_client_store_open(EDGE_STORE_NAME);
+        ASSERT_IS_NOT_NULL_WITH_MSG(store_handle, "Line:" TOSTRING(__LINE__));
+        for (index = 0; index < 3; index++)
+        {
+            cert_props[index] = test_helper_create_certificate_props("test_cn",
+                                                                     aliases[index],
+                                                                     issuer_aliases[index],
+                                                                     CERTIFICATE_TYPE_CLIENT,
+                                                                     3600);
+        }
+        result = store_if->hsm_client_store_create_pki_cert(store_handle, cert_props[0]);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        existing_cert_info = store_if->hsm_client_store_get_pki_cert(store_handle, aliases[0]);
+        ASSERT_IS_NOT_NULL_WITH_MSG(existing_cert_info, "Line:" TOSTRING(__LINE__));
+
+        // act
+        result = store_if->hsm_client_store_create_pki_certs(store_handle, cert_props, 3);
+
+        // assert
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        // the certificate which existed before the batch is kept
+        cert_info = store_if->hsm_client_store_get_pki_cert(store_handle, aliases[0]);
+        ASSERT_IS_NOT_NULL_WITH_MSG(cert_info, "Line:" TOSTRING(__LINE__));
+        ASSERT_ARE_EQUAL_WITH_MSG(char_ptr, certificate_info_get_certificate(existing_cert_info),
+                                  certificate_info_get_certificate(cert_info), "Line:" TOSTRING(__LINE__));
+        certificate_info_destroy(cert_info);
+        // the certificate issued by the batch is removed
+        cert_info = store_if->hsm_client_store_get_pki_cert(store_handle, aliases[1]);
+        ASSERT_IS_NULL_WITH_MSG(cert_info, "Line:" TOSTRING(__LINE__));
+        result = store_if->hsm_client_store_remove_pki_cert(store_handle, aliases[1]);
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+
+        // cleanup
+        certificate_info_destroy(existing_cert_info);
+        for (index = 0; index < 3; index++)
+        {
+            cert_properties_destroy(cert_props[index]);
+        }
+        result = store_if->hsm_client_store_remove_pki_cert(store_handle, aliases[0]);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        result = store_if->hsm_client_store_close(store_handle);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        result = store_if->hsm_client_store_destroy(EDGE_STORE_NAME);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+    }
+
+    TEST_FUNCTION(store_index_colliding_aliases_smoke)
+    {
+        // arrange
+        int result;
+        size_t index;
+        char aliases[4][32];
+        const HSM_CLIENT_STORE_INTERFACE *store_if = hsm_client_store_interface();
+        result = store_if->hsm_client_store_create(EDGE_STORE_NAME);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        HSM_CLIENT_STORE_HANDLE store_handle = store_if->hsm_client_store_open(EDGE_STORE_NAME);
+        ASSERT_IS_NOT_NULL_WITH_MSG(store_handle, "Line:" TOSTRING(__LINE__));
+        test_helper_find_colliding_aliases(aliases, 4);
+
+        // act, assert
+        for (index = 0; index < 4; index++)
+        {
+            test_helper_insert_alias_sas_key(store_handle, aliases[index]);
+        }
+        for (index = 0; index < 4; index++)
+        {
+            test_helper_assert_alias_sas_key(store_handle, aliases[index]);
+        }
+
+        // removing an alias in the middle of the probe sequence leaves a
+        // tombstone that later aliases are still found through
+        result = store_if->hsm_client_store_remove_key(store_handle, HSM_KEY_SAS, aliases[1]);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        test_helper_assert_no_sas_key(store_handle, aliases[1]);
+        test_helper_assert_alias_sas_key(store_handle, aliases[0]);
+        test_helper_assert_alias_sas_key(store_handle, aliases[2]);
+        test_helper_assert_alias_sas_key(store_handle, aliases[3]);
+
+        // reinserting over the tombstone
+        test_helper_insert_alias_sas_key(store_handle, aliases[1]);
+        for (index = 0; index < 4; index++)
+        {
+            test_helper_assert_alias_sas_key(store_handle, aliases[index]);
+        }
+
+        // repeated removal leaves enough tombstones to rebuild the index
+        for (index = 0; index < 32; index++)
+        {
+            result = store_if->hsm_client_store_remove_key(store_handle, HSM_KEY_SAS, aliases[index % 4]);
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+            test_helper_assert_no_sas_key(store_handle, aliases[index % 4]);
+            test_helper_insert_alias_sas_key(store_handle, aliases[index % 4]);
+        }
+        for (index = 0; index < 4; index++)
+        {
+            test_helper_assert_alias_sas_key(store_handle, aliases[index]);
+        }
+
+        // cleanup
+        for (index = 0; index < 4; index++)
+        {
+            result = store_if->hsm_client_store_remove_key(store_handle, HSM_KEY_SAS, aliases[index]);
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        }
+        result = store_if->hsm_client_store_close(store_handle);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        result = store_if->hsm_client_store_destroy(EDGE_STORE_NAME);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+    }
+
+    TEST_FUNCTION(store_index_grows_across_resize_smoke)
+    {
+        // arrange
+        int result;
+        size_t index;
+        char aliases[100][32];
+        const HSM_CLIENT_STORE_INTERFACE *store_if = hsm_client_store_interface();
+        result = store_if->hsm_client_store_create(EDGE_STORE_NAME);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        HSM_CLIENT_STORE_HANDLE store_handle = store_if->hsm_client_store_open(EDGE_STORE_NAME);
+        ASSERT_IS_NOT_NULL_WITH_MSG(store_handle, "Line:" TOSTRING(__LINE__));
+
+        // act, assert
+        for (index = 0; index < 100; index++)
+        {
+            (void)snprintf(aliases[index], sizeof(aliases[index]), "grow_%u", (unsigned)index);
+            test_helper_insert_alias_sas_key(store_handle, aliases[index]);
+        }
+        for (index = 0; index < 100; index++)
+        {
+            test_helper_assert_alias_sas_key(store_handle, aliases[index]);
+        }
+        for (index = 0; index < 100; index += 2)
+        {
+            result = store_if->hsm_client_store_remove_key(store_handle, HSM_KEY_SAS, aliases[index]);
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        }
+        for (index = 0; index < 100; index++)
+        {
+            if ((index % 2) == 0)
+            {
+                test_helper_assert_no_sas_key(store_handle, aliases[index]);
+            }
+            else
+            {
+                test_helper_assert_alias_sas_key(store_handle, aliases[index]);
+            }
+        }
+        for (index = 0; index < 100; index += 2)
+        {
+            test_helper_insert_alias_sas_key(store_handle, aliases[index]);
+        }
+        for (index = 0; index < 100; index++)
+        {
+            test_helper_assert_alias_sas_key(store_handle, aliases[index]);
+        }
+
+        // cleanup
+        for (index = 0; index < 100; index++)
+        {
+            result = store_if->hsm_client_store_remove_key(store_handle, HSM_KEY_SAS, aliases[index]);
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        }
+        result = store_if->hsm_client_store_close(store_handle);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        result = store_if->hsm_client_store_destroy(EDGE_STORE_NAME);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+    }
+
+    TEST_FUNCTION(store_index_keeps_insertion_order_after_removal_smoke)
+    {
+        // arrange
+        int result;
+        size_t index;
+        const char *aliases[3] = { "order_alias_a", "order_alias_b", "order_alias_c" };
+        const char *files[3] = { TESTONLY_IOTEDGE_HOMEDIR "/order_a.pem",
+                                 TESTONLY_IOTEDGE_HOMEDIR "/order_b.pem",
+                                 TESTONLY_IOTEDGE_HOMEDIR "/order_c.pem" };
+        const char *markers[3] = { "order a\n", "order b\n", "order c\n" };
+        const HSM_CLIENT_STORE_INTERFACE *store_if = hsm_client_store_interface();
+        result = store_if->hsm_client_store_create(EDGE_STORE_NAME);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        HSM_CLIENT_STORE_HANDLE store_handle = store_if->hsm_client_store_open(EDGE_STORE_NAME);
+        ASSERT_IS_NOT_NULL_WITH_MSG(store_handle, "Line:" TOSTRING(__LINE__));
+        CERT_INFO_HANDLE default_bundle = store_if->hsm_client_store_get_pki_trusted_certs(store_handle);
+        ASSERT_IS_NOT_NULL_WITH_MSG(default_bundle, "Line:" TOSTRING(__LINE__));
+        const char *default_pem = certificate_info_get_certificate(default_bundle);
+        size_t default_pem_len = strlen(default_pem);
+        size_t marker_len = strlen(markers[0]);
+        // the text following a certificate identifies the file it came from
+        char *contents = (char*)malloc(default_pem_len + marker_len + 1);
+        ASSERT_IS_NOT_NULL_WITH_MSG(contents, "Line:" TOSTRING(__LINE__));
+        for (index = 0; index < 3; index++)
+        {
+            (void)memcpy(contents, default_pem, default_pem_len);
+            (void)strcpy(contents + default_pem_len, markers[index]);
+            result = write_cstring_to_file(files[index], contents);
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+            result = store_if->hsm_client_store_insert_pki_trusted_cert(store_handle, aliases[index], files[index]);
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        }
+
+        // act
+        result = store_if->hsm_client_store_remove_pki_trusted_cert(store_handle, aliases[0]);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        result = store_if->hsm_client_store_insert_pki_trusted_cert(store_handle, aliases[0], files[0]);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        CERT_INFO_HANDLE bundle = store_if->hsm_client_store_get_pki_trusted_certs(store_handle);
+
+        // assert
+        // the bundle follows insertion order, removed aliases are skipped and
+        // reinserted ones are appended
+        ASSERT_IS_NOT_NULL_WITH_MSG(bundle, "Line:" TOSTRING(__LINE__));
+        const char *bundle_pem = certificate_info_get_certificate(bundle);
+        ASSERT_ARE_EQUAL_WITH_MSG(size_t, 4 * default_pem_len + 3 * marker_len, strlen(bundle_pem), "Line:" TOSTRING(__LINE__));
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, strncmp(bundle_pem, default_pem, default_pem_len), "Line:" TOSTRING(__LINE__));
+        const char *expected_order[3] = { markers[1], markers[2], markers[0] };
+        for (index = 0; index < 3; index++)
+        {
+            const char *marker = bundle_pem + ((index + 2) * default_pem_len) + (index * marker_len);
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, strncmp(marker, expected_order[index], marker_len), "Line:" TOSTRING(__LINE__));
+        }
+
+        // cleanup
+        certificate_info_destroy(bundle);
+        certificate_info_destroy(default_bundle);
+        free(contents);
+        for (index = 0; index < 3; index++)
+        {
+            result = store_if->hsm_client_store_remove_pki_trusted_cert(store_handle, aliases[index]);
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+            (void)delete_file(files[index]);
+        }
+        result = store_if->hsm_client_store_close(store_handle);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+        result = store_if->hsm_client_store_destroy(EDGE_STORE_NAME);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Line:" TOSTRING(__LINE__));
+    }
+
 END_TEST_SUITE(edge_hsm_store_int_tests)
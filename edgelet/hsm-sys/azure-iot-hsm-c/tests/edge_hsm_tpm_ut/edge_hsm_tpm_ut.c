@@ -70,6 +70,10 @@ MOCKABLE_FUNCTION(, int, mocked_hsm_client_key_sign, KEY_HANDLE, key_handle, con
 MOCKABLE_FUNCTION(, int, mocked_hsm_client_key_derive_and_sign, KEY_HANDLE, key_handle, const unsigned char*, data_to_be_signed, size_t, data_len, const unsigned char*, identity, size_t, identity_size, unsigned char**, digest, size_t*, digest_size);
 MOCKABLE_FUNCTION(, int, mocked_hsm_client_key_encrypt, KEY_HANDLE, key_handle, const SIZED_BUFFER*, identity, const SIZED_BUFFER*, plaintext, const SIZED_BUFFER*, iv, SIZED_BUFFER*, ciphertext);
 MOCKABLE_FUNCTION(, int, mocked_hsm_client_key_decrypt, KEY_HANDLE, key_handle, const SIZED_BUFFER*, identity, const SIZED_BUFFER*, ciphertext, const SIZED_BUFFER*, iv, SIZED_BUFFER*, plaintext);
+MOCKABLE_FUNCTION(, int, mocked_hsm_client_key_sign_into, KEY_HANDLE, key_handle, const unsigned char*, data_to_be_signed, size_t, data_len, unsigned char*, digest, size_t*, digest_size);
+MOCKABLE_FUNCTION(, int, mocked_hsm_client_key_derive_and_sign_into, KEY_HANDLE, key_handle, const unsigned char*, data_to_be_signed, size_t, data_len, const unsigned char*, identity, size_t, identity_size, unsigned char*, digest, size_t*, digest_size);
+MOCKABLE_FUNCTION(, int, mocked_hsm_client_key_sign_batch, KEY_HANDLE, key_handle, const HSM_SIGN_REQUEST*, requests, size_t, count, unsigned char*, digests, size_t*, digest_size);
+MOCKABLE_FUNCTION(, int, mocked_hsm_client_key_derive_and_sign_batch, KEY_HANDLE, key_handle, const HSM_SIGN_REQUEST*, requests, size_t, count, unsigned char*, digests, size_t*, digest_size);
 
 // interface mocks
 MOCKABLE_FUNCTION(, const HSM_CLIENT_STORE_INTERFACE*, hsm_client_store_interface);
@@ -93,6 +97,7 @@ MOCKABLE_FUNCTION(, const HSM_CLIENT_KEY_INTERFACE*, hsm_client_key_interface);
 #define TEST_HSM_CLIENT_HANDLE (HSM_CLIENT_HANDLE)0x1002
 #define TEST_SAS_KEY_NAME "edgelet-identity"
 #define TEST_OUTPUT_DIGEST_PTR (unsigned char*)0x5000
+#define TEST_DIGEST_SIZE 32
 
 DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
 
@@ -124,7 +129,12 @@ static const HSM_CLIENT_KEY_INTERFACE mocked_hsm_client_key_interface =
     mocked_hsm_client_key_sign,
     mocked_hsm_client_key_derive_and_sign,
     mocked_hsm_client_key_encrypt,
-    mocked_hsm_client_key_decrypt
+    mocked_hsm_client_key_decrypt,
+    NULL,
+    mocked_hsm_client_key_sign_into,
+    mocked_hsm_client_key_derive_and_sign_into,
+    mocked_hsm_client_key_sign_batch,
+    mocked_hsm_client_key_derive_and_sign_batch
 };
 
 //#############################################################################
@@ -272,6 +282,48 @@ static int test_hook_hsm_client_key_derive_and_sign(KEY_HANDLE key_handle,
     return 0;
 }
 
+static int test_hook_hsm_client_key_sign_into(KEY_HANDLE key_handle,
+                                              const unsigned char* data_to_be_signed,
+                                              size_t data_len,
+                                              unsigned char* digest,
+                                              size_t* digest_size)
+{
+    *digest_size = TEST_DIGEST_SIZE;
+    return 0;
+}
+
+static int test_hook_hsm_client_key_derive_and_sign_into(KEY_HANDLE key_handle,
+                                                         const unsigned char* data_to_be_signed,
+                                                         size_t data_len,
+                                                         const unsigned char* identity,
+                                                         size_t identity_size,
+                                                         unsigned char* digest,
+                                                         size_t* digest_size)
+{
+    *digest_size = TEST_DIGEST_SIZE;
+    return 0;
+}
+
+static int test_hook_hsm_client_key_sign_batch(KEY_HANDLE key_handle,
+                                               const HSM_SIGN_REQUEST* requests,
+                                               size_t count,
+                                               unsigned char* digests,
+                                               size_t* digest_size)
+{
+    *digest_size = TEST_DIGEST_SIZE;
+    return 0;
+}
+
+static int test_hook_hsm_client_key_derive_and_sign_batch(KEY_HANDLE key_handle,
+                                                          const HSM_SIGN_REQUEST* requests,
+                                                          size_t count,
+                                                          unsigned char* digests,
+                                                          size_t* digest_size)
+{
+    *digest_size = TEST_DIGEST_SIZE;
+    return 0;
+}
+
 static int test_hook_hsm_client_key_encrypt(KEY_HANDLE key_handle,
                                             const SIZED_BUFFER *identity,
                                             const SIZED_BUFFER *plaintext,
@@ -383,6 +435,18 @@ BEGIN_TEST_SUITE(edge_hsm_tpm_unittests)
             REGISTER_GLOBAL_MOCK_HOOK(mocked_hsm_client_key_derive_and_sign, test_hook_hsm_client_key_derive_and_sign);
             REGISTER_GLOBAL_MOCK_FAIL_RETURN(mocked_hsm_client_key_derive_and_sign, 1);
 
+            REGISTER_GLOBAL_MOCK_HOOK(mocked_hsm_client_key_sign_into, test_hook_hsm_client_key_sign_into);
+            REGISTER_GLOBAL_MOCK_FAIL_RETURN(mocked_hsm_client_key_sign_into, 1);
+
+            REGISTER_GLOBAL_MOCK_HOOK(mocked_hsm_client_key_derive_and_sign_into, test_hook_hsm_client_key_derive_and_sign_into);
+            REGISTER_GLOBAL_MOCK_FAIL_RETURN(mocked_hsm_client_key_derive_and_sign_into, 1);
+
+            REGISTER_GLOBAL_MOCK_HOOK(mocked_hsm_client_key_sign_batch, test_hook_hsm_client_key_sign_batch);
+            REGISTER_GLOBAL_MOCK_FAIL_RETURN(mocked_hsm_client_key_sign_batch, 1);
+
+            REGISTER_GLOBAL_MOCK_HOOK(mocked_hsm_client_key_derive_and_sign_batch, test_hook_hsm_client_key_derive_and_sign_batch);
+            REGISTER_GLOBAL_MOCK_FAIL_RETURN(mocked_hsm_client_key_derive_and_sign_batch, 1);
+
             REGISTER_GLOBAL_MOCK_HOOK(mocked_hsm_client_key_encrypt, test_hook_hsm_client_key_encrypt);
             REGISTER_GLOBAL_MOCK_FAIL_RETURN(mocked_hsm_client_key_encrypt, 1);
 
@@ -1077,12 +1141,6 @@ BEGIN_TEST_SUITE(edge_hsm_tpm_unittests)
             ASSERT_IS_NULL_WITH_MSG(test_output_buffer, "Line:" TOSTRING(__LINE__));
             ASSERT_IS_TRUE_WITH_MSG((test_output_len == 0), "Line:" TOSTRING(__LINE__));
 
-            test_output_buffer = TEST_OUTPUT_DIGEST_PTR;
-            test_output_len = 10;
-            status = hsm_client_sign_with_identity(hsm_handle, test_input, sizeof(test_input), NULL, &test_output_len);
-            ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
-            ASSERT_IS_TRUE_WITH_MSG((test_output_len == 0), "Line:" TOSTRING(__LINE__));
-
             test_output_buffer = TEST_OUTPUT_DIGEST_PTR;
             test_output_len = 10;
             status = hsm_client_sign_with_identity(hsm_handle, test_input, sizeof(test_input), &test_output_buffer, NULL);
@@ -1114,8 +1172,9 @@ BEGIN_TEST_SUITE(edge_hsm_tpm_unittests)
             umock_c_reset_all_calls();
 
             STRICT_EXPECTED_CALL(mocked_hsm_client_store_open_key(TEST_HSM_STORE_HANDLE, HSM_KEY_SAS, TEST_SAS_KEY_NAME));
-            STRICT_EXPECTED_CALL(mocked_hsm_client_key_sign(TEST_KEY_HANDLE, test_input, sizeof(test_input), &test_output_buffer, &test_output_len));
+            STRICT_EXPECTED_CALL(mocked_hsm_client_key_sign_into(TEST_KEY_HANDLE, test_input, sizeof(test_input), IGNORED_PTR_ARG, IGNORED_PTR_ARG));
             STRICT_EXPECTED_CALL(mocked_hsm_client_store_close_key(TEST_HSM_STORE_HANDLE, TEST_KEY_HANDLE));
+            STRICT_EXPECTED_CALL(gballoc_malloc(TEST_DIGEST_SIZE));
 
             // act
             status = hsm_client_sign_with_identity(hsm_handle, test_input, sizeof(test_input), &test_output_buffer, &test_output_len);
@@ -1125,6 +1184,7 @@ BEGIN_TEST_SUITE(edge_hsm_tpm_unittests)
             ASSERT_ARE_EQUAL_WITH_MSG(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls(), "Line:" TOSTRING(__LINE__));
 
             //cleanup
+            free(test_output_buffer);
             hsm_client_tpm_destroy(hsm_handle);
             hsm_client_tpm_store_deinit();
         }
@@ -1151,8 +1211,9 @@ BEGIN_TEST_SUITE(edge_hsm_tpm_unittests)
             umock_c_reset_all_calls();
 
             STRICT_EXPECTED_CALL(mocked_hsm_client_store_open_key(TEST_HSM_STORE_HANDLE, HSM_KEY_SAS, TEST_SAS_KEY_NAME));
-            STRICT_EXPECTED_CALL(mocked_hsm_client_key_sign(TEST_KEY_HANDLE, test_input, sizeof(test_input), &test_output_buffer, &test_output_len));
+            STRICT_EXPECTED_CALL(mocked_hsm_client_key_sign_into(TEST_KEY_HANDLE, test_input, sizeof(test_input), IGNORED_PTR_ARG, IGNORED_PTR_ARG));
             STRICT_EXPECTED_CALL(mocked_hsm_client_store_close_key(TEST_HSM_STORE_HANDLE, TEST_KEY_HANDLE));
+            STRICT_EXPECTED_CALL(gballoc_malloc(TEST_DIGEST_SIZE));
 
             umock_c_negative_tests_snapshot();
 
@@ -1255,12 +1316,6 @@ BEGIN_TEST_SUITE(edge_hsm_tpm_unittests)
             ASSERT_IS_NULL_WITH_MSG(test_output_buffer, "Line:" TOSTRING(__LINE__));
             ASSERT_IS_TRUE_WITH_MSG((test_output_len == 0), "Line:" TOSTRING(__LINE__));
 
-            test_output_buffer = TEST_OUTPUT_DIGEST_PTR;
-            test_output_len = 10;
-            status = hsm_client_derive_and_sign_with_identity(hsm_handle, test_input, sizeof(test_input), TEST_EDGE_MODULE_IDENTITY, identity_size, NULL, &test_output_len);
-            ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
-            ASSERT_IS_TRUE_WITH_MSG((test_output_len == 0), "Line:" TOSTRING(__LINE__));
-
             test_output_buffer = TEST_OUTPUT_DIGEST_PTR;
             test_output_len = 10;
             status = hsm_client_derive_and_sign_with_identity(hsm_handle, test_input, sizeof(test_input), TEST_EDGE_MODULE_IDENTITY, identity_size, &test_output_buffer, NULL);
@@ -1294,8 +1349,9 @@ BEGIN_TEST_SUITE(edge_hsm_tpm_unittests)
             umock_c_reset_all_calls();
 
             STRICT_EXPECTED_CALL(mocked_hsm_client_store_open_key(TEST_HSM_STORE_HANDLE, HSM_KEY_SAS, TEST_SAS_KEY_NAME));
-            STRICT_EXPECTED_CALL(mocked_hsm_client_key_derive_and_sign(TEST_KEY_HANDLE, test_input, sizeof(test_input), TEST_EDGE_MODULE_IDENTITY, identity_size, &test_output_buffer, &test_output_len));
+            STRICT_EXPECTED_CALL(mocked_hsm_client_key_derive_and_sign_into(TEST_KEY_HANDLE, test_input, sizeof(test_input), TEST_EDGE_MODULE_IDENTITY, identity_size, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
             STRICT_EXPECTED_CALL(mocked_hsm_client_store_close_key(TEST_HSM_STORE_HANDLE, TEST_KEY_HANDLE));
+            STRICT_EXPECTED_CALL(gballoc_malloc(TEST_DIGEST_SIZE));
 
             // act
             status = hsm_client_derive_and_sign_with_identity(hsm_handle, test_input, sizeof(test_input), TEST_EDGE_MODULE_IDENTITY, identity_size, &test_output_buffer, &test_output_len);
@@ -1305,6 +1361,7 @@ BEGIN_TEST_SUITE(edge_hsm_tpm_unittests)
             ASSERT_ARE_EQUAL_WITH_MSG(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls(), "Line:" TOSTRING(__LINE__));
 
             //cleanup
+            free(test_output_buffer);
             hsm_client_tpm_destroy(hsm_handle);
             hsm_client_tpm_store_deinit();
         }
@@ -1333,8 +1390,9 @@ BEGIN_TEST_SUITE(edge_hsm_tpm_unittests)
             umock_c_reset_all_calls();
 
             STRICT_EXPECTED_CALL(mocked_hsm_client_store_open_key(TEST_HSM_STORE_HANDLE, HSM_KEY_SAS, TEST_SAS_KEY_NAME));
-            STRICT_EXPECTED_CALL(mocked_hsm_client_key_derive_and_sign(TEST_KEY_HANDLE, test_input, sizeof(test_input), TEST_EDGE_MODULE_IDENTITY, identity_size, &test_output_buffer, &test_output_len));
+            STRICT_EXPECTED_CALL(mocked_hsm_client_key_derive_and_sign_into(TEST_KEY_HANDLE, test_input, sizeof(test_input), TEST_EDGE_MODULE_IDENTITY, identity_size, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
             STRICT_EXPECTED_CALL(mocked_hsm_client_store_close_key(TEST_HSM_STORE_HANDLE, TEST_KEY_HANDLE));
+            STRICT_EXPECTED_CALL(gballoc_malloc(TEST_DIGEST_SIZE));
 
             umock_c_negative_tests_snapshot();
 
@@ -1356,4 +1414,295 @@ BEGIN_TEST_SUITE(edge_hsm_tpm_unittests)
             umock_c_negative_tests_deinit();
         }
 
+        /**
+         * Test function for API
+         *   hsm_client_sign_with_identity
+        */
+        TEST_FUNCTION(edge_hsm_client_sign_with_identity_null_digest_returns_size)
+        {
+            //arrange
+            int status = hsm_client_tpm_store_init();
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+            const HSM_CLIENT_TPM_INTERFACE* interface = hsm_client_tpm_store_interface();
+            HSM_CLIENT_CREATE hsm_client_tpm_create = interface->hsm_client_tpm_create;
+            HSM_CLIENT_DESTROY hsm_client_tpm_destroy = interface->hsm_client_tpm_destroy;
+            HSM_CLIENT_SIGN_WITH_IDENTITY hsm_client_sign_with_identity = interface->hsm_client_sign_with_identity;
+            HSM_CLIENT_HANDLE hsm_handle = hsm_client_tpm_create();
+            unsigned char test_input[] = {'t', 'e', 's', 't'};
+            size_t test_output_len = 0;
+            umock_c_reset_all_calls();
+
+            STRICT_EXPECTED_CALL(mocked_hsm_client_store_open_key(TEST_HSM_STORE_HANDLE, HSM_KEY_SAS, TEST_SAS_KEY_NAME));
+            STRICT_EXPECTED_CALL(mocked_hsm_client_key_sign_into(TEST_KEY_HANDLE, test_input, sizeof(test_input), NULL, &test_output_len));
+            STRICT_EXPECTED_CALL(mocked_hsm_client_store_close_key(TEST_HSM_STORE_HANDLE, TEST_KEY_HANDLE));
+
+            // act
+            status = hsm_client_sign_with_identity(hsm_handle, test_input, sizeof(test_input), NULL, &test_output_len);
+
+            // assert
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+            ASSERT_ARE_EQUAL_WITH_MSG(size_t, TEST_DIGEST_SIZE, test_output_len, "Line:" TOSTRING(__LINE__));
+            ASSERT_ARE_EQUAL_WITH_MSG(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls(), "Line:" TOSTRING(__LINE__));
+
+            //cleanup
+            hsm_client_tpm_destroy(hsm_handle);
+            hsm_client_tpm_store_deinit();
+        }
+
+        /**
+         * Test function for API
+         *   hsm_client_sign_with_identity_into
+        */
+        TEST_FUNCTION(edge_hsm_client_sign_with_identity_into_success)
+        {
+            //arrange
+            int status = hsm_client_tpm_store_init();
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+            const HSM_CLIENT_TPM_INTERFACE* interface = hsm_client_tpm_store_interface();
+            HSM_CLIENT_CREATE hsm_client_tpm_create = interface->hsm_client_tpm_create;
+            HSM_CLIENT_DESTROY hsm_client_tpm_destroy = interface->hsm_client_tpm_destroy;
+            HSM_CLIENT_SIGN_WITH_IDENTITY_INTO hsm_client_sign_with_identity_into = interface->hsm_client_sign_with_identity_into;
+            HSM_CLIENT_HANDLE hsm_handle = hsm_client_tpm_create();
+            unsigned char test_input[] = {'t', 'e', 's', 't'};
+            unsigned char test_output_buffer[TEST_DIGEST_SIZE];
+            size_t test_output_len = sizeof(test_output_buffer);
+            umock_c_reset_all_calls();
+
+            STRICT_EXPECTED_CALL(mocked_hsm_client_store_open_key(TEST_HSM_STORE_HANDLE, HSM_KEY_SAS, TEST_SAS_KEY_NAME));
+            STRICT_EXPECTED_CALL(mocked_hsm_client_key_sign_into(TEST_KEY_HANDLE, test_input, sizeof(test_input), test_output_buffer, &test_output_len));
+            STRICT_EXPECTED_CALL(mocked_hsm_client_store_close_key(TEST_HSM_STORE_HANDLE, TEST_KEY_HANDLE));
+
+            // act
+            status = hsm_client_sign_with_identity_into(hsm_handle, test_input, sizeof(test_input), test_output_buffer, &test_output_len);
+
+            // assert
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+            ASSERT_ARE_EQUAL_WITH_MSG(size_t, TEST_DIGEST_SIZE, test_output_len, "Line:" TOSTRING(__LINE__));
+            ASSERT_ARE_EQUAL_WITH_MSG(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls(), "Line:" TOSTRING(__LINE__));
+
+            //cleanup
+            hsm_client_tpm_destroy(hsm_handle);
+            hsm_client_tpm_store_deinit();
+        }
+
+        /**
+         * Test function for API
+         *   hsm_client_derive_and_sign_with_identity_into
+        */
+        TEST_FUNCTION(edge_hsm_client_derive_and_sign_with_identity_into_success)
+        {
+            //arrange
+            int status = hsm_client_tpm_store_init();
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+            const HSM_CLIENT_TPM_INTERFACE* interface = hsm_client_tpm_store_interface();
+            HSM_CLIENT_CREATE hsm_client_tpm_create = interface->hsm_client_tpm_create;
+            HSM_CLIENT_DESTROY hsm_client_tpm_destroy = interface->hsm_client_tpm_destroy;
+            HSM_CLIENT_DERIVE_AND_SIGN_WITH_IDENTITY_INTO hsm_client_derive_and_sign_with_identity_into = interface->hsm_client_derive_and_sign_with_identity_into;
+            HSM_CLIENT_HANDLE hsm_handle = hsm_client_tpm_create();
+            unsigned char test_input[] = {'t', 'e', 's', 't'};
+            unsigned char test_output_buffer[TEST_DIGEST_SIZE];
+            size_t test_output_len = sizeof(test_output_buffer);
+            size_t identity_size = sizeof(TEST_EDGE_MODULE_IDENTITY);
+            umock_c_reset_all_calls();
+
+            STRICT_EXPECTED_CALL(mocked_hsm_client_store_open_key(TEST_HSM_STORE_HANDLE, HSM_KEY_SAS, TEST_SAS_KEY_NAME));
+            STRICT_EXPECTED_CALL(mocked_hsm_client_key_derive_and_sign_into(TEST_KEY_HANDLE, test_input, sizeof(test_input), TEST_EDGE_MODULE_IDENTITY, identity_size, test_output_buffer, &test_output_len));
+            STRICT_EXPECTED_CALL(mocked_hsm_client_store_close_key(TEST_HSM_STORE_HANDLE, TEST_KEY_HANDLE));
+
+            // act
+            status = hsm_client_derive_and_sign_with_identity_into(hsm_handle, test_input, sizeof(test_input), TEST_EDGE_MODULE_IDENTITY, identity_size, test_output_buffer, &test_output_len);
+
+            // assert
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+            ASSERT_ARE_EQUAL_WITH_MSG(size_t, TEST_DIGEST_SIZE, test_output_len, "Line:" TOSTRING(__LINE__));
+            ASSERT_ARE_EQUAL_WITH_MSG(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls(), "Line:" TOSTRING(__LINE__));
+
+            //cleanup
+            hsm_client_tpm_destroy(hsm_handle);
+            hsm_client_tpm_store_deinit();
+        }
+
+        /**
+         * Test function for API
+         *   hsm_client_sign_batch
+        */
+        TEST_FUNCTION(edge_hsm_client_sign_batch_opens_key_once_success)
+        {
+            //arrange
+            int status = hsm_client_tpm_store_init();
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+            const HSM_CLIENT_TPM_INTERFACE* interface = hsm_client_tpm_store_interface();
+            HSM_CLIENT_CREATE hsm_client_tpm_create = interface->hsm_client_tpm_create;
+            HSM_CLIENT_DESTROY hsm_client_tpm_destroy = interface->hsm_client_tpm_destroy;
+            HSM_CLIENT_SIGN_BATCH hsm_client_sign_batch = interface->hsm_client_sign_batch;
+            HSM_CLIENT_FREE_BUFFER hsm_client_free_buffer = interface->hsm_client_free_buffer;
+            HSM_CLIENT_HANDLE hsm_handle = hsm_client_tpm_create();
+            unsigned char test_input_1[] = {'t', 'e', 's', 't'};
+            unsigned char test_input_2[] = {'d', 'a', 't', 'a'};
+            HSM_SIGN_REQUEST requests[2] = {
+                { test_input_1, sizeof(test_input_1), NULL, 0 },
+                { test_input_2, sizeof(test_input_2), NULL, 0 }
+            };
+            unsigned char *digests = NULL;
+            size_t digest_size = 0;
+            umock_c_reset_all_calls();
+
+            STRICT_EXPECTED_CALL(mocked_hsm_client_store_open_key(TEST_HSM_STORE_HANDLE, HSM_KEY_SAS, TEST_SAS_KEY_NAME));
+            STRICT_EXPECTED_CALL(mocked_hsm_client_key_sign_batch(TEST_KEY_HANDLE, requests, 2, NULL, IGNORED_PTR_ARG));
+            STRICT_EXPECTED_CALL(gballoc_malloc(2 * TEST_DIGEST_SIZE));
+            STRICT_EXPECTED_CALL(mocked_hsm_client_key_sign_batch(TEST_KEY_HANDLE, requests, 2, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+            STRICT_EXPECTED_CALL(mocked_hsm_client_store_close_key(TEST_HSM_STORE_HANDLE, TEST_KEY_HANDLE));
+
+            // act
+            status = hsm_client_sign_batch(hsm_handle, requests, 2, &digests, &digest_size);
+
+            // assert
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+            ASSERT_IS_NOT_NULL_WITH_MSG(digests, "Line:" TOSTRING(__LINE__));
+            ASSERT_ARE_EQUAL_WITH_MSG(size_t, TEST_DIGEST_SIZE, digest_size, "Line:" TOSTRING(__LINE__));
+            ASSERT_ARE_EQUAL_WITH_MSG(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls(), "Line:" TOSTRING(__LINE__));
+
+            //cleanup
+            hsm_client_free_buffer(digests);
+            hsm_client_tpm_destroy(hsm_handle);
+            hsm_client_tpm_store_deinit();
+        }
+
+        /**
+         * Test function for API
+         *   hsm_client_derive_and_sign_batch
+        */
+        TEST_FUNCTION(edge_hsm_client_derive_and_sign_batch_opens_key_once_success)
+        {
+            //arrange
+            int status = hsm_client_tpm_store_init();
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+            const HSM_CLIENT_TPM_INTERFACE* interface = hsm_client_tpm_store_interface();
+            HSM_CLIENT_CREATE hsm_client_tpm_create = interface->hsm_client_tpm_create;
+            HSM_CLIENT_DESTROY hsm_client_tpm_destroy = interface->hsm_client_tpm_destroy;
+            HSM_CLIENT_DERIVE_AND_SIGN_BATCH hsm_client_derive_and_sign_batch = interface->hsm_client_derive_and_sign_batch;
+            HSM_CLIENT_FREE_BUFFER hsm_client_free_buffer = interface->hsm_client_free_buffer;
+            HSM_CLIENT_HANDLE hsm_handle = hsm_client_tpm_create();
+            unsigned char test_input[] = {'t', 'e', 's', 't'};
+            size_t identity_size = sizeof(TEST_EDGE_MODULE_IDENTITY);
+            HSM_SIGN_REQUEST requests[2] = {
+                { test_input, sizeof(test_input), TEST_EDGE_MODULE_IDENTITY, identity_size },
+                { test_input, sizeof(test_input), TEST_EDGE_MODULE_IDENTITY, identity_size }
+            };
+            unsigned char *digests = NULL;
+            size_t digest_size = 0;
+            umock_c_reset_all_calls();
+
+            STRICT_EXPECTED_CALL(mocked_hsm_client_store_open_key(TEST_HSM_STORE_HANDLE, HSM_KEY_SAS, TEST_SAS_KEY_NAME));
+            STRICT_EXPECTED_CALL(mocked_hsm_client_key_derive_and_sign_batch(TEST_KEY_HANDLE, requests, 2, NULL, IGNORED_PTR_ARG));
+            STRICT_EXPECTED_CALL(gballoc_malloc(2 * TEST_DIGEST_SIZE));
+            STRICT_EXPECTED_CALL(mocked_hsm_client_key_derive_and_sign_batch(TEST_KEY_HANDLE, requests, 2, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+            STRICT_EXPECTED_CALL(mocked_hsm_client_store_close_key(TEST_HSM_STORE_HANDLE, TEST_KEY_HANDLE));
+
+            // act
+            status = hsm_client_derive_and_sign_batch(hsm_handle, requests, 2, &digests, &digest_size);
+
+            // assert
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+            ASSERT_IS_NOT_NULL_WITH_MSG(digests, "Line:" TOSTRING(__LINE__));
+            ASSERT_ARE_EQUAL_WITH_MSG(size_t, TEST_DIGEST_SIZE, digest_size, "Line:" TOSTRING(__LINE__));
+            ASSERT_ARE_EQUAL_WITH_MSG(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls(), "Line:" TOSTRING(__LINE__));
+
+            //cleanup
+            hsm_client_free_buffer(digests);
+            hsm_client_tpm_destroy(hsm_handle);
+            hsm_client_tpm_store_deinit();
+        }
+
+        /**
+         * Test function for API
+         *   hsm_client_sign_batch
+        */
+        TEST_FUNCTION(edge_hsm_client_sign_batch_invalid_param_does_not_open_key)
+        {
+            //arrange
+            int status = hsm_client_tpm_store_init();
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+            const HSM_CLIENT_TPM_INTERFACE* interface = hsm_client_tpm_store_interface();
+            HSM_CLIENT_CREATE hsm_client_tpm_create = interface->hsm_client_tpm_create;
+            HSM_CLIENT_DESTROY hsm_client_tpm_destroy = interface->hsm_client_tpm_destroy;
+            HSM_CLIENT_SIGN_BATCH hsm_client_sign_batch = interface->hsm_client_sign_batch;
+            HSM_CLIENT_DERIVE_AND_SIGN_BATCH hsm_client_derive_and_sign_batch = interface->hsm_client_derive_and_sign_batch;
+            HSM_CLIENT_HANDLE hsm_handle = hsm_client_tpm_create();
+            unsigned char test_input[] = {'t', 'e', 's', 't'};
+            HSM_SIGN_REQUEST requests[2] = {
+                { test_input, sizeof(test_input), NULL, 0 },
+                { NULL, 0, NULL, 0 }
+            };
+            unsigned char *digests = NULL;
+            size_t digest_size = 0;
+            umock_c_reset_all_calls();
+
+            // act, assert
+            status = hsm_client_sign_batch(NULL, requests, 1, &digests, &digest_size);
+            ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+            status = hsm_client_sign_batch(hsm_handle, NULL, 1, &digests, &digest_size);
+            ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+            status = hsm_client_sign_batch(hsm_handle, requests, 0, &digests, &digest_size);
+            ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+            status = hsm_client_sign_batch(hsm_handle, requests, 2, &digests, &digest_size);
+            ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+            status = hsm_client_sign_batch(hsm_handle, requests, 1, NULL, &digest_size);
+            ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+            status = hsm_client_derive_and_sign_batch(hsm_handle, requests, 1, &digests, &digest_size);
+            ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+            ASSERT_IS_NULL_WITH_MSG(digests, "Line:" TOSTRING(__LINE__));
+            ASSERT_ARE_EQUAL_WITH_MSG(size_t, 0, digest_size, "Line:" TOSTRING(__LINE__));
+            ASSERT_ARE_EQUAL_WITH_MSG(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls(), "Line:" TOSTRING(__LINE__));
+
+            //cleanup
+            hsm_client_tpm_destroy(hsm_handle);
+            hsm_client_tpm_store_deinit();
+        }
+
+        /**
+         * Test function for API
+         *   hsm_client_sign_batch
+        */
+        TEST_FUNCTION(edge_hsm_client_sign_batch_key_failure_frees_digests)
+        {
+            //arrange
+            int status = hsm_client_tpm_store_init();
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+            const HSM_CLIENT_TPM_INTERFACE* interface = hsm_client_tpm_store_interface();
+            HSM_CLIENT_CREATE hsm_client_tpm_create = interface->hsm_client_tpm_create;
+            HSM_CLIENT_DESTROY hsm_client_tpm_destroy = interface->hsm_client_tpm_destroy;
+            HSM_CLIENT_SIGN_BATCH hsm_client_sign_batch = interface->hsm_client_sign_batch;
+            HSM_CLIENT_HANDLE hsm_handle = hsm_client_tpm_create();
+            unsigned char test_input[] = {'t', 'e', 's', 't'};
+            HSM_SIGN_REQUEST requests[2] = {
+                { test_input, sizeof(test_input), NULL, 0 },
+                { test_input, sizeof(test_input), NULL, 0 }
+            };
+            unsigned char *digests = NULL;
+            size_t digest_size = 0;
+            umock_c_reset_all_calls();
+
+            STRICT_EXPECTED_CALL(mocked_hsm_client_store_open_key(TEST_HSM_STORE_HANDLE, HSM_KEY_SAS, TEST_SAS_KEY_NAME));
+            STRICT_EXPECTED_CALL(mocked_hsm_client_key_sign_batch(TEST_KEY_HANDLE, requests, 2, NULL, IGNORED_PTR_ARG));
+            STRICT_EXPECTED_CALL(gballoc_malloc(2 * TEST_DIGEST_SIZE));
+            STRICT_EXPECTED_CALL(mocked_hsm_client_key_sign_batch(TEST_KEY_HANDLE, requests, 2, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+                .SetReturn(1);
+            STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+            STRICT_EXPECTED_CALL(mocked_hsm_client_store_close_key(TEST_HSM_STORE_HANDLE, TEST_KEY_HANDLE));
+
+            // act
+            status = hsm_client_sign_batch(hsm_handle, requests, 2, &digests, &digest_size);
+
+            // assert
+            ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+            ASSERT_IS_NULL_WITH_MSG(digests, "Line:" TOSTRING(__LINE__));
+            ASSERT_ARE_EQUAL_WITH_MSG(size_t, 0, digest_size, "Line:" TOSTRING(__LINE__));
+            ASSERT_ARE_EQUAL_WITH_MSG(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls(), "Line:" TOSTRING(__LINE__));
+
+            //cleanup
+            hsm_client_tpm_destroy(hsm_handle);
+            hsm_client_tpm_store_deinit();
+        }
+
 END_TEST_SUITE(edge_hsm_tpm_unittests)
@@ -0,0 +1,122 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "azure_c_shared_utility/gballoc.h"
+#include "hsm_utils.h"
+
+//#############################################################################
+// Benchmark defines and data
+//#############################################################################
+// roughly the size of a PEM encoded RSA 2048 CA certificate
+#define BENCH_FILE_SIZE 1800
+#define BENCH_MAX_FILES 1000
+#define BENCH_ITERATIONS 20
+#define BENCH_FILE_NAME_FMT "bench_ca_%04d.pem"
+#define BENCH_FILE_NAME_SIZE 32
+
+static const int BENCH_FILE_COUNTS[] = { 1, 10, 100, 250, 500, 1000 };
+
+//#############################################################################
+// Benchmark helpers
+//#############################################################################
+
+static double bench_now_seconds(void)
+{
+    return (double)clock() / (double)CLOCKS_PER_SEC;
+}
+
+static int bench_create_files(char names[][BENCH_FILE_NAME_SIZE], int num_files)
+{
+    int result = 0;
+    int index;
+    char contents[BENCH_FILE_SIZE + 1];
+
+    for (index = 0; (index < num_files) && (result == 0); index++)
+    {
+        memset(contents, 'A' + (index % 26), BENCH_FILE_SIZE);
+        contents[BENCH_FILE_SIZE - 1] = '\n';
+        contents[BENCH_FILE_SIZE] = 0;
+        (void)snprintf(names[index], BENCH_FILE_NAME_SIZE, BENCH_FILE_NAME_FMT, index);
+        if (write_cstring_to_file(names[index], contents) != 0)
+        {
+            printf("Could not create benchmark file %s\n", names[index]);
+            result = __LINE__;
+        }
+    }
+
+    return result;
+}
+
+static void bench_delete_files(char names[][BENCH_FILE_NAME_SIZE], int num_files)
+{
+    int index;
+    for (index = 0; index < num_files; index++)
+    {
+        (void)delete_file(names[index]);
+    }
+}
+
+static int bench_concat(const char **file_names, int num_files)
+{
+    int result = 0;
+    int iter;
+    double start, elapsed;
+    size_t expected_length = (size_t)num_files * BENCH_FILE_SIZE;
+
+    start = bench_now_seconds();
+    for (iter = 0; (iter < BENCH_ITERATIONS) && (result == 0); iter++)
+    {
+        char *output = concat_files_to_cstring(file_names, num_files);
+        if ((output == NULL) || (strlen(output) != expected_length))
+        {
+            printf("Unexpected concatenation result for %d files\n", num_files);
+            result = __LINE__;
+        }
+        free(output);
+    }
+    elapsed = (bench_now_seconds() - start) / BENCH_ITERATIONS;
+
+    if (result == 0)
+    {
+        printf("%6d files %10zu bytes: %10.3f ms per call, %8.3f us per file\n",
+               num_files, expected_length, elapsed * 1e3, (elapsed * 1e6) / num_files);
+    }
+
+    return result;
+}
+
+//#############################################################################
+// Benchmark
+//#############################################################################
+
+int main(void)
+{
+    int result;
+    static char names[BENCH_MAX_FILES][BENCH_FILE_NAME_SIZE];
+    static const char *file_names[BENCH_MAX_FILES];
+    int index;
+
+    for (index = 0; index < BENCH_MAX_FILES; index++)
+    {
+        file_names[index] = names[index];
+    }
+
+    if ((result = bench_create_files(names, BENCH_MAX_FILES)) == 0)
+    {
+        // the cost per file should remain flat as the number of files grows
+        printf("concat_files_to_cstring, average of %d calls\n", BENCH_ITERATIONS);
+        for (index = 0; (index < (int)(sizeof(BENCH_FILE_COUNTS) / sizeof(BENCH_FILE_COUNTS[0]))) && (result == 0); index++)
+        {
+            result = bench_concat(file_names, BENCH_FILE_COUNTS[index]);
+        }
+    }
+    bench_delete_files(names, BENCH_MAX_FILES);
+
+    return result;
+}
@@ -31,6 +31,11 @@
 #define TEST_FILE_EMPTY "test_empty.txt"
 #define TEST_WRITE_FILE "test_write_data.txt"
 #define TEST_WRITE_FILE_FOR_DELETE "test_write_data_del.txt"
+#define TEST_WRITE_FILE_FOR_MAP "test_write_data_map.txt"
+#define TEST_WRITE_FILE_FOR_APPEND "test_write_data_append.txt"
+#define TEST_WRITE_FILE_FOR_REPLACE "test_write_data_replace.txt"
+// large enough to exercise the memory mapped path
+#define TEST_MAPPED_FILE_SIZE (256 * 1024)
 
 static char ALPHA[] = "ABCD";
 static char ALPHA_NEWLINE[] = "AB\nCD\n";
@@ -342,6 +347,99 @@ BEGIN_TEST_SUITE(edge_hsm_util_int_tests)
             // cleanup
         }
 
+        TEST_FUNCTION(read_file_mapped_smoke)
+        {
+            // arrange
+            size_t mapped_size = 0;
+
+            // act
+            const void *mapped_data = read_file_mapped(TEST_FILE_NUMERIC_NEWLINE, &mapped_size);
+
+            // assert
+            ASSERT_IS_NOT_NULL(mapped_data);
+            ASSERT_ARE_EQUAL_WITH_MSG(size_t, sizeof(NUMERIC_NEWLINE), mapped_size, "Line:" TOSTRING(__LINE__));
+            int cmp_result = memcmp(NUMERIC_NEWLINE, mapped_data, sizeof(NUMERIC_NEWLINE));
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, cmp_result, "Line:" TOSTRING(__LINE__));
+
+            // cleanup
+            unmap_file(mapped_data, mapped_size);
+        }
+
+        TEST_FUNCTION(read_file_mapped_large_file_smoke)
+        {
+            // arrange
+            size_t index, mapped_size = 0;
+            char *input_string = (char*)malloc(TEST_MAPPED_FILE_SIZE + 1);
+            ASSERT_IS_NOT_NULL(input_string);
+            for (index = 0; index < TEST_MAPPED_FILE_SIZE; index++)
+            {
+                input_string[index] = (char)('A' + (index % 26));
+            }
+            input_string[TEST_MAPPED_FILE_SIZE] = 0;
+            int status = write_cstring_to_file(TEST_WRITE_FILE_FOR_MAP, input_string);
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+
+            // act
+            const void *mapped_data = read_file_mapped(TEST_WRITE_FILE_FOR_MAP, &mapped_size);
+
+            // assert
+            ASSERT_IS_NOT_NULL(mapped_data);
+            ASSERT_ARE_EQUAL_WITH_MSG(size_t, TEST_MAPPED_FILE_SIZE, mapped_size, "Line:" TOSTRING(__LINE__));
+            int cmp_result = memcmp(input_string, mapped_data, TEST_MAPPED_FILE_SIZE);
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, cmp_result, "Line:" TOSTRING(__LINE__));
+
+            // cleanup
+            unmap_file(mapped_data, mapped_size);
+            (void)delete_file(TEST_WRITE_FILE_FOR_MAP);
+            free(input_string);
+        }
+
+        TEST_FUNCTION(read_file_mapped_invalid_params_returns_null)
+        {
+            // arrange
+            size_t mapped_size;
+            const void *mapped_data;
+
+            // act, assert
+            mapped_size = 100;
+            mapped_data = read_file_mapped(NULL, &mapped_size);
+            ASSERT_IS_NULL(mapped_data);
+            ASSERT_ARE_EQUAL_WITH_MSG(size_t, 0, mapped_size, "Line:" TOSTRING(__LINE__));
+
+            // act, assert
+            mapped_size = 100;
+            mapped_data = read_file_mapped("", &mapped_size);
+            ASSERT_IS_NULL(mapped_data);
+            ASSERT_ARE_EQUAL_WITH_MSG(size_t, 0, mapped_size, "Line:" TOSTRING(__LINE__));
+
+            // act, assert
+            mapped_data = read_file_mapped(TEST_FILE_NUMERIC, NULL);
+            ASSERT_IS_NULL(mapped_data);
+
+            // cleanup
+        }
+
+        TEST_FUNCTION(read_file_mapped_empty_or_missing_file_returns_null)
+        {
+            // arrange
+            size_t mapped_size;
+            const void *mapped_data;
+
+            // act, assert
+            mapped_size = 100;
+            mapped_data = read_file_mapped(TEST_FILE_EMPTY, &mapped_size);
+            ASSERT_IS_NULL(mapped_data);
+            ASSERT_ARE_EQUAL_WITH_MSG(size_t, 0, mapped_size, "Line:" TOSTRING(__LINE__));
+
+            // act, assert
+            mapped_size = 100;
+            mapped_data = read_file_mapped(TEST_FILE_BAD, &mapped_size);
+            ASSERT_IS_NULL(mapped_data);
+            ASSERT_ARE_EQUAL_WITH_MSG(size_t, 0, mapped_size, "Line:" TOSTRING(__LINE__));
+
+            // cleanup
+        }
+
         TEST_FUNCTION(concat_files_to_cstring_invalid_params)
         {
             // arrange
@@ -644,6 +742,52 @@ BEGIN_TEST_SUITE(edge_hsm_util_int_tests)
             // cleanup
         }
 
+        TEST_FUNCTION(test_append_buffer_to_file_smoke)
+        {
+            // arrange
+            const char *expected_string = "abcdefgh";
+            size_t output_size = 0;
+            delete_file_if_exists(TEST_WRITE_FILE_FOR_APPEND);
+
+            // act
+            int status_1 = append_buffer_to_file(TEST_WRITE_FILE_FOR_APPEND, (const unsigned char*)"abcd", 4, false);
+            int status_2 = append_buffer_to_file(TEST_WRITE_FILE_FOR_APPEND, (const unsigned char*)"efgh", 4, false);
+            char *output_string = read_file_into_cstring(TEST_WRITE_FILE_FOR_APPEND, &output_size);
+
+            // assert
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status_1, "Line:" TOSTRING(__LINE__));
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status_2, "Line:" TOSTRING(__LINE__));
+            ASSERT_IS_NOT_NULL_WITH_MSG(output_string, "Line:" TOSTRING(__LINE__));
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, strcmp(expected_string, output_string), "Line:" TOSTRING(__LINE__));
+
+            // cleanup
+            free(output_string);
+            delete_file_if_exists(TEST_WRITE_FILE_FOR_APPEND);
+        }
+
+        TEST_FUNCTION(test_replace_file_smoke)
+        {
+            // arrange
+            const char *expected_string = "efgh";
+            size_t output_size = 0;
+            ASSERT_ARE_EQUAL(int, 0, write_cstring_to_file(TEST_WRITE_FILE_FOR_REPLACE, "abcd"));
+            ASSERT_ARE_EQUAL(int, 0, write_cstring_to_file(TEST_WRITE_FILE_FOR_APPEND, expected_string));
+
+            // act
+            int status = replace_file(TEST_WRITE_FILE_FOR_APPEND, TEST_WRITE_FILE_FOR_REPLACE);
+            char *output_string = read_file_into_cstring(TEST_WRITE_FILE_FOR_REPLACE, &output_size);
+
+            // assert
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+            ASSERT_IS_FALSE_WITH_MSG(is_file_valid(TEST_WRITE_FILE_FOR_APPEND), "Line:" TOSTRING(__LINE__));
+            ASSERT_IS_NOT_NULL_WITH_MSG(output_string, "Line:" TOSTRING(__LINE__));
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, strcmp(expected_string, output_string), "Line:" TOSTRING(__LINE__));
+
+            // cleanup
+            free(output_string);
+            delete_file_if_exists(TEST_WRITE_FILE_FOR_REPLACE);
+        }
+
         TEST_FUNCTION(test_hsm_env_input)
         {
             // arrange
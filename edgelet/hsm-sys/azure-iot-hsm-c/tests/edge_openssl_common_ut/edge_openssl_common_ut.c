@@ -48,6 +48,12 @@ MOCKABLE_FUNCTION(, void, mocked_OpenSSL_add_all_algorithms);
 MOCKABLE_FUNCTION(, int, ERR_load_BIO_strings);
 MOCKABLE_FUNCTION(, void, ERR_load_crypto_strings);
 
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+typedef void (*TEST_LOCKING_CALLBACK)(int mode, int type, const char *file, int line);
+MOCKABLE_FUNCTION(, TEST_LOCKING_CALLBACK, CRYPTO_get_locking_callback);
+MOCKABLE_FUNCTION(, void, CRYPTO_set_locking_callback, TEST_LOCKING_CALLBACK, func);
+#endif
+
 #undef ENABLE_MOCKS
 
 //#############################################################################
@@ -105,6 +111,11 @@ BEGIN_TEST_SUITE(edge_openssl_common_ut)
         umock_c_init(test_hook_on_umock_c_error);
         ASSERT_ARE_EQUAL(int, 0, umocktypes_charptr_register_types() );
 
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+        REGISTER_UMOCK_ALIAS_TYPE(TEST_LOCKING_CALLBACK, void*);
+#endif
+        REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, test_hook_gballoc_malloc);
+        REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, test_hook_gballoc_free);
         REGISTER_GLOBAL_MOCK_HOOK(mocked_OpenSSL_add_all_algorithms, test_hook_mocked_OpenSSL_add_all_algorithms);
         REGISTER_GLOBAL_MOCK_HOOK(ERR_load_BIO_strings, test_hook_ERR_load_BIO_strings);
         REGISTER_GLOBAL_MOCK_HOOK(ERR_load_crypto_strings, test_hook_ERR_load_crypto_strings);
@@ -140,6 +151,14 @@ BEGIN_TEST_SUITE(edge_openssl_common_ut)
     TEST_FUNCTION(initialize_openssl_initializes_just_once_success)
     {
         // arrange
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+        EXPECTED_CALL(CRYPTO_get_locking_callback());
+        for (int i = 0; i < CRYPTO_NUM_LOCKS; i++)
+        {
+            EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+        }
+        EXPECTED_CALL(CRYPTO_set_locking_callback(IGNORED_PTR_ARG));
+#endif
         EXPECTED_CALL(mocked_OpenSSL_add_all_algorithms());
         EXPECTED_CALL(ERR_load_BIO_strings());
         EXPECTED_CALL(ERR_load_crypto_strings());
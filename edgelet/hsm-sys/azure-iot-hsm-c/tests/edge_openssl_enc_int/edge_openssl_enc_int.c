@@ -1,6 +1,7 @@
 // Copyright (c) Microsoft. All rights reserved.
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -92,6 +93,11 @@ size_t TEST_CIPHER_SIZE = sizeof(TEST_CIPHER);
 #define TEST_TAG_OFFSET (TEST_VERSION_OFFSET + TEST_VERSION_SIZE)
 #define TEST_CIPHERTEXT_OFFSET (TEST_TAG_OFFSET + (TEST_TAG_SIZE))
 
+#define TEST_STREAM_VERSION 2
+#define TEST_STREAM_HEADER_SIZE 5
+#define TEST_STREAM_CHUNK_SIZE (64 * 1024)
+#define TEST_STREAM_RECORD_SIZE (TEST_TAG_SIZE + TEST_STREAM_CHUNK_SIZE)
+
 //#############################################################################
 // Test helpers
 //#############################################################################
@@ -111,6 +117,95 @@ static void test_helper_setup_homedir(void)
 #endif
 }
 
+static unsigned char* test_helper_create_data(size_t size)
+{
+    unsigned char *data = (unsigned char*)malloc(size + 1);
+    ASSERT_IS_NOT_NULL_WITH_MSG(data, "Line:" TOSTRING(__LINE__));
+    for (size_t i = 0; i < size; i++)
+    {
+        data[i] = (unsigned char)((i * 31) + (i >> 8));
+    }
+
+    return data;
+}
+
+static size_t test_helper_stream_ciphertext_size(size_t plaintext_size)
+{
+    size_t records = (plaintext_size == 0) ? 1 :
+        ((plaintext_size + TEST_STREAM_CHUNK_SIZE - 1) / TEST_STREAM_CHUNK_SIZE);
+
+    return TEST_STREAM_HEADER_SIZE + (records * TEST_TAG_SIZE) + plaintext_size;
+}
+
+// Runs input through a stream in pieces of piece_size bytes, sizing every
+// output with a size query first. Returns the status of the first failing call.
+static int test_helper_run_stream
+(
+    KEY_HANDLE key_handle,
+    bool is_encrypt,
+    const SIZED_BUFFER *id,
+    const SIZED_BUFFER *iv,
+    const unsigned char *input,
+    size_t input_size,
+    size_t piece_size,
+    unsigned char **output,
+    size_t *output_size
+)
+{
+    KEY_STREAM_HANDLE stream = NULL;
+    size_t capacity = input_size + TEST_STREAM_RECORD_SIZE;
+    size_t offset = 0;
+    size_t needed;
+    size_t written;
+    int status;
+
+    *output = (unsigned char*)malloc(capacity);
+    ASSERT_IS_NOT_NULL_WITH_MSG(*output, "Line:" TOSTRING(__LINE__));
+    *output_size = 0;
+    status = is_encrypt ? key_encrypt_init(key_handle, id, iv, &stream) :
+                          key_decrypt_init(key_handle, id, iv, &stream);
+    ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+    ASSERT_IS_NOT_NULL_WITH_MSG(stream, "Line:" TOSTRING(__LINE__));
+
+    for (size_t consumed = 0; (status == 0) && (consumed < input_size); consumed += piece_size)
+    {
+        size_t count = ((input_size - consumed) < piece_size) ? (input_size - consumed) : piece_size;
+        if ((status = key_stream_update(key_handle, stream, input + consumed, count, NULL, &needed)) == 0)
+        {
+            ASSERT_IS_TRUE_WITH_MSG((offset + needed) <= capacity, "Line:" TOSTRING(__LINE__));
+            written = capacity - offset;
+            if ((status = key_stream_update(key_handle, stream, input + consumed, count, *output + offset, &written)) == 0)
+            {
+                ASSERT_ARE_EQUAL_WITH_MSG(size_t, needed, written, "Line:" TOSTRING(__LINE__));
+                offset += written;
+            }
+        }
+    }
+    if ((status == 0) && ((status = key_stream_final(key_handle, stream, NULL, &needed)) == 0))
+    {
+        ASSERT_IS_TRUE_WITH_MSG((offset + needed) <= capacity, "Line:" TOSTRING(__LINE__));
+        written = capacity - offset;
+        if ((status = key_stream_final(key_handle, stream, *output + offset, &written)) == 0)
+        {
+            ASSERT_ARE_EQUAL_WITH_MSG(size_t, needed, written, "Line:" TOSTRING(__LINE__));
+            offset += written;
+        }
+    }
+    key_stream_destroy(key_handle, stream);
+
+    if (status == 0)
+    {
+        *output_size = offset;
+    }
+    else
+    {
+        free(*output);
+        *output = NULL;
+    }
+
+    return status;
+}
+
 //#############################################################################
 // Test cases
 //#############################################################################
@@ -436,6 +531,334 @@ BEGIN_TEST_SUITE(edge_openssl_enc_tests)
         key_destroy(key_handle);
     }
 
+    TEST_FUNCTION(test_enc_dec_repeated_with_same_key_success)
+    {
+        // arrange
+        int status;
+        size_t round;
+        KEY_HANDLE key_handle = create_encryption_key(TEST_KEY, TEST_KEY_SIZE);
+        ASSERT_IS_NOT_NULL_WITH_MSG(key_handle, "Line:" TOSTRING(__LINE__));
+        SIZED_BUFFER id = {TEST_ID_1, TEST_ID_1_SIZE};
+        SIZED_BUFFER id2 = {TEST_ID_2, TEST_ID_2_SIZE};
+        SIZED_BUFFER plaintext = {TEST_STRING, TEST_STRING_SIZE};
+        SIZED_BUFFER iv = {TEST_IV, TEST_IV_SIZE};
+        SIZED_BUFFER iv_large = {TEST_IV_LARGE, TEST_IV_LARGE_SIZE};
+
+        // act, assert
+        // the key keeps its cipher contexts between calls, every operation
+        // must start over from its own IV whatever the previous one did
+        for (round = 0; round < 3; round++)
+        {
+            SIZED_BUFFER ciphertext_result = {NULL, 0};
+            SIZED_BUFFER large_iv_ciphertext_result = {NULL, 0};
+            SIZED_BUFFER plaintext_result = {NULL, 0};
+
+            status = key_encrypt(key_handle, &id, &plaintext, &iv, &ciphertext_result);
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+            status = memcmp(ciphertext_result.buffer + TEST_TAG_OFFSET, TEST_TAG, TEST_TAG_SIZE);
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+            status = memcmp(ciphertext_result.buffer + TEST_CIPHERTEXT_OFFSET, TEST_CIPHER, TEST_CIPHER_SIZE);
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+
+            status = key_encrypt(key_handle, &id, &plaintext, &iv_large, &large_iv_ciphertext_result);
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+
+            status = key_decrypt(key_handle, &id2, &ciphertext_result, &iv, &plaintext_result);
+            ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+
+            status = key_decrypt(key_handle, &id, &ciphertext_result, &iv, &plaintext_result);
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+            ASSERT_ARE_EQUAL_WITH_MSG(size_t, TEST_STRING_SIZE, plaintext_result.size, "Line:" TOSTRING(__LINE__));
+            status = memcmp(TEST_STRING, plaintext_result.buffer, plaintext_result.size);
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+            free(plaintext_result.buffer);
+            plaintext_result.buffer = NULL;
+
+            status = key_decrypt(key_handle, &id, &large_iv_ciphertext_result, &iv_large, &plaintext_result);
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+            status = memcmp(TEST_STRING, plaintext_result.buffer, plaintext_result.size);
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+
+            free(plaintext_result.buffer);
+            free(large_iv_ciphertext_result.buffer);
+            free(ciphertext_result.buffer);
+        }
+
+        // cleanup
+        key_destroy(key_handle);
+    }
+
+    TEST_FUNCTION(test_stream_enc_dec_success)
+    {
+        // arrange
+        static const size_t sizes[] = {
+            0, 1, TEST_STREAM_CHUNK_SIZE - 1, TEST_STREAM_CHUNK_SIZE, TEST_STREAM_CHUNK_SIZE + 1,
+            (3 * TEST_STREAM_CHUNK_SIZE) + 5
+        };
+        static const size_t piece_sizes[] = { 7, 1000, TEST_STREAM_CHUNK_SIZE, 4 * TEST_STREAM_CHUNK_SIZE };
+        KEY_HANDLE key_handle = create_encryption_key(TEST_KEY, TEST_KEY_SIZE);
+        ASSERT_IS_NOT_NULL_WITH_MSG(key_handle, "Line:" TOSTRING(__LINE__));
+        SIZED_BUFFER id = {TEST_ID_1, TEST_ID_1_SIZE};
+        SIZED_BUFFER iv = {TEST_IV, TEST_IV_SIZE};
+
+        for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+        {
+            unsigned char *plaintext = test_helper_create_data(sizes[i]);
+            unsigned char *expected = NULL;
+            size_t expected_size = 0;
+
+            for (size_t j = 0; j < sizeof(piece_sizes) / sizeof(piece_sizes[0]); j++)
+            {
+                unsigned char *ciphertext, *decrypted;
+                size_t ciphertext_size, decrypted_size;
+                SIZED_BUFFER ciphertext_buffer, plaintext_result = {NULL, 0};
+
+                // act, assert (encrypt)
+                int status = test_helper_run_stream(key_handle, true, &id, &iv, plaintext, sizes[i],
+                                                    piece_sizes[j], &ciphertext, &ciphertext_size);
+                ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+                ASSERT_ARE_EQUAL_WITH_MSG(size_t, test_helper_stream_ciphertext_size(sizes[i]), ciphertext_size, "Line:" TOSTRING(__LINE__));
+                ASSERT_ARE_EQUAL_WITH_MSG(int, TEST_STREAM_VERSION, ciphertext[0], "Line:" TOSTRING(__LINE__));
+                if (expected == NULL)
+                {
+                    expected = ciphertext;
+                    expected_size = ciphertext_size;
+                }
+                else
+                {
+                    // the ciphertext does not depend on how the plaintext was split
+                    ASSERT_ARE_EQUAL_WITH_MSG(size_t, expected_size, ciphertext_size, "Line:" TOSTRING(__LINE__));
+                    status = memcmp(expected, ciphertext, ciphertext_size);
+                    ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+                }
+
+                // act, assert (stream decrypt)
+                status = test_helper_run_stream(key_handle, false, &id, &iv, ciphertext, ciphertext_size,
+                                                piece_sizes[j], &decrypted, &decrypted_size);
+                ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+                ASSERT_ARE_EQUAL_WITH_MSG(size_t, sizes[i], decrypted_size, "Line:" TOSTRING(__LINE__));
+                status = memcmp(plaintext, decrypted, sizes[i]);
+                ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+
+                // act, assert (one shot decrypt)
+                ciphertext_buffer.buffer = ciphertext;
+                ciphertext_buffer.size = ciphertext_size;
+                status = key_decrypt(key_handle, &id, &ciphertext_buffer, &iv, &plaintext_result);
+                ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+                ASSERT_ARE_EQUAL_WITH_MSG(size_t, sizes[i], plaintext_result.size, "Line:" TOSTRING(__LINE__));
+                status = memcmp(plaintext, plaintext_result.buffer, sizes[i]);
+                ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+
+                // cleanup
+                free(plaintext_result.buffer);
+                free(decrypted);
+                if (ciphertext != expected)
+                {
+                    free(ciphertext);
+                }
+            }
+
+            // cleanup
+            free(expected);
+            free(plaintext);
+        }
+
+        // cleanup
+        key_destroy(key_handle);
+    }
+
+    TEST_FUNCTION(test_stream_dec_with_a_different_id_fails)
+    {
+        // arrange
+        KEY_HANDLE key_handle = create_encryption_key(TEST_KEY, TEST_KEY_SIZE);
+        ASSERT_IS_NOT_NULL_WITH_MSG(key_handle, "Line:" TOSTRING(__LINE__));
+        SIZED_BUFFER id = {TEST_ID_1, TEST_ID_1_SIZE};
+        SIZED_BUFFER id2 = {TEST_ID_2, TEST_ID_2_SIZE};
+        SIZED_BUFFER iv = {TEST_IV, TEST_IV_SIZE};
+        unsigned char *plaintext = test_helper_create_data(TEST_STREAM_CHUNK_SIZE + 1);
+        unsigned char *ciphertext, *decrypted;
+        size_t ciphertext_size, decrypted_size;
+        int status = test_helper_run_stream(key_handle, true, &id, &iv, plaintext, TEST_STREAM_CHUNK_SIZE + 1,
+                                            TEST_STREAM_CHUNK_SIZE, &ciphertext, &ciphertext_size);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+
+        // act
+        status = test_helper_run_stream(key_handle, false, &id2, &iv, ciphertext, ciphertext_size,
+                                        ciphertext_size, &decrypted, &decrypted_size);
+
+        // assert
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        ASSERT_IS_NULL_WITH_MSG(decrypted, "Line:" TOSTRING(__LINE__));
+
+        // cleanup
+        free(ciphertext);
+        free(plaintext);
+        key_destroy(key_handle);
+    }
+
+    TEST_FUNCTION(test_stream_dec_modified_ciphertext_fails)
+    {
+        // arrange
+        KEY_HANDLE key_handle = create_encryption_key(TEST_KEY, TEST_KEY_SIZE);
+        ASSERT_IS_NOT_NULL_WITH_MSG(key_handle, "Line:" TOSTRING(__LINE__));
+        SIZED_BUFFER id = {TEST_ID_1, TEST_ID_1_SIZE};
+        SIZED_BUFFER iv = {TEST_IV, TEST_IV_SIZE};
+        size_t plaintext_size = (3 * TEST_STREAM_CHUNK_SIZE) + 5;
+        unsigned char *plaintext = test_helper_create_data(plaintext_size);
+        unsigned char *ciphertext, *modified, *decrypted;
+        size_t ciphertext_size, decrypted_size;
+        unsigned char *record_0, *record_1;
+        int status = test_helper_run_stream(key_handle, true, &id, &iv, plaintext, plaintext_size,
+                                            plaintext_size, &ciphertext, &ciphertext_size);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        modified = (unsigned char*)malloc(ciphertext_size);
+        ASSERT_IS_NOT_NULL_WITH_MSG(modified, "Line:" TOSTRING(__LINE__));
+        record_0 = modified + TEST_STREAM_HEADER_SIZE;
+        record_1 = record_0 + TEST_STREAM_RECORD_SIZE;
+
+        // act, assert (flipped bit in the data of the second record)
+        memcpy(modified, ciphertext, ciphertext_size);
+        record_1[TEST_TAG_SIZE + 100] ^= 1;
+        status = test_helper_run_stream(key_handle, false, &id, &iv, modified, ciphertext_size,
+                                        1000, &decrypted, &decrypted_size);
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+
+        // act, assert (flipped bit in the header)
+        memcpy(modified, ciphertext, ciphertext_size);
+        modified[TEST_STREAM_HEADER_SIZE - 1] ^= 1;
+        status = test_helper_run_stream(key_handle, false, &id, &iv, modified, ciphertext_size,
+                                        1000, &decrypted, &decrypted_size);
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+
+        // act, assert (reordered records)
+        memcpy(modified, ciphertext, ciphertext_size);
+        memcpy(record_0, ciphertext + TEST_STREAM_HEADER_SIZE + TEST_STREAM_RECORD_SIZE, TEST_STREAM_RECORD_SIZE);
+        memcpy(record_1, ciphertext + TEST_STREAM_HEADER_SIZE, TEST_STREAM_RECORD_SIZE);
+        status = test_helper_run_stream(key_handle, false, &id, &iv, modified, ciphertext_size,
+                                        1000, &decrypted, &decrypted_size);
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+
+        // act, assert (dropped record)
+        memcpy(modified, ciphertext, ciphertext_size);
+        memmove(record_1, record_1 + TEST_STREAM_RECORD_SIZE,
+                ciphertext_size - (size_t)(record_1 + TEST_STREAM_RECORD_SIZE - modified));
+        status = test_helper_run_stream(key_handle, false, &id, &iv, modified, ciphertext_size - TEST_STREAM_RECORD_SIZE,
+                                        1000, &decrypted, &decrypted_size);
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+
+        // act, assert (cut short at a record boundary, in a record and in the header)
+        memcpy(modified, ciphertext, ciphertext_size);
+        status = test_helper_run_stream(key_handle, false, &id, &iv, modified,
+                                        TEST_STREAM_HEADER_SIZE + (3 * TEST_STREAM_RECORD_SIZE),
+                                        1000, &decrypted, &decrypted_size);
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        status = test_helper_run_stream(key_handle, false, &id, &iv, modified, ciphertext_size - 1,
+                                        1000, &decrypted, &decrypted_size);
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        status = test_helper_run_stream(key_handle, false, &id, &iv, modified, TEST_STREAM_HEADER_SIZE - 1,
+                                        1000, &decrypted, &decrypted_size);
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+
+        // act, assert (the unmodified ciphertext still decrypts)
+        status = test_helper_run_stream(key_handle, false, &id, &iv, ciphertext, ciphertext_size,
+                                        1000, &decrypted, &decrypted_size);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        ASSERT_ARE_EQUAL_WITH_MSG(size_t, plaintext_size, decrypted_size, "Line:" TOSTRING(__LINE__));
+        status = memcmp(plaintext, decrypted, plaintext_size);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+
+        // cleanup
+        free(decrypted);
+        free(modified);
+        free(ciphertext);
+        free(plaintext);
+        key_destroy(key_handle);
+    }
+
+    TEST_FUNCTION(test_stream_output_buffer_too_small_fails_without_consuming_input)
+    {
+        // arrange
+        KEY_HANDLE key_handle = create_encryption_key(TEST_KEY, TEST_KEY_SIZE);
+        ASSERT_IS_NOT_NULL_WITH_MSG(key_handle, "Line:" TOSTRING(__LINE__));
+        SIZED_BUFFER id = {TEST_ID_1, TEST_ID_1_SIZE};
+        SIZED_BUFFER iv = {TEST_IV, TEST_IV_SIZE};
+        size_t plaintext_size = TEST_STREAM_CHUNK_SIZE + 1;
+        unsigned char *plaintext = test_helper_create_data(plaintext_size);
+        unsigned char *ciphertext = (unsigned char*)malloc(test_helper_stream_ciphertext_size(plaintext_size));
+        ASSERT_IS_NOT_NULL_WITH_MSG(ciphertext, "Line:" TOSTRING(__LINE__));
+        SIZED_BUFFER ciphertext_buffer = {ciphertext, 0};
+        SIZED_BUFFER plaintext_result = {NULL, 0};
+        KEY_STREAM_HANDLE stream = NULL;
+        size_t output_size;
+        int status = key_encrypt_init(key_handle, &id, &iv, &stream);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+
+        // act, assert
+        output_size = TEST_STREAM_HEADER_SIZE;
+        status = key_stream_update(key_handle, stream, plaintext, plaintext_size, ciphertext, &output_size);
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        ASSERT_ARE_EQUAL_WITH_MSG(size_t, TEST_STREAM_HEADER_SIZE + TEST_STREAM_RECORD_SIZE, output_size, "Line:" TOSTRING(__LINE__));
+        status = key_stream_update(key_handle, stream, plaintext, plaintext_size, ciphertext, &output_size);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        ciphertext_buffer.size = output_size;
+
+        output_size = TEST_TAG_SIZE;
+        status = key_stream_final(key_handle, stream, ciphertext + ciphertext_buffer.size, &output_size);
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        ASSERT_ARE_EQUAL_WITH_MSG(size_t, TEST_TAG_SIZE + 1, output_size, "Line:" TOSTRING(__LINE__));
+        status = key_stream_final(key_handle, stream, ciphertext + ciphertext_buffer.size, &output_size);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        ciphertext_buffer.size += output_size;
+
+        // a finished stream takes no more input
+        output_size = 0;
+        status = key_stream_final(key_handle, stream, NULL, &output_size);
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+
+        status = key_decrypt(key_handle, &id, &ciphertext_buffer, &iv, &plaintext_result);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        ASSERT_ARE_EQUAL_WITH_MSG(size_t, plaintext_size, plaintext_result.size, "Line:" TOSTRING(__LINE__));
+        status = memcmp(plaintext, plaintext_result.buffer, plaintext_size);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+
+        // cleanup
+        key_stream_destroy(key_handle, stream);
+        free(plaintext_result.buffer);
+        free(ciphertext);
+        free(plaintext);
+        key_destroy(key_handle);
+    }
+
+    TEST_FUNCTION(test_stream_dec_invalid_chunk_size_fails)
+    {
+        // arrange
+        KEY_HANDLE key_handle = create_encryption_key(TEST_KEY, TEST_KEY_SIZE);
+        ASSERT_IS_NOT_NULL_WITH_MSG(key_handle, "Line:" TOSTRING(__LINE__));
+        SIZED_BUFFER id = {TEST_ID_1, TEST_ID_1_SIZE};
+        SIZED_BUFFER iv = {TEST_IV, TEST_IV_SIZE};
+        // declares chunks of 256MB which would have to be buffered
+        unsigned char ciphertext[TEST_STREAM_HEADER_SIZE + TEST_TAG_SIZE] = { TEST_STREAM_VERSION, 0x10, 0, 0, 0 };
+        SIZED_BUFFER ciphertext_buffer = {ciphertext, sizeof(ciphertext)};
+        SIZED_BUFFER plaintext_result = {NULL, 0};
+        KEY_STREAM_HANDLE stream = NULL;
+        size_t output_size = 0;
+        int status = key_decrypt_init(key_handle, &id, &iv, &stream);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+
+        // act, assert
+        status = key_stream_update(key_handle, stream, ciphertext, sizeof(ciphertext), NULL, &output_size);
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        status = key_stream_final(key_handle, stream, NULL, &output_size);
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        status = key_decrypt(key_handle, &id, &ciphertext_buffer, &iv, &plaintext_result);
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        ASSERT_IS_NULL_WITH_MSG(plaintext_result.buffer, "Line:" TOSTRING(__LINE__));
+
+        // cleanup
+        key_stream_destroy(key_handle, stream);
+        key_destroy(key_handle);
+    }
+
     TEST_FUNCTION(test_generate_encryption_key_success)
     {
         // arrange
@@ -2,6 +2,7 @@
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
 #include <limits.h>
+#include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stddef.h>
@@ -115,6 +116,9 @@ static unsigned char TEST_IV[] = "IV";
 static size_t TEST_IV_SIZE = sizeof(TEST_IV);
 static const EVP_CIPHER* TEST_EVP_CIPHER = (EVP_CIPHER*)(0x2000);
 
+#define TEST_STREAM_CHUNK_SIZE (64 * 1024)
+#define TEST_STREAM_IV_SUFFIX_SIZE 9
+
 //#############################################################################
 // Mocked functions test hooks
 //#############################################################################
@@ -243,7 +247,19 @@ int test_hook_EVP_DecryptFinal_ex
 //#############################################################################
 // Test helpers
 //#############################################################################
-static uint64_t test_stack_helper_encrypt(void)
+static uint64_t test_stack_helper_create_cipher_ctx(uint64_t failed_function_bitmask, size_t *i)
+{
+    STRICT_EXPECTED_CALL(EVP_CIPHER_CTX_new());
+    failed_function_bitmask |= ((uint64_t)1 << (*i)++);
+    STRICT_EXPECTED_CALL(EVP_aes_256_gcm());
+    (*i)++;
+    STRICT_EXPECTED_CALL(EVP_EncryptInit_ex(TEST_EVP_CIPHER_CTX, TEST_EVP_CIPHER, NULL, IGNORED_PTR_ARG, NULL));
+    failed_function_bitmask |= ((uint64_t)1 << (*i)++);
+
+    return failed_function_bitmask;
+}
+
+static uint64_t test_stack_helper_encrypt(bool cipher_ctx_cached)
 {
     uint64_t failed_function_bitmask = 0;
     size_t i = 0;
@@ -252,15 +268,13 @@ static uint64_t test_stack_helper_encrypt(void)
 	i++;
     STRICT_EXPECTED_CALL(gballoc_malloc(TEST_CIPHERTEXT_SIZE));
     failed_function_bitmask |= ((uint64_t)1 << i++);
-    STRICT_EXPECTED_CALL(EVP_CIPHER_CTX_new());
-    i++;
-    STRICT_EXPECTED_CALL(EVP_aes_256_gcm());
-    i++;
-    STRICT_EXPECTED_CALL(EVP_EncryptInit_ex(TEST_EVP_CIPHER_CTX, TEST_EVP_CIPHER, NULL, NULL, NULL));
-    failed_function_bitmask |= ((uint64_t)1 << i++);
+    if (!cipher_ctx_cached)
+    {
+        failed_function_bitmask = test_stack_helper_create_cipher_ctx(failed_function_bitmask, &i);
+    }
     STRICT_EXPECTED_CALL(EVP_CIPHER_CTX_ctrl(TEST_EVP_CIPHER_CTX, EVP_CTRL_GCM_SET_IVLEN, (int)TEST_IV_SIZE, NULL));
     failed_function_bitmask |= ((uint64_t)1 << i++);
-    STRICT_EXPECTED_CALL(EVP_EncryptInit_ex(TEST_EVP_CIPHER_CTX, NULL, NULL, IGNORED_PTR_ARG, TEST_IV));
+    STRICT_EXPECTED_CALL(EVP_EncryptInit_ex(TEST_EVP_CIPHER_CTX, NULL, NULL, NULL, TEST_IV));
     failed_function_bitmask |= ((uint64_t)1 << i++);
     STRICT_EXPECTED_CALL(EVP_EncryptUpdate(TEST_EVP_CIPHER_CTX, NULL, IGNORED_PTR_ARG, TEST_IDENTITY, (int)TEST_IDENTITY_SIZE));
     failed_function_bitmask |= ((uint64_t)1 << i++);
@@ -270,12 +284,11 @@ static uint64_t test_stack_helper_encrypt(void)
     failed_function_bitmask |= ((uint64_t)1 << i++);
     STRICT_EXPECTED_CALL(EVP_CIPHER_CTX_ctrl(TEST_EVP_CIPHER_CTX, EVP_CTRL_GCM_GET_TAG, TEST_TAG_SIZE, IGNORED_PTR_ARG));
     failed_function_bitmask |= ((uint64_t)1 << i++);
-    STRICT_EXPECTED_CALL(EVP_CIPHER_CTX_free(TEST_EVP_CIPHER_CTX));
 
     return failed_function_bitmask;
 }
 
-static uint64_t test_stack_helper_decrypt(void)
+static uint64_t test_stack_helper_decrypt(bool cipher_ctx_cached)
 {
     uint64_t failed_function_bitmask = 0;
     size_t i = 0;
@@ -284,15 +297,13 @@ static uint64_t test_stack_helper_decrypt(void)
 	i++;
     STRICT_EXPECTED_CALL(gballoc_malloc(TEST_CIPHERTEXT_SIZE));
     failed_function_bitmask |= ((uint64_t)1 << i++);
-    STRICT_EXPECTED_CALL(EVP_CIPHER_CTX_new());
-    i++;
-    STRICT_EXPECTED_CALL(EVP_aes_256_gcm());
-    i++;
-    STRICT_EXPECTED_CALL(EVP_DecryptInit_ex(TEST_EVP_CIPHER_CTX, TEST_EVP_CIPHER, NULL, NULL, NULL));
-    failed_function_bitmask |= ((uint64_t)1 << i++);
+    if (!cipher_ctx_cached)
+    {
+        failed_function_bitmask = test_stack_helper_create_cipher_ctx(failed_function_bitmask, &i);
+    }
     STRICT_EXPECTED_CALL(EVP_CIPHER_CTX_ctrl(TEST_EVP_CIPHER_CTX, EVP_CTRL_GCM_SET_IVLEN, (int)TEST_IV_SIZE, NULL));
     failed_function_bitmask |= ((uint64_t)1 << i++);
-    STRICT_EXPECTED_CALL(EVP_DecryptInit_ex(TEST_EVP_CIPHER_CTX, NULL, NULL, IGNORED_PTR_ARG, TEST_IV));
+    STRICT_EXPECTED_CALL(EVP_DecryptInit_ex(TEST_EVP_CIPHER_CTX, NULL, NULL, NULL, TEST_IV));
     failed_function_bitmask |= ((uint64_t)1 << i++);
     STRICT_EXPECTED_CALL(EVP_DecryptUpdate(TEST_EVP_CIPHER_CTX, NULL, IGNORED_PTR_ARG, TEST_IDENTITY, (int)TEST_IDENTITY_SIZE));
     failed_function_bitmask |= ((uint64_t)1 << i++);
@@ -302,7 +313,28 @@ static uint64_t test_stack_helper_decrypt(void)
     failed_function_bitmask |= ((uint64_t)1 << i++);
     STRICT_EXPECTED_CALL(EVP_DecryptFinal_ex(TEST_EVP_CIPHER_CTX, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     failed_function_bitmask |= ((uint64_t)1 << i++);
-    STRICT_EXPECTED_CALL(EVP_CIPHER_CTX_free(TEST_EVP_CIPHER_CTX));
+
+    return failed_function_bitmask;
+}
+
+static uint64_t test_stack_helper_stream_init(bool is_encrypt)
+{
+    uint64_t failed_function_bitmask = 0;
+    size_t i = 0;
+
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    failed_function_bitmask |= ((uint64_t)1 << i++);
+    STRICT_EXPECTED_CALL(gballoc_malloc(TEST_IDENTITY_SIZE));
+    failed_function_bitmask |= ((uint64_t)1 << i++);
+    STRICT_EXPECTED_CALL(gballoc_malloc(TEST_IV_SIZE + TEST_STREAM_IV_SUFFIX_SIZE));
+    failed_function_bitmask |= ((uint64_t)1 << i++);
+    if (is_encrypt)
+    {
+        STRICT_EXPECTED_CALL(gballoc_malloc(TEST_STREAM_CHUNK_SIZE));
+        failed_function_bitmask |= ((uint64_t)1 << i++);
+    }
+    EXPECTED_CALL(initialize_openssl());
+    i++;
 
     return failed_function_bitmask;
 }
@@ -592,6 +624,37 @@ BEGIN_TEST_SUITE(edge_openssl_encryption_unittests)
         // cleanup
     }
 
+    /**
+     * Test function for API
+     *   key_destroy
+    */
+    TEST_FUNCTION(key_destroy_frees_cipher_ctx_success)
+    {
+        // arrange
+        KEY_HANDLE key_handle = create_encryption_key(TEST_KEY, ENCRYPTION_KEY_SIZE);
+        ASSERT_IS_NOT_NULL_WITH_MSG(key_handle, "Line:" TOSTRING(__LINE__));
+        SIZED_BUFFER id = {TEST_IDENTITY, TEST_IDENTITY_SIZE};
+        SIZED_BUFFER pt = {TEST_PLAINTEXT, TEST_PLAINTEXT_SIZE};
+        SIZED_BUFFER iv = {TEST_IV, TEST_IV_SIZE};
+        SIZED_BUFFER ct = {NULL, 0};
+        int status = key_encrypt(key_handle, &id, &pt, &iv, &ct);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(EVP_CIPHER_CTX_free(TEST_EVP_CIPHER_CTX));
+        EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(gballoc_free(key_handle));
+
+        // act
+        key_destroy(key_handle);
+
+        // assert
+        ASSERT_ARE_EQUAL_WITH_MSG(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls(), "Line:" TOSTRING(__LINE__));
+
+        // cleanup
+        free(ct.buffer);
+    }
+
     /**
      * Test function for API
      *   key_encrypt
@@ -697,7 +760,41 @@ BEGIN_TEST_SUITE(edge_openssl_encryption_unittests)
         int status;
         umock_c_reset_all_calls();
 
-        (void)test_stack_helper_encrypt();
+        (void)test_stack_helper_encrypt(false);
+
+        // act
+        status = key_encrypt(key_handle, &id, &pt, &iv, &ct);
+
+        // assert
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        ASSERT_ARE_EQUAL_WITH_MSG(size_t, TEST_CIPHERTEXT_HEADER_SIZE+TEST_PLAINTEXT_SIZE, ct.size, "Line:" TOSTRING(__LINE__));
+        ASSERT_IS_NOT_NULL_WITH_MSG(ct.buffer, "Line:" TOSTRING(__LINE__));
+        ASSERT_ARE_EQUAL_WITH_MSG(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls(), "Line:" TOSTRING(__LINE__));
+
+        // cleanup
+        free(ct.buffer);
+        key_destroy(key_handle);
+    }
+
+    /**
+     * Test function for API
+     *   key_encrypt
+    */
+    TEST_FUNCTION(key_encrypt_reuses_cipher_ctx_success)
+    {
+        // arrange
+        KEY_HANDLE key_handle = create_encryption_key(TEST_KEY, ENCRYPTION_KEY_SIZE);
+        ASSERT_IS_NOT_NULL_WITH_MSG(key_handle, "Line:" TOSTRING(__LINE__));
+        SIZED_BUFFER id = {TEST_IDENTITY, TEST_IDENTITY_SIZE};
+        SIZED_BUFFER pt = {TEST_PLAINTEXT, TEST_PLAINTEXT_SIZE};
+        SIZED_BUFFER iv = {TEST_IV, TEST_IV_SIZE};
+        SIZED_BUFFER ct = {NULL, 0};
+        int status = key_encrypt(key_handle, &id, &pt, &iv, &ct);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        free(ct.buffer);
+        umock_c_reset_all_calls();
+
+        (void)test_stack_helper_encrypt(true);
 
         // act
         status = key_encrypt(key_handle, &id, &pt, &iv, &ct);
@@ -713,6 +810,49 @@ BEGIN_TEST_SUITE(edge_openssl_encryption_unittests)
         key_destroy(key_handle);
     }
 
+    /**
+     * Test function for API
+     *   key_encrypt
+    */
+    TEST_FUNCTION(key_encrypt_failure_frees_cipher_ctx)
+    {
+        // arrange
+        KEY_HANDLE key_handle = create_encryption_key(TEST_KEY, ENCRYPTION_KEY_SIZE);
+        ASSERT_IS_NOT_NULL_WITH_MSG(key_handle, "Line:" TOSTRING(__LINE__));
+        SIZED_BUFFER id = {TEST_IDENTITY, TEST_IDENTITY_SIZE};
+        SIZED_BUFFER pt = {TEST_PLAINTEXT, TEST_PLAINTEXT_SIZE};
+        SIZED_BUFFER iv = {TEST_IV, TEST_IV_SIZE};
+        SIZED_BUFFER ct = {NULL, 0};
+        int status = key_encrypt(key_handle, &id, &pt, &iv, &ct);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        free(ct.buffer);
+        umock_c_reset_all_calls();
+
+        EXPECTED_CALL(initialize_openssl());
+        STRICT_EXPECTED_CALL(gballoc_malloc(TEST_CIPHERTEXT_SIZE));
+        STRICT_EXPECTED_CALL(EVP_CIPHER_CTX_ctrl(TEST_EVP_CIPHER_CTX, EVP_CTRL_GCM_SET_IVLEN, (int)TEST_IV_SIZE, NULL));
+        STRICT_EXPECTED_CALL(EVP_EncryptInit_ex(TEST_EVP_CIPHER_CTX, NULL, NULL, NULL, TEST_IV));
+        STRICT_EXPECTED_CALL(EVP_EncryptUpdate(TEST_EVP_CIPHER_CTX, NULL, IGNORED_PTR_ARG, TEST_IDENTITY, (int)TEST_IDENTITY_SIZE))
+            .SetReturn(0);
+        STRICT_EXPECTED_CALL(EVP_CIPHER_CTX_free(TEST_EVP_CIPHER_CTX));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+        (void)test_stack_helper_encrypt(false);
+
+        // act
+        status = key_encrypt(key_handle, &id, &pt, &iv, &ct);
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        status = key_encrypt(key_handle, &id, &pt, &iv, &ct);
+
+        // assert
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        ASSERT_IS_NOT_NULL_WITH_MSG(ct.buffer, "Line:" TOSTRING(__LINE__));
+        ASSERT_ARE_EQUAL_WITH_MSG(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls(), "Line:" TOSTRING(__LINE__));
+
+        // cleanup
+        free(ct.buffer);
+        key_destroy(key_handle);
+    }
+
     /**
      * Test function for API
      *   key_encrypt
@@ -730,7 +870,7 @@ BEGIN_TEST_SUITE(edge_openssl_encryption_unittests)
         SIZED_BUFFER ct = {NULL, 0};
         umock_c_reset_all_calls();
 
-        uint64_t failed_function_bitmask = test_stack_helper_encrypt();
+        uint64_t failed_function_bitmask = test_stack_helper_encrypt(false);
         umock_c_negative_tests_snapshot();
 
         for (size_t i = 0; i < umock_c_negative_tests_call_count(); i++)
@@ -888,7 +1028,41 @@ BEGIN_TEST_SUITE(edge_openssl_encryption_unittests)
         int status;
         umock_c_reset_all_calls();
 
-        (void)test_stack_helper_decrypt();
+        (void)test_stack_helper_decrypt(false);
+
+        // act
+        status = key_decrypt(key_handle, &id, &ct, &iv, &pt);
+
+        // assert
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        ASSERT_ARE_EQUAL_WITH_MSG(size_t, TEST_CIPHERTEXT_SIZE-TEST_CIPHERTEXT_HEADER_SIZE, pt.size, "Line:" TOSTRING(__LINE__));
+        ASSERT_IS_NOT_NULL_WITH_MSG(pt.buffer, "Line:" TOSTRING(__LINE__));
+        ASSERT_ARE_EQUAL_WITH_MSG(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls(), "Line:" TOSTRING(__LINE__));
+
+        // cleanup
+        free(pt.buffer);
+        key_destroy(key_handle);
+    }
+
+    /**
+     * Test function for API
+     *   key_decrypt
+    */
+    TEST_FUNCTION(key_decrypt_reuses_cipher_ctx_success)
+    {
+        // arrange
+        KEY_HANDLE key_handle = create_encryption_key(TEST_KEY, ENCRYPTION_KEY_SIZE);
+        ASSERT_IS_NOT_NULL_WITH_MSG(key_handle, "Line:" TOSTRING(__LINE__));
+        SIZED_BUFFER id = {TEST_IDENTITY, TEST_IDENTITY_SIZE};
+        SIZED_BUFFER ct = {TEST_CIPHERTEXT, TEST_CIPHERTEXT_SIZE};
+        SIZED_BUFFER iv = {TEST_IV, TEST_IV_SIZE};
+        SIZED_BUFFER pt = {NULL, 0};
+        int status = key_decrypt(key_handle, &id, &ct, &iv, &pt);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        free(pt.buffer);
+        umock_c_reset_all_calls();
+
+        (void)test_stack_helper_decrypt(true);
 
         // act
         status = key_decrypt(key_handle, &id, &ct, &iv, &pt);
@@ -921,7 +1095,7 @@ BEGIN_TEST_SUITE(edge_openssl_encryption_unittests)
         SIZED_BUFFER pt = {NULL, 0};
         umock_c_reset_all_calls();
 
-        uint64_t failed_function_bitmask = test_stack_helper_decrypt();
+        uint64_t failed_function_bitmask = test_stack_helper_decrypt(false);
         umock_c_negative_tests_snapshot();
 
         for (size_t i = 0; i < umock_c_negative_tests_call_count(); i++)
@@ -945,6 +1119,189 @@ BEGIN_TEST_SUITE(edge_openssl_encryption_unittests)
         umock_c_negative_tests_deinit();
     }
 
+    /**
+     * Test function for API
+     *   key_encrypt_init
+     *   key_decrypt_init
+    */
+    TEST_FUNCTION(key_stream_init_invalid_params)
+    {
+        // arrange
+        KEY_HANDLE key_handle = create_encryption_key(TEST_KEY, ENCRYPTION_KEY_SIZE);
+        ASSERT_IS_NOT_NULL_WITH_MSG(key_handle, "Line:" TOSTRING(__LINE__));
+        SIZED_BUFFER id = {TEST_IDENTITY, TEST_IDENTITY_SIZE};
+        SIZED_BUFFER iv = {TEST_IV, TEST_IV_SIZE};
+        SIZED_BUFFER empty = {NULL, 0};
+        SIZED_BUFFER invalid_size = {TEST_IV, 0};
+        KEY_STREAM_HANDLE stream;
+        int status;
+        umock_c_reset_all_calls();
+
+        // act, assert
+        stream = (KEY_STREAM_HANDLE)0x1000;
+        status = key_encrypt_init(key_handle, NULL, &iv, &stream);
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        ASSERT_IS_NULL_WITH_MSG(stream, "Line:" TOSTRING(__LINE__));
+
+        stream = (KEY_STREAM_HANDLE)0x1000;
+        status = key_encrypt_init(key_handle, &empty, &iv, &stream);
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        ASSERT_IS_NULL_WITH_MSG(stream, "Line:" TOSTRING(__LINE__));
+
+        stream = (KEY_STREAM_HANDLE)0x1000;
+        status = key_decrypt_init(key_handle, &id, NULL, &stream);
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        ASSERT_IS_NULL_WITH_MSG(stream, "Line:" TOSTRING(__LINE__));
+
+        stream = (KEY_STREAM_HANDLE)0x1000;
+        status = key_decrypt_init(key_handle, &id, &invalid_size, &stream);
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        ASSERT_IS_NULL_WITH_MSG(stream, "Line:" TOSTRING(__LINE__));
+
+        status = key_encrypt_init(key_handle, &id, &iv, NULL);
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        ASSERT_ARE_EQUAL_WITH_MSG(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls(), "Line:" TOSTRING(__LINE__));
+
+        // cleanup
+        key_destroy(key_handle);
+    }
+
+    /**
+     * Test function for API
+     *   key_encrypt_init
+     *   key_stream_destroy
+    */
+    TEST_FUNCTION(key_encrypt_init_success)
+    {
+        // arrange
+        KEY_HANDLE key_handle = create_encryption_key(TEST_KEY, ENCRYPTION_KEY_SIZE);
+        ASSERT_IS_NOT_NULL_WITH_MSG(key_handle, "Line:" TOSTRING(__LINE__));
+        SIZED_BUFFER id = {TEST_IDENTITY, TEST_IDENTITY_SIZE};
+        SIZED_BUFFER iv = {TEST_IV, TEST_IV_SIZE};
+        KEY_STREAM_HANDLE stream = NULL;
+        int status;
+        umock_c_reset_all_calls();
+
+        (void)test_stack_helper_stream_init(true);
+
+        // act
+        status = key_encrypt_init(key_handle, &id, &iv, &stream);
+
+        // assert
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        ASSERT_IS_NOT_NULL_WITH_MSG(stream, "Line:" TOSTRING(__LINE__));
+        ASSERT_ARE_EQUAL_WITH_MSG(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls(), "Line:" TOSTRING(__LINE__));
+
+        // act, assert (destroy)
+        umock_c_reset_all_calls();
+        EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+        EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+        EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(gballoc_free(stream));
+        key_stream_destroy(key_handle, stream);
+        ASSERT_ARE_EQUAL_WITH_MSG(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls(), "Line:" TOSTRING(__LINE__));
+
+        // cleanup
+        key_destroy(key_handle);
+    }
+
+    /**
+     * Test function for API
+     *   key_encrypt_init
+     *   key_decrypt_init
+    */
+    TEST_FUNCTION(key_stream_init_negative)
+    {
+        //arrange
+        int test_result = umock_c_negative_tests_init();
+        ASSERT_ARE_EQUAL(int, 0, test_result);
+        KEY_HANDLE key_handle = create_encryption_key(TEST_KEY, ENCRYPTION_KEY_SIZE);
+        ASSERT_IS_NOT_NULL_WITH_MSG(key_handle, "Line:" TOSTRING(__LINE__));
+        SIZED_BUFFER id = {TEST_IDENTITY, TEST_IDENTITY_SIZE};
+        SIZED_BUFFER iv = {TEST_IV, TEST_IV_SIZE};
+        umock_c_reset_all_calls();
+
+        uint64_t failed_function_bitmask = test_stack_helper_stream_init(true);
+        umock_c_negative_tests_snapshot();
+
+        for (size_t i = 0; i < umock_c_negative_tests_call_count(); i++)
+        {
+            umock_c_negative_tests_reset();
+            umock_c_negative_tests_fail_call(i);
+            if (failed_function_bitmask & ((uint64_t)1 << i))
+            {
+                KEY_STREAM_HANDLE stream = (KEY_STREAM_HANDLE)0x1000;
+
+                // act
+                int status = key_encrypt_init(key_handle, &id, &iv, &stream);
+
+                // assert
+                ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+                ASSERT_IS_NULL_WITH_MSG(stream, "Line:" TOSTRING(__LINE__));
+            }
+        }
+
+        //cleanup
+        key_destroy(key_handle);
+        umock_c_negative_tests_deinit();
+    }
+
+    /**
+     * Test function for API
+     *   key_stream_update
+     *   key_stream_final
+    */
+    TEST_FUNCTION(key_stream_update_final_invalid_params)
+    {
+        // arrange
+        KEY_HANDLE key_handle = create_encryption_key(TEST_KEY, ENCRYPTION_KEY_SIZE);
+        ASSERT_IS_NOT_NULL_WITH_MSG(key_handle, "Line:" TOSTRING(__LINE__));
+        KEY_HANDLE other_key_handle = create_encryption_key(TEST_KEY, ENCRYPTION_KEY_SIZE);
+        ASSERT_IS_NOT_NULL_WITH_MSG(other_key_handle, "Line:" TOSTRING(__LINE__));
+        SIZED_BUFFER id = {TEST_IDENTITY, TEST_IDENTITY_SIZE};
+        SIZED_BUFFER iv = {TEST_IV, TEST_IV_SIZE};
+        unsigned char output[TEST_CIPHERTEXT_SIZE];
+        size_t output_size;
+        KEY_STREAM_HANDLE stream = NULL;
+        int status = key_encrypt_init(key_handle, &id, &iv, &stream);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        umock_c_reset_all_calls();
+
+        // act, assert
+        status = key_stream_update(key_handle, stream, TEST_PLAINTEXT, TEST_PLAINTEXT_SIZE, output, NULL);
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+
+        output_size = sizeof(output);
+        status = key_stream_update(key_handle, NULL, TEST_PLAINTEXT, TEST_PLAINTEXT_SIZE, output, &output_size);
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        ASSERT_ARE_EQUAL_WITH_MSG(size_t, 0, output_size, "Line:" TOSTRING(__LINE__));
+
+        output_size = sizeof(output);
+        status = key_stream_update(key_handle, stream, NULL, TEST_PLAINTEXT_SIZE, output, &output_size);
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        ASSERT_ARE_EQUAL_WITH_MSG(size_t, 0, output_size, "Line:" TOSTRING(__LINE__));
+
+        // a stream only works with the key it was created with
+        output_size = sizeof(output);
+        status = key_stream_update(other_key_handle, stream, TEST_PLAINTEXT, TEST_PLAINTEXT_SIZE, output, &output_size);
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        ASSERT_ARE_EQUAL_WITH_MSG(size_t, 0, output_size, "Line:" TOSTRING(__LINE__));
+
+        status = key_stream_final(key_handle, stream, output, NULL);
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+
+        output_size = sizeof(output);
+        status = key_stream_final(other_key_handle, stream, output, &output_size);
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        ASSERT_ARE_EQUAL_WITH_MSG(size_t, 0, output_size, "Line:" TOSTRING(__LINE__));
+        ASSERT_ARE_EQUAL_WITH_MSG(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls(), "Line:" TOSTRING(__LINE__));
+
+        // cleanup
+        key_stream_destroy(key_handle, stream);
+        key_destroy(other_key_handle);
+        key_destroy(key_handle);
+    }
+
     /**
      * Test function for API
      *   key_sign
@@ -7,6 +7,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/crt_abstractions.h"
@@ -69,6 +70,9 @@ static TEST_MUTEX_HANDLE g_dllByDll;
 
 #define TEST_CHAIN_FILE_PATH        "chain_file.pem"
 
+#define TEST_KEY_POOL_SIZE          2
+#define TEST_KEY_POOL_ITERATIONS    8
+
 //#############################################################################
 // Test helpers
 //#############################################################################
@@ -465,6 +469,350 @@ BEGIN_TEST_SUITE(edge_openssl_int_tests)
         // cleanup
     }
 
+    TEST_FUNCTION(test_certificate_verification_id)
+    {
+        // arrange
+        PKI_KEY_PROPS key_props = { HSM_PKI_KEY_RSA, NULL };
+        unsigned char id_1[CERT_VERIFICATION_ID_SIZE], id_2[CERT_VERIFICATION_ID_SIZE];
+        int64_t not_after_1 = 0, not_after_2 = 0;
+        int64_t now = (int64_t)time(NULL);
+        CERT_PROPS_HANDLE ca_root_handle = test_helper_create_certificate_props(TEST_CA_CN_1,
+                                                                               TEST_CA_ALIAS_1,
+                                                                               TEST_CA_ALIAS_1,
+                                                                               CERTIFICATE_TYPE_CA,
+                                                                               TEST_VALIDITY);
+        CERT_PROPS_HANDLE int_ca_root_handle = test_helper_create_certificate_props(TEST_CA_CN_2,
+                                                                                   TEST_CA_ALIAS_2,
+                                                                                   TEST_CA_ALIAS_1,
+                                                                                   CERTIFICATE_TYPE_CA,
+                                                                                   TEST_VALIDITY);
+        test_helper_generate_self_signed(ca_root_handle,
+                                         TEST_SERIAL_NUM + 1,
+                                         2,
+                                         TEST_CA_PK_RSA_FILE_1,
+                                         TEST_CA_CERT_RSA_FILE_1,
+                                         &key_props);
+        test_helper_generate_pki_certificate(int_ca_root_handle,
+                                             TEST_SERIAL_NUM + 2,
+                                             1,
+                                             TEST_CA_PK_RSA_FILE_2,
+                                             TEST_CA_CERT_RSA_FILE_2,
+                                             TEST_CA_PK_RSA_FILE_1,
+                                             TEST_CA_CERT_RSA_FILE_1);
+
+        // act, assert
+        int status = get_certificate_verification_id(TEST_CA_CERT_RSA_FILE_2, TEST_CA_CERT_RSA_FILE_1, id_1, sizeof(id_1), &not_after_1);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        ASSERT_IS_TRUE_WITH_MSG(not_after_1 > now, "Line:" TOSTRING(__LINE__));
+        ASSERT_IS_TRUE_WITH_MSG(not_after_1 <= (int64_t)time(NULL) + TEST_VALIDITY, "Line:" TOSTRING(__LINE__));
+
+        status = get_certificate_verification_id(TEST_CA_CERT_RSA_FILE_2, TEST_CA_CERT_RSA_FILE_1, id_2, sizeof(id_2), &not_after_2);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, memcmp(id_1, id_2, sizeof(id_1)), "Line:" TOSTRING(__LINE__));
+
+        status = get_certificate_verification_id(TEST_CA_CERT_RSA_FILE_2, TEST_CA_CERT_RSA_FILE_2, id_2, sizeof(id_2), &not_after_2);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, memcmp(id_1, id_2, sizeof(id_1)), "Line:" TOSTRING(__LINE__));
+
+        status = get_certificate_verification_id(TEST_CA_CERT_RSA_FILE_2, TEST_CA_CERT_RSA_FILE_1, id_2, sizeof(id_2) - 1, &not_after_2);
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+
+        // re-issuing the certificate changes the id
+        test_helper_generate_pki_certificate(int_ca_root_handle,
+                                             TEST_SERIAL_NUM + 3,
+                                             1,
+                                             TEST_CA_PK_RSA_FILE_2,
+                                             TEST_CA_CERT_RSA_FILE_2,
+                                             TEST_CA_PK_RSA_FILE_1,
+                                             TEST_CA_CERT_RSA_FILE_1);
+        status = get_certificate_verification_id(TEST_CA_CERT_RSA_FILE_2, TEST_CA_CERT_RSA_FILE_1, id_2, sizeof(id_2), &not_after_2);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, memcmp(id_1, id_2, sizeof(id_1)), "Line:" TOSTRING(__LINE__));
+
+        // cleanup
+        delete_file(TEST_CA_PK_RSA_FILE_2);
+        delete_file(TEST_CA_CERT_RSA_FILE_2);
+        delete_file(TEST_CA_PK_RSA_FILE_1);
+        delete_file(TEST_CA_CERT_RSA_FILE_1);
+        cert_properties_destroy(int_ca_root_handle);
+        cert_properties_destroy(ca_root_handle);
+    }
+
+    TEST_FUNCTION(test_check_certificate_key)
+    {
+        // arrange
+        PKI_KEY_PROPS key_props = { HSM_PKI_KEY_RSA, NULL };
+        bool key_matches = false;
+        CERT_PROPS_HANDLE ca_root_handle = test_helper_create_certificate_props(TEST_CA_CN_1,
+                                                                               TEST_CA_ALIAS_1,
+                                                                               TEST_CA_ALIAS_1,
+                                                                               CERTIFICATE_TYPE_CA,
+                                                                               TEST_VALIDITY);
+        CERT_PROPS_HANDLE int_ca_root_handle = test_helper_create_certificate_props(TEST_CA_CN_2,
+                                                                                   TEST_CA_ALIAS_2,
+                                                                                   TEST_CA_ALIAS_1,
+                                                                                   CERTIFICATE_TYPE_CA,
+                                                                                   TEST_VALIDITY);
+        test_helper_generate_self_signed(ca_root_handle,
+                                         TEST_SERIAL_NUM + 1,
+                                         2,
+                                         TEST_CA_PK_RSA_FILE_1,
+                                         TEST_CA_CERT_RSA_FILE_1,
+                                         &key_props);
+        test_helper_generate_pki_certificate(int_ca_root_handle,
+                                             TEST_SERIAL_NUM + 2,
+                                             1,
+                                             TEST_CA_PK_RSA_FILE_2,
+                                             TEST_CA_CERT_RSA_FILE_2,
+                                             TEST_CA_PK_RSA_FILE_1,
+                                             TEST_CA_CERT_RSA_FILE_1);
+
+        // act, assert
+        int status = check_certificate_key(TEST_CA_CERT_RSA_FILE_2, TEST_CA_PK_RSA_FILE_2, &key_matches);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        ASSERT_IS_TRUE_WITH_MSG(key_matches, "Line:" TOSTRING(__LINE__));
+
+        // the chain of the certificate holds the issuer certificate, which is
+        // not the one checked
+        status = check_certificate_key(TEST_CA_CERT_RSA_FILE_2, TEST_CA_PK_RSA_FILE_1, &key_matches);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        ASSERT_IS_FALSE_WITH_MSG(key_matches, "Line:" TOSTRING(__LINE__));
+
+        status = check_certificate_key(TEST_CA_CERT_RSA_FILE_2, TEST_CA_CERT_RSA_FILE_1, &key_matches);
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+
+        // cleanup
+        delete_file(TEST_CA_PK_RSA_FILE_2);
+        delete_file(TEST_CA_CERT_RSA_FILE_2);
+        delete_file(TEST_CA_PK_RSA_FILE_1);
+        delete_file(TEST_CA_CERT_RSA_FILE_1);
+        cert_properties_destroy(int_ca_root_handle);
+        cert_properties_destroy(ca_root_handle);
+    }
+
+    TEST_FUNCTION(test_key_pool_issues_unique_keys)
+    {
+        // arrange
+        PKI_KEY_PROPS key_props = { HSM_PKI_KEY_EC, "prime256v1" };
+        char *previous_key = NULL;
+        int iteration;
+        CERT_PROPS_HANDLE cert_props_handle = test_helper_create_certificate_props(TEST_SERVER_CN_1,
+                                                                                  TEST_SERVER_ALIAS_1,
+                                                                                  TEST_SERVER_ALIAS_1,
+                                                                                  CERTIFICATE_TYPE_SERVER,
+                                                                                  TEST_VALIDITY);
+        int status = pki_key_pool_init(TEST_KEY_POOL_SIZE);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+
+        // act, assert
+        // keys are taken from the pool once it is refilled, and no key is
+        // ever handed out twice
+        for (iteration = 0; iteration < TEST_KEY_POOL_ITERATIONS; iteration++)
+        {
+            char *key;
+            test_helper_generate_self_signed(cert_props_handle,
+                                             TEST_SERIAL_NUM + iteration,
+                                             0,
+                                             TEST_SERVER_PK_ECC_FILE_1,
+                                             TEST_SERVER_CERT_ECC_FILE_1,
+                                             &key_props);
+            key = read_file_into_cstring(TEST_SERVER_PK_ECC_FILE_1, NULL);
+            ASSERT_IS_NOT_NULL_WITH_MSG(key, "Line:" TOSTRING(__LINE__));
+            if (previous_key != NULL)
+            {
+                ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, strcmp(previous_key, key), "Line:" TOSTRING(__LINE__));
+                free(previous_key);
+            }
+            previous_key = key;
+        }
+
+        // cleanup
+        free(previous_key);
+        pki_key_pool_deinit();
+        delete_file(TEST_SERVER_PK_ECC_FILE_1);
+        delete_file(TEST_SERVER_CERT_ECC_FILE_1);
+        cert_properties_destroy(cert_props_handle);
+    }
+
+    TEST_FUNCTION(test_issuer_handle_issues_multiple_certificates)
+    {
+        // arrange
+        PKI_KEY_PROPS key_props = { HSM_PKI_KEY_EC, "prime256v1" };
+        PKI_ISSUER_HANDLE issuer;
+        bool cert_verified;
+        int status;
+        CERT_PROPS_HANDLE ca_root_handle = test_helper_create_certificate_props(TEST_CA_CN_1,
+                                                                               TEST_CA_ALIAS_1,
+                                                                               TEST_CA_ALIAS_1,
+                                                                               CERTIFICATE_TYPE_CA,
+                                                                               TEST_VALIDITY);
+        CERT_PROPS_HANDLE server_handle = test_helper_create_certificate_props(TEST_SERVER_CN_3,
+                                                                              TEST_SERVER_ALIAS_3,
+                                                                              TEST_CA_ALIAS_1,
+                                                                              CERTIFICATE_TYPE_SERVER,
+                                                                              TEST_VALIDITY);
+        test_helper_generate_self_signed(ca_root_handle,
+                                         TEST_SERIAL_NUM + 1,
+                                         1,
+                                         TEST_CA_PK_RSA_FILE_1,
+                                         TEST_CA_CERT_RSA_FILE_1,
+                                         &key_props);
+        issuer = pki_issuer_create(TEST_CA_PK_RSA_FILE_1, TEST_CA_CERT_RSA_FILE_1);
+        ASSERT_IS_NOT_NULL_WITH_MSG(issuer, "Line:" TOSTRING(__LINE__));
+
+        // act
+        status = generate_pki_cert_and_key_with_issuer(server_handle,
+                                                       TEST_SERIAL_NUM + 2,
+                                                       0,
+                                                       TEST_SERVER_PK_RSA_FILE_3,
+                                                       TEST_SERVER_CERT_RSA_FILE_3,
+                                                       issuer);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        status = generate_pki_cert_and_key_with_issuer(server_handle,
+                                                       TEST_SERIAL_NUM + 3,
+                                                       0,
+                                                       TEST_SERVER_PK_ECC_FILE_1,
+                                                       TEST_SERVER_CERT_ECC_FILE_1,
+                                                       issuer);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+
+        // assert
+        cert_verified = false;
+        status = verify_certificate(TEST_SERVER_CERT_RSA_FILE_3, TEST_SERVER_PK_RSA_FILE_3, TEST_CA_CERT_RSA_FILE_1, &cert_verified);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        ASSERT_IS_TRUE_WITH_MSG(cert_verified, "Line:" TOSTRING(__LINE__));
+        cert_verified = false;
+        status = verify_certificate(TEST_SERVER_CERT_ECC_FILE_1, TEST_SERVER_PK_ECC_FILE_1, TEST_CA_CERT_RSA_FILE_1, &cert_verified);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        ASSERT_IS_TRUE_WITH_MSG(cert_verified, "Line:" TOSTRING(__LINE__));
+
+        // cleanup
+        pki_issuer_destroy(issuer);
+        delete_file(TEST_SERVER_PK_ECC_FILE_1);
+        delete_file(TEST_SERVER_CERT_ECC_FILE_1);
+        delete_file(TEST_SERVER_PK_RSA_FILE_3);
+        delete_file(TEST_SERVER_CERT_RSA_FILE_3);
+        delete_file(TEST_CA_PK_RSA_FILE_1);
+        delete_file(TEST_CA_CERT_RSA_FILE_1);
+        cert_properties_destroy(server_handle);
+        cert_properties_destroy(ca_root_handle);
+    }
+
+    TEST_FUNCTION(test_verifier_verifies_against_loaded_issuer)
+    {
+        // arrange
+        PKI_KEY_PROPS key_props = { HSM_PKI_KEY_EC, "prime256v1" };
+        PKI_VERIFIER_HANDLE verifier;
+        bool cert_verified;
+        int status;
+        CERT_PROPS_HANDLE server_handle = test_helper_create_certificate_props(TEST_SERVER_CN_1,
+                                                                              TEST_SERVER_ALIAS_1,
+                                                                              TEST_SERVER_ALIAS_1,
+                                                                              CERTIFICATE_TYPE_SERVER,
+                                                                              TEST_VALIDITY);
+        CERT_PROPS_HANDLE client_handle = test_helper_create_certificate_props(TEST_CLIENT_CN_1,
+                                                                              TEST_CLIENT_ALIAS_1,
+                                                                              TEST_CLIENT_ALIAS_1,
+                                                                              CERTIFICATE_TYPE_CLIENT,
+                                                                              TEST_VALIDITY);
+        test_helper_generate_self_signed(server_handle,
+                                         TEST_SERIAL_NUM,
+                                         0,
+                                         TEST_SERVER_PK_ECC_FILE_1,
+                                         TEST_SERVER_CERT_ECC_FILE_1,
+                                         &key_props);
+        test_helper_generate_self_signed(client_handle,
+                                         TEST_SERIAL_NUM + 1,
+                                         0,
+                                         TEST_CLIENT_PK_ECC_FILE_1,
+                                         TEST_CLIENT_CERT_ECC_FILE_1,
+                                         &key_props);
+        verifier = pki_verifier_create(TEST_SERVER_CERT_ECC_FILE_1);
+        ASSERT_IS_NOT_NULL_WITH_MSG(verifier, "Line:" TOSTRING(__LINE__));
+
+        // act, assert
+        cert_verified = false;
+        status = verify_certificate_with_verifier(TEST_SERVER_CERT_ECC_FILE_1, verifier, &cert_verified);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        ASSERT_IS_TRUE_WITH_MSG(cert_verified, "Line:" TOSTRING(__LINE__));
+        cert_verified = true;
+        status = verify_certificate_with_verifier(TEST_CLIENT_CERT_ECC_FILE_1, verifier, &cert_verified);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        ASSERT_IS_FALSE_WITH_MSG(cert_verified, "Line:" TOSTRING(__LINE__));
+        // the verifier is not affected by changes to the issuer certificate file
+        delete_file(TEST_SERVER_CERT_ECC_FILE_1);
+        test_helper_generate_self_signed(server_handle,
+                                         TEST_SERIAL_NUM + 2,
+                                         0,
+                                         TEST_SERVER_PK_ECC_FILE_1,
+                                         TEST_SERVER_CERT_ECC_FILE_1,
+                                         &key_props);
+        cert_verified = true;
+        status = verify_certificate_with_verifier(TEST_SERVER_CERT_ECC_FILE_1, verifier, &cert_verified);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        ASSERT_IS_FALSE_WITH_MSG(cert_verified, "Line:" TOSTRING(__LINE__));
+
+        // cleanup
+        pki_verifier_destroy(verifier);
+        delete_file(TEST_CLIENT_PK_ECC_FILE_1);
+        delete_file(TEST_CLIENT_CERT_ECC_FILE_1);
+        delete_file(TEST_SERVER_PK_ECC_FILE_1);
+        delete_file(TEST_SERVER_CERT_ECC_FILE_1);
+        cert_properties_destroy(client_handle);
+        cert_properties_destroy(server_handle);
+    }
+
+    TEST_FUNCTION(test_chain_check_ignores_pem_line_endings)
+    {
+        // arrange
+        PKI_KEY_PROPS key_props = { HSM_PKI_KEY_EC, "prime256v1" };
+        bool cert_verified = false;
+        char *cert_data, *crlf_data;
+        size_t cert_size = 0, index, crlf_index = 0;
+        int status;
+        CERT_PROPS_HANDLE server_handle = test_helper_create_certificate_props(TEST_SERVER_CN_1,
+                                                                              TEST_SERVER_ALIAS_1,
+                                                                              TEST_SERVER_ALIAS_1,
+                                                                              CERTIFICATE_TYPE_SERVER,
+                                                                              TEST_VALIDITY);
+        test_helper_generate_self_signed(server_handle,
+                                         TEST_SERIAL_NUM,
+                                         0,
+                                         TEST_SERVER_PK_ECC_FILE_1,
+                                         TEST_SERVER_CERT_ECC_FILE_1,
+                                         &key_props);
+        cert_data = read_file_into_cstring(TEST_SERVER_CERT_ECC_FILE_1, &cert_size);
+        ASSERT_IS_NOT_NULL_WITH_MSG(cert_data, "Line:" TOSTRING(__LINE__));
+        crlf_data = (char*)malloc(2 * cert_size + 1);
+        ASSERT_IS_NOT_NULL_WITH_MSG(crlf_data, "Line:" TOSTRING(__LINE__));
+        for (index = 0; cert_data[index] != 0; index++)
+        {
+            if (cert_data[index] == '\n')
+            {
+                crlf_data[crlf_index++] = '\r';
+            }
+            crlf_data[crlf_index++] = cert_data[index];
+        }
+        crlf_data[crlf_index] = 0;
+        status = write_cstring_to_file(TEST_CLIENT_CERT_ECC_FILE_1, crlf_data);
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+
+        // act
+        status = verify_certificate(TEST_CLIENT_CERT_ECC_FILE_1, TEST_SERVER_PK_ECC_FILE_1, TEST_SERVER_CERT_ECC_FILE_1, &cert_verified);
+
+        // assert
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        ASSERT_IS_TRUE_WITH_MSG(cert_verified, "Line:" TOSTRING(__LINE__));
+
+        // cleanup
+        free(crlf_data);
+        free(cert_data);
+        delete_file(TEST_CLIENT_CERT_ECC_FILE_1);
+        delete_file(TEST_SERVER_PK_ECC_FILE_1);
+        delete_file(TEST_SERVER_CERT_ECC_FILE_1);
+        cert_properties_destroy(server_handle);
+    }
+
 #if USE_ECC_KEYS
     TEST_FUNCTION(test_self_signed_ecc_default_server_chain)
     {
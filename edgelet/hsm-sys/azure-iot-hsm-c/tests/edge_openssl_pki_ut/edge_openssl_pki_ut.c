@@ -49,6 +49,7 @@ static void test_hook_gballoc_free(void* ptr)
 #include <openssl/x509v3.h>
 #include <openssl/evp.h>
 #include "hsm_certificate_props.h"
+#include "hsm_key_pool.h"
 
 //#############################################################################
 // Declare and enable MOCK definitions
@@ -147,13 +148,43 @@ MOCKABLE_FUNCTION(, void, X509_STORE_CTX_free, X509_STORE_CTX*, ctx);
 MOCKABLE_FUNCTION(, int, X509_STORE_set_flags, X509_STORE*, ctx, unsigned long, flags);
 MOCKABLE_FUNCTION(, int, X509_STORE_CTX_get_error, X509_STORE_CTX*, ctx);
 MOCKABLE_FUNCTION(, const char*, X509_verify_cert_error_string, long, n);
-MOCKABLE_FUNCTION(, X509_LOOKUP_METHOD*, X509_LOOKUP_file);
-MOCKABLE_FUNCTION(, X509_LOOKUP*, X509_STORE_add_lookup, X509_STORE*, v, X509_LOOKUP_METHOD*, m);
-MOCKABLE_FUNCTION(, int, X509_LOOKUP_ctrl, X509_LOOKUP*, ctx, int, cmd, const char*, argc, long, argl, char**, ret);
-MOCKABLE_FUNCTION(, X509_LOOKUP_METHOD*, X509_LOOKUP_hash_dir);
+MOCKABLE_FUNCTION(, int, X509_STORE_add_cert, X509_STORE*, ctx, X509*, x);
+MOCKABLE_FUNCTION(, int, X509_digest, const X509*, data, const EVP_MD*, type, unsigned char*, md, unsigned int*, len);
+MOCKABLE_FUNCTION(, unsigned long, X509_subject_name_hash, X509*, x);
+MOCKABLE_FUNCTION(, unsigned long, X509_issuer_name_hash, X509*, a);
+MOCKABLE_FUNCTION(, int, ASN1_OCTET_STRING_cmp, const ASN1_OCTET_STRING*, a, const ASN1_OCTET_STRING*, b);
+MOCKABLE_FUNCTION(, void, ASN1_OCTET_STRING_free, ASN1_OCTET_STRING*, a);
+MOCKABLE_FUNCTION(, void, AUTHORITY_KEYID_free, AUTHORITY_KEYID*, a);
+#if ((OPENSSL_VERSION_NUMBER & 0xFFF00000L) >= 0x10100000L)
+    MOCKABLE_FUNCTION(, BIO*, BIO_new_mem_buf, const void*, buf, int, len);
+    MOCKABLE_FUNCTION(, void*, X509_get_ext_d2i, const X509*, x, int, nid, int*, crit, int*, idx);
+#else
+    MOCKABLE_FUNCTION(, BIO*, BIO_new_mem_buf, void*, buf, int, len);
+    MOCKABLE_FUNCTION(, void*, X509_get_ext_d2i, X509*, x, int, nid, int*, crit, int*, idx);
+#endif
 MOCKABLE_FUNCTION(, X509*, PEM_read_bio_X509, BIO*, bp, X509**, x, pem_password_cb*, cb, void*, u);
 MOCKABLE_FUNCTION(, int, PEM_write_bio_X509, BIO*, bp, X509*, x);
 MOCKABLE_FUNCTION(, int, X509_STORE_CTX_init, X509_STORE_CTX*, ctx, X509_STORE*, store, X509*, x509, struct stack_st_X509*, chain);
+MOCKABLE_FUNCTION(, int, EVP_DigestInit_ex, EVP_MD_CTX*, ctx, const EVP_MD*, type, ENGINE*, impl);
+MOCKABLE_FUNCTION(, int, EVP_DigestUpdate, EVP_MD_CTX*, ctx, const void*, d, size_t, cnt);
+MOCKABLE_FUNCTION(, int, EVP_DigestFinal_ex, EVP_MD_CTX*, ctx, unsigned char*, md, unsigned int*, s);
+#if ((OPENSSL_VERSION_NUMBER & 0xFFF00000L) >= 0x10100000L)
+    MOCKABLE_FUNCTION(, EVP_MD_CTX*, EVP_MD_CTX_new);
+    MOCKABLE_FUNCTION(, void, EVP_MD_CTX_free, EVP_MD_CTX*, ctx);
+#else
+    MOCKABLE_FUNCTION(, EVP_MD_CTX*, EVP_MD_CTX_create);
+    MOCKABLE_FUNCTION(, void, EVP_MD_CTX_destroy, EVP_MD_CTX*, ctx);
+#endif
+#if ((OPENSSL_VERSION_NUMBER & 0xFFF00000L) >= 0x30000000L)
+    MOCKABLE_FUNCTION(, int, i2d_X509, const X509*, a, unsigned char**, out);
+#else
+    MOCKABLE_FUNCTION(, int, i2d_X509, X509*, a, unsigned char**, out);
+#endif
+#if ((OPENSSL_VERSION_NUMBER & 0xFFF00000L) >= 0x10100000L)
+    MOCKABLE_FUNCTION(, int, X509_check_private_key, const X509*, x509, const EVP_PKEY*, pkey);
+#else
+    MOCKABLE_FUNCTION(, int, X509_check_private_key, X509*, x509, EVP_PKEY*, pkey);
+#endif
 MOCKABLE_FUNCTION(, uint64_t, get_validity_seconds, CERT_PROPS_HANDLE, handle);
 MOCKABLE_FUNCTION(, const char*, get_common_name, CERT_PROPS_HANDLE, handle);
 MOCKABLE_FUNCTION(, const char*, get_country_name, CERT_PROPS_HANDLE, handle);
@@ -162,6 +193,10 @@ MOCKABLE_FUNCTION(, const char*, get_locality, CERT_PROPS_HANDLE, handle);
 MOCKABLE_FUNCTION(, const char*, get_organization_name, CERT_PROPS_HANDLE, handle);
 MOCKABLE_FUNCTION(, const char*, get_organization_unit, CERT_PROPS_HANDLE, handle);
 MOCKABLE_FUNCTION(, CERTIFICATE_TYPE, get_certificate_type, CERT_PROPS_HANDLE, handle);
+MOCKABLE_FUNCTION(, HSM_KEY_POOL_HANDLE, hsm_key_pool_create, size_t, pool_size, HSM_KEY_POOL_GENERATE_KEY, generate_key, HSM_KEY_POOL_DESTROY_KEY, destroy_key);
+MOCKABLE_FUNCTION(, void, hsm_key_pool_destroy, HSM_KEY_POOL_HANDLE, handle);
+MOCKABLE_FUNCTION(, void*, hsm_key_pool_take, HSM_KEY_POOL_HANDLE, handle, int, key_type, int, key_param);
+MOCKABLE_FUNCTION(, void, hsm_key_pool_get_metrics, HSM_KEY_POOL_HANDLE, handle, HSM_KEY_POOL_METRICS*, metrics);
 
 #undef ENABLE_MOCKS
 
@@ -243,14 +278,16 @@ static TEST_MUTEX_HANDLE g_dllByDll;
 #define TEST_X509_STORE (X509_STORE*)0x2021
 #define TEST_EVP_SHA256_MD (EVP_MD*)0x2022
 #define TEST_STORE_CTXT (X509_STORE_CTX*)0x2023
-#define TEST_X509_LOOKUP_METHOD_FILE (X509_LOOKUP_METHOD*)0x2024
-#define TEST_X509_LOOKUP_METHOD_HASH (X509_LOOKUP_METHOD*)0x2025
-#define TEST_X509_LOOKUP_LOAD_FILE (X509_LOOKUP*)0x2026
-#define TEST_X509_LOOKUP_LOAD_HASH (X509_LOOKUP*)0x2027
-#define TEST_X509_LOOKUP (X509_LOOKUP*)0x2028
+#define TEST_X509_NAME_HASH (unsigned long)0x2024
+#define TEST_PKI_VERIFIER (PKI_VERIFIER_HANDLE)0x2025
 #define TEST_CERT_PROPS_HANDLE (CERT_PROPS_HANDLE)0x2029
 #define TEST_WRITE_PRIVATE_KEY_FD (int)0x2030
 #define TEST_WRITE_CERTIFICATE_FD (int)0x2031
+#define TEST_KEY_POOL_HANDLE (HSM_KEY_POOL_HANDLE)0x2032
+
+#define TEST_KEY_POOL_SIZE 4
+#define TEST_KEY_POOL_HITS 5
+#define TEST_KEY_POOL_MISSES 2
 
 #define TEST_UTC_TIME_FROM_ASN1 1000
 #define VALID_ASN1_TIME_STRING_UTC_FORMAT 0x17
@@ -655,13 +692,28 @@ static void* test_hook_read_file_into_buffer
     size_t *output_buffer_size
 )
 {
-    (void)file_name;
-    size_t test_data_len = strlen(TEST_ISSUER_CERT_DATA);
-    size_t test_data_size = test_data_len + 1;
-    void *data = test_hook_gballoc_malloc(test_data_size);
+    const char *test_data;
+    size_t test_data_len, test_data_size;
+    void *data;
+
+    if (strcmp(file_name, TEST_CERT_FILE) == 0)
+    {
+        test_data = TEST_VALID_CHAIN_CERT_DATA;
+    }
+    else if (strcmp(file_name, TEST_BAD_CHAIN_CERT_FILE) == 0)
+    {
+        test_data = TEST_INVALID_CHAIN_CERT_DATA;
+    }
+    else
+    {
+        test_data = TEST_ISSUER_CERT_DATA;
+    }
+    test_data_len = strlen(test_data);
+    test_data_size = test_data_len + 1;
+    data = test_hook_gballoc_malloc(test_data_size);
     ASSERT_IS_NOT_NULL_WITH_MSG(data, "Line:" TOSTRING(__LINE__));
     memset(data, 0, test_data_size);
-    memcpy(data, TEST_ISSUER_CERT_DATA, test_data_len);
+    memcpy(data, test_data, test_data_len);
     if (output_buffer_size) *output_buffer_size = test_data_size;
     return data;
 }
@@ -885,40 +937,48 @@ static int test_hook_X509_STORE_CTX_get_error(X509_STORE_CTX *ctx)
     return TEST_ERROR_CODE;
 }
 
-static X509_LOOKUP_METHOD* test_hook_X509_LOOKUP_file(void)
+static int test_hook_X509_STORE_add_cert(X509_STORE *ctx, X509 *x)
 {
-    return TEST_X509_LOOKUP_METHOD_FILE;
+    (void)ctx;
+    (void)x;
+
+    return 1;
 }
 
-static X509_LOOKUP* test_hook_X509_STORE_add_lookup(X509_STORE *v, X509_LOOKUP_METHOD *m)
+// the digest of a certificate is filled with the low byte of its handle
+static int test_hook_X509_digest(const X509 *data, const EVP_MD *type, unsigned char *md, unsigned int *len)
 {
-    (void)v;
-    (void)m;
+    (void)type;
 
-    return TEST_X509_LOOKUP;
+    memset(md, (int)((uintptr_t)data & 0xFF), 32);
+    *len = 32;
+    return 1;
 }
 
-static int test_hook_X509_LOOKUP_ctrl
-(
-    X509_LOOKUP *ctx,
-    int cmd,
-    const char *argc,
-    long argl,
-    char **ret
-)
+static unsigned long test_hook_X509_subject_name_hash(X509 *x)
 {
-    (void)ctx;
-    (void)cmd;
-    (void)argc;
-    (void)argl;
-    (void)ret;
+    (void)x;
 
-    return 1;
+    return TEST_X509_NAME_HASH;
 }
 
-static X509_LOOKUP_METHOD* test_hook_X509_LOOKUP_hash_dir(void)
+static unsigned long test_hook_X509_issuer_name_hash(X509 *a)
 {
-    return TEST_X509_LOOKUP_METHOD_HASH;
+    (void)a;
+
+    return TEST_X509_NAME_HASH;
+}
+
+#if ((OPENSSL_VERSION_NUMBER & 0xFFF00000L) >= 0x10100000L)
+static BIO* test_hook_BIO_new_mem_buf(const void *buf, int len)
+#else
+static BIO* test_hook_BIO_new_mem_buf(void *buf, int len)
+#endif
+{
+    (void)buf;
+    (void)len;
+
+    return TEST_BIO;
 }
 
 static X509* test_hook_PEM_read_bio_X509(BIO *bp, X509 **x, pem_password_cb *cb, void *u)
@@ -1011,6 +1071,28 @@ static CERTIFICATE_TYPE test_hook_get_certificate_type(CERT_PROPS_HANDLE handle)
     return TEST_PROPS_CERT_TYPE;
 }
 
+static HSM_KEY_POOL_HANDLE test_hook_hsm_key_pool_create
+(
+    size_t pool_size,
+    HSM_KEY_POOL_GENERATE_KEY generate_key,
+    HSM_KEY_POOL_DESTROY_KEY destroy_key
+)
+{
+    (void)pool_size;
+    (void)generate_key;
+    (void)destroy_key;
+
+    return TEST_KEY_POOL_HANDLE;
+}
+
+static void test_hook_hsm_key_pool_get_metrics(HSM_KEY_POOL_HANDLE handle, HSM_KEY_POOL_METRICS *metrics)
+{
+    (void)handle;
+
+    metrics->hits = TEST_KEY_POOL_HITS;
+    metrics->misses = TEST_KEY_POOL_MISSES;
+}
+
 //#############################################################################
 // Test helpers
 //#############################################################################
@@ -1183,6 +1265,10 @@ static void test_helper_cert_create_with_subject
 
     if (!is_self_signed)
     {
+        EXPECTED_CALL(gballoc_calloc(1, IGNORED_NUM_ARG));
+        ASSERT_IS_TRUE_WITH_MSG((i < failed_function_size), "Line:" TOSTRING(__LINE__));
+        failed_function_list[i++] = 1;
+
         STRICT_EXPECTED_CALL(BIO_new_file(TEST_ISSUER_CERT_FILE, "r"));
         ASSERT_IS_TRUE_WITH_MSG((i < failed_function_size), "Line:" TOSTRING(__LINE__));
         failed_function_list[i++] = 1;
@@ -1207,6 +1293,10 @@ static void test_helper_cert_create_with_subject
         ASSERT_IS_TRUE_WITH_MSG((i < failed_function_size), "Line:" TOSTRING(__LINE__));
         i++;
 
+        STRICT_EXPECTED_CALL(read_file_into_buffer(TEST_ISSUER_CERT_FILE, IGNORED_PTR_ARG));
+        ASSERT_IS_TRUE_WITH_MSG((i < failed_function_size), "Line:" TOSTRING(__LINE__));
+        failed_function_list[i++] = 1;
+
         STRICT_EXPECTED_CALL(X509_get_pubkey(TEST_ISSUER_X509)).SetReturn(TEST_ISSUER_PUB_KEY);
         ASSERT_IS_TRUE_WITH_MSG((i < failed_function_size), "Line:" TOSTRING(__LINE__));
         failed_function_list[i++] = 1;
@@ -1514,18 +1604,10 @@ static void test_helper_cert_create_with_subject
 
     if (!is_self_signed)
     {
-        STRICT_EXPECTED_CALL(read_file_into_buffer(TEST_ISSUER_CERT_FILE, IGNORED_PTR_ARG));
-        ASSERT_IS_TRUE_WITH_MSG((i < failed_function_size), "Line:" TOSTRING(__LINE__));
-        failed_function_list[i++] = 1;
-
         int cert_data_size = (int)(strlen(TEST_ISSUER_CERT_DATA)) + 1;
         STRICT_EXPECTED_CALL(BIO_write(TEST_BIO_WRITE_CERT, IGNORED_PTR_ARG, cert_data_size)).SetReturn(cert_data_size);
         ASSERT_IS_TRUE_WITH_MSG((i < failed_function_size), "Line:" TOSTRING(__LINE__));
         failed_function_list[i++] = 1;
-
-        EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
-        ASSERT_IS_TRUE_WITH_MSG((i < failed_function_size), "Line:" TOSTRING(__LINE__));
-        i++;
     }
 
     STRICT_EXPECTED_CALL(BIO_free_all(TEST_BIO_WRITE_CERT));
@@ -1556,6 +1638,14 @@ static void test_helper_cert_create_with_subject
         STRICT_EXPECTED_CALL(EVP_PKEY_free(TEST_ISSUER_EVP_KEY));
         ASSERT_IS_TRUE_WITH_MSG((i < failed_function_size), "Line:" TOSTRING(__LINE__));
         i++;
+
+        EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+        ASSERT_IS_TRUE_WITH_MSG((i < failed_function_size), "Line:" TOSTRING(__LINE__));
+        i++;
+
+        EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+        ASSERT_IS_TRUE_WITH_MSG((i < failed_function_size), "Line:" TOSTRING(__LINE__));
+        i++;
     }
 }
 
@@ -1599,35 +1689,67 @@ static void test_helper_load_cert_file
     *index = i;
 }
 
-static void test_helper_verify_certificate
+static void test_helper_load_cert_chain
 (
     const char *cert_file,
-    const char *key_file,
-    const char *issuer_cert_file,
-    bool force_set_verify_return_value,
+    X509 *leaf_x509,
+    X509 *issuer_x509,
+    size_t *index,
     char *failed_function_list,
     size_t failed_function_size
 )
 {
-    (void)key_file;
+    size_t i = *index;
 
-    size_t i = 0;
+    STRICT_EXPECTED_CALL(read_file_into_buffer(cert_file, IGNORED_PTR_ARG));
+    ASSERT_IS_TRUE_WITH_MSG((i < failed_function_size), "Line:" TOSTRING(__LINE__));
+    failed_function_list[i++] = 1;
 
-    umock_c_reset_all_calls();
+    EXPECTED_CALL(BIO_new_mem_buf(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    ASSERT_IS_TRUE_WITH_MSG((i < failed_function_size), "Line:" TOSTRING(__LINE__));
+    failed_function_list[i++] = 1;
 
-    EXPECTED_CALL(initialize_openssl());
+    STRICT_EXPECTED_CALL(PEM_read_bio_X509(TEST_BIO, NULL, NULL, NULL)).SetReturn(leaf_x509);
     ASSERT_IS_TRUE_WITH_MSG((i < failed_function_size), "Line:" TOSTRING(__LINE__));
-    i++;
+    failed_function_list[i++] = 1;
 
-    STRICT_EXPECTED_CALL(read_file_into_cstring(cert_file, NULL));
+    EXPECTED_CALL(gballoc_realloc(NULL, IGNORED_NUM_ARG));
     ASSERT_IS_TRUE_WITH_MSG((i < failed_function_size), "Line:" TOSTRING(__LINE__));
     failed_function_list[i++] = 1;
 
-    STRICT_EXPECTED_CALL(read_file_into_cstring(issuer_cert_file, NULL));
+    EXPECTED_CALL(EVP_sha256());
+    ASSERT_IS_TRUE_WITH_MSG((i < failed_function_size), "Line:" TOSTRING(__LINE__));
+    i++;
+
+    STRICT_EXPECTED_CALL(X509_digest(leaf_x509, TEST_EVP_SHA256_MD, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     ASSERT_IS_TRUE_WITH_MSG((i < failed_function_size), "Line:" TOSTRING(__LINE__));
     failed_function_list[i++] = 1;
 
-    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    if (issuer_x509 != NULL)
+    {
+        // a chain without the issuer is not an error
+        STRICT_EXPECTED_CALL(PEM_read_bio_X509(TEST_BIO, NULL, NULL, NULL)).SetReturn(issuer_x509);
+        ASSERT_IS_TRUE_WITH_MSG((i < failed_function_size), "Line:" TOSTRING(__LINE__));
+        i++;
+
+        EXPECTED_CALL(gballoc_realloc(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+        ASSERT_IS_TRUE_WITH_MSG((i < failed_function_size), "Line:" TOSTRING(__LINE__));
+        failed_function_list[i++] = 1;
+
+        EXPECTED_CALL(EVP_sha256());
+        ASSERT_IS_TRUE_WITH_MSG((i < failed_function_size), "Line:" TOSTRING(__LINE__));
+        i++;
+
+        STRICT_EXPECTED_CALL(X509_digest(issuer_x509, TEST_EVP_SHA256_MD, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+        ASSERT_IS_TRUE_WITH_MSG((i < failed_function_size), "Line:" TOSTRING(__LINE__));
+        failed_function_list[i++] = 1;
+    }
+
+    STRICT_EXPECTED_CALL(PEM_read_bio_X509(TEST_BIO, NULL, NULL, NULL)).SetReturn(NULL);
+    ASSERT_IS_TRUE_WITH_MSG((i < failed_function_size), "Line:" TOSTRING(__LINE__));
+    i++;
+
+    STRICT_EXPECTED_CALL(BIO_free_all(TEST_BIO));
     ASSERT_IS_TRUE_WITH_MSG((i < failed_function_size), "Line:" TOSTRING(__LINE__));
     i++;
 
@@ -1635,35 +1757,107 @@ static void test_helper_verify_certificate
     ASSERT_IS_TRUE_WITH_MSG((i < failed_function_size), "Line:" TOSTRING(__LINE__));
     i++;
 
+    *index = i;
+}
+
+static void test_helper_load_verifier
+(
+    const char *issuer_cert_file,
+    size_t *index,
+    char *failed_function_list,
+    size_t failed_function_size
+)
+{
+    size_t i = *index;
+    unsigned long policy = X509_V_FLAG_X509_STRICT |
+                           X509_V_FLAG_CHECK_SS_SIGNATURE |
+                           X509_V_FLAG_POLICY_CHECK;
+
+    EXPECTED_CALL(gballoc_calloc(1, IGNORED_NUM_ARG));
+    ASSERT_IS_TRUE_WITH_MSG((i < failed_function_size), "Line:" TOSTRING(__LINE__));
+    failed_function_list[i++] = 1;
+
+    test_helper_load_cert_chain(issuer_cert_file, TEST_ISSUER_X509, NULL, &i, failed_function_list, failed_function_size);
+
     STRICT_EXPECTED_CALL(X509_STORE_new());
     ASSERT_IS_TRUE_WITH_MSG((i < failed_function_size), "Line:" TOSTRING(__LINE__));
     failed_function_list[i++] = 1;
 
-    EXPECTED_CALL(X509_LOOKUP_file());
+    STRICT_EXPECTED_CALL(X509_STORE_set_flags(TEST_X509_STORE, policy));
     ASSERT_IS_TRUE_WITH_MSG((i < failed_function_size), "Line:" TOSTRING(__LINE__));
     i++;
 
-    STRICT_EXPECTED_CALL(X509_STORE_add_lookup(TEST_X509_STORE, TEST_X509_LOOKUP_METHOD_FILE)).SetReturn(TEST_X509_LOOKUP_LOAD_FILE);
+    STRICT_EXPECTED_CALL(X509_STORE_add_cert(TEST_X509_STORE, TEST_ISSUER_X509));
     ASSERT_IS_TRUE_WITH_MSG((i < failed_function_size), "Line:" TOSTRING(__LINE__));
     failed_function_list[i++] = 1;
 
-    STRICT_EXPECTED_CALL(X509_LOOKUP_ctrl(TEST_X509_LOOKUP_LOAD_FILE, IGNORED_NUM_ARG, issuer_cert_file, X509_FILETYPE_PEM, NULL));
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
     ASSERT_IS_TRUE_WITH_MSG((i < failed_function_size), "Line:" TOSTRING(__LINE__));
     failed_function_list[i++] = 1;
 
-    EXPECTED_CALL(X509_LOOKUP_hash_dir());
+    STRICT_EXPECTED_CALL(X509_subject_name_hash(TEST_ISSUER_X509));
     ASSERT_IS_TRUE_WITH_MSG((i < failed_function_size), "Line:" TOSTRING(__LINE__));
     i++;
 
-    STRICT_EXPECTED_CALL(X509_STORE_add_lookup(TEST_X509_STORE, TEST_X509_LOOKUP_METHOD_HASH)).SetReturn(TEST_X509_LOOKUP_LOAD_HASH);
+    STRICT_EXPECTED_CALL(X509_get_ext_d2i(TEST_ISSUER_X509, NID_subject_key_identifier, NULL, NULL));
     ASSERT_IS_TRUE_WITH_MSG((i < failed_function_size), "Line:" TOSTRING(__LINE__));
-    failed_function_list[i++] = 1;
+    i++;
+
+    *index = i;
+}
+
+static void test_helper_destroy_verifier(size_t *index, size_t failed_function_size)
+{
+    size_t i = *index;
 
-    STRICT_EXPECTED_CALL(X509_LOOKUP_ctrl(TEST_X509_LOOKUP_LOAD_HASH, IGNORED_NUM_ARG, NULL, X509_FILETYPE_DEFAULT, NULL));
+    // anchors
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
     ASSERT_IS_TRUE_WITH_MSG((i < failed_function_size), "Line:" TOSTRING(__LINE__));
-    failed_function_list[i++] = 1;
+    i++;
 
-    test_helper_load_cert_file(TEST_CERT_FILE, TEST_X509, &i, failed_function_list, failed_function_size);
+    STRICT_EXPECTED_CALL(X509_free(TEST_ISSUER_X509));
+    ASSERT_IS_TRUE_WITH_MSG((i < failed_function_size), "Line:" TOSTRING(__LINE__));
+    i++;
+
+    // issuer chain
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    ASSERT_IS_TRUE_WITH_MSG((i < failed_function_size), "Line:" TOSTRING(__LINE__));
+    i++;
+
+    STRICT_EXPECTED_CALL(X509_STORE_free(TEST_X509_STORE));
+    ASSERT_IS_TRUE_WITH_MSG((i < failed_function_size), "Line:" TOSTRING(__LINE__));
+    i++;
+
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    ASSERT_IS_TRUE_WITH_MSG((i < failed_function_size), "Line:" TOSTRING(__LINE__));
+    i++;
+
+    *index = i;
+}
+
+static void test_helper_verify_certificate
+(
+    const char *cert_file,
+    const char *key_file,
+    const char *issuer_cert_file,
+    bool force_set_verify_return_value,
+    char *failed_function_list,
+    size_t failed_function_size
+)
+{
+    (void)key_file;
+
+    size_t i = 0;
+
+    umock_c_reset_all_calls();
+
+    EXPECTED_CALL(initialize_openssl());
+    ASSERT_IS_TRUE_WITH_MSG((i < failed_function_size), "Line:" TOSTRING(__LINE__));
+    i++;
+
+    test_helper_load_verifier(issuer_cert_file, &i, failed_function_list, failed_function_size);
+
+    test_helper_load_cert_chain(cert_file, TEST_X509, TEST_ISSUER_X509, &i, failed_function_list, failed_function_size);
 
     STRICT_EXPECTED_CALL(mocked_X509_get_notAfter(TEST_X509));
     ASSERT_IS_TRUE_WITH_MSG((i < failed_function_size), "Line:" TOSTRING(__LINE__));
@@ -1673,18 +1867,18 @@ static void test_helper_verify_certificate
     ASSERT_IS_TRUE_WITH_MSG((i < failed_function_size), "Line:" TOSTRING(__LINE__));
     failed_function_list[i++] = 1;
 
-    STRICT_EXPECTED_CALL(X509_STORE_CTX_new());
+    STRICT_EXPECTED_CALL(X509_issuer_name_hash(TEST_X509));
     ASSERT_IS_TRUE_WITH_MSG((i < failed_function_size), "Line:" TOSTRING(__LINE__));
-    failed_function_list[i++] = 1;
-
-    unsigned long policy = X509_V_FLAG_X509_STRICT |
-                           X509_V_FLAG_CHECK_SS_SIGNATURE |
-                           X509_V_FLAG_POLICY_CHECK;
+    i++;
 
-    STRICT_EXPECTED_CALL(X509_STORE_set_flags(TEST_X509_STORE, policy));
+    STRICT_EXPECTED_CALL(X509_get_ext_d2i(TEST_X509, NID_authority_key_identifier, NULL, NULL));
     ASSERT_IS_TRUE_WITH_MSG((i < failed_function_size), "Line:" TOSTRING(__LINE__));
     i++;
 
+    STRICT_EXPECTED_CALL(X509_STORE_CTX_new());
+    ASSERT_IS_TRUE_WITH_MSG((i < failed_function_size), "Line:" TOSTRING(__LINE__));
+    failed_function_list[i++] = 1;
+
     STRICT_EXPECTED_CALL(X509_STORE_CTX_init(TEST_STORE_CTXT, TEST_X509_STORE, TEST_X509, 0));
     ASSERT_IS_TRUE_WITH_MSG((i < failed_function_size), "Line:" TOSTRING(__LINE__));
     failed_function_list[i++] = 1;
@@ -1709,13 +1903,20 @@ static void test_helper_verify_certificate
     ASSERT_IS_TRUE_WITH_MSG((i < failed_function_size), "Line:" TOSTRING(__LINE__));
     i++;
 
+    // certificate chain
     STRICT_EXPECTED_CALL(X509_free(TEST_X509));
     ASSERT_IS_TRUE_WITH_MSG((i < failed_function_size), "Line:" TOSTRING(__LINE__));
     i++;
 
-    STRICT_EXPECTED_CALL(X509_STORE_free(TEST_X509_STORE));
+    STRICT_EXPECTED_CALL(X509_free(TEST_ISSUER_X509));
     ASSERT_IS_TRUE_WITH_MSG((i < failed_function_size), "Line:" TOSTRING(__LINE__));
     i++;
+
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    ASSERT_IS_TRUE_WITH_MSG((i < failed_function_size), "Line:" TOSTRING(__LINE__));
+    i++;
+
+    test_helper_destroy_verifier(&i, failed_function_size);
 }
 
 //#############################################################################
@@ -1738,6 +1939,9 @@ BEGIN_TEST_SUITE(edge_openssl_pki_unittests)
         REGISTER_UMOCK_ALIAS_TYPE(CERT_PROPS_HANDLE, void*);
         REGISTER_UMOCK_ALIAS_TYPE(CERTIFICATE_TYPE, int);
         REGISTER_UMOCK_ALIAS_TYPE(MODE_T, int);
+        REGISTER_UMOCK_ALIAS_TYPE(HSM_KEY_POOL_HANDLE, void*);
+        REGISTER_UMOCK_ALIAS_TYPE(HSM_KEY_POOL_GENERATE_KEY, void*);
+        REGISTER_UMOCK_ALIAS_TYPE(HSM_KEY_POOL_DESTROY_KEY, void*);
 
         REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, test_hook_gballoc_malloc);
         REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
@@ -1912,17 +2116,18 @@ BEGIN_TEST_SUITE(edge_openssl_pki_unittests)
         REGISTER_GLOBAL_MOCK_HOOK(X509_STORE_CTX_get_error, test_hook_X509_STORE_CTX_get_error);
         REGISTER_GLOBAL_MOCK_FAIL_RETURN(X509_STORE_CTX_get_error, 0);
 
-        REGISTER_GLOBAL_MOCK_HOOK(X509_LOOKUP_file, test_hook_X509_LOOKUP_file);
-        REGISTER_GLOBAL_MOCK_FAIL_RETURN(X509_LOOKUP_file, NULL);
+        REGISTER_GLOBAL_MOCK_HOOK(X509_STORE_add_cert, test_hook_X509_STORE_add_cert);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(X509_STORE_add_cert, 0);
 
-        REGISTER_GLOBAL_MOCK_HOOK(X509_STORE_add_lookup, test_hook_X509_STORE_add_lookup);
-        REGISTER_GLOBAL_MOCK_FAIL_RETURN(X509_STORE_add_lookup, NULL);
+        REGISTER_GLOBAL_MOCK_HOOK(X509_digest, test_hook_X509_digest);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(X509_digest, 0);
 
-        REGISTER_GLOBAL_MOCK_HOOK(X509_LOOKUP_ctrl, test_hook_X509_LOOKUP_ctrl);
-        REGISTER_GLOBAL_MOCK_FAIL_RETURN(X509_LOOKUP_ctrl, 0);
+        REGISTER_GLOBAL_MOCK_HOOK(X509_subject_name_hash, test_hook_X509_subject_name_hash);
+        REGISTER_GLOBAL_MOCK_HOOK(X509_issuer_name_hash, test_hook_X509_issuer_name_hash);
+        REGISTER_GLOBAL_MOCK_RETURN(X509_get_ext_d2i, NULL);
 
-        REGISTER_GLOBAL_MOCK_HOOK(X509_LOOKUP_hash_dir, test_hook_X509_LOOKUP_hash_dir);
-        REGISTER_GLOBAL_MOCK_FAIL_RETURN(X509_LOOKUP_hash_dir, NULL);
+        REGISTER_GLOBAL_MOCK_HOOK(BIO_new_mem_buf, test_hook_BIO_new_mem_buf);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(BIO_new_mem_buf, NULL);
 
         REGISTER_GLOBAL_MOCK_HOOK(PEM_read_bio_X509, test_hook_PEM_read_bio_X509);
         REGISTER_GLOBAL_MOCK_FAIL_RETURN(PEM_read_bio_X509, NULL);
@@ -1956,6 +2161,10 @@ BEGIN_TEST_SUITE(edge_openssl_pki_unittests)
 
         REGISTER_GLOBAL_MOCK_HOOK(get_certificate_type, test_hook_get_certificate_type);
         REGISTER_GLOBAL_MOCK_FAIL_RETURN(get_certificate_type, CERTIFICATE_TYPE_UNKNOWN);
+
+        REGISTER_GLOBAL_MOCK_HOOK(hsm_key_pool_create, test_hook_hsm_key_pool_create);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(hsm_key_pool_create, NULL);
+        REGISTER_GLOBAL_MOCK_HOOK(hsm_key_pool_get_metrics, test_hook_hsm_key_pool_get_metrics);
     }
 
     TEST_SUITE_CLEANUP(TestClassCleanup)
@@ -2977,11 +3186,18 @@ BEGIN_TEST_SUITE(edge_openssl_pki_unittests)
         // arrange
         bool verify_status = false;
 
+        size_t i = 0;
+        size_t failed_function_size = MAX_FAILED_FUNCTION_LIST_SIZE;
+        char failed_function_list[MAX_FAILED_FUNCTION_LIST_SIZE];
+        memset(failed_function_list, 0, failed_function_size);
         EXPECTED_CALL(initialize_openssl());
-        STRICT_EXPECTED_CALL(read_file_into_cstring(TEST_BAD_CHAIN_CERT_FILE, NULL));
-        STRICT_EXPECTED_CALL(read_file_into_cstring(TEST_ISSUER_CERT_FILE, NULL));
-        EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+        i++;
+        test_helper_load_verifier(TEST_ISSUER_CERT_FILE, &i, failed_function_list, failed_function_size);
+        test_helper_load_cert_chain(TEST_BAD_CHAIN_CERT_FILE, TEST_X509, NULL, &i, failed_function_list, failed_function_size);
+        STRICT_EXPECTED_CALL(X509_free(TEST_X509));
         EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+        i += 2;
+        test_helper_destroy_verifier(&i, failed_function_size);
 
         // act
         int status = verify_certificate(TEST_BAD_CHAIN_CERT_FILE, TEST_KEY_FILE, TEST_ISSUER_CERT_FILE, &verify_status);
@@ -3055,4 +3271,189 @@ BEGIN_TEST_SUITE(edge_openssl_pki_unittests)
         umock_c_negative_tests_deinit();
     }
 
+    /**
+     * Test function for API
+     *   get_certificate_verification_id
+    */
+    TEST_FUNCTION(get_certificate_verification_id_invalid_parameters_returns_error)
+    {
+        // arrange
+        unsigned char id[CERT_VERIFICATION_ID_SIZE];
+        int64_t not_after = 0;
+        int status;
+
+        // act, assert
+        status = get_certificate_verification_id(NULL, TEST_ISSUER_CERT_FILE, id, sizeof(id), &not_after);
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+
+        status = get_certificate_verification_id(TEST_CERT_FILE, NULL, id, sizeof(id), &not_after);
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+
+        status = get_certificate_verification_id(TEST_CERT_FILE, TEST_ISSUER_CERT_FILE, NULL, sizeof(id), &not_after);
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+
+        status = get_certificate_verification_id(TEST_CERT_FILE, TEST_ISSUER_CERT_FILE, id, sizeof(id) - 1, &not_after);
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+
+        status = get_certificate_verification_id(TEST_CERT_FILE, TEST_ISSUER_CERT_FILE, id, sizeof(id), NULL);
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+
+        // cleanup
+    }
+
+    /**
+     * Test function for API
+     *   check_certificate_key
+    */
+    TEST_FUNCTION(check_certificate_key_invalid_parameters_returns_error)
+    {
+        // arrange
+        bool key_matches = true;
+        int status;
+
+        // act, assert
+        status = check_certificate_key(NULL, TEST_KEY_FILE, &key_matches);
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+
+        status = check_certificate_key(TEST_CERT_FILE, NULL, &key_matches);
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+
+        status = check_certificate_key(TEST_CERT_FILE, TEST_KEY_FILE, NULL);
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+
+        // cleanup
+    }
+
+    TEST_FUNCTION(generate_pki_cert_and_key_with_issuer_invalid_params)
+    {
+        // arrange
+        int status;
+
+        // act
+        status = generate_pki_cert_and_key_with_issuer(TEST_CERT_PROPS_HANDLE, TEST_SERIAL_NUMBER, TEST_PATH_LEN_NON_CA, TEST_KEY_FILE, TEST_CERT_FILE, NULL);
+
+        // assert
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+
+        // cleanup
+    }
+
+    TEST_FUNCTION(pki_issuer_create_invalid_params)
+    {
+        // arrange
+        PKI_ISSUER_HANDLE issuer;
+
+        // act, assert
+        issuer = pki_issuer_create(NULL, TEST_ISSUER_CERT_FILE);
+        ASSERT_IS_NULL_WITH_MSG(issuer, "Line:" TOSTRING(__LINE__));
+
+        issuer = pki_issuer_create(TEST_ISSUER_KEY_FILE, NULL);
+        ASSERT_IS_NULL_WITH_MSG(issuer, "Line:" TOSTRING(__LINE__));
+
+        // cleanup
+    }
+
+    TEST_FUNCTION(pki_verifier_create_invalid_params)
+    {
+        // arrange
+        PKI_VERIFIER_HANDLE verifier;
+
+        // act
+        verifier = pki_verifier_create(NULL);
+
+        // assert
+        ASSERT_IS_NULL_WITH_MSG(verifier, "Line:" TOSTRING(__LINE__));
+
+        // cleanup
+    }
+
+    TEST_FUNCTION(verify_certificate_with_verifier_invalid_params)
+    {
+        // arrange
+        int status;
+        bool verify_status = true;
+
+        // act, assert
+        status = verify_certificate_with_verifier(NULL, TEST_PKI_VERIFIER, &verify_status);
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        ASSERT_IS_FALSE_WITH_MSG(verify_status, "Line:" TOSTRING(__LINE__));
+
+        verify_status = true;
+        status = verify_certificate_with_verifier(TEST_CERT_FILE, NULL, &verify_status);
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        ASSERT_IS_FALSE_WITH_MSG(verify_status, "Line:" TOSTRING(__LINE__));
+
+        status = verify_certificate_with_verifier(TEST_CERT_FILE, TEST_PKI_VERIFIER, NULL);
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+
+        // cleanup
+    }
+
+    TEST_FUNCTION(pki_key_pool_init_deinit_success)
+    {
+        // arrange
+        int status;
+        EXPECTED_CALL(initialize_openssl());
+        STRICT_EXPECTED_CALL(hsm_key_pool_create(TEST_KEY_POOL_SIZE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+        // act
+        status = pki_key_pool_init(TEST_KEY_POOL_SIZE);
+
+        // assert
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        ASSERT_ARE_EQUAL_WITH_MSG(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls(), "Line:" TOSTRING(__LINE__));
+
+        // act, assert
+        // the metrics are read once to be logged before the pool is destroyed
+        umock_c_reset_all_calls();
+        STRICT_EXPECTED_CALL(hsm_key_pool_get_metrics(TEST_KEY_POOL_HANDLE, IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(hsm_key_pool_destroy(TEST_KEY_POOL_HANDLE));
+        pki_key_pool_deinit();
+        ASSERT_ARE_EQUAL_WITH_MSG(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls(), "Line:" TOSTRING(__LINE__));
+
+        // a second deinit is a no-op
+        umock_c_reset_all_calls();
+        pki_key_pool_deinit();
+        ASSERT_ARE_EQUAL_WITH_MSG(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls(), "Line:" TOSTRING(__LINE__));
+
+        // cleanup
+    }
+
+    TEST_FUNCTION(pki_key_pool_init_create_failure_returns_error)
+    {
+        // arrange
+        int status;
+        uint64_t hits = 0, misses = 0;
+        EXPECTED_CALL(initialize_openssl());
+        STRICT_EXPECTED_CALL(hsm_key_pool_create(TEST_KEY_POOL_SIZE, IGNORED_PTR_ARG, IGNORED_PTR_ARG)).SetReturn(NULL);
+
+        // act
+        status = pki_key_pool_init(TEST_KEY_POOL_SIZE);
+
+        // assert
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+        ASSERT_ARE_EQUAL_WITH_MSG(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls(), "Line:" TOSTRING(__LINE__));
+        status = pki_key_pool_get_metrics(&hits, &misses);
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+
+        // cleanup
+        pki_key_pool_deinit();
+    }
+
+    TEST_FUNCTION(pki_key_pool_get_metrics_invalid_parameters_returns_error)
+    {
+        // arrange
+        int status;
+        uint64_t value = 0;
+
+        // act, assert
+        status = pki_key_pool_get_metrics(NULL, &value);
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+
+        status = pki_key_pool_get_metrics(&value, NULL);
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+
+        // cleanup
+    }
+
 END_TEST_SUITE(edge_openssl_pki_unittests)
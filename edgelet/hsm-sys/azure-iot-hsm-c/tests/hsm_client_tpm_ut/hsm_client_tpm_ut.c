@@ -43,6 +43,7 @@ static void my_gballoc_free(void* ptr)
 #include "azure_utpm_c/Marshal_fp.h"
 
 #include "edge_sas_perform_sign_with_key.h"
+#include "hsm_sign_cache.h"
 
 #include "azure_utpm_c/TpmTypes.h"
 #undef ENABLE_MOCKS
@@ -115,6 +116,22 @@ static int my_perform_sign_with_key( const unsigned char* key, size_t key_len,
     return 0;
 }
 
+static int my_perform_sign_with_key_into( const unsigned char* key, size_t key_len,
+                                          const unsigned char* data_to_be_signed, size_t data_to_be_signed_size,
+                                          unsigned char* digest, size_t* digest_size)
+{
+    (void)key;
+    (void)key_len;
+    (void)data_to_be_signed;
+    (void)data_to_be_signed_size;
+    if ((digest != NULL) && (*digest_size >= 32))
+    {
+        memset(digest, 0, 32);
+    }
+    *digest_size = 32;
+    return 0;
+}
+
 /*static BUFFER_HANDLE my_Base64_Decoder(const char* source)
 {
     (void)source;
@@ -162,6 +179,7 @@ BEGIN_TEST_SUITE(hsm_client_tpm_ut)
         REGISTER_UMOCK_ALIAS_TYPE(XDA_HANDLE, void*);
         REGISTER_UMOCK_ALIAS_TYPE(BUFFER_HANDLE, void*);
         REGISTER_UMOCK_ALIAS_TYPE(TPM_HANDLE, void*);
+        REGISTER_UMOCK_ALIAS_TYPE(HSM_SIGN_CACHE_HANDLE, void*);
         REGISTER_UMOCK_ALIAS_TYPE(UINT, unsigned int);
         REGISTER_UMOCK_ALIAS_TYPE(UINT32, unsigned int);
         REGISTER_UMOCK_ALIAS_TYPE(BOOL, int);
@@ -232,6 +250,8 @@ BEGIN_TEST_SUITE(hsm_client_tpm_ut)
 
         REGISTER_GLOBAL_MOCK_HOOK(perform_sign_with_key, my_perform_sign_with_key);
         REGISTER_GLOBAL_MOCK_FAIL_RETURN(perform_sign_with_key, 1);
+        REGISTER_GLOBAL_MOCK_HOOK(perform_sign_with_key_into, my_perform_sign_with_key_into);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(perform_sign_with_key_into, 1);
 
         for (size_t index = 0; index < 10; index++)
         {
@@ -800,9 +820,9 @@ BEGIN_TEST_SUITE(hsm_client_tpm_ut)
         tpm_if->hsm_client_tpm_destroy(sec_handle);
     }
 
-    TEST_FUNCTION(hsm_client_tpm_sign_data_digest_null_fail)
+    TEST_FUNCTION(hsm_client_tpm_sign_data_digest_null_returns_size)
     {
-        size_t key_len;
+        size_t key_len = 0;
 
         //arrange
         const HSM_CLIENT_TPM_INTERFACE* tpm_if = hsm_client_tpm_device_interface();
@@ -813,7 +833,8 @@ BEGIN_TEST_SUITE(hsm_client_tpm_ut)
         int result = tpm_if->hsm_client_sign_with_identity(sec_handle, TEST_BUFFER, TEST_BUFFER_SIZE, NULL, &key_len);
 
         //assert
-        ASSERT_ARE_NOT_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(size_t, 32, key_len);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
         //cleanup
@@ -1009,9 +1030,9 @@ BEGIN_TEST_SUITE(hsm_client_tpm_ut)
         tpm_if->hsm_client_tpm_destroy(sec_handle);
     }
 
-    TEST_FUNCTION(hsm_client_tpm_derive_and_sign_digest_null_fail)
+    TEST_FUNCTION(hsm_client_tpm_derive_and_sign_digest_null_returns_size)
     {
-        size_t key_len;
+        size_t key_len = 0;
 
         //arrange
         const HSM_CLIENT_TPM_INTERFACE* tpm_if = hsm_client_tpm_device_interface();
@@ -1023,7 +1044,8 @@ BEGIN_TEST_SUITE(hsm_client_tpm_ut)
                 IDENTITY_BUFFER, IDENTITY_BUFFER_SIZE, NULL, &key_len);
 
         //assert
-        ASSERT_ARE_NOT_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(size_t, 32, key_len);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
         //cleanup
@@ -1101,7 +1123,8 @@ BEGIN_TEST_SUITE(hsm_client_tpm_ut)
         umock_c_reset_all_calls();
 
         STRICT_EXPECTED_CALL(SignData(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG));
-        STRICT_EXPECTED_CALL(perform_sign_with_key(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(perform_sign_with_key_into(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
 
         //act
         int result = tpm_if->hsm_client_derive_and_sign_with_identity(sec_handle, TEST_BUFFER, TEST_BUFFER_SIZE, 
@@ -1116,6 +1139,206 @@ BEGIN_TEST_SUITE(hsm_client_tpm_ut)
         tpm_if->hsm_client_tpm_destroy(sec_handle);
     }
 
+    TEST_FUNCTION(hsm_client_tpm_sign_data_into_succeed)
+    {
+        unsigned char digest[TEST_BUFFER_SIZE];
+        size_t digest_len = sizeof(digest);
+
+        //arrange
+        const HSM_CLIENT_TPM_INTERFACE* tpm_if = hsm_client_tpm_device_interface();
+        HSM_CLIENT_HANDLE sec_handle = tpm_if->hsm_client_tpm_create();
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(SignData(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+
+        //act
+        int result = tpm_if->hsm_client_sign_with_identity_into(sec_handle, TEST_BUFFER, TEST_BUFFER_SIZE, digest, &digest_len);
+
+        //assert
+        ASSERT_ARE_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(size_t, TEST_BUFFER_SIZE, digest_len);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        tpm_if->hsm_client_tpm_destroy(sec_handle);
+    }
+
+    TEST_FUNCTION(hsm_client_tpm_sign_data_into_small_buffer_fail)
+    {
+        unsigned char digest[16];
+        size_t digest_len = sizeof(digest);
+
+        //arrange
+        const HSM_CLIENT_TPM_INTERFACE* tpm_if = hsm_client_tpm_device_interface();
+        HSM_CLIENT_HANDLE sec_handle = tpm_if->hsm_client_tpm_create();
+        umock_c_reset_all_calls();
+
+        //act
+        int result = tpm_if->hsm_client_sign_with_identity_into(sec_handle, TEST_BUFFER, TEST_BUFFER_SIZE, digest, &digest_len);
+
+        //assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(size_t, 32, digest_len);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        tpm_if->hsm_client_tpm_destroy(sec_handle);
+    }
+
+    TEST_FUNCTION(hsm_client_tpm_derive_and_sign_into_succeed)
+    {
+        unsigned char digest[32];
+        size_t digest_len = sizeof(digest);
+
+        //arrange
+        const HSM_CLIENT_TPM_INTERFACE* tpm_if = hsm_client_tpm_device_interface();
+        HSM_CLIENT_HANDLE sec_handle = tpm_if->hsm_client_tpm_create();
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(SignData(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+        STRICT_EXPECTED_CALL(perform_sign_with_key_into(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, digest, &digest_len));
+
+        //act
+        int result = tpm_if->hsm_client_derive_and_sign_with_identity_into(sec_handle, TEST_BUFFER, TEST_BUFFER_SIZE,
+                IDENTITY_BUFFER, IDENTITY_BUFFER_SIZE, digest, &digest_len);
+
+        //assert
+        ASSERT_ARE_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        tpm_if->hsm_client_tpm_destroy(sec_handle);
+    }
+
+    TEST_FUNCTION(hsm_client_tpm_sign_batch_invalid_requests_fail)
+    {
+        unsigned char* digests;
+        size_t digest_len;
+        HSM_SIGN_REQUEST requests[1] = { { TEST_BUFFER, TEST_BUFFER_SIZE, NULL, 0 } };
+
+        //arrange
+        const HSM_CLIENT_TPM_INTERFACE* tpm_if = hsm_client_tpm_device_interface();
+        HSM_CLIENT_HANDLE sec_handle = tpm_if->hsm_client_tpm_create();
+        umock_c_reset_all_calls();
+
+        //act
+        int result_null = tpm_if->hsm_client_sign_batch(sec_handle, NULL, 1, &digests, &digest_len);
+        int result_empty = tpm_if->hsm_client_sign_batch(sec_handle, requests, 0, &digests, &digest_len);
+        int result_identity = tpm_if->hsm_client_derive_and_sign_batch(sec_handle, requests, 1, &digests, &digest_len);
+
+        //assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result_null);
+        ASSERT_ARE_NOT_EQUAL(int, 0, result_empty);
+        ASSERT_ARE_NOT_EQUAL(int, 0, result_identity);
+        ASSERT_IS_NULL(digests);
+        ASSERT_ARE_EQUAL(size_t, 0, digest_len);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        tpm_if->hsm_client_tpm_destroy(sec_handle);
+    }
+
+    TEST_FUNCTION(hsm_client_tpm_sign_batch_succeed)
+    {
+        unsigned char* digests;
+        size_t digest_len;
+        HSM_SIGN_REQUEST requests[2] = {
+            { TEST_BUFFER, TEST_BUFFER_SIZE, NULL, 0 },
+            { TEST_BUFFER, TEST_BUFFER_SIZE, NULL, 0 }
+        };
+
+        //arrange
+        const HSM_CLIENT_TPM_INTERFACE* tpm_if = hsm_client_tpm_device_interface();
+        HSM_CLIENT_HANDLE sec_handle = tpm_if->hsm_client_tpm_create();
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(gballoc_malloc(2 * 32));
+        STRICT_EXPECTED_CALL(SignData(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+            .SetReturn(32);
+        STRICT_EXPECTED_CALL(SignData(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+            .SetReturn(32);
+
+        //act
+        int result = tpm_if->hsm_client_sign_batch(sec_handle, requests, 2, &digests, &digest_len);
+
+        //assert
+        ASSERT_ARE_EQUAL(int, 0, result);
+        ASSERT_IS_NOT_NULL(digests);
+        ASSERT_ARE_EQUAL(size_t, 32, digest_len);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        my_gballoc_free(digests);
+        tpm_if->hsm_client_tpm_destroy(sec_handle);
+    }
+
+    TEST_FUNCTION(hsm_client_tpm_sign_batch_sign_fail_frees_digests)
+    {
+        unsigned char* digests;
+        size_t digest_len;
+        HSM_SIGN_REQUEST requests[2] = {
+            { TEST_BUFFER, TEST_BUFFER_SIZE, NULL, 0 },
+            { TEST_BUFFER, TEST_BUFFER_SIZE, NULL, 0 }
+        };
+
+        //arrange
+        const HSM_CLIENT_TPM_INTERFACE* tpm_if = hsm_client_tpm_device_interface();
+        HSM_CLIENT_HANDLE sec_handle = tpm_if->hsm_client_tpm_create();
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(gballoc_malloc(2 * 32));
+        STRICT_EXPECTED_CALL(SignData(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+            .SetReturn(32);
+        STRICT_EXPECTED_CALL(SignData(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+            .SetReturn(0);
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+        //act
+        int result = tpm_if->hsm_client_sign_batch(sec_handle, requests, 2, &digests, &digest_len);
+
+        //assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result);
+        ASSERT_IS_NULL(digests);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        tpm_if->hsm_client_tpm_destroy(sec_handle);
+    }
+
+    TEST_FUNCTION(hsm_client_tpm_derive_and_sign_batch_succeed)
+    {
+        unsigned char* digests;
+        size_t digest_len;
+        HSM_SIGN_REQUEST requests[2] = {
+            { TEST_BUFFER, TEST_BUFFER_SIZE, IDENTITY_BUFFER, IDENTITY_BUFFER_SIZE },
+            { TEST_BUFFER, TEST_BUFFER_SIZE, IDENTITY_BUFFER, IDENTITY_BUFFER_SIZE }
+        };
+
+        //arrange
+        const HSM_CLIENT_TPM_INTERFACE* tpm_if = hsm_client_tpm_device_interface();
+        HSM_CLIENT_HANDLE sec_handle = tpm_if->hsm_client_tpm_create();
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(gballoc_malloc(2 * 32));
+        STRICT_EXPECTED_CALL(SignData(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+        STRICT_EXPECTED_CALL(perform_sign_with_key_into(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(SignData(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+        STRICT_EXPECTED_CALL(perform_sign_with_key_into(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+        //act
+        int result = tpm_if->hsm_client_derive_and_sign_batch(sec_handle, requests, 2, &digests, &digest_len);
+
+        //assert
+        ASSERT_ARE_EQUAL(int, 0, result);
+        ASSERT_IS_NOT_NULL(digests);
+        ASSERT_ARE_EQUAL(size_t, 32, digest_len);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        my_gballoc_free(digests);
+        tpm_if->hsm_client_tpm_destroy(sec_handle);
+    }
+
     TEST_FUNCTION(hsm_client_tpm_free_buffer_null_does_nothing)
     {
         // arrange
@@ -1163,6 +1386,10 @@ BEGIN_TEST_SUITE(hsm_client_tpm_ut)
         ASSERT_IS_NOT_NULL(tpm_iface->hsm_client_sign_with_identity);
         ASSERT_IS_NOT_NULL(tpm_iface->hsm_client_derive_and_sign_with_identity);
         ASSERT_IS_NOT_NULL(tpm_iface->hsm_client_free_buffer);
+        ASSERT_IS_NOT_NULL(tpm_iface->hsm_client_sign_with_identity_into);
+        ASSERT_IS_NOT_NULL(tpm_iface->hsm_client_derive_and_sign_with_identity_into);
+        ASSERT_IS_NOT_NULL(tpm_iface->hsm_client_sign_batch);
+        ASSERT_IS_NOT_NULL(tpm_iface->hsm_client_derive_and_sign_batch);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
         //cleanup
@@ -0,0 +1,464 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "testrunnerswitcher.h"
+#include "azure_c_shared_utility/gballoc.h"
+
+//#############################################################################
+// Interface(s) under test
+//#############################################################################
+
+#include "hsm_hmac.h"
+#include "hsm_sha256.h"
+
+//#############################################################################
+// Test defines and data
+//#############################################################################
+
+// longest message hashed when comparing the kernels, covers every tail size
+// of the padding over several blocks
+#define TEST_MAX_MESSAGE_SIZE 300
+// more messages than the multi-buffer kernel hashes at once
+#define TEST_BATCH_SIZE ((2 * HSM_SHA256_LANES) + 3)
+// 1000000 bytes are 15625 blocks
+#define TEST_MILLION_A_CHUNK_BLOCKS 25
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+// FIPS 180-2 appendix B test vectors
+static const char TEST_ABC[] = "abc";
+static const unsigned char TEST_ABC_DIGEST[] = {
+    0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea, 0x41, 0x41, 0x40, 0xde, 0x5d, 0xae, 0x22, 0x23,
+    0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c, 0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad
+};
+static const unsigned char TEST_EMPTY_DIGEST[] = {
+    0xe3, 0xb0, 0xc4, 0x42, 0x98, 0xfc, 0x1c, 0x14, 0x9a, 0xfb, 0xf4, 0xc8, 0x99, 0x6f, 0xb9, 0x24,
+    0x27, 0xae, 0x41, 0xe4, 0x64, 0x9b, 0x93, 0x4c, 0xa4, 0x95, 0x99, 0x1b, 0x78, 0x52, 0xb8, 0x55
+};
+static const char TEST_TWO_BLOCK[] = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+static const unsigned char TEST_TWO_BLOCK_DIGEST[] = {
+    0x24, 0x8d, 0x6a, 0x61, 0xd2, 0x06, 0x38, 0xb8, 0xe5, 0xc0, 0x26, 0x93, 0x0c, 0x3e, 0x60, 0x39,
+    0xa3, 0x3c, 0xe4, 0x59, 0x64, 0xff, 0x21, 0x67, 0xf6, 0xec, 0xed, 0xd4, 0x19, 0xdb, 0x06, 0xc1
+};
+static const unsigned char TEST_MILLION_A_DIGEST[] = {
+    0xcd, 0xc7, 0x6e, 0x5c, 0x99, 0x14, 0xfb, 0x92, 0x81, 0xa1, 0xc7, 0xe2, 0x84, 0xd7, 0x3e, 0x67,
+    0xf1, 0x80, 0x9a, 0x48, 0xa4, 0x97, 0x20, 0x0e, 0x04, 0x6d, 0x39, 0xcc, 0xc7, 0x11, 0x2c, 0xd0
+};
+
+// RFC 4231 HMAC-SHA256 test cases 1, 2 and 6
+static const char TEST_HMAC_DATA_1[] = "Hi There";
+static const unsigned char TEST_HMAC_DIGEST_1[] = {
+    0xb0, 0x34, 0x4c, 0x61, 0xd8, 0xdb, 0x38, 0x53, 0x5c, 0xa8, 0xaf, 0xce, 0xaf, 0x0b, 0xf1, 0x2b,
+    0x88, 0x1d, 0xc2, 0x00, 0xc9, 0x83, 0x3d, 0xa7, 0x26, 0xe9, 0x37, 0x6c, 0x2e, 0x32, 0xcf, 0xf7
+};
+static const char TEST_HMAC_KEY_2[] = "Jefe";
+static const char TEST_HMAC_DATA_2[] = "what do ya want for nothing?";
+static const unsigned char TEST_HMAC_DIGEST_2[] = {
+    0x5b, 0xdc, 0xc1, 0x46, 0xbf, 0x60, 0x75, 0x4e, 0x6a, 0x04, 0x24, 0x26, 0x08, 0x95, 0x75, 0xc7,
+    0x5a, 0x00, 0x3f, 0x08, 0x9d, 0x27, 0x39, 0x83, 0x9d, 0xec, 0x58, 0xb9, 0x64, 0xec, 0x38, 0x43
+};
+static const char TEST_HMAC_DATA_6[] = "Test Using Larger Than Block-Size Key - Hash Key First";
+static const unsigned char TEST_HMAC_DIGEST_6[] = {
+    0x60, 0xe4, 0x31, 0x59, 0x1e, 0xe0, 0xb6, 0x7f, 0x0d, 0x8a, 0x26, 0xaa, 0xcb, 0xf5, 0xb7, 0x7f,
+    0x8e, 0x0b, 0xc6, 0x21, 0x37, 0x28, 0xc5, 0x14, 0x05, 0x46, 0x04, 0x0f, 0x0e, 0xe3, 0x7f, 0x54
+};
+
+//#############################################################################
+// Test helpers
+//#############################################################################
+
+static void test_helper_fill_message(unsigned char *message, size_t size)
+{
+    size_t index;
+
+    for (index = 0; index < size; index++)
+    {
+        message[index] = (unsigned char)((index * 37) + 11);
+    }
+}
+
+// every backend this build and CPU can run, the scalar backend first
+static size_t test_helper_get_backends(const HSM_SHA256_BACKEND *backends[4])
+{
+    size_t count = 0;
+
+    backends[count++] = hsm_sha256_scalar_backend();
+    if (hsm_sha256_shani_backend() != NULL)
+    {
+        backends[count++] = hsm_sha256_shani_backend();
+    }
+    if (hsm_sha256_avx2_backend() != NULL)
+    {
+        backends[count++] = hsm_sha256_avx2_backend();
+    }
+    if (hsm_sha256_armv8_backend() != NULL)
+    {
+        backends[count++] = hsm_sha256_armv8_backend();
+    }
+    printf("Testing %zu SHA-256 backends\n", count);
+
+    return count;
+}
+
+static void test_helper_hash_batch
+(
+    const unsigned char *message,
+    const size_t *sizes,
+    size_t count,
+    unsigned char *digests
+)
+{
+    HSM_SHA256_MESSAGE messages[TEST_BATCH_SIZE];
+    size_t index;
+
+    for (index = 0; index < count; index++)
+    {
+        messages[index].state = NULL;
+        messages[index].prefix_size = 0;
+        messages[index].data = message + index;
+        messages[index].data_size = sizes[index];
+        messages[index].digest = digests + (index * HSM_SHA256_DIGEST_SIZE);
+    }
+    hsm_sha256_finish(messages, count);
+}
+
+//#############################################################################
+// Test cases
+//#############################################################################
+
+BEGIN_TEST_SUITE(hsm_sha256_int_tests)
+
+        TEST_SUITE_INITIALIZE(TestClassInitialize)
+        {
+            TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+            g_testByTest = TEST_MUTEX_CREATE();
+            ASSERT_IS_NOT_NULL(g_testByTest);
+        }
+
+        TEST_SUITE_CLEANUP(TestClassCleanup)
+        {
+            TEST_MUTEX_DESTROY(g_testByTest);
+            TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+        }
+
+        TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+        {
+            if (TEST_MUTEX_ACQUIRE(g_testByTest))
+            {
+                ASSERT_FAIL("Mutex is ABANDONED. Failure in test framework.");
+            }
+        }
+
+        TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+        {
+            hsm_sha256_use_backend(NULL);
+            TEST_MUTEX_RELEASE(g_testByTest);
+        }
+
+        TEST_FUNCTION(hsm_sha256_digest_known_answers_success)
+        {
+            // arrange
+            const HSM_SHA256_BACKEND *backends[4];
+            size_t backend_count = test_helper_get_backends(backends);
+            size_t index;
+
+            for (index = 0; index < backend_count; index++)
+            {
+                unsigned char digest[HSM_SHA256_DIGEST_SIZE];
+                hsm_sha256_use_backend(backends[index]);
+                printf("Backend %s\n", backends[index]->name);
+
+                // act, assert
+                hsm_sha256_digest((const unsigned char*)TEST_ABC, strlen(TEST_ABC), digest);
+                ASSERT_ARE_EQUAL_WITH_MSG(int, 0, memcmp(TEST_ABC_DIGEST, digest, sizeof(digest)), "Line:" TOSTRING(__LINE__));
+                hsm_sha256_digest((const unsigned char*)TEST_ABC, 0, digest);
+                ASSERT_ARE_EQUAL_WITH_MSG(int, 0, memcmp(TEST_EMPTY_DIGEST, digest, sizeof(digest)), "Line:" TOSTRING(__LINE__));
+                hsm_sha256_digest((const unsigned char*)TEST_TWO_BLOCK, strlen(TEST_TWO_BLOCK), digest);
+                ASSERT_ARE_EQUAL_WITH_MSG(int, 0, memcmp(TEST_TWO_BLOCK_DIGEST, digest, sizeof(digest)), "Line:" TOSTRING(__LINE__));
+            }
+
+            // cleanup
+        }
+
+        TEST_FUNCTION(hsm_sha256_compress_million_a_success)
+        {
+            // arrange
+            unsigned char chunk[TEST_MILLION_A_CHUNK_BLOCKS * HSM_SHA256_BLOCK_SIZE];
+            unsigned char digest[HSM_SHA256_DIGEST_SIZE];
+            HSM_SHA256_STATE state;
+            HSM_SHA256_MESSAGE message;
+            size_t index;
+            memset(chunk, 'a', sizeof(chunk));
+
+            // act, the message is a whole number of blocks so only padding is left
+            hsm_sha256_init_state(&state);
+            for (index = 0; index < (1000000 / sizeof(chunk)); index++)
+            {
+                hsm_sha256_compress(&state, chunk, TEST_MILLION_A_CHUNK_BLOCKS);
+            }
+            message.state = &state;
+            message.prefix_size = 1000000;
+            message.data = chunk;
+            message.data_size = 0;
+            message.digest = digest;
+            hsm_sha256_finish(&message, 1);
+
+            // assert
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, memcmp(TEST_MILLION_A_DIGEST, digest, sizeof(digest)), "Line:" TOSTRING(__LINE__));
+
+            // cleanup
+        }
+
+        TEST_FUNCTION(hsm_sha256_backends_match_scalar_success)
+        {
+            // arrange
+            const HSM_SHA256_BACKEND *backends[4];
+            size_t backend_count = test_helper_get_backends(backends);
+            unsigned char message[TEST_MAX_MESSAGE_SIZE];
+            size_t size;
+            test_helper_fill_message(message, sizeof(message));
+
+            for (size = 0; size <= TEST_MAX_MESSAGE_SIZE; size++)
+            {
+                unsigned char expected[HSM_SHA256_DIGEST_SIZE];
+                size_t index;
+
+                hsm_sha256_use_backend(hsm_sha256_scalar_backend());
+                hsm_sha256_digest(message, size, expected);
+
+                for (index = 1; index < backend_count; index++)
+                {
+                    unsigned char digest[HSM_SHA256_DIGEST_SIZE];
+
+                    // act
+                    hsm_sha256_use_backend(backends[index]);
+                    hsm_sha256_digest(message, size, digest);
+
+                    // assert
+                    ASSERT_ARE_EQUAL_WITH_MSG(int, 0, memcmp(expected, digest, sizeof(digest)), "Line:" TOSTRING(__LINE__));
+                }
+            }
+
+            // cleanup
+        }
+
+        TEST_FUNCTION(hsm_sha256_finish_batch_matches_single_success)
+        {
+            // arrange
+            const HSM_SHA256_BACKEND *backends[4];
+            size_t backend_count = test_helper_get_backends(backends);
+            unsigned char message[TEST_MAX_MESSAGE_SIZE + TEST_BATCH_SIZE];
+            size_t sizes[TEST_BATCH_SIZE];
+            unsigned char expected[TEST_BATCH_SIZE * HSM_SHA256_DIGEST_SIZE];
+            size_t index, count;
+            test_helper_fill_message(message, sizeof(message));
+
+            // lanes of a group finish after different numbers of blocks
+            for (index = 0; index < TEST_BATCH_SIZE; index++)
+            {
+                sizes[index] = ((index * 53) + 7) % TEST_MAX_MESSAGE_SIZE;
+            }
+            hsm_sha256_use_backend(hsm_sha256_scalar_backend());
+            for (index = 0; index < TEST_BATCH_SIZE; index++)
+            {
+                hsm_sha256_digest(message + index, sizes[index], expected + (index * HSM_SHA256_DIGEST_SIZE));
+            }
+
+            for (index = 0; index < backend_count; index++)
+            {
+                hsm_sha256_use_backend(backends[index]);
+                for (count = 1; count <= TEST_BATCH_SIZE; count++)
+                {
+                    unsigned char digests[TEST_BATCH_SIZE * HSM_SHA256_DIGEST_SIZE];
+
+                    // act
+                    test_helper_hash_batch(message, sizes, count, digests);
+
+                    // assert
+                    ASSERT_ARE_EQUAL_WITH_MSG(int, 0, memcmp(expected, digests, count * HSM_SHA256_DIGEST_SIZE), "Line:" TOSTRING(__LINE__));
+                }
+            }
+
+            // cleanup
+        }
+
+        TEST_FUNCTION(hsm_hmac_sign_known_answers_success)
+        {
+            // arrange
+            const HSM_SHA256_BACKEND *backends[4];
+            size_t backend_count = test_helper_get_backends(backends);
+            unsigned char key_1[20], key_6[131];
+            size_t index;
+            memset(key_1, 0x0b, sizeof(key_1));
+            memset(key_6, 0xaa, sizeof(key_6));
+
+            for (index = 0; index < backend_count; index++)
+            {
+                HSM_HMAC_KEY hmac_key;
+                unsigned char digest[HSM_HMAC_DIGEST_SIZE];
+                hsm_sha256_use_backend(backends[index]);
+
+                // act, assert
+                ASSERT_ARE_EQUAL_WITH_MSG(int, 0, hsm_hmac_key_init(&hmac_key, key_1, sizeof(key_1)), "Line:" TOSTRING(__LINE__));
+                ASSERT_ARE_EQUAL_WITH_MSG(int, 0, hsm_hmac_sign(&hmac_key, (const unsigned char*)TEST_HMAC_DATA_1, strlen(TEST_HMAC_DATA_1), digest), "Line:" TOSTRING(__LINE__));
+                ASSERT_ARE_EQUAL_WITH_MSG(int, 0, memcmp(TEST_HMAC_DIGEST_1, digest, sizeof(digest)), "Line:" TOSTRING(__LINE__));
+
+                ASSERT_ARE_EQUAL_WITH_MSG(int, 0, hsm_hmac_key_init(&hmac_key, (const unsigned char*)TEST_HMAC_KEY_2, strlen(TEST_HMAC_KEY_2)), "Line:" TOSTRING(__LINE__));
+                ASSERT_ARE_EQUAL_WITH_MSG(int, 0, hsm_hmac_sign(&hmac_key, (const unsigned char*)TEST_HMAC_DATA_2, strlen(TEST_HMAC_DATA_2), digest), "Line:" TOSTRING(__LINE__));
+                ASSERT_ARE_EQUAL_WITH_MSG(int, 0, memcmp(TEST_HMAC_DIGEST_2, digest, sizeof(digest)), "Line:" TOSTRING(__LINE__));
+
+                ASSERT_ARE_EQUAL_WITH_MSG(int, 0, hsm_hmac_key_init(&hmac_key, key_6, sizeof(key_6)), "Line:" TOSTRING(__LINE__));
+                ASSERT_ARE_EQUAL_WITH_MSG(int, 0, hsm_hmac_sign(&hmac_key, (const unsigned char*)TEST_HMAC_DATA_6, strlen(TEST_HMAC_DATA_6), digest), "Line:" TOSTRING(__LINE__));
+                ASSERT_ARE_EQUAL_WITH_MSG(int, 0, memcmp(TEST_HMAC_DIGEST_6, digest, sizeof(digest)), "Line:" TOSTRING(__LINE__));
+                hsm_hmac_key_clear(&hmac_key);
+            }
+
+            // cleanup
+        }
+
+        TEST_FUNCTION(hsm_hmac_sign_batch_matches_single_success)
+        {
+            // arrange
+            const HSM_SHA256_BACKEND *backends[4];
+            size_t backend_count = test_helper_get_backends(backends);
+            unsigned char message[TEST_MAX_MESSAGE_SIZE + TEST_BATCH_SIZE];
+            HSM_HMAC_KEY hmac_keys[2];
+            HSM_HMAC_REQUEST requests[TEST_BATCH_SIZE];
+            unsigned char expected[TEST_BATCH_SIZE * HSM_HMAC_DIGEST_SIZE];
+            size_t index, backend;
+            test_helper_fill_message(message, sizeof(message));
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, hsm_hmac_key_init(&hmac_keys[0], message, 16), "Line:" TOSTRING(__LINE__));
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, hsm_hmac_key_init(&hmac_keys[1], message + 16, 100), "Line:" TOSTRING(__LINE__));
+
+            // the requests alternate between the keys
+            hsm_sha256_use_backend(hsm_sha256_scalar_backend());
+            for (index = 0; index < TEST_BATCH_SIZE; index++)
+            {
+                requests[index].key = &hmac_keys[index % 2];
+                requests[index].data = message + index;
+                requests[index].data_size = ((index * 41) + 1) % TEST_MAX_MESSAGE_SIZE;
+                requests[index].digest = expected + (index * HSM_HMAC_DIGEST_SIZE);
+                ASSERT_ARE_EQUAL_WITH_MSG(int, 0, hsm_hmac_sign(requests[index].key, requests[index].data, requests[index].data_size, requests[index].digest), "Line:" TOSTRING(__LINE__));
+            }
+
+            for (backend = 0; backend < backend_count; backend++)
+            {
+                unsigned char digests[TEST_BATCH_SIZE * HSM_HMAC_DIGEST_SIZE];
+                hsm_sha256_use_backend(backends[backend]);
+                for (index = 0; index < TEST_BATCH_SIZE; index++)
+                {
+                    requests[index].digest = digests + (index * HSM_HMAC_DIGEST_SIZE);
+                }
+
+                // act
+                int status = hsm_hmac_sign_batch(requests, TEST_BATCH_SIZE);
+
+                // assert
+                ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+                ASSERT_ARE_EQUAL_WITH_MSG(int, 0, memcmp(expected, digests, sizeof(digests)), "Line:" TOSTRING(__LINE__));
+            }
+
+            // cleanup
+            hsm_hmac_key_clear(&hmac_keys[0]);
+            hsm_hmac_key_clear(&hmac_keys[1]);
+        }
+
+        TEST_FUNCTION(hsm_hmac_sign_batch_invalid_params_fails)
+        {
+            // arrange
+            HSM_HMAC_KEY hmac_key;
+            HSM_HMAC_REQUEST request;
+            unsigned char digest[HSM_HMAC_DIGEST_SIZE];
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, hsm_hmac_key_init(&hmac_key, (const unsigned char*)TEST_HMAC_KEY_2, strlen(TEST_HMAC_KEY_2)), "Line:" TOSTRING(__LINE__));
+            request.key = &hmac_key;
+            request.data = (const unsigned char*)TEST_HMAC_DATA_2;
+            request.data_size = strlen(TEST_HMAC_DATA_2);
+            request.digest = NULL;
+
+            // act, assert
+            ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, hsm_hmac_sign_batch(NULL, 1), "Line:" TOSTRING(__LINE__));
+            ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, hsm_hmac_sign_batch(&request, 0), "Line:" TOSTRING(__LINE__));
+            ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, hsm_hmac_sign_batch(&request, 1), "Line:" TOSTRING(__LINE__));
+            request.digest = digest;
+            request.key = NULL;
+            ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, hsm_hmac_sign_batch(&request, 1), "Line:" TOSTRING(__LINE__));
+
+            // cleanup
+            hsm_hmac_key_clear(&hmac_key);
+        }
+
+        TEST_FUNCTION(hsm_hmac_openssl_sign_known_answers_success)
+        {
+            // arrange
+            unsigned char key_1[20], key_6[131];
+            unsigned char digest[HSM_HMAC_DIGEST_SIZE];
+            memset(key_1, 0x0b, sizeof(key_1));
+            memset(key_6, 0xaa, sizeof(key_6));
+
+            // act, assert
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, hsm_hmac_openssl_sign(key_1, sizeof(key_1), (const unsigned char*)TEST_HMAC_DATA_1, strlen(TEST_HMAC_DATA_1), digest), "Line:" TOSTRING(__LINE__));
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, memcmp(TEST_HMAC_DIGEST_1, digest, sizeof(digest)), "Line:" TOSTRING(__LINE__));
+
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, hsm_hmac_openssl_sign((const unsigned char*)TEST_HMAC_KEY_2, strlen(TEST_HMAC_KEY_2), (const unsigned char*)TEST_HMAC_DATA_2, strlen(TEST_HMAC_DATA_2), digest), "Line:" TOSTRING(__LINE__));
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, memcmp(TEST_HMAC_DIGEST_2, digest, sizeof(digest)), "Line:" TOSTRING(__LINE__));
+
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, hsm_hmac_openssl_sign(key_6, sizeof(key_6), (const unsigned char*)TEST_HMAC_DATA_6, strlen(TEST_HMAC_DATA_6), digest), "Line:" TOSTRING(__LINE__));
+            ASSERT_ARE_EQUAL_WITH_MSG(int, 0, memcmp(TEST_HMAC_DIGEST_6, digest, sizeof(digest)), "Line:" TOSTRING(__LINE__));
+
+            // cleanup
+        }
+
+        TEST_FUNCTION(hsm_hmac_openssl_sign_matches_builtin_success)
+        {
+            // arrange
+            unsigned char message[TEST_MAX_MESSAGE_SIZE + TEST_BATCH_SIZE];
+            size_t index;
+            test_helper_fill_message(message, sizeof(message));
+            hsm_sha256_use_backend(NULL);
+
+            // consecutive signatures on this thread's context use a different
+            // key each time, short and longer than a block
+            for (index = 0; index < TEST_MAX_MESSAGE_SIZE; index += 7)
+            {
+                HSM_HMAC_KEY hmac_key;
+                unsigned char expected[HSM_HMAC_DIGEST_SIZE], digest[HSM_HMAC_DIGEST_SIZE];
+                const unsigned char *key = message + (index % TEST_BATCH_SIZE);
+                size_t key_size = ((index * 13) % 100) + 1;
+                ASSERT_ARE_EQUAL_WITH_MSG(int, 0, hsm_hmac_key_init(&hmac_key, key, key_size), "Line:" TOSTRING(__LINE__));
+                ASSERT_ARE_EQUAL_WITH_MSG(int, 0, hsm_hmac_sign(&hmac_key, message, index, expected), "Line:" TOSTRING(__LINE__));
+                hsm_hmac_key_clear(&hmac_key);
+
+                // act
+                int status = hsm_hmac_openssl_sign(key, key_size, message, index, digest);
+
+                // assert
+                ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+                ASSERT_ARE_EQUAL_WITH_MSG(int, 0, memcmp(expected, digest, sizeof(digest)), "Line:" TOSTRING(__LINE__));
+            }
+
+            // cleanup
+        }
+
+        TEST_FUNCTION(hsm_hmac_openssl_sign_invalid_params_fails)
+        {
+            // arrange
+            const unsigned char *key = (const unsigned char*)TEST_HMAC_KEY_2;
+            const unsigned char *data = (const unsigned char*)TEST_HMAC_DATA_2;
+            unsigned char digest[HSM_HMAC_DIGEST_SIZE];
+
+            // act, assert
+            ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, hsm_hmac_openssl_sign(NULL, 4, data, 4, digest), "Line:" TOSTRING(__LINE__));
+            ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, hsm_hmac_openssl_sign(key, 0, data, 4, digest), "Line:" TOSTRING(__LINE__));
+            ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, hsm_hmac_openssl_sign(key, 4, NULL, 4, digest), "Line:" TOSTRING(__LINE__));
+            ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, hsm_hmac_openssl_sign(key, 4, data, 4, NULL), "Line:" TOSTRING(__LINE__));
+
+            // cleanup
+        }
+
+END_TEST_SUITE(hsm_sha256_int_tests)
@@ -0,0 +1,390 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "testrunnerswitcher.h"
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/strings.h"
+
+//#############################################################################
+// Interface(s) under test
+//#############################################################################
+
+#include "hsm_constants.h"
+#include "hsm_sign_cache.h"
+
+//#############################################################################
+// Test defines and data
+//#############################################################################
+
+#define TEST_DIGEST_SIZE 32
+#define TEST_NOW 1500000000
+#define TEST_TTL 60
+// a single set, every payload competes for the same entries
+#define TEST_SMALL_CACHE_SIZE 4
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+static time_t g_test_now = TEST_NOW;
+
+static const unsigned char TEST_IDENTITY[] = {'m', 'o', 'd', '1'};
+static const unsigned char TEST_OTHER_IDENTITY[] = {'m', 'o', 'd', '2'};
+static const char TEST_PAYLOAD[] = "some/resource/uri\n1500000030";
+static const char TEST_PAYLOAD_NO_EXPIRY[] = "some data to sign";
+static const char TEST_EXPIRED_PAYLOAD[] = "some/resource/uri\n1499999999";
+
+//#############################################################################
+// Test helpers
+//#############################################################################
+
+static time_t test_clock(void)
+{
+    return g_test_now;
+}
+
+static void test_helper_fill_digest(unsigned char *digest, unsigned char seed)
+{
+    size_t index;
+
+    for (index = 0; index < TEST_DIGEST_SIZE; index++)
+    {
+        digest[index] = (unsigned char)(seed + index);
+    }
+}
+
+static void test_helper_insert
+(
+    HSM_SIGN_CACHE_HANDLE cache,
+    const unsigned char *identity,
+    size_t identity_size,
+    const char *payload,
+    unsigned char seed
+)
+{
+    unsigned char digest[TEST_DIGEST_SIZE];
+
+    test_helper_fill_digest(digest, seed);
+    hsm_sign_cache_insert(cache, hsm_sign_cache_get_generation(cache), identity, identity_size,
+                          (const unsigned char*)payload, strlen(payload), digest, sizeof(digest));
+}
+
+static bool test_helper_lookup
+(
+    HSM_SIGN_CACHE_HANDLE cache,
+    const unsigned char *identity,
+    size_t identity_size,
+    const char *payload,
+    unsigned char expected_seed
+)
+{
+    unsigned char digest[HSM_SIGN_CACHE_MAX_DIGEST_SIZE];
+    unsigned char expected_digest[TEST_DIGEST_SIZE];
+    size_t digest_size = sizeof(digest);
+    bool result;
+
+    result = hsm_sign_cache_lookup(cache, identity, identity_size,
+                                   (const unsigned char*)payload, strlen(payload),
+                                   digest, &digest_size);
+    if (result)
+    {
+        test_helper_fill_digest(expected_digest, expected_seed);
+        ASSERT_ARE_EQUAL_WITH_MSG(size_t, TEST_DIGEST_SIZE, digest_size, "Line:" TOSTRING(__LINE__));
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, memcmp(expected_digest, digest, TEST_DIGEST_SIZE), "Line:" TOSTRING(__LINE__));
+    }
+
+    return result;
+}
+
+static void test_helper_setenv(const char *key, const char *value)
+{
+    #if defined __WINDOWS__ || defined _WIN32 || defined _WIN64 || defined _Windows
+        errno_t status = _putenv_s(key, value);
+    #else
+        int status = setenv(key, value, 1);
+    #endif
+    ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+}
+
+static void test_helper_unsetenv(const char *key)
+{
+    #if defined __WINDOWS__ || defined _WIN32 || defined _WIN64 || defined _Windows
+        STRING_HANDLE key_handle = STRING_construct(key);
+        ASSERT_IS_NOT_NULL_WITH_MSG(key_handle, "Line:" TOSTRING(__LINE__));
+        int ret_val = STRING_concat(key_handle, "=");
+        ASSERT_ARE_EQUAL_WITH_MSG(int, 0, ret_val, "Line:" TOSTRING(__LINE__));
+        errno_t status = _putenv(STRING_c_str(key_handle));
+        STRING_delete(key_handle);
+    #else
+        int status = unsetenv(key);
+    #endif
+    ASSERT_ARE_EQUAL_WITH_MSG(int, 0, status, "Line:" TOSTRING(__LINE__));
+}
+
+//#############################################################################
+// Test cases
+//#############################################################################
+
+BEGIN_TEST_SUITE(hsm_sign_cache_int_tests)
+
+        TEST_SUITE_INITIALIZE(TestClassInitialize)
+        {
+            TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+            g_testByTest = TEST_MUTEX_CREATE();
+            ASSERT_IS_NOT_NULL(g_testByTest);
+        }
+
+        TEST_SUITE_CLEANUP(TestClassCleanup)
+        {
+            TEST_MUTEX_DESTROY(g_testByTest);
+            TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+        }
+
+        TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+        {
+            if (TEST_MUTEX_ACQUIRE(g_testByTest))
+            {
+                ASSERT_FAIL("Mutex is ABANDONED. Failure in test framework.");
+            }
+            g_test_now = TEST_NOW;
+        }
+
+        TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+        {
+            test_helper_unsetenv(ENV_HSM_SIGN_CACHE_SIZE);
+            test_helper_unsetenv(ENV_HSM_SIGN_CACHE_TTL);
+            TEST_MUTEX_RELEASE(g_testByTest);
+        }
+
+        TEST_FUNCTION(hsm_sign_cache_create_invalid_params_fails)
+        {
+            // act, assert
+            ASSERT_IS_NULL(hsm_sign_cache_create(0, TEST_TTL, NULL));
+            ASSERT_IS_NULL(hsm_sign_cache_create(HSM_SIGN_CACHE_MAX_SIZE + 1, TEST_TTL, NULL));
+            ASSERT_IS_NULL(hsm_sign_cache_create(TEST_SMALL_CACHE_SIZE, 0, NULL));
+            ASSERT_IS_NULL(hsm_sign_cache_create(TEST_SMALL_CACHE_SIZE, HSM_SIGN_CACHE_MAX_TTL + 1, NULL));
+        }
+
+        TEST_FUNCTION(hsm_sign_cache_lookup_returns_inserted_signature_success)
+        {
+            // arrange
+            HSM_SIGN_CACHE_HANDLE cache = hsm_sign_cache_create(TEST_SMALL_CACHE_SIZE, TEST_TTL, test_clock);
+            ASSERT_IS_NOT_NULL(cache);
+            HSM_SIGN_CACHE_METRICS metrics;
+
+            // act
+            bool miss = test_helper_lookup(cache, NULL, 0, TEST_PAYLOAD, 1);
+            test_helper_insert(cache, NULL, 0, TEST_PAYLOAD, 1);
+            test_helper_insert(cache, TEST_IDENTITY, sizeof(TEST_IDENTITY), TEST_PAYLOAD, 2);
+            bool hit = test_helper_lookup(cache, NULL, 0, TEST_PAYLOAD, 1);
+            bool derived_hit = test_helper_lookup(cache, TEST_IDENTITY, sizeof(TEST_IDENTITY), TEST_PAYLOAD, 2);
+            bool other_identity_hit = test_helper_lookup(cache, TEST_OTHER_IDENTITY, sizeof(TEST_OTHER_IDENTITY), TEST_PAYLOAD, 2);
+            hsm_sign_cache_get_metrics(cache, &metrics);
+
+            // assert
+            ASSERT_IS_FALSE(miss);
+            ASSERT_IS_TRUE(hit);
+            ASSERT_IS_TRUE(derived_hit);
+            ASSERT_IS_FALSE(other_identity_hit);
+            ASSERT_ARE_EQUAL(int, 2, (int)metrics.hits);
+            ASSERT_ARE_EQUAL(int, 2, (int)metrics.misses);
+
+            // cleanup
+            hsm_sign_cache_destroy(cache);
+        }
+
+        TEST_FUNCTION(hsm_sign_cache_entry_expires_with_payload_success)
+        {
+            // arrange
+            HSM_SIGN_CACHE_HANDLE cache = hsm_sign_cache_create(TEST_SMALL_CACHE_SIZE, TEST_TTL, test_clock);
+            ASSERT_IS_NOT_NULL(cache);
+            test_helper_insert(cache, NULL, 0, TEST_PAYLOAD, 1);
+
+            // act
+            g_test_now = TEST_NOW + 29;
+            bool hit_before_expiry = test_helper_lookup(cache, NULL, 0, TEST_PAYLOAD, 1);
+            g_test_now = TEST_NOW + 30;
+            bool hit_at_expiry = test_helper_lookup(cache, NULL, 0, TEST_PAYLOAD, 1);
+
+            // assert
+            ASSERT_IS_TRUE(hit_before_expiry);
+            ASSERT_IS_FALSE(hit_at_expiry);
+
+            // cleanup
+            hsm_sign_cache_destroy(cache);
+        }
+
+        TEST_FUNCTION(hsm_sign_cache_entry_expires_with_ttl_success)
+        {
+            // arrange
+            HSM_SIGN_CACHE_HANDLE cache = hsm_sign_cache_create(TEST_SMALL_CACHE_SIZE, TEST_TTL, test_clock);
+            ASSERT_IS_NOT_NULL(cache);
+            test_helper_insert(cache, NULL, 0, TEST_PAYLOAD_NO_EXPIRY, 1);
+
+            // act
+            g_test_now = TEST_NOW + TEST_TTL - 1;
+            bool hit_before_expiry = test_helper_lookup(cache, NULL, 0, TEST_PAYLOAD_NO_EXPIRY, 1);
+            g_test_now = TEST_NOW + TEST_TTL;
+            bool hit_at_expiry = test_helper_lookup(cache, NULL, 0, TEST_PAYLOAD_NO_EXPIRY, 1);
+
+            // assert
+            ASSERT_IS_TRUE(hit_before_expiry);
+            ASSERT_IS_FALSE(hit_at_expiry);
+
+            // cleanup
+            hsm_sign_cache_destroy(cache);
+        }
+
+        TEST_FUNCTION(hsm_sign_cache_expired_payload_not_cached_success)
+        {
+            // arrange
+            HSM_SIGN_CACHE_HANDLE cache = hsm_sign_cache_create(TEST_SMALL_CACHE_SIZE, TEST_TTL, test_clock);
+            ASSERT_IS_NOT_NULL(cache);
+
+            // act
+            test_helper_insert(cache, NULL, 0, TEST_EXPIRED_PAYLOAD, 1);
+            bool hit = test_helper_lookup(cache, NULL, 0, TEST_EXPIRED_PAYLOAD, 1);
+
+            // assert
+            ASSERT_IS_FALSE(hit);
+
+            // cleanup
+            hsm_sign_cache_destroy(cache);
+        }
+
+        TEST_FUNCTION(hsm_sign_cache_evicts_least_recently_used_success)
+        {
+            // arrange
+            HSM_SIGN_CACHE_HANDLE cache = hsm_sign_cache_create(TEST_SMALL_CACHE_SIZE, TEST_TTL, test_clock);
+            ASSERT_IS_NOT_NULL(cache);
+            char payloads[TEST_SMALL_CACHE_SIZE + 1][32];
+            size_t index;
+            for (index = 0; index < TEST_SMALL_CACHE_SIZE + 1; index++)
+            {
+                (void)snprintf(payloads[index], sizeof(payloads[index]), "payload %d", (int)index);
+            }
+            for (index = 0; index < TEST_SMALL_CACHE_SIZE; index++)
+            {
+                test_helper_insert(cache, NULL, 0, payloads[index], (unsigned char)index);
+            }
+
+            // act
+            // touching the oldest entry leaves the second one least recently used
+            bool first_hit = test_helper_lookup(cache, NULL, 0, payloads[0], 0);
+            test_helper_insert(cache, NULL, 0, payloads[TEST_SMALL_CACHE_SIZE], TEST_SMALL_CACHE_SIZE);
+
+            // assert
+            ASSERT_IS_TRUE(first_hit);
+            ASSERT_IS_TRUE(test_helper_lookup(cache, NULL, 0, payloads[0], 0));
+            ASSERT_IS_FALSE(test_helper_lookup(cache, NULL, 0, payloads[1], 1));
+            for (index = 2; index < TEST_SMALL_CACHE_SIZE + 1; index++)
+            {
+                ASSERT_IS_TRUE(test_helper_lookup(cache, NULL, 0, payloads[index], (unsigned char)index));
+            }
+
+            // cleanup
+            hsm_sign_cache_destroy(cache);
+        }
+
+        TEST_FUNCTION(hsm_sign_cache_clear_drops_entries_and_stale_inserts_success)
+        {
+            // arrange
+            HSM_SIGN_CACHE_HANDLE cache = hsm_sign_cache_create(TEST_SMALL_CACHE_SIZE, TEST_TTL, test_clock);
+            ASSERT_IS_NOT_NULL(cache);
+            unsigned char digest[TEST_DIGEST_SIZE];
+            test_helper_fill_digest(digest, 1);
+            test_helper_insert(cache, NULL, 0, TEST_PAYLOAD, 1);
+            uint64_t generation = hsm_sign_cache_get_generation(cache);
+
+            // act
+            hsm_sign_cache_clear(cache);
+            bool hit_after_clear = test_helper_lookup(cache, NULL, 0, TEST_PAYLOAD, 1);
+            // a signature computed before the clear must not be cached
+            hsm_sign_cache_insert(cache, generation, NULL, 0, (const unsigned char*)TEST_PAYLOAD,
+                                  strlen(TEST_PAYLOAD), digest, sizeof(digest));
+            bool hit_after_stale_insert = test_helper_lookup(cache, NULL, 0, TEST_PAYLOAD, 1);
+
+            // assert
+            ASSERT_ARE_NOT_EQUAL(int, (int)generation, (int)hsm_sign_cache_get_generation(cache));
+            ASSERT_IS_FALSE(hit_after_clear);
+            ASSERT_IS_FALSE(hit_after_stale_insert);
+
+            // cleanup
+            hsm_sign_cache_destroy(cache);
+        }
+
+        TEST_FUNCTION(hsm_sign_cache_lookup_small_buffer_misses)
+        {
+            // arrange
+            HSM_SIGN_CACHE_HANDLE cache = hsm_sign_cache_create(TEST_SMALL_CACHE_SIZE, TEST_TTL, test_clock);
+            ASSERT_IS_NOT_NULL(cache);
+            unsigned char digest[TEST_DIGEST_SIZE - 1];
+            size_t digest_size = sizeof(digest);
+            test_helper_insert(cache, NULL, 0, TEST_PAYLOAD, 1);
+
+            // act
+            bool hit = hsm_sign_cache_lookup(cache, NULL, 0, (const unsigned char*)TEST_PAYLOAD,
+                                             strlen(TEST_PAYLOAD), digest, &digest_size);
+
+            // assert
+            ASSERT_IS_FALSE(hit);
+            ASSERT_ARE_EQUAL(size_t, sizeof(digest), digest_size);
+
+            // cleanup
+            hsm_sign_cache_destroy(cache);
+        }
+
+        TEST_FUNCTION(hsm_sign_cache_lookup_invalid_params_misses)
+        {
+            // arrange
+            HSM_SIGN_CACHE_HANDLE cache = hsm_sign_cache_create(TEST_SMALL_CACHE_SIZE, TEST_TTL, test_clock);
+            ASSERT_IS_NOT_NULL(cache);
+            unsigned char digest[TEST_DIGEST_SIZE];
+            size_t digest_size = sizeof(digest);
+            const unsigned char *data = (const unsigned char*)TEST_PAYLOAD;
+            size_t data_size = strlen(TEST_PAYLOAD);
+            test_helper_insert(cache, NULL, 0, TEST_PAYLOAD, 1);
+
+            // act, assert
+            ASSERT_IS_FALSE(hsm_sign_cache_lookup(NULL, NULL, 0, data, data_size, digest, &digest_size));
+            ASSERT_IS_FALSE(hsm_sign_cache_lookup(cache, NULL, 0, NULL, data_size, digest, &digest_size));
+            ASSERT_IS_FALSE(hsm_sign_cache_lookup(cache, NULL, 0, data, data_size, NULL, &digest_size));
+            ASSERT_IS_FALSE(hsm_sign_cache_lookup(cache, NULL, 0, data, data_size, digest, NULL));
+
+            // cleanup
+            hsm_sign_cache_destroy(cache);
+        }
+
+        TEST_FUNCTION(hsm_sign_cache_create_from_env_success)
+        {
+            // arrange
+            HSM_SIGN_CACHE_HANDLE disabled_cache, invalid_cache, cache;
+            test_helper_unsetenv(ENV_HSM_SIGN_CACHE_SIZE);
+            disabled_cache = hsm_sign_cache_create_from_env();
+            test_helper_setenv(ENV_HSM_SIGN_CACHE_SIZE, "lots");
+            invalid_cache = hsm_sign_cache_create_from_env();
+
+            // act
+            test_helper_setenv(ENV_HSM_SIGN_CACHE_SIZE, "16");
+            test_helper_setenv(ENV_HSM_SIGN_CACHE_TTL, "120");
+            cache = hsm_sign_cache_create_from_env();
+
+            // assert
+            ASSERT_IS_NULL(disabled_cache);
+            ASSERT_IS_NULL(invalid_cache);
+            ASSERT_IS_NOT_NULL(cache);
+            test_helper_insert(cache, NULL, 0, TEST_PAYLOAD_NO_EXPIRY, 1);
+            ASSERT_IS_TRUE(test_helper_lookup(cache, NULL, 0, TEST_PAYLOAD_NO_EXPIRY, 1));
+
+            // cleanup
+            hsm_sign_cache_destroy(cache);
+        }
+
+END_TEST_SUITE(hsm_sign_cache_int_tests)
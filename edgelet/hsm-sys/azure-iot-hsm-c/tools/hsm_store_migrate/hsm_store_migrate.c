@@ -0,0 +1,199 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+// Imports the enc_keys directory of an HSM store into the packed store file
+// that is used when IOTEDGE_HSM_PACKED_STORE is set. Certificates and their
+// keys are not imported since the store only reads them from the certs and
+// cert_keys directories. Records are named after the files they are imported
+// from so any existing record is overwritten, and the store is compacted
+// once all files are in. The directory is left untouched.
+//
+// Usage: hsm_store_migrate <hsm dir> [packed store file]
+//
+// The hsm dir is the hsm directory under IOTEDGE_HOMEDIR and the packed
+// store file defaults to store.pack in that directory. Run the tool while
+// iotedged is stopped, and again if encryption keys were created while the
+// packed store was disabled.
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hsm_packed_store.h"
+
+#if defined __WINDOWS__ || defined _WIN32 || defined _WIN64 || defined _Windows
+    #include <windows.h>
+    #define SLASH "\\"
+#else
+    #include <dirent.h>
+    #define SLASH "/"
+#endif
+
+#define MAX_PATH_SIZE 1024
+
+typedef struct MIGRATE_DIR_TAG
+{
+    const char *dir_name;
+    const char *file_ext;
+    HSM_PACKED_RECORD_TYPE type;
+} MIGRATE_DIR;
+
+static const MIGRATE_DIR MIGRATE_DIRS[] =
+{
+    { "enc_keys", ".enc.key", HSM_PACKED_RECORD_ENC_KEY }
+};
+
+static int migrate_file
+(
+    HSM_PACKED_STORE_HANDLE store,
+    const MIGRATE_DIR *dir,
+    const char *dir_path,
+    const char *file_name,
+    size_t *num_imported
+)
+{
+    int result;
+    size_t name_len = strlen(file_name);
+    size_t ext_len = strlen(dir->file_ext);
+    char record_name[MAX_PATH_SIZE];
+    char file_path[MAX_PATH_SIZE];
+
+    if ((name_len <= ext_len) || (strcmp(file_name + name_len - ext_len, dir->file_ext) != 0))
+    {
+        // not a store file
+        result = 0;
+    }
+    else if ((name_len >= sizeof(record_name)) ||
+             (snprintf(file_path, sizeof(file_path), "%s%s%s", dir_path, SLASH, file_name) >= (int)sizeof(file_path)))
+    {
+        (void)printf("Path too long for %s\n", file_name);
+        result = 1;
+    }
+    else
+    {
+        memcpy(record_name, file_name, name_len - ext_len);
+        record_name[name_len - ext_len] = 0;
+        if (hsm_packed_store_import_file(store, dir->type, record_name, file_path) != 0)
+        {
+            (void)printf("Could not import %s\n", file_path);
+            result = 1;
+        }
+        else
+        {
+            (*num_imported)++;
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+static int migrate_dir
+(
+    HSM_PACKED_STORE_HANDLE store,
+    const char *hsm_dir,
+    const MIGRATE_DIR *dir,
+    size_t *num_imported
+)
+{
+    int result = 0;
+    char dir_path[MAX_PATH_SIZE];
+
+    if (snprintf(dir_path, sizeof(dir_path), "%s%s%s", hsm_dir, SLASH, dir->dir_name) >= (int)sizeof(dir_path))
+    {
+        (void)printf("Path too long for %s\n", dir->dir_name);
+        result = 1;
+    }
+    else
+    {
+#if defined __WINDOWS__ || defined _WIN32 || defined _WIN64 || defined _Windows
+        char pattern[MAX_PATH_SIZE];
+        WIN32_FIND_DATAA find_data;
+        HANDLE find_handle;
+
+        if (snprintf(pattern, sizeof(pattern), "%s%s*", dir_path, SLASH) >= (int)sizeof(pattern))
+        {
+            (void)printf("Path too long for %s\n", dir_path);
+            result = 1;
+        }
+        else if ((find_handle = FindFirstFileA(pattern, &find_data)) == INVALID_HANDLE_VALUE)
+        {
+            (void)printf("Skipping %s, directory not found or empty\n", dir_path);
+        }
+        else
+        {
+            do
+            {
+                if ((find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0)
+                {
+                    result = migrate_file(store, dir, dir_path, find_data.cFileName, num_imported);
+                }
+            } while ((result == 0) && FindNextFileA(find_handle, &find_data));
+            FindClose(find_handle);
+        }
+#else
+        DIR *dir_handle;
+        struct dirent *entry;
+
+        if ((dir_handle = opendir(dir_path)) == NULL)
+        {
+            (void)printf("Skipping %s, directory not found\n", dir_path);
+        }
+        else
+        {
+            while ((result == 0) && ((entry = readdir(dir_handle)) != NULL))
+            {
+                result = migrate_file(store, dir, dir_path, entry->d_name, num_imported);
+            }
+            (void)closedir(dir_handle);
+        }
+#endif
+    }
+
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    int result = 0;
+    char store_path[MAX_PATH_SIZE];
+    HSM_PACKED_STORE_HANDLE store;
+
+    if ((argc < 2) || (argc > 3))
+    {
+        (void)printf("Usage: %s <hsm dir> [packed store file]\n", argv[0]);
+        result = 1;
+    }
+    else if ((argc == 2) &&
+             (snprintf(store_path, sizeof(store_path), "%s%sstore.pack", argv[1], SLASH) >= (int)sizeof(store_path)))
+    {
+        (void)printf("Path too long for %s\n", argv[1]);
+        result = 1;
+    }
+    else if ((store = hsm_packed_store_open((argc == 3) ? argv[2] : store_path)) == NULL)
+    {
+        (void)printf("Could not open packed store\n");
+        result = 1;
+    }
+    else
+    {
+        size_t index, num_imported = 0;
+
+        for (index = 0; (index < sizeof(MIGRATE_DIRS) / sizeof(MIGRATE_DIRS[0])) && (result == 0); index++)
+        {
+            result = migrate_dir(store, argv[1], &MIGRATE_DIRS[index], &num_imported);
+        }
+
+        if ((result == 0) && (hsm_packed_store_compact(store) != 0))
+        {
+            (void)printf("Could not compact packed store\n");
+            result = 1;
+        }
+        hsm_packed_store_close(store);
+
+        (void)printf("Imported %zu files, migration %s\n", num_imported, (result == 0) ? "succeeded" : "failed");
+    }
+
+    return result;
+}
@@ -38,6 +38,7 @@ fn bindgen_test_supported_hsm_version() {
 }
 
 pub type HSM_CLIENT_HANDLE = *mut c_void;
+pub type HSM_CLIENT_STREAM_HANDLE = *mut c_void;
 #[repr(C)]
 #[derive(Debug, Copy, Clone)]
 pub struct HSM_CERTIFICATE_TAG {
@@ -87,6 +88,72 @@ fn bindgen_test_layout_SIZED_BUFFER_TAG() {
     );
 }
 
+/// One entry of a batch sign request. identity is only used by derive and
+/// sign batches.
+#[repr(C)]
+#[derive(Debug, Copy, Clone)]
+pub struct HSM_SIGN_REQUEST_TAG {
+    pub data: *const c_uchar,
+    pub data_size: usize,
+    pub identity: *const c_uchar,
+    pub identity_size: usize,
+}
+pub type HSM_SIGN_REQUEST = HSM_SIGN_REQUEST_TAG;
+
+#[test]
+fn bindgen_test_layout_HSM_SIGN_REQUEST_TAG() {
+    assert_eq!(
+        ::std::mem::size_of::<HSM_SIGN_REQUEST_TAG>(),
+        4_usize * ::std::mem::size_of::<usize>(),
+        concat!("Size of: ", stringify!(HSM_SIGN_REQUEST_TAG))
+    );
+    assert_eq!(
+        ::std::mem::align_of::<HSM_SIGN_REQUEST_TAG>(),
+        1_usize * ::std::mem::size_of::<usize>(),
+        concat!("Alignment of ", stringify!(HSM_SIGN_REQUEST_TAG))
+    );
+    assert_eq!(
+        unsafe { &(*(::std::ptr::null::<HSM_SIGN_REQUEST_TAG>())).data as *const _ as usize },
+        0_usize * ::std::mem::size_of::<usize>(),
+        concat!(
+            "Offset of field: ",
+            stringify!(HSM_SIGN_REQUEST_TAG),
+            "::",
+            stringify!(data)
+        )
+    );
+    assert_eq!(
+        unsafe { &(*(::std::ptr::null::<HSM_SIGN_REQUEST_TAG>())).data_size as *const _ as usize },
+        1_usize * ::std::mem::size_of::<usize>(),
+        concat!(
+            "Offset of field: ",
+            stringify!(HSM_SIGN_REQUEST_TAG),
+            "::",
+            stringify!(data_size)
+        )
+    );
+    assert_eq!(
+        unsafe { &(*(::std::ptr::null::<HSM_SIGN_REQUEST_TAG>())).identity as *const _ as usize },
+        2_usize * ::std::mem::size_of::<usize>(),
+        concat!(
+            "Offset of field: ",
+            stringify!(HSM_SIGN_REQUEST_TAG),
+            "::",
+            stringify!(identity)
+        )
+    );
+    assert_eq!(
+        unsafe { &(*(::std::ptr::null::<HSM_SIGN_REQUEST_TAG>())).identity_size as *const _ as usize },
+        3_usize * ::std::mem::size_of::<usize>(),
+        concat!(
+            "Offset of field: ",
+            stringify!(HSM_SIGN_REQUEST_TAG),
+            "::",
+            stringify!(identity_size)
+        )
+    );
+}
+
 pub type HSM_CLIENT_CREATE = Option<unsafe extern "C" fn() -> HSM_CLIENT_HANDLE>;
 pub type HSM_CLIENT_DESTROY = Option<unsafe extern "C" fn(handle: HSM_CLIENT_HANDLE)>;
 pub type HSM_CLIENT_FREE_BUFFER = Option<unsafe extern "C" fn(buffer: *mut c_void)>;
@@ -142,6 +209,80 @@ pub type HSM_CLIENT_DERIVE_AND_SIGN_WITH_IDENTITY = Option<
     ) -> c_int,
 >;
 
+/// API to sign data with the identity key into a buffer supplied by the
+/// caller, without allocating the digest.
+///
+/// digest_size[in/out] -- Size of the digest buffer on input. Length of the
+/// digest, or of the buffer required to hold it, on output.
+///
+/// @note: If digest is NULL the API will return the size of the required
+/// buffer to hold the digest contents.
+pub type HSM_CLIENT_SIGN_WITH_IDENTITY_INTO = Option<
+    unsafe extern "C" fn(
+        handle: HSM_CLIENT_HANDLE,
+        data: *const c_uchar,
+        data_len: usize,
+        digest: *mut c_uchar,
+        digest_size: *mut usize,
+    ) -> c_int,
+>;
+
+/// API to derive the SAS key and use it to sign the data into a buffer
+/// supplied by the caller, without allocating the digest.
+///
+/// digest_size[in/out] -- Size of the digest buffer on input. Length of the
+/// digest, or of the buffer required to hold it, on output.
+///
+/// @note: If digest is NULL the API will return the size of the required
+/// buffer to hold the digest contents.
+pub type HSM_CLIENT_DERIVE_AND_SIGN_WITH_IDENTITY_INTO = Option<
+    unsafe extern "C" fn(
+        handle: HSM_CLIENT_HANDLE,
+        data_to_be_signed: *const c_uchar,
+        data_to_be_signed_size: usize,
+        identity: *const c_uchar,
+        identity_size: usize,
+        digest: *mut c_uchar,
+        digest_size: *mut usize,
+    ) -> c_int,
+>;
+
+/// API to sign the data of every request with the identity key. The key is
+/// opened once for the whole batch.
+///
+/// digests[out] -- One buffer holding all the digests, digest i starting at
+/// offset i * digest_size. Free it with HSM_CLIENT_FREE_BUFFER.
+/// digest_size[out] -- Length of each digest.
+///
+/// @note: On failure no digests are returned.
+pub type HSM_CLIENT_SIGN_BATCH = Option<
+    unsafe extern "C" fn(
+        handle: HSM_CLIENT_HANDLE,
+        requests: *const HSM_SIGN_REQUEST,
+        count: usize,
+        digests: *mut *mut c_uchar,
+        digest_size: *mut usize,
+    ) -> c_int,
+>;
+
+/// API to derive the SAS key of the identity of every request and use it to
+/// sign the request data. The identity key is opened once for the whole batch.
+///
+/// digests[out] -- One buffer holding all the digests, digest i starting at
+/// offset i * digest_size. Free it with HSM_CLIENT_FREE_BUFFER.
+/// digest_size[out] -- Length of each digest.
+///
+/// @note: On failure no digests are returned.
+pub type HSM_CLIENT_DERIVE_AND_SIGN_BATCH = Option<
+    unsafe extern "C" fn(
+        handle: HSM_CLIENT_HANDLE,
+        requests: *const HSM_SIGN_REQUEST,
+        count: usize,
+        digests: *mut *mut c_uchar,
+        digest_size: *mut usize,
+    ) -> c_int,
+>;
+
 // x509
 
 pub type HSM_CLIENT_GET_CERTIFICATE =
@@ -240,6 +381,67 @@ pub type HSM_CLIENT_DECRYPT_DATA = Option<
     ) -> c_int,
 >;
 
+/// API to start encrypting or decrypting data of any size in pieces, with the
+/// key used by `HSM_CLIENT_ENCRYPT_DATA`. Cipher text of an encrypt stream can
+/// also be decrypted by `HSM_CLIENT_DECRYPT_DATA`.
+///
+/// handle[in]      -- A valid HSM client handle
+/// client_id[in]   -- Module or client identity string used in key generation
+/// initialization_vector[in] -- Initialization vector used for the cipher
+/// stream[out]     -- Stream handle, released with `HSM_CLIENT_STREAM_DESTROY`
+///
+/// Return
+/// 0 - Success
+/// Non 0 otherwise
+pub type HSM_CLIENT_STREAM_INIT = Option<
+    unsafe extern "C" fn(
+        handle: HSM_CLIENT_HANDLE,
+        client_id: *const SIZED_BUFFER,
+        initialization_vector: *const SIZED_BUFFER,
+        stream: *mut HSM_CLIENT_STREAM_HANDLE,
+    ) -> c_int,
+>;
+/// API to feed the next piece of input to a stream and return any output it
+/// completes.
+///
+/// output[out]     -- Caller supplied buffer, or NULL to query the size needed
+/// output_size[in,out] -- Size of output, on return the number of bytes
+///                        written or which would be written when output is NULL
+///
+/// A call whose output buffer is too small fails without consuming any input
+/// and sets output_size to the size needed.
+///
+/// Return
+/// 0 - Success
+/// Non 0 otherwise
+pub type HSM_CLIENT_STREAM_UPDATE = Option<
+    unsafe extern "C" fn(
+        handle: HSM_CLIENT_HANDLE,
+        stream: HSM_CLIENT_STREAM_HANDLE,
+        input: *const c_uchar,
+        input_size: usize,
+        output: *mut c_uchar,
+        output_size: *mut usize,
+    ) -> c_int,
+>;
+/// API to complete a stream and return its remaining output, output and
+/// output_size are as for `HSM_CLIENT_STREAM_UPDATE`.
+///
+/// Return
+/// 0 - Success
+/// Non 0 otherwise
+pub type HSM_CLIENT_STREAM_FINAL = Option<
+    unsafe extern "C" fn(
+        handle: HSM_CLIENT_HANDLE,
+        stream: HSM_CLIENT_STREAM_HANDLE,
+        output: *mut c_uchar,
+        output_size: *mut usize,
+    ) -> c_int,
+>;
+/// API to release a stream whether or not it completed.
+pub type HSM_CLIENT_STREAM_DESTROY =
+    Option<unsafe extern "C" fn(handle: HSM_CLIENT_HANDLE, stream: HSM_CLIENT_STREAM_HANDLE)>;
+
 pub type CRYPTO_ENCODING_TAG = u32;
 pub const CRYPTO_ENCODING_TAG_PEM: CRYPTO_ENCODING_TAG = 0;
 
@@ -375,6 +577,27 @@ pub type HSM_CLIENT_CREATE_CERTIFICATE = Option<
         -> CERT_INFO_HANDLE,
 >;
 
+/// Generates a batch of X.509 certificate and private key pairs, one for each
+/// of the supplied certificate properties, as if by `HSM_CLIENT_CREATE_CERTIFICATE`.
+/// The keys are generated concurrently and the aliases must be distinct.
+///
+/// certificates receives count handles, the certificate of the properties at
+/// the same index. Each returned handle must be released with
+/// certificate_info_destroy. On failure no handles are returned, although
+/// certificates of some of the properties may have been created.
+///
+/// Return
+/// 0  -- On success
+/// Non 0 -- otherwise
+pub type HSM_CLIENT_CREATE_CERTIFICATES = Option<
+    unsafe extern "C" fn(
+        handle: HSM_CLIENT_HANDLE,
+        certificate_props: *mut CERT_PROPS_HANDLE,
+        count: usize,
+        certificates: *mut CERT_INFO_HANDLE,
+    ) -> c_int,
+>;
+
 /// This API deletes any crypto assets associated with the id.
 ///
 /// handle[in]   -- Valid handle to certificate resources
@@ -469,6 +692,11 @@ pub struct HSM_CLIENT_TPM_INTERFACE_TAG {
     pub hsm_client_sign_with_identity: HSM_CLIENT_SIGN_WITH_IDENTITY,
     pub hsm_client_derive_and_sign_with_identity: HSM_CLIENT_DERIVE_AND_SIGN_WITH_IDENTITY,
     pub hsm_client_free_buffer: HSM_CLIENT_FREE_BUFFER,
+    pub hsm_client_sign_with_identity_into: HSM_CLIENT_SIGN_WITH_IDENTITY_INTO,
+    pub hsm_client_derive_and_sign_with_identity_into:
+        HSM_CLIENT_DERIVE_AND_SIGN_WITH_IDENTITY_INTO,
+    pub hsm_client_sign_batch: HSM_CLIENT_SIGN_BATCH,
+    pub hsm_client_derive_and_sign_batch: HSM_CLIENT_DERIVE_AND_SIGN_BATCH,
 }
 
 pub type HSM_CLIENT_TPM_INTERFACE = HSM_CLIENT_TPM_INTERFACE_TAG;
@@ -484,6 +712,10 @@ impl Default for HSM_CLIENT_TPM_INTERFACE_TAG {
             hsm_client_sign_with_identity: None,
             hsm_client_derive_and_sign_with_identity: None,
             hsm_client_free_buffer: None,
+            hsm_client_sign_with_identity_into: None,
+            hsm_client_derive_and_sign_with_identity_into: None,
+            hsm_client_sign_batch: None,
+            hsm_client_derive_and_sign_batch: None,
         }
     }
 }
@@ -492,7 +724,7 @@ impl Default for HSM_CLIENT_TPM_INTERFACE_TAG {
 fn bindgen_test_layout_HSM_CLIENT_TPM_INTERFACE_TAG() {
     assert_eq!(
         ::std::mem::size_of::<HSM_CLIENT_TPM_INTERFACE_TAG>(),
-        8_usize * ::std::mem::size_of::<usize>(),
+        12_usize * ::std::mem::size_of::<usize>(),
         concat!("Size of: ", stringify!(HSM_CLIENT_TPM_INTERFACE_TAG))
     );
     assert_eq!(
@@ -604,6 +836,58 @@ fn bindgen_test_layout_HSM_CLIENT_TPM_INTERFACE_TAG() {
             stringify!(hsm_client_free_buffer)
         )
     );
+    assert_eq!(
+        unsafe {
+            &(*(::std::ptr::null::<HSM_CLIENT_TPM_INTERFACE_TAG>()))
+                .hsm_client_sign_with_identity_into as *const _ as usize
+        },
+        8_usize * ::std::mem::size_of::<usize>(),
+        concat!(
+            "Offset of field: ",
+            stringify!(HSM_CLIENT_TPM_INTERFACE_TAG),
+            "::",
+            stringify!(hsm_client_sign_with_identity_into)
+        )
+    );
+    assert_eq!(
+        unsafe {
+            &(*(::std::ptr::null::<HSM_CLIENT_TPM_INTERFACE_TAG>()))
+                .hsm_client_derive_and_sign_with_identity_into as *const _ as usize
+        },
+        9_usize * ::std::mem::size_of::<usize>(),
+        concat!(
+            "Offset of field: ",
+            stringify!(HSM_CLIENT_TPM_INTERFACE_TAG),
+            "::",
+            stringify!(hsm_client_derive_and_sign_with_identity_into)
+        )
+    );
+    assert_eq!(
+        unsafe {
+            &(*(::std::ptr::null::<HSM_CLIENT_TPM_INTERFACE_TAG>())).hsm_client_sign_batch
+                as *const _ as usize
+        },
+        10_usize * ::std::mem::size_of::<usize>(),
+        concat!(
+            "Offset of field: ",
+            stringify!(HSM_CLIENT_TPM_INTERFACE_TAG),
+            "::",
+            stringify!(hsm_client_sign_batch)
+        )
+    );
+    assert_eq!(
+        unsafe {
+            &(*(::std::ptr::null::<HSM_CLIENT_TPM_INTERFACE_TAG>()))
+                .hsm_client_derive_and_sign_batch as *const _ as usize
+        },
+        11_usize * ::std::mem::size_of::<usize>(),
+        concat!(
+            "Offset of field: ",
+            stringify!(HSM_CLIENT_TPM_INTERFACE_TAG),
+            "::",
+            stringify!(hsm_client_derive_and_sign_batch)
+        )
+    );
 }
 
 #[repr(C)]
@@ -738,6 +1022,12 @@ pub struct HSM_CLIENT_CRYPTO_INTERFACE_TAG {
     pub hsm_client_decrypt_data: HSM_CLIENT_DECRYPT_DATA,
     pub hsm_client_get_trust_bundle: HSM_CLIENT_GET_TRUST_BUNDLE,
     pub hsm_client_free_buffer: HSM_CLIENT_FREE_BUFFER,
+    pub hsm_client_create_certificates: HSM_CLIENT_CREATE_CERTIFICATES,
+    pub hsm_client_encrypt_stream_init: HSM_CLIENT_STREAM_INIT,
+    pub hsm_client_decrypt_stream_init: HSM_CLIENT_STREAM_INIT,
+    pub hsm_client_stream_update: HSM_CLIENT_STREAM_UPDATE,
+    pub hsm_client_stream_final: HSM_CLIENT_STREAM_FINAL,
+    pub hsm_client_stream_destroy: HSM_CLIENT_STREAM_DESTROY,
 }
 pub type HSM_CLIENT_CRYPTO_INTERFACE = HSM_CLIENT_CRYPTO_INTERFACE_TAG;
 
@@ -755,6 +1045,12 @@ impl Default for HSM_CLIENT_CRYPTO_INTERFACE_TAG {
             hsm_client_decrypt_data: None,
             hsm_client_get_trust_bundle: None,
             hsm_client_free_buffer: None,
+            hsm_client_create_certificates: None,
+            hsm_client_encrypt_stream_init: None,
+            hsm_client_decrypt_stream_init: None,
+            hsm_client_stream_update: None,
+            hsm_client_stream_final: None,
+            hsm_client_stream_destroy: None,
         }
     }
 }
@@ -763,7 +1059,7 @@ impl Default for HSM_CLIENT_CRYPTO_INTERFACE_TAG {
 fn bindgen_test_layout_HSM_CLIENT_CRYPTO_INTERFACE_TAG() {
     assert_eq!(
         ::std::mem::size_of::<HSM_CLIENT_CRYPTO_INTERFACE_TAG>(),
-        11_usize * ::std::mem::size_of::<usize>(),
+        17_usize * ::std::mem::size_of::<usize>(),
         concat!("Size of: ", stringify!(HSM_CLIENT_CRYPTO_INTERFACE_TAG))
     );
     assert_eq!(
@@ -914,6 +1210,84 @@ fn bindgen_test_layout_HSM_CLIENT_CRYPTO_INTERFACE_TAG() {
             stringify!(hsm_client_free_buffer)
         )
     );
+    assert_eq!(
+        unsafe {
+            &(*(::std::ptr::null::<HSM_CLIENT_CRYPTO_INTERFACE_TAG>()))
+                .hsm_client_create_certificates as *const _ as usize
+        },
+        11_usize * ::std::mem::size_of::<usize>(),
+        concat!(
+            "Offset of field: ",
+            stringify!(HSM_CLIENT_CRYPTO_INTERFACE_TAG),
+            "::",
+            stringify!(hsm_client_create_certificates)
+        )
+    );
+    assert_eq!(
+        unsafe {
+            &(*(::std::ptr::null::<HSM_CLIENT_CRYPTO_INTERFACE_TAG>()))
+                .hsm_client_encrypt_stream_init as *const _ as usize
+        },
+        12_usize * ::std::mem::size_of::<usize>(),
+        concat!(
+            "Offset of field: ",
+            stringify!(HSM_CLIENT_CRYPTO_INTERFACE_TAG),
+            "::",
+            stringify!(hsm_client_encrypt_stream_init)
+        )
+    );
+    assert_eq!(
+        unsafe {
+            &(*(::std::ptr::null::<HSM_CLIENT_CRYPTO_INTERFACE_TAG>()))
+                .hsm_client_decrypt_stream_init as *const _ as usize
+        },
+        13_usize * ::std::mem::size_of::<usize>(),
+        concat!(
+            "Offset of field: ",
+            stringify!(HSM_CLIENT_CRYPTO_INTERFACE_TAG),
+            "::",
+            stringify!(hsm_client_decrypt_stream_init)
+        )
+    );
+    assert_eq!(
+        unsafe {
+            &(*(::std::ptr::null::<HSM_CLIENT_CRYPTO_INTERFACE_TAG>()))
+                .hsm_client_stream_update as *const _ as usize
+        },
+        14_usize * ::std::mem::size_of::<usize>(),
+        concat!(
+            "Offset of field: ",
+            stringify!(HSM_CLIENT_CRYPTO_INTERFACE_TAG),
+            "::",
+            stringify!(hsm_client_stream_update)
+        )
+    );
+    assert_eq!(
+        unsafe {
+            &(*(::std::ptr::null::<HSM_CLIENT_CRYPTO_INTERFACE_TAG>()))
+                .hsm_client_stream_final as *const _ as usize
+        },
+        15_usize * ::std::mem::size_of::<usize>(),
+        concat!(
+            "Offset of field: ",
+            stringify!(HSM_CLIENT_CRYPTO_INTERFACE_TAG),
+            "::",
+            stringify!(hsm_client_stream_final)
+        )
+    );
+    assert_eq!(
+        unsafe {
+            &(*(::std::ptr::null::<HSM_CLIENT_CRYPTO_INTERFACE_TAG>()))
+                .hsm_client_stream_destroy as *const _ as usize
+        },
+        16_usize * ::std::mem::size_of::<usize>(),
+        concat!(
+            "Offset of field: ",
+            stringify!(HSM_CLIENT_CRYPTO_INTERFACE_TAG),
+            "::",
+            stringify!(hsm_client_stream_destroy)
+        )
+    );
 }
 
 extern "C" {